@@ -15,6 +15,8 @@ enum class Block : uint8_t {
     Dirt = 9,
     // Add more block types as needed
 };
+// One past the largest Block value; keep in step with the enum
+constexpr size_t BLOCK_TYPE_COUNT = static_cast<size_t>(Block::Dirt) + 1;
 
 constexpr size_t TEXTURE_ATLAS_WIDTH = 512;
 constexpr size_t TEXTURE_ATLAS_HEIGHT = 512;
@@ -41,3 +43,10 @@ constexpr size_t BLOCKS_PER_ROW = TEXTURE_ATLAS_WIDTH / BLOCK_TEXTURE_SIZE;
     size_t y = static_cast<size_t>(texY * BLOCK_TEXTURE_SIZE);
     return {x, y};
 }
+
+// Tile of block's texture counted row by row, row * BLOCKS_PER_ROW + column; also its layer in the
+// texture array loadTextureArray builds from the atlas
+[[maybe_unused]] constexpr uint32_t getTileIndex(Block block) {
+    auto [texX, texY] = getTextureIndex(block);
+    return static_cast<uint32_t>(texY * BLOCKS_PER_ROW + texX);
+}
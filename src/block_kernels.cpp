@@ -0,0 +1,145 @@
+#include "block_kernels.h"
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+static_assert(sizeof(Block) == 1, "kernels treat blocks as bytes");
+static_assert(static_cast<uint8_t>(Block::Empty) == 0, "kernels test for Empty against zero");
+
+namespace {
+
+const uint8_t* bytes(const Block* blocks) { return reinterpret_cast<const uint8_t*>(blocks); }
+uint8_t* bytes(Block* blocks) { return reinterpret_cast<uint8_t*>(blocks); }
+
+} // namespace
+
+size_t countBlocksNotEqual(const Block* blocks, size_t count, Block value) {
+    const uint8_t* p = bytes(blocks);
+    const uint8_t v = static_cast<uint8_t>(value);
+    size_t i = 0;
+    size_t matches = 0;
+#if defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi8(static_cast<char>(v));
+    for (; i + 32 <= count; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        matches += std::popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle))));
+    }
+#elif defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(static_cast<char>(v));
+    for (; i + 16 <= count; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        matches += std::popcount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle))));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t needle = vdupq_n_u8(v);
+    for (; i + 16 <= count; i += 16) {
+        // Equal lanes are 0xff; keep one bit of each and add them up
+        uint8x16_t equal = vceqq_u8(vld1q_u8(p + i), needle);
+        matches += vaddvq_u8(vandq_u8(equal, vdupq_n_u8(1)));
+    }
+#endif
+    for (; i < count; ++i) {
+        matches += p[i] == v;
+    }
+    return count - matches;
+}
+
+size_t findBlockNotEqual(const Block* blocks, size_t count, Block value) {
+    const uint8_t* p = bytes(blocks);
+    const uint8_t v = static_cast<uint8_t>(value);
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi8(static_cast<char>(v));
+    for (; i + 32 <= count; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        uint32_t equal = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+        if (equal != 0xffffffffu) {
+            return i + std::countr_zero(~equal);
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(static_cast<char>(v));
+    for (; i + 16 <= count; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        uint32_t equal = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+        if (equal != 0xffffu) {
+            return i + std::countr_zero(~equal);
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t needle = vdupq_n_u8(v);
+    for (; i + 16 <= count; i += 16) {
+        // Some lane differs when the smallest comparison result isn't 0xff; the scalar loop finds it
+        if (vminvq_u8(vceqq_u8(vld1q_u8(p + i), needle)) != 0xff) {
+            break;
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        if (p[i] != v) {
+            return i;
+        }
+    }
+    return count;
+}
+
+void mergeNonEmptyBlocks(Block* dst, const Block* first, const Block* second, size_t count) {
+    uint8_t* out = bytes(dst);
+    const uint8_t* a = bytes(first);
+    const uint8_t* b = bytes(second);
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    for (; i + 32 <= count; i += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i vd = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out + i));
+        // blendv takes its first operand where the mask byte is clear
+        __m256i fallback = _mm256_blendv_epi8(vb, vd, _mm256_cmpeq_epi8(vb, zero));
+        __m256i merged = _mm256_blendv_epi8(va, fallback, _mm256_cmpeq_epi8(va, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), merged);
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    auto select = [](__m128i mask, __m128i whenSet, __m128i whenClear) {
+        return _mm_or_si128(_mm_and_si128(mask, whenSet), _mm_andnot_si128(mask, whenClear));
+    };
+    for (; i + 16 <= count; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i vd = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+        __m128i fallback = select(_mm_cmpeq_epi8(vb, zero), vd, vb);
+        __m128i merged = select(_mm_cmpeq_epi8(va, zero), fallback, va);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), merged);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t va = vld1q_u8(a + i);
+        uint8x16_t vb = vld1q_u8(b + i);
+        uint8x16_t vd = vld1q_u8(out + i);
+        uint8x16_t fallback = vbslq_u8(vceqzq_u8(vb), vd, vb);
+        vst1q_u8(out + i, vbslq_u8(vceqzq_u8(va), fallback, va));
+    }
+#endif
+    for (; i < count; ++i) {
+        if (a[i] != 0) {
+            out[i] = a[i];
+        } else if (b[i] != 0) {
+            out[i] = b[i];
+        }
+    }
+}
+
+void fillBlocks(Block* dst, size_t count, Block value) {
+    // memset is already vectorized by every standard library we build against
+    std::memset(dst, static_cast<uint8_t>(value), count);
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include "block.h"
+
+/**
+ * @brief Bulk loops over runs of blocks in storage order, the shape ChunkSpan::copyTo and assign
+ * work in. Each uses AVX2, SSE2 or NEON when the target has it (picked at compile time, so x86-64
+ * gets SSE2 by default and AVX2 with -mavx2) and a scalar loop for the rest.
+ */
+
+// Blocks in [blocks, blocks + count) that aren't value
+size_t countBlocksNotEqual(const Block* blocks, size_t count, Block value);
+// Index of the first block that isn't value, or count if there is none
+size_t findBlockNotEqual(const Block* blocks, size_t count, Block value);
+// Per block: first where it isn't Empty, else second where that isn't Empty, else dst unchanged
+void mergeNonEmptyBlocks(Block* dst, const Block* first, const Block* second, size_t count);
+void fillBlocks(Block* dst, size_t count, Block value);
@@ -39,6 +39,10 @@ void BlockRenderer::initialize() {
     glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
     glEnableVertexAttribArray(2);
     
+    // Atlas tile attribute
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tile));
+    glEnableVertexAttribArray(3);
+    
     glBindVertexArray(0);
 }
 
@@ -93,9 +97,6 @@ std::vector<Vertex> BlockRenderer::generateCubeVertices(Block blockType) {
         { 0.0f, -1.0f,  0.0f}  // Bottom
     };
     
-    // Texture coordinates for each vertex of each face
-    // Note: texCoords array removed as we use getTextureUV function instead
-    
     vertices.reserve(24);
     
     for (int face = 0; face < 6; ++face) {
@@ -103,7 +104,8 @@ std::vector<Vertex> BlockRenderer::generateCubeVertices(Block blockType) {
             Vertex v;
             v.position = positions[face * 4 + vertex];
             v.normal = normals[face];
-            v.texCoord = getTextureUV(blockType, face, vertex);
+            v.texCoord = getTileCorner(vertex);
+            v.tile = getTileOrigin(blockType);
             vertices.push_back(v);
         }
     }
@@ -133,22 +135,6 @@ std::vector<unsigned int> BlockRenderer::generateCubeIndices() {
     return indices;
 }
 
-glm::vec2 BlockRenderer::getTextureUV(Block block, int /* face */, int vertex) {
-    auto [texX, texY] = getTextureIndex(block);
-    
-    // Convert texture atlas coordinates to UV coordinates
-    float u = static_cast<float>(texX) / BLOCKS_PER_ROW;
-    float v = static_cast<float>(texY) / BLOCKS_PER_ROW;
-    float uvSize = 1.0f / BLOCKS_PER_ROW;
-    
-    // UV coordinates for each vertex of a face (0=bottom-left, 1=bottom-right, 2=top-right, 3=top-left)
-    glm::vec2 uvOffsets[4] = {
-        {0.0f, uvSize}, {uvSize, uvSize}, {uvSize, 0.0f}, {0.0f, 0.0f}
-    };
-    
-    return glm::vec2(u, v) + uvOffsets[vertex];
-}
-
 void BlockRenderer::setupCubeGeometry() {
     cubeVertices = generateCubeVertices(Block::Stone); // Default block type
     cubeIndices = generateCubeIndices();
@@ -1,15 +1,58 @@
 #pragma once
 
+#include <array>
 #include <vector>
 #include "block.h"
 #include <glm/glm.hpp>
 #include "gl_includes.h"
 struct Vertex {
     glm::vec3 position;
+    // In tiles from the tile's corner; the shader wraps it so merged faces repeat the texture
     glm::vec2 texCoord;
     glm::vec3 normal;
+    // Atlas UV of the block texture's corner
+    glm::vec2 tile;
 };
 
+// A UV pair usable in constant expressions, which glm::vec2 is not here
+struct TextureUV {
+    float u;
+    float v;
+};
+
+// Corner of a face in tile units (0=bottom-left, 1=bottom-right, 2=top-right, 3=top-left).
+// The atlas's v grows downwards, so the bottom of a face is v = 1.
+inline constexpr std::array<TextureUV, 4> TILE_CORNERS = {{
+    {0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f}, {0.0f, 0.0f}
+}};
+
+// Atlas UV of each block's texture corner, indexed by Block
+inline constexpr std::array<TextureUV, BLOCK_TYPE_COUNT> BLOCK_TILE_ORIGINS = [] {
+    std::array<TextureUV, BLOCK_TYPE_COUNT> origins{};
+    for (size_t block = 0; block < BLOCK_TYPE_COUNT; ++block) {
+        auto [texX, texY] = getTextureIndex(static_cast<Block>(block));
+        origins[block] = {static_cast<float>(texX) / BLOCKS_PER_ROW, static_cast<float>(texY) / BLOCKS_PER_ROW};
+    }
+    return origins;
+}();
+
+// Atlas UV of every face corner by [block][face][vertex], as getTextureUV returns it. Faces are in
+// ChunkNeighbours order; every face of a block shares one texture for now.
+using BlockFaceUVTable = std::array<std::array<std::array<TextureUV, 4>, 6>, BLOCK_TYPE_COUNT>;
+inline constexpr BlockFaceUVTable BLOCK_FACE_UVS = [] {
+    BlockFaceUVTable table{};
+    const float tileSize = 1.0f / BLOCKS_PER_ROW;
+    for (size_t block = 0; block < BLOCK_TYPE_COUNT; ++block) {
+        for (auto& face : table[block]) {
+            for (size_t vertex = 0; vertex < 4; ++vertex) {
+                face[vertex] = {BLOCK_TILE_ORIGINS[block].u + TILE_CORNERS[vertex].u * tileSize,
+                                BLOCK_TILE_ORIGINS[block].v + TILE_CORNERS[vertex].v * tileSize};
+            }
+        }
+    }
+    return table;
+}();
+
 class BlockRenderer {
 public:
     BlockRenderer();
@@ -22,13 +65,30 @@ public:
     // Geometry generation functions
     static std::vector<Vertex> generateCubeVertices(Block blockType);
     static std::vector<unsigned int> generateCubeIndices();
-    static glm::vec2 getTextureUV(Block block, int face, int vertex);
+    // Table lookups, cheap enough for the mesher's inner loop; unknown blocks get Block::Empty's texture
+    static glm::vec2 getTextureUV(Block block, int face, int vertex) {
+        const TextureUV& uv = BLOCK_FACE_UVS[tableIndex(block)][face][vertex];
+        return glm::vec2(uv.u, uv.v);
+    }
+    // Atlas UV of block's texture, and the size of one texture in UV units
+    static glm::vec2 getTileOrigin(Block block) {
+        const TextureUV& uv = BLOCK_TILE_ORIGINS[tableIndex(block)];
+        return glm::vec2(uv.u, uv.v);
+    }
+    static constexpr float getTileSize() { return 1.0f / BLOCKS_PER_ROW; }
+    // See TILE_CORNERS
+    static glm::vec2 getTileCorner(int vertex) { return glm::vec2(TILE_CORNERS[vertex].u, TILE_CORNERS[vertex].v); }
     
 private:
     GLuint VAO, VBO, EBO;
     std::vector<Vertex> cubeVertices;
     std::vector<unsigned int> cubeIndices;
     
+    static size_t tableIndex(Block block) {
+        size_t index = static_cast<size_t>(block);
+        return index < BLOCK_TYPE_COUNT ? index : 0;
+    }
+    
     void setupCubeGeometry();
     void updateVertexData(Block blockType, const glm::vec3& position);
 };
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "block_storage_pool.h"
+
+#include <algorithm>
+#include <bit>
+#include <new>
+
+static_assert(BLOCK_STORAGE_SLAB_BYTES % (size_t{1} << BLOCK_STORAGE_MAX_CLASS_SHIFT) == 0, "slabs hold whole buffers of every class");
+static_assert((size_t{1} << BLOCK_STORAGE_MIN_CLASS_SHIFT) >= alignof(std::max_align_t), "every buffer is max-aligned");
+
+BlockStoragePool::~BlockStoragePool() {
+    for (auto& sizeClass : classes_) {
+        for (void* slab : sizeClass.slabs) {
+            ::operator delete(slab, std::align_val_t{alignof(std::max_align_t)});
+        }
+    }
+}
+
+size_t BlockStoragePool::classFor(size_t bytes) {
+    const size_t shift = std::bit_width(std::max<size_t>(bytes, 1) - 1);
+    return shift <= BLOCK_STORAGE_MIN_CLASS_SHIFT ? 0 : shift - BLOCK_STORAGE_MIN_CLASS_SHIFT;
+}
+
+void* BlockStoragePool::allocate(size_t bytes) {
+    const size_t index = classFor(bytes);
+    if (index >= BLOCK_STORAGE_CLASS_COUNT) {
+        {
+            std::lock_guard<std::mutex> lock(oversized_.mutex);
+            ++oversized_.fallbacks;
+        }
+        return ::operator new(bytes, std::align_val_t{alignof(std::max_align_t)});
+    }
+    SizeClass& sizeClass = classes_[index];
+    const size_t size = classBytes(index);
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    if (!sizeClass.free) {
+        // Thread the new slab's buffers onto the free list, first buffer on top
+        auto* slab = static_cast<std::byte*>(::operator new(BLOCK_STORAGE_SLAB_BYTES, std::align_val_t{alignof(std::max_align_t)}));
+        sizeClass.slabs.push_back(slab);
+        for (size_t offset = BLOCK_STORAGE_SLAB_BYTES; offset > 0;) {
+            offset -= size;
+            auto* buffer = reinterpret_cast<FreeBuffer*>(slab + offset);
+            buffer->next = sizeClass.free;
+            sizeClass.free = buffer;
+        }
+    }
+    FreeBuffer* buffer = sizeClass.free;
+    sizeClass.free = buffer->next;
+    ++sizeClass.live;
+    return buffer;
+}
+
+void BlockStoragePool::deallocate(void* p, size_t bytes) noexcept {
+    if (!p) {
+        return;
+    }
+    const size_t index = classFor(bytes);
+    if (index >= BLOCK_STORAGE_CLASS_COUNT) {
+        ::operator delete(p, std::align_val_t{alignof(std::max_align_t)});
+        return;
+    }
+    SizeClass& sizeClass = classes_[index];
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    auto* buffer = static_cast<FreeBuffer*>(p);
+    buffer->next = sizeClass.free;
+    sizeClass.free = buffer;
+    --sizeClass.live;
+}
+
+size_t BlockStoragePool::liveBytes() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < BLOCK_STORAGE_CLASS_COUNT; ++i) {
+        std::lock_guard<std::mutex> lock(classes_[i].mutex);
+        bytes += classes_[i].live * classBytes(i);
+    }
+    return bytes;
+}
+
+size_t BlockStoragePool::reservedBytes() const {
+    size_t bytes = 0;
+    for (const auto& sizeClass : classes_) {
+        std::lock_guard<std::mutex> lock(sizeClass.mutex);
+        bytes += sizeClass.slabs.size() * BLOCK_STORAGE_SLAB_BYTES;
+    }
+    return bytes;
+}
+
+size_t BlockStoragePool::fallbackAllocations() const {
+    std::lock_guard<std::mutex> lock(oversized_.mutex);
+    return oversized_.fallbacks;
+}
+
+BlockStoragePool& BlockStoragePool::shared() {
+    static BlockStoragePool* pool = new BlockStoragePool();
+    return *pool;
+}
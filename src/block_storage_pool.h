@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Smallest and largest size class, as powers of two; larger buffers fall through to operator new.
+// The largest holds a dense chunk's blocks, the smallest a short palette.
+constexpr size_t BLOCK_STORAGE_MIN_CLASS_SHIFT = 4;
+constexpr size_t BLOCK_STORAGE_MAX_CLASS_SHIFT = 13;
+constexpr size_t BLOCK_STORAGE_CLASS_COUNT = BLOCK_STORAGE_MAX_CLASS_SHIFT - BLOCK_STORAGE_MIN_CLASS_SHIFT + 1;
+// Bytes each size class takes from the heap at a time
+constexpr size_t BLOCK_STORAGE_SLAB_BYTES = 64 * 1024;
+
+/**
+ * @brief Power-of-two size classes for ChunkSpan block storage (palettes, packed indices, dense
+ * blocks, column heights), each carved from slabs and recycled through its own free list, so the
+ * buffers of loaded, copied-on-write and evicted chunks are reused like ChunkArena's slots rather
+ * than churning the general-purpose heap.
+ *
+ * Slabs are kept until the pool is destroyed. Every class has its own lock, so a palette and a
+ * dense buffer allocated on different threads don't contend. Safe to use from any thread.
+ */
+class BlockStoragePool {
+public:
+    BlockStoragePool() = default;
+    ~BlockStoragePool();
+    BlockStoragePool(const BlockStoragePool&) = delete;
+    BlockStoragePool& operator=(const BlockStoragePool&) = delete;
+
+    // Aligned for any type up to std::max_align_t
+    void* allocate(size_t bytes);
+    // bytes as given to allocate
+    void deallocate(void* p, size_t bytes) noexcept;
+
+    // Bytes in buffers handed out and not yet returned, rounded up to their size classes
+    size_t liveBytes() const;
+    // Bytes taken from the heap as slabs
+    size_t reservedBytes() const;
+    // Requests bigger than the largest class
+    size_t fallbackAllocations() const;
+
+    // The pool ChunkSpan storage comes from; never destroyed, so chunks that outlive static
+    // destruction can still be freed
+    static BlockStoragePool& shared();
+
+private:
+    struct FreeBuffer {
+        FreeBuffer* next;
+    };
+    struct SizeClass {
+        mutable std::mutex mutex;
+        FreeBuffer* free = nullptr;
+        std::vector<void*> slabs;
+        size_t live = 0;
+        size_t fallbacks = 0;
+    };
+
+    // Index of the smallest class holding bytes, or BLOCK_STORAGE_CLASS_COUNT if none does
+    static size_t classFor(size_t bytes);
+    static constexpr size_t classBytes(size_t index) { return size_t{1} << (index + BLOCK_STORAGE_MIN_CLASS_SHIFT); }
+
+    std::array<SizeClass, BLOCK_STORAGE_CLASS_COUNT> classes_;
+    // Counts fallbacks, which have no class of their own
+    SizeClass oversized_;
+};
+
+// Stateless allocator over BlockStoragePool::shared(), for ChunkSpan's storage vectors
+template<typename T>
+class BlockStorageAllocator {
+public:
+    using value_type = T;
+
+    BlockStorageAllocator() noexcept = default;
+    template<typename U>
+    BlockStorageAllocator(const BlockStorageAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) { return static_cast<T*>(BlockStoragePool::shared().allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) noexcept { BlockStoragePool::shared().deallocate(p, n * sizeof(T)); }
+
+    template<typename U>
+    bool operator==(const BlockStorageAllocator<U>&) const noexcept { return true; }
+};
+
+template<typename T>
+using PooledVector = std::vector<T, BlockStorageAllocator<T>>;
@@ -0,0 +1,70 @@
+#include "buffer_range_allocator.h"
+
+#include <algorithm>
+#include <iterator>
+
+BufferRangeAllocator::BufferRangeAllocator(size_t capacity) {
+    grow(capacity);
+}
+
+std::optional<size_t> BufferRangeAllocator::allocate(size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    for (auto it = free_.begin(); it != free_.end(); ++it) {
+        if (it->second < count) {
+            continue;
+        }
+        size_t offset = it->first;
+        size_t remaining = it->second - count;
+        free_.erase(it);
+        if (remaining > 0) {
+            free_.emplace(offset + count, remaining);
+        }
+        used_ += count;
+        return offset;
+    }
+    return std::nullopt;
+}
+
+void BufferRangeAllocator::free(size_t offset, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    used_ -= count;
+    auto next = free_.lower_bound(offset);
+    // Merge with the free range just before, then with the one just after
+    if (next != free_.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            count += prev->second;
+            free_.erase(prev);
+        }
+    }
+    if (next != free_.end() && offset + count == next->first) {
+        count += next->second;
+        free_.erase(next);
+    }
+    free_.emplace(offset, count);
+}
+
+void BufferRangeAllocator::grow(size_t newCapacity) {
+    if (newCapacity <= capacity_) {
+        return;
+    }
+    size_t added = newCapacity - capacity_;
+    size_t start = capacity_;
+    capacity_ = newCapacity;
+    // Counted as used by free() below
+    used_ += added;
+    free(start, added);
+}
+
+size_t BufferRangeAllocator::largestFree() const {
+    size_t largest = 0;
+    for (const auto& [offset, count] : free_) {
+        largest = std::max(largest, count);
+    }
+    return largest;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <optional>
+
+/**
+ * @brief First-fit sub-allocator of element ranges inside one fixed-size buffer.
+ *
+ * Freed ranges are merged with free neighbours, so a buffer that is emptied returns to a single
+ * free range. Only offsets are tracked; the caller owns the storage. Not thread-safe.
+ */
+class BufferRangeAllocator {
+public:
+    explicit BufferRangeAllocator(size_t capacity = 0);
+
+    // Offset of count free elements, or nullopt if no free range is large enough
+    std::optional<size_t> allocate(size_t count);
+    // Returns a range from allocate(); count must be the allocated count
+    void free(size_t offset, size_t count);
+    // Adds the space between the old and new capacity as free; never shrinks
+    void grow(size_t newCapacity);
+
+    size_t capacity() const { return capacity_; }
+    size_t used() const { return used_; }
+    size_t largestFree() const;
+
+private:
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+    // Free ranges by offset
+    std::map<size_t, size_t> free_;
+};
@@ -0,0 +1,73 @@
+#include "chunk_arena.h"
+
+#include <new>
+
+static_assert(CHUNK_ARENA_SLOT_BYTES >= sizeof(void*), "a free slot holds the next pointer");
+
+ChunkArena::ChunkArena(size_t slotsPerSlab) : slotsPerSlab_(slotsPerSlab > 0 ? slotsPerSlab : 1) {}
+
+ChunkArena::~ChunkArena() {
+    for (void* slab : slabs_) {
+        ::operator delete(slab, std::align_val_t{alignof(std::max_align_t)});
+    }
+}
+
+void* ChunkArena::allocate(size_t bytes, size_t alignment) {
+    if (!fits(bytes, alignment)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++fallbacks_;
+        }
+        return ::operator new(bytes, std::align_val_t{alignment});
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_) {
+        // Thread the new slab's slots onto the free list, first slot on top
+        auto* slab = static_cast<std::byte*>(::operator new(slotsPerSlab_ * CHUNK_ARENA_SLOT_BYTES, std::align_val_t{alignof(std::max_align_t)}));
+        slabs_.push_back(slab);
+        for (size_t i = slotsPerSlab_; i-- > 0;) {
+            auto* slot = reinterpret_cast<FreeSlot*>(slab + i * CHUNK_ARENA_SLOT_BYTES);
+            slot->next = free_;
+            free_ = slot;
+        }
+    }
+    FreeSlot* slot = free_;
+    free_ = slot->next;
+    ++live_;
+    return slot;
+}
+
+void ChunkArena::deallocate(void* p, size_t bytes, size_t alignment) noexcept {
+    if (!p) {
+        return;
+    }
+    if (!fits(bytes, alignment)) {
+        ::operator delete(p, std::align_val_t{alignment});
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* slot = static_cast<FreeSlot*>(p);
+    slot->next = free_;
+    free_ = slot;
+    --live_;
+}
+
+size_t ChunkArena::liveSlots() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return live_;
+}
+
+size_t ChunkArena::reservedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return slabs_.size() * slotsPerSlab_ * CHUNK_ARENA_SLOT_BYTES;
+}
+
+size_t ChunkArena::fallbackAllocations() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fallbacks_;
+}
+
+ChunkArena& ChunkArena::shared() {
+    static ChunkArena* arena = new ChunkArena();
+    return *arena;
+}
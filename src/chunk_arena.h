@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "chunkspan.h"
+
+// Bytes per arena slot: a ChunkSpan plus the control block allocate_shared keeps beside it
+constexpr size_t CHUNK_ARENA_SLOT_BYTES = (sizeof(ChunkSpan) + 64 + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+// Slots carved from each slab the arena takes from the heap
+constexpr size_t CHUNK_ARENA_SLAB_SLOTS = 256;
+
+/**
+ * @brief Fixed-size slots for shared ChunkSpans, taken from large slabs and recycled through a free
+ * list, so loading, editing (copy-on-write) and evicting chunks reuses the same memory instead of
+ * fragmenting the general-purpose heap. The ChunkSpan object and its shared_ptr control block
+ * live here; its block storage comes from BlockStoragePool.
+ *
+ * Slabs are kept until the arena is destroyed. Requests bigger than a slot fall through to
+ * operator new. Safe to use from any thread.
+ */
+class ChunkArena {
+public:
+    explicit ChunkArena(size_t slotsPerSlab = CHUNK_ARENA_SLAB_SLOTS);
+    ~ChunkArena();
+    ChunkArena(const ChunkArena&) = delete;
+    ChunkArena& operator=(const ChunkArena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment);
+    // bytes and alignment as given to allocate
+    void deallocate(void* p, size_t bytes, size_t alignment) noexcept;
+
+    // Slots handed out and not yet returned
+    size_t liveSlots() const;
+    // Bytes taken from the heap as slabs
+    size_t reservedBytes() const;
+    // Requests too big or too aligned for a slot
+    size_t fallbackAllocations() const;
+
+    // The arena World and Client allocate chunks from; never destroyed, so chunks that outlive
+    // static destruction can still be freed
+    static ChunkArena& shared();
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    static bool fits(size_t bytes, size_t alignment) {
+        return bytes <= CHUNK_ARENA_SLOT_BYTES && alignment <= alignof(std::max_align_t);
+    }
+
+    const size_t slotsPerSlab_;
+    mutable std::mutex mutex_;
+    FreeSlot* free_ = nullptr;
+    std::vector<void*> slabs_;
+    size_t live_ = 0;
+    size_t fallbacks_ = 0;
+};
+
+// Allocator handing out ChunkArena slots, for std::allocate_shared
+template<typename T>
+class ChunkArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ChunkArenaAllocator(ChunkArena& arena) noexcept : arena_(&arena) {}
+    template<typename U>
+    ChunkArenaAllocator(const ChunkArenaAllocator<U>& other) noexcept : arena_(other.arena()) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T* p, size_t n) noexcept { arena_->deallocate(p, n * sizeof(T), alignof(T)); }
+
+    ChunkArena* arena() const noexcept { return arena_; }
+    template<typename U>
+    bool operator==(const ChunkArenaAllocator<U>& other) const noexcept { return arena_ == other.arena(); }
+
+private:
+    ChunkArena* arena_;
+};
+
+// A ChunkSpan constructed from args in a slot of the shared arena; use instead of make_shared
+template<typename... Args>
+std::shared_ptr<ChunkSpan> makePooledChunk(Args&&... args) {
+    return std::allocate_shared<ChunkSpan>(ChunkArenaAllocator<ChunkSpan>(ChunkArena::shared()), std::forward<Args>(args)...);
+}
@@ -0,0 +1,180 @@
+#include "chunk_culling.h"
+
+#include <deque>
+
+#include "chunk_mesh.h"
+#include "chunkdims.h"
+
+namespace {
+
+// Matches the mesher: only these blocks are seen through
+bool isSeeThrough(Block block) {
+    return block == Block::Empty || block == Block::Air;
+}
+
+int cellIndex(int x, int y, int z) {
+    return x + y * CHUNK_WIDTH + z * CHUNK_WIDTH * CHUNK_HEIGHT;
+}
+
+// Faces (ChunkNeighbours order) of the chunk that the cell lies against, as a bit mask
+unsigned borderFaces(int x, int y, int z) {
+    unsigned faces = 0;
+    if (z == CHUNK_DEPTH - 1) faces |= 1u << 0;
+    if (z == 0) faces |= 1u << 1;
+    if (x == 0) faces |= 1u << 2;
+    if (x == CHUNK_WIDTH - 1) faces |= 1u << 3;
+    if (y == CHUNK_HEIGHT - 1) faces |= 1u << 4;
+    if (y == 0) faces |= 1u << 5;
+    return faces;
+}
+
+} // namespace
+
+ChunkFaceConnectivity computeChunkFaceConnectivity(const std::vector<Block>& chunkData) {
+    std::vector<uint8_t> visited;
+    std::vector<int> stack;
+    return computeChunkFaceConnectivity(chunkData, visited, stack);
+}
+
+ChunkFaceConnectivity computeChunkFaceConnectivity(std::span<const Block> chunkData, std::vector<uint8_t>& visited, std::vector<int>& stack) {
+    ChunkFaceConnectivity connectivity = 0;
+    visited.assign(CHUNK_BLOCK_COUNT, 0);
+    stack.clear();
+
+    for (int z = 0; z < CHUNK_DEPTH; ++z) {
+        for (int y = 0; y < CHUNK_HEIGHT; ++y) {
+            for (int x = 0; x < CHUNK_WIDTH; ++x) {
+                int start = cellIndex(x, y, z);
+                if (visited[start] || !isSeeThrough(chunkData[start])) {
+                    continue;
+                }
+
+                // Flood fill one pocket, collecting the faces it reaches
+                unsigned faces = 0;
+                visited[start] = 1;
+                stack.push_back(start);
+                while (!stack.empty()) {
+                    int index = stack.back();
+                    stack.pop_back();
+                    int cx = index % CHUNK_WIDTH;
+                    int cy = (index / CHUNK_WIDTH) % CHUNK_HEIGHT;
+                    int cz = index / (CHUNK_WIDTH * CHUNK_HEIGHT);
+                    faces |= borderFaces(cx, cy, cz);
+                    const int steps[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+                    for (const auto& step : steps) {
+                        int nx = cx + step[0], ny = cy + step[1], nz = cz + step[2];
+                        if (nx < 0 || nx >= CHUNK_WIDTH || ny < 0 || ny >= CHUNK_HEIGHT || nz < 0 || nz >= CHUNK_DEPTH) {
+                            continue;
+                        }
+                        int next = cellIndex(nx, ny, nz);
+                        if (!visited[next] && isSeeThrough(chunkData[next])) {
+                            visited[next] = 1;
+                            stack.push_back(next);
+                        }
+                    }
+                }
+
+                for (int a = 0; a < 6; ++a) {
+                    for (int b = a + 1; b < 6; ++b) {
+                        if ((faces >> a & 1) && (faces >> b & 1)) {
+                            connectivity |= static_cast<ChunkFaceConnectivity>(1u << chunkFacePairBit(a, b));
+                        }
+                    }
+                }
+                if (connectivity == CHUNK_FACES_ALL_CONNECTED) {
+                    return connectivity;
+                }
+            }
+        }
+    }
+    return connectivity;
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+    // Gribb & Hartmann: each plane is the last row of the matrix plus or minus one of the others
+    auto row = [&](int i) {
+        return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    };
+    planes_[0] = row(3) + row(0); // left
+    planes_[1] = row(3) - row(0); // right
+    planes_[2] = row(3) + row(1); // bottom
+    planes_[3] = row(3) - row(1); // top
+    planes_[4] = row(3) + row(2); // near
+    planes_[5] = row(3) - row(2); // far
+}
+
+bool Frustum::intersectsBox(const glm::vec3& lo, const glm::vec3& hi) const {
+    for (const glm::vec4& plane : planes_) {
+        // The box corner furthest along the plane's normal
+        float x = plane.x >= 0.0f ? hi.x : lo.x;
+        float y = plane.y >= 0.0f ? hi.y : lo.y;
+        float z = plane.z >= 0.0f ? hi.z : lo.z;
+        if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::intersectsChunk(const AbsoluteChunkPosition& pos) const {
+    return intersectsBox(chunkBoundsMin(pos), chunkBoundsMax(pos));
+}
+
+glm::vec3 chunkBoundsMin(const AbsoluteChunkPosition& pos) {
+    return glm::vec3(static_cast<float>(pos.x) * CHUNK_WIDTH - 0.5f,
+                     static_cast<float>(pos.y) * CHUNK_HEIGHT - 0.5f,
+                     static_cast<float>(pos.z) * CHUNK_DEPTH - 0.5f);
+}
+
+glm::vec3 chunkBoundsMax(const AbsoluteChunkPosition& pos) {
+    return chunkBoundsMin(pos) + glm::vec3(CHUNK_WIDTH, CHUNK_HEIGHT, CHUNK_DEPTH);
+}
+
+ChunkSet findVisibleChunks(const AbsoluteChunkPosition& cameraChunk, int32_t maxDistance,
+                           const std::function<std::optional<ChunkFaceConnectivity>(const AbsoluteChunkPosition&)>& connectivity,
+                           const std::function<bool(const AbsoluteChunkPosition&)>& inView) {
+    struct Step {
+        AbsoluteChunkPosition pos;
+        // Face of pos the walk came in through, or -1 for the camera's chunk
+        int entered;
+        // Faces already stepped out of on the way here; their opposites are never taken
+        unsigned travelled;
+    };
+
+    ChunkSet visible;
+    visible.insert(cameraChunk);
+    std::deque<Step> queue;
+    queue.push_back(Step{cameraChunk, -1, 0});
+
+    while (!queue.empty()) {
+        Step step = queue.front();
+        queue.pop_front();
+        ChunkFaceConnectivity open = CHUNK_FACES_ALL_CONNECTED;
+        if (step.entered >= 0) {
+            open = connectivity(step.pos).value_or(CHUNK_FACES_ALL_CONNECTED);
+        }
+
+        for (int face = 0; face < 6; ++face) {
+            // Faces come in opposite pairs (0,1), (2,3), (4,5)
+            int opposite = face ^ 1;
+            if (step.travelled & (1u << opposite)) {
+                continue;
+            }
+            if (step.entered >= 0 && (face == step.entered || !chunkFacesConnected(open, step.entered, face))) {
+                continue;
+            }
+            AbsoluteChunkPosition next = ChunkNeighbours::positionOf(step.pos, face);
+            if (next.x - cameraChunk.x > maxDistance || cameraChunk.x - next.x > maxDistance ||
+                next.y - cameraChunk.y > maxDistance || cameraChunk.y - next.y > maxDistance ||
+                next.z - cameraChunk.z > maxDistance || cameraChunk.z - next.z > maxDistance) {
+                continue;
+            }
+            if (visible.contains(next) || !inView(next)) {
+                continue;
+            }
+            visible.insert(next);
+            queue.push_back(Step{next, opposite, step.travelled | (1u << face)});
+        }
+    }
+    return visible;
+}
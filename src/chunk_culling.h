@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "block.h"
+#include "chunk_pos_hash.h"
+#include "position.h"
+
+/**
+ * @brief Which pairs of a chunk's faces (the ChunkNeighbours order) are joined by see-through
+ * blocks inside it: bit chunkFacePairBit(a, b) is set when a line of sight can enter through
+ * face a and leave through face b.
+ */
+using ChunkFaceConnectivity = uint16_t;
+// Every face sees every other; used for chunks that haven't been meshed yet
+constexpr ChunkFaceConnectivity CHUNK_FACES_ALL_CONNECTED = 0x7fff;
+
+constexpr int chunkFacePairBit(int a, int b) {
+    if (a > b) {
+        int t = a;
+        a = b;
+        b = t;
+    }
+    // Pairs (0,1)..(0,5), (1,2)..(1,5), ... numbered in order, 15 in all
+    return a * 5 - a * (a - 1) / 2 + (b - a - 1);
+}
+
+inline bool chunkFacesConnected(ChunkFaceConnectivity connectivity, int a, int b) {
+    return (connectivity >> chunkFacePairBit(a, b)) & 1;
+}
+
+/**
+ * @brief Flood fills the chunk's see-through blocks (the ones the mesher skips) and records which
+ * faces each connected pocket touches. Cheap enough to run next to meshing on a worker.
+ */
+ChunkFaceConnectivity computeChunkFaceConnectivity(const std::vector<Block>& chunkData);
+// As above over CHUNK_BLOCK_COUNT blocks, with caller-owned buffers reused across calls
+ChunkFaceConnectivity computeChunkFaceConnectivity(std::span<const Block> chunkData, std::vector<uint8_t>& visited, std::vector<int>& stack);
+
+/**
+ * @brief The six clip planes of a view-projection matrix, for rejecting chunks the camera can't see.
+ */
+class Frustum {
+public:
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    // False only when the box lies entirely outside one plane; boxes near a corner may pass anyway
+    bool intersectsBox(const glm::vec3& lo, const glm::vec3& hi) const;
+    bool intersectsChunk(const AbsoluteChunkPosition& pos) const;
+
+private:
+    // (a, b, c, d) with ax + by + cz + d >= 0 on the inside
+    std::array<glm::vec4, 6> planes_;
+};
+
+// World-space bounds of a chunk's blocks; blocks are unit cubes centred on their integer position
+glm::vec3 chunkBoundsMin(const AbsoluteChunkPosition& pos);
+glm::vec3 chunkBoundsMax(const AbsoluteChunkPosition& pos);
+
+/**
+ * @brief Cave culling: walks outward from the camera's chunk through neighbouring chunks, only
+ * leaving a chunk through a face its see-through blocks connect to the face it was entered by, and
+ * never turning back along an axis already travelled. Chunks behind solid ground or cliffs, and
+ * sealed caves, are never reached.
+ *
+ * connectivity returns nullopt for chunks without a mesh yet; those are treated as open.
+ * inView filters what is walked into (e.g. Frustum::intersectsChunk); the camera's chunk is
+ * always visible. Chunks further than maxDistance from the camera's chunk on any axis are ignored.
+ */
+ChunkSet findVisibleChunks(const AbsoluteChunkPosition& cameraChunk, int32_t maxDistance,
+                           const std::function<std::optional<ChunkFaceConnectivity>(const AbsoluteChunkPosition&)>& connectivity,
+                           const std::function<bool(const AbsoluteChunkPosition&)>& inView);
@@ -0,0 +1,67 @@
+#include "chunk_delta_log.h"
+
+#include <algorithm>
+
+ChunkDeltaLog::ChunkDeltaLog(size_t editsPerChunk, size_t maxChunks)
+    : editsPerChunk_(std::max<size_t>(editsPerChunk, 1)), maxChunks_(std::max<size_t>(maxChunks, 1)) {}
+
+void ChunkDeltaLog::record(const AbsoluteChunkPosition& pos, std::uint64_t version, std::uint32_t index, Block block) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [it, inserted] = logs_.try_emplace(pos);
+    if (inserted) {
+        order_.push_back(pos);
+        while (logs_.size() > maxChunks_ && !order_.empty()) {
+            AbsoluteChunkPosition oldest = order_.front();
+            order_.pop_front();
+            if (ChunkPosEq{}(oldest, pos)) {
+                // Stale entry for the log just started; keep it queued
+                order_.push_back(oldest);
+            } else {
+                logs_.erase(oldest);
+            }
+        }
+        // Erasing may have moved entries
+        it = logs_.find(pos);
+    }
+
+    auto& edits = it->second;
+    if (!edits.empty() && version != edits.back().version + 1) {
+        edits.clear();
+    }
+    edits.push_back(Edit{version, index, block});
+    if (edits.size() > editsPerChunk_) {
+        edits.pop_front();
+    }
+}
+
+std::optional<std::vector<ChunkDeltaLog::Edit>> ChunkDeltaLog::editsBetween(const AbsoluteChunkPosition& pos, std::uint64_t fromVersion, std::uint64_t toVersion) const {
+    if (fromVersion == toVersion) {
+        return std::vector<Edit>{};
+    }
+    if (fromVersion > toVersion) {
+        return std::nullopt;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = logs_.find(pos);
+    if (it == logs_.end() || it->second.empty()) {
+        return std::nullopt;
+    }
+    const auto& edits = it->second;
+    // The log must hold every edit after fromVersion up to and including toVersion
+    if (edits.front().version > fromVersion + 1 || edits.back().version < toVersion) {
+        return std::nullopt;
+    }
+    std::vector<Edit> result;
+    result.reserve(static_cast<size_t>(toVersion - fromVersion));
+    for (const auto& edit : edits) {
+        if (edit.version > fromVersion && edit.version <= toVersion) {
+            result.push_back(edit);
+        }
+    }
+    return result;
+}
+
+size_t ChunkDeltaLog::trackedChunks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return logs_.size();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "block.h"
+#include "chunk_pos_hash.h"
+#include "position.h"
+
+// Most recent block edits remembered per chunk
+constexpr size_t CHUNK_DELTA_LOG_EDITS_PER_CHUNK = 256;
+// Chunks with a log at once; the longest-tracked are dropped first
+constexpr size_t CHUNK_DELTA_LOG_MAX_CHUNKS = 4096;
+
+/**
+ * @brief Bounded per-chunk history of single-block edits, so a client holding an older version of a
+ * chunk can be sent just the blocks that changed instead of the whole chunk.
+ *
+ * Each edit is recorded with the chunk's ChunkSpan::version() after it. Since every setBlock bumps
+ * the version by one, a chunk's log is a contiguous run of versions; when a recorded version
+ * doesn't follow the previous one (an unlogged write, a reload, or edits recorded out of order)
+ * the log restarts from it. Safe to use from any thread.
+ */
+class ChunkDeltaLog {
+public:
+    struct Edit {
+        std::uint64_t version; // chunk version after this edit
+        std::uint32_t index;   // storage index (x + y * strideY + z * strideZ)
+        Block block;
+    };
+
+    explicit ChunkDeltaLog(size_t editsPerChunk = CHUNK_DELTA_LOG_EDITS_PER_CHUNK, size_t maxChunks = CHUNK_DELTA_LOG_MAX_CHUNKS);
+
+    void record(const AbsoluteChunkPosition& pos, std::uint64_t version, std::uint32_t index, Block block);
+
+    /**
+     * @brief The edits that turn the chunk at fromVersion into the chunk at toVersion, oldest first.
+     * @return nullopt when the log doesn't cover that whole range; the caller should send the full chunk.
+     */
+    std::optional<std::vector<Edit>> editsBetween(const AbsoluteChunkPosition& pos, std::uint64_t fromVersion, std::uint64_t toVersion) const;
+
+    size_t trackedChunks() const;
+
+private:
+    const size_t editsPerChunk_;
+    const size_t maxChunks_;
+    mutable std::mutex mutex_;
+    ChunkPosMap<std::deque<Edit>> logs_;
+    // When each log was started, for eviction; may hold positions already evicted
+    std::deque<AbsoluteChunkPosition> order_;
+};
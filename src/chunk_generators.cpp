@@ -3,7 +3,15 @@
 #include <algorithm>
 
 
-std::shared_ptr<ChunkTransform> FlatworldChunkGenerator::generateChunk(const AbsoluteChunkPosition& pos, [[maybe_unused]] size_t seed) const {
-    // Create a transform that fills up to the specified height with the fill block
-    return std::make_shared<HeightmapChunkTransform>(static_cast<int>(height_), fillBlock_);
-};
\ No newline at end of file
+FlatworldChunkGenerator::FlatworldChunkGenerator(size_t height, Block fillBlock)
+    : height_(height), fillBlock_(fillBlock),
+      // Fills up to the specified height with the fill block
+      transform_(std::make_shared<HeightmapChunkTransform>(static_cast<int>(height), fillBlock)) {}
+
+std::shared_ptr<ChunkTransform> FlatworldChunkGenerator::generateChunk([[maybe_unused]] const AbsoluteChunkPosition& pos, [[maybe_unused]] size_t seed) const {
+    return transform_;
+};
+
+std::optional<WorldgenSurface> FlatworldChunkGenerator::surfaceAt([[maybe_unused]] int64_t worldX, [[maybe_unused]] int64_t worldZ, [[maybe_unused]] size_t seed) const {
+    return WorldgenSurface{static_cast<int64_t>(height_), fillBlock_};
+}
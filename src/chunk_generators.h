@@ -4,12 +4,14 @@
 // Empty chunk generator - generates empty chunks
 class FlatworldChunkGenerator : public IWorldgenStrategy, public std::enable_shared_from_this<FlatworldChunkGenerator> {
 public:
-    FlatworldChunkGenerator(size_t height = 1, Block fillBlock = Block::Grass)
-        : height_(height), fillBlock_(fillBlock) {}
+    FlatworldChunkGenerator(size_t height = 1, Block fillBlock = Block::Grass);
     std::shared_ptr<ChunkTransform> generateChunk(const AbsoluteChunkPosition& pos, size_t seed) const override;
+    std::optional<WorldgenSurface> surfaceAt(int64_t worldX, int64_t worldZ, size_t seed) const override;
 private:
     size_t height_;
     Block fillBlock_;
+    // The same for every chunk, so World compiles it once
+    std::shared_ptr<ChunkTransform> transform_;
 };
 
 /**
@@ -0,0 +1,207 @@
+#include "chunk_geometry_arena.h"
+#include "log.h"
+
+#include <algorithm>
+
+namespace {
+
+size_t roundUpToGranule(size_t count) {
+    return (count + CHUNK_ARENA_RANGE_GRANULE - 1) / CHUNK_ARENA_RANGE_GRANULE * CHUNK_ARENA_RANGE_GRANULE;
+}
+
+// Copies the used part of a buffer into a larger one
+GLuint growBuffer(GLuint old, size_t oldBytes, size_t newBytes) {
+    GLuint grown;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(newBytes), nullptr, GL_DYNAMIC_DRAW);
+    if (old != 0 && oldBytes > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, old);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(oldBytes));
+    }
+    if (old != 0) {
+        glDeleteBuffers(1, &old);
+    }
+    return grown;
+}
+
+} // namespace
+
+ChunkGeometryArena::ChunkGeometryArena(size_t vertexCapacity, size_t indexCapacity) {
+    glGenVertexArrays(1, &vao_);
+    vbo_ = growBuffer(0, 0, vertexCapacity * sizeof(PackedVertex));
+    ebo_ = growBuffer(0, 0, indexCapacity * sizeof(uint16_t));
+    vertices_.grow(vertexCapacity);
+    indices_.grow(indexCapacity);
+
+    glBindVertexArray(vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+    glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(PackedVertex), (void*)offsetof(PackedVertex, corner));
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(PackedVertex), (void*)offsetof(PackedVertex, tile));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+
+    glGenBuffers(1, &originBuffer_);
+    glGenTextures(1, &originTexture_);
+}
+
+ChunkGeometryArena::~ChunkGeometryArena() {
+    glDeleteTextures(1, &originTexture_);
+    glDeleteBuffers(1, &originBuffer_);
+    glDeleteBuffers(1, &ebo_);
+    glDeleteBuffers(1, &vbo_);
+    glDeleteVertexArrays(1, &vao_);
+}
+
+size_t ChunkGeometryArena::allocate(BufferRangeAllocator& allocator, GLuint& buffer, GLenum target, size_t elementSize, size_t count) {
+    if (auto offset = allocator.allocate(count)) {
+        return *offset;
+    }
+    size_t oldCapacity = allocator.capacity();
+    size_t newCapacity = std::max(oldCapacity * 2, oldCapacity + count);
+    buffer = growBuffer(buffer, oldCapacity * elementSize, newCapacity * elementSize);
+    allocator.grow(newCapacity);
+
+    // The VAO still points at the old buffer
+    glBindVertexArray(vao_);
+    if (target == GL_ARRAY_BUFFER) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(PackedVertex), (void*)offsetof(PackedVertex, corner));
+        glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(PackedVertex), (void*)offsetof(PackedVertex, tile));
+    } else {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    }
+    glBindVertexArray(0);
+    LOG_INFO("Chunk arena grown to " << newCapacity << (target == GL_ARRAY_BUFFER ? " vertices" : " indices"));
+
+    // The grown tail is one free range, so this can't fail
+    return *allocator.allocate(count);
+}
+
+void ChunkGeometryArena::release(const Entry& entry) {
+    vertices_.free(entry.vertexOffset, entry.vertexReserved);
+    indices_.free(entry.indexOffset, entry.indexReserved);
+}
+
+void ChunkGeometryArena::setOrigin(uint32_t chunkId, const glm::vec3& origin) {
+    const size_t needed = (static_cast<size_t>(chunkId) + 1) * 4;
+    if (origins_.size() < needed) {
+        origins_.resize(needed, 0.0f);
+    }
+    float* slot = &origins_[static_cast<size_t>(chunkId) * 4];
+    slot[0] = origin.x;
+    slot[1] = origin.y;
+    slot[2] = origin.z;
+
+    glBindBuffer(GL_TEXTURE_BUFFER, originBuffer_);
+    if (origins_.size() > originCapacity_) {
+        // Reallocate with room to spare; the texture has to be re-attached to the new storage
+        originCapacity_ = std::max<size_t>(origins_.size() * 2, 4 * 1024);
+        glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(originCapacity_ * sizeof(float)), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, static_cast<GLsizeiptr>(origins_.size() * sizeof(float)), origins_.data());
+        glBindTexture(GL_TEXTURE_BUFFER, originTexture_);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, originBuffer_);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    } else {
+        glBufferSubData(GL_TEXTURE_BUFFER, static_cast<GLintptr>(chunkId) * 4 * sizeof(float), 4 * sizeof(float), slot);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ChunkGeometryArena::upload(const AbsoluteChunkPosition& pos, ChunkMeshGeometry geometry) {
+    if (geometry.format != VertexFormat::Packed) {
+        ChunkMesh::pack(geometry);
+    }
+    const size_t vertexCount = geometry.packedVertices.size();
+    const size_t indexCount = geometry.packedIndices.size();
+    if (vertexCount == 0) {
+        remove(pos);
+        return;
+    }
+
+    auto it = entries_.find(pos);
+    if (it == entries_.end()) {
+        uint32_t chunkId;
+        if (!freeChunkIds_.empty()) {
+            chunkId = freeChunkIds_.back();
+            freeChunkIds_.pop_back();
+        } else {
+            chunkId = nextChunkId_++;
+        }
+        it = entries_.emplace(pos, Entry{chunkId, 0, 0, 0, 0, 0}).first;
+    }
+    Entry& entry = it->second;
+
+    // Reuse the chunk's ranges in place when the new mesh fits
+    if (vertexCount > entry.vertexReserved || indexCount > entry.indexReserved) {
+        release(entry);
+        entry.vertexReserved = roundUpToGranule(vertexCount);
+        entry.indexReserved = roundUpToGranule(indexCount);
+        entry.vertexOffset = allocate(vertices_, vbo_, GL_ARRAY_BUFFER, sizeof(PackedVertex), entry.vertexReserved);
+        entry.indexOffset = allocate(indices_, ebo_, GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t), entry.indexReserved);
+    }
+    entry.indexCount = indexCount;
+
+    for (PackedVertex& vertex : geometry.packedVertices) {
+        vertex.tile |= entry.chunkId << CHUNK_ARENA_TILE_BITS;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(entry.vertexOffset * sizeof(PackedVertex)),
+                    static_cast<GLsizeiptr>(vertexCount * sizeof(PackedVertex)), geometry.packedVertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // Binding the element buffer outside a VAO would change whichever VAO is bound
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo_);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(entry.indexOffset * sizeof(uint16_t)),
+                    static_cast<GLsizeiptr>(indexCount * sizeof(uint16_t)), geometry.packedIndices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    setOrigin(entry.chunkId, geometry.origin);
+    drawListDirty_ = true;
+}
+
+void ChunkGeometryArena::remove(const AbsoluteChunkPosition& pos) {
+    auto it = entries_.find(pos);
+    if (it == entries_.end()) {
+        return;
+    }
+    release(it->second);
+    freeChunkIds_.push_back(it->second.chunkId);
+    entries_.erase(it);
+    drawListDirty_ = true;
+}
+
+void ChunkGeometryArena::draw(GLenum originsTextureUnit, const ChunkSet* visible) {
+    if (entries_.empty()) {
+        return;
+    }
+    if (drawListDirty_ || visible) {
+        counts_.clear();
+        firstIndices_.clear();
+        baseVertices_.clear();
+        for (const auto& [pos, entry] : entries_) {
+            if (visible && !visible->contains(pos)) {
+                continue;
+            }
+            counts_.push_back(static_cast<GLsizei>(entry.indexCount));
+            firstIndices_.push_back(reinterpret_cast<const void*>(entry.indexOffset * sizeof(uint16_t)));
+            // Indices stay chunk-local, so 16 bits is enough however large the arena gets
+            baseVertices_.push_back(static_cast<GLint>(entry.vertexOffset));
+        }
+        // A culled list only holds for this frame
+        drawListDirty_ = visible != nullptr;
+    }
+    if (counts_.empty()) {
+        return;
+    }
+
+    glActiveTexture(originsTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, originTexture_);
+    glBindVertexArray(vao_);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts_.data(), GL_UNSIGNED_SHORT, firstIndices_.data(),
+                                  static_cast<GLsizei>(counts_.size()), baseVertices_.data());
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
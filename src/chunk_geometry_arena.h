@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "buffer_range_allocator.h"
+#include "chunk_mesh.h"
+#include "chunk_pos_hash.h"
+#include "gl_includes.h"
+#include "position.h"
+
+// Starting arena sizes; both grow by doubling when full
+constexpr size_t CHUNK_ARENA_INITIAL_VERTICES = 1 << 20;
+constexpr size_t CHUNK_ARENA_INITIAL_INDICES = 1 << 21;
+// Ranges are reserved in multiples of this, so a remesh that grows a little still fits in place
+constexpr size_t CHUNK_ARENA_RANGE_GRANULE = 256;
+// Chunk ids share PackedVertex::tile with the 10-bit atlas tile index
+constexpr uint32_t CHUNK_ARENA_TILE_BITS = 10;
+
+/**
+ * @brief Packed chunk meshes sub-allocated from one shared vertex buffer and one index buffer,
+ * all drawn with a single glMultiDrawElementsBaseVertex.
+ *
+ * Each chunk gets an id that stays fixed while it is resident, stored in the upper bits of every
+ * vertex's tile word; the shader looks the chunk's origin up by that id in a buffer texture
+ * (sampler `chunkOrigins`). A remesh overwrites the chunk's ranges when the new mesh fits.
+ * Render thread only (owns GL objects).
+ */
+class ChunkGeometryArena {
+public:
+    ChunkGeometryArena(size_t vertexCapacity = CHUNK_ARENA_INITIAL_VERTICES, size_t indexCapacity = CHUNK_ARENA_INITIAL_INDICES);
+    ~ChunkGeometryArena();
+    ChunkGeometryArena(const ChunkGeometryArena&) = delete;
+    ChunkGeometryArena& operator=(const ChunkGeometryArena&) = delete;
+
+    // Stores or replaces the chunk's mesh; geometry must be VertexFormat::Packed
+    void upload(const AbsoluteChunkPosition& pos, ChunkMeshGeometry geometry);
+    void remove(const AbsoluteChunkPosition& pos);
+    bool contains(const AbsoluteChunkPosition& pos) const { return entries_.count(pos) != 0; }
+    size_t size() const { return entries_.size(); }
+
+    // Draws every chunk, or only those in visible; bind the arena shader first. originsTextureUnit is where chunkOrigins is read from.
+    void draw(GLenum originsTextureUnit, const ChunkSet* visible = nullptr);
+
+    size_t vertexCapacity() const { return vertices_.capacity(); }
+    size_t indexCapacity() const { return indices_.capacity(); }
+
+private:
+    struct Entry {
+        uint32_t chunkId;
+        size_t vertexOffset;
+        size_t vertexReserved;
+        size_t indexOffset;
+        size_t indexReserved;
+        size_t indexCount;
+    };
+
+    // Grows the buffer behind allocator to fit count more elements and allocates them
+    size_t allocate(BufferRangeAllocator& allocator, GLuint& buffer, GLenum target, size_t elementSize, size_t count);
+    void release(const Entry& entry);
+    void setOrigin(uint32_t chunkId, const glm::vec3& origin);
+
+    GLuint vao_ = 0;
+    GLuint vbo_ = 0;
+    GLuint ebo_ = 0;
+    GLuint originBuffer_ = 0;
+    GLuint originTexture_ = 0;
+    BufferRangeAllocator vertices_;
+    BufferRangeAllocator indices_;
+
+    std::unordered_map<AbsoluteChunkPosition, Entry, ChunkPosHash, ChunkPosEq> entries_;
+    std::vector<uint32_t> freeChunkIds_;
+    uint32_t nextChunkId_ = 0;
+    // xyz origin (w unused) per chunk id, mirrored into originBuffer_
+    std::vector<float> origins_;
+    size_t originCapacity_ = 0;
+
+    // Draw lists, rebuilt after any upload or removal, and on every culled draw
+    bool drawListDirty_ = true;
+    std::vector<GLsizei> counts_;
+    std::vector<const void*> firstIndices_;
+    std::vector<GLint> baseVertices_;
+};
@@ -0,0 +1,306 @@
+#include "chunk_lod.h"
+#include "chunk_arena.h"
+#include "metrics.h"
+
+#include <algorithm>
+
+namespace {
+
+static_assert(CHUNK_WIDTH == CHUNK_HEIGHT && CHUNK_HEIGHT == CHUNK_DEPTH, "LOD cells assume cubic chunks");
+static_assert((CHUNK_WIDTH >> CHUNK_LOD_LEVELS) >= 1, "every LOD level needs at least one block per chunk");
+
+constexpr size_t STRIDE_Y = CHUNK_WIDTH;
+constexpr size_t STRIDE_Z = CHUNK_WIDTH * CHUNK_HEIGHT;
+constexpr int HALF = CHUNK_WIDTH / 2;
+
+// Shared by every ChunkLodCache in the process; hits() and misses() stay per cache
+struct ChunkLodCacheMetrics {
+    MetricCounter& hits = metricCounter("blocktest_cache_hits_total", "Lookups a cache answered", {{"cache", "chunk_lod"}});
+    MetricCounter& misses = metricCounter("blocktest_cache_misses_total", "Lookups a cache had to compute", {{"cache", "chunk_lod"}});
+    MetricHistogram& buildSeconds = metricHistogram("blocktest_chunk_lod_build_seconds", "Time to downsample and encode one LOD chunk");
+};
+
+ChunkLodCacheMetrics& lodMetrics() {
+    static ChunkLodCacheMetrics metrics;
+    return metrics;
+}
+
+size_t blockIndex(int x, int y, int z) {
+    return static_cast<size_t>(x) + static_cast<size_t>(y) * STRIDE_Y + static_cast<size_t>(z) * STRIDE_Z;
+}
+
+AbsoluteChunkPosition childPosition(const AbsoluteChunkPosition& lodPos, int child) {
+    return AbsoluteChunkPosition(lodPos.x * 2 + (child & 1), lodPos.y * 2 + ((child >> 1) & 1), lodPos.z * 2 + ((child >> 2) & 1));
+}
+
+// The first of the most common values among count (1..4) blocks
+Block mostCommon(const Block* blocks, int count) {
+    Block best = blocks[0];
+    std::ptrdiff_t bestCount = 0;
+    for (int i = 0; i < count; ++i) {
+        const std::ptrdiff_t seen = std::count(blocks, blocks + count, blocks[i]);
+        if (seen > bestCount) {
+            best = blocks[i];
+            bestCount = seen;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+AbsoluteChunkPosition lodPosition(const AbsoluteChunkPosition& pos, uint32_t level) {
+    const int64_t size = int64_t{1} << level;
+    return AbsoluteChunkPosition(static_cast<int32_t>(floor_div(pos.x, size)), static_cast<int32_t>(floor_div(pos.y, size)),
+                                 static_cast<int32_t>(floor_div(pos.z, size)));
+}
+
+AbsoluteChunkPosition lodFirstChunk(const AbsoluteChunkPosition& lodPos, uint32_t level) {
+    return AbsoluteChunkPosition(lodPos.x * (1 << level), lodPos.y * (1 << level), lodPos.z * (1 << level));
+}
+
+AbsoluteChunkPosition lodLastChunk(const AbsoluteChunkPosition& lodPos, uint32_t level) {
+    const AbsoluteChunkPosition first = lodFirstChunk(lodPos, level);
+    const int32_t span = (1 << level) - 1;
+    return AbsoluteChunkPosition(first.x + span, first.y + span, first.z + span);
+}
+
+ChunkSpan downsampleLodChunk(const std::array<const ChunkSpan*, 8>& children, const AbsoluteChunkPosition& lodPos) {
+    std::array<Block, CHUNK_BLOCK_COUNT> out;
+    std::array<Block, CHUNK_BLOCK_COUNT> blocks;
+    for (int child = 0; child < 8; ++child) {
+        const int ox = (child & 1) * HALF;
+        const int oy = ((child >> 1) & 1) * HALF;
+        const int oz = ((child >> 2) & 1) * HALF;
+        const ChunkSpan* source = children[child];
+        // A uniform child's cells are all that block
+        if (!source || source->isUniform()) {
+            const Block fill = source ? source->uniformBlock() : Block::Empty;
+            for (int z = 0; z < HALF; ++z) {
+                for (int y = 0; y < HALF; ++y) {
+                    std::fill_n(out.begin() + blockIndex(ox, oy + y, oz + z), HALF, fill);
+                }
+            }
+            continue;
+        }
+        source->copyTo(blocks);
+        for (int z = 0; z < HALF; ++z) {
+            for (int y = 0; y < HALF; ++y) {
+                for (int x = 0; x < HALF; ++x) {
+                    Block tops[4];
+                    int solidColumns = 0;
+                    for (int dz = 0; dz < 2; ++dz) {
+                        for (int dx = 0; dx < 2; ++dx) {
+                            const Block upper = blocks[blockIndex(2 * x + dx, 2 * y + 1, 2 * z + dz)];
+                            const Block top = upper != Block::Empty ? upper : blocks[blockIndex(2 * x + dx, 2 * y, 2 * z + dz)];
+                            if (top != Block::Empty) {
+                                tops[solidColumns++] = top;
+                            }
+                        }
+                    }
+                    out[blockIndex(ox + x, oy + y, oz + z)] = solidColumns >= 2 ? mostCommon(tops, solidColumns) : Block::Empty;
+                }
+            }
+        }
+    }
+    ChunkSpan result(lodPos);
+    result.assign(out);
+    return result;
+}
+
+bool clearLodChunkBox(ChunkSpan& lod, uint32_t level, const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max) {
+    const AbsoluteChunkPosition first = lodFirstChunk(lod.position, level);
+    const AbsoluteChunkPosition last = lodLastChunk(lod.position, level);
+    // LOD blocks per covered chunk, along each axis
+    const int64_t perChunk = CHUNK_WIDTH >> level;
+    const int64_t mins[3] = {min.x, min.y, min.z};
+    const int64_t maxs[3] = {max.x, max.y, max.z};
+    const int64_t firsts[3] = {first.x, first.y, first.z};
+    const int64_t lasts[3] = {last.x, last.y, last.z};
+    int lo[3];
+    int hi[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        const int64_t from = std::max(mins[axis], firsts[axis]);
+        const int64_t to = std::min(maxs[axis], lasts[axis]);
+        if (from > to) {
+            return false;
+        }
+        lo[axis] = static_cast<int>((from - firsts[axis]) * perChunk);
+        hi[axis] = static_cast<int>((to - firsts[axis] + 1) * perChunk);
+    }
+    if (lod.isEmpty()) {
+        return true;
+    }
+    std::array<Block, CHUNK_BLOCK_COUNT> blocks;
+    lod.copyTo(blocks);
+    for (int z = lo[2]; z < hi[2]; ++z) {
+        for (int y = lo[1]; y < hi[1]; ++y) {
+            std::fill_n(blocks.begin() + blockIndex(lo[0], y, z), hi[0] - lo[0], Block::Empty);
+        }
+    }
+    lod.assign(blocks);
+    return true;
+}
+
+ChunkSpan surfaceLodChunk(
+    const std::function<std::optional<WorldgenSurface>(int64_t worldX, int64_t worldZ)>& surface, uint32_t level,
+    const AbsoluteChunkPosition& lodPos) {
+    ChunkSpan result(lodPos);
+    if (!surface) {
+        return result;
+    }
+    // World blocks per LOD block along each axis
+    const int64_t cell = int64_t{1} << level;
+    const AbsoluteBlockPosition origin = chunkOrigin(lodFirstChunk(lodPos, level));
+    std::array<Block, CHUNK_BLOCK_COUNT> blocks;
+    blocks.fill(Block::Empty);
+    bool solid = false;
+    for (int z = 0; z < CHUNK_DEPTH; ++z) {
+        for (int x = 0; x < CHUNK_WIDTH; ++x) {
+            const auto column = surface(origin.x + x * cell + cell / 2, origin.z + z * cell + cell / 2);
+            if (!column) {
+                continue;
+            }
+            // Cells whose bottom layer is under the surface
+            const int64_t above = column->height - origin.y;
+            const int64_t layers = above <= 0 ? 0 : std::min<int64_t>((above + cell - 1) / cell, CHUNK_HEIGHT);
+            for (int64_t y = 0; y < layers; ++y) {
+                blocks[blockIndex(x, static_cast<int>(y), z)] = column->block;
+            }
+            solid = solid || layers > 0;
+        }
+    }
+    if (solid) {
+        result.assign(blocks);
+    }
+    return result;
+}
+
+ChunkLodCache::ChunkLodCache(ChunkSource source, ResidentProbe resident, SurfaceSampler surface, size_t capacity)
+    : source_(std::move(source)), resident_(std::move(resident)), surface_(std::move(surface)),
+      capacity_(std::max<size_t>(capacity, 1)) {}
+
+std::shared_ptr<const ChunkLodCache::Entry> ChunkLodCache::get(uint32_t level, const AbsoluteChunkPosition& lodPos) {
+    if (level < 1 || level > CHUNK_LOD_LEVELS) {
+        return nullptr;
+    }
+    // What the chunk would be built from now decides whether the cached one is still current
+    const std::shared_ptr<const Entry> cached = lookup(level, lodPos);
+    // With nothing resident under it the chunk comes from the surface, and a cached one stays
+    // current: the chunks unloaded since leave what was built from them
+    const bool surfaceOnly = resident_ && !resident_(lodFirstChunk(lodPos, level), lodLastChunk(lodPos, level));
+    std::array<std::shared_ptr<const ChunkSpan>, 8> children;
+    std::array<std::uint64_t, 8> sources{};
+    bool current = cached != nullptr;
+    for (int child = 0; !surfaceOnly && child < 8; ++child) {
+        const AbsoluteChunkPosition pos = childPosition(lodPos, child);
+        if (level == 1) {
+            children[child] = source_ ? source_(pos) : nullptr;
+            sources[child] = children[child] ? children[child]->version() + 1 : 0;
+            // A chunk that is no longer resident leaves what was built from it
+            current = current && (sources[child] == 0 || sources[child] == cached->sources[child]);
+        } else {
+            auto lower = get(level - 1, pos);
+            children[child] = lower->chunk;
+            sources[child] = lower->version;
+            current = current && sources[child] == cached->sources[child];
+        }
+    }
+    ChunkLodCacheMetrics& metrics = lodMetrics();
+    if (current) {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        metrics.hits.add();
+        return cached;
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    metrics.misses.add();
+
+    std::shared_ptr<const Entry> built;
+    {
+        ScopedMetricTimer timer(metrics.buildSeconds);
+        std::shared_ptr<ChunkSpan> chunk;
+        if (surfaceOnly) {
+            chunk = makePooledChunk(surfaceLodChunk(surface_, level, lodPos));
+        } else {
+            std::array<const ChunkSpan*, 8> inputs;
+            for (int child = 0; child < 8; ++child) {
+                if (level == 1 && !children[child]) {
+                    children[child] = surfaceChunk(childPosition(lodPos, child));
+                }
+                inputs[child] = children[child].get();
+            }
+            chunk = makePooledChunk(downsampleLodChunk(inputs, lodPos));
+        }
+        auto serialized = chunk->serialize();
+        built = std::make_shared<const Entry>(Entry{
+            chunk, chunk->contentHash(), std::string(serialized.begin(), serialized.end()), sources});
+    }
+    store(level, lodPos, built);
+    return built;
+}
+
+std::shared_ptr<const ChunkLodCache::Entry> ChunkLodCache::lookup(uint32_t level, const AbsoluteChunkPosition& lodPos) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Level& cache = levels_[level - 1];
+    auto it = cache.index.find(lodPos);
+    if (it == cache.index.end()) {
+        return nullptr;
+    }
+    cache.lru.splice(cache.lru.begin(), cache.lru, it->second);
+    return it->second->second;
+}
+
+void ChunkLodCache::store(uint32_t level, const AbsoluteChunkPosition& lodPos, const std::shared_ptr<const Entry>& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Level& cache = levels_[level - 1];
+    auto it = cache.index.find(lodPos);
+    if (it != cache.index.end()) {
+        it->second->second = entry;
+        cache.lru.splice(cache.lru.begin(), cache.lru, it->second);
+        return;
+    }
+    cache.lru.emplace_front(lodPos, entry);
+    cache.index.emplace(lodPos, cache.lru.begin());
+    if (cache.lru.size() > capacity_) {
+        cache.index.erase(cache.lru.back().first);
+        cache.lru.pop_back();
+    }
+}
+
+std::shared_ptr<const ChunkSpan> ChunkLodCache::surfaceChunk(const AbsoluteChunkPosition& pos) const {
+    if (!surface_) {
+        return nullptr;
+    }
+    const AbsoluteBlockPosition origin = chunkOrigin(pos);
+    std::array<Block, CHUNK_BLOCK_COUNT> blocks;
+    blocks.fill(Block::Empty);
+    bool solid = false;
+    for (int z = 0; z < CHUNK_DEPTH; ++z) {
+        for (int x = 0; x < CHUNK_WIDTH; ++x) {
+            const auto column = surface_(origin.x + x, origin.z + z);
+            if (!column) {
+                continue;
+            }
+            const int64_t layers = std::clamp<int64_t>(column->height - origin.y, 0, CHUNK_HEIGHT);
+            for (int64_t y = 0; y < layers; ++y) {
+                blocks[blockIndex(x, static_cast<int>(y), z)] = column->block;
+            }
+            solid = solid || layers > 0;
+        }
+    }
+    if (!solid) {
+        return nullptr;
+    }
+    auto chunk = makePooledChunk(pos);
+    chunk->assign(blocks);
+    return chunk;
+}
+
+size_t ChunkLodCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t total = 0;
+    for (const Level& level : levels_) {
+        total += level.lru.size();
+    }
+    return total;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "chunk_pos_hash.h"
+#include "chunkspan.h"
+#include "position.h"
+#include "world.h"
+
+/*
+ * Level-of-detail chunks are ordinary ChunkSpans in a coarser grid. The level L chunk at (x, y, z)
+ * covers chunks x * 2^L .. (x + 1) * 2^L - 1 on every axis, each of its blocks standing for a cube
+ * of 2^L blocks, and its position is in that grid. They are served, cached and meshed like full
+ * chunks, so a far ring costs one chunk per 2^L x 2^L x 2^L chunks.
+ */
+
+// Levels above full chunks: 1, 2 and 3 cover 2, 4 and 8 chunks per axis
+constexpr uint32_t CHUNK_LOD_LEVELS = 3;
+// Each level is drawn as a ring of its chunks this far from the viewer's horizontally, and one up
+// and down, leaving a hole where the finer ring is
+constexpr int32_t CHUNK_LOD_RING_RADIUS = 3;
+constexpr size_t CHUNK_LOD_RING_CHUNKS = (2 * CHUNK_LOD_RING_RADIUS + 1) * (2 * CHUNK_LOD_RING_RADIUS + 1) * 3;
+// Views whose rings a ChunkLodCache keeps at once, along with the finer chunks each ring chunk
+// over resident chunks is rebuilt from
+constexpr size_t CHUNK_LOD_CACHED_VIEWS = 4;
+// LOD chunks kept per level by a ChunkLodCache
+constexpr size_t CHUNK_LOD_CACHE_DEFAULT_CAPACITY = CHUNK_LOD_RING_CHUNKS * 9 * CHUNK_LOD_CACHED_VIEWS;
+
+// The level L chunk covering chunk pos
+AbsoluteChunkPosition lodPosition(const AbsoluteChunkPosition& pos, uint32_t level);
+// The first and last chunk the level L chunk at lodPos covers, on every axis
+AbsoluteChunkPosition lodFirstChunk(const AbsoluteChunkPosition& lodPos, uint32_t level);
+AbsoluteChunkPosition lodLastChunk(const AbsoluteChunkPosition& lodPos, uint32_t level);
+
+/**
+ * @brief Builds a chunk of the next level up from the eight below it, indexed dx + dy * 2 + dz * 4
+ * by their offset inside it; null children count as all Empty. Each 2x2x2 cell becomes one block:
+ * solid when at least half of its four columns hold a block, taking the most common of the
+ * columns' top blocks. That keeps thin floors and the terrain's surface blocks, and drops thin
+ * pillars and holes.
+ */
+ChunkSpan downsampleLodChunk(const std::array<const ChunkSpan*, 8>& children, const AbsoluteChunkPosition& lodPos);
+
+/**
+ * @brief Empties the blocks of a level L chunk that stand for chunks min..max (inclusive), where a
+ * finer ring is drawn instead. Whatever faces the hole is then meshed as a wall, hiding the seam.
+ * @return False when the box misses the chunk, which is left as it was.
+ */
+bool clearLodChunkBox(ChunkSpan& lod, uint32_t level, const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max);
+
+/**
+ * @brief Builds a level L chunk straight from the generator's surface, one sample per LOD column
+ * at its centre: a cell is solid, of the column's block, where the surface is above its bottom.
+ * Matches downsampling the surface chunk by chunk but for the sampling, at a 4^L-th of the calls.
+ * A null sampler gives an Empty chunk.
+ */
+ChunkSpan surfaceLodChunk(
+    const std::function<std::optional<WorldgenSurface>(int64_t worldX, int64_t worldZ)>& surface, uint32_t level,
+    const AbsoluteChunkPosition& lodPos);
+
+/**
+ * @brief Builds LOD chunks on request and keeps them, LRU-bounded per level, with their encoding.
+ *
+ * Where the probe finds no resident chunk under an LOD chunk it is built straight from the
+ * generator's surface (see surfaceLodChunk). Otherwise level 1 chunks are downsampled from the
+ * resident chunks the source returns, and where one isn't resident from the generator's surface;
+ * higher levels from the level below, probing each child in turn. Every lookup first
+ * checks what the entry was built from, so edits need no invalidation: a changed chunk version
+ * (or a child LOD that changed) rebuilds it on the next request. A chunk that has been unloaded
+ * leaves its last contents in place. The version handed out is the content hash, so a rebuild with
+ * the same result, e.g. after eviction, doesn't make clients refetch unchanged chunks.
+ *
+ * Safe to use from any thread; builds run without holding the lock, and two threads rebuilding the
+ * same chunk both do the work.
+ */
+class ChunkLodCache {
+public:
+    struct Entry {
+        // Position in the level's grid
+        std::shared_ptr<const ChunkSpan> chunk;
+        // chunk->contentHash(); never 0
+        std::uint64_t version;
+        std::string bytes; // serialized chunk, ready for a protobuf bytes field
+        // By child index: at level 1 each resident chunk's version + 1 (0 where the surface stood
+        // in), above that each child's LOD version; all 0 when built straight from the surface
+        std::array<std::uint64_t, 8> sources;
+    };
+    // The resident chunk at a position, or null
+    using ChunkSource = std::function<std::shared_ptr<const ChunkSpan>(const AbsoluteChunkPosition&)>;
+    // Whether any chunk in min..max (inclusive) is resident; null treats every box as resident
+    using ResidentProbe = std::function<bool(const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max)>;
+    using SurfaceSampler = std::function<std::optional<WorldgenSurface>(int64_t worldX, int64_t worldZ)>;
+
+    ChunkLodCache(ChunkSource source, ResidentProbe resident, SurfaceSampler surface,
+                  size_t capacity = CHUNK_LOD_CACHE_DEFAULT_CAPACITY);
+    ChunkLodCache(const ChunkLodCache&) = delete;
+    ChunkLodCache& operator=(const ChunkLodCache&) = delete;
+
+    // The chunk at lodPos of level 1..CHUNK_LOD_LEVELS, current with what is resident under it
+    std::shared_ptr<const Entry> get(uint32_t level, const AbsoluteChunkPosition& lodPos);
+
+    // Entries cached over every level
+    size_t size() const;
+    size_t capacity() const { return capacity_; }
+    size_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    size_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    struct Level {
+        // Most recently used first
+        std::list<std::pair<AbsoluteChunkPosition, std::shared_ptr<const Entry>>> lru;
+        ChunkPosMap<decltype(lru)::iterator> index;
+    };
+
+    std::shared_ptr<const Entry> lookup(uint32_t level, const AbsoluteChunkPosition& lodPos);
+    void store(uint32_t level, const AbsoluteChunkPosition& lodPos, const std::shared_ptr<const Entry>& entry);
+    // The generator's surface filled into a full chunk, for an absent level 1 child
+    std::shared_ptr<const ChunkSpan> surfaceChunk(const AbsoluteChunkPosition& pos) const;
+
+    const ChunkSource source_;
+    const ResidentProbe resident_;
+    const SurfaceSampler surface_;
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    std::array<Level, CHUNK_LOD_LEVELS> levels_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+};
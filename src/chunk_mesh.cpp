@@ -1,17 +1,119 @@
 #include "chunk_mesh.h"
 
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Corners of each face around a block centre (front, back, left, right, top, bottom), counter-clockwise
+const glm::vec3 FACE_POSITIONS[6][4] = {
+    // Front face (z+)
+    {{-0.5f, -0.5f,  0.5f}, { 0.5f, -0.5f,  0.5f}, { 0.5f,  0.5f,  0.5f}, {-0.5f,  0.5f,  0.5f}},
+    // Back face (z-)
+    {{ 0.5f, -0.5f, -0.5f}, {-0.5f, -0.5f, -0.5f}, {-0.5f,  0.5f, -0.5f}, { 0.5f,  0.5f, -0.5f}},
+    // Left face (x-)
+    {{-0.5f, -0.5f, -0.5f}, {-0.5f, -0.5f,  0.5f}, {-0.5f,  0.5f,  0.5f}, {-0.5f,  0.5f, -0.5f}},
+    // Right face (x+)
+    {{ 0.5f, -0.5f,  0.5f}, { 0.5f, -0.5f, -0.5f}, { 0.5f,  0.5f, -0.5f}, { 0.5f,  0.5f,  0.5f}},
+    // Top face (y+)
+    {{-0.5f,  0.5f,  0.5f}, { 0.5f,  0.5f,  0.5f}, { 0.5f,  0.5f, -0.5f}, {-0.5f,  0.5f, -0.5f}},
+    // Bottom face (y-)
+    {{-0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f,  0.5f}, {-0.5f, -0.5f,  0.5f}}
+};
+
+const glm::vec3 FACE_NORMALS[6] = {
+    { 0.0f,  0.0f,  1.0f}, // Front
+    { 0.0f,  0.0f, -1.0f}, // Back
+    {-1.0f,  0.0f,  0.0f}, // Left
+    { 1.0f,  0.0f,  0.0f}, // Right
+    { 0.0f,  1.0f,  0.0f}, // Top
+    { 0.0f, -1.0f,  0.0f}  // Bottom
+};
+
+// Axes (0=x, 1=y, 2=z) of each face: its normal, the texture's u (corner 0 to 1) and v (corner 1 to 2)
+struct FaceAxes {
+    int normal;
+    int u;
+    int v;
+};
+
+const FaceAxes FACE_AXES[6] = {
+    {2, 0, 1}, // Front
+    {2, 0, 1}, // Back
+    {0, 2, 1}, // Left
+    {0, 2, 1}, // Right
+    {1, 0, 2}, // Top
+    {1, 0, 2}  // Bottom
+};
+
+// Step from a block to its neighbour across each face
+const int FACE_STEPS[6][3] = {
+    { 0,  0,  1}, // Front
+    { 0,  0, -1}, // Back
+    {-1,  0,  0}, // Left
+    { 1,  0,  0}, // Right
+    { 0,  1,  0}, // Top
+    { 0, -1,  0}  // Bottom
+};
+
+bool isTransparent(Block block) {
+    return block == Block::Empty || block == Block::Air;
+}
+
+} // namespace
+
 ChunkMesh::ChunkMesh() : VAO(0), VBO(0), EBO(0) {}
 
 ChunkMesh::~ChunkMesh() {
     cleanup();
 }
 
-void ChunkMesh::buildMesh(const std::vector<Block>& chunkData, const glm::vec3& chunkPosition) {
-    vertices.clear();
-    indices.clear();
-    
-    unsigned int vertexOffset = 0;
-    
+AbsoluteChunkPosition ChunkNeighbours::positionOf(const AbsoluteChunkPosition& pos, int face) {
+    return AbsoluteChunkPosition(pos.x + FACE_STEPS[face][0], pos.y + FACE_STEPS[face][1], pos.z + FACE_STEPS[face][2]);
+}
+
+void ChunkMesh::buildGeometry(ChunkBlocks blocks, const glm::vec3& chunkPosition, MeshingMode mode, const ChunkNeighbours& neighbours, ChunkMeshScratch& scratch, ChunkMeshGeometry& out) {
+    out.format = VertexFormat::Full;
+    out.origin = chunkPosition;
+    out.vertices.clear();
+    out.indices.clear();
+    out.packedVertices.clear();
+    out.packedIndices.clear();
+    out.faceConnectivity = computeChunkFaceConnectivity(blocks, scratch.visited, scratch.stack);
+    if (mode == MeshingMode::Greedy) {
+        buildGreedy(out, blocks, chunkPosition, neighbours, scratch.mask);
+    } else {
+        buildNaive(out, blocks, chunkPosition, neighbours);
+    }
+}
+
+void ChunkMesh::buildGeometry(const ChunkSpan& chunk, MeshingMode mode, const ChunkNeighbours& neighbours, ChunkMeshScratch& scratch, ChunkMeshGeometry& out) {
+    const AbsoluteChunkPosition& pos = chunk.position;
+    glm::vec3 origin(pos.x * CHUNK_WIDTH, pos.y * CHUNK_HEIGHT, pos.z * CHUNK_DEPTH);
+    if (chunk.isEmpty() || (chunk.isUniform() && isTransparent(chunk.uniformBlock()))) {
+        // Nothing to draw and nothing to block the view, known without expanding the chunk
+        out.format = VertexFormat::Full;
+        out.origin = origin;
+        out.vertices.clear();
+        out.indices.clear();
+        out.packedVertices.clear();
+        out.packedIndices.clear();
+        out.faceConnectivity = CHUNK_FACES_ALL_CONNECTED;
+        return;
+    }
+    scratch.blocks.resize(CHUNK_BLOCK_COUNT);
+    chunk.copyTo(std::span<Block, CHUNK_BLOCK_COUNT>(scratch.blocks.data(), CHUNK_BLOCK_COUNT));
+    buildGeometry(ChunkBlocks(scratch.blocks.data(), CHUNK_BLOCK_COUNT), origin, mode, neighbours, scratch, out);
+}
+
+ChunkMeshGeometry ChunkMesh::buildGeometry(const std::vector<Block>& chunkData, const glm::vec3& chunkPosition, MeshingMode mode, const ChunkNeighbours& neighbours) {
+    ChunkMeshScratch scratch;
+    ChunkMeshGeometry geometry;
+    buildGeometry(ChunkBlocks(chunkData.data(), CHUNK_BLOCK_COUNT), chunkPosition, mode, neighbours, scratch, geometry);
+    return geometry;
+}
+
+void ChunkMesh::buildNaive(ChunkMeshGeometry& geometry, ChunkBlocks chunkData, const glm::vec3& chunkPosition, const ChunkNeighbours& neighbours) {
     // Iterate through all blocks in the chunk
     for (int x = 0; x < CHUNK_WIDTH; ++x) {
         for (int y = 0; y < CHUNK_HEIGHT; ++y) {
@@ -20,7 +122,7 @@ void ChunkMesh::buildMesh(const std::vector<Block>& chunkData, const glm::vec3&
                 Block blockType = chunkData[blockIndex];
                 
                 // Skip empty/air blocks
-                if (blockType == Block::Empty || blockType == Block::Air) {
+                if (isTransparent(blockType)) {
                     continue;
                 }
                 
@@ -28,38 +130,143 @@ void ChunkMesh::buildMesh(const std::vector<Block>& chunkData, const glm::vec3&
                 
                 // Check each face and add if it should be rendered
                 for (int face = 0; face < 6; ++face) {
-                    if (shouldRenderFace(chunkData, x, y, z, face)) {
-                        addBlockFace(blockType, blockPosition, face);
-                        
-                        // Add indices for this face (2 triangles = 6 indices)
-                        indices.push_back(vertexOffset + 0);
-                        indices.push_back(vertexOffset + 1);
-                        indices.push_back(vertexOffset + 2);
-                        indices.push_back(vertexOffset + 2);
-                        indices.push_back(vertexOffset + 3);
-                        indices.push_back(vertexOffset + 0);
-                        
-                        vertexOffset += 4;
+                    if (shouldRenderFace(chunkData, neighbours, x, y, z, face)) {
+                        addBlockFace(geometry, blockType, blockPosition, face);
+                        addFaceIndices(geometry);
                     }
                 }
             }
         }
     }
+}
+
+void ChunkMesh::buildGreedy(ChunkMeshGeometry& geometry, ChunkBlocks chunkData, const glm::vec3& chunkPosition, const ChunkNeighbours& neighbours, std::vector<Block>& mask) {
+    const int dims[3] = {CHUNK_WIDTH, CHUNK_HEIGHT, CHUNK_DEPTH};
     
+    for (int face = 0; face < 6; ++face) {
+        const FaceAxes& axes = FACE_AXES[face];
+        const int width = dims[axes.u];
+        const int height = dims[axes.v];
+        mask.assign(static_cast<size_t>(width) * height, Block::Empty);
+        
+        for (int slice = 0; slice < dims[axes.normal]; ++slice) {
+            // Which block, if any, shows this face at each cell of the plane
+            int cell[3];
+            cell[axes.normal] = slice;
+            for (int b = 0; b < height; ++b) {
+                for (int a = 0; a < width; ++a) {
+                    cell[axes.u] = a;
+                    cell[axes.v] = b;
+                    Block blockType = chunkData[getBlockIndex(cell[0], cell[1], cell[2])];
+                    bool visible = !isTransparent(blockType) && shouldRenderFace(chunkData, neighbours, cell[0], cell[1], cell[2], face);
+                    mask[a + b * width] = visible ? blockType : Block::Empty;
+                }
+            }
+            
+            // Grow each unclaimed cell into the widest run, then as many rows of that run as match
+            for (int b = 0; b < height; ++b) {
+                for (int a = 0; a < width;) {
+                    Block blockType = mask[a + b * width];
+                    if (blockType == Block::Empty) {
+                        ++a;
+                        continue;
+                    }
+                    int runWidth = 1;
+                    while (a + runWidth < width && mask[a + runWidth + b * width] == blockType) {
+                        ++runWidth;
+                    }
+                    int runHeight = 1;
+                    for (; b + runHeight < height; ++runHeight) {
+                        const Block* row = &mask[a + (b + runHeight) * width];
+                        if (!std::all_of(row, row + runWidth, [&](Block other) { return other == blockType; })) {
+                            break;
+                        }
+                    }
+                    for (int dy = 0; dy < runHeight; ++dy) {
+                        std::fill_n(&mask[a + (b + dy) * width], runWidth, Block::Empty);
+                    }
+                    
+                    int lo[3];
+                    int hi[3];
+                    lo[axes.normal] = hi[axes.normal] = slice;
+                    lo[axes.u] = a;
+                    hi[axes.u] = a + runWidth - 1;
+                    lo[axes.v] = b;
+                    hi[axes.v] = b + runHeight - 1;
+                    addMergedFace(geometry, blockType, chunkPosition, lo, hi, face);
+                    addFaceIndices(geometry);
+                    a += runWidth;
+                }
+            }
+        }
+    }
+}
+
+void ChunkMesh::pack(ChunkMeshGeometry& geometry) {
+    if (geometry.format == VertexFormat::Packed) {
+        return;
+    }
+    auto bits = [](float value) { return static_cast<uint32_t>(std::lround(value)); };
+    geometry.packedVertices.clear();
+    geometry.packedVertices.reserve(geometry.vertices.size());
+    for (const Vertex& v : geometry.vertices) {
+        // Blocks are centred on integer positions, so corners sit half a block off them
+        glm::vec3 local = v.position - geometry.origin + glm::vec3(0.5f);
+        uint32_t face = 0;
+        while (face < 5 && !(FACE_NORMALS[face] == v.normal)) {
+            ++face;
+        }
+        PackedVertex packed;
+        packed.corner = bits(local.x) | bits(local.y) << 5 | bits(local.z) << 10 | face << 15 |
+                        bits(v.texCoord.x) << 18 | bits(v.texCoord.y) << 23;
+        packed.tile = bits(v.tile.y * BLOCKS_PER_ROW) * BLOCKS_PER_ROW + bits(v.tile.x * BLOCKS_PER_ROW);
+        geometry.packedVertices.push_back(packed);
+    }
+    geometry.packedIndices.assign(geometry.indices.begin(), geometry.indices.end());
+    geometry.vertices.clear();
+    geometry.indices.clear();
+    geometry.format = VertexFormat::Packed;
+}
+
+void ChunkMesh::scaleToLod(ChunkMeshGeometry& geometry, uint32_t level) {
+    if (geometry.format != VertexFormat::Full || level == 0) {
+        return;
+    }
+    const float scale = static_cast<float>(1u << level);
+    for (Vertex& v : geometry.vertices) {
+        // Corners sit half a block off the integer block centres, in both the coarse and the world grid
+        v.position = (v.position + glm::vec3(0.5f)) * scale - glm::vec3(0.5f);
+        // One texture tile per world block, as on full chunks
+        v.texCoord *= scale;
+    }
+    geometry.origin *= scale;
+}
+
+void ChunkMesh::upload(ChunkMeshGeometry built) {
+    cleanup();
+    geometry = std::move(built);
     setupMesh();
 }
 
+void ChunkMesh::buildMesh(const std::vector<Block>& chunkData, const glm::vec3& chunkPosition, MeshingMode mode) {
+    upload(buildGeometry(chunkData, chunkPosition, mode));
+}
+
 void ChunkMesh::render() {
     if (isEmpty()) return;
     
     glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+    if (geometry.format == VertexFormat::Packed) {
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(geometry.packedIndices.size()), GL_UNSIGNED_SHORT, 0);
+    } else {
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(geometry.indices.size()), GL_UNSIGNED_INT, 0);
+    }
     glBindVertexArray(0);
 }
 
-void ChunkMesh::update(const std::vector<Block>& chunkData, const glm::vec3& chunkPosition) {
+void ChunkMesh::update(const std::vector<Block>& chunkData, const glm::vec3& chunkPosition, MeshingMode mode) {
     cleanup();
-    buildMesh(chunkData, chunkPosition);
+    buildMesh(chunkData, chunkPosition, mode);
 }
 
 void ChunkMesh::cleanup() {
@@ -72,7 +279,7 @@ void ChunkMesh::cleanup() {
 }
 
 void ChunkMesh::setupMesh() {
-    if (vertices.empty()) return;
+    if (isEmpty()) return;
     
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
@@ -80,11 +287,30 @@ void ChunkMesh::setupMesh() {
     
     glBindVertexArray(VAO);
     
+    if (geometry.format == VertexFormat::Packed) {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, geometry.packedVertices.size() * sizeof(PackedVertex), geometry.packedVertices.data(), GL_STATIC_DRAW);
+        
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, geometry.packedIndices.size() * sizeof(uint16_t), geometry.packedIndices.data(), GL_STATIC_DRAW);
+        
+        // Packed corner, face and repeat attribute
+        glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(PackedVertex), (void*)offsetof(PackedVertex, corner));
+        glEnableVertexAttribArray(0);
+        
+        // Atlas tile index attribute
+        glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(PackedVertex), (void*)offsetof(PackedVertex, tile));
+        glEnableVertexAttribArray(1);
+        
+        glBindVertexArray(0);
+        return;
+    }
+    
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, geometry.vertices.size() * sizeof(Vertex), geometry.vertices.data(), GL_STATIC_DRAW);
     
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, geometry.indices.size() * sizeof(unsigned int), geometry.indices.data(), GL_STATIC_DRAW);
     
     // Position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
@@ -98,76 +324,88 @@ void ChunkMesh::setupMesh() {
     glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
     glEnableVertexAttribArray(2);
     
+    // Atlas tile attribute
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tile));
+    glEnableVertexAttribArray(3);
+    
     glBindVertexArray(0);
 }
 
-bool ChunkMesh::shouldRenderFace(const std::vector<Block>& chunkData, int x, int y, int z, int face) {
+bool ChunkMesh::shouldRenderFace(ChunkBlocks chunkData, const ChunkNeighbours& neighbours, int x, int y, int z, int face) {
     // Face directions: 0=front, 1=back, 2=left, 3=right, 4=top, 5=bottom
-    int nx = x, ny = y, nz = z;
-    
-    switch (face) {
-        case 0: nz++; break; // Front
-        case 1: nz--; break; // Back
-        case 2: nx--; break; // Left
-        case 3: nx++; break; // Right
-        case 4: ny++; break; // Top
-        case 5: ny--; break; // Bottom
-    }
+    int nx = x + FACE_STEPS[face][0];
+    int ny = y + FACE_STEPS[face][1];
+    int nz = z + FACE_STEPS[face][2];
     
-    // If neighbor is outside chunk bounds, render the face
+    // If neighbor is outside chunk bounds, look in the chunk on that side; render the face if it isn't loaded
     if (nx < 0 || nx >= CHUNK_WIDTH || 
         ny < 0 || ny >= CHUNK_HEIGHT || 
         nz < 0 || nz >= CHUNK_DEPTH) {
-        return true;
+        const auto& neighbour = neighbours.faces[face];
+        if (!neighbour) {
+            return true;
+        }
+        ChunkLocalPosition across(
+            static_cast<uint32_t>((nx + CHUNK_WIDTH) % CHUNK_WIDTH),
+            static_cast<uint32_t>((ny + CHUNK_HEIGHT) % CHUNK_HEIGHT),
+            static_cast<uint32_t>((nz + CHUNK_DEPTH) % CHUNK_DEPTH));
+        return isTransparent(neighbour->getBlock(across));
     }
     
     // Check if neighbor block is transparent
     int neighborIndex = getBlockIndex(nx, ny, nz);
     Block neighborBlock = chunkData[neighborIndex];
     
-    return (neighborBlock == Block::Empty || neighborBlock == Block::Air);
+    return isTransparent(neighborBlock);
 }
 
-glm::vec3 ChunkMesh::getBlockPosition(int x, int y, int z) const {
+glm::vec3 ChunkMesh::getBlockPosition(int x, int y, int z) {
     return glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
 }
 
-int ChunkMesh::getBlockIndex(int x, int y, int z) const {
+int ChunkMesh::getBlockIndex(int x, int y, int z) {
     // Standard Minecraft-like layout: x + y * CHUNK_WIDTH + z * CHUNK_WIDTH * CHUNK_HEIGHT
     return x + y * CHUNK_WIDTH + z * CHUNK_WIDTH * CHUNK_HEIGHT;
 }
 
-void ChunkMesh::addBlockFace(Block blockType, const glm::vec3& position, int face) {
-    // Face positions and normals
-    glm::vec3 facePositions[6][4] = {
-        // Front face (z+)
-        {{-0.5f, -0.5f,  0.5f}, { 0.5f, -0.5f,  0.5f}, { 0.5f,  0.5f,  0.5f}, {-0.5f,  0.5f,  0.5f}},
-        // Back face (z-)
-        {{ 0.5f, -0.5f, -0.5f}, {-0.5f, -0.5f, -0.5f}, {-0.5f,  0.5f, -0.5f}, { 0.5f,  0.5f, -0.5f}},
-        // Left face (x-)
-        {{-0.5f, -0.5f, -0.5f}, {-0.5f, -0.5f,  0.5f}, {-0.5f,  0.5f,  0.5f}, {-0.5f,  0.5f, -0.5f}},
-        // Right face (x+)
-        {{ 0.5f, -0.5f,  0.5f}, { 0.5f, -0.5f, -0.5f}, { 0.5f,  0.5f, -0.5f}, { 0.5f,  0.5f,  0.5f}},
-        // Top face (y+)
-        {{-0.5f,  0.5f,  0.5f}, { 0.5f,  0.5f,  0.5f}, { 0.5f,  0.5f, -0.5f}, {-0.5f,  0.5f, -0.5f}},
-        // Bottom face (y-)
-        {{-0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f,  0.5f}, {-0.5f, -0.5f,  0.5f}}
-    };
-    
-    glm::vec3 faceNormals[6] = {
-        { 0.0f,  0.0f,  1.0f}, // Front
-        { 0.0f,  0.0f, -1.0f}, // Back
-        {-1.0f,  0.0f,  0.0f}, // Left
-        { 1.0f,  0.0f,  0.0f}, // Right
-        { 0.0f,  1.0f,  0.0f}, // Top
-        { 0.0f, -1.0f,  0.0f}  // Bottom
-    };
-    
+void ChunkMesh::addBlockFace(ChunkMeshGeometry& geometry, Block blockType, const glm::vec3& position, int face) {
+    for (int vertex = 0; vertex < 4; ++vertex) {
+        Vertex v;
+        v.position = position + FACE_POSITIONS[face][vertex];
+        v.normal = FACE_NORMALS[face];
+        v.texCoord = BlockRenderer::getTileCorner(vertex);
+        v.tile = BlockRenderer::getTileOrigin(blockType);
+        geometry.vertices.push_back(v);
+    }
+}
+
+void ChunkMesh::addMergedFace(ChunkMeshGeometry& geometry, Block blockType, const glm::vec3& chunkPosition, const int lo[3], const int hi[3], int face) {
+    const FaceAxes& axes = FACE_AXES[face];
+    // The texture repeats once per block along each side
+    const float repeatU = static_cast<float>(hi[axes.u] - lo[axes.u] + 1);
+    const float repeatV = static_cast<float>(hi[axes.v] - lo[axes.v] + 1);
     for (int vertex = 0; vertex < 4; ++vertex) {
+        const glm::vec3& offset = FACE_POSITIONS[face][vertex];
+        // Each corner sits on the low or high edge of the rectangle, as it does on a single block
+        glm::vec3 corner(
+            static_cast<float>(offset.x < 0.0f ? lo[0] : hi[0]) + offset.x,
+            static_cast<float>(offset.y < 0.0f ? lo[1] : hi[1]) + offset.y,
+            static_cast<float>(offset.z < 0.0f ? lo[2] : hi[2]) + offset.z);
+        glm::vec2 uv = BlockRenderer::getTileCorner(vertex);
+        
         Vertex v;
-        v.position = position + facePositions[face][vertex];
-        v.normal = faceNormals[face];
-        v.texCoord = BlockRenderer::getTextureUV(blockType, face, vertex);
-        vertices.push_back(v);
+        v.position = chunkPosition + corner;
+        v.normal = FACE_NORMALS[face];
+        v.texCoord = glm::vec2(uv.x * repeatU, uv.y * repeatV);
+        v.tile = BlockRenderer::getTileOrigin(blockType);
+        geometry.vertices.push_back(v);
     }
-}
\ No newline at end of file
+}
+
+void ChunkMesh::addFaceIndices(ChunkMeshGeometry& geometry) {
+    // 2 triangles over the 4 vertices just added
+    const auto base = static_cast<unsigned int>(geometry.vertices.size() - 4);
+    for (unsigned int corner : {0u, 1u, 2u, 2u, 3u, 0u}) {
+        geometry.indices.push_back(base + corner);
+    }
+}
@@ -1,31 +1,145 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
 #include <vector>
 #include "block.h"
 #include "block_renderer.h"
+#include "chunk_culling.h"
 #include "chunkdims.h"
+#include "chunkspan.h"
+#include "position.h"
+
+enum class MeshingMode {
+    // One quad per visible block face
+    Naive,
+    // Visible faces of the same block in the same plane merged into as few rectangles as possible
+    Greedy,
+};
+
+/**
+ * @brief The chunks touching each face of the chunk being meshed, indexed by face
+ * (0=front z+, 1=back z-, 2=left x-, 3=right x+, 4=top y+, 5=bottom y-).
+ * A border face is drawn only if the block beyond it is transparent; when that neighbour
+ * is missing (null) border faces are drawn, and the chunk should be remeshed once it arrives.
+ */
+struct ChunkNeighbours {
+    std::array<std::shared_ptr<const ChunkSpan>, 6> faces;
+    
+    static AbsoluteChunkPosition positionOf(const AbsoluteChunkPosition& pos, int face);
+};
+
+enum class VertexFormat {
+    // Vertex (40 bytes) with 32-bit indices; drawn with the world-space block shader
+    Full,
+    // PackedVertex (8 bytes) with 16-bit indices; drawn with the packed chunk shader
+    Packed,
+};
+
+/**
+ * @brief 8-byte chunk mesh vertex, unpacked by the packed chunk shader.
+ *
+ * corner bits 0-4, 5-9, 10-14: x, y, z of the block corner, 0..16 from the chunk's low corner;
+ * bits 15-17: face (the ChunkNeighbours order, selects the normal); bits 18-22, 23-27: u, v in
+ * tiles. tile bits 0-9: the atlas tile index, row * BLOCKS_PER_ROW + column; pack() leaves the
+ * rest zero and ChunkGeometryArena stores its chunk id there.
+ */
+struct PackedVertex {
+    uint32_t corner;
+    uint32_t tile;
+};
+static_assert(sizeof(PackedVertex) == 8, "PackedVertex must stay 8 bytes");
+// Even a checkerboard chunk, the worst case, stays within 16-bit indices
+static_assert(CHUNK_BLOCK_COUNT / 2 * 6 * 4 <= 65536, "chunk meshes need 16-bit indices");
+
+// Vertex and index data of one chunk mesh, before it is uploaded; only the format's arrays are filled
+struct ChunkMeshGeometry {
+    VertexFormat format = VertexFormat::Full;
+    // World position of block (0, 0, 0) of the chunk
+    glm::vec3 origin{0.0f};
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<PackedVertex> packedVertices;
+    std::vector<uint16_t> packedIndices;
+    // Which faces the chunk's see-through blocks join, for cave culling
+    ChunkFaceConnectivity faceConnectivity = CHUNK_FACES_ALL_CONNECTED;
+    
+    // Vertex count in either format
+    size_t vertexCount() const { return format == VertexFormat::Packed ? packedVertices.size() : vertices.size(); }
+    // Bytes the vertex and index data take once uploaded
+    size_t byteSize() const {
+        if (format == VertexFormat::Packed) {
+            return packedVertices.size() * sizeof(PackedVertex) + packedIndices.size() * sizeof(uint16_t);
+        }
+        return vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+    }
+};
+
+// A chunk's blocks in storage order (x + y * CHUNK_WIDTH + z * CHUNK_WIDTH * CHUNK_HEIGHT)
+using ChunkBlocks = std::span<const Block, CHUNK_BLOCK_COUNT>;
+
+/**
+ * @brief Working memory for building chunk meshes, reused from one build to the next so a
+ * thread that keeps one (and keeps its output geometry) meshes without allocating.
+ */
+struct ChunkMeshScratch {
+    // ChunkSpan contents expanded for random access
+    std::vector<Block> blocks;
+    // Greedy meshing: the visible face of each cell of one plane
+    std::vector<Block> mask;
+    // Face connectivity flood fill
+    std::vector<uint8_t> visited;
+    std::vector<int> stack;
+};
 
 class ChunkMesh {
 public:
     ChunkMesh();
     ~ChunkMesh();
     
-    void buildMesh(const std::vector<Block>& chunkData, const glm::vec3& chunkPosition);
+    /**
+     * @brief Builds Full geometry into out without touching GL, so any thread can call it. out's
+     * arrays are cleared, not freed, and refilled; with the same scratch and out each call only
+     * allocates when a mesh is bigger than any before it.
+     */
+    static void buildGeometry(ChunkBlocks blocks, const glm::vec3& chunkPosition, MeshingMode mode, const ChunkNeighbours& neighbours, ChunkMeshScratch& scratch, ChunkMeshGeometry& out);
+    // As above, reading the chunk's blocks (and its position) straight from the ChunkSpan
+    static void buildGeometry(const ChunkSpan& chunk, MeshingMode mode, const ChunkNeighbours& neighbours, ChunkMeshScratch& scratch, ChunkMeshGeometry& out);
+    // Allocating convenience form
+    static ChunkMeshGeometry buildGeometry(const std::vector<Block>& chunkData, const glm::vec3& chunkPosition, MeshingMode mode = MeshingMode::Naive, const ChunkNeighbours& neighbours = {});
+    // Converts Full geometry to Packed; the Full arrays are cleared but keep their capacity
+    static void pack(ChunkMeshGeometry& geometry);
+    // Turns Full geometry of a level L LOD chunk (see chunk_lod.h), built at its grid position, into
+    // world space: each block becomes 2^L blocks wide and textures repeat per world block
+    static void scaleToLod(ChunkMeshGeometry& geometry, uint32_t level);
+    // Replaces the mesh with already built geometry; render thread only
+    void upload(ChunkMeshGeometry geometry);
+    
+    void buildMesh(const std::vector<Block>& chunkData, const glm::vec3& chunkPosition, MeshingMode mode = MeshingMode::Naive);
+    // Bind the shader matching format() first; the packed one needs chunkOrigin set to origin()
     void render();
-    void update(const std::vector<Block>& chunkData, const glm::vec3& chunkPosition);
+    void update(const std::vector<Block>& chunkData, const glm::vec3& chunkPosition, MeshingMode mode = MeshingMode::Naive);
     void cleanup();
     
-    bool isEmpty() const { return vertices.empty(); }
+    bool isEmpty() const { return geometry.vertexCount() == 0; }
+    VertexFormat format() const { return geometry.format; }
+    const glm::vec3& origin() const { return geometry.origin; }
     
 private:
     GLuint VAO, VBO, EBO;
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
+    ChunkMeshGeometry geometry;
     
     void setupMesh();
-    bool shouldRenderFace(const std::vector<Block>& chunkData, int x, int y, int z, int face);
-    glm::vec3 getBlockPosition(int x, int y, int z) const;
-    int getBlockIndex(int x, int y, int z) const;
-    void addBlockFace(Block blockType, const glm::vec3& position, int face);
+    static void buildNaive(ChunkMeshGeometry& geometry, ChunkBlocks chunkData, const glm::vec3& chunkPosition, const ChunkNeighbours& neighbours);
+    static void buildGreedy(ChunkMeshGeometry& geometry, ChunkBlocks chunkData, const glm::vec3& chunkPosition, const ChunkNeighbours& neighbours, std::vector<Block>& mask);
+    static bool shouldRenderFace(ChunkBlocks chunkData, const ChunkNeighbours& neighbours, int x, int y, int z, int face);
+    static glm::vec3 getBlockPosition(int x, int y, int z);
+    static int getBlockIndex(int x, int y, int z);
+    static void addBlockFace(ChunkMeshGeometry& geometry, Block blockType, const glm::vec3& position, int face);
+    // Adds the face quad spanning blocks lo..hi (inclusive, chunk-local) of one plane
+    static void addMergedFace(ChunkMeshGeometry& geometry, Block blockType, const glm::vec3& chunkPosition, const int lo[3], const int hi[3], int face);
+    static void addFaceIndices(ChunkMeshGeometry& geometry);
 };
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "chunk_mesh_cache.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+int32_t chebyshevDistance(const AbsoluteChunkPosition& a, const AbsoluteChunkPosition& b) {
+    return std::max({std::abs(a.x - b.x), std::abs(a.y - b.y), std::abs(a.z - b.z)});
+}
+
+} // namespace
+
+ChunkMeshCache::ChunkMeshCache(size_t byteBudget) : byteBudget_(byteBudget) {}
+
+bool ChunkMeshCache::needsMesh(const AbsoluteChunkPosition& pos, uint64_t version) const {
+    auto it = entries_.find(pos);
+    return it == entries_.end() || !it->second.current || it->second.version != version;
+}
+
+bool ChunkMeshCache::queued(const AbsoluteChunkPosition& pos, uint64_t version) {
+    auto [it, inserted] = entries_.try_emplace(pos);
+    Entry& entry = it->second;
+    bool changed = inserted || entry.version != version;
+    entry.version = version;
+    entry.current = true;
+    return changed;
+}
+
+void ChunkMeshCache::uploaded(const AbsoluteChunkPosition& pos, size_t bytes, ChunkFaceConnectivity connectivity) {
+    Entry& entry = entries_[pos];
+    if (entry.resident) {
+        residentBytes_ -= entry.bytes;
+    }
+    entry.resident = true;
+    entry.bytes = bytes;
+    entry.connectivity = connectivity;
+    entry.lastDrawn = frame_;
+    residentBytes_ += bytes;
+}
+
+void ChunkMeshCache::invalidate(const AbsoluteChunkPosition& pos) {
+    auto it = entries_.find(pos);
+    if (it != entries_.end()) {
+        it->second.current = false;
+    }
+}
+
+void ChunkMeshCache::invalidateAll() {
+    for (auto& entry : entries_) {
+        entry.second.current = false;
+    }
+}
+
+void ChunkMeshCache::touch(const AbsoluteChunkPosition& pos) const {
+    auto it = entries_.find(pos);
+    if (it != entries_.end()) {
+        it->second.lastDrawn = frame_;
+    }
+}
+
+std::vector<AbsoluteChunkPosition> ChunkMeshCache::evict(const AbsoluteChunkPosition& center, int32_t loadDistance, int32_t keepDistance) {
+    std::vector<AbsoluteChunkPosition> evicted;
+    // Candidates for the budget pass: outside the load range but inside the keep distance
+    std::vector<std::pair<uint64_t, AbsoluteChunkPosition>> lingering;
+    for (const auto& entry : entries_) {
+        int32_t distance = chebyshevDistance(entry.first, center);
+        if (distance > keepDistance) {
+            evicted.push_back(entry.first);
+        } else if (distance > loadDistance && entry.second.resident) {
+            lingering.emplace_back(entry.second.lastDrawn, entry.first);
+        }
+    }
+    for (const auto& pos : evicted) {
+        erase(pos);
+    }
+
+    if (residentBytes_ > byteBudget_) {
+        std::sort(lingering.begin(), lingering.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (const auto& [lastDrawn, pos] : lingering) {
+            if (residentBytes_ <= byteBudget_) {
+                break;
+            }
+            erase(pos);
+            evicted.push_back(pos);
+        }
+    }
+    return evicted;
+}
+
+void ChunkMeshCache::erase(const AbsoluteChunkPosition& pos) {
+    auto it = entries_.find(pos);
+    if (it == entries_.end()) {
+        return;
+    }
+    if (it->second.resident) {
+        residentBytes_ -= it->second.bytes;
+    }
+    entries_.erase(it);
+}
+
+std::optional<ChunkFaceConnectivity> ChunkMeshCache::connectivity(const AbsoluteChunkPosition& pos) const {
+    auto it = entries_.find(pos);
+    if (it == entries_.end() || !it->second.resident) {
+        return std::nullopt;
+    }
+    return it->second.connectivity;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "chunk_culling.h"
+#include "chunk_pos_hash.h"
+#include "position.h"
+
+// Meshes within this many chunks of the camera (on every axis) stay resident after leaving the load range
+constexpr int32_t CHUNK_MESH_KEEP_DISTANCE = 5;
+// GPU bytes of chunk geometry kept before meshes outside the load range are dropped, least recently drawn first
+constexpr size_t CHUNK_MESH_CACHE_BUDGET = 128 * 1024 * 1024;
+
+/**
+ * @brief Bookkeeping for the render thread's chunk meshes: which ChunkSpan::version each was built
+ * from, what it costs on the GPU, and when it was last drawn. The meshes themselves live in a
+ * ChunkGeometryArena or ChunkMesh; whatever evict() returns is the caller's to free.
+ *
+ * A mesh is only rebuilt when the chunk's version changes or it is invalidated (a neighbour
+ * arrived or changed, or the meshing settings did). Meshes survive leaving the load range until
+ * they are further than the keep distance, or the cache is over budget.
+ */
+class ChunkMeshCache {
+public:
+    explicit ChunkMeshCache(size_t byteBudget = CHUNK_MESH_CACHE_BUDGET);
+
+    // True unless a mesh of this version is resident or being built
+    bool needsMesh(const AbsoluteChunkPosition& pos, uint64_t version) const;
+    /**
+     * @brief Records that the chunk was handed to the mesher at this version.
+     * @return True when its contents differ from the last build (or it has none), so neighbours
+     * culled their borders against something else and should be invalidated.
+     */
+    bool queued(const AbsoluteChunkPosition& pos, uint64_t version);
+    // The mesh of pos was uploaded
+    void uploaded(const AbsoluteChunkPosition& pos, size_t bytes, ChunkFaceConnectivity connectivity);
+
+    // Forces a rebuild next time needsMesh is asked; the old mesh stays until then
+    void invalidate(const AbsoluteChunkPosition& pos);
+    void invalidateAll();
+
+    // Marks the chunk as drawn this frame, for least-recently-drawn eviction
+    void touch(const AbsoluteChunkPosition& pos) const;
+    void nextFrame() { ++frame_; }
+
+    /**
+     * @brief Forgets, and returns, every chunk further than keepDistance from center, then chunks
+     * further than loadDistance, least recently drawn first, until the resident bytes are within budget.
+     */
+    std::vector<AbsoluteChunkPosition> evict(const AbsoluteChunkPosition& center, int32_t loadDistance, int32_t keepDistance);
+    void erase(const AbsoluteChunkPosition& pos);
+
+    bool contains(const AbsoluteChunkPosition& pos) const { return entries_.find(pos) != entries_.end(); }
+    // Connectivity of the resident mesh, for the occlusion pass
+    std::optional<ChunkFaceConnectivity> connectivity(const AbsoluteChunkPosition& pos) const;
+    template<typename Fn>
+    void forEachResident(Fn&& fn) const {
+        for (const auto& entry : entries_) {
+            if (entry.second.resident) {
+                fn(entry.first);
+            }
+        }
+    }
+    size_t size() const { return entries_.size(); }
+    size_t residentBytes() const { return residentBytes_; }
+    size_t byteBudget() const { return byteBudget_; }
+
+private:
+    struct Entry {
+        // Version last handed to the mesher
+        uint64_t version = 0;
+        // False once invalidated
+        bool current = true;
+        bool resident = false;
+        size_t bytes = 0;
+        ChunkFaceConnectivity connectivity = CHUNK_FACES_ALL_CONNECTED;
+        mutable uint64_t lastDrawn = 0;
+    };
+
+    const size_t byteBudget_;
+    ChunkPosMap<Entry> entries_;
+    size_t residentBytes_ = 0;
+    uint64_t frame_ = 0;
+};
@@ -0,0 +1,117 @@
+#include "chunk_mesher.h"
+
+#include <thread>
+#include <vector>
+
+#include "thread_pool.h"
+
+ChunkMesher::ChunkMesher(size_t threadCount, MeshingMode mode, VertexFormat format)
+    : mode_(mode), format_(format), pool_(std::make_unique<ThreadPool>(threadCount)) {}
+
+ChunkMesher::~ChunkMesher() {
+    // Jobs still queued return without building
+    stopping_ = true;
+    pool_.reset();
+}
+
+size_t ChunkMesher::defaultThreadCount() {
+    const size_t cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 1;
+}
+
+void ChunkMesher::submit(const AbsoluteChunkPosition& pos, std::shared_ptr<const ChunkSpan> chunk, ChunkNeighbours neighbours, uint32_t lodLevel) {
+    if (lodLevel > CHUNK_LOD_LEVELS) {
+        return;
+    }
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation = nextGeneration_++;
+        latest_[lodLevel][pos] = generation;
+    }
+    pool_->submit([this, pos, lodLevel, generation, chunk = std::move(chunk), neighbours = std::move(neighbours)]() mutable {
+        build(pos, lodLevel, generation, std::move(chunk), std::move(neighbours));
+    });
+}
+
+void ChunkMesher::build(AbsoluteChunkPosition pos, uint32_t lodLevel, uint64_t generation, std::shared_ptr<const ChunkSpan> chunk, ChunkNeighbours neighbours) {
+    if (stopping_) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!currentLocked(pos, lodLevel, generation)) {
+            return;
+        }
+    }
+
+    // Each worker keeps its buffers between builds; only the finished arrays are copied out, at their exact size
+    thread_local ChunkMeshScratch scratch;
+    thread_local ChunkMeshGeometry working;
+    ChunkMesh::buildGeometry(*chunk, mode_, neighbours, scratch, working);
+    if (lodLevel > 0) {
+        ChunkMesh::scaleToLod(working, lodLevel);
+    } else if (format_ == VertexFormat::Packed) {
+        ChunkMesh::pack(working);
+    }
+    ChunkMeshGeometry geometry = working;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (currentLocked(pos, lodLevel, generation)) {
+        completed_.push_back(Completed{generation, Result{pos, std::move(geometry), lodLevel}});
+    }
+}
+
+bool ChunkMesher::currentLocked(const AbsoluteChunkPosition& pos, uint32_t lodLevel, uint64_t generation) const {
+    auto it = latest_[lodLevel].find(pos);
+    return it != latest_[lodLevel].end() && it->second == generation;
+}
+
+void ChunkMesher::cancel(const AbsoluteChunkPosition& pos, uint32_t lodLevel) {
+    if (lodLevel > CHUNK_LOD_LEVELS) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    latest_[lodLevel].erase(pos);
+}
+
+void ChunkMesher::cancelAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& latest : latest_) {
+        latest.clear();
+    }
+    completed_.clear();
+}
+
+size_t ChunkMesher::drainCompleted(std::chrono::microseconds budget, const std::function<void(Result&&)>& upload) {
+    const auto deadline = std::chrono::steady_clock::now() + budget;
+    size_t handed = 0;
+    do {
+        Result result;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // Skip results superseded after they finished
+            while (!completed_.empty() && !currentLocked(completed_.front().result.position, completed_.front().result.lodLevel, completed_.front().generation)) {
+                completed_.pop_front();
+            }
+            if (completed_.empty()) {
+                break;
+            }
+            result = std::move(completed_.front().result);
+            completed_.pop_front();
+            latest_[result.lodLevel].erase(result.position);
+        }
+        upload(std::move(result));
+        ++handed;
+    } while (std::chrono::steady_clock::now() < deadline);
+    return handed;
+}
+
+size_t ChunkMesher::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t total = 0;
+    for (const auto& latest : latest_) {
+        total += latest.size();
+    }
+    return total;
+}
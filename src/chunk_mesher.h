@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "chunk_lod.h"
+#include "chunk_mesh.h"
+#include "chunk_pos_hash.h"
+#include "chunkspan.h"
+#include "position.h"
+
+class ThreadPool;
+
+/**
+ * @brief Builds chunk mesh geometry on worker threads so the render thread only uploads it.
+ *
+ * Chunks are submitted as shared snapshots that nobody writes to afterwards (the client cache
+ * replaces chunks instead of editing them in place). Resubmitting or cancelling a position makes
+ * any build still pending or finished for it stale, and stale results are never handed out.
+ * LOD chunks (see chunk_lod.h) are tracked per level apart from full chunks at the same position,
+ * and always come out as world-space Full geometry.
+ */
+class ChunkMesher {
+public:
+    struct Result {
+        AbsoluteChunkPosition position;
+        ChunkMeshGeometry geometry;
+        // 0 for a full chunk, else the LOD level position is in
+        uint32_t lodLevel = 0;
+    };
+
+    explicit ChunkMesher(size_t threadCount = defaultThreadCount(), MeshingMode mode = MeshingMode::Greedy, VertexFormat format = VertexFormat::Packed);
+    ~ChunkMesher();
+    ChunkMesher(const ChunkMesher&) = delete;
+    ChunkMesher& operator=(const ChunkMesher&) = delete;
+
+    // Leaves one core for the render thread
+    static size_t defaultThreadCount();
+
+    // Applies to builds that start afterwards; resubmit chunks to remesh them
+    void setMeshingMode(MeshingMode mode) { mode_ = mode; }
+    MeshingMode getMeshingMode() const { return mode_; }
+    void setVertexFormat(VertexFormat format) { format_ = format; }
+    VertexFormat getVertexFormat() const { return format_; }
+
+    // neighbours are snapshots too; border faces against missing ones are kept
+    void submit(const AbsoluteChunkPosition& pos, std::shared_ptr<const ChunkSpan> chunk, ChunkNeighbours neighbours = {}, uint32_t lodLevel = 0);
+    void cancel(const AbsoluteChunkPosition& pos, uint32_t lodLevel = 0);
+    void cancelAll();
+
+    /**
+     * @brief Passes finished meshes to upload, oldest first, until budget has been spent.
+     * At least one mesh is handed out per call when any is ready, so uploads always progress.
+     * @return Meshes handed out.
+     */
+    size_t drainCompleted(std::chrono::microseconds budget, const std::function<void(Result&&)>& upload);
+
+    // Submitted positions not yet handed out or cancelled
+    size_t pending() const;
+
+private:
+    struct Completed {
+        uint64_t generation;
+        Result result;
+    };
+
+    void build(AbsoluteChunkPosition pos, uint32_t lodLevel, uint64_t generation, std::shared_ptr<const ChunkSpan> chunk, ChunkNeighbours neighbours);
+    bool currentLocked(const AbsoluteChunkPosition& pos, uint32_t lodLevel, uint64_t generation) const;
+
+    mutable std::mutex mutex_;
+    // Generation of the newest submission per LOD level and position
+    std::array<ChunkPosMap<uint64_t>, CHUNK_LOD_LEVELS + 1> latest_;
+    std::deque<Completed> completed_;
+    uint64_t nextGeneration_ = 1;
+    std::atomic<MeshingMode> mode_;
+    std::atomic<VertexFormat> format_;
+    std::atomic<bool> stopping_{false};
+    // Last so its workers are joined before the state above goes away
+    std::unique_ptr<ThreadPool> pool_;
+};
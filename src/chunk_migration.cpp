@@ -0,0 +1,72 @@
+#include "chunk_migration.h"
+#include "chunk_arena.h"
+#include "chunkspan.h"
+#include <iostream>
+#include <span>
+#include <vector>
+
+size_t migrateSQLiteChunks(sqlite3* source, IChunkPersistence& destination, size_t batchSize) {
+    if (!source) {
+        std::cerr << "No database connection to migrate from\n";
+        return 0;
+    }
+    if (batchSize == 0) batchSize = 1;
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(source, "SELECT data FROM chunks", -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to prepare migration query: " << sqlite3_errmsg(source) << "\n";
+        return 0;
+    }
+
+    size_t migrated = 0;
+    std::vector<std::shared_ptr<const ChunkSpan>> batch;
+    batch.reserve(batchSize);
+    // Chunks the destination didn't keep a reference to; later rows decode into them in place
+    std::vector<std::shared_ptr<ChunkSpan>> pool;
+    auto flushBatch = [&]() {
+        if (batch.empty()) return;
+        if (destination.saveChunks(batch)) {
+            migrated += batch.size();
+        } else {
+            std::cerr << "Failed to save a batch of " << batch.size() << " migrated chunks\n";
+        }
+        for (auto& chunk : batch) {
+            if (chunk.use_count() == 1) {
+                pool.push_back(std::const_pointer_cast<ChunkSpan>(std::move(chunk)));
+            }
+        }
+        batch.clear();
+    };
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const auto* blob = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, 0));
+        const int blobSize = sqlite3_column_bytes(stmt, 0);
+        if (!blob || blobSize <= 0) {
+            std::cerr << "Skipping row with empty chunk data\n";
+            continue;
+        }
+        const std::span<const uint8_t> data(blob, static_cast<size_t>(blobSize));
+        try {
+            if (pool.empty()) {
+                batch.push_back(makePooledChunk(data));
+            } else {
+                pool.back()->decode(data);
+                batch.push_back(std::move(pool.back()));
+                pool.pop_back();
+            }
+        } catch (const std::exception& ex) {
+            std::cerr << "Skipping chunk that failed to deserialize: " << ex.what() << "\n";
+            continue;
+        }
+        if (batch.size() >= batchSize) {
+            flushBatch();
+        }
+    }
+    if (rc != SQLITE_DONE) {
+        std::cerr << "Migration query stopped early: " << sqlite3_errmsg(source) << "\n";
+    }
+    flushBatch();
+    sqlite3_finalize(stmt);
+    return migrated;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "world.h"
+#include <cstddef>
+#include <sqlite3.h>
+
+/**
+ * @brief Copies every chunk in an SQLiteChunkPersistence database into another persistence backend.
+ * Rows are streamed from the `chunks` table and saved in batches through IChunkPersistence::saveChunks.
+ * Rows that fail to deserialize are reported and skipped.
+ * @param source Open connection to a database written by SQLiteChunkPersistence.
+ * @param destination Backend to copy into, e.g. a RegionFileChunkPersistence.
+ * @param batchSize Chunks handed to each saveChunks call.
+ * @return Number of chunks copied.
+ */
+size_t migrateSQLiteChunks(sqlite3* source, IChunkPersistence& destination, size_t batchSize = 256);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "flat_hash_map.h"
+#include "position.h"
+
+// Hash, equality and containers for tables keyed by chunk position
+struct ChunkPosHash {
+    std::size_t operator()(const AbsoluteChunkPosition& pos) const {
+        // Give each axis its own odd multiplier, then run the murmur3 finalizer so every input bit
+        // reaches the low bits that open-addressing tables index with
+        uint64_t h = static_cast<uint64_t>(static_cast<uint32_t>(pos.x)) * 0x9E3779B97F4A7C15ull;
+        h ^= static_cast<uint64_t>(static_cast<uint32_t>(pos.y)) * 0xC2B2AE3D27D4EB4Full;
+        h ^= static_cast<uint64_t>(static_cast<uint32_t>(pos.z)) * 0x165667B19E3779F9ull;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return static_cast<std::size_t>(h);
+    }
+};
+
+struct ChunkPosEq {
+    bool operator()(const AbsoluteChunkPosition& a, const AbsoluteChunkPosition& b) const {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+};
+
+using ChunkSet = FlatHashSet<AbsoluteChunkPosition, ChunkPosHash, ChunkPosEq>;
+// Any other per-chunk table
+template<typename V>
+using ChunkPosMap = FlatHashMap<AbsoluteChunkPosition, V, ChunkPosHash, ChunkPosEq>;
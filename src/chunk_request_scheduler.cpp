@@ -0,0 +1,105 @@
+#include "chunk_request_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+// Weight of each new round trip in the smoothed one
+constexpr double RTT_SMOOTHING = 0.125;
+// Smoothed round trips under this multiple of the fastest grow the limit, over the second shrink it
+constexpr double RTT_GROW_RATIO = 1.5;
+constexpr double RTT_SHRINK_RATIO = 3.0;
+
+} // namespace
+
+ChunkRequestScheduler::ChunkRequestScheduler(int32_t cancelDistance) : cancelDistance_(cancelDistance) {}
+
+bool ChunkRequestScheduler::enqueue(const AbsoluteChunkPosition& pos) {
+    if (!queued_.insert(pos).second) {
+        return false;
+    }
+    pending_.push_back(pos);
+    return true;
+}
+
+void ChunkRequestScheduler::clear() {
+    pending_.clear();
+    queued_.clear();
+}
+
+std::vector<AbsoluteChunkPosition> ChunkRequestScheduler::setCenter(const AbsoluteChunkPosition& center) {
+    center_ = center;
+    std::vector<AbsoluteChunkPosition> dropped;
+    auto stale = std::partition(pending_.begin(), pending_.end(), [&](const AbsoluteChunkPosition& pos) { return !isStale(pos); });
+    for (auto it = stale; it != pending_.end(); ++it) {
+        queued_.erase(*it);
+        dropped.push_back(*it);
+    }
+    pending_.erase(stale, pending_.end());
+    return dropped;
+}
+
+void ChunkRequestScheduler::setViewDirection(double dx, double dy, double dz) {
+    double length = std::sqrt(dx * dx + dy * dy + dz * dz);
+    if (length > 0.0) {
+        dirX_ = dx / length;
+        dirY_ = dy / length;
+        dirZ_ = dz / length;
+    } else {
+        dirX_ = dirY_ = dirZ_ = 0.0;
+    }
+}
+
+bool ChunkRequestScheduler::isStale(const AbsoluteChunkPosition& pos) const {
+    return std::abs(pos.x - center_.x) > cancelDistance_ ||
+           std::abs(pos.y - center_.y) > cancelDistance_ ||
+           std::abs(pos.z - center_.z) > cancelDistance_;
+}
+
+double ChunkRequestScheduler::priority(const AbsoluteChunkPosition& pos) const {
+    double x = pos.x - center_.x;
+    double y = pos.y - center_.y;
+    double z = pos.z - center_.z;
+    double distance = std::sqrt(x * x + y * y + z * z);
+    if (distance == 0.0) {
+        return 0.0;
+    }
+    // 1 straight ahead, 2 straight behind
+    double facing = (x * dirX_ + y * dirY_ + z * dirZ_) / distance;
+    return distance * (1.5 - 0.5 * facing);
+}
+
+std::vector<AbsoluteChunkPosition> ChunkRequestScheduler::takeBatch(size_t count) {
+    count = std::min(count, pending_.size());
+    auto sooner = [&](const AbsoluteChunkPosition& a, const AbsoluteChunkPosition& b) { return priority(a) < priority(b); };
+    std::partial_sort(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(count), pending_.end(), sooner);
+
+    std::vector<AbsoluteChunkPosition> batch(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(count));
+    pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(count));
+    for (const auto& pos : batch) {
+        queued_.erase(pos);
+    }
+    return batch;
+}
+
+void ChunkRequestScheduler::recordRoundTrip(std::chrono::microseconds rtt, size_t chunks) {
+    double sample = static_cast<double>(std::max<int64_t>(rtt.count(), 1)) / static_cast<double>(std::max<size_t>(chunks, 1));
+    if (smoothedRtt_ == 0.0) {
+        smoothedRtt_ = minRtt_ = sample;
+        return;
+    }
+    smoothedRtt_ += RTT_SMOOTHING * (sample - smoothedRtt_);
+    minRtt_ = std::min(minRtt_, sample);
+
+    ++samplesSinceShrink_;
+
+    if (smoothedRtt_ < minRtt_ * RTT_GROW_RATIO) {
+        inflightLimit_ = std::min(inflightLimit_ + 1, CHUNK_REQUEST_MAX_INFLIGHT);
+    } else if (smoothedRtt_ > minRtt_ * RTT_SHRINK_RATIO && samplesSinceShrink_ >= inflightLimit_) {
+        // At most once per round of calls, so the calls sent at the old limit don't cut it again
+        inflightLimit_ = std::max(inflightLimit_ * 3 / 4, CHUNK_REQUEST_MIN_INFLIGHT);
+        samplesSinceShrink_ = 0;
+    }
+}
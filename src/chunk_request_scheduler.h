@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "chunk_pos_hash.h"
+#include "position.h"
+
+// Queued or in-flight chunks further than this from the player's chunk (on any axis) are dropped
+constexpr int32_t CHUNK_REQUEST_CANCEL_DISTANCE = 8;
+// Bounds and starting point of the adaptive in-flight GetChunks limit
+constexpr size_t CHUNK_REQUEST_MIN_INFLIGHT = 2;
+constexpr size_t CHUNK_REQUEST_MAX_INFLIGHT = 32;
+constexpr size_t CHUNK_REQUEST_INITIAL_INFLIGHT = 8;
+
+/**
+ * @brief Orders the client's pending chunk requests by how soon the player needs them, and sizes
+ * how many GetChunks calls may be in flight.
+ *
+ * Urgency is the distance from the player's chunk, stretched up to double for chunks behind the
+ * view direction, recomputed from the current viewpoint whenever a batch is taken. The in-flight
+ * limit grows by one while round trips per chunk stay near the fastest seen and is cut by a quarter when they
+ * climb well past it (the server queueing our calls), like delay-based congestion control.
+ * Not synchronized; Client guards it with its calls mutex.
+ */
+class ChunkRequestScheduler {
+public:
+    explicit ChunkRequestScheduler(int32_t cancelDistance = CHUNK_REQUEST_CANCEL_DISTANCE);
+
+    // False when pos is already queued
+    bool enqueue(const AbsoluteChunkPosition& pos);
+    bool contains(const AbsoluteChunkPosition& pos) const { return queued_.contains(pos); }
+    void clear();
+    size_t size() const { return pending_.size(); }
+
+    /**
+     * @brief Moves the viewpoint to another chunk.
+     * @return Queued positions now past the cancel distance, which have been dropped.
+     */
+    std::vector<AbsoluteChunkPosition> setCenter(const AbsoluteChunkPosition& center);
+    // Need not be normalized; zero means no preference. Only reorders, never drops.
+    void setViewDirection(double dx, double dy, double dz);
+    const AbsoluteChunkPosition& center() const { return center_; }
+    // Past the cancel distance from the current viewpoint
+    bool isStale(const AbsoluteChunkPosition& pos) const;
+    // Lower is sooner
+    double priority(const AbsoluteChunkPosition& pos) const;
+
+    // Removes and returns up to count queued positions, most urgent first
+    std::vector<AbsoluteChunkPosition> takeBatch(size_t count);
+
+    // A call for several chunks is sampled as its round trip per chunk, so batch size doesn't read as queueing
+    void recordRoundTrip(std::chrono::microseconds rtt, size_t chunks = 1);
+    size_t inflightLimit() const { return inflightLimit_; }
+    // Smoothed round trip, zero before the first one
+    std::chrono::microseconds smoothedRoundTrip() const { return std::chrono::microseconds(static_cast<int64_t>(smoothedRtt_)); }
+
+private:
+    const int32_t cancelDistance_;
+    std::vector<AbsoluteChunkPosition> pending_;
+    ChunkSet queued_;
+    AbsoluteChunkPosition center_{0, 0, 0};
+    // Unit view direction, or zero
+    double dirX_ = 0.0, dirY_ = 0.0, dirZ_ = 0.0;
+
+    size_t inflightLimit_ = CHUNK_REQUEST_INITIAL_INFLIGHT;
+    double smoothedRtt_ = 0.0;
+    double minRtt_ = 0.0;
+    size_t samplesSinceShrink_ = 0;
+};
@@ -0,0 +1,134 @@
+#include "chunk_residency.h"
+#include <cstdlib>
+
+ChunkResidency::ChunkResidency(int32_t radiusInChunks) : radius_(radiusInChunks < 0 ? 0 : radiusInChunks) {
+    for (int32_t dx = -radius_; dx <= radius_; dx++) {
+        for (int32_t dy = -radius_; dy <= radius_; dy++) {
+            for (int32_t dz = -radius_; dz <= radius_; dz++) {
+                if (inSphere(dx, dy, dz)) {
+                    sphereOffsets_.emplace_back(dx, dy, dz);
+                }
+            }
+        }
+    }
+}
+
+bool ChunkResidency::inSphere(int32_t dx, int32_t dy, int32_t dz) const {
+    // Integer form of sqrt(dx^2 + dy^2 + dz^2) <= radius
+    const int64_t d2 = int64_t{dx} * dx + int64_t{dy} * dy + int64_t{dz} * dz;
+    return d2 <= int64_t{radius_} * radius_;
+}
+
+size_t ChunkResidency::directionIndex(int32_t dx, int32_t dy, int32_t dz) {
+    return static_cast<size_t>((dx + 1) * 9 + (dy + 1) * 3 + (dz + 1));
+}
+
+const ChunkResidency::ShellDelta& ChunkResidency::shellFor(int32_t dx, int32_t dy, int32_t dz) {
+    auto& shell = shells_[directionIndex(dx, dy, dz)];
+    if (!shell) {
+        shell = std::make_unique<ShellDelta>();
+        for (const auto& o : sphereOffsets_) {
+            // new + o is outside the old sphere when (new + o - old) = o + d is outside
+            if (!inSphere(o.x + dx, o.y + dy, o.z + dz)) shell->entering.push_back(o);
+            // old + o is outside the new sphere when (old + o - new) = o - d is outside
+            if (!inSphere(o.x - dx, o.y - dy, o.z - dz)) shell->leaving.push_back(o);
+        }
+    }
+    return *shell;
+}
+
+void ChunkResidency::acquire(const AbsoluteChunkPosition& pos) {
+    if (refCounts_[pos]++ == 0) {
+        pendingUnloads_.erase(pos);
+        pendingLoads_.insert(pos);
+    }
+}
+
+void ChunkResidency::release(const AbsoluteChunkPosition& pos) {
+    auto it = refCounts_.find(pos);
+    if (it == refCounts_.end()) return;
+    if (--it->second == 0) {
+        refCounts_.erase(it);
+        pendingLoads_.erase(pos);
+        pendingUnloads_.insert(pos);
+    }
+}
+
+void ChunkResidency::acquireSphere(const AbsoluteChunkPosition& center) {
+    for (const auto& o : sphereOffsets_) {
+        acquire(AbsoluteChunkPosition(center.x + o.x, center.y + o.y, center.z + o.z));
+    }
+}
+
+void ChunkResidency::releaseSphere(const AbsoluteChunkPosition& center) {
+    for (const auto& o : sphereOffsets_) {
+        release(AbsoluteChunkPosition(center.x + o.x, center.y + o.y, center.z + o.z));
+    }
+}
+
+void ChunkResidency::updateAnchor(AnchorId id, const AbsoluteChunkPosition& chunk) {
+    auto it = anchors_.find(id);
+    if (it == anchors_.end()) {
+        anchors_.emplace(id, chunk);
+        acquireSphere(chunk);
+        return;
+    }
+
+    const AbsoluteChunkPosition previous = it->second;
+    const int32_t dx = chunk.x - previous.x;
+    const int32_t dy = chunk.y - previous.y;
+    const int32_t dz = chunk.z - previous.z;
+    if (dx == 0 && dy == 0 && dz == 0) {
+        return;
+    }
+    it->second = chunk;
+
+    if (std::abs(dx) <= 1 && std::abs(dy) <= 1 && std::abs(dz) <= 1) {
+        const ShellDelta& shell = shellFor(dx, dy, dz);
+        for (const auto& o : shell.entering) {
+            acquire(AbsoluteChunkPosition(chunk.x + o.x, chunk.y + o.y, chunk.z + o.z));
+        }
+        for (const auto& o : shell.leaving) {
+            release(AbsoluteChunkPosition(previous.x + o.x, previous.y + o.y, previous.z + o.z));
+        }
+        return;
+    }
+
+    // Teleport: acquire first so overlapping chunks never drop to zero
+    acquireSphere(chunk);
+    releaseSphere(previous);
+}
+
+void ChunkResidency::removeAnchor(AnchorId id) {
+    auto it = anchors_.find(id);
+    if (it == anchors_.end()) return;
+    const AbsoluteChunkPosition previous = it->second;
+    anchors_.erase(it);
+    releaseSphere(previous);
+}
+
+void ChunkResidency::retainAnchors(const std::unordered_set<AnchorId>& keep) {
+    std::vector<AnchorId> stale;
+    for (const auto& [id, chunk] : anchors_) {
+        if (keep.find(id) == keep.end()) stale.push_back(id);
+    }
+    for (AnchorId id : stale) {
+        removeAnchor(id);
+    }
+}
+
+bool ChunkResidency::isResident(const AbsoluteChunkPosition& pos) const {
+    return refCounts_.find(pos) != refCounts_.end();
+}
+
+std::vector<AbsoluteChunkPosition> ChunkResidency::takePendingLoads() {
+    std::vector<AbsoluteChunkPosition> result(pendingLoads_.begin(), pendingLoads_.end());
+    pendingLoads_.clear();
+    return result;
+}
+
+std::vector<AbsoluteChunkPosition> ChunkResidency::takePendingUnloads() {
+    std::vector<AbsoluteChunkPosition> result(pendingUnloads_.begin(), pendingUnloads_.end());
+    pendingUnloads_.clear();
+    return result;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "position.h"
+#include "world.h"
+
+/**
+ * @brief Tracks which chunks must be resident given a set of moving load anchors.
+ *
+ * Each anchor keeps a sphere of chunks (integer distance <= radius) resident. The sphere
+ * offset table is computed once, and per-chunk reference counts are only touched when an
+ * anchor changes chunk: a single-chunk step applies a precomputed O(r^2) shell delta, larger
+ * jumps fall back to a full sphere diff. Anchors that stay inside their chunk cost O(1).
+ */
+class ChunkResidency {
+public:
+    // Stable anchor identity; callers pick the scheme (e.g. anchor index, entity id)
+    using AnchorId = std::uint64_t;
+
+    explicit ChunkResidency(int32_t radiusInChunks);
+
+    // Adds the anchor or moves it to a new chunk
+    void updateAnchor(AnchorId id, const AbsoluteChunkPosition& chunk);
+    void removeAnchor(AnchorId id);
+    // Removes every anchor whose id is not in keep
+    void retainAnchors(const std::unordered_set<AnchorId>& keep);
+
+    bool isResident(const AbsoluteChunkPosition& pos) const;
+    // Chunks that became resident since the last call
+    std::vector<AbsoluteChunkPosition> takePendingLoads();
+    // Chunks that stopped being resident since the last call
+    std::vector<AbsoluteChunkPosition> takePendingUnloads();
+
+    int32_t radius() const { return radius_; }
+    const std::vector<AbsoluteChunkPosition>& sphereOffsets() const { return sphereOffsets_; }
+    size_t anchorCount() const { return anchors_.size(); }
+    size_t residentCount() const { return refCounts_.size(); }
+
+private:
+    struct ShellDelta {
+        std::vector<AbsoluteChunkPosition> entering; // offsets from the new chunk
+        std::vector<AbsoluteChunkPosition> leaving;  // offsets from the old chunk
+    };
+
+    bool inSphere(int32_t dx, int32_t dy, int32_t dz) const;
+    static size_t directionIndex(int32_t dx, int32_t dy, int32_t dz);
+    const ShellDelta& shellFor(int32_t dx, int32_t dy, int32_t dz);
+    void acquire(const AbsoluteChunkPosition& pos);
+    void release(const AbsoluteChunkPosition& pos);
+    void acquireSphere(const AbsoluteChunkPosition& center);
+    void releaseSphere(const AbsoluteChunkPosition& center);
+
+    int32_t radius_;
+    std::vector<AbsoluteChunkPosition> sphereOffsets_;
+    // Shell deltas for the 26 single-chunk steps, built on first use
+    std::array<std::unique_ptr<ShellDelta>, 27> shells_;
+    std::unordered_map<AnchorId, AbsoluteChunkPosition> anchors_;
+    ChunkPosMap<uint32_t> refCounts_;
+    ChunkSet pendingLoads_;
+    ChunkSet pendingUnloads_;
+};
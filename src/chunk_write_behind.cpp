@@ -0,0 +1,119 @@
+#include "chunk_write_behind.h"
+#include "log.h"
+#include "metrics.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace {
+
+struct WriteBehindMetrics {
+    MetricHistogram& saveBatchSeconds = metricHistogram("blocktest_chunk_save_batch_seconds", "Time to write one write-behind batch to persistence");
+    MetricCounter& chunksSaved = metricCounter("blocktest_chunks_saved_total", "Chunks written to persistence by the write-behind queue");
+    MetricGauge& pendingSaves = metricGauge("blocktest_chunk_save_backlog", "Chunks queued or being written by the write-behind queue");
+};
+
+WriteBehindMetrics& writeBehindMetrics() {
+    static WriteBehindMetrics metrics;
+    return metrics;
+}
+
+} // namespace
+
+ChunkWriteBehind::ChunkWriteBehind(std::shared_ptr<IChunkPersistence> persistence)
+    : persistence_(std::move(persistence)) {
+    writer_ = std::thread(&ChunkWriteBehind::writerLoop, this);
+}
+
+ChunkWriteBehind::~ChunkWriteBehind() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if (writer_.joinable()) writer_.join();
+}
+
+void ChunkWriteBehind::enqueue(std::shared_ptr<const ChunkSpan> chunk) {
+    if (!chunk) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry& entry = entries_[chunk->position];
+        entry.chunk = std::move(chunk);
+        if (!entry.queued) {
+            // New, or currently being written: the newer copy needs its own write
+            entry.queued = true;
+            order_.push_back(entry.chunk->position);
+        }
+        writeBehindMetrics().pendingSaves.set(static_cast<int64_t>(entries_.size()));
+    }
+    wake_.notify_one();
+}
+
+std::optional<std::shared_ptr<const ChunkSpan>> ChunkWriteBehind::pending(const AbsoluteChunkPosition& pos) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(pos);
+    if (it == entries_.end()) {
+        return std::nullopt;
+    }
+    return it->second.chunk;
+}
+
+void ChunkWriteBehind::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    drained_.wait(lock, [this]() { return entries_.empty(); });
+}
+
+size_t ChunkWriteBehind::pendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+void ChunkWriteBehind::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this]() { return stopping_ || !order_.empty(); });
+        if (order_.empty()) {
+            // Only reachable when stopping with nothing left to write
+            return;
+        }
+
+        // Take everything queued so far and write it as one batch
+        std::vector<std::shared_ptr<const ChunkSpan>> batch;
+        batch.reserve(std::min(order_.size(), CHUNK_WRITE_BEHIND_MAX_BATCH));
+        while (!order_.empty() && batch.size() < CHUNK_WRITE_BEHIND_MAX_BATCH) {
+            auto it = entries_.find(order_.front());
+            order_.pop_front();
+            it->second.queued = false;
+            batch.push_back(it->second.chunk);
+        }
+
+        lock.unlock();
+        if (persistence_) {
+            TraceSpan span("ChunkWriteBehind::saveChunks");
+            WriteBehindMetrics& metrics = writeBehindMetrics();
+            const auto started = std::chrono::steady_clock::now();
+            const bool saved = persistence_->saveChunks(batch);
+            metrics.saveBatchSeconds.observe(std::chrono::steady_clock::now() - started);
+            if (saved) {
+                metrics.chunksSaved.add(batch.size());
+            } else {
+                LOG_ERROR("Write-behind failed to save a batch of " << batch.size() << " chunks");
+            }
+        }
+        lock.lock();
+
+        // Keep entries whose newer copy was queued while this batch was being written
+        for (const auto& chunk : batch) {
+            auto it = entries_.find(chunk->position);
+            if (it != entries_.end() && !it->second.queued && it->second.chunk == chunk) {
+                entries_.erase(it);
+            }
+        }
+        writeBehindMetrics().pendingSaves.set(static_cast<int64_t>(entries_.size()));
+        if (entries_.empty()) {
+            drained_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "chunkspan.h"
+#include "position.h"
+#include "world.h"
+
+// Upper bound on chunks written per persistence transaction
+constexpr size_t CHUNK_WRITE_BEHIND_MAX_BATCH = 256;
+
+/**
+ * @brief Background writer that saves chunks to an IChunkPersistence off the caller's thread.
+ *
+ * Saves are coalesced by position: queueing a chunk that is already waiting replaces the
+ * waiting copy, so each position is written at most once per drain. Chunks stay visible
+ * through pending() until their write has finished, which lets a reload read its own writes.
+ * Whatever is queued when the writer wakes is handed to IChunkPersistence::saveChunks as one batch.
+ */
+class ChunkWriteBehind {
+public:
+    explicit ChunkWriteBehind(std::shared_ptr<IChunkPersistence> persistence);
+    // Writes everything still queued, then stops the writer thread
+    ~ChunkWriteBehind();
+    ChunkWriteBehind(const ChunkWriteBehind&) = delete;
+    ChunkWriteBehind& operator=(const ChunkWriteBehind&) = delete;
+
+    // The chunk must not be mutated after it is queued
+    void enqueue(std::shared_ptr<const ChunkSpan> chunk);
+    // Latest queued or in-flight copy of a chunk, if any
+    std::optional<std::shared_ptr<const ChunkSpan>> pending(const AbsoluteChunkPosition& pos) const;
+    // Blocks until the queue is empty and nothing is in flight
+    void flush();
+    size_t pendingCount() const;
+
+private:
+    struct Entry {
+        std::shared_ptr<const ChunkSpan> chunk;
+        bool queued = false; // position is in order_ (false while only in flight)
+    };
+
+    void writerLoop();
+
+    std::shared_ptr<IChunkPersistence> persistence_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable drained_;
+    ChunkPosMap<Entry> entries_;
+    std::deque<AbsoluteChunkPosition> order_;
+    bool stopping_ = false;
+    std::thread writer_;
+};
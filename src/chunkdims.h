@@ -1,5 +1,8 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
 constexpr uint8_t CHUNK_WIDTH = 16;
 constexpr uint8_t CHUNK_HEIGHT = 16;
-constexpr uint8_t CHUNK_DEPTH = 16;
\ No newline at end of file
+constexpr uint8_t CHUNK_DEPTH = 16;
+// Total number of blocks in a single chunk
+constexpr size_t CHUNK_BLOCK_COUNT = CHUNK_WIDTH * CHUNK_HEIGHT * CHUNK_DEPTH;
\ No newline at end of file
@@ -1,52 +1,127 @@
-
 #include "chunkspan.h"
+#include "block_kernels.h"
 #include <stdexcept>
 #include <cstring>
+#include <algorithm>
+
+// Version tags for serialization. v1 lists (index, block) for every non-empty block; v2, the one
+// written, is a palette followed by runs of equal blocks in storage order, with varint lengths
+constexpr uint8_t CHUNKSPAN_SPARSE_SERIALIZATION_VERSION_V1 = 1;
+constexpr uint8_t CHUNKSPAN_SPARSE_SERIALIZATION_VERSION = 2;
+// Version byte plus three int32 position coordinates
+constexpr size_t CHUNKSPAN_SERIALIZATION_HEADER_SIZE = 1 + 3 * sizeof(int32_t);
+// Longest LEB128 encoding of a uint32_t
+constexpr size_t MAX_VARINT_BYTES = 5;
+
+// Number of 64-bit words needed to pack one index per block at the given width
+static constexpr size_t packedWordCount(std::uint8_t bits) {
+    return (CHUNK_BLOCK_COUNT * bits + 63) / 64;
+}
+
+// Writes value as LEB128 at out, which must have MAX_VARINT_BYTES free; returns the bytes written
+static size_t writeVarint(uint8_t* out, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = static_cast<uint8_t>(value);
+    return n;
+}
 
-// Version tag for serialization
-constexpr uint8_t CHUNKSPAN_SPARSE_SERIALIZATION_VERSION = 1;
+static uint32_t readVarint(std::span<const uint8_t> data, size_t& offset) {
+    uint32_t value = 0;
+    for (size_t shift = 0; shift < 7 * MAX_VARINT_BYTES; shift += 7) {
+        if (offset >= data.size()) throw std::runtime_error("Serialized data too short for varint");
+        uint8_t byte = data[offset++];
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return value;
+    }
+    throw std::runtime_error("Varint too long");
+}
 
-// Helper: get total block count
-constexpr size_t CHUNK_BLOCK_COUNT = CHUNK_WIDTH * CHUNK_HEIGHT * CHUNK_DEPTH;
+ChunkSpan::ChunkSpan(const std::array<Block, CHUNK_BLOCK_COUNT>& storage, AbsoluteChunkPosition pos)
+    : position(pos) {
+    buildFromDense(storage.data());
+}
 
 ChunkSerializationSparseVector ChunkSpan::serialize() const {
-	ChunkSerializationSparseVector out;
-	// Version
-	out.push_back(CHUNKSPAN_SPARSE_SERIALIZATION_VERSION);
-	// Position (x, y, z as int32_t)
-	for (int i = 0; i < 3; ++i) {
-		int32_t coord = (i == 0) ? position.x : (i == 1) ? position.y : position.z;
-		uint8_t* p = reinterpret_cast<uint8_t*>(&coord);
-		out.insert(out.end(), p, p + sizeof(int32_t));
+	std::array<Block, CHUNK_BLOCK_COUNT> blocks;
+	std::array<uint16_t, CHUNK_BLOCK_COUNT> runEnds;
+	static_assert(CHUNK_BLOCK_COUNT <= UINT16_MAX, "run ends must fit in uint16_t");
+
+	// Palette in order of first appearance, so the first run always uses index 0
+	std::array<int16_t, 256> paletteIndex;
+	paletteIndex.fill(-1);
+	std::vector<uint8_t> palette;
+	size_t runs = 0;
+	if (mode_ == ChunkStorageMode::Uniform) {
+		// One run, without expanding the chunk
+		blocks[0] = uniform_;
+		paletteIndex[static_cast<uint8_t>(uniform_)] = 0;
+		palette.push_back(static_cast<uint8_t>(uniform_));
+		runEnds[runs++] = CHUNK_BLOCK_COUNT;
+	} else {
+		copyTo(blocks);
+		// Whole runs at a time, so the long runs terrain is made of are scanned in bulk
+		for (size_t start = 0; start < CHUNK_BLOCK_COUNT; start = runEnds[runs++]) {
+			uint8_t value = static_cast<uint8_t>(blocks[start]);
+			if (paletteIndex[value] < 0) {
+				paletteIndex[value] = static_cast<int16_t>(palette.size());
+				palette.push_back(value);
+			}
+			runEnds[runs] = static_cast<uint16_t>(start + findBlockNotEqual(&blocks[start], CHUNK_BLOCK_COUNT - start, blocks[start]));
+		}
 	}
-	// Count non-empty blocks
-	uint32_t nonempty_count = 0;
-	for (size_t i = 0; i < storage.size(); ++i) {
-		if (storage[i] != Block::Empty) ++nonempty_count;
+
+	// Sized for the worst case up front, then trimmed, so the writes below never reallocate
+	ChunkSerializationSparseVector out(CHUNKSPAN_SERIALIZATION_HEADER_SIZE + 2 * MAX_VARINT_BYTES + palette.size() + runs * (1 + MAX_VARINT_BYTES));
+	uint8_t* p = out.data();
+	*p++ = CHUNKSPAN_SPARSE_SERIALIZATION_VERSION;
+	for (int32_t coord : {position.x, position.y, position.z}) {
+		std::memcpy(p, &coord, sizeof(int32_t));
+		p += sizeof(int32_t);
 	}
-	// Write count (uint32_t)
-	uint8_t* pcount = reinterpret_cast<uint8_t*>(&nonempty_count);
-	out.insert(out.end(), pcount, pcount + sizeof(uint32_t));
-	// Write (index, value) for each non-empty block
-	for (size_t i = 0; i < storage.size(); ++i) {
-		if (storage[i] != Block::Empty) {
-			uint32_t idx = static_cast<uint32_t>(i);
-			uint8_t* pidx = reinterpret_cast<uint8_t*>(&idx);
-			out.insert(out.end(), pidx, pidx + sizeof(uint32_t));
-			out.push_back(static_cast<uint8_t>(storage[i]));
-		}
+	p += writeVarint(p, static_cast<uint32_t>(palette.size()));
+	std::memcpy(p, palette.data(), palette.size());
+	p += palette.size();
+	p += writeVarint(p, static_cast<uint32_t>(runs));
+	// Each run: palette index byte, then varint length
+	size_t runStart = 0;
+	for (size_t r = 0; r < runs; ++r) {
+		*p++ = static_cast<uint8_t>(paletteIndex[static_cast<uint8_t>(blocks[runStart])]);
+		p += writeVarint(p, static_cast<uint32_t>(runEnds[r] - runStart));
+		runStart = runEnds[r];
 	}
+	out.resize(static_cast<size_t>(p - out.data()));
 	return out;
 }
 
-ChunkSpan::ChunkSpan(ChunkSerializationSparseVector& serializedData)
-	: storage{}, position{0,0,0}
+ChunkSpan::ChunkSpan(const ChunkSerializationSparseVector& serializedData)
+	: ChunkSpan(std::span<const uint8_t>(serializedData.data(), serializedData.size()))
 {
+}
+
+ChunkSpan::ChunkSpan(std::span<const uint8_t> serializedData)
+	: position{0,0,0}
+{
+	decode(serializedData);
+}
+
+ChunkSpan::ChunkSpan(std::string_view serializedData)
+	: position{0,0,0}
+{
+	decode(serializedData);
+}
+
+void ChunkSpan::decode(std::span<const uint8_t> serializedData) {
 	size_t offset = 0;
 	// Version
 	if (serializedData.size() < 1) throw std::runtime_error("Serialized data too short");
 	uint8_t version = serializedData[offset++];
-	if (version != CHUNKSPAN_SPARSE_SERIALIZATION_VERSION) throw std::runtime_error("Unknown ChunkSpan serialization version");
+	if (version != CHUNKSPAN_SPARSE_SERIALIZATION_VERSION && version != CHUNKSPAN_SPARSE_SERIALIZATION_VERSION_V1) {
+		throw std::runtime_error("Unknown ChunkSpan serialization version");
+	}
 	// Position
 	if (serializedData.size() < offset + 3 * sizeof(int32_t)) throw std::runtime_error("Serialized data too short for position");
 	int32_t pos[3];
@@ -55,13 +130,22 @@ ChunkSpan::ChunkSpan(ChunkSerializationSparseVector& serializedData)
 		offset += sizeof(int32_t);
 	}
 	const_cast<AbsoluteChunkPosition&>(position) = AbsoluteChunkPosition(pos[0], pos[1], pos[2]);
+	if (version == CHUNKSPAN_SPARSE_SERIALIZATION_VERSION_V1) {
+		// v1 only lists non-empty blocks
+		fill(Block::Empty);
+		deserializeV1(serializedData, offset);
+	} else {
+		deserializeV2(serializedData, offset);
+	}
+}
+
+void ChunkSpan::deserializeV1(std::span<const uint8_t> serializedData, size_t offset) {
 	// Non-empty count
 	if (serializedData.size() < offset + sizeof(uint32_t)) throw std::runtime_error("Serialized data too short for count");
 	uint32_t nonempty_count = 0;
 	std::memcpy(&nonempty_count, &serializedData[offset], sizeof(uint32_t));
 	offset += sizeof(uint32_t);
-	// Fill storage with Empty
-	storage.fill(Block::Empty);
+	// Storage starts out uniformly Empty
 	// Read (index, value) pairs
 	for (uint32_t i = 0; i < nonempty_count; ++i) {
 		if (serializedData.size() < offset + sizeof(uint32_t) + 1) throw std::runtime_error("Serialized data too short for block entry");
@@ -69,17 +153,315 @@ ChunkSpan::ChunkSpan(ChunkSerializationSparseVector& serializedData)
 		std::memcpy(&idx, &serializedData[offset], sizeof(uint32_t));
 		offset += sizeof(uint32_t);
 		uint8_t val = serializedData[offset++];
-		if (idx >= storage.size()) throw std::runtime_error("Block index out of range");
-		storage[idx] = static_cast<Block>(val);
+		if (idx >= CHUNK_BLOCK_COUNT) throw std::runtime_error("Block index out of range");
+		setBlock(idx, static_cast<Block>(val));
+	}
+	compact();
+}
+
+void ChunkSpan::deserializeV2(std::span<const uint8_t> serializedData, size_t offset) {
+	uint32_t paletteSize = readVarint(serializedData, offset);
+	if (paletteSize == 0 || paletteSize > 256) throw std::runtime_error("Invalid palette size");
+	if (serializedData.size() < offset + paletteSize) throw std::runtime_error("Serialized data too short for palette");
+	std::span<const uint8_t> palette = serializedData.subspan(offset, paletteSize);
+	offset += paletteSize;
+
+	uint32_t runs = readVarint(serializedData, offset);
+	if (runs == 0 || runs > CHUNK_BLOCK_COUNT) throw std::runtime_error("Invalid run count");
+	if (runs == 1) {
+		// Whole chunk is one block; skip the dense buffer
+		if (offset >= serializedData.size()) throw std::runtime_error("Serialized data too short for run");
+		uint8_t index = serializedData[offset++];
+		if (index >= paletteSize) throw std::runtime_error("Palette index out of range");
+		if (readVarint(serializedData, offset) != CHUNK_BLOCK_COUNT) throw std::runtime_error("Runs do not cover the chunk");
+		fill(static_cast<Block>(palette[index]));
+		return;
+	}
+
+	std::array<Block, CHUNK_BLOCK_COUNT> blocks;
+	size_t filled = 0;
+	for (uint32_t r = 0; r < runs; ++r) {
+		if (offset >= serializedData.size()) throw std::runtime_error("Serialized data too short for run");
+		uint8_t index = serializedData[offset++];
+		if (index >= paletteSize) throw std::runtime_error("Palette index out of range");
+		uint32_t length = readVarint(serializedData, offset);
+		if (length > CHUNK_BLOCK_COUNT - filled) throw std::runtime_error("Runs overflow the chunk");
+		std::fill_n(blocks.begin() + filled, length, static_cast<Block>(palette[index]));
+		filled += length;
 	}
+	if (filled != CHUNK_BLOCK_COUNT) throw std::runtime_error("Runs do not cover the chunk");
+	buildFromDense(blocks.data());
 }
 
 Block ChunkSpan::getBlock(const ChunkLocalPosition& localPos) const {
     size_t index = localPos.x + localPos.y * strideY + localPos.z * strideZ;
-    return storage[index];
+    return getBlock(index);
 }
 
 void ChunkSpan::setBlock(const ChunkLocalPosition& localPos, Block block) {
     size_t index = localPos.x + localPos.y * strideY + localPos.z * strideZ;
-    storage[index] = block;
+    setBlock(index, block);
+}
+
+Block ChunkSpan::getBlock(size_t index) const {
+    switch (mode_) {
+        case ChunkStorageMode::Uniform:  return uniform_;
+        case ChunkStorageMode::Paletted: return palette_[readIndex(index)];
+        case ChunkStorageMode::Dense:    return dense_[index];
+    }
+    return Block::Empty;
+}
+
+void ChunkSpan::setBlock(size_t index, Block block) {
+    const Block previous = getBlock(index);
+    // Rewriting the same block isn't a change; clients would refetch for nothing
+    if (block == previous) return;
+    ++version_;
+    storeBlock(index, block);
+    updateSummary(index, previous, block);
+}
+
+void ChunkSpan::storeBlock(size_t index, Block block) {
+    if (mode_ == ChunkStorageMode::Dense) {
+        dense_[index] = block;
+        return;
+    }
+    if (mode_ == ChunkStorageMode::Uniform) {
+        // The column heights were implied by the uniform block; from here on they're stored
+        columnHeights_.assign(CHUNK_COLUMN_COUNT, uniformColumnHeight());
+        // Promote to a two-entry palette; every existing block maps to index 0
+        palette_.assign({uniform_});
+        bitsPerIndex_ = 1;
+        packed_.assign(packedWordCount(bitsPerIndex_), 0);
+        mode_ = ChunkStorageMode::Paletted;
+    }
+
+    // Palette is at most CHUNK_MAX_PALETTE_SIZE entries, so this scan is bounded
+    auto it = std::find(palette_.begin(), palette_.end(), block);
+    std::uint32_t paletteIndex = static_cast<std::uint32_t>(it - palette_.begin());
+    if (it == palette_.end()) {
+        if (palette_.size() == (size_t{1} << bitsPerIndex_)) {
+            if (palette_.size() >= CHUNK_MAX_PALETTE_SIZE) {
+                promoteToDense();
+                dense_[index] = block;
+                return;
+            }
+            repack(static_cast<std::uint8_t>(bitsPerIndex_ * 2));
+        }
+        palette_.push_back(block);
+    }
+    writeIndex(index, paletteIndex);
+}
+
+void ChunkSpan::updateSummary(size_t index, Block previous, Block block) {
+    if (previous == Block::Empty) {
+        ++nonEmptyCount_;
+    } else if (block == Block::Empty) {
+        --nonEmptyCount_;
+    }
+    const size_t x = index % CHUNK_WIDTH;
+    const size_t y = (index / strideY) % CHUNK_HEIGHT;
+    const size_t z = index / strideZ;
+    std::uint8_t& height = columnHeights_[x + z * CHUNK_WIDTH];
+    if (block != Block::Empty) {
+        height = std::max(height, static_cast<std::uint8_t>(y + 1));
+    } else if (y + 1 == height) {
+        // The top block went; look down the column for the next one
+        size_t top = y;
+        while (top > 0 && getBlock(x + (top - 1) * strideY + z * strideZ) == Block::Empty) --top;
+        height = static_cast<std::uint8_t>(top);
+    }
+}
+
+void ChunkSpan::rebuildSummary(const Block* blocks) {
+    static_assert(CHUNK_HEIGHT < 256, "column heights must fit in uint8_t");
+    nonEmptyCount_ = static_cast<std::uint32_t>(countBlocksNotEqual(blocks, CHUNK_BLOCK_COUNT, Block::Empty));
+    columnHeights_.resize(CHUNK_COLUMN_COUNT);
+    for (size_t z = 0; z < CHUNK_DEPTH; ++z) {
+        for (size_t x = 0; x < CHUNK_WIDTH; ++x) {
+            size_t top = nonEmptyCount_ == 0 ? 0 : CHUNK_HEIGHT;
+            while (top > 0 && blocks[x + (top - 1) * strideY + z * strideZ] == Block::Empty) --top;
+            columnHeights_[x + z * CHUNK_WIDTH] = static_cast<std::uint8_t>(top);
+        }
+    }
+}
+
+void ChunkSpan::fill(Block block) {
+    ++version_;
+    mode_ = ChunkStorageMode::Uniform;
+    uniform_ = block;
+    bitsPerIndex_ = 0;
+    nonEmptyCount_ = block == Block::Empty ? 0 : static_cast<std::uint32_t>(CHUNK_BLOCK_COUNT);
+    // Release the memory rather than just clearing it; that's the point of uniform storage
+    BlockVector().swap(palette_);
+    WordVector().swap(packed_);
+    BlockVector().swap(dense_);
+    HeightVector().swap(columnHeights_);
+}
+
+void ChunkSpan::fillRange(size_t begin, size_t end, Block block) {
+    end = std::min(end, CHUNK_BLOCK_COUNT);
+    if (begin >= end) return;
+    if (begin == 0 && end == CHUNK_BLOCK_COUNT) {
+        fill(block);
+        return;
+    }
+    if (mode_ == ChunkStorageMode::Dense) {
+        ++version_;
+        fillBlocks(dense_.data() + begin, end - begin, block);
+        rebuildSummary(dense_.data());
+        return;
+    }
+    for (size_t i = begin; i < end; ++i) {
+        setBlock(i, block);
+    }
+}
+
+void ChunkSpan::copyTo(std::span<Block, CHUNK_BLOCK_COUNT> out) const {
+    switch (mode_) {
+        case ChunkStorageMode::Uniform:
+            std::fill(out.begin(), out.end(), uniform_);
+            break;
+        case ChunkStorageMode::Paletted:
+            for (size_t i = 0; i < CHUNK_BLOCK_COUNT; ++i) {
+                out[i] = palette_[readIndex(i)];
+            }
+            break;
+        case ChunkStorageMode::Dense:
+            std::copy(dense_.begin(), dense_.end(), out.begin());
+            break;
+    }
+}
+
+void ChunkSpan::assign(std::span<const Block, CHUNK_BLOCK_COUNT> blocks) {
+    ++version_;
+    buildFromDense(blocks.data());
+}
+
+void ChunkSpan::compact() {
+    if (mode_ == ChunkStorageMode::Uniform) return;
+    std::array<Block, CHUNK_BLOCK_COUNT> blocks;
+    copyTo(blocks);
+    buildFromDense(blocks.data());
+}
+
+std::uint64_t ChunkSpan::contentHash() const {
+    std::array<Block, CHUNK_BLOCK_COUNT> blocks;
+    copyTo(blocks);
+    // Multiply-xorshift over 8 blocks at a time, finished with the murmur3 finalizer
+    static_assert(CHUNK_BLOCK_COUNT % sizeof(std::uint64_t) == 0, "block count must be a multiple of 8");
+    std::uint64_t h = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < CHUNK_BLOCK_COUNT; i += sizeof(std::uint64_t)) {
+        std::uint64_t word;
+        std::memcpy(&word, &blocks[i], sizeof(word));
+        h = (h ^ word) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+    }
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    // 0 means "no hash" on the wire
+    return h != 0 ? h : 1;
+}
+
+size_t ChunkSpan::paletteSize() const {
+    switch (mode_) {
+        case ChunkStorageMode::Uniform:  return 1;
+        case ChunkStorageMode::Paletted: return palette_.size();
+        case ChunkStorageMode::Dense:    break;
+    }
+    return 0;
+}
+
+size_t ChunkSpan::storageBytes() const {
+    return sizeof(ChunkSpan)
+        + palette_.capacity() * sizeof(Block)
+        + packed_.capacity() * sizeof(std::uint64_t)
+        + dense_.capacity() * sizeof(Block)
+        + columnHeights_.capacity();
+}
+
+std::uint32_t ChunkSpan::readIndex(size_t index) const {
+    const size_t bit = index * bitsPerIndex_;
+    const std::uint64_t mask = (std::uint64_t{1} << bitsPerIndex_) - 1;
+    return static_cast<std::uint32_t>((packed_[bit >> 6] >> (bit & 63)) & mask);
+}
+
+void ChunkSpan::writeIndex(size_t index, std::uint32_t paletteIndex) {
+    const size_t bit = index * bitsPerIndex_;
+    const std::uint64_t mask = (std::uint64_t{1} << bitsPerIndex_) - 1;
+    std::uint64_t& word = packed_[bit >> 6];
+    word = (word & ~(mask << (bit & 63))) | ((static_cast<std::uint64_t>(paletteIndex) & mask) << (bit & 63));
+}
+
+void ChunkSpan::repack(std::uint8_t newBits) {
+    WordVector oldPacked(packedWordCount(newBits), 0);
+    oldPacked.swap(packed_);
+    const std::uint8_t oldBits = bitsPerIndex_;
+    const std::uint64_t oldMask = (std::uint64_t{1} << oldBits) - 1;
+    bitsPerIndex_ = newBits;
+    for (size_t i = 0; i < CHUNK_BLOCK_COUNT; ++i) {
+        const size_t bit = i * oldBits;
+        writeIndex(i, static_cast<std::uint32_t>((oldPacked[bit >> 6] >> (bit & 63)) & oldMask));
+    }
+}
+
+void ChunkSpan::promoteToDense() {
+    BlockVector dense(CHUNK_BLOCK_COUNT);
+    copyTo(std::span<Block, CHUNK_BLOCK_COUNT>(dense.data(), CHUNK_BLOCK_COUNT));
+    // The contents, and so the summary, are unchanged
+    BlockVector().swap(palette_);
+    WordVector().swap(packed_);
+    bitsPerIndex_ = 0;
+    dense_ = std::move(dense);
+    mode_ = ChunkStorageMode::Dense;
+}
+
+void ChunkSpan::buildFromDense(const Block* blocks) {
+    // Collect distinct blocks in order of first appearance, stopping once there are too many
+    std::array<bool, 256> seen{};
+    std::array<Block, CHUNK_MAX_PALETTE_SIZE + 1> palette;
+    size_t paletteSize = 0;
+    for (size_t i = 0; i < CHUNK_BLOCK_COUNT && paletteSize <= CHUNK_MAX_PALETTE_SIZE; ++i) {
+        auto raw = static_cast<uint8_t>(blocks[i]);
+        if (!seen[raw]) {
+            seen[raw] = true;
+            palette[paletteSize++] = blocks[i];
+        }
+    }
+
+    if (paletteSize == 1) {
+        fill(palette[0]);
+        return;
+    }
+
+    // Existing buffers are reused, so decoding into a pooled chunk doesn't allocate
+    ++version_;
+    uniform_ = palette[0];
+    rebuildSummary(blocks);
+    if (paletteSize > CHUNK_MAX_PALETTE_SIZE) {
+        palette_.clear();
+        packed_.clear();
+        bitsPerIndex_ = 0;
+        dense_.assign(blocks, blocks + CHUNK_BLOCK_COUNT);
+        mode_ = ChunkStorageMode::Dense;
+        return;
+    }
+
+    std::uint8_t bits = 1;
+    while ((size_t{1} << bits) < paletteSize) bits = static_cast<std::uint8_t>(bits * 2);
+
+    std::array<std::uint8_t, 256> lookup{};
+    for (size_t p = 0; p < paletteSize; ++p) {
+        lookup[static_cast<uint8_t>(palette[p])] = static_cast<std::uint8_t>(p);
+    }
+    // Paletted chunks are small; don't hold on to a dense buffer
+    BlockVector().swap(dense_);
+    mode_ = ChunkStorageMode::Paletted;
+    palette_.assign(palette.begin(), palette.begin() + paletteSize);
+    bitsPerIndex_ = bits;
+    packed_.assign(packedWordCount(bits), 0);
+    for (size_t i = 0; i < CHUNK_BLOCK_COUNT; ++i) {
+        writeIndex(i, lookup[static_cast<uint8_t>(blocks[i])]);
+    }
 }
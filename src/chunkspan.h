@@ -1,23 +1,44 @@
 #pragma once
 #include "position.h"
 #include "block.h"
+#include "block_storage_pool.h"
 #include "chunkdims.h"
 #include <cstdint>
 #include <array>
+#include <span>
+#include <string_view>
 #include <vector>
 
 typedef std::vector<uint8_t> ChunkSerializationSparseVector;
+
+/**
+ * @brief How a ChunkSpan currently stores its blocks.
+ * Chunks start out Uniform and are promoted only as their contents diversify.
+ */
+enum class ChunkStorageMode : uint8_t {
+    Uniform,  // every block is the same, stored as a single Block
+    Paletted, // up to CHUNK_MAX_PALETTE_SIZE distinct blocks, bit-packed palette indices
+    Dense     // one byte per block
+};
+
+// Largest palette kept before a chunk is promoted to dense storage (4 bits per block)
+constexpr size_t CHUNK_MAX_PALETTE_SIZE = 16;
+// Vertical (x, z) columns in a chunk, indexed x + z * CHUNK_WIDTH
+constexpr size_t CHUNK_COLUMN_COUNT = CHUNK_WIDTH * CHUNK_DEPTH;
+
 struct ChunkSpan {
 public:
-    std::array<Block, CHUNK_WIDTH * CHUNK_HEIGHT * CHUNK_DEPTH> storage; // Internal storage for the chunk data
     const std::uint32_t strideY = CHUNK_WIDTH;                   // distance between consecutive y elements
     const std::uint32_t strideZ = CHUNK_WIDTH * CHUNK_HEIGHT;    // distance between consecutive z slices
     const AbsoluteChunkPosition position{0,0,0}; // Optional: position of this chunk in world space
     ChunkSpan() = delete; // Prevent default constructor
     ChunkSpan(AbsoluteChunkPosition pos) : position(pos) {}
-    ChunkSpan(std::array<Block, CHUNK_WIDTH * CHUNK_HEIGHT * CHUNK_DEPTH> storage, AbsoluteChunkPosition pos = {0,0,0})
-        : storage(storage), position(pos) {};
-    ChunkSpan(ChunkSerializationSparseVector& serializedData);
+    ChunkSpan(const std::array<Block, CHUNK_BLOCK_COUNT>& storage, AbsoluteChunkPosition pos = {0,0,0});
+    ChunkSpan(const ChunkSerializationSparseVector& serializedData);
+    // Deserializes straight from borrowed bytes, e.g. a memory-mapped file or SQLite blob
+    explicit ChunkSpan(std::span<const uint8_t> serializedData);
+    // As above for a protobuf bytes field
+    explicit ChunkSpan(std::string_view serializedData);
     ChunkSpan(ChunkSpan& other) = default;
     ChunkSpan(const ChunkSpan& other) = default;
     ~ChunkSpan() = default;
@@ -25,9 +46,99 @@ public:
     ChunkSpan& operator=(const ChunkSpan& other) = default;
     ChunkSpan& operator=(ChunkSpan&& other) = default;
     ChunkSerializationSparseVector serialize() const;
-    
+    /**
+     * @brief Replaces position and contents with the serialized chunk, reusing this chunk's storage
+     * buffers, so a pooled ChunkSpan can decode one chunk after another without allocating.
+     * Throws std::runtime_error on malformed data, leaving the contents unspecified but valid.
+     * The version changes as for any write; set it afterwards as for a freshly decoded chunk.
+     */
+    void decode(std::span<const uint8_t> serializedData);
+    void decode(std::string_view serializedData) {
+        decode(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(serializedData.data()), serializedData.size()));
+    }
+
     // Access block at local coordinates within the chunk
     Block getBlock(const ChunkLocalPosition& localPos) const;
     void setBlock(const ChunkLocalPosition& localPos, Block block);
 
-};
\ No newline at end of file
+    // Access block by storage index (x + y * strideY + z * strideZ)
+    Block getBlock(size_t index) const;
+    void setBlock(size_t index, Block block);
+
+    // Set every block to the same value. Collapses the chunk to uniform storage.
+    void fill(Block block);
+    // Set blocks in the storage index range [begin, end) to the same value.
+    void fillRange(size_t begin, size_t end, Block block);
+    // Expand all blocks into a caller-owned buffer in storage order.
+    void copyTo(std::span<Block, CHUNK_BLOCK_COUNT> out) const;
+    // Replace all blocks from a buffer in storage order, picking the smallest storage mode.
+    void assign(std::span<const Block, CHUNK_BLOCK_COUNT> blocks);
+
+    /**
+     * @brief Re-derives the palette from the current contents and picks the smallest storage mode.
+     * setBlock never shrinks storage on its own, so call this after bulk edits such as generation.
+     */
+    void compact();
+
+    ChunkStorageMode storageMode() const { return mode_; }
+    bool isUniform() const { return mode_ == ChunkStorageMode::Uniform; }
+    // Only meaningful when isUniform() is true
+    Block uniformBlock() const { return uniform_; }
+    size_t paletteSize() const;
+
+    // Summary kept up to date by every write, so readers can skip chunks without scanning them
+    std::uint32_t nonEmptyCount() const { return nonEmptyCount_; }
+    // Every block is Block::Empty, whatever the storage mode
+    bool isEmpty() const { return nonEmptyCount_ == 0; }
+    // One above the highest non-Empty block in the column, 0 when the column is all Empty
+    std::uint8_t columnHeight(std::uint32_t x, std::uint32_t z) const {
+        if (mode_ == ChunkStorageMode::Uniform) return uniformColumnHeight();
+        return columnHeights_[x + z * CHUNK_WIDTH];
+    }
+
+    // Approximate heap + inline bytes used by block storage, for memory accounting.
+    size_t storageBytes() const;
+
+    /**
+     * @brief Incremented by every block write (setBlock, fill, fillRange, assign), so a copy with the
+     * same version has the same contents. Copies keep the version; it isn't serialized, the owner
+     * sets it with setVersion when a chunk is loaded or received.
+     */
+    std::uint64_t version() const { return version_; }
+    void setVersion(std::uint64_t version) { version_ = version; }
+    // Hash of the block contents only (not position, storage mode or version); never 0
+    std::uint64_t contentHash() const;
+
+private:
+    // Block storage comes from BlockStoragePool's size classes rather than the general heap
+    using BlockVector = PooledVector<Block>;
+    using WordVector = PooledVector<std::uint64_t>;
+    using HeightVector = PooledVector<std::uint8_t>;
+
+    ChunkStorageMode mode_ = ChunkStorageMode::Uniform;
+    Block uniform_ = Block::Empty;
+    BlockVector palette_;               // Paletted: palette index -> block
+    std::uint8_t bitsPerIndex_ = 0;     // Paletted: 1, 2 or 4, so indices never straddle a word
+    WordVector packed_;                 // Paletted: bit-packed palette indices
+    BlockVector dense_;                 // Dense: one entry per block
+    std::uint64_t version_ = 0;
+    std::uint32_t nonEmptyCount_ = 0;
+    HeightVector columnHeights_;        // Not Uniform: columnHeight for each column
+
+    std::uint8_t uniformColumnHeight() const { return uniform_ == Block::Empty ? 0 : CHUNK_HEIGHT; }
+    // setBlock without the version bump; block differs from the block there now
+    void storeBlock(size_t index, Block block);
+    // After one block changed from previous to block
+    void updateSummary(size_t index, Block previous, Block block);
+    // Recomputes the summary of a chunk that isn't Uniform from its blocks in storage order
+    void rebuildSummary(const Block* blocks);
+
+    std::uint32_t readIndex(size_t index) const;
+    void writeIndex(size_t index, std::uint32_t paletteIndex);
+    void repack(std::uint8_t newBits);
+    void promoteToDense();
+    void buildFromDense(const Block* blocks);
+    // Decode the body after the version byte and position, starting at offset
+    void deserializeV1(std::span<const uint8_t> serializedData, size_t offset);
+    void deserializeV2(std::span<const uint8_t> serializedData, size_t offset);
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <memory>
 #include <cstdint>
 #include <vector>
@@ -8,6 +9,8 @@
 #include "chunkdims.h"
 #include "position.h"
 #include "chunkspan.h"
+#include "block_kernels.h"
+#include "column_height_cache.h"
 #include "perlinnoise.hpp"
 #include <functional>
 
@@ -15,10 +18,37 @@
 class ChunkTransform;
 class CombinedChunkTransform;
 class MergeChunkTransform;
+
+// One vertical (x, z) column of a chunk, bottom to top
+using ChunkColumnBlocks = std::array<Block, CHUNK_HEIGHT>;
+
+// Where a column sits in the world
+struct ChunkColumn {
+    int64_t worldX;
+    int64_t worldZ;
+    int64_t worldYStart; // world y of ChunkColumnBlocks[0]
+};
+
 class ChunkTransform : public std::enable_shared_from_this<ChunkTransform> {
 public:
     virtual ~ChunkTransform() = default;
     virtual void apply(ChunkSpan& chunk) const = 0;
+
+    /**
+     * @brief Whether the transform treats every (x, z) column independently, so applyColumn gives the same result as apply.
+     * Column-separable trees can be fused by compile() into a single pass over the chunk.
+     */
+    virtual bool columnSeparable() const { return false; }
+    // Column-wise equivalent of apply; only called when columnSeparable() is true
+    virtual void applyColumn(const ChunkColumn& column, ChunkColumnBlocks& blocks) const {}
+
+    /**
+     * @brief Returns a transform equivalent to this one that evaluates column-separable subtrees in one fused pass,
+     * without the intermediate full-chunk copies the + and | nodes make. Parts that can't be fused
+     * (LambdaChunkTransform and other custom transforms) are kept as they are.
+     */
+    std::shared_ptr<ChunkTransform> compile() const;
+
     //operator overload to chain transforms
     /**
      * @brief Combines this transform with another transform, returning a new transform that applies both in sequence.
@@ -49,6 +79,15 @@ public:
         if (first_) first_->apply(chunk);
         if (second_) second_->apply(chunk);
     }
+    bool columnSeparable() const override {
+        return (!first_ || first_->columnSeparable()) && (!second_ || second_->columnSeparable());
+    }
+    void applyColumn(const ChunkColumn& column, ChunkColumnBlocks& blocks) const override {
+        if (first_) first_->applyColumn(column, blocks);
+        if (second_) second_->applyColumn(column, blocks);
+    }
+    const std::shared_ptr<ChunkTransform>& first() const { return first_; }
+    const std::shared_ptr<ChunkTransform>& second() const { return second_; }
 
 private:
     std::shared_ptr<ChunkTransform> first_;
@@ -66,15 +105,35 @@ public:
         ChunkSpan copiedChunkTwo(chunk);
         if (first_) first_->apply(copiedChunkOne);
         if (second_) second_->apply(copiedChunkTwo);
-        // merge results: where first is empty, take from second
-        for (size_t i = 0; i < chunk.storage.size(); ++i) {
-            if (copiedChunkOne.storage[i] != Block::Empty) {
-                chunk.storage[i] = copiedChunkOne.storage[i];
-            } else if (copiedChunkTwo.storage[i] != Block::Empty) {
-                chunk.storage[i] = copiedChunkTwo.storage[i];
+        // Both results are all Empty: nothing to merge in
+        if (copiedChunkOne.isEmpty() && copiedChunkTwo.isEmpty()) return;
+        // merge results: where first is empty, take from second, in one pass over expanded copies
+        std::array<Block, CHUNK_BLOCK_COUNT> merged, one, two;
+        chunk.copyTo(merged);
+        copiedChunkOne.copyTo(one);
+        copiedChunkTwo.copyTo(two);
+        mergeNonEmptyBlocks(merged.data(), one.data(), two.data(), CHUNK_BLOCK_COUNT);
+        chunk.assign(merged);
+    }
+    bool columnSeparable() const override {
+        return (!first_ || first_->columnSeparable()) && (!second_ || second_->columnSeparable());
+    }
+    void applyColumn(const ChunkColumn& column, ChunkColumnBlocks& blocks) const override {
+        // Same merge as apply, on two column-sized copies instead of two chunk copies
+        ChunkColumnBlocks one = blocks;
+        ChunkColumnBlocks two = blocks;
+        if (first_) first_->applyColumn(column, one);
+        if (second_) second_->applyColumn(column, two);
+        for (size_t y = 0; y < CHUNK_HEIGHT; ++y) {
+            if (one[y] != Block::Empty) {
+                blocks[y] = one[y];
+            } else if (two[y] != Block::Empty) {
+                blocks[y] = two[y];
             }
         }
     }
+    const std::shared_ptr<ChunkTransform>& first() const { return first_; }
+    const std::shared_ptr<ChunkTransform>& second() const { return second_; }
 
 private:
     std::shared_ptr<ChunkTransform> first_;
@@ -101,7 +160,11 @@ class EmptyChunkTransform : public ChunkTransform {
 public:
     void apply(ChunkSpan& chunk) const override {
         // Set all blocks to empty
-        std::fill(chunk.storage.begin(), chunk.storage.end(), Block::Empty);
+        chunk.fill(Block::Empty);
+    }
+    bool columnSeparable() const override { return true; }
+    void applyColumn(const ChunkColumn& column, ChunkColumnBlocks& blocks) const override {
+        blocks.fill(Block::Empty);
     }
 };
 
@@ -113,6 +176,7 @@ public:
     void apply(ChunkSpan& chunk) const override {
         // Do nothing
     }
+    bool columnSeparable() const override { return true; }
 };
 
 /**
@@ -123,7 +187,11 @@ public:
     FillChunkTransform(Block block) : block_(block) {}
     void apply(ChunkSpan& chunk) const override {
         // Fill all blocks with the specified block type 
-        std::fill(chunk.storage.begin(), chunk.storage.end(), block_);
+        chunk.fill(block_);
+    }
+    bool columnSeparable() const override { return true; }
+    void applyColumn(const ChunkColumn& column, ChunkColumnBlocks& blocks) const override {
+        blocks.fill(block_);
     }
 private:
     const Block block_;
@@ -141,41 +209,76 @@ private:
  * @param fillBlock The block type to fill when the noise value exceeds the threshold.
  * @param startHeight Mandatory absolute block position height offset to add to the noise value before applying the threshold. Blocks below this height are always filled.
  * @param maxHeight Maximum height (absolute block position) to fill. Mandatory.
+ * @param heightCache Optional cache of the noise per chunk column, shared across chunks and threads so each column's
+ * noise is computed once per world. Must come from makeHeightCache with the same noise, scale and octaves.
  */
 class PerlinNoiseChunkTransform : public ChunkTransform {
 public:
-    PerlinNoiseChunkTransform(std::shared_ptr<siv::PerlinNoise> noise, double scale, int octaves, double threshold, Block fillBlock, int startHeight, int maxHeight)
-        : noise_(noise), scale_(scale), octaves_(octaves), threshold_(threshold), fillBlock_(fillBlock), startHeight_(startHeight), maxHeight_(maxHeight) {
+    PerlinNoiseChunkTransform(std::shared_ptr<siv::PerlinNoise> noise, double scale, int octaves, double threshold, Block fillBlock, int startHeight, int maxHeight,
+                              std::shared_ptr<ColumnHeightCache> heightCache = nullptr)
+        : noise_(noise), scale_(scale), octaves_(octaves), threshold_(threshold), fillBlock_(fillBlock), startHeight_(startHeight), maxHeight_(maxHeight),
+          heightCache_(std::move(heightCache)) {
         if (!noise_) throw std::invalid_argument("PerlinNoiseChunkTransform requires a valid PerlinNoise instance");
         if (scale_ <= 0.0) throw std::invalid_argument("PerlinNoiseChunkTransform requires scale > 0.0");
         if (octaves_ <= 0) throw std::invalid_argument("PerlinNoiseChunkTransform requires octaves > 0");
         if (threshold_ < 0.0 || threshold_ > 1.0) throw std::invalid_argument("PerlinNoiseChunkTransform requires threshold in [0.0, 1.0]");
         if (startHeight_ >= maxHeight_) throw std::invalid_argument("PerlinNoiseChunkTransform requires startHeight < maxHeight");
     }
+    /**
+     * @brief Creates a column cache of this transform's noise for the given parameters.
+     */
+    static std::shared_ptr<ColumnHeightCache> makeHeightCache(std::shared_ptr<siv::PerlinNoise> noise, double scale, int octaves,
+                                                              size_t capacity = COLUMN_HEIGHT_CACHE_DEFAULT_CAPACITY) {
+        return std::make_shared<ColumnHeightCache>([noise, scale, octaves](int64_t worldX, int64_t worldZ) {
+            return sampleNoise(*noise, scale, octaves, worldX, worldZ);
+        }, capacity);
+    }
     void apply(ChunkSpan& chunk) const override {
         auto absPos = chunkOrigin(chunk.position);
+        std::shared_ptr<const ColumnHeightCache::Column> cached;
+        if (heightCache_) {
+            cached = heightCache_->column(chunk.position.x, chunk.position.z);
+        }
         for (int z = 0; z < CHUNK_DEPTH; ++z) {
-            for (int y = 0; y < CHUNK_HEIGHT; ++y) {
-                for (int x = 0; x < CHUNK_WIDTH; ++x) {
+            for (int x = 0; x < CHUNK_WIDTH; ++x) {
+                // The height only depends on (x, z)
+                double noiseValue = cached ? (*cached)[x + z * CHUNK_WIDTH]
+                                           : sampleNoise(*noise_, scale_, octaves_, absPos.x + x, absPos.z + z);
+                int height = toHeight(noiseValue);
+                for (int y = 0; y < CHUNK_HEIGHT; ++y) {
                     int index = x + y * chunk.strideY + z * chunk.strideZ;
                     // Only modify empty blocks
-                    if (chunk.storage[index] != Block::Empty) continue;
+                    if (chunk.getBlock(index) != Block::Empty) continue;
 
-                    int worldX = absPos.x + x;
                     int worldY = absPos.y + y;
-                    int worldZ = absPos.z + z;
-
-                    // Calculate noise value at this position
-                    double noiseValue = noise_->normalizedOctave2D_01(worldX / scale_, worldZ / scale_, octaves_);
-                    int height = static_cast<int>(noiseValue * (maxHeight_ - startHeight_)) + startHeight_;
                     if (worldY <= height && worldY <= maxHeight_) {
-                        chunk.storage[index] = fillBlock_;
+                        chunk.setBlock(index, fillBlock_);
                     }
                 }
             }
         }
     }
+    bool columnSeparable() const override { return true; }
+    void applyColumn(const ChunkColumn& column, ChunkColumnBlocks& blocks) const override {
+        // The height only depends on (x, z), so sample the noise once per column
+        double noiseValue = heightCache_ ? heightCache_->sample(column.worldX, column.worldZ)
+                                         : sampleNoise(*noise_, scale_, octaves_, column.worldX, column.worldZ);
+        int height = toHeight(noiseValue);
+        for (int y = 0; y < CHUNK_HEIGHT; ++y) {
+            int worldY = static_cast<int>(column.worldYStart) + y;
+            if (blocks[y] == Block::Empty && worldY <= height && worldY <= maxHeight_) {
+                blocks[y] = fillBlock_;
+            }
+        }
+    }
 private:
+    static double sampleNoise(const siv::PerlinNoise& noise, double scale, int octaves, int64_t worldX, int64_t worldZ) {
+        return noise.normalizedOctave2D_01(static_cast<int>(worldX) / scale, static_cast<int>(worldZ) / scale, octaves);
+    }
+    int toHeight(double noiseValue) const {
+        return static_cast<int>(noiseValue * (maxHeight_ - startHeight_)) + startHeight_;
+    }
+
     const std::shared_ptr<siv::PerlinNoise> noise_;
     const double scale_;
     const int octaves_;
@@ -183,6 +286,7 @@ private:
     const Block fillBlock_;
     const int startHeight_;
     const int maxHeight_;
+    const std::shared_ptr<ColumnHeightCache> heightCache_;
 };
 
 class HeightmapChunkTransform : public ChunkTransform {
@@ -191,18 +295,87 @@ public:
     void apply(ChunkSpan& chunk) const override {
         auto absPos = chunkOrigin(chunk.position);
         int globalYStart = static_cast<int>(absPos.y);
+        // Whole chunk below the surface: keep it uniform instead of writing every block
+        if (globalYStart + CHUNK_HEIGHT <= height_) {
+            chunk.fill(fillBlock_);
+            return;
+        }
+        // The layers below the surface sit at the bottom of each z slice, one contiguous range per slice
+        const int layers = std::clamp(height_ - globalYStart, 0, static_cast<int>(CHUNK_HEIGHT));
+        if (layers == 0) return;
+        std::array<Block, CHUNK_BLOCK_COUNT> blocks;
+        chunk.copyTo(blocks);
+        for (int z = 0; z < CHUNK_DEPTH; ++z) {
+            fillBlocks(blocks.data() + z * chunk.strideZ, static_cast<size_t>(layers) * chunk.strideY, fillBlock_);
+        }
+        chunk.assign(blocks);
+    }
+    bool columnSeparable() const override { return true; }
+    void applyColumn(const ChunkColumn& column, ChunkColumnBlocks& blocks) const override {
         for (int y = 0; y < CHUNK_HEIGHT; ++y) {
-            int globalY = globalYStart + y;
-            if (globalY < height_) {
-                for (int z = 0; z < CHUNK_DEPTH; ++z) {
-                    for (int x = 0; x < CHUNK_WIDTH; ++x) {
-                        chunk.storage[y * chunk.strideY + z * chunk.strideZ + x] = fillBlock_;
-                    }
-                }
+            if (column.worldYStart + y < height_) {
+                blocks[y] = fillBlock_;
             }
         }
     }
 private:
     const int height_;
     const Block fillBlock_;
-};
\ No newline at end of file
+};
+
+/**
+ * @brief Runs a column-separable transform tree in a single pass: each (x, z) column is
+ * gathered once, pushed through the whole tree in a small stack buffer, and written back,
+ * and the chunk's storage is rebuilt once at the end. Built by ChunkTransform::compile().
+ */
+class FusedChunkTransform : public ChunkTransform {
+public:
+    explicit FusedChunkTransform(std::shared_ptr<const ChunkTransform> root) : root_(std::move(root)) {}
+    void apply(ChunkSpan& chunk) const override {
+        std::array<Block, CHUNK_BLOCK_COUNT> blocks;
+        chunk.copyTo(blocks);
+        const auto origin = chunkOrigin(chunk.position);
+        ChunkColumnBlocks column;
+        for (int z = 0; z < CHUNK_DEPTH; ++z) {
+            for (int x = 0; x < CHUNK_WIDTH; ++x) {
+                const size_t base = x + z * chunk.strideZ;
+                for (int y = 0; y < CHUNK_HEIGHT; ++y) {
+                    column[y] = blocks[base + y * chunk.strideY];
+                }
+                root_->applyColumn(ChunkColumn{origin.x + x, origin.z + z, origin.y}, column);
+                for (int y = 0; y < CHUNK_HEIGHT; ++y) {
+                    blocks[base + y * chunk.strideY] = column[y];
+                }
+            }
+        }
+        chunk.assign(blocks);
+    }
+    bool columnSeparable() const override { return true; }
+    void applyColumn(const ChunkColumn& column, ChunkColumnBlocks& blocks) const override {
+        root_->applyColumn(column, blocks);
+    }
+
+private:
+    const std::shared_ptr<const ChunkTransform> root_;
+};
+
+inline std::shared_ptr<ChunkTransform> ChunkTransform::compile() const {
+    auto self = std::const_pointer_cast<ChunkTransform>(shared_from_this());
+    auto* combined = dynamic_cast<const CombinedChunkTransform*>(this);
+    auto* merge = dynamic_cast<const MergeChunkTransform*>(this);
+    if (!combined && !merge) {
+        // Leaves already run in one pass
+        return self;
+    }
+    if (columnSeparable()) {
+        return std::make_shared<FusedChunkTransform>(self);
+    }
+    // Fuse whatever can be fused below a node that can't be
+    auto compileChild = [](const std::shared_ptr<ChunkTransform>& child) {
+        return child ? child->compile() : child;
+    };
+    if (combined) {
+        return std::make_shared<CombinedChunkTransform>(compileChild(combined->first()), compileChild(combined->second()));
+    }
+    return std::make_shared<MergeChunkTransform>(compileChild(merge->first()), compileChild(merge->second()));
+}
@@ -1,7 +1,10 @@
 #include "client.h"
 #include "chunkdims.h"
+#include "chunk_arena.h"
 #include "chunkspan.h"
-#include <iostream>
+#include "chunk_write_behind.h"
+#include "region_chunk_persistence.h"
+#include "log.h"
 #include <algorithm>
 #include <chrono>
 #include <thread>
@@ -18,24 +21,35 @@ Client::~Client() {
     disconnect();
 }
 
+void Client::setDiskCacheDirectory(const std::filesystem::path& directory) {
+    std::lock_guard<std::mutex> lock(diskCacheMutex_);
+    diskCacheDirectory_ = directory;
+}
+
 bool Client::connect() {
     try {
         std::string server_address = host_ + ":" + std::to_string(port_);
         channel_ = grpc::CreateChannel(server_address, grpc::InsecureChannelCredentials());
         stub_ = blockserver::BlockServer::NewStub(channel_);
-        std::cout << "Connected to server at " << server_address << std::endl;
+        LOG_INFO("Connected to server at " << server_address);
         // Test connection with a ping
         connected_ = ping();
         
         if (connected_) {
+            openDiskCache();
             // Start background completion thread
             shouldStop_ = false;
             completionThread_ = std::thread(&Client::completionThreadFunc, this);
+            {
+                std::lock_guard<std::mutex> lock(blockEditMutex_);
+                blockEditsStopping_ = false;
+            }
+            blockEditSender_ = std::thread(&Client::blockEditSenderFunc, this);
         }
         
         return connected_;
     } catch (const std::exception& e) {
-        std::cerr << "Error connecting to server: " << e.what() << std::endl;
+        LOG_ERROR("Error connecting to server: " << e.what());
         handleRpcError(e);
         connected_ = false;
         return false;
@@ -50,10 +64,24 @@ void Client::disconnect() {
     
     // First mark as disconnected to stop new requests
     connected_ = false;
+    unsubscribeChunks();
+    closePlayerStream();
+    stopBlockEditSender();
     
-    // Stop the completion thread by shutting down the completion queue first
-    shouldStop_ = true;
-    cq_.Shutdown();  // This will cause AsyncNext to return false and unblock the thread
+    // Cancel what is in flight so the completion thread can drain the queue and exit
+    {
+        std::lock_guard<std::mutex> lock(callsMutex_);
+        shouldStop_ = true;
+        for (auto& [tag, call] : pending_calls_) {
+            call->cancelled = true;
+            call->context.TryCancel();
+        }
+        for (auto& [tag, call] : pending_lod_calls_) {
+            call->context.TryCancel();
+        }
+        requestScheduler_.clear();
+    }
+    cq_.Shutdown();  // Next() returns false once the cancelled calls have drained
     
     if (completionThread_.joinable()) {
         // Give it a reasonable timeout to join
@@ -62,40 +90,34 @@ void Client::disconnect() {
         });
         
         if (future.wait_for(std::chrono::seconds(2)) == std::future_status::timeout) {
-            std::cerr << "Warning: Completion thread did not join within timeout, detaching" << std::endl;
+            LOG_WARN("Completion thread did not join within timeout, detaching");
             completionThread_.detach();
         }
     }
     
-    // Wait for pending requests to complete with timeout
+    // Let responses already handed to the decode workers finish, with timeout
     const auto timeout = std::chrono::seconds(5);
     const auto start = std::chrono::steady_clock::now();
-    
-    while (getPendingRequestCount() > 0) {
-        // Check timeout
+    while (decodesInFlight_.load() > 0) {
         if (std::chrono::steady_clock::now() - start > timeout) {
-            std::cerr << "Warning: Disconnect timeout - " << getPendingRequestCount() 
-                      << " requests may still be pending" << std::endl;
+            LOG_WARN("Disconnect timeout - " << decodesInFlight_.load()
+                     << " responses may still be decoding");
             break;
         }
-        
-        // Process any completed requests to clean up the list
-        try {
-            processPendingRequests();
-        } catch (const std::exception& e) {
-            // Ignore errors during shutdown
-        }
-        
-        // Small delay to avoid busy waiting
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
     
-    // Shutdown completion queue and clear remaining requests
-    cq_.Shutdown();
+    // Clear whatever the completion thread didn't get to
     {
         std::lock_guard<std::mutex> lock(callsMutex_);
         pending_calls_.clear();
-        requestBacklog_.clear();
+        pending_lod_calls_.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(lodMutex_);
+        for (auto& requested : requestedLodChunks_) {
+            requested.clear();
+        }
     }
     
     {
@@ -112,6 +134,13 @@ void Client::disconnect() {
     // Now safe to destroy gRPC client
     stub_.reset();
     channel_.reset();
+    
+    {
+        std::lock_guard<std::mutex> lock(diskCacheMutex_);
+        diskWriter_.reset();
+        diskCache_.reset();
+        diskVersions_.clear();
+    }
 }
 
 bool Client::isConnected() const {
@@ -119,8 +148,100 @@ bool Client::isConnected() const {
 }
 
 void Client::setPlayerPosition(const AbsoluteBlockPosition& pos) {
-    std::lock_guard<std::mutex> lock(playerMutex_);
-    playerPosition_ = pos;
+    {
+        std::lock_guard<std::mutex> lock(playerMutex_);
+        playerPosition_ = pos;
+    }
+    
+    // Requests only need revisiting when the player crosses into another chunk
+    AbsoluteChunkPosition center = toAbsoluteChunk(pos);
+    {
+        std::lock_guard<std::mutex> lock(rescheduleMutex_);
+        if (ChunkPosEq{}(center, rescheduleCenter_)) {
+            return;
+        }
+        rescheduleCenter_ = center;
+        // A queued reschedule picks up the newest center when it runs
+        if (rescheduleQueued_) {
+            return;
+        }
+        rescheduleQueued_ = true;
+    }
+    // Cancelling and resending calls happens on a worker, off the render thread
+    decodesInFlight_.fetch_add(1);
+    try {
+        decodePool_.submit([this]() {
+            applyReschedule();
+            decodesInFlight_.fetch_sub(1);
+        });
+    } catch (const std::exception& e) {
+        decodesInFlight_.fetch_sub(1);
+        {
+            std::lock_guard<std::mutex> lock(rescheduleMutex_);
+            rescheduleQueued_ = false;
+        }
+        LOG_ERROR("Failed to queue chunk request rescheduling: " << e.what());
+    }
+}
+
+void Client::applyReschedule() {
+    AbsoluteChunkPosition center;
+    {
+        std::lock_guard<std::mutex> lock(rescheduleMutex_);
+        center = rescheduleCenter_;
+        rescheduleQueued_ = false;
+    }
+    std::vector<AbsoluteChunkPosition> dropped;
+    std::vector<std::shared_ptr<AsyncChunkCall>> calls;
+    {
+        std::lock_guard<std::mutex> lock(callsMutex_);
+        if (ChunkPosEq{}(center, requestScheduler_.center())) {
+            return;
+        }
+        dropped = rescheduleRequestsLocked(center);
+        if (isConnected()) {
+            calls = takeBacklogLocked();
+        }
+    }
+    releaseRequested(dropped);
+    sendChunkCalls(std::move(calls));
+}
+
+void Client::setViewDirection(double x, double y, double z) {
+    std::lock_guard<std::mutex> lock(callsMutex_);
+    // Queued positions are reordered when the next batch is taken
+    requestScheduler_.setViewDirection(x, y, z);
+}
+
+std::vector<AbsoluteChunkPosition> Client::rescheduleRequestsLocked(const AbsoluteChunkPosition& center) {
+    std::vector<AbsoluteChunkPosition> dropped = requestScheduler_.setCenter(center);
+    
+    // Cancel calls whose chunks are now mostly out of range; the rest of their chunks are requeued
+    for (auto& [tag, call] : pending_calls_) {
+        if (call->cancelled) {
+            continue;
+        }
+        size_t stale = 0;
+        for (const auto& pos : call->positions) {
+            stale += requestScheduler_.isStale(pos) ? 1 : 0;
+        }
+        if (stale * 2 < call->positions.size()) {
+            continue;
+        }
+        call->cancelled = true;
+        call->context.TryCancel();
+        cancelledRequests_.fetch_add(1, std::memory_order_relaxed);
+        for (const auto& pos : call->positions) {
+            if (requestScheduler_.isStale(pos)) {
+                dropped.push_back(pos);
+            } else {
+                requestScheduler_.enqueue(pos);
+            }
+        }
+    }
+    
+    // Dropped chunks can be requested again if the player comes back
+    return dropped;
 }
 
 AbsoluteBlockPosition Client::getPlayerPosition() const {
@@ -134,7 +255,7 @@ std::string Client::getPlayerId() const {
 
 bool Client::connectAsPlayer(const std::string& playerName, const AbsolutePrecisePosition& spawnPosition) {
     if (!isConnected()) {
-        std::cerr << "Client not connected to server" << std::endl;
+        LOG_ERROR("Client not connected to server");
         return false;
     }
     
@@ -155,6 +276,12 @@ bool Client::connectAsPlayer(const std::string& playerName, const AbsolutePrecis
                 std::lock_guard<std::mutex> lock(sessionMutex_);
                 sessionToken_ = response.session_token();
             }
+            {
+                // A new session starts from a full entity snapshot
+                std::lock_guard<std::mutex> lock(entitiesMutex_);
+                entities_.clear();
+                entityAck_ = 0;
+            }
             
             playerId_ = response.player_id();
             
@@ -166,12 +293,12 @@ bool Client::connectAsPlayer(const std::string& playerName, const AbsolutePrecis
             };
             setPlayerPosition(spawnBlock);
             
-            std::cout << "Successfully connected as player: " << playerName 
-                      << " at (" << response.actual_spawn_x() << ", " << response.actual_spawn_y() 
-                      << ", " << response.actual_spawn_z() << ")" << std::endl;
+            LOG_INFO("Successfully connected as player: " << playerName 
+                     << " at (" << response.actual_spawn_x() << ", " << response.actual_spawn_y() 
+                     << ", " << response.actual_spawn_z() << ")");
             return true;
         } else {
-            std::cerr << "Failed to connect as player: " << response.error_message() << std::endl;
+            LOG_ERROR("Failed to connect as player: " << response.error_message());
             return false;
         }
         
@@ -185,6 +312,10 @@ bool Client::refreshSession() {
     if (!isConnected()) {
         return false;
     }
+    // The player stream's own traffic keeps the session alive
+    if (playerStreamOpen_) {
+        return true;
+    }
     
     std::string token;
     {
@@ -208,7 +339,7 @@ bool Client::refreshSession() {
         if (status.ok() && response.success()) {
             return true;
         } else {
-            std::cerr << "Failed to refresh session: " << response.error_message() << std::endl;
+            LOG_ERROR("Failed to refresh session: " << response.error_message());
             // Clear invalid session
             {
                 std::lock_guard<std::mutex> lock(sessionMutex_);
@@ -235,10 +366,21 @@ bool Client::updatePlayerPosition(const AbsolutePrecisePosition& position) {
     }
     
     if (token.empty()) {
-        std::cerr << "No valid session token for position update" << std::endl;
+        LOG_ERROR("No valid session token for position update");
         return false;
     }
     
+    if (playerStreamOpen_) {
+        // Only the newest sample matters; the writer thread picks it up
+        {
+            std::lock_guard<std::mutex> lock(playerStreamMutex_);
+            pendingSample_ = position;
+        }
+        playerStreamWake_.notify_one();
+        setPlayerPosition(toAbsoluteBlock(position));
+        return true;
+    }
+    
     try {
         blockserver::UpdatePlayerPositionRequest request;
         request.set_session_token(token);
@@ -257,7 +399,7 @@ bool Client::updatePlayerPosition(const AbsolutePrecisePosition& position) {
             setPlayerPosition(blockPos);
             return true;
         } else {
-            std::cerr << "Failed to update player position: " << response.error_message() << std::endl;
+            LOG_ERROR("Failed to update player position: " << response.error_message());
             if (response.error_message().find("Invalid or expired session") != std::string::npos) {
                 // Clear invalid session
                 std::lock_guard<std::mutex> lock(sessionMutex_);
@@ -276,6 +418,7 @@ bool Client::disconnectPlayer() {
     if (!isConnected()) {
         return false;
     }
+    closePlayerStream();
     
     std::string token;
     {
@@ -302,10 +445,10 @@ bool Client::disconnectPlayer() {
         }
         
         if (status.ok() && response.success()) {
-            std::cout << "Successfully disconnected player" << std::endl;
+            LOG_INFO("Successfully disconnected player");
             return true;
         } else {
-            std::cerr << "Failed to disconnect player: " << response.error_message() << std::endl;
+            LOG_ERROR("Failed to disconnect player: " << response.error_message());
             return false;
         }
         
@@ -329,6 +472,189 @@ std::string Client::getSessionToken() const {
     return sessionToken_;
 }
 
+bool Client::pollEntityUpdates(int32_t viewRadius) {
+    if (!isConnected()) {
+        return false;
+    }
+    
+    std::string token = getSessionToken();
+    if (token.empty()) {
+        return false;
+    }
+    
+    try {
+        blockserver::GetEntityUpdatesRequest request;
+        request.set_session_token(token);
+        request.set_view_radius(viewRadius);
+        {
+            std::lock_guard<std::mutex> lock(entitiesMutex_);
+            request.set_ack_sequence(entityAck_);
+        }
+        
+        blockserver::GetEntityUpdatesResponse response;
+        grpc::ClientContext context;
+        grpc::Status status = stub_->GetEntityUpdates(&context, request, &response);
+        if (!status.ok() || !response.success()) {
+            LOG_ERROR("Failed to get entity updates: " << (status.ok() ? response.error_message() : status.error_message()));
+            return false;
+        }
+        
+        std::lock_guard<std::mutex> lock(entitiesMutex_);
+        if (response.full()) {
+            entities_.clear();
+        }
+        for (const auto& update : response.updates()) {
+            EntityDelta delta;
+            delta.entity = update.entity_id();
+            delta.removed = update.removed();
+            if (!delta.removed) {
+                const std::string& data = update.snapshot_data();
+                decodeEntityComponents(std::vector<uint8_t>(data.begin(), data.end()), delta);
+            }
+            entities_.apply(delta);
+        }
+        entityAck_ = response.sequence();
+        return true;
+    } catch (const std::exception& e) {
+        handleRpcError(e);
+        // Resync from a full snapshot next time
+        std::lock_guard<std::mutex> lock(entitiesMutex_);
+        entityAck_ = 0;
+        return false;
+    }
+}
+
+bool Client::openPlayerStream() {
+    if (!isConnected()) {
+        return false;
+    }
+    std::string token = getSessionToken();
+    if (token.empty()) {
+        LOG_ERROR("No valid session token for player stream");
+        return false;
+    }
+    
+    closePlayerStream();
+    std::lock_guard<std::mutex> lifecycle(playerStreamLifecycleMutex_);
+    playerStreamContext_ = std::make_unique<grpc::ClientContext>();
+    playerStream_ = stub_->PlayerStream(playerStreamContext_.get());
+    {
+        std::lock_guard<std::mutex> lock(playerStreamMutex_);
+        playerStreamClosing_ = false;
+        pendingSample_.reset();
+    }
+    appliedInputSequence_ = 0;
+    playerStreamOpen_ = true;
+    playerStreamWriter_ = std::thread(&Client::playerStreamWriterFunc, this, std::move(token));
+    playerStreamReader_ = std::thread(&Client::playerStreamReaderFunc, this);
+    return true;
+}
+
+void Client::closePlayerStream() {
+    std::lock_guard<std::mutex> lifecycle(playerStreamLifecycleMutex_);
+    if (!playerStream_) {
+        return;
+    }
+    playerStreamOpen_ = false;
+    {
+        std::lock_guard<std::mutex> lock(playerStreamMutex_);
+        playerStreamClosing_ = true;
+    }
+    playerStreamWake_.notify_all();
+    if (playerStreamWriter_.joinable()) {
+        playerStreamWriter_.join();
+    }
+    // Unblocks the reader even if the server never saw our WritesDone
+    playerStreamContext_->TryCancel();
+    if (playerStreamReader_.joinable()) {
+        playerStreamReader_.join();
+    }
+    // Only once neither thread is in Read, Write or WritesDone, which Finish mustn't overlap
+    auto status = playerStream_->Finish();
+    if (!status.ok() && status.error_code() != grpc::StatusCode::CANCELLED) {
+        LOG_ERROR("Player stream failed: " << status.error_message());
+    }
+    playerStream_.reset();
+    playerStreamContext_.reset();
+}
+
+bool Client::isPlayerStreamOpen() const {
+    return playerStreamOpen_;
+}
+
+uint64_t Client::getAppliedInputSequence() const {
+    return appliedInputSequence_;
+}
+
+void Client::playerStreamWriterFunc(std::string sessionToken) {
+    blockserver::PlayerInput input;
+    input.set_session_token(std::move(sessionToken));
+    bool first = true;
+    for (;;) {
+        std::optional<AbsolutePrecisePosition> sample;
+        {
+            std::unique_lock<std::mutex> lock(playerStreamMutex_);
+            if (!first) {
+                playerStreamWake_.wait_for(lock, kPlayerStreamKeepalive, [this] {
+                    return playerStreamClosing_ || pendingSample_.has_value();
+                });
+            }
+            if (playerStreamClosing_) {
+                break;
+            }
+            sample.swap(pendingSample_);
+        }
+        if (sample) {
+            input.set_sequence(++nextInputSequence_);
+            input.set_x(sample->x);
+            input.set_y(sample->y);
+            input.set_z(sample->z);
+        } else {
+            input.clear_x();
+            input.clear_y();
+            input.clear_z();
+        }
+        if (!playerStream_->Write(input)) {
+            break;
+        }
+        if (first) {
+            // Only the first message needs the token
+            input.clear_session_token();
+            first = false;
+        }
+    }
+    playerStream_->WritesDone();
+}
+
+void Client::playerStreamReaderFunc() {
+    blockserver::PlayerStreamEvent event;
+    while (playerStream_->Read(&event)) {
+        if (event.applied_sequence() > appliedInputSequence_) {
+            appliedInputSequence_ = event.applied_sequence();
+        }
+        if (!event.session_valid()) {
+            LOG_ERROR("Player stream ended: " << event.error_message());
+            {
+                std::lock_guard<std::mutex> lock(sessionMutex_);
+                sessionToken_.clear();
+            }
+            break;
+        }
+    }
+    playerStreamOpen_ = false;
+    {
+        // Stop the writer too; closePlayerStream() joins both threads, then finishes the call
+        std::lock_guard<std::mutex> lock(playerStreamMutex_);
+        playerStreamClosing_ = true;
+    }
+    playerStreamWake_.notify_all();
+}
+
+void Client::readEntities(const std::function<void(const GameRegistry&)>& fn) const {
+    std::lock_guard<std::mutex> lock(entitiesMutex_);
+    fn(entities_.registry());
+}
+
 std::optional<std::shared_ptr<ChunkSpan>> Client::requestChunk(const AbsoluteChunkPosition& pos) {
     // Check cache first
     auto cached = getCachedChunk(pos);
@@ -344,180 +670,423 @@ std::optional<std::shared_ptr<ChunkSpan>> Client::requestChunk(const AbsoluteChu
 }
 
 void Client::requestChunkAsync(const AbsoluteChunkPosition& pos) {
+    requestChunksAsync(std::span<const AbsoluteChunkPosition>(&pos, 1));
+}
+
+void Client::requestChunksAsync(std::span<const AbsoluteChunkPosition> positions) {
     if (!isConnected()) {
-        std::cerr << "Client not connected" << std::endl;
+        LOG_ERROR("Client not connected");
         return;
     }
     
-    // Check if already requested
+    // Queue everything first so the whole set goes out in as few GetChunks calls as possible
+    std::vector<AbsoluteChunkPosition> added;
     {
-        std::lock_guard<std::mutex> lock(requestedChunksMutex_);
-        if (requestedChunks_.find(pos) != requestedChunks_.end()) {
-            return; // Already requested
+        std::lock_guard<std::mutex> requestedLock(requestedChunksMutex_);
+        for (const auto& pos : positions) {
+            if (requestedChunks_.insert(pos).second) {
+                added.push_back(pos);
+            }
         }
-        requestedChunks_.insert(pos);
     }
-    
-    // Respect in-flight limit; if saturated, push to backlog to send later
+    std::vector<std::shared_ptr<AsyncChunkCall>> calls;
     {
         std::lock_guard<std::mutex> lock(callsMutex_);
-        if (pending_calls_.size() >= kMaxInflightRequests) {
-            requestBacklog_.push_back(pos);
-            return;
+        for (const auto& pos : added) {
+            requestScheduler_.enqueue(pos);
         }
+        calls = takeBacklogLocked();
     }
+    sendChunkCalls(std::move(calls));
+}
 
-    try {
-        // Create async call structure
-        auto call = std::make_unique<AsyncChunkCall>();
-        call->position = pos;
-        *call->request.mutable_player_position() = createPlayerPositionMessage();
-        call->request.set_x(pos.x);
-        call->request.set_y(pos.y);
-        call->request.set_z(pos.z);
-        call->request_time = std::chrono::steady_clock::now();
-        
-        // Start async call
-        call->response_reader = stub_->AsyncGetChunk(&call->context, call->request, &cq_);
-        
-        // Use the call pointer as tag for completion queue
-        void* tag = call.get();
-        call->response_reader->Finish(&call->response, &call->status, tag);
-        
-        // Store call for later processing
+void Client::requestLodChunksAsync(uint32_t level, std::span<const AbsoluteChunkPosition> positions) {
+    if (!isConnected()) {
+        LOG_ERROR("Client not connected");
+        return;
+    }
+    if (level < 1 || level > CHUNK_LOD_LEVELS) {
+        LOG_ERROR("No LOD level " << level);
+        return;
+    }
+    // The server only answers positions around where we are
+    const blockserver::PlayerPosition playerPosition = createPlayerPositionMessage();
+    const std::string sessionToken = getSessionToken();
+    
+    std::lock_guard<std::mutex> lock(callsMutex_);
+    // The completion queue may already be shut down
+    if (shouldStop_) {
+        return;
+    }
+    std::shared_ptr<AsyncLodChunkCall> call;
+    auto send = [&]() {
+        try {
+            call->response_reader = stub_->AsyncGetLodChunks(&call->context, call->request, &cq_);
+            void* tag = call.get();
+            call->response_reader->Finish(&call->response, &call->status, tag);
+            pending_lod_calls_[tag] = std::move(call);
+        } catch (const std::exception& e) {
+            handleRpcError(e);
+            std::lock_guard<std::mutex> lodLock(lodMutex_);
+            for (const auto& pos : call->positions) {
+                requestedLodChunks_[level - 1].erase(pos);
+            }
+        }
+        call.reset();
+    };
+    for (const auto& pos : positions) {
+        uint64_t knownVersion = 0;
         {
-            std::lock_guard<std::mutex> lock(callsMutex_);
-            pending_calls_[tag] = std::move(call);
+            std::lock_guard<std::mutex> lodLock(lodMutex_);
+            if (!requestedLodChunks_[level - 1].insert(pos).second) {
+                continue;
+            }
+            auto cached = lodChunks_[level - 1].find(pos);
+            if (cached != lodChunks_[level - 1].end()) {
+                knownVersion = cached->second->version();
+            }
+        }
+        if (!call) {
+            call = std::make_shared<AsyncLodChunkCall>();
+            call->level = level;
+            call->request.set_level(level);
+            *call->request.mutable_player_position() = playerPosition;
+            call->request.set_session_token(sessionToken);
+        }
+        call->positions.push_back(pos);
+        auto* position = call->request.add_positions();
+        position->set_x(pos.x);
+        position->set_y(pos.y);
+        position->set_z(pos.z);
+        call->request.add_known_versions(knownVersion);
+        if (call->positions.size() == kMaxLodChunksPerRequest) {
+            send();
         }
+    }
+    if (call) {
+        send();
+    }
+}
 
-    } catch (const std::exception& e) {
-        handleRpcError(e);
-        // Remove from requested chunks on error
-        std::lock_guard<std::mutex> lock(requestedChunksMutex_);
-        requestedChunks_.erase(pos);
+std::vector<std::pair<uint32_t, AbsoluteChunkPosition>> Client::takeArrivedLodChunks() {
+    std::vector<std::pair<uint32_t, AbsoluteChunkPosition>> arrived;
+    while (auto entry = readyLodChunks_.pop()) {
+        arrived.push_back(*entry);
     }
+    return arrived;
 }
 
-void Client::processPendingRequests() {
-    // Early exit if not connected to avoid processing during shutdown
-    if (!isConnected() && stub_ == nullptr) {
-        // If we're in shutdown mode, still clean up pending calls
+std::shared_ptr<const ChunkSpan> Client::getCachedLodChunk(uint32_t level, const AbsoluteChunkPosition& pos) const {
+    if (level < 1 || level > CHUNK_LOD_LEVELS) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(lodMutex_);
+    auto cached = lodChunks_[level - 1].find(pos);
+    return cached != lodChunks_[level - 1].end() ? cached->second : nullptr;
+}
+
+size_t Client::evictLodChunks(uint32_t level, const AbsoluteChunkPosition& center, int32_t keepDistance) {
+    if (level < 1 || level > CHUNK_LOD_LEVELS) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(lodMutex_);
+    auto& cached = lodChunks_[level - 1];
+    std::vector<AbsoluteChunkPosition> far;
+    for (const auto& [pos, chunk] : cached) {
+        const int32_t distance = std::max({std::abs(pos.x - center.x), std::abs(pos.y - center.y), std::abs(pos.z - center.z)});
+        if (distance > keepDistance) {
+            far.push_back(pos);
+        }
+    }
+    for (const auto& pos : far) {
+        cached.erase(pos);
+    }
+    return far.size();
+}
+
+size_t Client::activeCallsLocked() const {
+    size_t active = 0;
+    for (const auto& entry : pending_calls_) {
+        active += entry.second->cancelled ? 0 : 1;
+    }
+    return active + preparingCalls_;
+}
+
+std::vector<std::shared_ptr<AsyncChunkCall>> Client::takeBacklogLocked() {
+    std::vector<std::shared_ptr<AsyncChunkCall>> calls;
+    // The completion queue may already be shut down
+    if (shouldStop_) {
+        return calls;
+    }
+    // Respect the in-flight limit; whatever doesn't fit is sent, most urgent first, as calls complete
+    while (requestScheduler_.size() > 0 && activeCallsLocked() < requestScheduler_.inflightLimit()) {
+        // Spread what is queued over the calls allowed, so they are served side by side
+        size_t limit = requestScheduler_.inflightLimit();
+        size_t batchSize = std::clamp((requestScheduler_.size() + limit - 1) / limit, kMinChunksPerRequest, kMaxChunksPerRequest);
+        auto call = std::make_shared<AsyncChunkCall>();
+        call->positions = requestScheduler_.takeBatch(batchSize);
+        ++preparingCalls_;
+        calls.push_back(std::move(call));
+    }
+    return calls;
+}
+
+void Client::sendChunkCalls(std::vector<std::shared_ptr<AsyncChunkCall>> calls) {
+    while (!calls.empty()) {
+        bool freedCapacity = false;
+        for (auto& call : calls) {
+            // Skip chunks that arrived (e.g. pushed by the subscription) while queued
+            std::vector<AbsoluteChunkPosition> wanted;
+            std::vector<AbsoluteChunkPosition> arrived;
+            {
+                std::lock_guard<std::mutex> cacheLock(cacheMutex_);
+                for (const auto& pos : call->positions) {
+                    (cachedChunks_.contains(pos) ? arrived : wanted).push_back(pos);
+                }
+            }
+            releaseRequested(arrived);
+            call->positions = std::move(wanted);
+            for (const auto& pos : call->positions) {
+                auto* position = call->request.add_positions();
+                position->set_x(pos.x);
+                position->set_y(pos.y);
+                position->set_z(pos.z);
+
+                // Offer a disk-cached copy so the server can skip sending it
+                auto diskCopy = loadFromDiskCache(pos);
+                call->request.add_known_versions(diskCopy ? diskCopy->version() : 0);
+                call->request.add_known_hashes(diskCopy ? diskCopy->contentHash() : 0);
+                call->diskCopies.push_back(std::move(diskCopy));
+            }
+            *call->request.mutable_player_position() = createPlayerPositionMessage();
+            // Lets the server load misses near us; those it can't answer yet arrive on the subscription
+            call->request.set_session_token(getSessionToken());
+
+            std::lock_guard<std::mutex> lock(callsMutex_);
+            --preparingCalls_;
+            if (call->positions.empty() || shouldStop_) {
+                freedCapacity = freedCapacity || !shouldStop_;
+                if (shouldStop_) {
+                    std::lock_guard<std::mutex> requestedLock(requestedChunksMutex_);
+                    for (const auto& pos : call->positions) {
+                        requestedChunks_.erase(pos);
+                    }
+                }
+                continue;
+            }
+            try {
+                call->request_time = std::chrono::steady_clock::now();
+                call->response_reader = stub_->AsyncGetChunks(&call->context, call->request, &cq_);
+
+                // Use the call pointer as tag for completion queue
+                void* tag = call.get();
+                call->response_reader->Finish(&call->response, &call->status, tag);
+                pending_calls_[tag] = std::move(call);
+            } catch (const std::exception& e) {
+                handleRpcError(e);
+                // Remove from requested chunks on error
+                std::lock_guard<std::mutex> requestedLock(requestedChunksMutex_);
+                for (const auto& pos : call->positions) {
+                    requestedChunks_.erase(pos);
+                }
+            }
+        }
+        calls.clear();
+        // A call that had nothing left to ask for leaves room for the next batch
+        if (freedCapacity) {
+            std::lock_guard<std::mutex> lock(callsMutex_);
+            calls = takeBacklogLocked();
+        }
+    }
+}
+
+void Client::handleCompletedCall(void* tag, bool ok) {
+    std::shared_ptr<AsyncChunkCall> call;
+    {
         std::lock_guard<std::mutex> lock(callsMutex_);
-        pending_calls_.clear();
-        return;
+        auto it = pending_calls_.find(tag);
+        if (it != pending_calls_.end()) {
+            call = std::move(it->second);
+            pending_calls_.erase(it);
+        }
     }
     
-    void* tag;
-    bool ok;
-    
-    // Process all ready completions (non-blocking)
-    while (cq_.AsyncNext(&tag, &ok, std::chrono::system_clock::now() + std::chrono::milliseconds(10)) == grpc::CompletionQueue::GOT_EVENT) {
-        std::unique_ptr<AsyncChunkCall> call;
-        
+    if (!call) {
+        std::shared_ptr<AsyncLodChunkCall> lodCall;
         {
             std::lock_guard<std::mutex> lock(callsMutex_);
-            auto it = pending_calls_.find(tag);
-            if (it != pending_calls_.end()) {
-                call = std::move(it->second);
-                pending_calls_.erase(it);
+            auto it = pending_lod_calls_.find(tag);
+            if (it != pending_lod_calls_.end()) {
+                lodCall = std::move(it->second);
+                pending_lod_calls_.erase(it);
             }
         }
-        
-        if (!call) continue;
-        
+        if (lodCall) {
+            handleCompletedLodCall(lodCall, ok);
+        }
+        return;
+    }
+    
+    // A cancelled call that finished first is still used; one that was cut short is expected
+    const bool cutShort = call->cancelled && (!ok || call->status.error_code() == grpc::StatusCode::CANCELLED);
+    const bool succeeded = !cutShort && ok && call->status.ok() && call->response.success();
+    if (succeeded) {
+        // Decoding and caching happen on a worker; its positions stay requested until they are cached
+        decodesInFlight_.fetch_add(1);
         try {
-            if (ok && call->status.ok() && call->response.success()) {
-                if (call->response.has_chunk_data()) {
-                    const std::string& chunkDataStr = call->response.chunk_data();
-                    std::vector<uint8_t> serializedData(chunkDataStr.begin(), chunkDataStr.end());
-                    
-                    std::cout << "Got response for chunk (" << call->position.x << ", " 
-                              << call->position.y << ", " << call->position.z 
-                              << ") - Data size: " << serializedData.size() << " bytes" << std::endl;
-                    
-                    // Deserialize the chunk directly
-                    try {
-                        auto chunk = std::make_shared<ChunkSpan>(serializedData);
-                        cacheChunk(call->position, chunk);
-                        
-                        std::cout << "Loaded chunk (" << call->position.x << ", " 
-                                  << call->position.y << ", " << call->position.z << ")" << std::endl;
-                    } catch (const std::exception& e) {
-                        std::cerr << "Failed to deserialize chunk data for position (" 
-                                  << call->position.x << ", " << call->position.y << ", " 
-                                  << call->position.z << "): " << e.what() << std::endl;
-                    }
-                }
-            } else {
-                std::cerr << "gRPC error for chunk (" << call->position.x << ", " 
-                          << call->position.y << ", " << call->position.z << "): ";
-                if (!call->status.ok()) {
-                    std::cerr << call->status.error_message();
-                } else if (!ok) {
-                    std::cerr << "Completion queue error";
-                } else {
-                    std::cerr << call->response.error_message();
-                }
-                std::cerr << std::endl;
-            }
+            decodePool_.submit([this, call]() {
+                decodeResponse(*call);
+                decodesInFlight_.fetch_sub(1);
+            });
         } catch (const std::exception& e) {
+            decodesInFlight_.fetch_sub(1);
             handleRpcError(e);
         }
-        
-        // Remove from requested chunks
-        {
-            std::lock_guard<std::mutex> requestedLock(requestedChunksMutex_);
-            requestedChunks_.erase(call->position);
+    } else {
+        if (!cutShort) {
+            LOG_ERROR("gRPC error for " << call->positions.size() << " chunks: "
+                      << (!call->status.ok() ? call->status.error_message() : !ok ? "Completion queue error" : call->response.error_message()));
         }
-        
-        // Drain backlog up to capacity
-        {
-            std::lock_guard<std::mutex> lock(callsMutex_);
-            while (!requestBacklog_.empty() && pending_calls_.size() < kMaxInflightRequests) {
-                AbsoluteChunkPosition next = requestBacklog_.front();
-                requestBacklog_.pop_front();
-                
-                // Double-check it wasn't satisfied while in backlog
-                {
-                    std::lock_guard<std::mutex> cacheLock(cacheMutex_);
-                    if (cachedChunks_.find(next) != cachedChunks_.end()) {
-                        std::lock_guard<std::mutex> requestedLock(requestedChunksMutex_);
-                        requestedChunks_.erase(next);
-                        continue;
-                    }
-                }
-                
-                try {
-                    // Create new async call for backlog item
-                    auto backlogCall = std::make_unique<AsyncChunkCall>();
-                    backlogCall->position = next;
-                    *backlogCall->request.mutable_player_position() = createPlayerPositionMessage();
-                    backlogCall->request.set_x(next.x);
-                    backlogCall->request.set_y(next.y);
-                    backlogCall->request.set_z(next.z);
-                    backlogCall->request_time = std::chrono::steady_clock::now();
-                    
-                    backlogCall->response_reader = stub_->AsyncGetChunk(&backlogCall->context, backlogCall->request, &cq_);
-                    
-                    void* backlogTag = backlogCall.get();
-                    backlogCall->response_reader->Finish(&backlogCall->response, &backlogCall->status, backlogTag);
-                    
-                    pending_calls_[backlogTag] = std::move(backlogCall);
-                    
-                } catch (const std::exception& e) {
-                    handleRpcError(e);
-                    std::lock_guard<std::mutex> requestedLock(requestedChunksMutex_);
-                    requestedChunks_.erase(next);
+        releaseRequested(*call);
+    }
+    
+    // Drain backlog up to capacity
+    std::vector<std::shared_ptr<AsyncChunkCall>> calls;
+    {
+        std::lock_guard<std::mutex> lock(callsMutex_);
+        if (!call->cancelled && ok && call->status.ok()) {
+            requestScheduler_.recordRoundTrip(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - call->request_time), call->positions.size());
+        }
+        calls = takeBacklogLocked();
+    }
+    sendChunkCalls(std::move(calls));
+}
+
+void Client::handleCompletedLodCall(const std::shared_ptr<AsyncLodChunkCall>& call, bool ok) {
+    if (ok && call->status.ok() && call->response.success()) {
+        decodesInFlight_.fetch_add(1);
+        try {
+            decodePool_.submit([this, call]() {
+                decodeLodResponse(*call);
+                decodesInFlight_.fetch_sub(1);
+            });
+            return;
+        } catch (const std::exception& e) {
+            decodesInFlight_.fetch_sub(1);
+            handleRpcError(e);
+        }
+    } else if (call->status.error_code() != grpc::StatusCode::CANCELLED) {
+        LOG_ERROR("gRPC error for " << call->positions.size() << " level " << call->level << " LOD chunks: "
+                  << (!call->status.ok() ? call->status.error_message() : !ok ? "Completion queue error" : call->response.error_message()));
+    }
+    std::lock_guard<std::mutex> lock(lodMutex_);
+    for (const auto& pos : call->positions) {
+        requestedLodChunks_[call->level - 1].erase(pos);
+    }
+}
+
+void Client::decodeLodResponse(const AsyncLodChunkCall& call) {
+    // Decoded before taking the lock, so lookups aren't held up by deserialization
+    std::vector<std::shared_ptr<ChunkSpan>> decoded;
+    for (const auto& entry : call.response.chunks()) {
+        if (entry.not_modified() || !entry.has_chunk_data()) {
+            continue;
+        }
+        AbsoluteChunkPosition pos{entry.position().x(), entry.position().y(), entry.position().z()};
+        try {
+            auto chunk = makePooledChunk(std::string_view(entry.chunk_data()));
+            chunk->setVersion(entry.version());
+            decoded.push_back(std::move(chunk));
+        } catch (const std::exception& e) {
+            LOG_ERROR("Failed to deserialize level " << call.level << " LOD chunk data for position ("
+                      << pos.x << ", " << pos.y << ", " << pos.z << "): " << e.what());
+        }
+    }
+    std::lock_guard<std::mutex> lock(lodMutex_);
+    for (auto& chunk : decoded) {
+        const AbsoluteChunkPosition pos = chunk->position;
+        lodChunks_[call.level - 1].insert_or_assign(pos, std::move(chunk));
+        readyLodChunks_.push({call.level, pos});
+    }
+    for (const auto& pos : call.positions) {
+        requestedLodChunks_[call.level - 1].erase(pos);
+    }
+}
+
+void Client::decodeResponse(const AsyncChunkCall& call) {
+    size_t loaded = 0;
+    try {
+        for (int i = 0; i < call.response.chunks_size(); ++i) {
+            const auto& entry = call.response.chunks(i);
+            AbsoluteChunkPosition pos{entry.position().x(), entry.position().y(), entry.position().z()};
+            if (entry.not_modified()) {
+                // Our disk copy is current; it is already on disk, so don't write it back
+                // The server answers positions in request order
+                std::shared_ptr<ChunkSpan> copy = static_cast<size_t>(i) < call.diskCopies.size() ? call.diskCopies[i] : nullptr;
+                if (copy && ChunkPosEq{}(copy->position, pos)) {
+                    copy->setVersion(entry.version());
+                    rememberDiskVersion(pos, entry.version());
+                    cacheChunk(pos, std::move(copy), false);
+                    readyChunks_.push(pos);
+                    revalidatedChunks_.fetch_add(1, std::memory_order_relaxed);
+                    ++loaded;
                 }
+                continue;
+            }
+            if (!entry.has_chunk_data()) {
+                continue;
+            }
+            // Deserialize the chunk directly from the response bytes
+            try {
+                auto chunk = makePooledChunk(std::string_view(entry.chunk_data()));
+                chunk->setVersion(entry.version());
+                cacheChunk(pos, chunk);
+                readyChunks_.push(pos);
+                ++loaded;
+            } catch (const std::exception& e) {
+                LOG_ERROR("Failed to deserialize chunk data for position (" 
+                          << pos.x << ", " << pos.y << ", " << pos.z << "): " << e.what());
             }
         }
+        LOG_DEBUG("Loaded " << loaded << " of " << call.positions.size() << " requested chunks");
+    } catch (const std::exception& e) {
+        handleRpcError(e);
+    }
+    releaseRequested(call);
+}
+
+void Client::releaseRequested(const AsyncChunkCall& call) {
+    // A cancelled call's positions were released or requeued when it was cancelled
+    if (call.cancelled) {
+        return;
+    }
+    releaseRequested(call.positions);
+}
+
+void Client::releaseRequested(const std::vector<AbsoluteChunkPosition>& positions) {
+    if (positions.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> requestedLock(requestedChunksMutex_);
+    for (const auto& pos : positions) {
+        requestedChunks_.erase(pos);
     }
 }
 
+std::vector<AbsoluteChunkPosition> Client::processPendingRequests() {
+    std::vector<AbsoluteChunkPosition> arrived;
+    while (auto pos = readyChunks_.pop()) {
+        arrived.push_back(*pos);
+    }
+    return arrived;
+}
+
 void Client::preloadChunksAroundPosition(const AbsoluteBlockPosition& position, size_t radiusInChunks) {
     const auto centerChunk = toAbsoluteChunk(position);
     const int32_t radius = static_cast<int32_t>(radiusInChunks);
     
+    std::vector<AbsoluteChunkPosition> missing;
     for (int32_t dx = -radius; dx <= radius; ++dx) {
         for (int32_t dy = -radius; dy <= radius; ++dy) {
             for (int32_t dz = -radius; dz <= radius; ++dz) {
@@ -526,17 +1095,20 @@ void Client::preloadChunksAroundPosition(const AbsoluteBlockPosition& position,
                     centerChunk.y + dy,
                     centerChunk.z + dz
                 };
-                
-                // Request chunk (this will cache it automatically)
-                requestChunk(chunkPos);
+                if (!getCachedChunk(chunkPos)) {
+                    missing.push_back(chunkPos);
+                }
             }
         }
     }
+    
+    // One batched request (this will cache them automatically)
+    requestChunksAsync(missing);
 }
 
 bool Client::placeBlock(const AbsoluteBlockPosition& pos, Block block) {
     if (!isConnected()) {
-        std::cerr << "Client not connected" << std::endl;
+        LOG_ERROR("Client not connected");
         return false;
     }
     
@@ -555,21 +1127,10 @@ bool Client::placeBlock(const AbsoluteBlockPosition& pos, Block block) {
         
         if (status.ok() && response.success()) {
             // Update local cache if chunk is loaded
-            auto chunkPos = toAbsoluteChunk(pos);
-            auto cached = getCachedChunk(chunkPos);
-            if (cached) {
-                auto localPos = toChunkLocal(pos, chunkPos);
-                (*cached)->setBlock(localPos, block);
-            }
+            patchCachedBlock(pos, block);
             return true;
         } else {
-            std::cerr << "PlaceBlock failed: ";
-            if (!status.ok()) {
-                std::cerr << status.error_message();
-            } else {
-                std::cerr << response.error_message();
-            }
-            std::cerr << std::endl;
+            LOG_ERROR("PlaceBlock failed: " << (status.ok() ? response.error_message() : status.error_message()));
             return false;
         }
     } catch (const std::exception& e) {
@@ -582,9 +1143,140 @@ bool Client::breakBlock(const AbsoluteBlockPosition& pos) {
     return placeBlock(pos, Block::Empty);
 }
 
+bool Client::placeBlockAsync(const AbsoluteBlockPosition& pos, Block block) {
+    if (!isConnected()) {
+        LOG_ERROR("Client not connected");
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(blockEditMutex_);
+        blockEdits_.push_back({pos, block, patchCachedBlock(pos, block)});
+    }
+    blockEditWake_.notify_one();
+    return true;
+}
+
+bool Client::breakBlockAsync(const AbsoluteBlockPosition& pos) {
+    return placeBlockAsync(pos, Block::Empty);
+}
+
+bool Client::flushBlockEdits(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(blockEditMutex_);
+    return blockEditsAnswered_.wait_for(lock, timeout, [this] {
+        return blockEdits_.empty() && blockEditsInFlight_ == 0;
+    });
+}
+
+size_t Client::getRejectedBlockEditCount() const {
+    return rejectedBlockEdits_.load(std::memory_order_relaxed);
+}
+
+void Client::stopBlockEditSender() {
+    if (!blockEditSender_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(blockEditMutex_);
+        blockEditsStopping_ = true;
+    }
+    blockEditWake_.notify_all();
+    blockEditSender_.join();
+}
+
+void Client::blockEditSenderFunc() {
+    for (;;) {
+        // Everything queued during the previous round trip goes out together
+        std::vector<QueuedBlockEdit> batch;
+        {
+            std::unique_lock<std::mutex> lock(blockEditMutex_);
+            blockEditWake_.wait(lock, [this] { return blockEditsStopping_ || !blockEdits_.empty(); });
+            if (blockEdits_.empty()) {
+                break;
+            }
+            const size_t count = std::min(blockEdits_.size(), kMaxBlockEditsPerRequest);
+            batch.assign(std::make_move_iterator(blockEdits_.begin()), std::make_move_iterator(blockEdits_.begin() + static_cast<std::ptrdiff_t>(count)));
+            blockEdits_.erase(blockEdits_.begin(), blockEdits_.begin() + static_cast<std::ptrdiff_t>(count));
+            blockEditsInFlight_ = batch.size();
+        }
+        
+        blockserver::PlaceBlocksRequest request;
+        *request.mutable_player_position() = createPlayerPositionMessage();
+        for (const auto& edit : batch) {
+            auto* message = request.add_edits();
+            message->set_x(edit.pos.x);
+            message->set_y(edit.pos.y);
+            message->set_z(edit.pos.z);
+            message->set_block_type(static_cast<uint32_t>(edit.block));
+        }
+        blockserver::PlaceBlocksResponse response;
+        grpc::ClientContext context;
+        context.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(5));
+        grpc::Status status = stub_->PlaceBlocks(&context, request, &response);
+        const bool answered = status.ok() && response.success();
+        if (!answered) {
+            LOG_ERROR("PlaceBlocks failed for " << batch.size() << " edits: "
+                      << (status.ok() ? response.error_message() : status.error_message()));
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(blockEditMutex_);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (answered && i < static_cast<size_t>(response.results_size()) && response.results(i).success()) {
+                    adoptBlockEditVersion(batch[i].pos, response.results(i).version());
+                    continue;
+                }
+                rejectedBlockEdits_.fetch_add(1, std::memory_order_relaxed);
+                // A later local edit of this block now owns it, whatever the server says about this one
+                auto samePos = [&](const QueuedBlockEdit& other) { return other.pos.x == batch[i].pos.x && other.pos.y == batch[i].pos.y && other.pos.z == batch[i].pos.z; };
+                if (!batch[i].previous ||
+                    std::any_of(batch.begin() + static_cast<std::ptrdiff_t>(i) + 1, batch.end(), samePos) ||
+                    std::any_of(blockEdits_.begin(), blockEdits_.end(), samePos)) {
+                    continue;
+                }
+                // Unless a server push replaced the block meanwhile
+                patchCachedBlock(batch[i].pos, *batch[i].previous, batch[i].block);
+            }
+            blockEditsInFlight_ = 0;
+        }
+        blockEditsAnswered_.notify_all();
+    }
+}
+
+std::optional<Block> Client::patchCachedBlock(const AbsoluteBlockPosition& pos, Block block, std::optional<Block> expected) {
+    auto chunkPos = toAbsoluteChunk(pos);
+    auto cached = getCachedChunk(chunkPos);
+    if (!cached) {
+        return std::nullopt;
+    }
+    ChunkLocalPosition local = toChunkLocal(pos, chunkPos);
+    Block previous = (*cached)->getBlock(local);
+    if (expected && previous != *expected) {
+        return std::nullopt;
+    }
+    // Edit a copy; the mesher may be reading the cached one. Both it and the disk copy keep the
+    // server's version, so the server's echo of this edit still applies as deltas.
+    auto patched = makePooledChunk(**cached);
+    patched->setBlock(local, block);
+    patched->setVersion((*cached)->version());
+    cacheChunk(chunkPos, std::move(patched), false);
+    return previous;
+}
+
+void Client::adoptBlockEditVersion(const AbsoluteBlockPosition& pos, uint64_t version) {
+    auto chunkPos = toAbsoluteChunk(pos);
+    auto cached = getCachedChunk(chunkPos);
+    // Only when no one else's edit came in between; otherwise the subscription's deltas catch us up
+    if (!cached || (*cached)->version() + 1 != version) {
+        return;
+    }
+    auto adopted = makePooledChunk(**cached);
+    adopted->setVersion(version);
+    cacheChunk(chunkPos, std::move(adopted), false);
+}
+
 std::vector<AbsoluteChunkPosition> Client::getUpdatedChunks(int32_t renderDistance) {
     if (!isConnected()) {
-        std::cerr << "Client not connected" << std::endl;
+        LOG_ERROR("Client not connected");
         return {};
     }
     
@@ -605,7 +1297,7 @@ std::vector<AbsoluteChunkPosition> Client::getUpdatedChunks(int32_t renderDistan
             }
             return updatedChunks;
         } else {
-            std::cerr << "Failed to get updated chunks: " << response.error_message() << std::endl;
+            LOG_ERROR("Failed to get updated chunks: " << response.error_message());
             return {};
         }
     } catch (const std::exception& e) {
@@ -614,6 +1306,112 @@ std::vector<AbsoluteChunkPosition> Client::getUpdatedChunks(int32_t renderDistan
     }
 }
 
+bool Client::subscribeChunks(int32_t viewRadius) {
+    if (!isConnected()) {
+        LOG_ERROR("Client not connected");
+        return false;
+    }
+    
+    unsubscribeChunks();
+    
+    blockserver::SubscribeChunksRequest request;
+    *request.mutable_player_position() = createPlayerPositionMessage();
+    request.set_view_radius(viewRadius);
+    request.set_session_token(getSessionToken());
+    
+    std::lock_guard<std::mutex> lock(subscriptionMutex_);
+    subscriptionContext_ = std::make_unique<grpc::ClientContext>();
+    subscribed_ = true;
+    subscriptionThread_ = std::thread(&Client::subscriptionThreadFunc, this, subscriptionContext_.get(), std::move(request));
+    return true;
+}
+
+void Client::unsubscribeChunks() {
+    std::lock_guard<std::mutex> lock(subscriptionMutex_);
+    if (subscriptionContext_) {
+        // Makes the blocked Read return false
+        subscriptionContext_->TryCancel();
+    }
+    if (subscriptionThread_.joinable()) {
+        subscriptionThread_.join();
+    }
+    subscriptionContext_.reset();
+    subscribed_ = false;
+}
+
+bool Client::isSubscribed() const {
+    return subscribed_;
+}
+
+std::vector<AbsoluteChunkPosition> Client::takeStreamedChunkUpdates() {
+    std::lock_guard<std::mutex> lock(streamedUpdatesMutex_);
+    std::vector<AbsoluteChunkPosition> updates;
+    updates.swap(streamedUpdates_);
+    return updates;
+}
+
+bool Client::applyBlockDeltas(const AbsoluteChunkPosition& pos, const ChunkSpan& cached, const blockserver::BlockDeltas& deltas, uint64_t version) {
+    // A copy that already took some of these edits (our own, acknowledged) can take them all again:
+    // every block they touch ends as the last edit leaves it, the rest match from_version anyway
+    if (cached.version() < deltas.from_version() || cached.version() > version) {
+        return false;
+    }
+    // Patch a copy; the render thread may be reading the cached one
+    auto patched = makePooledChunk(cached);
+    for (const auto& edit : deltas.edits()) {
+        if (edit.index() >= CHUNK_BLOCK_COUNT) {
+            return false;
+        }
+        patched->setBlock(edit.index(), static_cast<Block>(edit.block_type()));
+    }
+    patched->setVersion(version);
+    cacheChunk(pos, std::move(patched));
+    return true;
+}
+
+void Client::subscriptionThreadFunc(grpc::ClientContext* context, blockserver::SubscribeChunksRequest request) {
+    auto reader = stub_->SubscribeChunks(context, request);
+    blockserver::ChunkUpdate update;
+    while (reader->Read(&update)) {
+        AbsoluteChunkPosition pos{update.position().x(), update.position().y(), update.position().z()};
+        if (update.has_chunk_data()) {
+            try {
+                auto chunk = makePooledChunk(std::string_view(update.chunk_data()));
+                chunk->setVersion(update.version());
+                cacheChunk(pos, std::move(chunk));
+            } catch (const std::exception& e) {
+                LOG_ERROR("Failed to create chunk from stream: " << e.what());
+                continue;
+            }
+        } else if (update.has_deltas()) {
+            auto cached = getCachedChunk(pos);
+            if (!cached) {
+                // Not a chunk we hold; nothing to patch
+                continue;
+            }
+            if (!applyBlockDeltas(pos, **cached, update.deltas(), update.version())) {
+                // Our copy isn't the version the deltas start from: drop it and fetch the whole chunk
+                {
+                    std::lock_guard<std::mutex> lock(cacheMutex_);
+                    cachedChunks_.erase(pos);
+                }
+                requestChunkAsync(pos);
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(cacheMutex_);
+            cachedChunks_.erase(pos);
+        }
+        std::lock_guard<std::mutex> lock(streamedUpdatesMutex_);
+        streamedUpdates_.push_back(pos);
+    }
+    
+    auto status = reader->Finish();
+    if (!status.ok() && status.error_code() != grpc::StatusCode::CANCELLED) {
+        LOG_ERROR("Chunk subscription ended: " << status.error_message());
+    }
+    subscribed_ = false;
+}
+
 std::optional<Block> Client::getBlockAt(const AbsoluteBlockPosition& pos) {
     // First check local cache
     auto chunkPos = toAbsoluteChunk(pos);
@@ -640,9 +1438,9 @@ void Client::clearCache() {
 
 std::optional<std::shared_ptr<ChunkSpan>> Client::getCachedChunk(const AbsoluteChunkPosition& pos) const {
     std::lock_guard<std::mutex> lock(cacheMutex_);
-    auto it = cachedChunks_.find(pos);
-    if (it != cachedChunks_.end()) {
-        return it->second;
+    auto chunk = cachedChunks_.find(pos);
+    if (chunk) {
+        return chunk;
     }
     return std::nullopt;
 }
@@ -652,17 +1450,107 @@ size_t Client::getCacheSize() const {
     return cachedChunks_.size();
 }
 
-void Client::evictOldChunks(size_t maxChunks) {
+void Client::setCacheBudget(size_t bytes) {
+    AbsoluteChunkPosition center = toAbsoluteChunk(getPlayerPosition());
     std::lock_guard<std::mutex> lock(cacheMutex_);
-    if (cachedChunks_.size() <= maxChunks) {
-        return;
+    cachedChunks_.setCenter(center);
+    cachedChunks_.setByteBudget(bytes);
+}
+
+size_t Client::evictOldChunks() {
+    AbsoluteChunkPosition center = toAbsoluteChunk(getPlayerPosition());
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    cachedChunks_.setCenter(center);
+    return cachedChunks_.evict();
+}
+
+void Client::pinChunk(const AbsoluteChunkPosition& pos) {
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    cachedChunks_.pin(pos);
+}
+
+void Client::unpinChunk(const AbsoluteChunkPosition& pos) {
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    cachedChunks_.unpin(pos);
+}
+
+ClientChunkCacheStats Client::getCacheStats() const {
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    return cachedChunks_.stats();
+}
+
+std::string Client::getWorldId() const {
+    std::lock_guard<std::mutex> lock(diskCacheMutex_);
+    return worldId_;
+}
+
+size_t Client::getRevalidatedChunkCount() const {
+    return revalidatedChunks_.load(std::memory_order_relaxed);
+}
+
+void Client::openDiskCache() {
+    std::string worldId;
+    try {
+        blockserver::ServerInfoRequest request;
+        blockserver::ServerInfoResponse response;
+        grpc::ClientContext context;
+        auto status = stub_->GetServerInfo(&context, request, &response);
+        if (status.ok() && response.success()) {
+            worldId = response.world_id();
+        }
+    } catch (const std::exception& e) {
+        handleRpcError(e);
     }
     
-    // Simple eviction: remove excess chunks (in a real implementation, you might use LRU)
-    size_t toRemove = cachedChunks_.size() - maxChunks;
-    auto it = cachedChunks_.begin();
-    for (size_t i = 0; i < toRemove && it != cachedChunks_.end(); ++i) {
-        it = cachedChunks_.erase(it);
+    std::lock_guard<std::mutex> lock(diskCacheMutex_);
+    worldId_ = worldId;
+    // Finish writes to the previous world's cache before closing it
+    diskWriter_.reset();
+    diskCache_.reset();
+    diskVersions_.clear();
+    // The id only names the cache directory; cached chunks are still revalidated by hash
+    if (diskCacheDirectory_.empty() || worldId.empty() || worldId.find_first_of("/\\.") != std::string::npos) {
+        return;
+    }
+    try {
+        diskCache_ = std::make_shared<RegionFileChunkPersistence>(diskCacheDirectory_ / worldId);
+        diskWriter_ = std::make_unique<ChunkWriteBehind>(diskCache_);
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to open chunk disk cache: " << e.what());
+    }
+}
+
+std::shared_ptr<ChunkSpan> Client::loadFromDiskCache(const AbsoluteChunkPosition& pos) {
+    std::shared_ptr<RegionFileChunkPersistence> diskCache;
+    uint64_t version = 0;
+    {
+        std::lock_guard<std::mutex> lock(diskCacheMutex_);
+        if (!diskCache_) {
+            return nullptr;
+        }
+        auto known = diskVersions_.find(pos);
+        version = known != diskVersions_.end() ? known->second : 0;
+        // A write still queued is newer than the file
+        if (auto queued = diskWriter_ ? diskWriter_->pending(pos) : std::nullopt) {
+            auto copy = makePooledChunk(**queued);
+            copy->setVersion(version);
+            return copy;
+        }
+        diskCache = diskCache_;
+    }
+    // Region reads share the mapping, so they don't need the disk cache lock
+    auto chunk = diskCache->loadChunk(pos);
+    if (!chunk) {
+        return nullptr;
+    }
+    (*chunk)->setVersion(version);
+    return *chunk;
+}
+
+void Client::rememberDiskVersion(const AbsoluteChunkPosition& pos, uint64_t version) {
+    std::lock_guard<std::mutex> lock(diskCacheMutex_);
+    if (diskCache_) {
+        diskVersions_.insert_or_assign(pos, version);
     }
 }
 
@@ -695,9 +1583,32 @@ std::string Client::getServerInfo() {
     }
 }
 
+std::optional<blockserver::StatsResponse> Client::getServerStats(bool includePrometheusText) {
+    if (!isConnected()) {
+        return std::nullopt;
+    }
+
+    try {
+        blockserver::StatsRequest request;
+        request.set_include_prometheus_text(includePrometheusText);
+        blockserver::StatsResponse response;
+        grpc::ClientContext context;
+
+        auto status = stub_->GetStats(&context, request, &response);
+        if (!status.ok() || !response.success()) {
+            LOG_ERROR("Failed to get server stats: " << status.error_message());
+            return std::nullopt;
+        }
+        return response;
+    } catch (const std::exception& e) {
+        handleRpcError(e);
+        return std::nullopt;
+    }
+}
+
 bool Client::ping() {
     if (!stub_) {
-        std::cerr << "no stub_" << std::endl;
+        LOG_ERROR("no stub_");
         return false;
     }
     
@@ -707,8 +1618,8 @@ bool Client::ping() {
         grpc::ClientContext context;
         
         auto status = stub_->Ping(&context, request, &response);
-        std::cout << "Ping status: " << (status.ok() ? "OK" : "Failed") << std::endl;
-        std::cout << "Ping response success: " << (response.success() ? "Yes" : "No") << std::endl;
+        LOG_DEBUG("Ping status: " << (status.ok() ? "OK" : "Failed"));
+        LOG_DEBUG("Ping response success: " << (response.success() ? "Yes" : "No"));
         return status.ok() && response.success();
     } catch (const std::exception& e) {
         return false;
@@ -717,10 +1628,9 @@ bool Client::ping() {
 
 std::shared_ptr<ChunkSpan> Client::createChunkFromData(const AbsoluteChunkPosition& pos, const std::vector<uint8_t>& data) {
     try {
-        auto serializedData = const_cast<std::vector<uint8_t>&>(data); // ChunkSpan constructor may modify the vector
-        return std::make_shared<ChunkSpan>(serializedData);
+        return makePooledChunk(data);
     } catch (const std::exception& e) {
-        std::cerr << "Failed to create chunk from data: " << e.what() << std::endl;
+        LOG_ERROR("Failed to create chunk from data: " << e.what());
         return nullptr;
     }
 }
@@ -729,23 +1639,25 @@ std::vector<uint8_t> Client::serializeChunk(const ChunkSpan& chunk) {
     return chunk.serialize();
 }
 
-void Client::cacheChunk(const AbsoluteChunkPosition& pos, std::shared_ptr<ChunkSpan> chunk) {
-    std::lock_guard<std::mutex> lock(cacheMutex_);
-    cachedChunks_[pos] = chunk;
-    
-    // Auto-evict if cache gets too large
-    if (cachedChunks_.size() > 100) {
-        // Simple eviction: remove excess chunks
-        size_t toRemove = cachedChunks_.size() - 100;
-        auto it = cachedChunks_.begin();
-        for (size_t i = 0; i < toRemove && it != cachedChunks_.end(); ++i) {
-            it = cachedChunks_.erase(it);
+void Client::cacheChunk(const AbsoluteChunkPosition& pos, std::shared_ptr<ChunkSpan> chunk, bool persist) {
+    if (persist) {
+        // Written on the disk writer's thread; lookups see it through pending() until then
+        std::lock_guard<std::mutex> diskLock(diskCacheMutex_);
+        if (diskWriter_) {
+            diskWriter_->enqueue(chunk);
+            diskVersions_.insert_or_assign(pos, chunk->version());
         }
     }
+    
+    // Distances for eviction are measured from where the player is now
+    AbsoluteChunkPosition center = toAbsoluteChunk(getPlayerPosition());
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    cachedChunks_.setCenter(center);
+    cachedChunks_.insert(pos, std::move(chunk));
 }
 
 void Client::handleRpcError(const std::exception& e) {
-    std::cerr << "RPC Error: " << e.what() << std::endl;
+    LOG_ERROR("RPC Error: " << e.what());
     // Could implement reconnection logic here
 }
 
@@ -766,129 +1678,27 @@ size_t Client::getPendingRequestCount() const {
     return pending_calls_.size();
 }
 
+size_t Client::getInflightRequestLimit() const {
+    std::lock_guard<std::mutex> lock(callsMutex_);
+    return requestScheduler_.inflightLimit();
+}
+
+size_t Client::getCancelledRequestCount() const {
+    return cancelledRequests_.load(std::memory_order_relaxed);
+}
+
 void Client::completionThreadFunc() {
-    while (!shouldStop_) {
+    void* tag;
+    bool ok;
+    // Blocks until a call completes; false once the queue is shut down and drained
+    while (cq_.Next(&tag, &ok)) {
         try {
-            // Use a timeout for AsyncNext to make it more responsive to shutdown
-            void* tag;
-            bool ok;
-            
-            // Check completion queue with a small timeout instead of blocking indefinitely
-            auto deadline = std::chrono::system_clock::now() + std::chrono::milliseconds(100);
-            grpc::CompletionQueue::NextStatus status = cq_.AsyncNext(&tag, &ok, deadline);
-            
-            if (status == grpc::CompletionQueue::NextStatus::GOT_EVENT) {
-                // Process the event
-                std::unique_ptr<AsyncChunkCall> call;
-                
-                {
-                    std::lock_guard<std::mutex> lock(callsMutex_);
-                    auto it = pending_calls_.find(tag);
-                    if (it != pending_calls_.end()) {
-                        call = std::move(it->second);
-                        pending_calls_.erase(it);
-                    }
-                }
-                
-                if (call) {
-                    // Process the completed call (same logic as in processPendingRequests)
-                    try {
-                        if (ok && call->status.ok() && call->response.success()) {
-                            if (call->response.has_chunk_data()) {
-                                const std::string& chunkDataStr = call->response.chunk_data();
-                                std::vector<uint8_t> serializedData(chunkDataStr.begin(), chunkDataStr.end());
-                                
-                                std::cout << "Got response for chunk (" << call->position.x << ", " 
-                                          << call->position.y << ", " << call->position.z 
-                                          << ") - Data size: " << serializedData.size() << " bytes" << std::endl;
-                                
-                                try {
-                                    auto chunk = std::make_shared<ChunkSpan>(serializedData);
-                                    cacheChunk(call->position, chunk);
-                                    
-                                    std::cout << "Loaded chunk (" << call->position.x << ", " 
-                                              << call->position.y << ", " << call->position.z << ")" << std::endl;
-                                } catch (const std::exception& e) {
-                                    std::cerr << "Failed to deserialize chunk data for position (" 
-                                              << call->position.x << ", " << call->position.y << ", " 
-                                              << call->position.z << "): " << e.what() << std::endl;
-                                }
-                            }
-                        } else {
-                            std::cerr << "gRPC error for chunk (" << call->position.x << ", " 
-                                      << call->position.y << ", " << call->position.z << "): ";
-                            if (!call->status.ok()) {
-                                std::cerr << call->status.error_message();
-                            } else if (!ok) {
-                                std::cerr << "Completion queue error";
-                            } else {
-                                std::cerr << call->response.error_message();
-                            }
-                            std::cerr << std::endl;
-                        }
-                    } catch (const std::exception& e) {
-                        handleRpcError(e);
-                    }
-                    
-                    // Remove from requested chunks
-                    {
-                        std::lock_guard<std::mutex> requestedLock(requestedChunksMutex_);
-                        requestedChunks_.erase(call->position);
-                    }
-                    
-                    // Process backlog if not shutting down
-                    if (!shouldStop_) {
-                        std::lock_guard<std::mutex> lock(callsMutex_);
-                        while (!requestBacklog_.empty() && pending_calls_.size() < kMaxInflightRequests) {
-                            AbsoluteChunkPosition next = requestBacklog_.front();
-                            requestBacklog_.pop_front();
-                            
-                            // Double-check it wasn't satisfied while in backlog
-                            {
-                                std::lock_guard<std::mutex> cacheLock(cacheMutex_);
-                                if (cachedChunks_.find(next) != cachedChunks_.end()) {
-                                    std::lock_guard<std::mutex> requestedLock(requestedChunksMutex_);
-                                    requestedChunks_.erase(next);
-                                    continue;
-                                }
-                            }
-                            
-                            try {
-                                // Create new async call for backlog item
-                                auto backlogCall = std::make_unique<AsyncChunkCall>();
-                                backlogCall->position = next;
-                                *backlogCall->request.mutable_player_position() = createPlayerPositionMessage();
-                                backlogCall->request.set_x(next.x);
-                                backlogCall->request.set_y(next.y);
-                                backlogCall->request.set_z(next.z);
-                                backlogCall->request_time = std::chrono::steady_clock::now();
-                                
-                                backlogCall->response_reader = stub_->AsyncGetChunk(&backlogCall->context, backlogCall->request, &cq_);
-                                
-                                void* backlogTag = backlogCall.get();
-                                backlogCall->response_reader->Finish(&backlogCall->response, &backlogCall->status, backlogTag);
-                                
-                                pending_calls_[backlogTag] = std::move(backlogCall);
-                                
-                            } catch (const std::exception& e) {
-                                handleRpcError(e);
-                                std::lock_guard<std::mutex> requestedLock(requestedChunksMutex_);
-                                requestedChunks_.erase(next);
-                            }
-                        }
-                    }
-                }
-            } else if (status == grpc::CompletionQueue::NextStatus::SHUTDOWN) {
-                // Completion queue was shut down, exit the loop
-                break;
-            }
-            // If TIMEOUT, just continue the loop and check shouldStop_
-            
+            handleCompletedCall(tag, ok);
         } catch (const std::exception& e) {
             // Log error but continue processing
-            std::cerr << "Error in completion thread: " << e.what() << std::endl;
+            LOG_ERROR("Error in completion thread: " << e.what());
             // Small delay to avoid tight error loops
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
     }
-}
\ No newline at end of file
+}
@@ -1,12 +1,17 @@
 #pragma once
 
+#include <array>
+#include <filesystem>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <unordered_map>
 #include <string>
+#include <span>
 #include <vector>
 #include <deque>
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
 #include <chrono>
 #include <thread>
@@ -16,20 +21,41 @@
 #include "chunktransform.h"
 #include "position.h"
 #include "block.h"
+#include "chunk_lod.h"
+#include "chunk_request_scheduler.h"
+#include "client_chunk_cache.h"
+#include "mpsc_queue.h"
+#include "thread_pool.h"
 #include "world.h"
+#include "entity_sync.h"
 
-// Client-side chunk cache
-using ClientChunkMap = std::unordered_map<AbsoluteChunkPosition, std::shared_ptr<ChunkSpan>, ChunkPosHash, ChunkPosEq>;
+class ChunkWriteBehind;
+class RegionFileChunkPersistence;
 
-// Async chunk request tracking
+// Async batched chunk request tracking (one GetChunks call)
 struct AsyncChunkCall {
-    AbsoluteChunkPosition position;
-    blockserver::ChunkRequest request;
-    blockserver::ChunkResponse response;
+    std::vector<AbsoluteChunkPosition> positions;
+    // Copies from the disk cache sent for revalidation, parallel to positions (null if none)
+    std::vector<std::shared_ptr<ChunkSpan>> diskCopies;
+    blockserver::ChunksRequest request;
+    blockserver::ChunksResponse response;
     grpc::ClientContext context;
     grpc::Status status;
-    std::unique_ptr<grpc::ClientAsyncResponseReader<blockserver::ChunkResponse>> response_reader;
+    std::unique_ptr<grpc::ClientAsyncResponseReader<blockserver::ChunksResponse>> response_reader;
     std::chrono::steady_clock::time_point request_time;
+    // Cancelled because the player moved away; its positions were already requeued or released
+    bool cancelled = false;
+};
+
+// Async LOD chunk request tracking (one GetLodChunks call)
+struct AsyncLodChunkCall {
+    uint32_t level = 0;
+    std::vector<AbsoluteChunkPosition> positions;
+    blockserver::LodChunksRequest request;
+    blockserver::LodChunksResponse response;
+    grpc::ClientContext context;
+    grpc::Status status;
+    std::unique_ptr<grpc::ClientAsyncResponseReader<blockserver::LodChunksResponse>> response_reader;
 };
 
 class Client {
@@ -41,55 +67,133 @@ public:
     ~Client();
     
     // Connection management
+    // Keeps fetched chunks on disk under directory/<world id> and revalidates them with the server
+    // instead of downloading them again; set before connect()
+    void setDiskCacheDirectory(const std::filesystem::path& directory);
     bool connect();
     void disconnect();
     bool isConnected() const;
     
     // Player management
+    // Also reorders queued chunk requests, and drops or cancels those that are now too far away
     void setPlayerPosition(const AbsoluteBlockPosition& pos);
+    // Chunks in front of the player are requested before ones behind; need not be normalized
+    void setViewDirection(double x, double y, double z);
     AbsoluteBlockPosition getPlayerPosition() const;
     std::string getPlayerId() const;
     
     // Player session management
     bool connectAsPlayer(const std::string& playerName, const AbsolutePrecisePosition& spawnPosition);
     bool refreshSession();
+    // Sent over the player stream when it is open (returns immediately), otherwise as a unary RPC
     bool updatePlayerPosition(const AbsolutePrecisePosition& position);
     bool disconnectPlayer();
     bool hasValidSession() const;
     std::string getSessionToken() const;
     
+    // Player stream: carries position samples and keeps the session alive without RefreshSession polling.
+    // Requires a session; closed by disconnectPlayer() and disconnect().
+    bool openPlayerStream();
+    void closePlayerStream();
+    bool isPlayerStreamOpen() const;
+    // Highest position sample the server has acknowledged applying
+    uint64_t getAppliedInputSequence() const;
+    
+    // Entity sync: fetches what changed around the session's player since the last poll and applies
+    // it to the local entity mirror (viewRadius in chunks, 0 for the server default)
+    bool pollEntityUpdates(int32_t viewRadius = 0);
+    // Runs fn with the mirrored entities (NameComponent + AbsolutePrecisePosition)
+    void readEntities(const std::function<void(const GameRegistry&)>& fn) const;
+    
     // Chunk operations (non-blocking)
     std::optional<std::shared_ptr<ChunkSpan>> requestChunk(const AbsoluteChunkPosition& pos);
     void requestChunkAsync(const AbsoluteChunkPosition& pos);
+    // Requests every position not already requested, batched into as few GetChunks calls as possible
+    void requestChunksAsync(std::span<const AbsoluteChunkPosition> positions);
     void preloadChunksAroundPosition(const AbsoluteBlockPosition& position, size_t radiusInChunks = 5);
     
+    // LOD chunks (see chunk_lod.h), positions in the level's grid: requests every position not
+    // already in flight; cached ones are revalidated and only resent when they changed
+    void requestLodChunksAsync(uint32_t level, std::span<const AbsoluteChunkPosition> positions);
+    // LOD chunks that arrived or changed since the last call, with their level; never blocks
+    std::vector<std::pair<uint32_t, AbsoluteChunkPosition>> takeArrivedLodChunks();
+    std::shared_ptr<const ChunkSpan> getCachedLodChunk(uint32_t level, const AbsoluteChunkPosition& pos) const;
+    // Drops the level's cached LOD chunks further than keepDistance (Chebyshev, in its grid) from
+    // center; returns how many
+    size_t evictLodChunks(uint32_t level, const AbsoluteChunkPosition& center, int32_t keepDistance);
+    
     // Updated chunks tracking
     std::vector<AbsoluteChunkPosition> getUpdatedChunks(int32_t renderDistance = 5);
     
-    // Process pending async requests (call this regularly from render thread)
-    void processPendingRequests();
+    // Chunk update stream: starts (or restarts) a SubscribeChunks stream around the current player position,
+    // or around the session's player while there is a valid session. Pushed chunks go straight into the cache.
+    bool subscribeChunks(int32_t viewRadius = 5);
+    void unsubscribeChunks();
+    bool isSubscribed() const;
+    // Positions the stream updated or invalidated in the cache since the last call
+    std::vector<AbsoluteChunkPosition> takeStreamedChunkUpdates();
+    
+    // Chunks that arrived (decoded and cached) since the last call; never blocks. Call regularly from
+    // one thread, normally the render thread; responses are handled on the client's own threads.
+    std::vector<AbsoluteChunkPosition> processPendingRequests();
     
     // Get number of pending requests (for shutdown coordination)
     size_t getPendingRequestCount() const;
+    // GetChunks calls currently allowed in flight, adapted to the measured round trip
+    size_t getInflightRequestLimit() const;
+    // In-flight calls cancelled because the player moved away from most of their chunks
+    size_t getCancelledRequestCount() const;
     
-    // Block operations
+    // Block operations; these block for a round trip
     bool placeBlock(const AbsoluteBlockPosition& pos, Block block);
     bool breakBlock(const AbsoluteBlockPosition& pos);
+    // Queued block edits: applied to the cached chunk at once, then sent in PlaceBlocks batches from a
+    // background thread. An edit the server rejects is rolled back unless a later edit replaced it.
+    bool placeBlockAsync(const AbsoluteBlockPosition& pos, Block block);
+    bool breakBlockAsync(const AbsoluteBlockPosition& pos);
+    // Waits until the server has answered every queued edit; false on timeout
+    bool flushBlockEdits(std::chrono::milliseconds timeout = std::chrono::seconds(5));
+    // Queued edits the server refused (or that failed to send)
+    size_t getRejectedBlockEditCount() const;
     std::optional<Block> getBlockAt(const AbsoluteBlockPosition& pos);
     
     // Cache management
     void clearCache();
     std::optional<std::shared_ptr<ChunkSpan>> getCachedChunk(const AbsoluteChunkPosition& pos) const;
     size_t getCacheSize() const;
-    void evictOldChunks(size_t maxChunks = 100);
+    // Bytes of chunk storage cached before the furthest, least recently used chunks are evicted
+    void setCacheBudget(size_t bytes);
+    // Applies the budget now; returns the chunks evicted. Caching a chunk does this on its own.
+    size_t evictOldChunks();
+    // Pinned chunks (e.g. ones with a mesh) are never evicted; pin before or after they arrive
+    void pinChunk(const AbsoluteChunkPosition& pos);
+    void unpinChunk(const AbsoluteChunkPosition& pos);
+    ClientChunkCacheStats getCacheStats() const;
     
     // Server information
     std::string getServerInfo();
+    // The server's metrics; nullopt when not connected or the call failed
+    std::optional<blockserver::StatsResponse> getServerStats(bool includePrometheusText = false);
+    // World id reported by the server at connect; empty if it sent none
+    std::string getWorldId() const;
+    // Chunks taken from the disk cache because the server reported them unchanged
+    size_t getRevalidatedChunkCount() const;
     bool ping();
 
 private:
-    // Limit concurrent in-flight chunk RPCs to avoid flooding server
-    static constexpr std::size_t kMaxInflightRequests = 64;
+    // A player stream with nothing to send still sends this often, well inside the session timeout
+    static constexpr std::chrono::milliseconds kPlayerStreamKeepalive{1000};
+    
+    // Chunks per GetChunks call; stays under the server's per-request limit
+    static constexpr std::size_t kMaxChunksPerRequest = 256;
+    // Queued chunks are spread over the allowed calls, but never fewer than this per call
+    static constexpr std::size_t kMinChunksPerRequest = 16;
+    // Workers decoding GetChunks responses
+    static constexpr std::size_t kDecodeThreads = 2;
+    // LOD chunks per GetLodChunks call; the server's per-request limit
+    static constexpr std::size_t kMaxLodChunksPerRequest = 256;
+    // Edits per PlaceBlocks call; stays under the server's per-request limit
+    static constexpr std::size_t kMaxBlockEditsPerRequest = 512;
     
     // Network connection
     std::unique_ptr<blockserver::BlockServer::Stub> stub_;
@@ -108,29 +212,147 @@ private:
     std::string sessionToken_;
     mutable std::mutex sessionMutex_;
     
+    // Player stream; the writer thread sends the newest pending sample, the reader thread takes acks
+    std::unique_ptr<grpc::ClientContext> playerStreamContext_;
+    std::unique_ptr<grpc::ClientReaderWriter<blockserver::PlayerInput, blockserver::PlayerStreamEvent>> playerStream_;
+    std::thread playerStreamWriter_;
+    std::thread playerStreamReader_;
+    std::mutex playerStreamLifecycleMutex_;
+    std::mutex playerStreamMutex_;
+    std::condition_variable playerStreamWake_;
+    std::optional<AbsolutePrecisePosition> pendingSample_;
+    uint64_t nextInputSequence_ = 0;
+    bool playerStreamClosing_ = false;
+    std::atomic<bool> playerStreamOpen_{false};
+    std::atomic<uint64_t> appliedInputSequence_{0};
+    
+    // Entities mirrored from GetEntityUpdates, and the last update applied
+    EntityMirror entities_;
+    uint64_t entityAck_ = 0;
+    mutable std::mutex entitiesMutex_;
+    
     // Local chunk cache
-    ClientChunkMap cachedChunks_;
+    ClientChunkCache cachedChunks_;
     mutable std::mutex cacheMutex_;
     
+    // Optional on-disk chunk cache for the connected world
+    std::filesystem::path diskCacheDirectory_;
+    std::shared_ptr<RegionFileChunkPersistence> diskCache_;
+    // Writes chunks to diskCache_ off the network and decode threads
+    std::unique_ptr<ChunkWriteBehind> diskWriter_;
+    // The server version of each chunk written to disk this session; unknown ones are offered by hash alone
+    ChunkPosMap<uint64_t> diskVersions_;
+    std::string worldId_;
+    mutable std::mutex diskCacheMutex_;
+    std::atomic<size_t> revalidatedChunks_{0};
+    
     // Async request tracking
-    std::unordered_map<void*, std::unique_ptr<AsyncChunkCall>> pending_calls_;
+    std::unordered_map<void*, std::shared_ptr<AsyncChunkCall>> pending_calls_;
     mutable std::mutex callsMutex_;
-    // Backlog of requested chunks waiting to be sent when capacity allows
-    std::deque<AbsoluteChunkPosition> requestBacklog_;
-    std::unordered_set<AbsoluteChunkPosition, ChunkPosHash, ChunkPosEq> requestedChunks_;
+    // Requested chunks waiting to be sent when capacity allows, nearest first
+    ChunkRequestScheduler requestScheduler_;
+    std::atomic<size_t> cancelledRequests_{0};
+    // The player's latest chunk, and whether a worker is already queued to reschedule around it
+    std::mutex rescheduleMutex_;
+    AbsoluteChunkPosition rescheduleCenter_{0, 0, 0};
+    bool rescheduleQueued_ = false;
+    // Calls taken from the scheduler that sendChunkCalls hasn't started yet; they count as in flight
+    size_t preparingCalls_ = 0;
+    // Never taken while callsMutex_ is held, except to release a call's positions
+    ChunkSet requestedChunks_;
     std::mutex requestedChunksMutex_;
+    // GetLodChunks calls in flight, under callsMutex_
+    std::unordered_map<void*, std::shared_ptr<AsyncLodChunkCall>> pending_lod_calls_;
     
-    // Background completion queue processing
+    // LOD chunks by level - 1, and those requested and not yet answered
+    std::array<ChunkPosMap<std::shared_ptr<const ChunkSpan>>, CHUNK_LOD_LEVELS> lodChunks_;
+    std::array<ChunkSet, CHUNK_LOD_LEVELS> requestedLodChunks_;
+    mutable std::mutex lodMutex_;
+    MpscQueue<std::pair<uint32_t, AbsoluteChunkPosition>> readyLodChunks_;
+    
+    // Background completion queue processing; set shouldStop_ under callsMutex_
     std::thread completionThread_;
     std::atomic<bool> shouldStop_{false};
+    // Responses handed to decodePool_ and not yet cached
+    std::atomic<size_t> decodesInFlight_{0};
+    // Decoded positions on their way to processPendingRequests()
+    MpscQueue<AbsoluteChunkPosition> readyChunks_;
+    
+    // Chunk subscription stream
+    std::unique_ptr<grpc::ClientContext> subscriptionContext_;
+    std::thread subscriptionThread_;
+    std::atomic<bool> subscribed_{false};
+    std::mutex subscriptionMutex_;
+    std::vector<AbsoluteChunkPosition> streamedUpdates_;
+    std::mutex streamedUpdatesMutex_;
+    
+    // Queued block edits; the sender thread takes up to kMaxBlockEditsPerRequest at a time. Taken
+    // before cacheMutex_, so a rollback can't race a newer local edit of the same block.
+    struct QueuedBlockEdit {
+        AbsoluteBlockPosition pos;
+        Block block;
+        // What the cached chunk held before, restored on rejection; nullopt if it wasn't cached
+        std::optional<Block> previous;
+    };
+    std::deque<QueuedBlockEdit> blockEdits_;
+    size_t blockEditsInFlight_ = 0;
+    bool blockEditsStopping_ = false;
+    std::mutex blockEditMutex_;
+    std::condition_variable blockEditWake_;
+    std::condition_variable blockEditsAnswered_;
+    std::thread blockEditSender_;
+    std::atomic<size_t> rejectedBlockEdits_{0};
     
     // Helper methods
     std::shared_ptr<ChunkSpan> createChunkFromData(const AbsoluteChunkPosition& pos, const std::vector<uint8_t>& data);
     std::vector<uint8_t> serializeChunk(const ChunkSpan& chunk);
-    void cacheChunk(const AbsoluteChunkPosition& pos, std::shared_ptr<ChunkSpan> chunk);
+    // Caches in memory and, when persist is set, writes through to the disk cache
+    void cacheChunk(const AbsoluteChunkPosition& pos, std::shared_ptr<ChunkSpan> chunk, bool persist = true);
+    // The disk-cached copy, with its server version if this session has seen it; no lock held
+    std::shared_ptr<ChunkSpan> loadFromDiskCache(const AbsoluteChunkPosition& pos);
+    void rememberDiskVersion(const AbsoluteChunkPosition& pos, uint64_t version);
+    void openDiskCache();
     blockserver::PlayerPosition createPlayerPositionMessage() const;
     void completionThreadFunc();
+    // Takes queued positions as GetChunks calls while under the in-flight limit; requires callsMutex_ held.
+    // Hand the result to sendChunkCalls once the lock is released.
+    std::vector<std::shared_ptr<AsyncChunkCall>> takeBacklogLocked();
+    // Offers disk-cached copies and starts the calls; callsMutex_ must not be held
+    void sendChunkCalls(std::vector<std::shared_ptr<AsyncChunkCall>> calls);
+    // Calls in flight that weren't cancelled, plus those being prepared; requires callsMutex_ held
+    size_t activeCallsLocked() const;
+    // Updates the scheduler's viewpoint and cancels calls it left behind; requires callsMutex_ held.
+    // Returns the dropped positions, for releaseRequested once the lock is released.
+    std::vector<AbsoluteChunkPosition> rescheduleRequestsLocked(const AbsoluteChunkPosition& center);
+    // Reschedules around rescheduleCenter_; runs on decodePool_
+    void applyReschedule();
+    // On the completion thread: hands successful responses to a decode worker and sends more requests
+    void handleCompletedCall(void* tag, bool ok);
+    void blockEditSenderFunc();
+    // Sends what is still queued, then stops the sender thread
+    void stopBlockEditSender();
+    // Writes block into a copy of the cached chunk and returns the block it replaced; nullopt when the
+    // chunk isn't cached or, with expected given, the block there isn't expected
+    std::optional<Block> patchCachedBlock(const AbsoluteBlockPosition& pos, Block block, std::optional<Block> expected = std::nullopt);
+    // Moves the cached chunk to the version the server gave an acknowledged edit, if it is the next one
+    void adoptBlockEditVersion(const AbsoluteBlockPosition& pos, uint64_t version);
+    // On a decode worker: caches the response's chunks and queues them for processPendingRequests()
+    void decodeResponse(const AsyncChunkCall& call);
+    void releaseRequested(const AsyncChunkCall& call);
+    void releaseRequested(const std::vector<AbsoluteChunkPosition>& positions);
+    // On the completion thread: the LOD counterpart of handleCompletedCall
+    void handleCompletedLodCall(const std::shared_ptr<AsyncLodChunkCall>& call, bool ok);
+    // On a decode worker: caches the changed LOD chunks and queues them for takeArrivedLodChunks()
+    void decodeLodResponse(const AsyncLodChunkCall& call);
+    void playerStreamWriterFunc(std::string sessionToken);
+    void playerStreamReaderFunc();
+    void subscriptionThreadFunc(grpc::ClientContext* context, blockserver::SubscribeChunksRequest request);
+    // Applies streamed block deltas to a copy of the cached chunk; false if they don't start at its version
+    bool applyBlockDeltas(const AbsoluteChunkPosition& pos, const ChunkSpan& cached, const blockserver::BlockDeltas& deltas, uint64_t version);
     
     // Error handling
     void handleRpcError(const std::exception& e);
+    
+    // Declared last so its workers stop before the state they decode into is destroyed
+    ThreadPool decodePool_{kDecodeThreads};
 };
\ No newline at end of file
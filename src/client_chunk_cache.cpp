@@ -0,0 +1,101 @@
+#include "client_chunk_cache.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <tuple>
+#include <vector>
+
+ClientChunkCache::ClientChunkCache(size_t byteBudget) : byteBudget_(byteBudget) {}
+
+std::shared_ptr<ChunkSpan> ClientChunkCache::find(const AbsoluteChunkPosition& pos) const {
+    auto it = entries_.find(pos);
+    if (it == entries_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    it->second.lastUsed = ++clock_;
+    return it->second.chunk;
+}
+
+void ClientChunkCache::insert(const AbsoluteChunkPosition& pos, std::shared_ptr<ChunkSpan> chunk) {
+    Entry& entry = entries_[pos];
+    bytes_ -= entry.bytes;
+    entry.bytes = chunkBytes(*chunk);
+    entry.chunk = std::move(chunk);
+    entry.lastUsed = ++clock_;
+    bytes_ += entry.bytes;
+    if (bytes_ > byteBudget_) {
+        evictExcept(&pos);
+    }
+}
+
+bool ClientChunkCache::erase(const AbsoluteChunkPosition& pos) {
+    auto it = entries_.find(pos);
+    if (it == entries_.end()) {
+        return false;
+    }
+    bytes_ -= it->second.bytes;
+    entries_.erase(it);
+    return true;
+}
+
+void ClientChunkCache::clear() {
+    entries_.clear();
+    bytes_ = 0;
+}
+
+void ClientChunkCache::setByteBudget(size_t byteBudget) {
+    byteBudget_ = byteBudget;
+    if (bytes_ > byteBudget_) {
+        evict();
+    }
+}
+
+size_t ClientChunkCache::evictExcept(const AbsoluteChunkPosition* keep) {
+    if (bytes_ <= byteBudget_) {
+        return 0;
+    }
+    const size_t target = static_cast<size_t>(static_cast<double>(byteBudget_) * CLIENT_CHUNK_CACHE_LOW_WATER);
+
+    // (distance, age) of every candidate; the largest go first
+    std::vector<std::tuple<int32_t, uint64_t, AbsoluteChunkPosition>> candidates;
+    candidates.reserve(entries_.size());
+    for (const auto& [pos, entry] : entries_) {
+        if (pinned_.contains(pos) || (keep && ChunkPosEq{}(pos, *keep))) {
+            continue;
+        }
+        int32_t distance = std::max({std::abs(pos.x - center_.x), std::abs(pos.y - center_.y), std::abs(pos.z - center_.z)});
+        candidates.emplace_back(distance, clock_ - entry.lastUsed, pos);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+        return std::tie(std::get<0>(a), std::get<1>(a)) > std::tie(std::get<0>(b), std::get<1>(b));
+    });
+
+    size_t evicted = 0;
+    for (const auto& candidate : candidates) {
+        if (bytes_ <= target) {
+            break;
+        }
+        erase(std::get<2>(candidate));
+        ++evicted;
+    }
+    evictions_ += evicted;
+    return evicted;
+}
+
+ClientChunkCacheStats ClientChunkCache::stats() const {
+    ClientChunkCacheStats result;
+    result.chunks = entries_.size();
+    result.bytes = bytes_;
+    result.byteBudget = byteBudget_;
+    result.pinned = pinned_.size();
+    result.hits = hits_;
+    result.misses = misses_;
+    result.evictions = evictions_;
+    return result;
+}
+
+size_t ClientChunkCache::chunkBytes(const ChunkSpan& chunk) {
+    return sizeof(ChunkSpan) + chunk.storageBytes();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "chunk_pos_hash.h"
+#include "chunkspan.h"
+#include "position.h"
+
+// Bytes of chunk storage the client keeps in memory before evicting
+constexpr size_t CLIENT_CHUNK_CACHE_BUDGET = 64 * 1024 * 1024;
+// Eviction frees down to this share of the budget, so one pass makes room for a batch of arrivals
+constexpr double CLIENT_CHUNK_CACHE_LOW_WATER = 0.9;
+
+struct ClientChunkCacheStats {
+    size_t chunks = 0;
+    size_t bytes = 0;
+    size_t byteBudget = 0;
+    size_t pinned = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
+
+/**
+ * @brief The client's in-memory chunks, bounded by bytes of chunk storage rather than a count.
+ *
+ * When over budget the chunks furthest from the player (by chunks on the longest axis) go first,
+ * and among chunks equally far the least recently looked up. Pinned chunks, such as those the
+ * renderer has a mesh of, are never evicted; a pin may be set before the chunk arrives.
+ * Not synchronized; Client guards it with its cache mutex.
+ */
+class ClientChunkCache {
+public:
+    explicit ClientChunkCache(size_t byteBudget = CLIENT_CHUNK_CACHE_BUDGET);
+
+    // Looks the chunk up, counting a hit or miss and marking it recently used; null when absent
+    std::shared_ptr<ChunkSpan> find(const AbsoluteChunkPosition& pos) const;
+    // As find without touching recency or statistics
+    bool contains(const AbsoluteChunkPosition& pos) const { return entries_.find(pos) != entries_.end(); }
+    // Stores or replaces the chunk, then evicts others if that went over budget
+    void insert(const AbsoluteChunkPosition& pos, std::shared_ptr<ChunkSpan> chunk);
+    bool erase(const AbsoluteChunkPosition& pos);
+    // Drops every chunk; pins are kept
+    void clear();
+
+    // Where distances are measured from; normally the player's chunk
+    void setCenter(const AbsoluteChunkPosition& center) { center_ = center; }
+    void pin(const AbsoluteChunkPosition& pos) { pinned_.insert(pos); }
+    void unpin(const AbsoluteChunkPosition& pos) { pinned_.erase(pos); }
+    bool isPinned(const AbsoluteChunkPosition& pos) const { return pinned_.contains(pos); }
+
+    // Applies immediately, evicting if the cache is now over budget
+    void setByteBudget(size_t byteBudget);
+    // Evicts until within budget (down to the low-water mark); returns the chunks evicted
+    size_t evict() { return evictExcept(nullptr); }
+
+    size_t size() const { return entries_.size(); }
+    size_t bytes() const { return bytes_; }
+    ClientChunkCacheStats stats() const;
+
+    // What a chunk is charged against the budget
+    static size_t chunkBytes(const ChunkSpan& chunk);
+
+private:
+    struct Entry {
+        std::shared_ptr<ChunkSpan> chunk;
+        size_t bytes = 0;
+        mutable uint64_t lastUsed = 0;
+    };
+
+    // keep, when set, is never chosen (the chunk just inserted)
+    size_t evictExcept(const AbsoluteChunkPosition* keep);
+
+    size_t byteBudget_;
+    ChunkPosMap<Entry> entries_;
+    ChunkSet pinned_;
+    AbsoluteChunkPosition center_{0, 0, 0};
+    size_t bytes_ = 0;
+    mutable uint64_t clock_ = 0;
+    mutable uint64_t hits_ = 0;
+    mutable uint64_t misses_ = 0;
+    uint64_t evictions_ = 0;
+};
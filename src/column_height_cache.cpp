@@ -0,0 +1,88 @@
+#include "column_height_cache.h"
+#include "metrics.h"
+
+#include <algorithm>
+
+namespace {
+
+// Shared by every ColumnHeightCache in the process; hits() and misses() stay per cache
+struct ColumnHeightCacheMetrics {
+    MetricCounter& hits = metricCounter("blocktest_cache_hits_total", "Lookups a cache answered", {{"cache", "column_height"}});
+    MetricCounter& misses = metricCounter("blocktest_cache_misses_total", "Lookups a cache had to compute", {{"cache", "column_height"}});
+};
+
+ColumnHeightCacheMetrics& cacheMetrics() {
+    static ColumnHeightCacheMetrics metrics;
+    return metrics;
+}
+
+} // namespace
+
+ColumnHeightCache::ColumnHeightCache(Sampler sampler, size_t capacity)
+    : sampler_(std::move(sampler)),
+      capacity_(std::max<size_t>(capacity, 1)),
+      shardCapacity_((capacity_ + COLUMN_HEIGHT_CACHE_SHARDS - 1) / COLUMN_HEIGHT_CACHE_SHARDS) {
+    static_assert((COLUMN_HEIGHT_CACHE_SHARDS & (COLUMN_HEIGHT_CACHE_SHARDS - 1)) == 0, "shard count must be a power of two");
+}
+
+ColumnHeightCache::Shard& ColumnHeightCache::shardFor(const AbsoluteChunkPosition& key) {
+    // The high bits of the hash pick the shard; the table inside uses the low bits
+    return shards_[(ChunkPosHash{}(key) >> 58) & (COLUMN_HEIGHT_CACHE_SHARDS - 1)];
+}
+
+std::shared_ptr<const ColumnHeightCache::Column> ColumnHeightCache::column(int32_t chunkX, int32_t chunkZ) {
+    const AbsoluteChunkPosition key(chunkX, 0, chunkZ);
+    Shard& shard = shardFor(key);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            cacheMetrics().hits.add();
+            return it->second->second;
+        }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    cacheMetrics().misses.add();
+
+    auto computed = std::make_shared<Column>();
+    const int64_t originX = static_cast<int64_t>(chunkX) * CHUNK_WIDTH;
+    const int64_t originZ = static_cast<int64_t>(chunkZ) * CHUNK_DEPTH;
+    for (int z = 0; z < CHUNK_DEPTH; ++z) {
+        for (int x = 0; x < CHUNK_WIDTH; ++x) {
+            (*computed)[x + z * CHUNK_WIDTH] = sampler_(originX + x, originZ + z);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        // Another thread computed it first; its result is identical
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return it->second->second;
+    }
+    shard.lru.emplace_front(key, computed);
+    shard.index.emplace(key, shard.lru.begin());
+    if (shard.lru.size() > shardCapacity_) {
+        shard.index.erase(shard.lru.back().first);
+        shard.lru.pop_back();
+    }
+    return computed;
+}
+
+double ColumnHeightCache::sample(int64_t worldX, int64_t worldZ) {
+    const AbsoluteBlockPosition block(worldX, 0, worldZ);
+    const AbsoluteChunkPosition chunk = toAbsoluteChunk(block);
+    const ChunkLocalPosition local = toChunkLocal(block, chunk);
+    return (*column(chunk.x, chunk.z))[local.x + local.z * CHUNK_WIDTH];
+}
+
+size_t ColumnHeightCache::size() const {
+    size_t total = 0;
+    for (const Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.lru.size();
+    }
+    return total;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "chunk_pos_hash.h"
+#include "chunkdims.h"
+#include "position.h"
+
+// Independently locked shards of a ColumnHeightCache; a power of two
+constexpr size_t COLUMN_HEIGHT_CACHE_SHARDS = 16;
+// Default number of chunk columns kept (each holds CHUNK_WIDTH * CHUNK_DEPTH doubles)
+constexpr size_t COLUMN_HEIGHT_CACHE_DEFAULT_CAPACITY = 4096;
+
+/**
+ * @brief Thread-safe, LRU-bounded cache of a 2D function of (worldX, worldZ), such as a noise heightmap.
+ *
+ * Samples are computed and stored one chunk column at a time (all CHUNK_WIDTH x CHUNK_DEPTH
+ * positions of a chunk's footprint), so every chunk stacked vertically in that column shares
+ * them. Each cache is bound to one sampler for its whole life; transforms that use different
+ * noise parameters need different caches.
+ *
+ * The cache is split into COLUMN_HEIGHT_CACHE_SHARDS shards with their own lock and LRU list.
+ * Misses run the sampler without holding a lock, so generation threads never wait on each
+ * other's noise; two threads missing the same column may both compute it, and one result wins.
+ */
+class ColumnHeightCache {
+public:
+    // Samples indexed x + z * CHUNK_WIDTH by chunk-local position
+    using Column = std::array<double, CHUNK_WIDTH * CHUNK_DEPTH>;
+    using Sampler = std::function<double(int64_t worldX, int64_t worldZ)>;
+
+    explicit ColumnHeightCache(Sampler sampler, size_t capacity = COLUMN_HEIGHT_CACHE_DEFAULT_CAPACITY);
+    ColumnHeightCache(const ColumnHeightCache&) = delete;
+    ColumnHeightCache& operator=(const ColumnHeightCache&) = delete;
+
+    // Samples for the chunk column at (chunkX, chunkZ), computing them on a miss
+    std::shared_ptr<const Column> column(int32_t chunkX, int32_t chunkZ);
+    // The sample at one world position; looks up its whole column
+    double sample(int64_t worldX, int64_t worldZ);
+
+    // Columns currently cached
+    size_t size() const;
+    size_t capacity() const { return capacity_; }
+    size_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    size_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        // Most recently used first
+        std::list<std::pair<AbsoluteChunkPosition, std::shared_ptr<const Column>>> lru;
+        ChunkPosMap<decltype(lru)::iterator> index;
+    };
+
+    Shard& shardFor(const AbsoluteChunkPosition& key);
+
+    const Sampler sampler_;
+    const size_t capacity_;
+    const size_t shardCapacity_;
+    std::array<Shard, COLUMN_HEIGHT_CACHE_SHARDS> shards_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+};
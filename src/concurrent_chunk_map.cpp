@@ -0,0 +1,129 @@
+#include "concurrent_chunk_map.h"
+
+#include <algorithm>
+
+size_t ConcurrentChunkMap::shardIndex(const AbsoluteChunkPosition& pos) {
+    // Fibonacci-hash the packed coordinates; neighbouring chunks land on different shards
+    const uint64_t packed = (uint64_t{static_cast<uint32_t>(pos.x)} * 0x9E3779B1u)
+                          ^ (uint64_t{static_cast<uint32_t>(pos.y)} << 21)
+                          ^ (uint64_t{static_cast<uint32_t>(pos.z)} << 42);
+    static_assert((CONCURRENT_CHUNK_MAP_SHARDS & (CONCURRENT_CHUNK_MAP_SHARDS - 1)) == 0, "shard count must be a power of two");
+    return static_cast<size_t>((packed * 0x9E3779B97F4A7C15ull) >> 40) & (CONCURRENT_CHUNK_MAP_SHARDS - 1);
+}
+
+std::shared_ptr<const ChunkSpan> ConcurrentChunkMap::find(const AbsoluteChunkPosition& pos) const {
+    const Shard& shard = shardFor(pos);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.entries.find(pos);
+    return it != shard.entries.end() ? it->second.chunk : nullptr;
+}
+
+bool ConcurrentChunkMap::contains(const AbsoluteChunkPosition& pos) const {
+    const Shard& shard = shardFor(pos);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    return shard.entries.find(pos) != shard.entries.end();
+}
+
+bool ConcurrentChunkMap::insert(const AbsoluteChunkPosition& pos, std::shared_ptr<const ChunkSpan> chunk, bool dirty) {
+    Shard& shard = shardFor(pos);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    if (!shard.entries.emplace(pos, Entry{std::move(chunk), dirty}).second) {
+        return false;
+    }
+    countRegion(pos, 1);
+    return true;
+}
+
+std::optional<ConcurrentChunkMap::Entry> ConcurrentChunkMap::erase(const AbsoluteChunkPosition& pos) {
+    Shard& shard = shardFor(pos);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.entries.find(pos);
+    if (it == shard.entries.end()) {
+        return std::nullopt;
+    }
+    Entry removed = std::move(it->second);
+    shard.entries.erase(it);
+    countRegion(pos, -1);
+    return removed;
+}
+
+size_t ConcurrentChunkMap::size() const {
+    size_t total = 0;
+    for (const Shard& shard : shards_) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        total += shard.entries.size();
+    }
+    return total;
+}
+
+bool ConcurrentChunkMap::anyLoadedIn(const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max) const {
+    if (min.x > max.x || min.y > max.y || min.z > max.z) {
+        return false;
+    }
+    constexpr int32_t regionSize = 1 << CONCURRENT_CHUNK_MAP_REGION_SHIFT;
+    const AbsoluteChunkPosition regionMin = regionOf(min);
+    const AbsoluteChunkPosition regionMax = regionOf(max);
+    // Regions with chunks that the box only partly covers; probed below, outside the region lock
+    std::vector<AbsoluteChunkPosition> partial;
+    {
+        std::lock_guard<std::mutex> lock(regionsMutex_);
+        for (int32_t rz = regionMin.z; rz <= regionMax.z; ++rz) {
+            for (int32_t ry = regionMin.y; ry <= regionMax.y; ++ry) {
+                for (int32_t rx = regionMin.x; rx <= regionMax.x; ++rx) {
+                    const AbsoluteChunkPosition region(rx, ry, rz);
+                    if (regionCounts_.find(region) == regionCounts_.end()) {
+                        continue;
+                    }
+                    const AbsoluteChunkPosition first(rx * regionSize, ry * regionSize, rz * regionSize);
+                    const bool covered = min.x <= first.x && first.x + regionSize - 1 <= max.x && min.y <= first.y &&
+                                         first.y + regionSize - 1 <= max.y && min.z <= first.z && first.z + regionSize - 1 <= max.z;
+                    if (covered) {
+                        return true;
+                    }
+                    partial.push_back(region);
+                }
+            }
+        }
+    }
+    for (const AbsoluteChunkPosition& region : partial) {
+        const AbsoluteChunkPosition first(region.x * regionSize, region.y * regionSize, region.z * regionSize);
+        for (int32_t z = std::max(min.z, first.z); z <= std::min(max.z, first.z + regionSize - 1); ++z) {
+            for (int32_t y = std::max(min.y, first.y); y <= std::min(max.y, first.y + regionSize - 1); ++y) {
+                for (int32_t x = std::max(min.x, first.x); x <= std::min(max.x, first.x + regionSize - 1); ++x) {
+                    if (contains(AbsoluteChunkPosition(x, y, z))) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+AbsoluteChunkPosition ConcurrentChunkMap::regionOf(const AbsoluteChunkPosition& pos) {
+    // Arithmetic shifts round toward negative infinity, so regions don't straddle 0
+    return AbsoluteChunkPosition(pos.x >> CONCURRENT_CHUNK_MAP_REGION_SHIFT, pos.y >> CONCURRENT_CHUNK_MAP_REGION_SHIFT,
+                                 pos.z >> CONCURRENT_CHUNK_MAP_REGION_SHIFT);
+}
+
+void ConcurrentChunkMap::countRegion(const AbsoluteChunkPosition& pos, int delta) {
+    std::lock_guard<std::mutex> lock(regionsMutex_);
+    const AbsoluteChunkPosition region = regionOf(pos);
+    size_t& count = regionCounts_[region];
+    if (delta > 0) {
+        ++count;
+    } else if (--count == 0) {
+        regionCounts_.erase(region);
+    }
+}
+
+void ConcurrentChunkMap::takeDirty(size_t shardIndex, std::vector<std::shared_ptr<const ChunkSpan>>& out) {
+    Shard& shard = shards_[shardIndex];
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    for (auto& [pos, entry] : shard.entries) {
+        if (entry.dirty) {
+            out.push_back(entry.chunk);
+            entry.dirty = false;
+        }
+    }
+}
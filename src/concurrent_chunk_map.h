@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "chunk_arena.h"
+#include "chunkspan.h"
+#include "position.h"
+#include "world.h"
+
+// Number of independently locked shards; a power of two
+constexpr size_t CONCURRENT_CHUNK_MAP_SHARDS = 64;
+// Loaded chunks are also counted per aligned cube of 2^this chunks on every axis
+constexpr int CONCURRENT_CHUNK_MAP_REGION_SHIFT = 3;
+
+/**
+ * @brief Chunk position -> loaded chunk map that many threads can read and write at once.
+ *
+ * Positions are spread over CONCURRENT_CHUNK_MAP_SHARDS shards, each behind its own
+ * reader/writer lock, so lookups on different shards never contend and lookups on the same
+ * shard only share a lock.
+ *
+ * Chunks are published copy-on-write: a pointer returned by find() is an immutable snapshot
+ * that stays valid and unchanged however long the caller holds it. update() copies the chunk,
+ * applies the edit to the copy and swaps it in under the shard's write lock, so concurrent
+ * block writes to one chunk are serialized and never observed half-done.
+ *
+ * A count of loaded chunks per region lets anyLoadedIn() skip empty stretches of a box without
+ * visiting the shards.
+ */
+class ConcurrentChunkMap {
+public:
+    struct Entry {
+        std::shared_ptr<const ChunkSpan> chunk;
+        // Differs from what persistence holds
+        bool dirty = false;
+    };
+
+    ConcurrentChunkMap() = default;
+    ConcurrentChunkMap(const ConcurrentChunkMap&) = delete;
+    ConcurrentChunkMap& operator=(const ConcurrentChunkMap&) = delete;
+
+    // Null when the position isn't loaded
+    std::shared_ptr<const ChunkSpan> find(const AbsoluteChunkPosition& pos) const;
+    bool contains(const AbsoluteChunkPosition& pos) const;
+    // Does nothing and returns false if the position is already loaded
+    bool insert(const AbsoluteChunkPosition& pos, std::shared_ptr<const ChunkSpan> chunk, bool dirty);
+    // Removes the chunk and returns what was stored
+    std::optional<Entry> erase(const AbsoluteChunkPosition& pos);
+    size_t size() const;
+    // Whether any chunk in min..max (inclusive) is loaded; regions with none are skipped wholesale
+    bool anyLoadedIn(const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max) const;
+
+    /**
+     * @brief Applies edit(ChunkSpan&) to a private copy of the chunk, then publishes the copy and marks it dirty.
+     * @return The value edit returned (or true for void edits), or false if the position isn't loaded.
+     */
+    template<typename F>
+    bool update(const AbsoluteChunkPosition& pos, F&& edit) {
+        Shard& shard = shardFor(pos);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.entries.find(pos);
+        if (it == shard.entries.end()) {
+            return false;
+        }
+        auto copy = makePooledChunk(*it->second.chunk);
+        if constexpr (std::is_void_v<std::invoke_result_t<F, ChunkSpan&>>) {
+            edit(*copy);
+        } else {
+            if (!edit(*copy)) return false;
+        }
+        it->second.chunk = std::move(copy);
+        it->second.dirty = true;
+        return true;
+    }
+
+    // Calls func(pos, entry) for every loaded chunk, one shard at a time under its read lock
+    template<typename F>
+    void forEach(F&& func) const {
+        for (const Shard& shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            for (const auto& [pos, entry] : shard.entries) {
+                func(pos, entry);
+            }
+        }
+    }
+
+    // Appends the dirty chunks of one shard to out and marks them clean, for saving a shard at a time
+    void takeDirty(size_t shardIndex, std::vector<std::shared_ptr<const ChunkSpan>>& out);
+
+    static size_t shardIndex(const AbsoluteChunkPosition& pos);
+
+private:
+    // Own cache line each so shard locks don't false-share
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        ChunkPosMap<Entry> entries;
+    };
+
+    Shard& shardFor(const AbsoluteChunkPosition& pos) { return shards_[shardIndex(pos)]; }
+    const Shard& shardFor(const AbsoluteChunkPosition& pos) const { return shards_[shardIndex(pos)]; }
+
+    static AbsoluteChunkPosition regionOf(const AbsoluteChunkPosition& pos);
+    void countRegion(const AbsoluteChunkPosition& pos, int delta);
+
+    std::array<Shard, CONCURRENT_CHUNK_MAP_SHARDS> shards_;
+    // Taken after a shard's lock, never before
+    mutable std::mutex regionsMutex_;
+    // Loaded chunks by regionOf; regions with none have no entry
+    ChunkPosMap<size_t> regionCounts_;
+};
@@ -0,0 +1,130 @@
+#include "dirty_chunk_tracker.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+int32_t floorDiv(int32_t value, int32_t divisor) {
+    int32_t quotient = value / divisor;
+    return (value % divisor != 0 && value < 0) ? quotient - 1 : quotient;
+}
+
+bool inArea(const AbsoluteChunkPosition& pos, const AbsoluteChunkPosition& center, int32_t radius) {
+    return std::max({std::abs(pos.x - center.x), std::abs(pos.y - center.y), std::abs(pos.z - center.z)}) <= radius;
+}
+
+} // namespace
+
+DirtyChunkTracker::DirtyChunkTracker(int32_t regionSize) : regionSize_(std::max<int32_t>(regionSize, 1)) {}
+
+AbsoluteChunkPosition DirtyChunkTracker::regionOf(const AbsoluteChunkPosition& pos) const {
+    return AbsoluteChunkPosition(floorDiv(pos.x, regionSize_), floorDiv(pos.y, regionSize_), floorDiv(pos.z, regionSize_));
+}
+
+void DirtyChunkTracker::markDirty(const AbsoluteChunkPosition& pos) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = regions_.find(regionOf(pos));
+    if (it == regions_.end()) {
+        return;
+    }
+    for (Watcher* watcher : it->second) {
+        if (inArea(pos, watcher->center, watcher->radius)) {
+            watcher->dirty.insert(pos);
+        }
+    }
+}
+
+std::vector<AbsoluteChunkPosition> DirtyChunkTracker::poll(const std::string& watcherId, const AbsoluteChunkPosition& center, int32_t radius) {
+    radius = std::max<int32_t>(radius, 0);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& slot = watchers_[watcherId];
+    if (!slot) {
+        slot = std::make_unique<Watcher>();
+    }
+    Watcher* watcher = slot.get();
+    watcher->lastPoll = std::chrono::steady_clock::now();
+
+    std::vector<AbsoluteChunkPosition> result;
+    result.reserve(watcher->dirty.size());
+    for (const auto& pos : watcher->dirty) {
+        if (inArea(pos, center, radius)) {
+            result.push_back(pos);
+        }
+    }
+    watcher->dirty.clear();
+
+    if (!ChunkPosEq{}(watcher->center, center) || watcher->radius != radius) {
+        unindexLocked(watcher);
+        watcher->center = center;
+        watcher->radius = radius;
+        indexLocked(watcher);
+    }
+    return result;
+}
+
+void DirtyChunkTracker::indexLocked(Watcher* watcher) {
+    const AbsoluteChunkPosition low = regionOf(AbsoluteChunkPosition(watcher->center.x - watcher->radius, watcher->center.y - watcher->radius, watcher->center.z - watcher->radius));
+    const AbsoluteChunkPosition high = regionOf(AbsoluteChunkPosition(watcher->center.x + watcher->radius, watcher->center.y + watcher->radius, watcher->center.z + watcher->radius));
+    for (int32_t x = low.x; x <= high.x; ++x) {
+        for (int32_t y = low.y; y <= high.y; ++y) {
+            for (int32_t z = low.z; z <= high.z; ++z) {
+                AbsoluteChunkPosition region(x, y, z);
+                regions_[region].push_back(watcher);
+                watcher->regions.push_back(region);
+            }
+        }
+    }
+}
+
+void DirtyChunkTracker::unindexLocked(Watcher* watcher) {
+    for (const auto& region : watcher->regions) {
+        auto it = regions_.find(region);
+        if (it == regions_.end()) {
+            continue;
+        }
+        auto& listed = it->second;
+        listed.erase(std::remove(listed.begin(), listed.end(), watcher), listed.end());
+        if (listed.empty()) {
+            regions_.erase(it);
+        }
+    }
+    watcher->regions.clear();
+}
+
+void DirtyChunkTracker::remove(const std::string& watcherId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = watchers_.find(watcherId);
+    if (it == watchers_.end()) {
+        return;
+    }
+    unindexLocked(it->second.get());
+    watchers_.erase(it);
+}
+
+size_t DirtyChunkTracker::removeIdle(std::chrono::steady_clock::duration maxIdle) {
+    const auto cutoff = std::chrono::steady_clock::now() - maxIdle;
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t removed = 0;
+    for (auto it = watchers_.begin(); it != watchers_.end();) {
+        if (it->second->lastPoll < cutoff) {
+            unindexLocked(it->second.get());
+            it = watchers_.erase(it);
+            ++removed;
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+size_t DirtyChunkTracker::watcherCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return watchers_.size();
+}
+
+size_t DirtyChunkTracker::watchersNear(const AbsoluteChunkPosition& pos) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = regions_.find(regionOf(pos));
+    return it == regions_.end() ? 0 : it->second.size();
+}
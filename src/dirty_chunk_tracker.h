@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "chunk_pos_hash.h"
+#include "position.h"
+
+// Edge length, in chunks, of the cubic regions watchers are indexed by
+constexpr int32_t DIRTY_CHUNK_REGION_SIZE = 8;
+
+/**
+ * @brief Per-watcher queues of changed chunks, fed through a region index so an edit only
+ * touches the watchers whose area covers it.
+ *
+ * A watcher (one polling player) declares its area, a Chebyshev radius in chunks around a
+ * center chunk, each time it polls. markDirty() looks up the edit's region and queues the chunk
+ * for every watcher there that has it in range; poll() hands back and clears that watcher's queue.
+ * Edits outside a watcher's area at the time are not kept for it. Safe to use from any thread.
+ */
+class DirtyChunkTracker {
+public:
+    explicit DirtyChunkTracker(int32_t regionSize = DIRTY_CHUNK_REGION_SIZE);
+
+    void markDirty(const AbsoluteChunkPosition& pos);
+
+    /**
+     * @brief Moves the watcher's area to center/radius and takes the chunks changed in its old area
+     * since the last poll that are still inside the new one. The first poll only starts tracking.
+     */
+    std::vector<AbsoluteChunkPosition> poll(const std::string& watcher, const AbsoluteChunkPosition& center, int32_t radius);
+
+    void remove(const std::string& watcher);
+    // Drops watchers that haven't polled for maxIdle
+    size_t removeIdle(std::chrono::steady_clock::duration maxIdle);
+
+    size_t watcherCount() const;
+    // Watchers registered in the region holding pos
+    size_t watchersNear(const AbsoluteChunkPosition& pos) const;
+
+private:
+    struct Watcher {
+        AbsoluteChunkPosition center{0, 0, 0};
+        int32_t radius = -1;
+        ChunkSet dirty;
+        // Regions this watcher is listed in
+        std::vector<AbsoluteChunkPosition> regions;
+        std::chrono::steady_clock::time_point lastPoll;
+    };
+
+    AbsoluteChunkPosition regionOf(const AbsoluteChunkPosition& pos) const;
+    void unindexLocked(Watcher* watcher);
+    void indexLocked(Watcher* watcher);
+
+    const int32_t regionSize_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::unique_ptr<Watcher>> watchers_;
+    ChunkPosMap<std::vector<Watcher*>> regions_;
+};
@@ -0,0 +1,83 @@
+#include "encoded_chunk_cache.h"
+#include "metrics.h"
+
+#include <algorithm>
+
+namespace {
+
+// Shared by every EncodedChunkCache in the process; hits() and misses() stay per cache
+struct EncodedChunkCacheMetrics {
+    MetricCounter& hits = metricCounter("blocktest_cache_hits_total", "Lookups a cache answered", {{"cache", "encoded_chunk"}});
+    MetricCounter& misses = metricCounter("blocktest_cache_misses_total", "Lookups a cache had to compute", {{"cache", "encoded_chunk"}});
+    MetricHistogram& encodeSeconds = metricHistogram("blocktest_chunk_encode_seconds", "Time to serialize a chunk for the wire");
+    MetricHistogram& encodedBytes = metricHistogram("blocktest_chunk_encoded_bytes", "Size of a serialized chunk", {}, sizeBuckets());
+};
+
+EncodedChunkCacheMetrics& cacheMetrics() {
+    static EncodedChunkCacheMetrics metrics;
+    return metrics;
+}
+
+} // namespace
+
+EncodedChunkCache::EncodedChunkCache(size_t capacity)
+    : capacity_(std::max<size_t>(capacity, 1)) {}
+
+std::shared_ptr<const EncodedChunkCache::Entry> EncodedChunkCache::get(const ChunkSpan& chunk) {
+    const AbsoluteChunkPosition& pos = chunk.position;
+    const std::uint64_t version = chunk.version();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(pos);
+        if (it != index_.end() && it->second->second->version == version) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            cacheMetrics().hits.add();
+            return it->second->second;
+        }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    EncodedChunkCacheMetrics& metrics = cacheMetrics();
+    metrics.misses.add();
+
+    std::shared_ptr<const Entry> encoded;
+    {
+        ScopedMetricTimer timer(metrics.encodeSeconds);
+        auto serialized = chunk.serialize();
+        encoded = std::make_shared<const Entry>(Entry{
+            version, chunk.contentHash(), std::string(serialized.begin(), serialized.end())});
+    }
+    metrics.encodedBytes.observe(static_cast<double>(encoded->bytes.size()));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(pos);
+    if (it != index_.end()) {
+        // Keep whichever of the two encodings is newer
+        if (it->second->second->version < version) {
+            it->second->second = encoded;
+        }
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return encoded;
+    }
+    lru_.emplace_front(pos, encoded);
+    index_.emplace(pos, lru_.begin());
+    if (lru_.size() > capacity_) {
+        index_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+    return encoded;
+}
+
+void EncodedChunkCache::invalidate(const AbsoluteChunkPosition& pos) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(pos);
+    if (it != index_.end()) {
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+}
+
+size_t EncodedChunkCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lru_.size();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "chunk_pos_hash.h"
+#include "chunkspan.h"
+#include "position.h"
+
+// Default number of encoded chunks kept by an EncodedChunkCache
+constexpr size_t ENCODED_CHUNK_CACHE_DEFAULT_CAPACITY = 4096;
+
+/**
+ * @brief LRU cache of ChunkSpan::serialize() output and contentHash(), for serving the same chunk
+ * to many clients without re-encoding it each time.
+ *
+ * Entries are keyed by chunk position and remembered with the ChunkSpan::version() they were
+ * encoded from; a lookup with any other version re-encodes, so a stale entry is never returned
+ * even without invalidate(). Relies on published chunks being immutable, as World's are. Safe to
+ * use from any thread; encoding runs without holding the lock.
+ */
+class EncodedChunkCache {
+public:
+    struct Entry {
+        std::uint64_t version;
+        std::uint64_t contentHash;
+        std::string bytes; // serialized chunk, ready for a protobuf bytes field
+    };
+
+    explicit EncodedChunkCache(size_t capacity = ENCODED_CHUNK_CACHE_DEFAULT_CAPACITY);
+    EncodedChunkCache(const EncodedChunkCache&) = delete;
+    EncodedChunkCache& operator=(const EncodedChunkCache&) = delete;
+
+    // The encoding of chunk at its current version, encoding it on a miss
+    std::shared_ptr<const Entry> get(const ChunkSpan& chunk);
+    // Drops the entry for pos, e.g. after the chunk was edited
+    void invalidate(const AbsoluteChunkPosition& pos);
+
+    size_t size() const;
+    size_t capacity() const { return capacity_; }
+    size_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    size_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    // Most recently used first
+    std::list<std::pair<AbsoluteChunkPosition, std::shared_ptr<const Entry>>> lru_;
+    ChunkPosMap<decltype(lru_)::iterator> index_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+};
@@ -0,0 +1,140 @@
+#include "entity_spatial_index.h"
+
+#include <cmath>
+
+namespace {
+
+const std::vector<entt::entity> NO_ENTITIES;
+
+} // namespace
+
+bool EntitySpatialIndex::update(entt::entity entity, const AbsolutePrecisePosition& position) {
+    const AbsoluteChunkPosition chunk = toAbsoluteChunk(position);
+    auto it = entities_.find(entity);
+    if (it != entities_.end()) {
+        Entry& entry = it->second;
+        entry.position = position;
+        if (ChunkPosEq{}(entry.chunk, chunk)) {
+            return false;
+        }
+        unlink(entry);
+        auto& bucket = buckets_[chunk];
+        entry.chunk = chunk;
+        entry.slot = static_cast<uint32_t>(bucket.size());
+        bucket.push_back(entity);
+    } else {
+        auto& bucket = buckets_[chunk];
+        entities_.emplace(entity, Entry{chunk, position, static_cast<uint32_t>(bucket.size())});
+        bucket.push_back(entity);
+    }
+    chunkChanges_.insert(entity);
+    return true;
+}
+
+bool EntitySpatialIndex::remove(entt::entity entity) {
+    auto it = entities_.find(entity);
+    if (it == entities_.end()) {
+        return false;
+    }
+    unlink(it->second);
+    entities_.erase(it);
+    chunkChanges_.insert(entity);
+    return true;
+}
+
+void EntitySpatialIndex::unlink(const Entry& entry) {
+    auto bucket = buckets_.find(entry.chunk);
+    auto& members = bucket->second;
+    // Swap the last member into the hole and tell it where it went
+    const entt::entity last = members.back();
+    members[entry.slot] = last;
+    entities_.find(last)->second.slot = entry.slot;
+    members.pop_back();
+    if (members.empty()) {
+        buckets_.erase(bucket);
+    }
+}
+
+std::optional<AbsoluteChunkPosition> EntitySpatialIndex::chunkOf(entt::entity entity) const {
+    auto it = entities_.find(entity);
+    if (it == entities_.end()) {
+        return std::nullopt;
+    }
+    return it->second.chunk;
+}
+
+std::optional<AbsolutePrecisePosition> EntitySpatialIndex::positionOf(entt::entity entity) const {
+    auto it = entities_.find(entity);
+    if (it == entities_.end()) {
+        return std::nullopt;
+    }
+    return it->second.position;
+}
+
+const std::vector<entt::entity>& EntitySpatialIndex::entitiesIn(const AbsoluteChunkPosition& chunk) const {
+    auto bucket = buckets_.find(chunk);
+    return bucket == buckets_.end() ? NO_ENTITIES : bucket->second;
+}
+
+template<typename F>
+void EntitySpatialIndex::forEachBucketIn(const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max, F&& f) const {
+    if (min.x > max.x || min.y > max.y || min.z > max.z) {
+        return;
+    }
+    const uint64_t volume = static_cast<uint64_t>(int64_t{max.x} - min.x + 1)
+                          * static_cast<uint64_t>(int64_t{max.y} - min.y + 1)
+                          * static_cast<uint64_t>(int64_t{max.z} - min.z + 1);
+    // Walk whichever is smaller: the chunks in the box or the occupied chunks
+    if (volume <= buckets_.size()) {
+        for (int32_t y = min.y; y <= max.y; ++y) {
+            for (int32_t z = min.z; z <= max.z; ++z) {
+                for (int32_t x = min.x; x <= max.x; ++x) {
+                    auto bucket = buckets_.find(AbsoluteChunkPosition(x, y, z));
+                    if (bucket != buckets_.end()) {
+                        f(bucket->second);
+                    }
+                }
+            }
+        }
+    } else {
+        for (const auto& [chunk, members] : buckets_) {
+            if (chunk.x >= min.x && chunk.x <= max.x && chunk.y >= min.y && chunk.y <= max.y &&
+                chunk.z >= min.z && chunk.z <= max.z) {
+                f(members);
+            }
+        }
+    }
+}
+
+void EntitySpatialIndex::queryBox(const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max, std::vector<entt::entity>& out) const {
+    forEachBucketIn(min, max, [&](const std::vector<entt::entity>& members) {
+        out.insert(out.end(), members.begin(), members.end());
+    });
+}
+
+void EntitySpatialIndex::queryRadius(const AbsolutePrecisePosition& center, double radius, std::vector<entt::entity>& out) const {
+    if (!(radius >= 0.0)) {
+        return;
+    }
+    // Chunks overlapping the sphere's bounding box, then the exact distance per entity
+    const AbsoluteChunkPosition min = toAbsoluteChunk(AbsolutePrecisePosition(center.x - radius, center.y - radius, center.z - radius));
+    const AbsoluteChunkPosition max = toAbsoluteChunk(AbsolutePrecisePosition(center.x + radius, center.y + radius, center.z + radius));
+    const double radiusSquared = radius * radius;
+    forEachBucketIn(min, max, [&](const std::vector<entt::entity>& members) {
+        for (entt::entity entity : members) {
+            const AbsolutePrecisePosition& p = entities_.at(entity).position;
+            const double dx = p.x - center.x;
+            const double dy = p.y - center.y;
+            const double dz = p.z - center.z;
+            if (dx * dx + dy * dy + dz * dz <= radiusSquared) {
+                out.push_back(entity);
+            }
+        }
+    });
+}
+
+std::vector<entt::entity> EntitySpatialIndex::takeChunkChanges() {
+    std::vector<entt::entity> changes(chunkChanges_.begin(), chunkChanges_.end());
+    chunkChanges_.clear();
+    return changes;
+}
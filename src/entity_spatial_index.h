@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <entt/entt.hpp>
+
+#include "chunk_pos_hash.h"
+#include "position.h"
+
+/**
+ * @brief Buckets positioned entities by the chunk they are in, so "who is near here" costs the
+ * chunks in range rather than every entity.
+ *
+ * World keeps one over its registry, updated wherever an entity is spawned, moved or despawned.
+ * Moving within a chunk only rewrites the stored position; crossing into another chunk is an O(1)
+ * swap out of the old bucket. Queries walk whichever is smaller, the chunks in range or the occupied
+ * buckets. Entities whose chunk changed are also remembered until takeChunkChanges(), which is all
+ * the residency tracker needs to hear about. Not synchronized.
+ */
+class EntitySpatialIndex {
+public:
+    // Adds the entity or moves it; true when it is new or changed chunk
+    bool update(entt::entity entity, const AbsolutePrecisePosition& position);
+    // False when the entity wasn't indexed
+    bool remove(entt::entity entity);
+
+    std::optional<AbsoluteChunkPosition> chunkOf(entt::entity entity) const;
+    std::optional<AbsolutePrecisePosition> positionOf(entt::entity entity) const;
+    // Entities currently in the chunk, in no particular order
+    const std::vector<entt::entity>& entitiesIn(const AbsoluteChunkPosition& chunk) const;
+
+    // Appends the entities in chunks min..max, inclusive on every axis
+    void queryBox(const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max, std::vector<entt::entity>& out) const;
+    // Appends the entities within radius blocks (Euclidean) of center
+    void queryRadius(const AbsolutePrecisePosition& center, double radius, std::vector<entt::entity>& out) const;
+
+    // Entities added, removed or moved to another chunk since the last call; chunkOf tells which
+    std::vector<entt::entity> takeChunkChanges();
+
+    size_t size() const { return entities_.size(); }
+    size_t occupiedChunkCount() const { return buckets_.size(); }
+
+private:
+    struct Entry {
+        AbsoluteChunkPosition chunk;
+        AbsolutePrecisePosition position;
+        // Index in the chunk's bucket, so leaving it doesn't search
+        uint32_t slot;
+    };
+
+    void unlink(const Entry& entry);
+    template<typename F>
+    void forEachBucketIn(const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max, F&& f) const;
+
+    FlatHashMap<entt::entity, Entry> entities_;
+    ChunkPosMap<std::vector<entt::entity>> buckets_;
+    FlatHashSet<entt::entity> chunkChanges_;
+};
@@ -0,0 +1,192 @@
+#include "entity_sync.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "name_component.h"
+#include "snapshot_archive.h"
+
+namespace {
+// Component flags in encoded entity data
+constexpr std::uint8_t HAS_POSITION = 1 << 0;
+constexpr std::uint8_t HAS_NAME = 1 << 1;
+
+int32_t quantize(double value) {
+    return static_cast<int32_t>(std::lround(value * ENTITY_POSITION_STEPS_PER_BLOCK));
+}
+} // namespace
+
+QuantizedPosition quantizePosition(const AbsolutePrecisePosition& position) {
+    return QuantizedPosition{quantize(position.x), quantize(position.y), quantize(position.z)};
+}
+
+AbsolutePrecisePosition dequantizePosition(const QuantizedPosition& position) {
+    constexpr double step = 1.0 / ENTITY_POSITION_STEPS_PER_BLOCK;
+    return AbsolutePrecisePosition(position.x * step, position.y * step, position.z * step);
+}
+
+std::vector<std::uint8_t> encodeEntityComponents(const EntityDelta& delta) {
+    std::vector<std::uint8_t> out;
+    out.reserve(1 + sizeof(QuantizedPosition) + (delta.name ? sizeof(std::uint64_t) + delta.name->size() : 0));
+    VectorOutputArchive archive(out);
+    std::uint8_t flags = (delta.position ? HAS_POSITION : 0) | (delta.name ? HAS_NAME : 0);
+    archive(flags);
+    if (delta.position) archive(*delta.position);
+    if (delta.name) archive(*delta.name);
+    return out;
+}
+
+void decodeEntityComponents(const std::vector<std::uint8_t>& data, EntityDelta& delta) {
+    VectorInputArchive archive(data);
+    std::uint8_t flags = 0;
+    archive(flags);
+    if (flags & ~(HAS_POSITION | HAS_NAME)) {
+        throw std::runtime_error("Unknown entity component flags");
+    }
+    if (flags & HAS_POSITION) {
+        QuantizedPosition position;
+        archive(position);
+        delta.position = position;
+    }
+    if (flags & HAS_NAME) {
+        std::string name;
+        archive(name);
+        delta.name = std::move(name);
+    }
+}
+
+void EntityMirror::clear() {
+    for (const auto& [remote, local] : remote_) {
+        registry_.destroy(local);
+    }
+    remote_.clear();
+}
+
+void EntityMirror::apply(const EntityDelta& delta) {
+    auto it = remote_.find(delta.entity);
+    if (delta.removed) {
+        if (it != remote_.end()) {
+            registry_.destroy(it->second);
+            remote_.erase(it);
+        }
+        return;
+    }
+    if (it == remote_.end()) {
+        it = remote_.emplace(delta.entity, registry_.create()).first;
+    }
+    auto& reg = registry_.raw();
+    if (delta.position) {
+        reg.emplace_or_replace<AbsolutePrecisePosition>(it->second, dequantizePosition(*delta.position));
+    }
+    if (delta.name) {
+        reg.emplace_or_replace<NameComponent>(it->second, *delta.name);
+    }
+}
+
+std::optional<entt::entity> EntityMirror::localEntity(EntityId remote) const {
+    auto it = remote_.find(remote);
+    if (it == remote_.end()) return std::nullopt;
+    return it->second;
+}
+
+void EntityTracker::markDirty(entt::entity entity) {
+    std::lock_guard<std::mutex> lock(dirtyMutex_);
+    dirty_.insert(static_cast<EntityId>(entity));
+}
+
+bool EntityTracker::hasDirty() const {
+    std::lock_guard<std::mutex> lock(dirtyMutex_);
+    return !dirty_.empty();
+}
+
+void EntityTracker::refresh(const entt::registry& registry) {
+    std::unordered_set<EntityId> dirty;
+    {
+        std::lock_guard<std::mutex> lock(dirtyMutex_);
+        dirty.swap(dirty_);
+    }
+    if (dirty.empty()) return;
+
+    std::lock_guard<std::mutex> lock(stateMutex_);
+    for (EntityId id : dirty) {
+        const auto entity = static_cast<entt::entity>(id);
+        const AbsolutePrecisePosition* position = registry.valid(entity) ? registry.try_get<AbsolutePrecisePosition>(entity) : nullptr;
+        if (!position) {
+            entities_.erase(id);
+            continue;
+        }
+        const auto* name = registry.try_get<NameComponent>(entity);
+        EntityState& state = entities_[id];
+        state.position = quantizePosition(*position);
+        state.name = name ? name->name : std::string();
+    }
+}
+
+EntitySnapshot EntityTracker::snapshotOf(std::span<const entt::entity> entities, std::optional<EntityId> exclude) const {
+    EntitySnapshot snapshot;
+    std::lock_guard<std::mutex> lock(stateMutex_);
+    for (entt::entity entity : entities) {
+        const auto id = static_cast<EntityId>(entity);
+        auto it = entities_.find(id);
+        if (it != entities_.end() && id != exclude) {
+            snapshot.emplace(id, it->second);
+        }
+    }
+    return snapshot;
+}
+
+size_t EntityTracker::size() const {
+    std::lock_guard<std::mutex> lock(stateMutex_);
+    return entities_.size();
+}
+
+EntityInterest::Update EntityInterest::next(std::uint64_t acked, EntitySnapshot visible) {
+    Update update;
+    update.sequence = nextSequence_++;
+
+    const EntitySnapshot* baseline = nullptr;
+    if (acked != 0) {
+        for (const auto& [sequence, snapshot] : baselines_) {
+            if (sequence == acked) {
+                baseline = &snapshot;
+                break;
+            }
+        }
+    }
+    update.full = baseline == nullptr;
+
+    for (const auto& [id, state] : visible) {
+        const EntityState* known = nullptr;
+        if (baseline) {
+            auto it = baseline->find(id);
+            if (it != baseline->end()) known = &it->second;
+        }
+        EntityDelta delta;
+        delta.entity = id;
+        if (!known || !(known->position == state.position)) delta.position = state.position;
+        if (!known || known->name != state.name) delta.name = state.name;
+        if (delta.position || delta.name) update.deltas.push_back(std::move(delta));
+    }
+    if (baseline) {
+        for (const auto& [id, state] : *baseline) {
+            if (visible.find(id) == visible.end()) {
+                EntityDelta delta;
+                delta.entity = id;
+                delta.removed = true;
+                update.deltas.push_back(std::move(delta));
+            }
+        }
+        // Older baselines can no longer be acked once the client has moved past them
+        while (!baselines_.empty() && baselines_.front().first < acked) {
+            baselines_.pop_front();
+        }
+    }
+
+    baselines_.emplace_back(update.sequence, std::move(visible));
+    while (baselines_.size() > ENTITY_SYNC_BASELINES) {
+        baselines_.pop_front();
+    }
+    return update;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <entt/entt.hpp>
+
+#include "position.h"
+#include "registry_wrapper.h"
+
+// Entity positions are sent in fixed point with this many steps per block
+constexpr int32_t ENTITY_POSITION_STEPS_PER_BLOCK = 16;
+// Snapshots remembered per session, so an ack may lag this many responses behind
+constexpr size_t ENTITY_SYNC_BASELINES = 8;
+// View radius in chunks used when a request doesn't give one
+constexpr int32_t ENTITY_SYNC_DEFAULT_VIEW_RADIUS = 8;
+
+using EntityId = std::underlying_type_t<entt::entity>;
+
+// Position quantized to 1 / ENTITY_POSITION_STEPS_PER_BLOCK of a block
+struct QuantizedPosition {
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t z = 0;
+    bool operator==(const QuantizedPosition& other) const = default;
+};
+
+QuantizedPosition quantizePosition(const AbsolutePrecisePosition& position);
+AbsolutePrecisePosition dequantizePosition(const QuantizedPosition& position);
+
+// What a client is told about one entity
+struct EntityState {
+    QuantizedPosition position;
+    std::string name;
+};
+
+using EntitySnapshot = std::unordered_map<EntityId, EntityState>;
+
+// Change to one entity relative to a client's baseline; fields left empty are unchanged
+struct EntityDelta {
+    EntityId entity = 0;
+    bool removed = false;
+    std::optional<QuantizedPosition> position;
+    std::optional<std::string> name;
+};
+
+// Packs the changed components of a delta with VectorOutputArchive (a flags byte, then each present field)
+std::vector<std::uint8_t> encodeEntityComponents(const EntityDelta& delta);
+// Reads components written by encodeEntityComponents into delta; throws on malformed data
+void decodeEntityComponents(const std::vector<std::uint8_t>& data, EntityDelta& delta);
+
+/**
+ * @brief Client-side mirror of the entities a server has sent. Remote ids map to local entities
+ * carrying NameComponent and AbsolutePrecisePosition.
+ */
+class EntityMirror {
+public:
+    // Drops every mirrored entity, e.g. before applying a full snapshot
+    void clear();
+    void apply(const EntityDelta& delta);
+
+    GameRegistry& registry() { return registry_; }
+    const GameRegistry& registry() const { return registry_; }
+    std::optional<entt::entity> localEntity(EntityId remote) const;
+    size_t size() const { return remote_.size(); }
+
+private:
+    GameRegistry registry_;
+    std::unordered_map<EntityId, entt::entity> remote_;
+};
+
+/**
+ * @brief Server-side copy of the synced state of every entity. Which entities are in view comes
+ * from World's EntitySpatialIndex (World::entitiesInChunkBox); the tracker only keeps what is sent
+ * about each.
+ *
+ * World's entity callback only marks entities dirty; refresh() later reads just those back from the
+ * registry, so moving entities costs nothing until a client asks for updates. Safe to use from any
+ * thread; refresh() must run inside World::readEntities.
+ */
+class EntityTracker {
+public:
+    void markDirty(entt::entity entity);
+    void refresh(const entt::registry& registry);
+    bool hasDirty() const;
+
+    // Current state of the given entities, excluding one; entities not tracked (yet) are skipped
+    EntitySnapshot snapshotOf(std::span<const entt::entity> entities, std::optional<EntityId> exclude = std::nullopt) const;
+    size_t size() const;
+
+private:
+    mutable std::mutex dirtyMutex_;
+    std::unordered_set<EntityId> dirty_;
+
+    mutable std::mutex stateMutex_;
+    std::unordered_map<EntityId, EntityState> entities_;
+};
+
+/**
+ * @brief One session's entity stream: remembers the last ENTITY_SYNC_BASELINES snapshots sent and
+ * diffs the current view against whichever one the client acknowledged.
+ */
+class EntityInterest {
+public:
+    struct Update {
+        std::uint64_t sequence = 0;
+        // The client must drop everything it has before applying the deltas
+        bool full = false;
+        std::vector<EntityDelta> deltas;
+    };
+
+    // acked is the sequence of the last update the client applied, or 0 for none
+    Update next(std::uint64_t acked, EntitySnapshot visible);
+
+private:
+    std::uint64_t nextSequence_ = 1;
+    std::deque<std::pair<std::uint64_t, EntitySnapshot>> baselines_;
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Open-addressing hash containers with linear probing and backward-shift deletion.
+ *
+ * Entries live inline in one power-of-two array, so a lookup is a hash, a mask and usually a
+ * single cache line. There are no tombstones: erase shifts the following run back, so probe
+ * lengths stay short under heavy insert/erase churn such as chunk loading and unloading.
+ *
+ * Differences from the std containers:
+ * - any insertion may rehash, which invalidates all iterators, pointers and references
+ * - erase leaves only iterators before the erased slot valid; erase(iterator) returns the next
+ *   element to visit, but an entry shifted back across the array's end may be visited twice
+ * - the hash must mix its bits well, since the slot index is taken from the low bits
+ */
+namespace flat_hash_detail {
+
+template<typename Value, typename Key, typename KeyOf, typename Hash, typename Eq>
+class Table {
+public:
+    using key_type = Key;
+    using value_type = Value;
+    using size_type = size_t;
+
+    template<bool Const>
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const Value*, Value*>;
+        using reference = std::conditional_t<Const, const Value&, Value&>;
+        using SlotVector = std::conditional_t<Const, const std::vector<std::optional<Value>>, std::vector<std::optional<Value>>>;
+
+        Iterator() = default;
+        Iterator(SlotVector* slots, size_t index) : slots_(slots), index_(index) { skipEmpty(); }
+        // iterator -> const_iterator
+        template<bool OtherConst, typename = std::enable_if_t<Const && !OtherConst>>
+        Iterator(const Iterator<OtherConst>& other) : slots_(other.slots_), index_(other.index_) {}
+
+        reference operator*() const { return *(*slots_)[index_]; }
+        pointer operator->() const { return &*(*slots_)[index_]; }
+        Iterator& operator++() { ++index_; skipEmpty(); return *this; }
+        Iterator operator++(int) { Iterator old = *this; ++*this; return old; }
+        friend bool operator==(const Iterator& a, const Iterator& b) { return a.index_ == b.index_; }
+        friend bool operator!=(const Iterator& a, const Iterator& b) { return a.index_ != b.index_; }
+
+    private:
+        template<bool> friend class Iterator;
+        friend class Table;
+
+        void skipEmpty() {
+            while (slots_ && index_ < slots_->size() && !(*slots_)[index_]) ++index_;
+        }
+
+        SlotVector* slots_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    Table() = default;
+    explicit Table(size_t expected) { reserve(expected); }
+
+    iterator begin() { return iterator(&slots_, 0); }
+    iterator end() { return iterator(&slots_, slots_.size()); }
+    const_iterator begin() const { return const_iterator(&slots_, 0); }
+    const_iterator end() const { return const_iterator(&slots_, slots_.size()); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t capacity() const { return slots_.size(); }
+
+    void clear() {
+        for (auto& slot : slots_) slot.reset();
+        size_ = 0;
+    }
+
+    // Grows so that expected entries fit without another rehash
+    void reserve(size_t expected) {
+        size_t needed = MIN_CAPACITY;
+        while (needed * MAX_LOAD_NUM < expected * MAX_LOAD_DEN) needed *= 2;
+        if (needed > slots_.size()) rehash(needed);
+    }
+
+    iterator find(const Key& key) {
+        size_t index = findIndex(key);
+        return index == NPOS ? end() : iterator(&slots_, index);
+    }
+    const_iterator find(const Key& key) const {
+        size_t index = findIndex(key);
+        return index == NPOS ? end() : const_iterator(&slots_, index);
+    }
+    bool contains(const Key& key) const { return findIndex(key) != NPOS; }
+    size_t count(const Key& key) const { return contains(key) ? 1 : 0; }
+
+    size_t erase(const Key& key) {
+        size_t index = findIndex(key);
+        if (index == NPOS) return 0;
+        eraseIndex(index);
+        return 1;
+    }
+
+    iterator erase(const_iterator pos) {
+        size_t index = pos.index_;
+        eraseIndex(index);
+        // An entry from further along the run may have moved into this slot
+        return iterator(&slots_, index);
+    }
+    iterator erase(iterator pos) { return erase(const_iterator(pos)); }
+
+protected:
+    static constexpr size_t NPOS = static_cast<size_t>(-1);
+    static constexpr size_t MIN_CAPACITY = 16;
+    // Maximum load factor of 3/4 keeps linear probe runs short
+    static constexpr size_t MAX_LOAD_NUM = 3;
+    static constexpr size_t MAX_LOAD_DEN = 4;
+
+    size_t homeIndex(const Key& key) const { return hash_(key) & (slots_.size() - 1); }
+
+    size_t findIndex(const Key& key) const {
+        if (size_ == 0) return NPOS;
+        const size_t mask = slots_.size() - 1;
+        for (size_t index = homeIndex(key);; index = (index + 1) & mask) {
+            const auto& slot = slots_[index];
+            if (!slot) return NPOS;
+            if (eq_(KeyOf{}(*slot), key)) return index;
+        }
+    }
+
+    // Returns the slot holding key, constructing a value there with make() if absent
+    template<typename Make>
+    std::pair<iterator, bool> findOrInsert(const Key& key, Make&& make) {
+        size_t existing = findIndex(key);
+        if (existing != NPOS) return {iterator(&slots_, existing), false};
+        if ((size_ + 1) * MAX_LOAD_DEN > slots_.size() * MAX_LOAD_NUM) {
+            rehash(slots_.empty() ? MIN_CAPACITY : slots_.size() * 2);
+        }
+        const size_t mask = slots_.size() - 1;
+        size_t index = homeIndex(key);
+        while (slots_[index]) index = (index + 1) & mask;
+        make(slots_[index]);
+        ++size_;
+        return {iterator(&slots_, index), true};
+    }
+
+    void eraseIndex(size_t hole) {
+        const size_t mask = slots_.size() - 1;
+        slots_[hole].reset();
+        --size_;
+        // Backward-shift: pull later entries of the run into the hole if that moves them closer to home
+        for (size_t next = (hole + 1) & mask; slots_[next]; next = (next + 1) & mask) {
+            const size_t home = homeIndex(KeyOf{}(*slots_[next]));
+            // Entry may move only if its home is not in the cyclic range (hole, next]
+            const bool homeBetween = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+            if (!homeBetween) {
+                slots_[hole] = std::move(slots_[next]);
+                slots_[next].reset();
+                hole = next;
+            }
+        }
+    }
+
+    void rehash(size_t newCapacity) {
+        std::vector<std::optional<Value>> old(newCapacity);
+        old.swap(slots_);
+        const size_t mask = slots_.size() - 1;
+        for (auto& slot : old) {
+            if (!slot) continue;
+            size_t index = homeIndex(KeyOf{}(*slot));
+            while (slots_[index]) index = (index + 1) & mask;
+            slots_[index] = std::move(slot);
+        }
+    }
+
+    std::vector<std::optional<Value>> slots_;
+    size_t size_ = 0;
+    [[no_unique_address]] Hash hash_;
+    [[no_unique_address]] Eq eq_;
+};
+
+struct PairFirst {
+    template<typename P>
+    const auto& operator()(const P& p) const { return p.first; }
+};
+
+struct Identity {
+    template<typename T>
+    const T& operator()(const T& t) const { return t; }
+};
+
+} // namespace flat_hash_detail
+
+/**
+ * @brief Open-addressing hash map; see flat_hash_detail::Table for the invalidation rules.
+ * Entries are std::pair<Key, Value>; don't modify the key through an iterator.
+ */
+template<typename Key, typename Value, typename Hash = std::hash<Key>, typename Eq = std::equal_to<Key>>
+class FlatHashMap : public flat_hash_detail::Table<std::pair<Key, Value>, Key, flat_hash_detail::PairFirst, Hash, Eq> {
+    using Base = flat_hash_detail::Table<std::pair<Key, Value>, Key, flat_hash_detail::PairFirst, Hash, Eq>;
+
+public:
+    using mapped_type = Value;
+    using typename Base::iterator;
+    using Base::Base;
+
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args) {
+        return this->findOrInsert(key, [&](auto& slot) {
+            slot.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+        });
+    }
+
+    template<typename V>
+    std::pair<iterator, bool> emplace(const Key& key, V&& value) {
+        return try_emplace(key, std::forward<V>(value));
+    }
+
+    std::pair<iterator, bool> insert(std::pair<Key, Value> entry) {
+        return try_emplace(entry.first, std::move(entry.second));
+    }
+
+    template<typename V>
+    std::pair<iterator, bool> insert_or_assign(const Key& key, V&& value) {
+        auto result = try_emplace(key, std::forward<V>(value));
+        if (!result.second) result.first->second = std::forward<V>(value);
+        return result;
+    }
+
+    Value& operator[](const Key& key) { return try_emplace(key).first->second; }
+
+    Value& at(const Key& key) {
+        auto it = this->find(key);
+        if (it == this->end()) throw std::out_of_range("FlatHashMap::at");
+        return it->second;
+    }
+    const Value& at(const Key& key) const {
+        auto it = this->find(key);
+        if (it == this->end()) throw std::out_of_range("FlatHashMap::at");
+        return it->second;
+    }
+};
+
+/**
+ * @brief Open-addressing hash set; see flat_hash_detail::Table for the invalidation rules.
+ */
+template<typename Key, typename Hash = std::hash<Key>, typename Eq = std::equal_to<Key>>
+class FlatHashSet : public flat_hash_detail::Table<Key, Key, flat_hash_detail::Identity, Hash, Eq> {
+    using Base = flat_hash_detail::Table<Key, Key, flat_hash_detail::Identity, Hash, Eq>;
+
+public:
+    using typename Base::iterator;
+    using Base::Base;
+
+    std::pair<iterator, bool> insert(const Key& key) {
+        return this->findOrInsert(key, [&](auto& slot) { slot.emplace(key); });
+    }
+    std::pair<iterator, bool> emplace(const Key& key) { return insert(key); }
+};
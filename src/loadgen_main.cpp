@@ -0,0 +1,416 @@
+// blocktest_loadgen: simulates many players against a running server, without a window.
+// Usage: blocktest_loadgen [options], see printUsage below
+//
+// Each simulated player is a Client on its own thread: it connects as a player, walks in straight
+// lines across the spawn area, streams the chunks around it (requests plus a chunk subscription, which
+// delivers what the server had to load first) and places and breaks blocks at a set rate. Connects are spread over the ramp time. At the end it prints throughput and latency
+// percentiles per operation; chunk latency runs from the request to the chunk being decoded.
+#include "client.h"
+#include "chunkdims.h"
+#include "chunk_request_scheduler.h"
+#include "log.h"
+#include "world.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <numbers>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Feet just above the one-block flat world the server generates by default
+constexpr double SPAWN_HEIGHT = 2.0;
+// How often a player with nothing due still collects arrived chunks
+constexpr auto POLL_INTERVAL = std::chrono::milliseconds(5);
+// A requested chunk missing for this long counts as a failed request
+constexpr auto CHUNK_TIMEOUT = std::chrono::seconds(10);
+// Chance per move of picking a new heading
+constexpr double TURN_CHANCE = 0.02;
+// Further out the client cancels its own requests and the server won't load misses on demand
+constexpr int32_t MAX_VIEW_RADIUS = std::min(CHUNK_REQUEST_CANCEL_DISTANCE, DEMAND_LOAD_RADIUS);
+
+struct LoadOptions {
+    std::string host = "127.0.0.1";
+    uint16_t port = 50000;
+    size_t players = 16;
+    double durationSeconds = 30.0;
+    double rampSeconds = 5.0;
+    // Position updates per second per player
+    double moveRate = 10.0;
+    // Blocks per second
+    double speed = 4.3;
+    // Chunks in each direction streamed around each player
+    int32_t viewRadius = 2;
+    // Block edits (a place or a break) per second per player
+    double editRate = 1.0;
+    // Players spawn and walk within a square this many blocks wide around the origin
+    double area = 512.0;
+    uint64_t seed = 1;
+    bool serverStats = false;
+    bool verbose = false;
+};
+
+enum Operation { Connect, Move, Chunk, Edit, OPERATION_COUNT };
+constexpr const char* OPERATION_NAMES[OPERATION_COUNT] = {"connect", "move", "chunk", "edit"};
+
+struct OperationStats {
+    std::vector<double> latenciesUs;
+    uint64_t failures = 0;
+};
+
+struct LoadResults {
+    OperationStats operations[OPERATION_COUNT];
+
+    void merge(LoadResults& other) {
+        for (int i = 0; i < OPERATION_COUNT; ++i) {
+            auto& samples = operations[i].latenciesUs;
+            samples.insert(samples.end(), other.operations[i].latenciesUs.begin(), other.operations[i].latenciesUs.end());
+            operations[i].failures += other.operations[i].failures;
+        }
+    }
+};
+
+double microsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// Times one blocking call, recording its latency when it succeeds and a failure when it doesn't
+template<typename F>
+bool timed(OperationStats& stats, F&& call) {
+    const auto started = Clock::now();
+    if (!call()) {
+        ++stats.failures;
+        return false;
+    }
+    stats.latenciesUs.push_back(microsSince(started));
+    return true;
+}
+
+// Expects samples sorted
+double percentile(const std::vector<double>& samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()))];
+}
+
+/**
+ * @brief One simulated player: keeps the chunk cube around it requested and notes when each
+ * chunk arrives. Requests the client drops because the player walked away are forgotten.
+ */
+class SimulatedPlayer {
+public:
+    SimulatedPlayer(const LoadOptions& options, size_t index, LoadResults& results)
+        : options_(options), index_(index), results_(results), random_(options.seed * 1000003 + index),
+          client_(options.host, options.port, "loadgen-" + std::to_string(index)) {}
+
+    void run(Clock::time_point start, Clock::time_point stop) {
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(options_.rampSeconds * index_ / std::max<size_t>(options_.players, 1))));
+        if (!client_.connect()) {
+            ++results_.operations[Connect].failures;
+            return;
+        }
+
+        std::uniform_real_distribution<double> spread(-options_.area / 2, options_.area / 2);
+        position_ = AbsolutePrecisePosition(spread(random_), SPAWN_HEIGHT, spread(random_));
+        turn();
+        if (!timed(results_.operations[Connect], [&] { return client_.connectAsPlayer("loadgen-" + std::to_string(index_), position_); })) {
+            client_.disconnect();
+            return;
+        }
+        client_.setPlayerPosition(toAbsoluteBlock(position_));
+        // Chunks answered pending arrive through the subscription once loaded
+        if (!client_.subscribeChunks(options_.viewRadius)) {
+            ++results_.operations[Connect].failures;
+            client_.disconnectPlayer();
+            client_.disconnect();
+            return;
+        }
+        streamAround(toAbsoluteChunk(position_));
+
+        const auto movePeriod = period(options_.moveRate);
+        auto nextMove = options_.moveRate > 0 ? Clock::now() + movePeriod : Clock::time_point::max();
+        auto nextEdit = options_.editRate > 0 ? Clock::now() + editInterval() : Clock::time_point::max();
+        for (auto now = Clock::now(); now < stop; now = Clock::now()) {
+            if (now >= nextMove) {
+                move(std::chrono::duration<double>(movePeriod).count());
+                nextMove += movePeriod;
+            }
+            if (now >= nextEdit) {
+                edit();
+                nextEdit += editInterval();
+            }
+            collectChunks();
+            std::this_thread::sleep_until(std::min({nextMove, nextEdit, Clock::now() + POLL_INTERVAL}));
+        }
+
+        client_.unsubscribeChunks();
+        client_.disconnectPlayer();
+        client_.disconnect();
+    }
+
+private:
+    static Clock::duration period(double rate) {
+        return rate > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate)) : Clock::duration::max();
+    }
+
+    // Poisson-spaced, so edits from many players don't arrive in lockstep
+    Clock::duration editInterval() {
+        std::exponential_distribution<double> interval(options_.editRate);
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval(random_)));
+    }
+
+    void turn() {
+        std::uniform_real_distribution<double> angle(0.0, 2.0 * std::numbers::pi);
+        heading_ = angle(random_);
+        client_.setViewDirection(std::cos(heading_), 0.0, std::sin(heading_));
+    }
+
+    void move(double seconds) {
+        const double half = options_.area / 2;
+        double x = position_.x + std::cos(heading_) * options_.speed * seconds;
+        double z = position_.z + std::sin(heading_) * options_.speed * seconds;
+        std::bernoulli_distribution turning(TURN_CHANCE);
+        if (x < -half || x > half || z < -half || z > half || turning(random_)) {
+            x = std::clamp(x, -half, half);
+            z = std::clamp(z, -half, half);
+            turn();
+        }
+        const AbsoluteChunkPosition before = toAbsoluteChunk(position_);
+        position_ = AbsolutePrecisePosition(x, position_.y, z);
+        timed(results_.operations[Move], [&] { return client_.updatePlayerPosition(position_); });
+        const AbsoluteChunkPosition after = toAbsoluteChunk(position_);
+        if (!ChunkPosEq{}(before, after)) {
+            streamAround(after);
+        }
+    }
+
+    // Places a block next to the player, then breaks it on the next edit
+    void edit() {
+        auto& stats = results_.operations[Edit];
+        if (placed_) {
+            timed(stats, [&] { return client_.breakBlock(*placed_); });
+            placed_.reset();
+            return;
+        }
+        std::uniform_int_distribution<int32_t> offset(-3, 3);
+        const AbsoluteBlockPosition feet = toAbsoluteBlock(position_);
+        const AbsoluteBlockPosition target(feet.x + offset(random_), feet.y, feet.z + offset(random_));
+        if (timed(stats, [&] { return client_.placeBlock(target, Block::Stone); })) {
+            placed_ = target;
+        }
+    }
+
+    void streamAround(const AbsoluteChunkPosition& center) {
+        const int32_t r = options_.viewRadius;
+        // Forget requests the client dropped for being out of range
+        forgetOutstandingIf([&](const AbsoluteChunkPosition& pos, Clock::time_point) {
+            return std::abs(pos.x - center.x) > r || std::abs(pos.y - center.y) > r || std::abs(pos.z - center.z) > r;
+        });
+        std::vector<AbsoluteChunkPosition> wanted;
+        const auto now = Clock::now();
+        for (int32_t y = center.y - r; y <= center.y + r; ++y) {
+            for (int32_t z = center.z - r; z <= center.z + r; ++z) {
+                for (int32_t x = center.x - r; x <= center.x + r; ++x) {
+                    const AbsoluteChunkPosition pos(x, y, z);
+                    if (!outstanding_.contains(pos) && !client_.getCachedChunk(pos)) {
+                        outstanding_.emplace(pos, now);
+                        wanted.push_back(pos);
+                    }
+                }
+            }
+        }
+        client_.requestChunksAsync(wanted);
+    }
+
+    void collectChunks() {
+        auto& stats = results_.operations[Chunk];
+        auto arrived = [&](const AbsoluteChunkPosition& pos) {
+            auto it = outstanding_.find(pos);
+            if (it != outstanding_.end()) {
+                stats.latenciesUs.push_back(microsSince(it->second));
+                outstanding_.erase(it);
+            }
+        };
+        for (const AbsoluteChunkPosition& pos : client_.processPendingRequests()) {
+            arrived(pos);
+        }
+        for (const AbsoluteChunkPosition& pos : client_.takeStreamedChunkUpdates()) {
+            arrived(pos);
+        }
+        const auto expired = Clock::now() - CHUNK_TIMEOUT;
+        stats.failures += forgetOutstandingIf([&](const AbsoluteChunkPosition&, Clock::time_point requested) { return requested < expired; });
+    }
+
+    // Entries shifted back across the map's end may be tested twice, which these predicates allow
+    template<typename F>
+    size_t forgetOutstandingIf(F&& predicate) {
+        size_t forgotten = 0;
+        for (auto it = outstanding_.begin(); it != outstanding_.end();) {
+            if (predicate(it->first, it->second)) {
+                it = outstanding_.erase(it);
+                ++forgotten;
+            } else {
+                ++it;
+            }
+        }
+        return forgotten;
+    }
+
+    const LoadOptions& options_;
+    const size_t index_;
+    LoadResults& results_;
+    std::mt19937_64 random_;
+    Client client_;
+    AbsolutePrecisePosition position_;
+    double heading_ = 0.0;
+    std::optional<AbsoluteBlockPosition> placed_;
+    // Requested chunks not yet arrived, and when they were requested
+    ChunkPosMap<Clock::time_point> outstanding_;
+};
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --host HOST          server address (127.0.0.1)\n"
+              << "  --port PORT          server port (50000)\n"
+              << "  --players N          simulated players (16)\n"
+              << "  --duration SECONDS   how long to run (30)\n"
+              << "  --ramp SECONDS       spread player connects over this long (5)\n"
+              << "  --move-rate HZ       position updates per player per second (10)\n"
+              << "  --speed BLOCKS       walking speed in blocks per second (4.3)\n"
+              << "  --view-radius N      chunks streamed in each direction, at most " << MAX_VIEW_RADIUS << " (2)\n"
+              << "  --edit-rate HZ       block edits per player per second (1)\n"
+              << "  --area BLOCKS        width of the square players walk in (512)\n"
+              << "  --seed N             random seed (1)\n"
+              << "  --server-stats       print the server's metrics at the end\n"
+              << "  --verbose            keep client logging\n";
+}
+
+bool parseNumber(const char* text, double& out) {
+    char* end = nullptr;
+    out = std::strtod(text, &end);
+    return end != text && *end == '\0' && out >= 0;
+}
+
+std::optional<LoadOptions> parseOptions(int argc, char** argv) {
+    LoadOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string flag = argv[i];
+        if (flag == "--server-stats") {
+            options.serverStats = true;
+            continue;
+        }
+        if (flag == "--verbose") {
+            options.verbose = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return std::nullopt;
+        }
+        const char* value = argv[++i];
+        if (flag == "--host") {
+            options.host = value;
+            continue;
+        }
+        double number = 0;
+        if (!parseNumber(value, number)) {
+            return std::nullopt;
+        }
+        if (flag == "--port" && number <= 65535) {
+            options.port = static_cast<uint16_t>(number);
+        } else if (flag == "--players") {
+            options.players = static_cast<size_t>(number);
+        } else if (flag == "--duration") {
+            options.durationSeconds = number;
+        } else if (flag == "--ramp") {
+            options.rampSeconds = number;
+        } else if (flag == "--move-rate") {
+            options.moveRate = number;
+        } else if (flag == "--speed") {
+            options.speed = number;
+        } else if (flag == "--view-radius" && number <= MAX_VIEW_RADIUS) {
+            options.viewRadius = static_cast<int32_t>(number);
+        } else if (flag == "--edit-rate") {
+            options.editRate = number;
+        } else if (flag == "--area" && number > 0) {
+            options.area = number;
+        } else if (flag == "--seed") {
+            options.seed = static_cast<uint64_t>(number);
+        } else {
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+void printReport(LoadResults& results, double seconds) {
+    std::printf("%-8s %10s %9s %10s %10s %10s %10s\n", "op", "count", "failed", "ops/s", "p50 ms", "p99 ms", "p999 ms");
+    for (int i = 0; i < OPERATION_COUNT; ++i) {
+        auto& stats = results.operations[i];
+        std::sort(stats.latenciesUs.begin(), stats.latenciesUs.end());
+        std::printf("%-8s %10zu %9llu %10.1f %10.3f %10.3f %10.3f\n", OPERATION_NAMES[i], stats.latenciesUs.size(),
+                    static_cast<unsigned long long>(stats.failures), stats.latenciesUs.size() / seconds,
+                    percentile(stats.latenciesUs, 0.50) / 1000, percentile(stats.latenciesUs, 0.99) / 1000,
+                    percentile(stats.latenciesUs, 0.999) / 1000);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    auto options = parseOptions(argc, argv);
+    if (!options) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    // Hundreds of clients logging every failure would drown the report, which counts them anyway
+    if (!options->verbose) {
+        setLogLevel(LogLevel::Off);
+    }
+
+    std::cout << "Simulating " << options->players << " players against " << options->host << ":" << options->port
+              << " for " << options->durationSeconds << "s" << std::endl;
+
+    LoadResults total;
+    std::mutex totalMutex;
+    const auto start = Clock::now();
+    const auto stop = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options->durationSeconds));
+    std::vector<std::thread> threads;
+    threads.reserve(options->players);
+    for (size_t i = 0; i < options->players; ++i) {
+        threads.emplace_back([&, i] {
+            LoadResults results;
+            SimulatedPlayer(*options, i, results).run(start, stop);
+            std::lock_guard<std::mutex> lock(totalMutex);
+            total.merge(results);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    printReport(total, std::chrono::duration<double>(Clock::now() - start).count());
+
+    if (options->serverStats) {
+        Client client(options->host, options->port, "loadgen-stats");
+        auto stats = client.connect() ? client.getServerStats(true) : std::nullopt;
+        if (!stats) {
+            std::cerr << "Failed to fetch server stats" << std::endl;
+            return 1;
+        }
+        std::cout << stats->prometheus_text();
+    }
+    return 0;
+}
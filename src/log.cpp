@@ -0,0 +1,32 @@
+#include "log.h"
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+std::atomic<int> runtimeLevel{static_cast<int>(LogLevel::Info)};
+
+} // namespace
+
+void setLogLevel(LogLevel level) {
+    runtimeLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel logLevel() {
+    return static_cast<LogLevel>(runtimeLevel.load(std::memory_order_relaxed));
+}
+
+bool logEnabled(LogLevel level) {
+    return level != LogLevel::Off && static_cast<int>(level) >= runtimeLevel.load(std::memory_order_relaxed);
+}
+
+void logWrite(LogLevel level, std::string_view line) {
+    std::string buffer;
+    buffer.reserve(line.size() + 1);
+    buffer.append(line);
+    buffer.push_back('\n');
+    // stdio locks the stream for the one call, so concurrent lines never interleave
+    std::fwrite(buffer.data(), 1, buffer.size(), level >= LogLevel::Warn ? stderr : stdout);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <sstream>
+#include <string_view>
+
+enum class LogLevel : int {
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warn = 3,
+    Error = 4,
+    Off = 5
+};
+
+// Statements below this level compile to nothing; the build sets it with -DBLOCKTEST_LOG_MIN_LEVEL
+#ifndef BLOCKTEST_LOG_MIN_LEVEL
+#define BLOCKTEST_LOG_MIN_LEVEL 1
+#endif
+
+// Least level written at runtime; Info until changed
+void setLogLevel(LogLevel level);
+LogLevel logLevel();
+bool logEnabled(LogLevel level);
+// Writes one line with a single write: Trace..Info to stdout, Warn and Error to stderr. Neither is
+// flushed per line, so hot paths don't serialize on the stream.
+void logWrite(LogLevel level, std::string_view line);
+
+/**
+ * @brief Logs a streamed message, e.g. BLOCKTEST_LOG(Debug, "GetChunk (" << x << ")").
+ * The message is only formatted when the level is enabled, and levels under
+ * BLOCKTEST_LOG_MIN_LEVEL are compiled out entirely.
+ */
+#define BLOCKTEST_LOG(level, message)                                                                  \
+    do {                                                                                               \
+        if constexpr (static_cast<int>(LogLevel::level) >= BLOCKTEST_LOG_MIN_LEVEL) {                  \
+            if (logEnabled(LogLevel::level)) {                                                         \
+                std::ostringstream blocktestLogLine_;                                                  \
+                blocktestLogLine_ << message;                                                          \
+                logWrite(LogLevel::level, blocktestLogLine_.view());                                   \
+            }                                                                                          \
+        }                                                                                              \
+    } while (0)
+
+#define LOG_TRACE(message) BLOCKTEST_LOG(Trace, message)
+#define LOG_DEBUG(message) BLOCKTEST_LOG(Debug, message)
+#define LOG_INFO(message) BLOCKTEST_LOG(Info, message)
+#define LOG_WARN(message) BLOCKTEST_LOG(Warn, message)
+#define LOG_ERROR(message) BLOCKTEST_LOG(Error, message)
@@ -2,10 +2,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <memory>
+#include <string>
 #include <vector>
 #include <cstdio>
 #include <thread>
 #include <chrono>
+#include <unordered_map>
+#include <array>
 #include "gl_includes.h"
 #include "block.h"
 #include "chunktransform.h"
@@ -14,7 +17,13 @@
 #include "shader.h"
 #include "camera.h"
 #include "block_renderer.h"
+#include "chunk_culling.h"
 #include "chunk_mesh.h"
+#include "chunk_mesh_cache.h"
+#include "chunk_mesher.h"
+#include "chunk_arena.h"
+#include "chunk_geometry_arena.h"
+#include "chunk_lod.h"
 #include "world.h"
 #include "chunk_generators.h"
 #include "client.h"
@@ -30,6 +39,67 @@ float lastX = WINDOW_WIDTH / 2.0f;
 float lastY = WINDOW_HEIGHT / 2.0f;
 bool firstMouse = true;
 
+// Render-thread time per frame spent uploading meshes the mesher finished
+const auto MESH_UPLOAD_BUDGET = std::chrono::milliseconds(4);
+// Chunks further than this from the camera's chunk on any axis are never loaded or meshed
+const int32_t CHUNK_LOAD_DISTANCE = 3;
+// Frames between revalidating the drawn LOD chunks with the server, which resends changed ones
+const int LOD_REVALIDATE_FRAMES = 120;
+// Far plane distance, just past the coarsest ring
+const float VIEW_DISTANCE = static_cast<float>((CHUNK_LOD_RING_RADIUS + 1) * (1 << CHUNK_LOD_LEVELS) * CHUNK_WIDTH);
+// Load the atlas as a mipmapped texture array, one layer per tile, rather than one 2D texture.
+// Mipmaps then never blend neighbouring tiles, so distant terrain neither shimmers nor bleeds.
+const bool ATLAS_TEXTURE_ARRAY = true;
+// Written at shutdown and restored at startup, so the world comes back without regenerating it
+const char* WORLD_CHECKPOINT_PATH = "blocktest_world.checkpoint";
+
+// Chunks loaded and meshed at full detail around the camera's chunk
+AbsoluteChunkPosition loadBoxMin(const AbsoluteChunkPosition& cameraChunk) {
+    return AbsoluteChunkPosition(cameraChunk.x - CHUNK_LOAD_DISTANCE, cameraChunk.y - 1, cameraChunk.z - CHUNK_LOAD_DISTANCE);
+}
+AbsoluteChunkPosition loadBoxMax(const AbsoluteChunkPosition& cameraChunk) {
+    return AbsoluteChunkPosition(cameraChunk.x + CHUNK_LOAD_DISTANCE, cameraChunk.y + 2, cameraChunk.z + CHUNK_LOAD_DISTANCE);
+}
+
+// The chunks covered by the ring finer than level (the loaded chunks for level 1), where it leaves a hole
+std::pair<AbsoluteChunkPosition, AbsoluteChunkPosition> lodRingHole(const AbsoluteChunkPosition& cameraChunk, uint32_t level) {
+    if (level == 1) {
+        return {loadBoxMin(cameraChunk), loadBoxMax(cameraChunk)};
+    }
+    const AbsoluteChunkPosition center = lodPosition(cameraChunk, level - 1);
+    return {lodFirstChunk(AbsoluteChunkPosition(center.x - CHUNK_LOD_RING_RADIUS, center.y - 1, center.z - CHUNK_LOD_RING_RADIUS), level - 1),
+            lodLastChunk(AbsoluteChunkPosition(center.x + CHUNK_LOD_RING_RADIUS, center.y + 1, center.z + CHUNK_LOD_RING_RADIUS), level - 1)};
+}
+
+bool chunkBoxesOverlap(const AbsoluteChunkPosition& aMin, const AbsoluteChunkPosition& aMax,
+                       const AbsoluteChunkPosition& bMin, const AbsoluteChunkPosition& bMax) {
+    return aMin.x <= bMax.x && bMin.x <= aMax.x && aMin.y <= bMax.y && bMin.y <= aMax.y && aMin.z <= bMax.z && bMin.z <= aMax.z;
+}
+
+bool chunkBoxContains(const AbsoluteChunkPosition& outerMin, const AbsoluteChunkPosition& outerMax,
+                      const AbsoluteChunkPosition& innerMin, const AbsoluteChunkPosition& innerMax) {
+    return outerMin.x <= innerMin.x && innerMax.x <= outerMax.x && outerMin.y <= innerMin.y && innerMax.y <= outerMax.y &&
+           outerMin.z <= innerMin.z && innerMax.z <= outerMax.z;
+}
+
+// The level's LOD chunks that make up its ring: not wholly inside the finer ring's hole
+std::vector<AbsoluteChunkPosition> lodRing(const AbsoluteChunkPosition& cameraChunk, uint32_t level) {
+    const AbsoluteChunkPosition center = lodPosition(cameraChunk, level);
+    const auto [holeMin, holeMax] = lodRingHole(cameraChunk, level);
+    std::vector<AbsoluteChunkPosition> ring;
+    for (int32_t x = -CHUNK_LOD_RING_RADIUS; x <= CHUNK_LOD_RING_RADIUS; ++x) {
+        for (int32_t y = -1; y <= 1; ++y) {
+            for (int32_t z = -CHUNK_LOD_RING_RADIUS; z <= CHUNK_LOD_RING_RADIUS; ++z) {
+                AbsoluteChunkPosition pos(center.x + x, center.y + y, center.z + z);
+                if (!chunkBoxContains(holeMin, holeMax, lodFirstChunk(pos, level), lodLastChunk(pos, level))) {
+                    ring.push_back(pos);
+                }
+            }
+        }
+    }
+    return ring;
+}
+
 // Timing
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
@@ -56,18 +126,42 @@ void scroll_callback([[maybe_unused]]GLFWwindow* window, [[maybe_unused]] double
     camera.processMouseScroll(yoffset);
 }
 
+// Camera and light for the frame, shared by every chunk shader through one uniform buffer.
+// FrameUniforms mirrors its std140 layout: vec3s are padded to 16 bytes.
+const char* frameUniformsSource = R"(
+layout (std140) uniform FrameUniforms {
+    mat4 view;
+    mat4 projection;
+    vec3 lightPos;
+    vec3 viewPos;
+};
+)";
+
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 lightPos;
+    glm::vec4 viewPos;
+};
+static_assert(sizeof(FrameUniforms) == 160, "FrameUniforms must match the std140 block");
+constexpr GLuint FRAME_UNIFORMS_BINDING = 0;
+
+// Puts the version and the frame uniform block ahead of a shader's own source
+std::string shaderSource(const char* defines, const char* source) {
+    return std::string("#version 330 core\n") + defines + frameUniformsSource + source;
+}
+
 // Vertex shader source
 const char* vertexShaderSource = R"(
-#version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
 layout (location = 2) in vec3 aNormal;
+layout (location = 3) in vec2 aTile;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 out vec2 TexCoord;
+out vec2 Tile;
 out vec3 Normal;
 out vec3 FragPos;
 
@@ -75,6 +169,51 @@ void main() {
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = mat3(transpose(inverse(model))) * aNormal;
     TexCoord = aTexCoord;
+    Tile = aTile;
+    
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
+)";
+
+// Vertex shader for chunk meshes in VertexFormat::Packed; shares the fragment shader.
+// With CHUNK_ARENA defined it draws a ChunkGeometryArena, reading each chunk's origin by the
+// id in the tile word's upper bits; otherwise one ChunkMesh at a time with a chunkOrigin uniform.
+const char* packedVertexShaderSource = R"(
+layout (location = 0) in uint aCorner;
+layout (location = 1) in uint aTile;
+
+uniform mat4 model;
+#ifdef CHUNK_ARENA
+uniform samplerBuffer chunkOrigins;
+#else
+uniform vec3 chunkOrigin;
+#endif
+uniform float tileSize;
+uniform int tilesPerRow;
+
+out vec2 TexCoord;
+out vec2 Tile;
+out vec3 Normal;
+out vec3 FragPos;
+
+// Same order as ChunkNeighbours: front, back, left, right, top, bottom
+const vec3 faceNormals[6] = vec3[6](
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0), vec3(-1.0, 0.0, 0.0),
+    vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0));
+
+void main() {
+#ifdef CHUNK_ARENA
+    vec3 chunkOrigin = texelFetch(chunkOrigins, int(aTile >> 10u)).xyz;
+    int tile = int(aTile & 1023u);
+#else
+    int tile = int(aTile);
+#endif
+    // Corners are counted from the chunk's low corner; block centres sit half a block further in
+    vec3 corner = vec3(aCorner & 31u, (aCorner >> 5u) & 31u, (aCorner >> 10u) & 31u);
+    FragPos = vec3(model * vec4(chunkOrigin + corner - vec3(0.5), 1.0));
+    Normal = mat3(transpose(inverse(model))) * faceNormals[(aCorner >> 15u) & 7u];
+    TexCoord = vec2((aCorner >> 18u) & 31u, (aCorner >> 23u) & 31u);
+    Tile = vec2(tile % tilesPerRow, tile / tilesPerRow) * tileSize;
     
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
@@ -82,19 +221,30 @@ void main() {
 
 // Fragment shader source
 const char* fragmentShaderSource = R"(
-#version 330 core
 out vec4 FragColor;
 
 in vec2 TexCoord;
+in vec2 Tile;
 in vec3 Normal;
 in vec3 FragPos;
 
+#ifdef ATLAS_ARRAY
+uniform sampler2DArray atlas;
+uniform int tilesPerRow;
+#else
 uniform sampler2D atlas;
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+#endif
+uniform float tileSize;
 
 void main() {
-    vec4 texColor = texture(atlas, TexCoord);
+#ifdef ATLAS_ARRAY
+    // Each tile is its own layer, which wraps by itself across merged faces
+    ivec2 cell = ivec2(round(Tile / tileSize));
+    vec4 texColor = texture(atlas, vec3(TexCoord, float(cell.y * tilesPerRow + cell.x)));
+#else
+    // Repeat the block's texture across faces merged by the greedy mesher
+    vec4 texColor = texture(atlas, Tile + fract(TexCoord) * tileSize);
+#endif
     if(texColor.a < 0.1)
         discard;
     
@@ -168,7 +318,9 @@ int main(void) {
 
     // --- Texture loading ---
     printf("Loading texture atlas...\n");
-    GLuint atlasTexture = loadTexture("/workspaces/blocktest/assets/atlas.png");
+    const char* atlasPath = "/workspaces/blocktest/assets/atlas.png";
+    const GLenum atlasTarget = ATLAS_TEXTURE_ARRAY ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+    GLuint atlasTexture = ATLAS_TEXTURE_ARRAY ? loadTextureArray(atlasPath, static_cast<int>(BLOCK_TEXTURE_SIZE)) : loadTexture(atlasPath);
     if (atlasTexture == 0) {
         printf("Failed to load atlas texture\n");
         glfwDestroyWindow(window);
@@ -179,7 +331,22 @@ int main(void) {
     }
 
     // --- Initialize rendering ---
-    Shader blockShader(vertexShaderSource, fragmentShaderSource);
+    const char* fragmentDefines = ATLAS_TEXTURE_ARRAY ? "#define ATLAS_ARRAY\n" : "";
+    Shader blockShader(shaderSource("", vertexShaderSource), shaderSource(fragmentDefines, fragmentShaderSource));
+    Shader arenaChunkShader(shaderSource("#define CHUNK_ARENA\n", packedVertexShaderSource), shaderSource(fragmentDefines, fragmentShaderSource));
+    // Uniforms that never change are set once here; the camera and light go in frameUniforms each frame
+    UniformBuffer frameUniforms(FRAME_UNIFORMS_BINDING, sizeof(FrameUniforms));
+    for (Shader* shader : {&blockShader, &arenaChunkShader}) {
+        shader->bindUniformBlock("FrameUniforms", FRAME_UNIFORMS_BINDING);
+        shader->use();
+        shader->setInt("atlas", 0);
+        shader->setFloat("tileSize", BlockRenderer::getTileSize());
+        shader->setMat4("model", glm::mat4(1.0f));
+        shader->setInt("tilesPerRow", static_cast<int>(BLOCKS_PER_ROW));
+    }
+    arenaChunkShader.setInt("chunkOrigins", 1);
+    // Packed chunk meshes all live here and are drawn in one call; Full ones stay separate ChunkMeshes
+    auto chunkArena = std::make_unique<ChunkGeometryArena>();
     BlockRenderer blockRenderer;
     blockRenderer.initialize();
     
@@ -196,8 +363,12 @@ int main(void) {
     
     // Create world with terrain generator, load radius, and seed
     auto world = std::make_shared<World>(terrainGenerator, loadAnchorsCallback, 3, 42);  // Load 3 chunks in each direction
+    world->setGenerationThreads(std::thread::hardware_concurrency());
     
-    // Generate chunks around the load anchors
+    // Pick up where the last run stopped, then load whatever the anchors still need
+    if (world->restoreCheckpoint(WORLD_CHECKPOINT_PATH)) {
+        printf("Restored world checkpoint %s\n", WORLD_CHECKPOINT_PATH);
+    }
     world->ensureChunksLoaded();
     printf("World chunks loaded.\n"); 
     uint16_t port = 50000;
@@ -239,8 +410,8 @@ int main(void) {
     fflush(stdout);
     
     // Create chunk meshes for rendering
-    std::vector<std::unique_ptr<ChunkMesh>> chunkMeshes;
-    std::vector<glm::vec3> chunkPositions;
+    std::unordered_map<AbsoluteChunkPosition, std::unique_ptr<ChunkMesh>, ChunkPosHash, ChunkPosEq> chunkMeshes;
+    ChunkMesher mesher;
     
     // Build meshes for the loaded chunks using client
     printf("Loading initial chunks from server...\n");
@@ -250,21 +421,25 @@ int main(void) {
     printf("Initial camera position: (%.1f, %.1f, %.1f)\n", camera.position.x, camera.position.y, camera.position.z);
     printf("Initial chunk position: (%d, %d, %d)\n", initialChunk.x, initialChunk.y, initialChunk.z);
     fflush(stdout);
+    // Sent with chunk requests; LOD chunks are only served around it
+    client.setPlayerPosition(initialPos);
     
-    // Manually request chunks in the specific range we need for mesh building
-    int chunksRequested = 0;
+    // Manually request chunks in the specific range we need for mesh building, in one batch
+    std::vector<AbsoluteChunkPosition> initialRequests;
     for (int x = -3; x <= 3; x++) {
         for (int y = -1; y <= 2; y++) {
             for (int z = -3; z <= 3; z++) {
-                AbsoluteChunkPosition chunkPos(x + initialChunk.x, y + initialChunk.y, z + initialChunk.z);
-                client.requestChunkAsync(chunkPos);
-                chunksRequested++;
-                printf("Requested chunk (%d, %d, %d)\n", chunkPos.x, chunkPos.y, chunkPos.z);
+                initialRequests.emplace_back(x + initialChunk.x, y + initialChunk.y, z + initialChunk.z);
             }
         }
     }
+    client.requestChunksAsync(initialRequests);
+    // Far rings use downsampled chunks, so they cost about as much as the loaded chunks together
+    for (uint32_t level = 1; level <= CHUNK_LOD_LEVELS; ++level) {
+        client.requestLodChunksAsync(level, lodRing(initialChunk, level));
+    }
     
-    printf("Total chunks requested: %d\n", chunksRequested);
+    printf("Total chunks requested: %zu\n", initialRequests.size());
     fflush(stdout);
     
     printf("Built %zu chunk meshes for rendering.\n", chunkMeshes.size());
@@ -281,7 +456,29 @@ int main(void) {
     
     // Main render loop
     int64_t lastAnchorX = 0, lastAnchorY = 0, lastAnchorZ = 0;
-    std::unordered_map<AbsoluteChunkPosition, bool, ChunkPosHash, ChunkPosEq> meshBuilt;
+    // Which chunk version each mesh was built from, and which meshes to drop as the camera moves
+    ChunkMeshCache meshCache;
+    bool meshToggleWasDown = false;
+    bool formatToggleWasDown = false;
+    bool occlusionCulling = true;
+    bool occlusionToggleWasDown = false;
+    
+    // LOD ring meshes by level - 1, and what each was last queued from: the LOD chunk's version and
+    // whether, and where, the finer ring's hole was cut out of it
+    struct LodMesh {
+        std::unique_ptr<ChunkMesh> mesh;
+        uint64_t version = 0;
+        bool clipped = false;
+        AbsoluteChunkPosition holeMin{0, 0, 0};
+        AbsoluteChunkPosition holeMax{0, 0, 0};
+    };
+    std::array<std::unordered_map<AbsoluteChunkPosition, LodMesh, ChunkPosHash, ChunkPosEq>, CHUNK_LOD_LEVELS> lodMeshes;
+    AbsoluteChunkPosition lodRingChunk = initialChunk;
+    bool lodRingsStale = true;
+    
+    // Chunk changes are pushed by the server instead of polled
+    client.subscribeChunks(5); // 5 chunk render distance
+    AbsoluteChunkPosition subscribedChunk = initialChunk;
     
     int frameCounter = 0;
     while (!glfwWindowShouldClose(window)) {
@@ -293,20 +490,6 @@ int main(void) {
                 printf("Frame %d - Window should close: %s\n", frameCounter, 
                        glfwWindowShouldClose(window) ? "true" : "false");
                 
-                // Update client's player position
-                AbsoluteBlockPosition currentPos = toAbsoluteBlock(AbsolutePrecisePosition(camera.position.x, camera.position.y, camera.position.z));
-                client.setPlayerPosition(currentPos);
-                
-                // Check for updated chunks from server
-                auto updatedChunks = client.getUpdatedChunks(5); // 5 chunk render distance
-                if (!updatedChunks.empty()) {
-                    printf("Server reported %zu updated chunks\n", updatedChunks.size());
-                    // Request the updated chunks
-                    for (const auto& chunkPos : updatedChunks) {
-                        client.requestChunkAsync(chunkPos);
-                    }
-                }
-                
                 // Check OpenGL errors
                 GLenum error = glGetError();
 
@@ -316,8 +499,12 @@ int main(void) {
                 fflush(stdout);
             }
         
-        // Process pending chunk requests (non-blocking)
-        client.processPendingRequests();
+        // Chunks decoded since last frame (non-blocking); the client's threads already cached them
+        std::vector<AbsoluteChunkPosition> arrivedChunks = client.processPendingRequests();
+        
+        // Chunks the server pushed are already cached; resident meshes of them are rechecked below,
+        // and the old mesh stays drawn until its replacement is uploaded
+        std::vector<AbsoluteChunkPosition> streamedUpdates = client.takeStreamedChunkUpdates();
         
         // Calculate delta time
         float currentFrame = glfwGetTime();
@@ -334,7 +521,7 @@ int main(void) {
             
             // Update window title with debug info
             AbsoluteBlockPosition currentPos = toAbsoluteBlock(AbsolutePrecisePosition(camera.position.x, camera.position.y, camera.position.z));
-            int loadedChunks = static_cast<int>(chunkMeshes.size());
+            int loadedChunks = static_cast<int>(chunkMeshes.size() + chunkArena->size());
             
             char titleBuffer[256];
             snprintf(titleBuffer, sizeof(titleBuffer), 
@@ -350,83 +537,203 @@ int main(void) {
         
         // Update player position in client
         AbsoluteBlockPosition currentPos = toAbsoluteBlock(AbsolutePrecisePosition(camera.position.x, camera.position.y, camera.position.z));
+        client.setViewDirection(camera.front.x, camera.front.y, camera.front.z);
         client.setPlayerPosition(currentPos);
         
         // Build meshes for newly loaded chunks
         AbsoluteBlockPosition currentCameraPos = toAbsoluteBlock(AbsolutePrecisePosition(camera.position.x, camera.position.y, camera.position.z));
         AbsoluteChunkPosition cameraChunk = toAbsoluteChunk(currentCameraPos);
         
-        int newMeshesBuilt = 0;
+        // Submits the cached chunk unless a mesh of its current version is resident or building
+        auto queueMesh = [&](const AbsoluteChunkPosition& chunkPos) {
+            // Cached chunks are never edited in place, so the mesher can read the snapshot directly
+            auto chunkOpt = client.getCachedChunk(chunkPos);
+            if (!chunkOpt || !meshCache.needsMesh(chunkPos, (*chunkOpt)->version())) {
+                return;
+            }
+            ChunkNeighbours neighbours;
+            for (int face = 0; face < 6; ++face) {
+                neighbours.faces[face] = client.getCachedChunk(ChunkNeighbours::positionOf(chunkPos, face)).value_or(nullptr);
+            }
+            mesher.submit(chunkPos, *chunkOpt, std::move(neighbours));
+            
+            // Neighbours culled their border against the old contents (or nothing)
+            if (meshCache.queued(chunkPos, (*chunkOpt)->version())) {
+                for (int face = 0; face < 6; ++face) {
+                    meshCache.invalidate(ChunkNeighbours::positionOf(chunkPos, face));
+                }
+            }
+        };
         for (int x = -3; x <= 3; x++) {
             for (int y = -1; y <= 2; y++) {
                 for (int z = -3; z <= 3; z++) {
-                    AbsoluteChunkPosition chunkPos(x + cameraChunk.x, y + cameraChunk.y, z + cameraChunk.z);
-                    
-                    // Check if we already built a mesh for this chunk
-                    if (meshBuilt.find(chunkPos) != meshBuilt.end()) {
+                    queueMesh(AbsoluteChunkPosition(x + cameraChunk.x, y + cameraChunk.y, z + cameraChunk.z));
+                }
+            }
+        }
+        // Meshes kept past the load range still follow edits, and refetches of evicted chunks
+        for (const auto* updates : {&streamedUpdates, &arrivedChunks}) {
+            for (const auto& chunkPos : *updates) {
+                if (meshCache.contains(chunkPos)) {
+                    queueMesh(chunkPos);
+                }
+            }
+        }
+        
+        // Submits a ring's LOD chunk unless its mesh is of the current version with the current hole.
+        // Faces against the hole and against missing neighbours are kept and close the seam to the
+        // finer ring, so neighbours are only culled against away from the hole.
+        auto queueLodMesh = [&](uint32_t level, const AbsoluteChunkPosition& lodPos) {
+            auto chunk = client.getCachedLodChunk(level, lodPos);
+            auto entry = lodMeshes[level - 1].find(lodPos);
+            if (!chunk || entry == lodMeshes[level - 1].end()) {
+                return;
+            }
+            const auto [holeMin, holeMax] = lodRingHole(cameraChunk, level);
+            auto touchesHole = [&](const AbsoluteChunkPosition& pos) {
+                return chunkBoxesOverlap(holeMin, holeMax, lodFirstChunk(pos, level), lodLastChunk(pos, level));
+            };
+            const bool clipped = touchesHole(lodPos);
+            LodMesh& lod = entry->second;
+            if (lod.version == chunk->version() && lod.clipped == clipped &&
+                (!clipped || (ChunkPosEq{}(lod.holeMin, holeMin) && ChunkPosEq{}(lod.holeMax, holeMax)))) {
+                return;
+            }
+            std::shared_ptr<const ChunkSpan> snapshot = chunk;
+            if (clipped) {
+                auto cut = makePooledChunk(*chunk);
+                clearLodChunkBox(*cut, level, holeMin, holeMax);
+                snapshot = std::move(cut);
+            }
+            ChunkNeighbours neighbours;
+            for (int face = 0; face < 6 && !clipped; ++face) {
+                AbsoluteChunkPosition neighbour = ChunkNeighbours::positionOf(lodPos, face);
+                if (!touchesHole(neighbour)) {
+                    neighbours.faces[face] = client.getCachedLodChunk(level, neighbour);
+                }
+            }
+            mesher.submit(lodPos, std::move(snapshot), std::move(neighbours), level);
+            lod.version = chunk->version();
+            lod.clipped = clipped;
+            lod.holeMin = holeMin;
+            lod.holeMax = holeMax;
+        };
+        // On entering another chunk the rings move: drop what left them, request what joined, and
+        // recut the holes; now and then the server is asked what changed under the drawn chunks
+        if (!ChunkPosEq{}(cameraChunk, lodRingChunk) || lodRingsStale || frameCounter % LOD_REVALIDATE_FRAMES == 0) {
+            for (uint32_t level = 1; level <= CHUNK_LOD_LEVELS; ++level) {
+                std::vector<AbsoluteChunkPosition> ring = lodRing(cameraChunk, level);
+                auto& meshes = lodMeshes[level - 1];
+                ChunkSet inRing;
+                for (const auto& pos : ring) {
+                    inRing.insert(pos);
+                    meshes.try_emplace(pos);
+                }
+                for (auto it = meshes.begin(); it != meshes.end();) {
+                    if (inRing.contains(it->first)) {
+                        ++it;
                         continue;
                     }
-                    
-                    // Try to get the chunk from cache
-                    auto chunkOpt = client.getCachedChunk(chunkPos);
-                    if (chunkOpt) {
-                        auto chunk = *chunkOpt;
-                        
-                        // Convert chunk data to vector for mesh building
-                        const size_t chunkElemCount = CHUNK_WIDTH * CHUNK_HEIGHT * CHUNK_DEPTH;
-                        std::vector<Block> chunkData(chunkElemCount);
-                        for (size_t i = 0; i < chunkElemCount; i++) {
-                            chunkData[i] = chunk->storage[i];
-                        }
-                        
-                        // Create mesh for this chunk
-                        auto mesh = std::make_unique<ChunkMesh>();
-                        glm::vec3 worldPos(
-                            chunkPos.x * CHUNK_WIDTH,
-                            chunkPos.y * CHUNK_HEIGHT,
-                            chunkPos.z * CHUNK_DEPTH
-                        );
-                        mesh->buildMesh(chunkData, worldPos);
-                        
-                        chunkMeshes.push_back(std::move(mesh));
-                        chunkPositions.push_back(worldPos);
-                        meshBuilt[chunkPos] = true;
-                        newMeshesBuilt++;
-                        
-                        printf("Built mesh for chunk (%d, %d, %d)\n", chunkPos.x, chunkPos.y, chunkPos.z);
-                        fflush(stdout);
+                    if (it->second.mesh) {
+                        it->second.mesh->cleanup();
                     }
+                    mesher.cancel(it->first, level);
+                    it = meshes.erase(it);
+                }
+                client.evictLodChunks(level, lodPosition(cameraChunk, level), CHUNK_LOD_RING_RADIUS + 1);
+                client.requestLodChunksAsync(level, ring);
+                for (const auto& pos : ring) {
+                    queueLodMesh(level, pos);
                 }
             }
+            lodRingChunk = cameraChunk;
+            lodRingsStale = false;
+        }
+        for (const auto& [level, lodPos] : client.takeArrivedLodChunks()) {
+            queueLodMesh(level, lodPos);
+        }
+        
+        // Upload what the mesher finished, within this frame's budget
+        int newMeshesBuilt = static_cast<int>(mesher.drainCompleted(MESH_UPLOAD_BUDGET, [&](ChunkMesher::Result&& built) {
+            if (built.lodLevel > 0) {
+                auto entry = lodMeshes[built.lodLevel - 1].find(built.position);
+                if (entry == lodMeshes[built.lodLevel - 1].end()) {
+                    return;
+                }
+                if (!entry->second.mesh) {
+                    entry->second.mesh = std::make_unique<ChunkMesh>();
+                }
+                entry->second.mesh->upload(std::move(built.geometry));
+                return;
+            }
+            meshCache.uploaded(built.position, built.geometry.byteSize(), built.geometry.faceConnectivity);
+            // Keep the chunk cached while it has a mesh, so remeshing it never needs a refetch
+            client.pinChunk(built.position);
+            if (built.geometry.format == VertexFormat::Packed) {
+                chunkMeshes.erase(built.position);
+                chunkArena->upload(built.position, std::move(built.geometry));
+                return;
+            }
+            chunkArena->remove(built.position);
+            auto& mesh = chunkMeshes[built.position];
+            if (!mesh) {
+                mesh = std::make_unique<ChunkMesh>();
+            }
+            mesh->upload(std::move(built.geometry));
+        }));
+        
+        // Drop meshes that left the keep distance, and lingering ones while over the VRAM budget;
+        // builds in flight for them are cancelled
+        auto dropMeshes = [&](const std::vector<AbsoluteChunkPosition>& evicted) {
+            for (const auto& pos : evicted) {
+                chunkMeshes.erase(pos);
+                chunkArena->remove(pos);
+                mesher.cancel(pos);
+                client.unpinChunk(pos);
+            }
+        };
+        if (meshCache.residentBytes() > meshCache.byteBudget()) {
+            dropMeshes(meshCache.evict(cameraChunk, CHUNK_LOAD_DISTANCE, CHUNK_MESH_KEEP_DISTANCE));
         }
         
         // Print cache status periodically
         static int debugCounter = 0;
         debugCounter++;
         if (debugCounter % 60 == 0) { // Every ~1 second at 60fps
-            printf("Cache size: %zu chunks, Meshes: %zu, New meshes this frame: %d\n", 
-                   client.getCacheSize(), chunkMeshes.size(), newMeshesBuilt);
+            ClientChunkCacheStats cacheStats = client.getCacheStats();
+            printf("Cache size: %zu chunks (%zu KiB, %llu evicted), Meshes: %zu, New meshes this frame: %d\n", 
+                   cacheStats.chunks, cacheStats.bytes / 1024, static_cast<unsigned long long>(cacheStats.evictions),
+                   chunkMeshes.size() + chunkArena->size(), newMeshesBuilt);
             fflush(stdout);
         }
 
         // Update world anchor to camera's current block position
         AbsoluteBlockPosition anchorBlockPos = toAbsoluteBlock(AbsolutePrecisePosition(camera.position.x, camera.position.y, camera.position.z));
         if (anchorBlockPos.x != lastAnchorX || anchorBlockPos.y != lastAnchorY || anchorBlockPos.z != lastAnchorZ) {
-            // Clear existing meshes and mesh tracking - they'll be rebuilt as chunks load
-            chunkMeshes.clear();
-            chunkPositions.clear();
-            meshBuilt.clear();
-            
             // Request new chunks around the new position using the same range as mesh building
             AbsoluteChunkPosition cameraChunk = toAbsoluteChunk(anchorBlockPos);
+            
+            // Meshes stay resident, and drawn, until they are past the keep distance
+            dropMeshes(meshCache.evict(cameraChunk, CHUNK_LOAD_DISTANCE, CHUNK_MESH_KEEP_DISTANCE));
+
+            std::vector<AbsoluteChunkPosition> requests;
             for (int x = -3; x <= 3; x++) {
                 for (int y = -1; y <= 2; y++) {
                     for (int z = -3; z <= 3; z++) {
                         AbsoluteChunkPosition chunkPos(x + cameraChunk.x, y + cameraChunk.y, z + cameraChunk.z);
-                        client.requestChunkAsync(chunkPos);
+                        if (!client.getCachedChunk(chunkPos)) {
+                            requests.push_back(chunkPos);
+                        }
                     }
                 }
             }
+            client.requestChunksAsync(requests);
+            
+            // Re-centre the update stream when the camera enters another chunk
+            if (!ChunkPosEq{}(cameraChunk, subscribedChunk) || !client.isSubscribed()) {
+                client.subscribeChunks(5);
+                subscribedChunk = cameraChunk;
+            }
             
             lastAnchorX = anchorBlockPos.x;
             lastAnchorY = anchorBlockPos.y;
@@ -436,36 +743,100 @@ int main(void) {
         // Check for escape key to exit
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
             glfwSetWindowShouldClose(window, true);
+        
+        // M switches between greedy and naive meshing; every chunk is remeshed in the new mode
+        bool meshToggleDown = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+        if (meshToggleDown && !meshToggleWasDown) {
+            bool greedy = mesher.getMeshingMode() != MeshingMode::Greedy;
+            mesher.setMeshingMode(greedy ? MeshingMode::Greedy : MeshingMode::Naive);
+            meshCache.invalidateAll();
+            for (auto& meshes : lodMeshes) {
+                for (auto& [lodPos, lod] : meshes) {
+                    lod.version = 0;
+                }
+            }
+            lodRingsStale = true;
+            printf("Meshing mode: %s\n", greedy ? "greedy" : "naive");
+            fflush(stdout);
+        }
+        meshToggleWasDown = meshToggleDown;
+        
+        // V switches chunk meshes between the packed and full vertex formats
+        bool formatToggleDown = glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS;
+        if (formatToggleDown && !formatToggleWasDown) {
+            bool packed = mesher.getVertexFormat() != VertexFormat::Packed;
+            mesher.setVertexFormat(packed ? VertexFormat::Packed : VertexFormat::Full);
+            meshCache.invalidateAll();
+            printf("Chunk vertex format: %s\n", packed ? "packed" : "full");
+            fflush(stdout);
+        }
+        formatToggleWasDown = formatToggleDown;
+        
+        // O switches the occlusion pass on and off; frustum culling always runs
+        bool occlusionToggleDown = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+        if (occlusionToggleDown && !occlusionToggleWasDown) {
+            occlusionCulling = !occlusionCulling;
+            printf("Occlusion culling: %s\n", occlusionCulling ? "on" : "off");
+            fflush(stdout);
+        }
+        occlusionToggleWasDown = occlusionToggleDown;
 
         // Clear screen
         glClearColor(0.2f, 0.3f, 0.8f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Use shader
-        blockShader.use();
-
         // Bind texture
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, atlasTexture);
-        blockShader.setInt("atlas", 0);
+        glBindTexture(atlasTarget, atlasTexture);
 
-        // Set matrices
-        glm::mat4 model = glm::mat4(1.0f);
+        // Set matrices and lighting for both chunk shaders at once
         glm::mat4 view = camera.getViewMatrix();
-        glm::mat4 projection = camera.getProjectionMatrix(static_cast<float>(WINDOW_WIDTH) / static_cast<float>(WINDOW_HEIGHT));
-
-        blockShader.setMat4("model", model);
-        blockShader.setMat4("view", view);
-        blockShader.setMat4("projection", projection);
-
-        // Set lighting uniforms
-        blockShader.setVec3("lightPos", lightPos);
-        blockShader.setVec3("viewPos", camera.position);
+        glm::mat4 projection = camera.getProjectionMatrix(static_cast<float>(WINDOW_WIDTH) / static_cast<float>(WINDOW_HEIGHT), 0.1f, VIEW_DISTANCE);
+        frameUniforms.update(FrameUniforms{view, projection, glm::vec4(lightPos, 1.0f), glm::vec4(camera.position, 1.0f)});
+
+        // Only chunks inside the view frustum are drawn; with occlusion culling on, only those the
+        // camera can also see into through open chunks
+        Frustum frustum(projection * view);
+        // Meshes kept past the load range would overlap the first LOD ring, so only loaded ones are drawn
+        const AbsoluteChunkPosition drawMin = loadBoxMin(cameraChunk);
+        const AbsoluteChunkPosition drawMax = loadBoxMax(cameraChunk);
+        auto inView = [&](const AbsoluteChunkPosition& pos) {
+            return chunkBoxContains(drawMin, drawMax, pos, pos) && frustum.intersectsChunk(pos);
+        };
+        ChunkSet visibleChunks;
+        if (occlusionCulling) {
+            AbsoluteChunkPosition viewChunk = toAbsoluteChunk(toAbsoluteBlock(AbsolutePrecisePosition(camera.position.x, camera.position.y, camera.position.z)));
+            visibleChunks = findVisibleChunks(viewChunk, CHUNK_MESH_KEEP_DISTANCE, [&](const AbsoluteChunkPosition& pos) {
+                return meshCache.connectivity(pos);
+            }, inView);
+        } else {
+            meshCache.forEachResident([&](const AbsoluteChunkPosition& pos) {
+                if (inView(pos)) {
+                    visibleChunks.insert(pos);
+                }
+            });
+        }
+        for (const auto& pos : visibleChunks) {
+            meshCache.touch(pos);
+        }
+        meshCache.nextFrame();
 
-        // Render all terrain chunks
-        for (size_t i = 0; i < chunkMeshes.size(); i++) {
-            chunkMeshes[i]->render();
+        // Render the visible terrain chunks, each format with its own shader
+        blockShader.use();
+        for (auto& [chunkPos, mesh] : chunkMeshes) {
+            if (mesh->format() == VertexFormat::Full && visibleChunks.contains(chunkPos)) {
+                mesh->render();
+            }
         }
+        for (uint32_t level = 1; level <= CHUNK_LOD_LEVELS; ++level) {
+            for (auto& [lodPos, lod] : lodMeshes[level - 1]) {
+                if (lod.mesh && frustum.intersectsBox(chunkBoundsMin(lodFirstChunk(lodPos, level)), chunkBoundsMax(lodLastChunk(lodPos, level)))) {
+                    lod.mesh->render();
+                }
+            }
+        }
+        arenaChunkShader.use();
+        chunkArena->draw(GL_TEXTURE1, &visibleChunks);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -492,10 +863,20 @@ int main(void) {
     printf("Shutting down...\n");
     client.disconnect();
     server.stop();
+    // The tick thread has stopped, so nothing changes the world while it is written
+    world->saveCheckpoint(WORLD_CHECKPOINT_PATH);
     blockRenderer.cleanup();
-    for (auto& mesh : chunkMeshes) {
+    for (auto& [chunkPos, mesh] : chunkMeshes) {
         mesh->cleanup();
     }
+    for (auto& meshes : lodMeshes) {
+        for (auto& [lodPos, lod] : meshes) {
+            if (lod.mesh) {
+                lod.mesh->cleanup();
+            }
+        }
+    }
+    chunkArena.reset();
     glDeleteTextures(1, &atlasTexture);
     glfwDestroyWindow(window);
     glfwTerminate();
@@ -0,0 +1,262 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+namespace {
+
+std::string entryKey(const std::string& name, const MetricLabels& labels) {
+    // \x1f sorts before any name character, so one name's label sets stay together
+    std::string key = name;
+    for (const auto& [label, value] : labels) {
+        key += '\x1f';
+        key += label;
+        key += '=';
+        key += value;
+    }
+    return key;
+}
+
+void appendNumber(std::string& out, double value) {
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+void appendNumber(std::string& out, uint64_t value) {
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+void appendEscaped(std::string& out, const std::string& text, bool quote) {
+    for (char c : text) {
+        if (c == '\\') {
+            out += "\\\\";
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c == '"' && quote) {
+            out += "\\\"";
+        } else {
+            out += c;
+        }
+    }
+}
+
+// {a="1",b="2"} with an optional extra label (the histogram bucket's le); nothing when empty
+void appendLabels(std::string& out, const MetricLabels& labels, const char* extraName = nullptr, const std::string& extraValue = {}) {
+    if (labels.empty() && !extraName) {
+        return;
+    }
+    out += '{';
+    bool first = true;
+    auto append = [&](const std::string& name, const std::string& value) {
+        if (!first) {
+            out += ',';
+        }
+        first = false;
+        out += name;
+        out += "=\"";
+        appendEscaped(out, value, true);
+        out += '"';
+    };
+    for (const auto& [name, value] : labels) {
+        append(name, value);
+    }
+    if (extraName) {
+        append(extraName, extraValue);
+    }
+    out += '}';
+}
+
+const char* typeName(MetricKind kind) {
+    switch (kind) {
+    case MetricKind::Counter:
+        return "counter";
+    case MetricKind::Gauge:
+        return "gauge";
+    case MetricKind::Histogram:
+        return "histogram";
+    }
+    return "untyped";
+}
+
+} // namespace
+
+std::vector<double> latencyBuckets() {
+    std::vector<double> bounds;
+    for (double bound = 1e-6; bound < 20.0; bound *= 2.0) {
+        bounds.push_back(bound);
+    }
+    return bounds;
+}
+
+std::vector<double> sizeBuckets() {
+    std::vector<double> bounds;
+    for (double bound = 16.0; bound <= 16.0 * 1024 * 1024; bound *= 4.0) {
+        bounds.push_back(bound);
+    }
+    return bounds;
+}
+
+MetricHistogram::MetricHistogram(std::vector<double> upperBounds)
+    : upperBounds_(std::move(upperBounds)), buckets_(new std::atomic<uint64_t>[upperBounds_.size() + 1]) {
+    if (!std::is_sorted(upperBounds_.begin(), upperBounds_.end())) {
+        throw std::invalid_argument("MetricHistogram requires ascending bucket bounds");
+    }
+    for (size_t i = 0; i <= upperBounds_.size(); ++i) {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void MetricHistogram::observe(double value) {
+    // Bounds are inclusive upper limits, as Prometheus' le
+    const size_t bucket = static_cast<size_t>(std::lower_bound(upperBounds_.begin(), upperBounds_.end(), value) - upperBounds_.begin());
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+std::vector<uint64_t> MetricHistogram::bucketCounts() const {
+    std::vector<uint64_t> counts(upperBounds_.size() + 1);
+    for (size_t i = 0; i < counts.size(); ++i) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+    return counts;
+}
+
+MetricsRegistry& MetricsRegistry::global() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::Entry& MetricsRegistry::entry(const std::string& name, const std::string& help, const MetricLabels& labels, MetricKind kind) {
+    auto [it, inserted] = entries_.try_emplace(entryKey(name, labels));
+    Entry& entry = it->second;
+    if (inserted) {
+        entry.name = name;
+        entry.help = help;
+        entry.labels = labels;
+        entry.kind = kind;
+    } else if (entry.kind != kind) {
+        throw std::invalid_argument("Metric " + name + " is already registered as a " + typeName(entry.kind));
+    }
+    return entry;
+}
+
+MetricCounter& MetricsRegistry::counter(const std::string& name, const std::string& help, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& e = entry(name, help, labels, MetricKind::Counter);
+    if (!e.counter) {
+        e.counter = std::make_unique<MetricCounter>();
+    }
+    return *e.counter;
+}
+
+MetricGauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const MetricLabels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& e = entry(name, help, labels, MetricKind::Gauge);
+    if (!e.gauge) {
+        e.gauge = std::make_unique<MetricGauge>();
+    }
+    return *e.gauge;
+}
+
+MetricHistogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, const MetricLabels& labels,
+                                            const std::vector<double>& upperBounds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& e = entry(name, help, labels, MetricKind::Histogram);
+    if (!e.histogram) {
+        e.histogram = std::make_unique<MetricHistogram>(upperBounds);
+    }
+    return *e.histogram;
+}
+
+std::vector<MetricSnapshot> MetricsRegistry::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<MetricSnapshot> result;
+    result.reserve(entries_.size());
+    for (const auto& [key, e] : entries_) {
+        MetricSnapshot metric;
+        metric.name = e.name;
+        metric.help = e.help;
+        metric.labels = e.labels;
+        metric.kind = e.kind;
+        switch (e.kind) {
+        case MetricKind::Counter:
+            metric.value = static_cast<double>(e.counter->value());
+            break;
+        case MetricKind::Gauge:
+            metric.value = static_cast<double>(e.gauge->value());
+            break;
+        case MetricKind::Histogram:
+            metric.upperBounds = e.histogram->upperBounds();
+            metric.bucketCounts = e.histogram->bucketCounts();
+            // Bucket loads and the count aren't one atomic read; report the buckets' total
+            metric.count = 0;
+            for (uint64_t n : metric.bucketCounts) {
+                metric.count += n;
+            }
+            metric.sum = e.histogram->sum();
+            break;
+        }
+        result.push_back(std::move(metric));
+    }
+    return result;
+}
+
+std::string formatPrometheusText(const std::vector<MetricSnapshot>& metrics) {
+    std::string out;
+    const std::string* previousName = nullptr;
+    for (const MetricSnapshot& metric : metrics) {
+        if (!previousName || *previousName != metric.name) {
+            out += "# HELP ";
+            out += metric.name;
+            out += ' ';
+            appendEscaped(out, metric.help, false);
+            out += "\n# TYPE ";
+            out += metric.name;
+            out += ' ';
+            out += typeName(metric.kind);
+            out += '\n';
+            previousName = &metric.name;
+        }
+        if (metric.kind != MetricKind::Histogram) {
+            out += metric.name;
+            appendLabels(out, metric.labels);
+            out += ' ';
+            appendNumber(out, metric.value);
+            out += '\n';
+            continue;
+        }
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < metric.bucketCounts.size(); ++i) {
+            cumulative += metric.bucketCounts[i];
+            std::string bound = "+Inf";
+            if (i < metric.upperBounds.size()) {
+                bound.clear();
+                appendNumber(bound, metric.upperBounds[i]);
+            }
+            out += metric.name;
+            out += "_bucket";
+            appendLabels(out, metric.labels, "le", bound);
+            out += ' ';
+            appendNumber(out, cumulative);
+            out += '\n';
+        }
+        out += metric.name;
+        out += "_sum";
+        appendLabels(out, metric.labels);
+        out += ' ';
+        appendNumber(out, metric.sum);
+        out += '\n';
+        out += metric.name;
+        out += "_count";
+        appendLabels(out, metric.labels);
+        out += ' ';
+        appendNumber(out, metric.count);
+        out += '\n';
+    }
+    return out;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Label name/value pairs that tell apart metrics of the same name, e.g. {{"method", "GetChunk"}}
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+enum class MetricKind {
+    Counter,
+    Gauge,
+    Histogram
+};
+
+// Monotonic count; add() is one relaxed atomic add
+class MetricCounter {
+public:
+    void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Value that goes up and down, e.g. a queue depth
+class MetricGauge {
+public:
+    void set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// Upper bounds for latencies in seconds: 1us doubling up to ~16s
+std::vector<double> latencyBuckets();
+// Upper bounds for sizes in bytes: 16B quadrupling up to 16MiB
+std::vector<double> sizeBuckets();
+
+/**
+ * @brief Distribution of observed values over fixed buckets. observe() is a binary search over
+ * the bounds and three relaxed atomic adds, so it is cheap enough for per-call use on any thread.
+ */
+class MetricHistogram {
+public:
+    explicit MetricHistogram(std::vector<double> upperBounds);
+
+    void observe(double value);
+    template<typename Rep, typename Period>
+    void observe(std::chrono::duration<Rep, Period> duration) {
+        observe(std::chrono::duration<double>(duration).count());
+    }
+
+    const std::vector<double>& upperBounds() const { return upperBounds_; }
+    // Observations in each bucket (not cumulative); the last is above every bound
+    std::vector<uint64_t> bucketCounts() const;
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    double sum() const { return sum_.load(std::memory_order_relaxed); }
+
+private:
+    const std::vector<double> upperBounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<double> sum_{0.0};
+};
+
+// Observes the time from construction to destruction into a histogram
+class ScopedMetricTimer {
+public:
+    explicit ScopedMetricTimer(MetricHistogram& histogram)
+        : histogram_(histogram), started_(std::chrono::steady_clock::now()) {}
+    ~ScopedMetricTimer() { histogram_.observe(std::chrono::steady_clock::now() - started_); }
+    ScopedMetricTimer(const ScopedMetricTimer&) = delete;
+    ScopedMetricTimer& operator=(const ScopedMetricTimer&) = delete;
+
+private:
+    MetricHistogram& histogram_;
+    const std::chrono::steady_clock::time_point started_;
+};
+
+// A metric's value at one moment, as reported by GetStats
+struct MetricSnapshot {
+    std::string name;
+    std::string help;
+    MetricLabels labels;
+    MetricKind kind = MetricKind::Gauge;
+    double value = 0.0; // counters and gauges
+    // Histograms: bounds, per-bucket counts (one more than bounds), count and sum
+    std::vector<double> upperBounds;
+    std::vector<uint64_t> bucketCounts;
+    uint64_t count = 0;
+    double sum = 0.0;
+};
+
+/**
+ * @brief Process-wide set of named metrics.
+ *
+ * Metrics are registered once, typically into a function-local static reference next to the code
+ * they measure, and live as long as the process; registering the same name and labels again
+ * returns the same metric. Only registration and snapshot() take the lock. Names follow the
+ * Prometheus conventions: a unit suffix, and _total on counters.
+ */
+class MetricsRegistry {
+public:
+    static MetricsRegistry& global();
+
+    // Throw std::invalid_argument if the name and labels are already registered as another kind
+    MetricCounter& counter(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    MetricGauge& gauge(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    MetricHistogram& histogram(const std::string& name, const std::string& help, const MetricLabels& labels = {},
+                               const std::vector<double>& upperBounds = latencyBuckets());
+
+    // Every metric, sorted by name then labels
+    std::vector<MetricSnapshot> snapshot() const;
+
+private:
+    struct Entry {
+        std::string name;
+        std::string help;
+        MetricLabels labels;
+        MetricKind kind;
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricGauge> gauge;
+        std::unique_ptr<MetricHistogram> histogram;
+    };
+
+    Entry& entry(const std::string& name, const std::string& help, const MetricLabels& labels, MetricKind kind);
+
+    mutable std::mutex mutex_;
+    // Keyed by name and labels, which also gives snapshot() its order
+    std::map<std::string, Entry> entries_;
+};
+
+// Shorthands for MetricsRegistry::global()
+inline MetricCounter& metricCounter(const std::string& name, const std::string& help, const MetricLabels& labels = {}) {
+    return MetricsRegistry::global().counter(name, help, labels);
+}
+inline MetricGauge& metricGauge(const std::string& name, const std::string& help, const MetricLabels& labels = {}) {
+    return MetricsRegistry::global().gauge(name, help, labels);
+}
+inline MetricHistogram& metricHistogram(const std::string& name, const std::string& help, const MetricLabels& labels = {},
+                                        const std::vector<double>& upperBounds = latencyBuckets()) {
+    return MetricsRegistry::global().histogram(name, help, labels, upperBounds);
+}
+
+// Prometheus text exposition format (version 0.0.4). Metrics of one name must be adjacent, as
+// snapshot() returns them; each name gets one HELP and TYPE line.
+std::string formatPrometheusText(const std::vector<MetricSnapshot>& metrics);
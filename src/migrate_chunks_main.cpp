@@ -0,0 +1,30 @@
+// blocktest_migrate: copies a SQLite chunk database into region files.
+// Usage: blocktest_migrate <chunks.db> <region-directory>
+#include "chunk_migration.h"
+#include "region_chunk_persistence.h"
+#include <iostream>
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <chunks.db> <region-directory>\n";
+        return 1;
+    }
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open_v2(argv[1], &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to open " << argv[1] << ": " << sqlite3_errmsg(db) << "\n";
+        sqlite3_close(db);
+        return 1;
+    }
+
+    size_t migrated = 0;
+    {
+        RegionFileChunkPersistence regions(argv[2]);
+        migrated = migrateSQLiteChunks(db, regions);
+        regions.flush();
+    }
+    sqlite3_close(db);
+
+    std::cout << "Migrated " << migrated << " chunks into " << argv[2] << std::endl;
+    return 0;
+}
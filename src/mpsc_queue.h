@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+/**
+ * @brief Unbounded lock-free queue for many producer threads and one consumer thread.
+ *
+ * A linked list with a dummy node (Vyukov's intrusive MPSC queue): push() is a single atomic
+ * exchange, so producers never wait on the consumer or each other, and pop() never blocks. An
+ * element pushed while pop() runs may not be seen until the next pop(). Each push allocates a node.
+ */
+template<typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head_(new Node()), tail_(head_.load(std::memory_order_relaxed)) {}
+    ~MpscQueue() {
+        while (tail_) {
+            Node* next = tail_->next.load(std::memory_order_relaxed);
+            delete tail_;
+            tail_ = next;
+        }
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // Any thread
+    void push(T value) {
+        Node* node = new Node();
+        node->value.emplace(std::move(value));
+        Node* previous = head_.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Consumer thread only; empty when nothing is ready
+    std::optional<T> pop() {
+        Node* next = tail_->next.load(std::memory_order_acquire);
+        if (!next) {
+            return std::nullopt;
+        }
+        // The next node becomes the dummy once its value is moved out
+        std::optional<T> value = std::move(next->value);
+        next->value.reset();
+        delete tail_;
+        tail_ = next;
+        return value;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        std::optional<T> value;
+    };
+
+    // Most recently pushed node; producers swap themselves in here
+    std::atomic<Node*> head_;
+    // Dummy node ahead of the oldest element; only the consumer touches it
+    Node* tail_;
+};
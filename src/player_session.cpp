@@ -1,149 +1,295 @@
 #include "player_session.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <random>
-#include <sstream>
-#include <iomanip>
-
-std::string PlayerSessionManager::generateSessionToken() {
-    // Generate a random session token
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<uint64_t> dis;
-    
-    uint64_t token1 = dis(gen);
-    uint64_t token2 = dis(gen);
-    
-    std::stringstream ss;
-    ss << std::hex << token1 << token2;
-    return ss.str();
-}
-
-std::string PlayerSessionManager::createSession(const std::string& playerName, 
-                                               entt::entity playerEntity, 
-                                               const AbsolutePrecisePosition& position) {
-    std::lock_guard<std::mutex> lock(sessionsMutex_);
-    
-    std::string token = generateSessionToken();
-    
-    // Ensure token is unique (very unlikely collision, but be safe)
-    while (activeSessions_.find(token) != activeSessions_.end()) {
-        token = generateSessionToken();
+
+#include <sys/random.h>
+
+namespace {
+
+constexpr size_t TOKEN_HEX_DIGITS = 16;
+constexpr size_t TOKEN_LENGTH = 2 * TOKEN_HEX_DIGITS;
+
+uint32_t slotIndexOf(SessionHandle handle) { return static_cast<uint32_t>(handle); }
+uint32_t generationOf(SessionHandle handle) { return static_cast<uint32_t>(handle >> 32); }
+SessionHandle makeHandle(uint32_t slotIndex, uint32_t generation) {
+    return (static_cast<SessionHandle>(generation) << 32) | slotIndex;
+}
+
+// Handle then secret, each as 16 lowercase hex digits
+std::string formatToken(SessionHandle handle, uint64_t secret) {
+    char buffer[TOKEN_LENGTH + 1];
+    std::snprintf(buffer, sizeof(buffer), "%016llx%016llx", static_cast<unsigned long long>(handle), static_cast<unsigned long long>(secret));
+    return std::string(buffer, TOKEN_LENGTH);
+}
+
+bool parseHex(const char* digits, uint64_t& value) {
+    value = 0;
+    for (size_t i = 0; i < TOKEN_HEX_DIGITS; ++i) {
+        char c = digits[i];
+        uint64_t digit;
+        if (c >= '0' && c <= '9') {
+            digit = static_cast<uint64_t>(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            digit = static_cast<uint64_t>(c - 'a' + 10);
+        } else {
+            return false;
+        }
+        value = (value << 4) | digit;
     }
-    
-    activeSessions_.emplace(token, PlayerSession(token, playerName, playerEntity, position));
-    return token;
+    return true;
 }
 
-bool PlayerSessionManager::refreshSession(const std::string& sessionToken) {
-    std::lock_guard<std::mutex> lock(sessionsMutex_);
-    
-    auto it = activeSessions_.find(sessionToken);
-    if (it != activeSessions_.end()) {
-        it->second.lastRefresh = std::chrono::steady_clock::now();
-        return true;
+bool parseToken(const std::string& token, SessionHandle& handle, uint64_t& secret) {
+    return token.size() == TOKEN_LENGTH && parseHex(token.data(), handle) && parseHex(token.data() + TOKEN_HEX_DIGITS, secret);
+}
+
+// Fresh from the OS for every token: handles are guessable, so the secret alone keeps a session
+// from being taken over, and a seeded generator's outputs would give its state away
+uint64_t randomSecret() {
+    uint64_t secret = 0;
+    auto* out = reinterpret_cast<unsigned char*>(&secret);
+    size_t filled = 0;
+    while (filled < sizeof(secret)) {
+        const ssize_t got = getrandom(out + filled, sizeof(secret) - filled, 0);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // No getrandom (old kernel): random_device reads the same pool
+            std::random_device rd;
+            return (static_cast<uint64_t>(rd()) << 32) | rd();
+        }
+        filled += static_cast<size_t>(got);
     }
-    return false;
+    return secret;
 }
 
-bool PlayerSessionManager::updatePlayerPosition(const std::string& sessionToken, 
-                                               const AbsolutePrecisePosition& position) {
-    std::lock_guard<std::mutex> lock(sessionsMutex_);
-    
-    auto it = activeSessions_.find(sessionToken);
-    if (it != activeSessions_.end()) {
-        it->second.position = position;
-        it->second.lastRefresh = std::chrono::steady_clock::now(); // Also refresh on position update
-        return true;
+// Doesn't stop at the first differing bit, so timing says nothing about how much of a guess was right
+bool secretsEqual(uint64_t a, uint64_t b) {
+    uint64_t difference = 0;
+    for (int shift = 0; shift < 64; shift += 8) {
+        difference |= ((a ^ b) >> shift) & 0xff;
     }
-    return false;
+    return difference == 0;
 }
 
-bool PlayerSessionManager::isValidSession(const std::string& sessionToken) const {
-    std::lock_guard<std::mutex> lock(sessionsMutex_);
-    
-    auto it = activeSessions_.find(sessionToken);
-    if (it == activeSessions_.end()) {
+} // namespace
+
+PlayerSessionManager::PlayerSessionManager(std::chrono::steady_clock::duration timeout)
+    : timeout_(timeout), expiry_(SESSION_EXPIRY_TICK) {}
+
+template<typename F>
+bool PlayerSessionManager::withSession(SessionHandle handle, std::optional<uint64_t> secret, F&& f) const {
+    const uint32_t index = slotIndexOf(handle);
+    Shard& shard = shards_[index % SESSION_SHARDS];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const size_t local = index / SESSION_SHARDS;
+    if (local >= shard.slots.size()) {
+        return false;
+    }
+    Slot& slot = shard.slots[local];
+    if (!slot.session || slot.generation != generationOf(handle) || (secret && !secretsEqual(*secret, slot.secret))) {
+        return false;
+    }
+    // Timed out but not swept yet: already gone as far as callers are concerned
+    if (std::chrono::steady_clock::now() - slot.session->lastRefresh >= timeout_) {
         return false;
     }
-    
-    auto now = std::chrono::steady_clock::now();
-    auto elapsed = now - it->second.lastRefresh;
-    return elapsed < SESSION_TIMEOUT;
+    f(*slot.session);
+    return true;
+}
+
+std::string PlayerSessionManager::createSession(const std::string& playerName,
+                                               entt::entity playerEntity,
+                                               const AbsolutePrecisePosition& position) {
+    const uint32_t shardIndex = nextShard_.fetch_add(1, std::memory_order_relaxed) % SESSION_SHARDS;
+    Shard& shard = shards_[shardIndex];
+    // Drawn outside the lock; getrandom is a system call
+    const uint64_t secret = randomSecret();
+    SessionHandle handle;
+    std::string token;
+    std::chrono::steady_clock::time_point created;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        uint32_t local;
+        if (!shard.freeSlots.empty()) {
+            local = shard.freeSlots.back();
+            shard.freeSlots.pop_back();
+        } else {
+            local = static_cast<uint32_t>(shard.slots.size());
+            shard.slots.emplace_back();
+        }
+        Slot& slot = shard.slots[local];
+        handle = makeHandle(local * static_cast<uint32_t>(SESSION_SHARDS) + shardIndex, slot.generation);
+        slot.secret = secret;
+        token = formatToken(handle, slot.secret);
+        slot.session.emplace(token, playerName, playerEntity, position);
+        slot.session->handle = handle;
+        created = slot.session->lastRefresh;
+    }
+
+    std::lock_guard<std::mutex> lock(expiryMutex_);
+    expiry_.schedule(handle, created + timeout_);
+    return token;
 }
 
-// Internal helper method that doesn't acquire the lock (assumes lock is already held)
-bool PlayerSessionManager::isValidSessionInternal(const std::string& sessionToken) const {
-    auto it = activeSessions_.find(sessionToken);
-    if (it == activeSessions_.end()) {
+bool PlayerSessionManager::restoreSession(const std::string& sessionToken, const std::string& playerName,
+                                          entt::entity playerEntity, const AbsolutePrecisePosition& position) {
+    SessionHandle handle;
+    uint64_t secret;
+    if (!parseToken(sessionToken, handle, secret) || generationOf(handle) == 0) {
         return false;
     }
-    
-    auto now = std::chrono::steady_clock::now();
-    auto elapsed = now - it->second.lastRefresh;
-    return elapsed < SESSION_TIMEOUT;
+    const uint32_t index = slotIndexOf(handle);
+    Shard& shard = shards_[index % SESSION_SHARDS];
+    const uint32_t local = index / static_cast<uint32_t>(SESSION_SHARDS);
+    std::chrono::steady_clock::time_point created;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        // Slots skipped to reach this one are free for new sessions
+        while (shard.slots.size() <= local) {
+            shard.freeSlots.push_back(static_cast<uint32_t>(shard.slots.size()));
+            shard.slots.emplace_back();
+        }
+        Slot& slot = shard.slots[local];
+        if (slot.session) {
+            return false;
+        }
+        shard.freeSlots.erase(std::remove(shard.freeSlots.begin(), shard.freeSlots.end(), local), shard.freeSlots.end());
+        slot.generation = generationOf(handle);
+        slot.secret = secret;
+        slot.session.emplace(sessionToken, playerName, playerEntity, position);
+        slot.session->handle = handle;
+        created = slot.session->lastRefresh;
+    }
+
+    std::lock_guard<std::mutex> lock(expiryMutex_);
+    expiry_.schedule(handle, created + timeout_);
+    return true;
 }
 
-std::optional<PlayerSession> PlayerSessionManager::getSession(const std::string& sessionToken) const {
-    std::lock_guard<std::mutex> lock(sessionsMutex_);
-    
-    auto it = activeSessions_.find(sessionToken);
-    if (it != activeSessions_.end() && isValidSessionInternal(sessionToken)) {
-        return it->second;
+std::optional<SessionHandle> PlayerSessionManager::resolve(const std::string& sessionToken) const {
+    SessionHandle handle;
+    uint64_t secret;
+    if (!parseToken(sessionToken, handle, secret) || !withSession(handle, secret, [](PlayerSession&) {})) {
+        return std::nullopt;
     }
-    return std::nullopt;
-}
-
-std::vector<std::string> PlayerSessionManager::removeExpiredSessions() {
-    std::lock_guard<std::mutex> lock(sessionsMutex_);
-    std::vector<std::string> expiredTokens;
-    
-    auto now = std::chrono::steady_clock::now();
-    
-    for (auto it = activeSessions_.begin(); it != activeSessions_.end();) {
-        auto elapsed = now - it->second.lastRefresh;
-        if (elapsed >= SESSION_TIMEOUT) {
-            expiredTokens.push_back(it->first);
-            it = activeSessions_.erase(it);
-        } else {
-            ++it;
+    return handle;
+}
+
+bool PlayerSessionManager::refreshSession(const std::string& sessionToken) {
+    auto handle = resolve(sessionToken);
+    return handle && refreshSession(*handle);
+}
+
+bool PlayerSessionManager::refreshSession(SessionHandle handle) {
+    return withSession(handle, std::nullopt, [](PlayerSession& session) {
+        session.lastRefresh = std::chrono::steady_clock::now();
+    });
+}
+
+bool PlayerSessionManager::updatePlayerPosition(const std::string& sessionToken,
+                                               const AbsolutePrecisePosition& position,
+                                               entt::entity* playerEntity) {
+    auto handle = resolve(sessionToken);
+    return handle && updatePlayerPosition(*handle, position, playerEntity);
+}
+
+bool PlayerSessionManager::updatePlayerPosition(SessionHandle handle,
+                                               const AbsolutePrecisePosition& position,
+                                               entt::entity* playerEntity) {
+    return withSession(handle, std::nullopt, [&](PlayerSession& session) {
+        session.position = position;
+        session.lastRefresh = std::chrono::steady_clock::now(); // Also refresh on position update
+        if (playerEntity) {
+            *playerEntity = session.playerEntity;
         }
+    });
+}
+
+bool PlayerSessionManager::isValidSession(const std::string& sessionToken) const {
+    return resolve(sessionToken).has_value();
+}
+
+std::optional<PlayerSession> PlayerSessionManager::getSession(const std::string& sessionToken) const {
+    SessionHandle handle;
+    uint64_t secret;
+    std::optional<PlayerSession> copy;
+    if (parseToken(sessionToken, handle, secret)) {
+        withSession(handle, secret, [&](PlayerSession& session) { copy = session; });
     }
-    
-    return expiredTokens;
+    return copy;
+}
+
+std::optional<PlayerSessionState> PlayerSessionManager::getSessionState(SessionHandle handle) const {
+    std::optional<PlayerSessionState> state;
+    withSession(handle, std::nullopt, [&](PlayerSession& session) {
+        state = PlayerSessionState{session.playerEntity, session.position};
+    });
+    return state;
 }
 
-void PlayerSessionManager::removeSession(const std::string& sessionToken) {
-    std::lock_guard<std::mutex> lock(sessionsMutex_);
-    activeSessions_.erase(sessionToken);
+std::vector<ExpiredPlayerSession> PlayerSessionManager::removeExpiredSessions() {
+    return removeExpiredSessions(std::chrono::steady_clock::now());
 }
 
-std::vector<PlayerSession> PlayerSessionManager::getAllActiveSessions() const {
-    std::lock_guard<std::mutex> lock(sessionsMutex_);
-    std::vector<PlayerSession> sessions;
-    
-    auto now = std::chrono::steady_clock::now();
-    
-    for (const auto& [token, session] : activeSessions_) {
-        auto elapsed = now - session.lastRefresh;
-        if (elapsed < SESSION_TIMEOUT) {
-            sessions.push_back(session);
+std::vector<ExpiredPlayerSession> PlayerSessionManager::removeExpiredSessions(std::chrono::steady_clock::time_point now) {
+    std::vector<ExpiredPlayerSession> expired;
+    std::lock_guard<std::mutex> expiryLock(expiryMutex_);
+    std::vector<SessionHandle> due;
+    expiry_.advance(now, due);
+    for (SessionHandle handle : due) {
+        const uint32_t index = slotIndexOf(handle);
+        Shard& shard = shards_[index % SESSION_SHARDS];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Slot& slot = shard.slots[index / SESSION_SHARDS];
+        if (!slot.session || slot.generation != generationOf(handle)) {
+            // Removed since the timer was set
+            continue;
+        }
+        const auto deadline = slot.session->lastRefresh + timeout_;
+        if (now < deadline) {
+            // Refreshed since; wait for the new deadline
+            expiry_.schedule(handle, deadline);
+            continue;
         }
+        expired.push_back(ExpiredPlayerSession{handle, slot.session->playerEntity});
+        slot.session.reset();
+        ++slot.generation;
+        shard.freeSlots.push_back(index / SESSION_SHARDS);
     }
-    
-    return sessions;
+    return expired;
+}
+
+std::optional<entt::entity> PlayerSessionManager::removeSession(const std::string& sessionToken) {
+    SessionHandle handle;
+    uint64_t secret;
+    if (!parseToken(sessionToken, handle, secret)) {
+        return std::nullopt;
+    }
+    const uint32_t index = slotIndexOf(handle);
+    Shard& shard = shards_[index % SESSION_SHARDS];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const size_t local = index / SESSION_SHARDS;
+    if (local >= shard.slots.size()) {
+        return std::nullopt;
+    }
+    Slot& slot = shard.slots[local];
+    if (!slot.session || slot.generation != generationOf(handle) || !secretsEqual(slot.secret, secret)) {
+        return std::nullopt;
+    }
+    // The session's timer is left to fire and find the slot's generation moved on
+    entt::entity entity = slot.session->playerEntity;
+    slot.session.reset();
+    ++slot.generation;
+    shard.freeSlots.push_back(static_cast<uint32_t>(local));
+    return entity;
 }
 
 size_t PlayerSessionManager::getActiveSessionCount() const {
-    std::lock_guard<std::mutex> lock(sessionsMutex_);
-    
-    auto now = std::chrono::steady_clock::now();
     size_t count = 0;
-    
-    for (const auto& [token, session] : activeSessions_) {
-        auto elapsed = now - session.lastRefresh;
-        if (elapsed < SESSION_TIMEOUT) {
-            count++;
-        }
-    }
-    
+    forEachActiveSession([&](const PlayerSession&) { ++count; });
     return count;
-}
\ No newline at end of file
+}
@@ -1,11 +1,25 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <string>
 #include <chrono>
-#include <unordered_map>
+#include <cstdint>
 #include <mutex>
+#include <optional>
+#include <vector>
 #include <entt/entt.hpp>
 #include "position.h"
+#include "timer_wheel.h"
+
+/**
+ * @brief Names a session inside the server: the session's slot index in the low 32 bits and the
+ * slot's generation in the high 32, so a handle goes stale when its session ends even though the
+ * slot is reused. Handles are guessable; only tokens, which add a random secret, come from clients.
+ */
+using SessionHandle = uint64_t;
+// Never issued
+constexpr SessionHandle INVALID_SESSION_HANDLE = 0;
 
 /**
  * @brief Represents an active player session
@@ -16,38 +30,111 @@ struct PlayerSession {
     entt::entity playerEntity;
     std::chrono::steady_clock::time_point lastRefresh;
     AbsolutePrecisePosition position;
-    
-    PlayerSession(const std::string& token, const std::string& name, 
+    SessionHandle handle = INVALID_SESSION_HANDLE;
+
+    PlayerSession(const std::string& token, const std::string& name,
                   entt::entity entity, const AbsolutePrecisePosition& pos)
-        : sessionToken(token), playerName(name), playerEntity(entity), 
+        : sessionToken(token), playerName(name), playerEntity(entity),
           lastRefresh(std::chrono::steady_clock::now()), position(pos) {}
 };
 
+// The parts of a session the per-tick paths read, without copying its strings
+struct PlayerSessionState {
+    entt::entity playerEntity;
+    AbsolutePrecisePosition position;
+};
+
+struct ExpiredPlayerSession {
+    SessionHandle handle;
+    entt::entity playerEntity;
+};
+
 /**
  * @brief Manages player sessions with timeout handling
+ *
+ * Sessions live in slots spread over SESSION_SHARDS independently locked shards, so lookups by
+ * handle index straight into a slot and players on different shards never contend. A token is the
+ * handle and a secret from the OS's CSPRNG in hex; resolving one parses it instead of hashing a
+ * string key, and compares the secret in constant time.
+ * Timeouts go through a TimerWheel: each session has one timer, refreshes just move its deadline,
+ * and a timer that fires early for a refreshed session is set again, so removeExpiredSessions
+ * only ever looks at sessions whose timers came due.
  */
 class PlayerSessionManager {
 public:
     static constexpr std::chrono::seconds SESSION_TIMEOUT{5}; // 5 second timeout
-    
+    // Granularity of the expiry timers
+    static constexpr std::chrono::milliseconds SESSION_EXPIRY_TICK{100};
+    static constexpr size_t SESSION_SHARDS = 16;
+
+    explicit PlayerSessionManager(std::chrono::steady_clock::duration timeout = SESSION_TIMEOUT);
+
     // Session management
-    std::string createSession(const std::string& playerName, entt::entity playerEntity, 
+    std::string createSession(const std::string& playerName, entt::entity playerEntity,
                              const AbsolutePrecisePosition& position);
+    /**
+     * @brief Recreates a session under the token it was issued with, e.g. from a checkpoint, so its
+     * client carries on after a restart. It counts as refreshed now. False when the token is
+     * malformed or its slot is taken.
+     */
+    bool restoreSession(const std::string& sessionToken, const std::string& playerName, entt::entity playerEntity,
+                        const AbsolutePrecisePosition& position);
+    // The session a token names, when that session exists and hasn't timed out
+    std::optional<SessionHandle> resolve(const std::string& sessionToken) const;
     bool refreshSession(const std::string& sessionToken);
-    bool updatePlayerPosition(const std::string& sessionToken, const AbsolutePrecisePosition& position);
+    bool refreshSession(SessionHandle handle);
+    // Also refreshes the session; playerEntity, if given, receives the session's entity
+    bool updatePlayerPosition(const std::string& sessionToken, const AbsolutePrecisePosition& position, entt::entity* playerEntity = nullptr);
+    bool updatePlayerPosition(SessionHandle handle, const AbsolutePrecisePosition& position, entt::entity* playerEntity = nullptr);
     bool isValidSession(const std::string& sessionToken) const;
+    // A full copy, for tools and tests; the hot paths use getSessionState
     std::optional<PlayerSession> getSession(const std::string& sessionToken) const;
-    std::vector<std::string> removeExpiredSessions();
-    void removeSession(const std::string& sessionToken);
-    
+    std::optional<PlayerSessionState> getSessionState(SessionHandle handle) const;
+    // Ends sessions whose timers came due and that haven't been refreshed since
+    std::vector<ExpiredPlayerSession> removeExpiredSessions();
+    std::vector<ExpiredPlayerSession> removeExpiredSessions(std::chrono::steady_clock::time_point now);
+    // The ended session's entity, if the token named a session
+    std::optional<entt::entity> removeSession(const std::string& sessionToken);
+
     // Session queries
-    std::vector<PlayerSession> getAllActiveSessions() const;
+    // Calls f(const PlayerSession&) for each session that hasn't timed out, under its shard's lock
+    template<typename F>
+    void forEachActiveSession(F&& f) const {
+        const auto now = std::chrono::steady_clock::now();
+        for (const Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const Slot& slot : shard.slots) {
+                if (slot.session && now - slot.session->lastRefresh < timeout_) {
+                    f(*slot.session);
+                }
+            }
+        }
+    }
     size_t getActiveSessionCount() const;
-    
+
 private:
-    std::string generateSessionToken();
-    bool isValidSessionInternal(const std::string& sessionToken) const; // Internal helper without locking
-    
-    mutable std::mutex sessionsMutex_;
-    std::unordered_map<std::string, PlayerSession> activeSessions_;
-};
\ No newline at end of file
+    struct Slot {
+        // Starts at 1 so no handle is 0
+        uint32_t generation = 1;
+        uint64_t secret = 0;
+        std::optional<PlayerSession> session;
+    };
+    struct Shard {
+        mutable std::mutex mutex;
+        std::vector<Slot> slots;
+        std::vector<uint32_t> freeSlots;
+    };
+
+    // Runs f(PlayerSession&) under the shard lock when handle names a live, unexpired session whose
+    // secret matches (when one is given); false otherwise
+    template<typename F>
+    bool withSession(SessionHandle handle, std::optional<uint64_t> secret, F&& f) const;
+
+    const std::chrono::steady_clock::duration timeout_;
+    // Lookups from const methods still lock their shard
+    mutable std::array<Shard, SESSION_SHARDS> shards_;
+    std::atomic<uint32_t> nextShard_{0};
+
+    std::mutex expiryMutex_; // taken before any shard mutex, never after
+    TimerWheel<SessionHandle> expiry_;
+};
@@ -0,0 +1,352 @@
+#include "region_chunk_persistence.h"
+#include "chunk_arena.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char REGION_MAGIC[4] = {'B', 'T', 'R', 'G'};
+constexpr uint32_t REGION_FORMAT_VERSION = 1;
+
+struct RegionEntry {
+    uint32_t firstSector; // 0 = chunk not stored
+    uint32_t byteLength;
+};
+
+constexpr size_t REGION_TABLE_OFFSET = REGION_SECTOR_SIZE;
+constexpr size_t REGION_HEADER_SECTORS = 1 + (REGION_CHUNK_COUNT * sizeof(RegionEntry) + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE;
+// Files grow by at least this many sectors at a time so appends rarely remap
+constexpr size_t REGION_GROWTH_SECTORS = 256;
+
+size_t sectorsFor(size_t bytes) {
+    return std::max<size_t>(1, (bytes + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE);
+}
+
+size_t localIndex(const AbsoluteChunkPosition& chunk) {
+    const auto lx = static_cast<size_t>(floor_mod(chunk.x, REGION_SIZE_IN_CHUNKS));
+    const auto ly = static_cast<size_t>(floor_mod(chunk.y, REGION_SIZE_IN_CHUNKS));
+    const auto lz = static_cast<size_t>(floor_mod(chunk.z, REGION_SIZE_IN_CHUNKS));
+    return lx + ly * REGION_SIZE_IN_CHUNKS + lz * REGION_SIZE_IN_CHUNKS * REGION_SIZE_IN_CHUNKS;
+}
+
+} // namespace
+
+struct RegionFileChunkPersistence::Region {
+    int fd = -1;
+    uint8_t* map = nullptr;
+    size_t mappedBytes = 0;
+    // One flag per sector of the file; header sectors are always in use
+    std::vector<bool> usedSectors;
+    // Loads share the mapping; stores take it exclusively since growing remaps it
+    std::shared_mutex mutex;
+
+    ~Region() {
+        if (map) {
+            msync(map, mappedBytes, MS_SYNC);
+            munmap(map, mappedBytes);
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    RegionEntry entry(size_t index) const {
+        RegionEntry e;
+        std::memcpy(&e, map + REGION_TABLE_OFFSET + index * sizeof(RegionEntry), sizeof(RegionEntry));
+        return e;
+    }
+
+    void setEntry(size_t index, const RegionEntry& e) {
+        std::memcpy(map + REGION_TABLE_OFFSET + index * sizeof(RegionEntry), &e, sizeof(RegionEntry));
+    }
+
+    bool mapFile(size_t bytes) {
+        if (map) {
+            munmap(map, mappedBytes);
+            map = nullptr;
+        }
+        void* m = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED) {
+            std::cerr << "Failed to map region file: " << std::strerror(errno) << "\n";
+            mappedBytes = 0;
+            return false;
+        }
+        map = static_cast<uint8_t*>(m);
+        mappedBytes = bytes;
+        return true;
+    }
+
+    // Extends the file so at least sectorCount more sectors are free at its end
+    bool grow(size_t sectorCount) {
+        const size_t oldSectors = usedSectors.size();
+        const size_t newSectors = oldSectors + std::max(sectorCount, REGION_GROWTH_SECTORS);
+        // Reserved, not just sized: stores into a sparse file's holes raise SIGBUS when the disk is full
+        const off_t oldBytes = static_cast<off_t>(oldSectors * REGION_SECTOR_SIZE);
+        if (const int error = posix_fallocate(fd, oldBytes, static_cast<off_t>(newSectors * REGION_SECTOR_SIZE) - oldBytes); error != 0) {
+            std::cerr << "Failed to grow region file: " << std::strerror(error) << "\n";
+            return false;
+        }
+        if (!mapFile(newSectors * REGION_SECTOR_SIZE)) {
+            // Keep serving what is stored from the mapping as it was
+            mapFile(oldSectors * REGION_SECTOR_SIZE);
+            return false;
+        }
+        usedSectors.resize(newSectors, false);
+        return true;
+    }
+
+    size_t findFreeRun(size_t count) const {
+        size_t run = 0;
+        for (size_t s = REGION_HEADER_SECTORS; s < usedSectors.size(); ++s) {
+            run = usedSectors[s] ? 0 : run + 1;
+            if (run == count) return s + 1 - count;
+        }
+        return 0;
+    }
+
+    void markSectors(size_t first, size_t count, bool used) {
+        std::fill(usedSectors.begin() + first, usedSectors.begin() + first + count, used);
+    }
+
+    // The stored payload, or an empty span if absent; caller holds mutex
+    std::span<const uint8_t> payload(size_t index) const {
+        const RegionEntry e = entry(index);
+        if (e.firstSector == 0) return {};
+        if (size_t{e.firstSector} * REGION_SECTOR_SIZE + e.byteLength > mappedBytes) {
+            std::cerr << "Region entry " << index << " points past the end of the file\n";
+            return {};
+        }
+        return std::span<const uint8_t>(map + size_t{e.firstSector} * REGION_SECTOR_SIZE, e.byteLength);
+    }
+
+    std::optional<std::shared_ptr<ChunkSpan>> load(size_t index) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        const auto data = payload(index);
+        if (data.empty()) return std::nullopt;
+        try {
+            return makePooledChunk(data);
+        } catch (const std::exception& ex) {
+            std::cerr << "Failed to deserialize chunk: " << ex.what() << "\n";
+            return std::nullopt;
+        }
+    }
+
+    std::optional<ChunkSerializationSparseVector> loadSerialized(size_t index) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        const auto data = payload(index);
+        if (data.empty()) return std::nullopt;
+        return ChunkSerializationSparseVector(data.begin(), data.end());
+    }
+
+    // Caller holds mutex exclusively
+    bool store(size_t index, const ChunkSerializationSparseVector& data) {
+        const size_t needed = sectorsFor(data.size());
+        RegionEntry e = entry(index);
+        const size_t oldCount = e.firstSector ? sectorsFor(e.byteLength) : 0;
+
+        // The old run stays allocated until the entry no longer points at it, so a store that
+        // fails leaves the chunk as it was and its sectors out of other chunks' reach
+        size_t first = 0;
+        size_t releasedFirst = 0;
+        size_t releasedCount = 0;
+        if (e.firstSector != 0 && oldCount >= needed) {
+            // Still fits: rewrite in place and release any tail
+            first = e.firstSector;
+            releasedFirst = first + needed;
+            releasedCount = oldCount - needed;
+        } else {
+            first = findFreeRun(needed);
+            if (first == 0) {
+                if (!grow(needed)) return false;
+                first = findFreeRun(needed);
+                if (first == 0) return false;
+            }
+            markSectors(first, needed, true);
+            releasedFirst = e.firstSector;
+            releasedCount = oldCount;
+        }
+
+        std::memcpy(map + first * REGION_SECTOR_SIZE, data.data(), data.size());
+        // Publish the entry only once the payload is in place
+        e.firstSector = static_cast<uint32_t>(first);
+        e.byteLength = static_cast<uint32_t>(data.size());
+        setEntry(index, e);
+        markSectors(releasedFirst, releasedCount, false);
+        return true;
+    }
+};
+
+RegionFileChunkPersistence::RegionFileChunkPersistence(std::filesystem::path directory)
+    : directory_(std::move(directory)) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec) {
+        std::cerr << "Failed to create region directory " << directory_ << ": " << ec.message() << "\n";
+    }
+}
+
+RegionFileChunkPersistence::~RegionFileChunkPersistence() = default;
+
+AbsoluteChunkPosition RegionFileChunkPersistence::regionOf(const AbsoluteChunkPosition& chunk) {
+    return AbsoluteChunkPosition(
+        static_cast<int32_t>(floor_div(chunk.x, REGION_SIZE_IN_CHUNKS)),
+        static_cast<int32_t>(floor_div(chunk.y, REGION_SIZE_IN_CHUNKS)),
+        static_cast<int32_t>(floor_div(chunk.z, REGION_SIZE_IN_CHUNKS)));
+}
+
+std::filesystem::path RegionFileChunkPersistence::regionPath(const AbsoluteChunkPosition& region) const {
+    return directory_ / ("r." + std::to_string(region.x) + "." + std::to_string(region.y) + "." + std::to_string(region.z) + ".region");
+}
+
+std::unique_ptr<RegionFileChunkPersistence::Region> RegionFileChunkPersistence::openRegion(const AbsoluteChunkPosition& regionPos, bool create) const {
+    const std::filesystem::path path = regionPath(regionPos);
+    int fd = open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            std::cerr << "Failed to open region file " << path << ": " << std::strerror(errno) << "\n";
+        }
+        return nullptr;
+    }
+    auto region = std::make_unique<Region>();
+    region->fd = fd;
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        std::cerr << "Failed to stat region file " << path << ": " << std::strerror(errno) << "\n";
+        return nullptr;
+    }
+    size_t fileBytes = static_cast<size_t>(st.st_size);
+    if (fileBytes == 0) {
+        // Fresh file: zeroed header and entry table, then the magic
+        fileBytes = REGION_HEADER_SECTORS * REGION_SECTOR_SIZE;
+        if (posix_fallocate(fd, 0, static_cast<off_t>(fileBytes)) != 0 || !region->mapFile(fileBytes)) {
+            std::cerr << "Failed to initialize region file " << path << "\n";
+            return nullptr;
+        }
+        std::memcpy(region->map, REGION_MAGIC, sizeof(REGION_MAGIC));
+        std::memcpy(region->map + sizeof(REGION_MAGIC), &REGION_FORMAT_VERSION, sizeof(REGION_FORMAT_VERSION));
+    } else {
+        if (fileBytes < REGION_HEADER_SECTORS * REGION_SECTOR_SIZE || fileBytes % REGION_SECTOR_SIZE != 0 || !region->mapFile(fileBytes)) {
+            std::cerr << "Region file " << path << " is truncated or misaligned\n";
+            return nullptr;
+        }
+        uint32_t version = 0;
+        std::memcpy(&version, region->map + sizeof(REGION_MAGIC), sizeof(version));
+        if (std::memcmp(region->map, REGION_MAGIC, sizeof(REGION_MAGIC)) != 0 || version != REGION_FORMAT_VERSION) {
+            std::cerr << "Region file " << path << " has an unknown format\n";
+            return nullptr;
+        }
+    }
+
+    // Rebuild the sector allocation map from the entry table
+    const size_t sectorCount = fileBytes / REGION_SECTOR_SIZE;
+    region->usedSectors.assign(sectorCount, false);
+    region->markSectors(0, REGION_HEADER_SECTORS, true);
+    for (size_t i = 0; i < REGION_CHUNK_COUNT; ++i) {
+        RegionEntry e = region->entry(i);
+        if (e.firstSector == 0) continue;
+        const size_t count = sectorsFor(e.byteLength);
+        if (e.firstSector < REGION_HEADER_SECTORS || e.firstSector + count > sectorCount) {
+            std::cerr << "Dropping corrupt region entry " << i << " in " << path << "\n";
+            region->setEntry(i, RegionEntry{0, 0});
+            continue;
+        }
+        region->markSectors(e.firstSector, count, true);
+    }
+    return region;
+}
+
+RegionFileChunkPersistence::Region* RegionFileChunkPersistence::region(const AbsoluteChunkPosition& regionPos, bool create) {
+    std::lock_guard<std::mutex> lock(regionsMutex_);
+    auto it = regions_.find(regionPos);
+    if (it != regions_.end() && (it->second || !create)) {
+        return it->second.get();
+    }
+    auto opened = openRegion(regionPos, create);
+    Region* result = opened.get();
+    regions_.insert_or_assign(regionPos, std::move(opened));
+    return result;
+}
+
+std::optional<std::shared_ptr<ChunkSpan>> RegionFileChunkPersistence::loadChunk(const AbsoluteChunkPosition& pos) {
+    Region* r = region(regionOf(pos), false);
+    if (!r) return std::nullopt;
+    return r->load(localIndex(pos));
+}
+
+std::vector<std::optional<ChunkSerializationSparseVector>> RegionFileChunkPersistence::loadSerializedChunks(std::span<const AbsoluteChunkPosition> positions) {
+    std::vector<std::optional<ChunkSerializationSparseVector>> result(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i) {
+        if (Region* r = region(regionOf(positions[i]), false)) {
+            result[i] = r->loadSerialized(localIndex(positions[i]));
+        }
+    }
+    return result;
+}
+
+bool RegionFileChunkPersistence::saveChunk(const ChunkSpan& chunk) {
+    Region* r = region(regionOf(chunk.position), true);
+    if (!r) return false;
+    auto data = chunk.serialize();
+    std::unique_lock<std::shared_mutex> lock(r->mutex);
+    return r->store(localIndex(chunk.position), data);
+}
+
+bool RegionFileChunkPersistence::saveChunks(const std::vector<std::shared_ptr<const ChunkSpan>>& chunks) {
+    // Group by region and serialize outside the locks, then take each region's lock once
+    ChunkPosMap<std::vector<const ChunkSpan*>> byRegion;
+    for (const auto& chunk : chunks) {
+        if (chunk) byRegion[regionOf(chunk->position)].push_back(chunk.get());
+    }
+
+    bool success = true;
+    for (const auto& [regionPos, regionChunks] : byRegion) {
+        Region* r = region(regionPos, true);
+        if (!r) {
+            success = false;
+            continue;
+        }
+        std::vector<ChunkSerializationSparseVector> payloads;
+        payloads.reserve(regionChunks.size());
+        for (const ChunkSpan* chunk : regionChunks) {
+            payloads.push_back(chunk->serialize());
+        }
+        std::unique_lock<std::shared_mutex> lock(r->mutex);
+        for (size_t i = 0; i < regionChunks.size(); ++i) {
+            success = r->store(localIndex(regionChunks[i]->position), payloads[i]) && success;
+        }
+    }
+    return success;
+}
+
+void RegionFileChunkPersistence::saveAllLoadedChunks(const ChunkMap& chunks) {
+    std::vector<std::shared_ptr<const ChunkSpan>> batch;
+    batch.reserve(chunks.size());
+    for (const auto& [pos, chunk] : chunks) {
+        if (chunk) batch.push_back(chunk);
+    }
+    saveChunks(batch);
+    flush();
+}
+
+bool RegionFileChunkPersistence::flush() {
+    std::lock_guard<std::mutex> lock(regionsMutex_);
+    bool success = true;
+    for (auto& [regionPos, r] : regions_) {
+        if (!r || !r->map) continue;
+        std::shared_lock<std::shared_mutex> regionLock(r->mutex);
+        if (msync(r->map, r->mappedBytes, MS_SYNC) != 0) {
+            std::cerr << "Failed to sync region file: " << std::strerror(errno) << "\n";
+            success = false;
+        }
+    }
+    return success;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "world.h"
+#include "chunkspan.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+
+// Chunks per region file along each axis
+constexpr int32_t REGION_SIZE_IN_CHUNKS = 32;
+constexpr size_t REGION_CHUNK_COUNT = size_t{REGION_SIZE_IN_CHUNKS} * REGION_SIZE_IN_CHUNKS * REGION_SIZE_IN_CHUNKS;
+// Payloads are stored in whole sectors
+constexpr size_t REGION_SECTOR_SIZE = 4096;
+
+/**
+ * @brief Stores chunks in memory-mapped region files of 32x32x32 chunks each.
+ *
+ * File layout (all integers little-endian):
+ * - sector 0: magic "BTRG" and a uint32 format version
+ * - the next REGION_CHUNK_COUNT * 8 bytes: one {uint32 first sector, uint32 byte length} entry per chunk,
+ *   indexed x + y * 32 + z * 32 * 32 by region-local position; a first sector of 0 means absent
+ * - after that: sector-aligned ChunkSpan::serialize() payloads
+ *
+ * Loads deserialize straight out of the mapping without copying the payload. A rewritten chunk
+ * stays in place when it still fits its sectors, otherwise it moves to the first free run, and
+ * the file grows when there is none.
+ */
+class RegionFileChunkPersistence : public IChunkPersistence {
+public:
+    // Creates the directory if needed; region files are created on first save
+    explicit RegionFileChunkPersistence(std::filesystem::path directory);
+    // Syncs and unmaps all open regions
+    ~RegionFileChunkPersistence() override;
+    RegionFileChunkPersistence(const RegionFileChunkPersistence&) = delete;
+    RegionFileChunkPersistence& operator=(const RegionFileChunkPersistence&) = delete;
+
+    bool saveChunk(const ChunkSpan& chunk) override;
+    std::optional<std::shared_ptr<ChunkSpan>> loadChunk(const AbsoluteChunkPosition& pos) override;
+    // Payloads copied out of the mappings, for decoding off the caller's region locks
+    std::vector<std::optional<ChunkSerializationSparseVector>> loadSerializedChunks(std::span<const AbsoluteChunkPosition> positions) override;
+    void saveAllLoadedChunks(const ChunkMap& chunks) override;
+    bool saveChunks(const std::vector<std::shared_ptr<const ChunkSpan>>& chunks) override;
+
+    // Blocks until every mapped region has been written back to disk
+    bool flush();
+
+    static AbsoluteChunkPosition regionOf(const AbsoluteChunkPosition& chunk);
+    std::filesystem::path regionPath(const AbsoluteChunkPosition& region) const;
+
+private:
+    struct Region;
+
+    // Returns the open region, opening (and creating, if asked) its file on first use; null if absent
+    Region* region(const AbsoluteChunkPosition& regionPos, bool create);
+    std::unique_ptr<Region> openRegion(const AbsoluteChunkPosition& regionPos, bool create) const;
+
+    std::filesystem::path directory_;
+    std::mutex regionsMutex_;
+    // A null entry caches that the region file does not exist yet
+    ChunkPosMap<std::unique_ptr<Region>> regions_;
+};
@@ -0,0 +1,116 @@
+#include "rpc_dispatcher.h"
+
+#include <algorithm>
+
+RpcDispatcher::RpcDispatcher(size_t workerThreads, size_t maxQueued)
+    : maxQueued_(std::max<size_t>(maxQueued, 1)) {
+    workerThreads = std::max<size_t>(workerThreads, 1);
+    workers_.reserve(workerThreads);
+    for (size_t i = 0; i < workerThreads; ++i) {
+        workers_.emplace_back(&RpcDispatcher::workerLoop, this);
+    }
+}
+
+RpcDispatcher::~RpcDispatcher() {
+    stop();
+}
+
+bool RpcDispatcher::submit(RpcPriority priority, Task run, Task shed) {
+    const size_t level = static_cast<size_t>(priority);
+    Task dropped;
+    bool accepted = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            dropped = std::move(shed);
+            accepted = false;
+        } else {
+            if (queuedCount_ >= maxQueued_) {
+                // Make room by dropping the longest-waiting task of the lowest priority below this one
+                size_t victim = RPC_PRIORITY_COUNT;
+                for (size_t l = RPC_PRIORITY_COUNT; l-- > level + 1;) {
+                    if (!queues_[l].empty()) {
+                        victim = l;
+                        break;
+                    }
+                }
+                if (victim == RPC_PRIORITY_COUNT) {
+                    dropped = std::move(shed);
+                    accepted = false;
+                } else {
+                    dropped = std::move(queues_[victim].front().shed);
+                    queues_[victim].pop_front();
+                    --queuedCount_;
+                }
+            }
+            if (accepted) {
+                queues_[level].push_back(Entry{std::move(run), std::move(shed)});
+                ++queuedCount_;
+            }
+        }
+    }
+    if (accepted) {
+        available_.notify_one();
+    }
+    if (dropped) {
+        shed_.fetch_add(1, std::memory_order_relaxed);
+        dropped();
+    }
+    return accepted;
+}
+
+void RpcDispatcher::stop() {
+    std::vector<Task> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ && workers_.empty()) {
+            return;
+        }
+        stopping_ = true;
+        for (auto& queue : queues_) {
+            for (auto& entry : queue) {
+                dropped.push_back(std::move(entry.shed));
+            }
+            queue.clear();
+        }
+        queuedCount_ = 0;
+    }
+    available_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
+    shed_.fetch_add(dropped.size(), std::memory_order_relaxed);
+    for (auto& task : dropped) {
+        if (task) task();
+    }
+}
+
+size_t RpcDispatcher::queued() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queuedCount_;
+}
+
+void RpcDispatcher::workerLoop() {
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            available_.wait(lock, [this] { return stopping_ || queuedCount_ > 0; });
+            if (stopping_) {
+                return;
+            }
+            for (auto& queue : queues_) {
+                if (!queue.empty()) {
+                    task = std::move(queue.front().run);
+                    queue.pop_front();
+                    --queuedCount_;
+                    break;
+                }
+            }
+        }
+        if (task) task();
+    }
+}
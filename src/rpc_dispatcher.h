@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Scheduling class of an RPC; lower values are served first
+enum class RpcPriority : std::uint8_t {
+    High,   // cheap session and liveness calls (Ping, RefreshSession, ...)
+    Normal, // single-block reads and edits
+    Low     // chunk transfers
+};
+
+constexpr size_t RPC_PRIORITY_COUNT = 3;
+
+/**
+ * @brief Bounded, prioritized work queue drained by a fixed set of worker threads, used to run
+ * async-mode RPC handlers.
+ *
+ * Each task comes with a shed callback that runs instead of it if the task is dropped: when the
+ * queue is full, a new task displaces the oldest queued task of a lower priority, or is itself
+ * shed if there is none, so overload sheds chunk transfers before it delays session calls. Shed
+ * callbacks run on the submitting (or stopping) thread, outside the queue lock.
+ */
+class RpcDispatcher {
+public:
+    using Task = std::function<void()>;
+
+    RpcDispatcher(size_t workerThreads, size_t maxQueued);
+    // Calls stop()
+    ~RpcDispatcher();
+    RpcDispatcher(const RpcDispatcher&) = delete;
+    RpcDispatcher& operator=(const RpcDispatcher&) = delete;
+
+    // Queues run, or calls shed if the queue is full of work of the same or higher priority.
+    // Returns false if shed was called.
+    bool submit(RpcPriority priority, Task run, Task shed);
+
+    // Lets running tasks finish, sheds whatever is still queued and joins the workers
+    void stop();
+
+    size_t workerCount() const { return workers_.size(); }
+    size_t queued() const;
+    size_t shedCount() const { return shed_.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry {
+        Task run;
+        Task shed;
+    };
+
+    void workerLoop();
+
+    const size_t maxQueued_;
+    mutable std::mutex mutex_;
+    std::condition_variable available_;
+    std::array<std::deque<Entry>, RPC_PRIORITY_COUNT> queues_;
+    size_t queuedCount_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> shed_{0};
+};
@@ -1,21 +1,112 @@
 #include "server.h"
+#include "server_async.h"
 #include "chunkdims.h"
-#include <iostream>
+#include "log.h"
+#include "metrics.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstdlib>
 #include <stdexcept>
 #include <thread>
 #include <grpcpp/grpcpp.h>
 
-Server::Server(uint16_t port, std::shared_ptr<World> world)
-    : world_(world), port_(port), running_(false) {
+namespace {
+// How often an idle subscription re-reads its session's position and checks for shutdown
+constexpr auto SUBSCRIPTION_POLL_INTERVAL = std::chrono::milliseconds(100);
+// Largest GetChunks batch served; bounds the size of one response
+constexpr int MAX_CHUNKS_PER_REQUEST = 1024;
+// Largest GetLodChunks batch served
+constexpr int MAX_LOD_CHUNKS_PER_REQUEST = 256;
+// LOD chunks further than a ring (plus one, for a requester that moved meanwhile) from the
+// requester's LOD chunk go unanswered
+constexpr int32_t LOD_REQUEST_HORIZONTAL_REACH = CHUNK_LOD_RING_RADIUS + 1;
+constexpr int32_t LOD_REQUEST_VERTICAL_REACH = 2;
+// Largest PlaceBlocks batch applied
+constexpr int MAX_BLOCK_EDITS_PER_REQUEST = 4096;
+// Server tick rate; coalesced PlayerStream samples are applied once per tick
+constexpr auto SERVER_TICK_INTERVAL = std::chrono::milliseconds(50);
+// Default phase budgets; together they fill the tick
+constexpr auto SERVER_TICK_INPUT_BUDGET = std::chrono::milliseconds(5);
+constexpr auto SERVER_TICK_RESIDENCY_BUDGET = std::chrono::milliseconds(5);
+constexpr auto SERVER_TICK_GENERATION_BUDGET = std::chrono::milliseconds(25);
+constexpr auto SERVER_TICK_PERSISTENCE_BUDGET = std::chrono::milliseconds(5);
+constexpr auto SERVER_TICK_ENTITIES_BUDGET = std::chrono::milliseconds(5);
+// How often an autosave sweep of edited chunks starts
+constexpr auto SERVER_AUTOSAVE_INTERVAL = std::chrono::seconds(30);
+// Longest a sync-mode GetChunk(s) waits for demand loads before answering pending
+constexpr auto DEMAND_LOAD_WAIT = std::chrono::seconds(2);
+// How often sessions and idle GetUpdatedChunks pollers are checked for expiry
+constexpr auto SESSION_EXPIRY_INTERVAL = std::chrono::seconds(1);
+// Least time between acks on one PlayerStream
+constexpr auto PLAYER_STREAM_ACK_INTERVAL = std::chrono::milliseconds(250);
+// Largest entity view radius honoured, in chunks
+constexpr int32_t MAX_ENTITY_VIEW_RADIUS = 32;
+// Largest GetUpdatedChunks render distance honoured, in chunks
+constexpr int32_t MAX_UPDATED_CHUNKS_RENDER_DISTANCE = 32;
+// A GetUpdatedChunks poller that stays quiet this long stops being tracked
+constexpr auto UPDATED_CHUNKS_POLLER_IDLE = std::chrono::seconds(60);
+
+MetricGauge& rpcInFlight() {
+    static MetricGauge& gauge = metricGauge("blocktest_rpc_in_flight", "RPC handlers running");
+    return gauge;
+}
+
+MetricCounter& chunkBytesSent() {
+    static MetricCounter& counter = metricCounter("blocktest_chunk_bytes_sent_total", "Serialized chunk bytes put in GetChunk(s) responses");
+    return counter;
+}
+
+// Latency histogram of one method, registered on its first call
+struct RpcMethodMetrics {
+    explicit RpcMethodMetrics(const char* method)
+        : name(method),
+          latency(metricHistogram("blocktest_rpc_duration_seconds", "Time spent in an RPC handler", {{"method", method}})) {}
+    const char* name;
+    MetricHistogram& latency;
+};
+
+// Times one unary handler call, traces it and counts it as in flight meanwhile
+class RpcCallScope {
+public:
+    explicit RpcCallScope(const RpcMethodMetrics& method) : span_(method.name), timer_(method.latency) { rpcInFlight().add(1); }
+    ~RpcCallScope() { rpcInFlight().add(-1); }
+
+private:
+    TraceSpan span_;
+    ScopedMetricTimer timer_;
+};
+
+MetricSnapshot serverGauge(const char* name, const char* help, double value, MetricKind kind = MetricKind::Gauge) {
+    MetricSnapshot metric;
+    metric.name = name;
+    metric.help = help;
+    metric.kind = kind;
+    metric.value = value;
+    return metric;
+}
+}
+
+Server::Server(uint16_t port, std::shared_ptr<World> world, ServerMode mode, AsyncServerOptions asyncOptions)
+    : world_(world), port_(port), running_(false), mode_(mode), asyncOptions_(asyncOptions),
+      lodChunks_([this](const AbsoluteChunkPosition& pos) { return world_ ? world_->chunkAt(pos).value_or(nullptr) : nullptr; },
+                 [this](const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max) {
+                     return world_ && world_->chunksLoadedIn(min, max);
+                 },
+                 [this](int64_t worldX, int64_t worldZ) { return world_ ? world_->surfaceAt(worldX, worldZ) : std::nullopt; }) {
+    watchEntities();
+    addTickPhases();
 }
 
 Server::~Server() {
     stop();
+    if (world_) {
+        world_->setEntityUpdatedCallback(nullptr);
+    }
 }
 
 bool Server::start() {
     if (running_) {
-        std::cerr << "Server is already running" << std::endl;
+        LOG_ERROR("Server is already running");
         return false;
     }
     
@@ -24,24 +115,32 @@ bool Server::start() {
         
         grpc::ServerBuilder builder;
         builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
-        builder.RegisterService(this);
+        if (mode_ == ServerMode::Async) {
+            registerAsyncService(builder);
+        } else {
+            builder.RegisterService(this);
+        }
         
         grpcServer_ = builder.BuildAndStart();
         if (!grpcServer_) {
-            std::cerr << "Failed to start gRPC server" << std::endl;
+            LOG_ERROR("Failed to start gRPC server");
+            stopAsyncCalls();
             return false;
         }
+        if (mode_ == ServerMode::Async) {
+            startAsyncCalls();
+        }
         
         running_ = true;
-        std::cout << "Server started on " << server_address << std::endl;
+        stopSubscriptions_ = false;
+        LOG_INFO("Server started on " << server_address);
         
-        // Start session cleanup thread
-        shouldStopCleanup_ = false;
-        cleanupThread_ = std::make_unique<std::thread>(&Server::sessionCleanupLoop, this);
+        stopTick_ = false;
+        tickThread_ = std::make_unique<std::thread>(&Server::tickLoop, this);
         
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Failed to start server: " << e.what() << std::endl;
+        LOG_ERROR("Failed to start server: " << e.what());
         running_ = false;
         return false;
     }
@@ -52,30 +151,91 @@ void Server::stop() {
         return;
     }
     
-    std::cout << "Stopping server..." << std::endl;
+    LOG_INFO("Stopping server...");
     running_ = false;
     
-    // Stop session cleanup thread
-    shouldStopCleanup_ = true;
-    if (cleanupThread_ && cleanupThread_->joinable()) {
-        cleanupThread_->join();
+    // Player streams block in Read until the client sends or the call is cancelled
+    stopTick_ = true;
+    if (tickThread_ && tickThread_->joinable()) {
+        tickThread_->join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(playerStreamsMutex_);
+        for (const auto& slot : playerStreams_) {
+            slot->context->TryCancel();
+        }
     }
     
+    // End open subscription streams, otherwise Shutdown waits on them forever
+    stopSubscriptions_ = true;
+    {
+        std::lock_guard<std::mutex> lock(subscribersMutex_);
+        for (const auto& subscriber : subscribers_) {
+            subscriber->wake.notify_all();
+        }
+    }
+
+    // Async calls stop re-arming before Shutdown cancels the ones waiting for a client
+    acceptingCalls_ = false;
     if (grpcServer_) {
         grpcServer_->Shutdown();
+        stopAsyncCalls();
         grpcServer_.reset();
     }
     
-    std::cout << "Server stopped" << std::endl;
+    LOG_INFO("Server stopped");
 }
 
 bool Server::isRunning() const {
     return running_;
 }
 
+size_t Server::getShedCallCount() const {
+    return dispatcher_ ? dispatcher_->shedCount() : 0;
+}
+
+std::vector<MetricSnapshot> Server::getMetrics() const {
+    std::vector<MetricSnapshot> metrics = MetricsRegistry::global().snapshot();
+    metrics.push_back(serverGauge("blocktest_rpc_shed_total", "Async calls shed under overload", static_cast<double>(getShedCallCount()), MetricKind::Counter));
+    metrics.push_back(serverGauge("blocktest_rpc_queue_depth", "Async calls waiting for a dispatcher worker",
+                                  static_cast<double>(dispatcher_ ? dispatcher_->queued() : 0)));
+    {
+        std::lock_guard<std::mutex> lock(subscribersMutex_);
+        metrics.push_back(serverGauge("blocktest_chunk_subscriptions", "Open SubscribeChunks streams", static_cast<double>(subscribers_.size())));
+    }
+    {
+        std::lock_guard<std::mutex> lock(playerStreamsMutex_);
+        metrics.push_back(serverGauge("blocktest_player_streams", "Open PlayerStreams", static_cast<double>(playerStreams_.size())));
+    }
+    // Keeps each name's label sets together, as formatPrometheusText needs
+    std::stable_sort(metrics.begin(), metrics.end(), [](const MetricSnapshot& a, const MetricSnapshot& b) { return a.name < b.name; });
+    return metrics;
+}
+
 
 void Server::setWorld(std::shared_ptr<World> world) {
+    if (world_) {
+        world_->setEntityUpdatedCallback(nullptr);
+    }
     world_ = world;
+    watchEntities();
+}
+
+void Server::watchEntities() {
+    if (!world_) {
+        return;
+    }
+    // Only mark the entity; its state is read back when a client next asks for entity updates
+    world_->setEntityUpdatedCallback([this](entt::entity entity, const entt::registry&) {
+        entityTracker_.markDirty(entity);
+    });
+    // Entities spawned before the server attached
+    world_->readEntities([this](const entt::registry& registry) {
+        for (auto entity : registry.view<AbsolutePrecisePosition>()) {
+            entityTracker_.markDirty(entity);
+        }
+        entityTracker_.refresh(registry);
+    });
 }
 
 std::shared_ptr<World> Server::getWorld() const {
@@ -90,46 +250,218 @@ std::string Server::getServerInfo() const {
     return "Minecraft-like Game Server v1.0 on port " + std::to_string(port_);
 }
 
+std::string Server::getWorldId() const {
+    return world_ ? "seed-" + std::to_string(world_->getSeed()) : "";
+}
+
 // gRPC service implementations
 grpc::Status Server::GetChunk(grpc::ServerContext* context,
                              const blockserver::ChunkRequest* request,
                              blockserver::ChunkResponse* response) {
-    std::cout << "[gRPC] GetChunk request: (" << request->x() << ", " << request->y() << ", " << request->z() << ")";
-    if (request->has_player_position()) {
-        std::cout << " from player: " << request->player_position().player_id();
-    }
-    std::cout << std::endl;
+    static const RpcMethodMetrics rpcMetrics("GetChunk");
+    RpcCallScope rpcCall(rpcMetrics);
+    LOG_DEBUG("[gRPC] GetChunk request: (" << request->x() << ", " << request->y() << ", " << request->z() << ")"
+              << (request->has_player_position() ? " from player: " + request->player_position().player_id() : ""));
     
     if (!world_) {
-        std::cerr << "No world instance available" << std::endl;
+        LOG_ERROR("No world instance available");
         response->set_success(false);
         response->set_error_message("No world instance available");
         return grpc::Status::OK;
     }
     
     AbsoluteChunkPosition pos{request->x(), request->y(), request->z()};
-    auto chunkOpt = world_->chunkAt(pos);
+    std::shared_ptr<const ChunkSpan> chunk = world_->chunkAt(pos).value_or(nullptr);
     
-    if (!chunkOpt) {
-        std::clog << "Chunk not found at (" << request->x() << ", " << request->y() << ", " << request->z() << ")" << std::endl;
-        //still succeed, just no chunk data. ok because it's an optional field now
-        response->set_success(true);
+    if (!chunk) {
+        auto center = demandLoadCenter(request->session_token());
+        if (!center || !chunkInRange(pos, *center, DEMAND_LOAD_RADIUS)) {
+            LOG_DEBUG("Chunk not found at (" << request->x() << ", " << request->y() << ", " << request->z() << ")");
+            //still succeed, just no chunk data. ok because it's an optional field now
+            response->set_success(true);
+            return grpc::Status::OK;
+        }
+        std::vector<std::shared_future<std::shared_ptr<const ChunkSpan>>> loads{world_->requestChunkLoad(pos)};
+        chunk = awaitDemandLoads(loads, context).front();
+        if (!chunk) {
+            response->set_success(true);
+            response->set_pending(true);
+            return grpc::Status::OK;
+        }
+    }
+    
+    auto encoded = encodedChunks_.get(*chunk);
+    response->set_success(true);
+    response->set_version(encoded->version);
+    response->set_content_hash(encoded->contentHash);
+    if (clientCopyCurrent(*encoded, request->known_version(), request->known_hash())) {
+        response->set_not_modified(true);
+        LOG_DEBUG("[gRPC] GetChunk response for (" << request->x() << ", " << request->y() << ", " << request->z()
+                  << ") not modified");
         return grpc::Status::OK;
     }
     
-    auto chunkData = serializeChunk(**chunkOpt);
+    response->set_chunk_data(encoded->bytes);
+    chunkBytesSent().add(encoded->bytes.size());
+    
+    LOG_DEBUG("[gRPC] GetChunk response for (" << request->x() << ", " << request->y() << ", " << request->z()
+              << ") size: " << encoded->bytes.size() << " bytes");
+    
+    return grpc::Status::OK;
+}
+
+grpc::Status Server::GetChunks(grpc::ServerContext* context,
+                              const blockserver::ChunksRequest* request,
+                              blockserver::ChunksResponse* response) {
+    static const RpcMethodMetrics rpcMetrics("GetChunks");
+    RpcCallScope rpcCall(rpcMetrics);
+    if (!world_) {
+        LOG_ERROR("No world instance available");
+        response->set_success(false);
+        response->set_error_message("No world instance available");
+        return grpc::Status::OK;
+    }
+    if (request->positions_size() > MAX_CHUNKS_PER_REQUEST) {
+        response->set_success(false);
+        response->set_error_message("Too many chunks requested (max " + std::to_string(MAX_CHUNKS_PER_REQUEST) + ")");
+        return grpc::Status::OK;
+    }
+    
+    // Misses near the session's player are loaded on demand, all in one wait
+    std::vector<std::shared_ptr<const ChunkSpan>> chunks(request->positions_size());
+    std::vector<int> demandedIndices;
+    std::vector<std::shared_future<std::shared_ptr<const ChunkSpan>>> loads;
+    auto center = demandLoadCenter(request->session_token());
+    for (int i = 0; i < request->positions_size(); ++i) {
+        const auto& requested = request->positions(i);
+        AbsoluteChunkPosition pos{requested.x(), requested.y(), requested.z()};
+        chunks[i] = world_->chunkAt(pos).value_or(nullptr);
+        if (chunks[i]) {
+            continue;
+        }
+        if (center && chunkInRange(pos, *center, DEMAND_LOAD_RADIUS)) {
+            demandedIndices.push_back(i);
+            loads.push_back(world_->requestChunkLoad(pos));
+        }
+    }
+    std::vector<char> pending(chunks.size(), 0);
+    if (!loads.empty()) {
+        auto loaded = awaitDemandLoads(loads, context);
+        for (size_t j = 0; j < demandedIndices.size(); ++j) {
+            chunks[demandedIndices[j]] = loaded[j];
+            pending[demandedIndices[j]] = loaded[j] ? 0 : 1;
+        }
+    }
+    
+    size_t bytes = 0;
+    size_t notModified = 0;
+    response->mutable_chunks()->Reserve(request->positions_size());
+    for (int i = 0; i < request->positions_size(); ++i) {
+        const auto& requested = request->positions(i);
+        auto* entry = response->add_chunks();
+        *entry->mutable_position() = requested;
+        if (!chunks[i]) {
+            entry->set_pending(pending[i] != 0);
+            continue;
+        }
+        auto encoded = encodedChunks_.get(*chunks[i]);
+        entry->set_version(encoded->version);
+        entry->set_content_hash(encoded->contentHash);
+        uint64_t knownVersion = i < request->known_versions_size() ? request->known_versions(i) : 0;
+        uint64_t knownHash = i < request->known_hashes_size() ? request->known_hashes(i) : 0;
+        if (clientCopyCurrent(*encoded, knownVersion, knownHash)) {
+            entry->set_not_modified(true);
+            ++notModified;
+            continue;
+        }
+        entry->set_chunk_data(encoded->bytes);
+        bytes += encoded->bytes.size();
+    }
     response->set_success(true);
-    response->set_chunk_data(chunkData.data(), chunkData.size());
+    chunkBytesSent().add(bytes);
     
-    std::cout << "[gRPC] GetChunk response for (" << request->x() << ", " << request->y() << ", " << request->z()
-              << ") size: " << chunkData.size() << " bytes" << std::endl;
+    LOG_DEBUG("[gRPC] GetChunks response: " << request->positions_size() << " chunks (" << notModified << " not modified), " << bytes << " bytes"
+              << (request->has_player_position() ? " to player: " + request->player_position().player_id() : ""));
     
     return grpc::Status::OK;
 }
 
+grpc::Status Server::GetLodChunks(grpc::ServerContext* context,
+                                 const blockserver::LodChunksRequest* request,
+                                 blockserver::LodChunksResponse* response) {
+    static const RpcMethodMetrics rpcMetrics("GetLodChunks");
+    RpcCallScope rpcCall(rpcMetrics);
+    if (!world_) {
+        LOG_ERROR("No world instance available");
+        response->set_success(false);
+        response->set_error_message("No world instance available");
+        return grpc::Status::OK;
+    }
+    if (request->level() < 1 || request->level() > CHUNK_LOD_LEVELS) {
+        response->set_success(false);
+        response->set_error_message("LOD level must be 1.." + std::to_string(CHUNK_LOD_LEVELS));
+        return grpc::Status::OK;
+    }
+    if (request->positions_size() > MAX_LOD_CHUNKS_PER_REQUEST) {
+        response->set_success(false);
+        response->set_error_message("Too many LOD chunks requested (max " + std::to_string(MAX_LOD_CHUNKS_PER_REQUEST) + ")");
+        return grpc::Status::OK;
+    }
+
+    // The session's player if there is one; a requester without must say where it is
+    auto requester = demandLoadCenter(request->session_token());
+    if (!requester && request->has_player_position()) {
+        const auto& playerPos = request->player_position();
+        requester = toAbsoluteChunk(AbsoluteBlockPosition{playerPos.x(), playerPos.y(), playerPos.z()});
+    }
+    if (!requester) {
+        response->set_success(false);
+        response->set_error_message("Player position or session token required");
+        return grpc::Status::OK;
+    }
+    const AbsoluteChunkPosition center = lodPosition(*requester, request->level());
+
+    size_t bytes = 0;
+    size_t notModified = 0;
+    size_t outOfReach = 0;
+    response->mutable_chunks()->Reserve(request->positions_size());
+    for (int i = 0; i < request->positions_size(); ++i) {
+        const auto& requested = request->positions(i);
+        auto* entry = response->add_chunks();
+        *entry->mutable_position() = requested;
+        // Left without data, like a chunk that isn't loaded
+        if (std::abs(int64_t{requested.x()} - center.x) > LOD_REQUEST_HORIZONTAL_REACH ||
+            std::abs(int64_t{requested.z()} - center.z) > LOD_REQUEST_HORIZONTAL_REACH ||
+            std::abs(int64_t{requested.y()} - center.y) > LOD_REQUEST_VERTICAL_REACH) {
+            ++outOfReach;
+            continue;
+        }
+        auto lod = lodChunks_.get(request->level(), AbsoluteChunkPosition{requested.x(), requested.y(), requested.z()});
+        entry->set_version(lod->version);
+        entry->set_content_hash(lod->version);
+        uint64_t knownVersion = i < request->known_versions_size() ? request->known_versions(i) : 0;
+        if (knownVersion == lod->version) {
+            entry->set_not_modified(true);
+            ++notModified;
+            continue;
+        }
+        entry->set_chunk_data(lod->bytes);
+        bytes += lod->bytes.size();
+    }
+    response->set_success(true);
+    chunkBytesSent().add(bytes);
+
+    LOG_DEBUG("[gRPC] GetLodChunks response: level " << request->level() << ", " << request->positions_size() << " chunks ("
+              << notModified << " not modified, " << outOfReach << " out of reach), " << bytes << " bytes");
+
+    return grpc::Status::OK;
+}
+
 grpc::Status Server::GetUpdatedChunks(grpc::ServerContext* context,
                                      const blockserver::UpdatedChunksRequest* request,
                                      blockserver::UpdatedChunksResponse* response) {
+    static const RpcMethodMetrics rpcMetrics("GetUpdatedChunks");
+    RpcCallScope rpcCall(rpcMetrics);
     if (!request->has_player_position()) {
         response->set_success(false);
         response->set_error_message("Player position required");
@@ -138,13 +470,13 @@ grpc::Status Server::GetUpdatedChunks(grpc::ServerContext* context,
     
     const auto& playerPos = request->player_position();
     AbsoluteBlockPosition blockPos{playerPos.x(), playerPos.y(), playerPos.z()};
-    int32_t renderDistance = request->render_distance();
+    int32_t renderDistance = std::min(request->render_distance(), MAX_UPDATED_CHUNKS_RENDER_DISTANCE);
     
-    std::cout << "[gRPC] GetUpdatedChunks request from player: " << playerPos.player_id() 
+    LOG_DEBUG("[gRPC] GetUpdatedChunks request from player: " << playerPos.player_id() 
               << " at (" << playerPos.x() << ", " << playerPos.y() << ", " << playerPos.z() << ")"
-              << " render distance: " << renderDistance << std::endl;
+              << " render distance: " << renderDistance);
     
-    auto updatedChunks = getUpdatedChunksInRange(blockPos, renderDistance);
+    auto updatedChunks = getUpdatedChunksInRange(playerPos.player_id(), blockPos, renderDistance);
     
     response->set_success(true);
     for (const auto& chunkPos : updatedChunks) {
@@ -154,16 +486,125 @@ grpc::Status Server::GetUpdatedChunks(grpc::ServerContext* context,
         chunk->set_z(chunkPos.z);
     }
     
-    std::cout << "[gRPC] GetUpdatedChunks response: " << updatedChunks.size() << " updated chunks" << std::endl;
+    LOG_DEBUG("[gRPC] GetUpdatedChunks response: " << updatedChunks.size() << " updated chunks");
     
     return grpc::Status::OK;
 }
 
+grpc::Status Server::SubscribeChunks(grpc::ServerContext* context,
+                                    const blockserver::SubscribeChunksRequest* request,
+                                    grpc::ServerWriter<blockserver::ChunkUpdate>* writer) {
+    if (!world_) {
+        LOG_ERROR("No world instance available");
+        return grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, "No world instance available");
+    }
+    if (!request->has_player_position() && request->session_token().empty()) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Player position or session token required");
+    }
+    if (request->view_radius() < 0) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "View radius must not be negative");
+    }
+
+    auto subscriber = std::make_shared<ChunkSubscriber>();
+    const auto& playerPos = request->player_position();
+    subscriber->center = toAbsoluteChunk(AbsoluteBlockPosition{playerPos.x(), playerPos.y(), playerPos.z()});
+    subscriber->viewRadius = request->view_radius();
+    if (!request->session_token().empty()) {
+        subscriber->session = world_->resolvePlayerSession(request->session_token());
+    }
+    {
+        std::lock_guard<std::mutex> lock(subscribersMutex_);
+        subscribers_.push_back(subscriber);
+    }
+
+    LOG_INFO("[gRPC] SubscribeChunks from player: " << playerPos.player_id()
+             << " view radius: " << subscriber->viewRadius);
+
+    std::vector<std::pair<AbsoluteChunkPosition, std::optional<uint64_t>>> batch;
+    while (!stopSubscriptions_ && !context->IsCancelled()) {
+        // Follow the session's player as it moves
+        if (subscriber->session) {
+            auto session = world_->getPlayerSessionState(*subscriber->session);
+            if (session) {
+                AbsoluteChunkPosition center = toAbsoluteChunk(toAbsoluteBlock(session->position));
+                std::lock_guard<std::mutex> lock(subscriber->mutex);
+                subscriber->center = center;
+            }
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(subscriber->mutex);
+            subscriber->wake.wait_for(lock, SUBSCRIPTION_POLL_INTERVAL, [&]() {
+                return !subscriber->order.empty() || stopSubscriptions_;
+            });
+            batch.clear();
+            for (const auto& chunkPos : subscriber->order) {
+                batch.emplace_back(chunkPos, subscriber->pending.at(chunkPos));
+            }
+            subscriber->order.clear();
+            subscriber->pending.clear();
+        }
+
+        bool open = true;
+        for (const auto& [chunkPos, fromVersion] : batch) {
+            blockserver::ChunkUpdate update;
+            fillChunkUpdate(update, chunkPos, fromVersion);
+            // Blocks while this client's flow-control window is full; changes keep coalescing meanwhile
+            if (!writer->Write(update)) {
+                open = false;
+                break;
+            }
+        }
+        if (!open) {
+            break;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(subscribersMutex_);
+        subscribers_.erase(std::remove(subscribers_.begin(), subscribers_.end(), subscriber), subscribers_.end());
+    }
+    LOG_INFO("[gRPC] SubscribeChunks ended for player: " << playerPos.player_id());
+    return grpc::Status::OK;
+}
+
+void Server::fillChunkUpdate(blockserver::ChunkUpdate& update, const AbsoluteChunkPosition& pos, std::optional<uint64_t> fromVersion) {
+    auto* position = update.mutable_position();
+    position->set_x(pos.x);
+    position->set_y(pos.y);
+    position->set_z(pos.z);
+    // Read the chunk at send time so coalesced edits go out as one up-to-date update
+    auto chunk = world_->chunkAt(pos);
+    if (!chunk) {
+        update.set_invalidated(true);
+        return;
+    }
+    const uint64_t version = (*chunk)->version();
+    update.set_version(version);
+    if (fromVersion) {
+        auto edits = deltaLog_.editsBetween(pos, *fromVersion, version);
+        if (edits) {
+            auto* deltas = update.mutable_deltas();
+            deltas->set_from_version(*fromVersion);
+            for (const auto& edit : *edits) {
+                auto* delta = deltas->add_edits();
+                delta->set_index(edit.index);
+                delta->set_block_type(static_cast<uint32_t>(edit.block));
+            }
+            return;
+        }
+    }
+    // The log no longer reaches back that far
+    update.set_chunk_data(encodedChunks_.get(**chunk)->bytes);
+}
+
 grpc::Status Server::PlaceBlock(grpc::ServerContext* context,
                                const blockserver::PlaceBlockRequest* request,
                                blockserver::PlaceBlockResponse* response) {
+    static const RpcMethodMetrics rpcMetrics("PlaceBlock");
+    RpcCallScope rpcCall(rpcMetrics);
     if (!world_) {
-        std::cerr << "No world instance available" << std::endl;
+        LOG_ERROR("No world instance available");
         response->set_success(false);
         response->set_error_message("No world instance available");
         return grpc::Status::OK;
@@ -173,21 +614,26 @@ grpc::Status Server::PlaceBlock(grpc::ServerContext* context,
     Block newBlock = static_cast<Block>(request->block_type());
     
     // Use the World's setBlockIfLoaded method
-    bool success = world_->setBlockIfLoaded(pos, newBlock);
+    BlockEditResult edit;
+    bool success = world_->setBlockIfLoaded(pos, newBlock, &edit);
     
     if (success) {
-        // Mark the chunk as updated
-        AbsoluteChunkPosition chunkPos = toAbsoluteChunk(pos);
-        markChunkUpdated(chunkPos);
-        
-        std::string playerInfo = "";
-        if (request->has_player_position()) {
-            playerInfo = " by player " + request->player_position().player_id();
+        // Log the edit so subscribers get a delta, then mark the chunk as updated; a write of the
+        // block already there changes nothing anyone holds
+        if (edit.changed) {
+            AbsoluteChunkPosition chunkPos = toAbsoluteChunk(pos);
+            ChunkLocalPosition localPos = toChunkLocal(pos, chunkPos);
+            uint32_t index = localPos.x + localPos.y * CHUNK_WIDTH + localPos.z * CHUNK_WIDTH * CHUNK_HEIGHT;
+            deltaLog_.record(chunkPos, edit.version, index, newBlock);
+            encodedChunks_.invalidate(chunkPos);
+            markChunkUpdated(chunkPos, edit.version - 1);
         }
-        std::cout << "Placed block " << request->block_type() << " at (" << request->x() << ", " << request->y() << ", " << request->z() << ")" << playerInfo << std::endl;
+        
+        LOG_DEBUG("Placed block " << request->block_type() << " at (" << request->x() << ", " << request->y() << ", " << request->z() << ")"
+                  << (request->has_player_position() ? " by player " + request->player_position().player_id() : ""));
         response->set_success(true);
     } else {
-        std::cerr << "Failed to place block - chunk not loaded at (" << request->x() << ", " << request->y() << ", " << request->z() << ")" << std::endl;
+        LOG_DEBUG("Failed to place block - chunk not loaded at (" << request->x() << ", " << request->y() << ", " << request->z() << ")");
         response->set_success(false);
         response->set_error_message("Chunk not loaded");
     }
@@ -198,7 +644,7 @@ grpc::Status Server::PlaceBlock(grpc::ServerContext* context,
 grpc::Status Server::BreakBlock(grpc::ServerContext* context,
                                const blockserver::BreakBlockRequest* request,
                                blockserver::BreakBlockResponse* response) {
-    // Create a PlaceBlockRequest with Empty block type
+    // Create a PlaceBlockRequest with Empty block type; timed as that PlaceBlock
     blockserver::PlaceBlockRequest placeRequest;
     if (request->has_player_position()) {
         *placeRequest.mutable_player_position() = request->player_position();
@@ -217,11 +663,70 @@ grpc::Status Server::BreakBlock(grpc::ServerContext* context,
     return status;
 }
 
+grpc::Status Server::PlaceBlocks(grpc::ServerContext* context,
+                                const blockserver::PlaceBlocksRequest* request,
+                                blockserver::PlaceBlocksResponse* response) {
+    static const RpcMethodMetrics rpcMetrics("PlaceBlocks");
+    RpcCallScope rpcCall(rpcMetrics);
+    if (!world_) {
+        response->set_success(false);
+        response->set_error_message("No world instance available");
+        return grpc::Status::OK;
+    }
+    if (request->edits_size() > MAX_BLOCK_EDITS_PER_REQUEST) {
+        response->set_success(false);
+        response->set_error_message("Too many block edits (max " + std::to_string(MAX_BLOCK_EDITS_PER_REQUEST) + ")");
+        return grpc::Status::OK;
+    }
+    
+    std::vector<BlockPlacement> edits;
+    edits.reserve(request->edits_size());
+    for (const auto& edit : request->edits()) {
+        edits.push_back({AbsoluteBlockPosition(edit.x(), edit.y(), edit.z()), static_cast<Block>(edit.block_type())});
+    }
+    std::vector<std::optional<BlockEditResult>> results = world_->setBlocksIfLoaded(edits);
+    
+    // Log every edit that changed a block for subscribers' deltas; each touched chunk is marked
+    // once, from the version before its first change. A chunk's changes got consecutive versions,
+    // in request order.
+    ChunkPosMap<uint64_t> touched;
+    size_t applied = 0;
+    for (size_t i = 0; i < edits.size(); ++i) {
+        auto* result = response->add_results();
+        if (!results[i]) {
+            result->set_success(false);
+            continue;
+        }
+        result->set_success(true);
+        result->set_version(results[i]->version);
+        ++applied;
+        if (!results[i]->changed) {
+            continue;
+        }
+        AbsoluteChunkPosition chunkPos = toAbsoluteChunk(edits[i].pos);
+        ChunkLocalPosition localPos = toChunkLocal(edits[i].pos, chunkPos);
+        uint32_t index = localPos.x + localPos.y * CHUNK_WIDTH + localPos.z * CHUNK_WIDTH * CHUNK_HEIGHT;
+        deltaLog_.record(chunkPos, results[i]->version, index, edits[i].block);
+        touched.try_emplace(chunkPos, results[i]->version - 1);
+    }
+    for (const auto& [chunkPos, fromVersion] : touched) {
+        encodedChunks_.invalidate(chunkPos);
+        markChunkUpdated(chunkPos, fromVersion);
+    }
+    
+    LOG_DEBUG("Placed " << applied << " of " << edits.size() << " blocks in " << touched.size() << " chunks"
+              << (request->has_player_position() ? " by player " + request->player_position().player_id() : ""));
+    response->set_success(true);
+    return grpc::Status::OK;
+}
+
 grpc::Status Server::GetBlockAt(grpc::ServerContext* context,
                                const blockserver::GetBlockRequest* request,
                                blockserver::GetBlockResponse* response) {
+    static const RpcMethodMetrics rpcMetrics("GetBlockAt");
+    RpcCallScope rpcCall(rpcMetrics);
     if (!world_) {
-        std::cerr << "No world instance available" << std::endl;
+        LOG_ERROR("No world instance available");
         response->set_success(false);
         response->set_error_message("No world instance available");
         return grpc::Status::OK;
@@ -246,6 +751,8 @@ grpc::Status Server::GetBlockAt(grpc::ServerContext* context,
 grpc::Status Server::Ping(grpc::ServerContext* context,
                          const blockserver::PingRequest* request,
                          blockserver::PingResponse* response) {
+    static const RpcMethodMetrics rpcMetrics("Ping");
+    RpcCallScope rpcCall(rpcMetrics);
     response->set_success(true);
     return grpc::Status::OK;
 }
@@ -253,19 +760,73 @@ grpc::Status Server::Ping(grpc::ServerContext* context,
 grpc::Status Server::GetServerInfo(grpc::ServerContext* context,
                                   const blockserver::ServerInfoRequest* request,
                                   blockserver::ServerInfoResponse* response) {
+    static const RpcMethodMetrics rpcMetrics("GetServerInfo");
+    RpcCallScope rpcCall(rpcMetrics);
     response->set_success(true);
     response->set_server_info(getServerInfo());
+    response->set_world_id(getWorldId());
+    return grpc::Status::OK;
+}
+
+grpc::Status Server::GetStats(grpc::ServerContext* context,
+                             const blockserver::StatsRequest* request,
+                             blockserver::StatsResponse* response) {
+    static const RpcMethodMetrics rpcMetrics("GetStats");
+    RpcCallScope rpcCall(rpcMetrics);
+    const std::vector<MetricSnapshot> metrics = getMetrics();
+    response->mutable_metrics()->Reserve(static_cast<int>(metrics.size()));
+    for (const MetricSnapshot& metric : metrics) {
+        auto* entry = response->add_metrics();
+        entry->set_name(metric.name);
+        entry->set_help(metric.help);
+        for (const auto& [name, value] : metric.labels) {
+            auto* label = entry->add_labels();
+            label->set_name(name);
+            label->set_value(value);
+        }
+        switch (metric.kind) {
+        case MetricKind::Counter:
+            entry->set_kind(blockserver::Metric::COUNTER);
+            entry->set_value(metric.value);
+            break;
+        case MetricKind::Gauge:
+            entry->set_kind(blockserver::Metric::GAUGE);
+            entry->set_value(metric.value);
+            break;
+        case MetricKind::Histogram:
+            entry->set_kind(blockserver::Metric::HISTOGRAM);
+            entry->set_count(metric.count);
+            entry->set_sum(metric.sum);
+            for (size_t i = 0; i < metric.bucketCounts.size(); ++i) {
+                auto* bucket = entry->add_buckets();
+                if (i < metric.upperBounds.size()) {
+                    bucket->set_upper_bound(metric.upperBounds[i]);
+                }
+                bucket->set_count(metric.bucketCounts[i]);
+            }
+            break;
+        }
+    }
+    if (request->include_prometheus_text()) {
+        response->set_prometheus_text(formatPrometheusText(metrics));
+    }
+    if (request->include_trace()) {
+        response->set_chrome_trace(Tracer::global().chromeTraceJson());
+    }
+    response->set_success(true);
     return grpc::Status::OK;
 }
 
 grpc::Status Server::ConnectPlayer(grpc::ServerContext* context,
                                   const blockserver::ConnectPlayerRequest* request,
                                   blockserver::ConnectPlayerResponse* response) {
-    std::cout << "[gRPC] ConnectPlayer request from: " << request->player_name() 
-              << " at (" << request->spawn_x() << ", " << request->spawn_y() << ", " << request->spawn_z() << ")" << std::endl;
+    static const RpcMethodMetrics rpcMetrics("ConnectPlayer");
+    RpcCallScope rpcCall(rpcMetrics);
+    LOG_INFO("[gRPC] ConnectPlayer request from: " << request->player_name() 
+             << " at (" << request->spawn_x() << ", " << request->spawn_y() << ", " << request->spawn_z() << ")");
     
     if (!world_) {
-        std::cerr << "No world instance available" << std::endl;
+        LOG_ERROR("No world instance available");
         response->set_success(false);
         response->set_error_message("No world instance available");
         return grpc::Status::OK;
@@ -290,11 +851,11 @@ grpc::Status Server::ConnectPlayer(grpc::ServerContext* context,
         response->set_actual_spawn_y(spawnPos.y);
         response->set_actual_spawn_z(spawnPos.z);
         
-        std::cout << "[gRPC] Player " << request->player_name() << " connected with session: " 
-                  << sessionToken.substr(0, 8) << "..." << std::endl;
+        LOG_INFO("[gRPC] Player " << request->player_name() << " connected with session: " 
+                 << sessionToken.substr(0, 8) << "...");
         
     } catch (const std::exception& e) {
-        std::cerr << "Failed to connect player: " << e.what() << std::endl;
+        LOG_ERROR("Failed to connect player: " << e.what());
         response->set_success(false);
         response->set_error_message("Failed to create player session");
     }
@@ -305,6 +866,8 @@ grpc::Status Server::ConnectPlayer(grpc::ServerContext* context,
 grpc::Status Server::RefreshSession(grpc::ServerContext* context,
                                    const blockserver::RefreshSessionRequest* request,
                                    blockserver::RefreshSessionResponse* response) {
+    static const RpcMethodMetrics rpcMetrics("RefreshSession");
+    RpcCallScope rpcCall(rpcMetrics);
     if (!world_) {
         response->set_success(false);
         response->set_error_message("No world instance available");
@@ -330,6 +893,8 @@ grpc::Status Server::RefreshSession(grpc::ServerContext* context,
 grpc::Status Server::UpdatePlayerPosition(grpc::ServerContext* context,
                                          const blockserver::UpdatePlayerPositionRequest* request,
                                          blockserver::UpdatePlayerPositionResponse* response) {
+    static const RpcMethodMetrics rpcMetrics("UpdatePlayerPosition");
+    RpcCallScope rpcCall(rpcMetrics);
     if (!world_) {
         response->set_success(false);
         response->set_error_message("No world instance available");
@@ -360,9 +925,204 @@ grpc::Status Server::UpdatePlayerPosition(grpc::ServerContext* context,
     return grpc::Status::OK;
 }
 
+grpc::Status Server::PlayerStream(grpc::ServerContext* context,
+                                 grpc::ServerReaderWriter<blockserver::PlayerStreamEvent, blockserver::PlayerInput>* stream) {
+    if (!world_) {
+        return grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, "No world instance available");
+    }
+    
+    blockserver::PlayerInput input;
+    if (!stream->Read(&input)) {
+        return grpc::Status::OK;
+    }
+    auto session = world_->resolvePlayerSession(input.session_token());
+    if (!session) {
+        blockserver::PlayerStreamEvent event;
+        event.set_session_valid(false);
+        event.set_error_message("Invalid or expired session token");
+        stream->Write(event);
+        return grpc::Status::OK;
+    }
+    
+    auto slot = std::make_shared<PlayerStreamSlot>();
+    slot->session = *session;
+    slot->context = context;
+    {
+        std::lock_guard<std::mutex> lock(playerStreamsMutex_);
+        if (stopTick_) {
+            return grpc::Status(grpc::StatusCode::UNAVAILABLE, "Server stopping");
+        }
+        playerStreams_.push_back(slot);
+    }
+    
+    blockserver::PlayerStreamEvent event;
+    event.set_session_valid(true);
+    stream->Write(event);
+    
+    uint64_t lastAcked = 0;
+    auto lastAckTime = std::chrono::steady_clock::now();
+    do {
+        {
+            std::lock_guard<std::mutex> lock(slot->mutex);
+            slot->touched = true;
+            if (input.has_x() && input.has_y() && input.has_z()) {
+                slot->latest = AbsolutePrecisePosition{input.x(), input.y(), input.z()};
+                slot->latestSequence = std::max(slot->latestSequence, input.sequence());
+            }
+        }
+        if (!slot->sessionValid) {
+            event.set_session_valid(false);
+            event.set_applied_sequence(slot->appliedSequence);
+            event.set_error_message("Session ended");
+            stream->Write(event);
+            break;
+        }
+        // Acks ride on incoming traffic, rate limited, so an idle player costs nothing
+        uint64_t applied = slot->appliedSequence;
+        auto now = std::chrono::steady_clock::now();
+        if (applied > lastAcked && now - lastAckTime >= PLAYER_STREAM_ACK_INTERVAL) {
+            event.set_applied_sequence(applied);
+            if (!stream->Write(event)) {
+                break;
+            }
+            lastAcked = applied;
+            lastAckTime = now;
+        }
+    } while (stream->Read(&input));
+    
+    {
+        std::lock_guard<std::mutex> lock(playerStreamsMutex_);
+        playerStreams_.erase(std::remove(playerStreams_.begin(), playerStreams_.end(), slot), playerStreams_.end());
+    }
+    return grpc::Status::OK;
+}
+
+void Server::addTickPhases() {
+    using Deadline = TickScheduler::Clock::time_point;
+    tick_.addPhase(SERVER_TICK_INPUT, SERVER_TICK_INPUT_BUDGET, [this](Deadline) {
+        applyPlayerStreams();
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastSessionExpiry_ >= SESSION_EXPIRY_INTERVAL) {
+            lastSessionExpiry_ = now;
+            expireSessions();
+        }
+        return false;
+    });
+    tick_.addPhase(SERVER_TICK_RESIDENCY, SERVER_TICK_RESIDENCY_BUDGET, [this](Deadline) {
+        if (auto world = world_) {
+            world->queueChunkLoads();
+            world->garbageCollectChunks();
+        }
+        return false;
+    });
+    // Queued loads carry over from tick to tick instead of all landing at once. Demand loads go
+    // first, since a client is waiting on each, and are pushed to the subscriptions that cover them
+    tick_.addPhase(SERVER_TICK_GENERATION, SERVER_TICK_GENERATION_BUDGET, [this](Deadline deadline) {
+        auto world = world_;
+        if (!world) {
+            return false;
+        }
+        for (const auto& pos : world->loadDemandedChunks(deadline)) {
+            markChunkUpdated(pos);
+        }
+        bool anchorsPending = world->loadQueuedChunks(deadline);
+        return anchorsPending || world->hasDemandedChunks();
+    });
+    tick_.addPhase(SERVER_TICK_PERSISTENCE, SERVER_TICK_PERSISTENCE_BUDGET, [this](Deadline deadline) {
+        auto world = world_;
+        if (!world) {
+            return false;
+        }
+        if (!autosaving_) {
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastAutosave_ < SERVER_AUTOSAVE_INTERVAL) {
+                return false;
+            }
+            lastAutosave_ = now;
+        }
+        autosaving_ = world->saveDirtyChunks(deadline);
+        return autosaving_;
+    });
+    // Reads moved entities back so GetEntityUpdates rarely has to
+    tick_.addPhase(SERVER_TICK_ENTITIES, SERVER_TICK_ENTITIES_BUDGET, [this](Deadline) {
+        auto world = world_;
+        if (world && entityTracker_.hasDirty()) {
+            world->readEntities([this](const entt::registry& registry) { entityTracker_.refresh(registry); });
+        }
+        return false;
+    });
+}
+
+void Server::tickLoop() {
+    auto next = std::chrono::steady_clock::now();
+    while (!stopTick_) {
+        next += SERVER_TICK_INTERVAL;
+        std::this_thread::sleep_until(next);
+        tick_.runTick();
+        // Don't try to catch up after a stall
+        next = std::max(next, std::chrono::steady_clock::now());
+    }
+}
+
+bool Server::setTickPhaseBudget(const std::string& phase, std::chrono::steady_clock::duration budget) {
+    return tick_.setBudget(phase, budget);
+}
+
+std::vector<TickPhaseStats> Server::getTickStats() const {
+    return tick_.stats();
+}
+
+void Server::applyPlayerStreams() {
+    if (!world_) {
+        return;
+    }
+    std::vector<std::shared_ptr<PlayerStreamSlot>> slots;
+    {
+        std::lock_guard<std::mutex> lock(playerStreamsMutex_);
+        slots = playerStreams_;
+    }
+    
+    std::vector<std::pair<SessionHandle, AbsolutePrecisePosition>> moves;
+    std::vector<std::pair<PlayerStreamSlot*, uint64_t>> moved;
+    for (const auto& slot : slots) {
+        std::optional<AbsolutePrecisePosition> latest;
+        uint64_t sequence = 0;
+        {
+            std::lock_guard<std::mutex> lock(slot->mutex);
+            if (!slot->touched) {
+                continue;
+            }
+            slot->touched = false;
+            latest.swap(slot->latest);
+            sequence = slot->latestSequence;
+        }
+        if (latest) {
+            moves.emplace_back(slot->session, *latest);
+            moved.emplace_back(slot.get(), sequence);
+        } else if (!world_->refreshPlayerSession(slot->session)) {
+            // Keepalive only
+            slot->sessionValid = false;
+        }
+    }
+    if (moves.empty()) {
+        return;
+    }
+    
+    auto applied = world_->updatePlayerPositions(moves);
+    for (size_t i = 0; i < moved.size(); ++i) {
+        if (applied[i]) {
+            moved[i].first->appliedSequence = moved[i].second;
+        } else {
+            moved[i].first->sessionValid = false;
+        }
+    }
+}
+
 grpc::Status Server::DisconnectPlayer(grpc::ServerContext* context,
                                      const blockserver::DisconnectPlayerRequest* request,
                                      blockserver::DisconnectPlayerResponse* response) {
+    static const RpcMethodMetrics rpcMetrics("DisconnectPlayer");
+    RpcCallScope rpcCall(rpcMetrics);
     if (!world_) {
         response->set_success(false);
         response->set_error_message("No world instance available");
@@ -377,8 +1137,12 @@ grpc::Status Server::DisconnectPlayer(grpc::ServerContext* context,
     
     auto sessionOpt = world_->getPlayerSession(request->session_token());
     if (sessionOpt.has_value()) {
-        std::cout << "[gRPC] Disconnecting player: " << sessionOpt.value().playerName << std::endl;
-        world_->disconnectPlayerBySession(request->session_token());
+        LOG_INFO("[gRPC] Disconnecting player: " << sessionOpt.value().playerName);
+        auto session = world_->disconnectPlayerBySession(request->session_token());
+        if (session) {
+            std::lock_guard<std::mutex> lock(entityInterestMutex_);
+            entityInterest_.erase(*session);
+        }
         response->set_success(true);
     } else {
         response->set_success(false);
@@ -388,52 +1152,142 @@ grpc::Status Server::DisconnectPlayer(grpc::ServerContext* context,
     return grpc::Status::OK;
 }
 
-std::vector<uint8_t> Server::serializeChunk(const ChunkSpan& chunk) {
-    return chunk.serialize();
+grpc::Status Server::GetEntityUpdates(grpc::ServerContext* context,
+                                     const blockserver::GetEntityUpdatesRequest* request,
+                                     blockserver::GetEntityUpdatesResponse* response) {
+    static const RpcMethodMetrics rpcMetrics("GetEntityUpdates");
+    RpcCallScope rpcCall(rpcMetrics);
+    if (!world_) {
+        response->set_success(false);
+        response->set_error_message("No world instance available");
+        return grpc::Status::OK;
+    }
+    
+    auto session = world_->resolvePlayerSession(request->session_token());
+    auto sessionOpt = session ? world_->getPlayerSessionState(*session) : std::nullopt;
+    if (!sessionOpt) {
+        response->set_success(false);
+        response->set_error_message("Invalid session token");
+        return grpc::Status::OK;
+    }
+    
+    if (entityTracker_.hasDirty()) {
+        world_->readEntities([this](const entt::registry& registry) { entityTracker_.refresh(registry); });
+    }
+    int32_t radius = request->view_radius() > 0 ? std::min(request->view_radius(), MAX_ENTITY_VIEW_RADIUS) : ENTITY_SYNC_DEFAULT_VIEW_RADIUS;
+    // World's spatial index says who is in view; the player already knows where it is
+    const AbsoluteChunkPosition center = toAbsoluteChunk(sessionOpt->position);
+    const auto nearby = world_->entitiesInChunkBox(AbsoluteChunkPosition(center.x - radius, center.y - radius, center.z - radius),
+                                                   AbsoluteChunkPosition(center.x + radius, center.y + radius, center.z + radius));
+    auto visible = entityTracker_.snapshotOf(nearby, static_cast<EntityId>(sessionOpt->playerEntity));
+    
+    EntityInterest::Update update;
+    {
+        std::lock_guard<std::mutex> lock(entityInterestMutex_);
+        update = entityInterest_[*session].next(request->ack_sequence(), std::move(visible));
+    }
+    
+    response->set_success(true);
+    response->set_sequence(update.sequence);
+    response->set_full(update.full);
+    response->mutable_updates()->Reserve(static_cast<int>(update.deltas.size()));
+    for (const auto& delta : update.deltas) {
+        auto* entry = response->add_updates();
+        entry->set_entity_id(delta.entity);
+        if (delta.removed) {
+            entry->set_removed(true);
+        } else {
+            auto data = encodeEntityComponents(delta);
+            entry->set_snapshot_data(data.data(), data.size());
+        }
+    }
+    return grpc::Status::OK;
 }
 
-void Server::markChunkUpdated(const AbsoluteChunkPosition& pos) {
-    std::lock_guard<std::mutex> lock(updatedChunksMutex_);
-    updatedChunks_.insert(pos);
+bool Server::clientCopyCurrent(const EncodedChunkCache::Entry& chunk, uint64_t knownVersion, uint64_t knownHash) {
+    // Same version means same contents; otherwise fall back to comparing contents, which also
+    // covers copies kept from an earlier session or before the chunk was reloaded
+    if (knownVersion != 0 && knownVersion == chunk.version) {
+        return true;
+    }
+    return knownHash != 0 && knownHash == chunk.contentHash;
 }
 
-std::vector<AbsoluteChunkPosition> Server::getUpdatedChunksInRange(const AbsoluteBlockPosition& playerPos, int32_t renderDistance) {
-    std::lock_guard<std::mutex> lock(updatedChunksMutex_);
-    std::vector<AbsoluteChunkPosition> result;
-    
-    AbsoluteChunkPosition playerChunk = toAbsoluteChunk(playerPos);
-    
-    for (const auto& chunkPos : updatedChunks_) {
-        // Calculate distance in chunks
-        int32_t dx = std::abs(chunkPos.x - playerChunk.x);
-        int32_t dy = std::abs(chunkPos.y - playerChunk.y);
-        int32_t dz = std::abs(chunkPos.z - playerChunk.z);
-        
-        // Use Manhattan distance for simplicity
-        int32_t distance = std::max({dx, dy, dz});
-        
-        if (distance <= renderDistance) {
-            result.push_back(chunkPos);
+void Server::markChunkUpdated(const AbsoluteChunkPosition& pos, std::optional<uint64_t> fromVersion) {
+    dirtyChunks_.markDirty(pos);
+
+    std::lock_guard<std::mutex> lock(subscribersMutex_);
+    for (const auto& subscriber : subscribers_) {
+        std::lock_guard<std::mutex> subscriberLock(subscriber->mutex);
+        if (!chunkInRange(pos, subscriber->center, subscriber->viewRadius)) {
+            continue;
+        }
+        // Keep the oldest starting version so the coalesced deltas cover every edit
+        if (subscriber->pending.try_emplace(pos, fromVersion).second) {
+            subscriber->order.push_back(pos);
         }
+        subscriber->wake.notify_one();
     }
-    
-    // Clear the updated chunks list after returning them
-    updatedChunks_.clear();
-    
-    return result;
 }
 
-void Server::sessionCleanupLoop() {
-    while (!shouldStopCleanup_) {
+std::optional<AbsoluteChunkPosition> Server::demandLoadCenter(const std::string& sessionToken) const {
+    if (sessionToken.empty()) {
+        return std::nullopt;
+    }
+    auto session = world_->resolvePlayerSession(sessionToken);
+    auto state = session ? world_->getPlayerSessionState(*session) : std::nullopt;
+    if (!state) {
+        return std::nullopt;
+    }
+    return toAbsoluteChunk(state->position);
+}
+
+std::vector<std::shared_ptr<const ChunkSpan>> Server::awaitDemandLoads(
+        const std::vector<std::shared_future<std::shared_ptr<const ChunkSpan>>>& loads, grpc::ServerContext* context) const {
+    std::vector<std::shared_ptr<const ChunkSpan>> chunks(loads.size());
+    // Sync handlers own their thread and can wait out the load. Async workers are shared, so their
+    // callers answer pending at once and get the chunk through their subscription instead.
+    auto waitUntil = std::chrono::steady_clock::now();
+    if (mode_ == ServerMode::Sync) {
+        auto untilCallDeadline = context->deadline() - std::chrono::system_clock::now();
+        waitUntil += std::min<std::chrono::steady_clock::duration>(DEMAND_LOAD_WAIT, std::max<std::chrono::system_clock::duration>(untilCallDeadline, {}));
+    }
+    for (size_t i = 0; i < loads.size(); ++i) {
+        if (loads[i].wait_until(waitUntil) != std::future_status::ready) {
+            continue;
+        }
         try {
-            // Sleep for 1 second between cleanup checks
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-            
-            if (world_ && !shouldStopCleanup_) {
-                world_->cleanupExpiredSessions();
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "Error in session cleanup: " << e.what() << std::endl;
+            chunks[i] = loads[i].get();
+        } catch (const std::future_error&) {
+            // The world went away before loading it
         }
     }
+    return chunks;
+}
+
+bool Server::chunkInRange(const AbsoluteChunkPosition& chunk, const AbsoluteChunkPosition& center, int32_t radius) {
+    // Chebyshev distance in chunks
+    int32_t dx = std::abs(chunk.x - center.x);
+    int32_t dy = std::abs(chunk.y - center.y);
+    int32_t dz = std::abs(chunk.z - center.z);
+    return std::max({dx, dy, dz}) <= radius;
+}
+
+std::vector<AbsoluteChunkPosition> Server::getUpdatedChunksInRange(const std::string& playerId, const AbsoluteBlockPosition& playerPos, int32_t renderDistance) {
+    // A player's first poll starts tracking changes near it
+    return dirtyChunks_.poll(playerId, toAbsoluteChunk(playerPos), renderDistance);
+}
+
+void Server::expireSessions() {
+    if (!world_) {
+        return;
+    }
+    auto ended = world_->cleanupExpiredSessions();
+    dirtyChunks_.removeIdle(UPDATED_CHUNKS_POLLER_IDLE);
+    
+    // Forget entity baselines of sessions that ended
+    std::lock_guard<std::mutex> lock(entityInterestMutex_);
+    for (SessionHandle session : ended) {
+        entityInterest_.erase(session);
+    }
 }
\ No newline at end of file
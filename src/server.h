@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -7,17 +8,58 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <optional>
 #include <grpcpp/grpcpp.h>
 #include "blockserver.grpc.pb.h"
 #include "world.h"
+#include "chunk_delta_log.h"
+#include "dirty_chunk_tracker.h"
+#include "encoded_chunk_cache.h"
+#include "chunk_lod.h"
+#include "entity_sync.h"
+#include "metrics.h"
+#include "rpc_dispatcher.h"
+#include "tick_scheduler.h"
 #include "position.h"
 #include "block.h"
 
+// How the server runs its RPC handlers
+enum class ServerMode {
+    Sync, // gRPC's own sync thread pool, one thread per in-flight call
+    Async // completion queues feeding a prioritized, bounded RpcDispatcher
+};
+
+struct AsyncServerOptions {
+    // Completion queues, each polled by its own thread
+    size_t completionQueues = 2;
+    // Threads running handlers; 0 uses the hardware concurrency
+    size_t workerThreads = 0;
+    // Queued calls beyond this are shed, lowest priority first, with RESOURCE_EXHAUSTED
+    size_t maxQueuedCalls = 4096;
+    // Calls of each method kept requested on every queue, so bursts don't wait for re-arming
+    size_t pendingCallsPerMethod = 4;
+};
+
+// Phases of the server tick, in the order they run; names for Server::setTickPhaseBudget
+constexpr const char* SERVER_TICK_INPUT = "input";             // player streams, session expiry
+constexpr const char* SERVER_TICK_RESIDENCY = "residency";     // anchor moves, chunk unloads
+constexpr const char* SERVER_TICK_GENERATION = "generation";   // loading and generating queued chunks
+constexpr const char* SERVER_TICK_PERSISTENCE = "persistence"; // autosave of edited chunks
+constexpr const char* SERVER_TICK_ENTITIES = "entities";       // entity state for GetEntityUpdates
+
+class AsyncBlockService;
+struct AsyncCallEnv;
+
 class Server final : public blockserver::BlockServer::Service {
 public:
     // Constructor
     Server(uint16_t port = 8080, 
-           std::shared_ptr<World> world = nullptr);
+           std::shared_ptr<World> world = nullptr,
+           ServerMode mode = ServerMode::Sync,
+           AsyncServerOptions asyncOptions = {});
     
     // Destructor
     ~Server();
@@ -33,16 +75,38 @@ public:
     
     // Server information
     uint16_t getPort() const;
+    ServerMode getMode() const { return mode_; }
+    // Async mode: calls shed under overload so far
+    size_t getShedCallCount() const;
     std::string getServerInfo() const;
+    // Names the world for client-side chunk caches; cached copies are still revalidated by content hash
+    std::string getWorldId() const;
+    // False for an unknown phase; takes effect from the next tick
+    bool setTickPhaseBudget(const std::string& phase, std::chrono::steady_clock::duration budget);
+    std::vector<TickPhaseStats> getTickStats() const;
+    // The process-wide metrics plus this server's own gauges, sorted by name; what GetStats returns
+    std::vector<MetricSnapshot> getMetrics() const;
 
     // gRPC service implementations
     grpc::Status GetChunk(grpc::ServerContext* context,
                          const blockserver::ChunkRequest* request,
                          blockserver::ChunkResponse* response) override;
+
+    grpc::Status GetChunks(grpc::ServerContext* context,
+                          const blockserver::ChunksRequest* request,
+                          blockserver::ChunksResponse* response) override;
+
+    grpc::Status GetLodChunks(grpc::ServerContext* context,
+                             const blockserver::LodChunksRequest* request,
+                             blockserver::LodChunksResponse* response) override;
                          
     grpc::Status GetUpdatedChunks(grpc::ServerContext* context,
                                  const blockserver::UpdatedChunksRequest* request,
                                  blockserver::UpdatedChunksResponse* response) override;
+
+    grpc::Status SubscribeChunks(grpc::ServerContext* context,
+                                const blockserver::SubscribeChunksRequest* request,
+                                grpc::ServerWriter<blockserver::ChunkUpdate>* writer) override;
                          
     grpc::Status PlaceBlock(grpc::ServerContext* context,
                            const blockserver::PlaceBlockRequest* request,
@@ -52,6 +116,10 @@ public:
                            const blockserver::BreakBlockRequest* request,
                            blockserver::BreakBlockResponse* response) override;
                            
+    grpc::Status PlaceBlocks(grpc::ServerContext* context,
+                            const blockserver::PlaceBlocksRequest* request,
+                            blockserver::PlaceBlocksResponse* response) override;
+                           
     grpc::Status GetBlockAt(grpc::ServerContext* context,
                            const blockserver::GetBlockRequest* request,
                            blockserver::GetBlockResponse* response) override;
@@ -64,6 +132,10 @@ public:
                               const blockserver::ServerInfoRequest* request,
                               blockserver::ServerInfoResponse* response) override;
 
+    grpc::Status GetStats(grpc::ServerContext* context,
+                         const blockserver::StatsRequest* request,
+                         blockserver::StatsResponse* response) override;
+
     // Player session methods
     grpc::Status ConnectPlayer(grpc::ServerContext* context,
                               const blockserver::ConnectPlayerRequest* request,
@@ -81,12 +153,78 @@ public:
                                  const blockserver::DisconnectPlayerRequest* request,
                                  blockserver::DisconnectPlayerResponse* response) override;
 
+    grpc::Status PlayerStream(grpc::ServerContext* context,
+                             grpc::ServerReaderWriter<blockserver::PlayerStreamEvent, blockserver::PlayerInput>* stream) override;
+
+    // Entities within the session's view radius, as a delta against the snapshot it acknowledged
+    grpc::Status GetEntityUpdates(grpc::ServerContext* context,
+                                 const blockserver::GetEntityUpdatesRequest* request,
+                                 blockserver::GetEntityUpdatesResponse* response) override;
+
 private:
+    /**
+     * @brief One SubscribeChunks stream. Changed positions are coalesced, so a chunk edited many
+     * times before the stream catches up is sent once, as the deltas since the first of those edits
+     * or else its latest contents, and a slow client holds at most one pending entry per chunk in
+     * its view instead of a growing backlog.
+     */
+    struct ChunkSubscriber {
+        std::mutex mutex;
+        std::condition_variable wake;
+        AbsoluteChunkPosition center;
+        int32_t viewRadius = 0;
+        // Followed when the request named a session
+        std::optional<SessionHandle> session;
+        // Chunk version before the first coalesced change, when known
+        ChunkPosMap<std::optional<uint64_t>> pending;
+        std::deque<AbsoluteChunkPosition> order;
+    };
+
+    /**
+     * @brief One PlayerStream. The stream's thread only stores the newest sample; the player tick
+     * applies it to the world, so a client sending faster than the tick costs one slot write per message.
+     */
+    struct PlayerStreamSlot {
+        std::mutex mutex;
+        SessionHandle session = INVALID_SESSION_HANDLE;
+        grpc::ServerContext* context = nullptr;
+        std::optional<AbsolutePrecisePosition> latest;
+        uint64_t latestSequence = 0;
+        // A message arrived since the last tick
+        bool touched = false;
+        std::atomic<uint64_t> appliedSequence{0};
+        std::atomic<bool> sessionValid{true};
+    };
+
     // Helper methods
-    std::vector<uint8_t> serializeChunk(const ChunkSpan& chunk);
-    void markChunkUpdated(const AbsoluteChunkPosition& pos);
-    std::vector<AbsoluteChunkPosition> getUpdatedChunksInRange(const AbsoluteBlockPosition& playerPos, int32_t renderDistance);
-    void sessionCleanupLoop();
+    // True if a client copy with this version or content hash (0 = unknown) matches chunk
+    static bool clientCopyCurrent(const EncodedChunkCache::Entry& chunk, uint64_t knownVersion, uint64_t knownHash);
+    // fromVersion is the chunk's version before the change, if it was a logged block edit
+    void markChunkUpdated(const AbsoluteChunkPosition& pos, std::optional<uint64_t> fromVersion = std::nullopt);
+    // Fills update with deltas since fromVersion when the log covers them, otherwise with the whole chunk
+    void fillChunkUpdate(blockserver::ChunkUpdate& update, const AbsoluteChunkPosition& pos, std::optional<uint64_t> fromVersion);
+    std::vector<AbsoluteChunkPosition> getUpdatedChunksInRange(const std::string& playerId, const AbsoluteBlockPosition& playerPos, int32_t renderDistance);
+    static bool chunkInRange(const AbsoluteChunkPosition& chunk, const AbsoluteChunkPosition& center, int32_t radius);
+    // Chunk of the token's session player, around which misses may be loaded on demand
+    std::optional<AbsoluteChunkPosition> demandLoadCenter(const std::string& sessionToken) const;
+    // The loads' chunks, or null for those not ready in time; waits only in sync mode
+    std::vector<std::shared_ptr<const ChunkSpan>> awaitDemandLoads(
+        const std::vector<std::shared_future<std::shared_ptr<const ChunkSpan>>>& loads, grpc::ServerContext* context) const;
+    // Hooks the world's entity callback up to entityTracker_
+    void watchEntities();
+    // Registers the SERVER_TICK_* phases with tick_
+    void addTickPhases();
+    // Runs tick_ once per SERVER_TICK_INTERVAL
+    void tickLoop();
+    // Applies each player stream's newest sample; the input phase
+    void applyPlayerStreams();
+    // Ends timed-out sessions and drops what the server kept for them
+    void expireSessions();
+    // Async mode plumbing (server_async.cpp)
+    void registerAsyncService(grpc::ServerBuilder& builder);
+    void startAsyncCalls();
+    // Call after grpcServer_->Shutdown(); drains and joins the queues and workers
+    void stopAsyncCalls();
     
     // Server state
     std::unique_ptr<grpc::Server> grpcServer_;
@@ -94,12 +232,47 @@ private:
     uint16_t port_;
     bool running_;
     std::unique_ptr<std::thread> serverThread_;
+    ServerMode mode_;
+    AsyncServerOptions asyncOptions_;
+    
+    // Async mode state
+    std::unique_ptr<AsyncBlockService> asyncService_;
+    std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> completionQueues_;
+    std::vector<std::thread> completionThreads_;
+    std::unique_ptr<RpcDispatcher> dispatcher_;
+    std::unique_ptr<AsyncCallEnv> asyncEnv_;
+    std::atomic<bool> acceptingCalls_{false};
     
-    // Session timeout handling
-    std::unique_ptr<std::thread> cleanupThread_;
-    std::atomic<bool> shouldStopCleanup_{false};
+    // The server tick and its thread: player input, session expiry, chunk loading and saving
+    TickScheduler tick_;
+    std::unique_ptr<std::thread> tickThread_;
+    std::atomic<bool> stopTick_{false};
+    // Tick thread only
+    std::chrono::steady_clock::time_point lastSessionExpiry_{};
+    std::chrono::steady_clock::time_point lastAutosave_ = std::chrono::steady_clock::now();
+    bool autosaving_ = false;
     
-    // Chunk update tracking
-    std::unordered_set<AbsoluteChunkPosition, ChunkPosHash, ChunkPosEq> updatedChunks_;
-    std::mutex updatedChunksMutex_;
+    // Chunk update tracking for GetUpdatedChunks, one queue per polling player covering its render distance
+    DirtyChunkTracker dirtyChunks_;
+
+    // Recent block edits, for sending deltas instead of whole chunks
+    ChunkDeltaLog deltaLog_;
+    // Synced entity state, and each session's entity baselines, dropped when the session ends
+    EntityTracker entityTracker_;
+    std::unordered_map<SessionHandle, EntityInterest> entityInterest_;
+    std::mutex entityInterestMutex_;
+
+    // Serialized chunks and their hashes, shared by every request for the same chunk version
+    EncodedChunkCache encodedChunks_;
+    // Downsampled chunks for GetLodChunks, rebuilt when the chunks under them change
+    ChunkLodCache lodChunks_;
+
+    // Open PlayerStreams, applied by the tick's input phase
+    std::vector<std::shared_ptr<PlayerStreamSlot>> playerStreams_;
+    mutable std::mutex playerStreamsMutex_;
+
+    // Open SubscribeChunks streams
+    std::vector<std::shared_ptr<ChunkSubscriber>> subscribers_;
+    mutable std::mutex subscribersMutex_;
+    std::atomic<bool> stopSubscriptions_{false};
 };
\ No newline at end of file
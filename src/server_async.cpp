@@ -0,0 +1,186 @@
+#include "server.h"
+#include "server_async.h"
+#include <algorithm>
+#include <chrono>
+#include "log.h"
+#include "metrics.h"
+
+namespace {
+
+MetricHistogram& queueWaitSeconds() {
+    static MetricHistogram& histogram = metricHistogram("blocktest_rpc_queue_wait_seconds", "Time an async call waited for a dispatcher worker");
+    return histogram;
+}
+
+// A call object is the completion queue tag for every event of one RPC
+class AsyncCall {
+public:
+    virtual ~AsyncCall() = default;
+    virtual void proceed(bool ok) = 0;
+};
+
+/**
+ * @brief One unary RPC: requested on a completion queue, run on a dispatcher worker, then
+ * finished back through the queue. Deletes itself once the finish (or a failed request) completes.
+ */
+template <class Request, class Response>
+class AsyncUnaryCall final : public AsyncCall {
+public:
+    using RequestMethod = void (AsyncBlockService::*)(grpc::ServerContext*, Request*, grpc::ServerAsyncResponseWriter<Response>*,
+                                                      grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*);
+    using Handler = grpc::Status (Server::*)(grpc::ServerContext*, const Request*, Response*);
+
+    AsyncUnaryCall(const AsyncCallEnv& env, grpc::ServerCompletionQueue* cq, RequestMethod request, Handler handler, RpcPriority priority)
+        : env_(env), cq_(cq), requestMethod_(request), handler_(handler), priority_(priority), responder_(&context_) {
+        (env_.service.*requestMethod_)(&context_, &request_, &responder_, cq_, cq_, this);
+    }
+
+    void proceed(bool ok) override {
+        if (finishing_ || !ok) {
+            // Finished, or the server shut down before a call arrived
+            delete this;
+            return;
+        }
+        // Re-arm the method before handling this call
+        if (env_.accepting.load()) {
+            new AsyncUnaryCall(env_, cq_, requestMethod_, handler_, priority_);
+        }
+        finishing_ = true;
+        queuedAt_ = std::chrono::steady_clock::now();
+        env_.dispatcher.submit(priority_, [this] { run(); }, [this] {
+            responder_.FinishWithError(grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Server overloaded"), this);
+        });
+    }
+
+private:
+    void run() {
+        queueWaitSeconds().observe(std::chrono::steady_clock::now() - queuedAt_);
+        // Don't spend a worker on a call its client has already given up on
+        if (context_.deadline() < std::chrono::system_clock::now()) {
+            responder_.FinishWithError(grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED, "Deadline passed while queued"), this);
+            return;
+        }
+        grpc::Status status = (env_.server.*handler_)(&context_, &request_, &response_);
+        responder_.Finish(response_, status, this);
+    }
+
+    const AsyncCallEnv& env_;
+    grpc::ServerCompletionQueue* const cq_;
+    const RequestMethod requestMethod_;
+    const Handler handler_;
+    const RpcPriority priority_;
+    grpc::ServerContext context_;
+    Request request_;
+    Response response_;
+    grpc::ServerAsyncResponseWriter<Response> responder_;
+    bool finishing_ = false;
+    std::chrono::steady_clock::time_point queuedAt_{};
+};
+
+// Requests the first calls of one method on a queue; each call re-arms itself as it arrives
+template <class Request, class Response>
+void armMethod(const AsyncCallEnv& env, grpc::ServerCompletionQueue* cq, size_t count,
+               typename AsyncUnaryCall<Request, Response>::RequestMethod request,
+               typename AsyncUnaryCall<Request, Response>::Handler handler, RpcPriority priority) {
+    for (size_t i = 0; i < count; ++i) {
+        new AsyncUnaryCall<Request, Response>(env, cq, request, handler, priority);
+    }
+}
+
+} // namespace
+
+grpc::Status AsyncBlockService::SubscribeChunks(grpc::ServerContext* context,
+                                               const blockserver::SubscribeChunksRequest* request,
+                                               grpc::ServerWriter<blockserver::ChunkUpdate>* writer) {
+    return server_.SubscribeChunks(context, request, writer);
+}
+
+grpc::Status AsyncBlockService::PlayerStream(grpc::ServerContext* context,
+                                            grpc::ServerReaderWriter<blockserver::PlayerStreamEvent, blockserver::PlayerInput>* stream) {
+    return server_.PlayerStream(context, stream);
+}
+
+void Server::registerAsyncService(grpc::ServerBuilder& builder) {
+    asyncService_ = std::make_unique<AsyncBlockService>(*this);
+    builder.RegisterService(asyncService_.get());
+    const size_t queues = std::max<size_t>(asyncOptions_.completionQueues, 1);
+    for (size_t i = 0; i < queues; ++i) {
+        completionQueues_.push_back(builder.AddCompletionQueue());
+    }
+}
+
+void Server::startAsyncCalls() {
+    size_t workers = asyncOptions_.workerThreads;
+    if (workers == 0) {
+        workers = std::max<unsigned>(std::thread::hardware_concurrency(), 1);
+    }
+    dispatcher_ = std::make_unique<RpcDispatcher>(workers, asyncOptions_.maxQueuedCalls);
+    acceptingCalls_ = true;
+
+    // Outlives the calls: they are all deleted before stopAsyncCalls() returns
+    asyncEnv_ = std::make_unique<AsyncCallEnv>(AsyncCallEnv{*this, *asyncService_, *dispatcher_, acceptingCalls_});
+    const AsyncCallEnv* env = asyncEnv_.get();
+
+    using namespace blockserver;
+    const size_t n = std::max<size_t>(asyncOptions_.pendingCallsPerMethod, 1);
+    for (auto& cq : completionQueues_) {
+        auto* q = cq.get();
+        armMethod<ChunkRequest, ChunkResponse>(*env, q, n, &AsyncBlockService::RequestGetChunk, &Server::GetChunk, RpcPriority::Low);
+        armMethod<ChunksRequest, ChunksResponse>(*env, q, n, &AsyncBlockService::RequestGetChunks, &Server::GetChunks, RpcPriority::Low);
+        armMethod<LodChunksRequest, LodChunksResponse>(*env, q, n, &AsyncBlockService::RequestGetLodChunks, &Server::GetLodChunks, RpcPriority::Low);
+        armMethod<UpdatedChunksRequest, UpdatedChunksResponse>(*env, q, n, &AsyncBlockService::RequestGetUpdatedChunks, &Server::GetUpdatedChunks, RpcPriority::Normal);
+        armMethod<PlaceBlockRequest, PlaceBlockResponse>(*env, q, n, &AsyncBlockService::RequestPlaceBlock, &Server::PlaceBlock, RpcPriority::Normal);
+        armMethod<BreakBlockRequest, BreakBlockResponse>(*env, q, n, &AsyncBlockService::RequestBreakBlock, &Server::BreakBlock, RpcPriority::Normal);
+        armMethod<PlaceBlocksRequest, PlaceBlocksResponse>(*env, q, n, &AsyncBlockService::RequestPlaceBlocks, &Server::PlaceBlocks, RpcPriority::Normal);
+        armMethod<GetBlockRequest, GetBlockResponse>(*env, q, n, &AsyncBlockService::RequestGetBlockAt, &Server::GetBlockAt, RpcPriority::Normal);
+        armMethod<ConnectPlayerRequest, ConnectPlayerResponse>(*env, q, n, &AsyncBlockService::RequestConnectPlayer, &Server::ConnectPlayer, RpcPriority::High);
+        armMethod<RefreshSessionRequest, RefreshSessionResponse>(*env, q, n, &AsyncBlockService::RequestRefreshSession, &Server::RefreshSession, RpcPriority::High);
+        armMethod<UpdatePlayerPositionRequest, UpdatePlayerPositionResponse>(*env, q, n, &AsyncBlockService::RequestUpdatePlayerPosition, &Server::UpdatePlayerPosition, RpcPriority::High);
+        armMethod<DisconnectPlayerRequest, DisconnectPlayerResponse>(*env, q, n, &AsyncBlockService::RequestDisconnectPlayer, &Server::DisconnectPlayer, RpcPriority::High);
+        armMethod<PingRequest, PingResponse>(*env, q, n, &AsyncBlockService::RequestPing, &Server::Ping, RpcPriority::High);
+        armMethod<ServerInfoRequest, ServerInfoResponse>(*env, q, n, &AsyncBlockService::RequestGetServerInfo, &Server::GetServerInfo, RpcPriority::High);
+        armMethod<StatsRequest, StatsResponse>(*env, q, n, &AsyncBlockService::RequestGetStats, &Server::GetStats, RpcPriority::High);
+        armMethod<GetEntityUpdatesRequest, GetEntityUpdatesResponse>(*env, q, n, &AsyncBlockService::RequestGetEntityUpdates, &Server::GetEntityUpdates, RpcPriority::Normal);
+
+        // One thread per queue, so a call's events are always handled on the same thread
+        completionThreads_.emplace_back([q] {
+            void* tag;
+            bool ok;
+            while (q->Next(&tag, &ok)) {
+                static_cast<AsyncCall*>(tag)->proceed(ok);
+            }
+        });
+    }
+    LOG_INFO("Async RPC mode: " << completionQueues_.size() << " completion queues, "
+             << workers << " workers");
+}
+
+void Server::stopAsyncCalls() {
+    acceptingCalls_ = false;
+    // Shed calls still queued; their FinishWithError events drain through the queues below
+    if (dispatcher_) {
+        dispatcher_->stop();
+    }
+    for (auto& cq : completionQueues_) {
+        cq->Shutdown();
+    }
+    for (auto& thread : completionThreads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    // A queue that never had a thread still has to be drained before it is destroyed
+    if (completionThreads_.empty()) {
+        for (auto& cq : completionQueues_) {
+            void* tag;
+            bool ok;
+            while (cq->Next(&tag, &ok)) {
+            }
+        }
+    }
+    completionThreads_.clear();
+    completionQueues_.clear();
+    dispatcher_.reset();
+    asyncEnv_.reset();
+    asyncService_.reset();
+}
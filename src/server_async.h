@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <grpcpp/grpcpp.h>
+#include "blockserver.grpc.pb.h"
+#include "rpc_dispatcher.h"
+
+class Server;
+class AsyncBlockService;
+
+// What every async call needs from the server
+struct AsyncCallEnv {
+    Server& server;
+    AsyncBlockService& service;
+    RpcDispatcher& dispatcher;
+    const std::atomic<bool>& accepting;
+};
+
+// Every unary BlockServer method in async form. The streams (SubscribeChunks, PlayerStream) last as
+// long as a client stays, so they stay on gRPC's sync threads rather than occupying a dispatcher worker.
+using AsyncUnaryBlockService =
+    blockserver::BlockServer::WithAsyncMethod_GetChunk<
+    blockserver::BlockServer::WithAsyncMethod_GetChunks<
+    blockserver::BlockServer::WithAsyncMethod_GetLodChunks<
+    blockserver::BlockServer::WithAsyncMethod_GetUpdatedChunks<
+    blockserver::BlockServer::WithAsyncMethod_PlaceBlock<
+    blockserver::BlockServer::WithAsyncMethod_BreakBlock<
+    blockserver::BlockServer::WithAsyncMethod_PlaceBlocks<
+    blockserver::BlockServer::WithAsyncMethod_GetBlockAt<
+    blockserver::BlockServer::WithAsyncMethod_ConnectPlayer<
+    blockserver::BlockServer::WithAsyncMethod_RefreshSession<
+    blockserver::BlockServer::WithAsyncMethod_UpdatePlayerPosition<
+    blockserver::BlockServer::WithAsyncMethod_DisconnectPlayer<
+    blockserver::BlockServer::WithAsyncMethod_Ping<
+    blockserver::BlockServer::WithAsyncMethod_GetServerInfo<
+    blockserver::BlockServer::WithAsyncMethod_GetStats<
+    blockserver::BlockServer::WithAsyncMethod_GetEntityUpdates<
+    blockserver::BlockServer::Service>>>>>>>>>>>>>>>>;
+
+/**
+ * @brief The service registered in ServerMode::Async. Unary calls are requested on the server's
+ * completion queues and run by its RpcDispatcher; the remaining sync methods forward to Server.
+ */
+class AsyncBlockService final : public AsyncUnaryBlockService {
+public:
+    explicit AsyncBlockService(Server& server) : server_(server) {}
+
+    grpc::Status SubscribeChunks(grpc::ServerContext* context,
+                                const blockserver::SubscribeChunksRequest* request,
+                                grpc::ServerWriter<blockserver::ChunkUpdate>* writer) override;
+
+    grpc::Status PlayerStream(grpc::ServerContext* context,
+                             grpc::ServerReaderWriter<blockserver::PlayerStreamEvent, blockserver::PlayerInput>* stream) override;
+
+private:
+    Server& server_;
+};
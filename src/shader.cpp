@@ -13,6 +13,7 @@ Shader::Shader(const std::string& vertexSource, const std::string& fragmentSourc
     
     // Check for linking errors
     checkCompileErrors(programId, "PROGRAM");
+    cacheUniformLocations();
     
     // Clean up shaders
     glDeleteShader(vertex);
@@ -27,24 +28,76 @@ void Shader::use() {
     glUseProgram(programId);
 }
 
+void Shader::set(Uniform<glm::mat4> uniform, const glm::mat4& matrix) {
+    glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(matrix));
+}
+
+void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3& vector) {
+    glUniform3fv(uniform.location, 1, glm::value_ptr(vector));
+}
+
+void Shader::set(Uniform<float> uniform, float value) {
+    glUniform1f(uniform.location, value);
+}
+
+void Shader::set(Uniform<int> uniform, int value) {
+    glUniform1i(uniform.location, value);
+}
+
 void Shader::setMat4(const std::string& name, const glm::mat4& matrix) {
-    GLint location = glGetUniformLocation(programId, name.c_str());
-    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+    set(uniform<glm::mat4>(name), matrix);
 }
 
 void Shader::setVec3(const std::string& name, const glm::vec3& vector) {
-    GLint location = glGetUniformLocation(programId, name.c_str());
-    glUniform3fv(location, 1, glm::value_ptr(vector));
+    set(uniform<glm::vec3>(name), vector);
 }
 
 void Shader::setFloat(const std::string& name, float value) {
-    GLint location = glGetUniformLocation(programId, name.c_str());
-    glUniform1f(location, value);
+    set(uniform<float>(name), value);
 }
 
 void Shader::setInt(const std::string& name, int value) {
-    GLint location = glGetUniformLocation(programId, name.c_str());
-    glUniform1i(location, value);
+    set(uniform<int>(name), value);
+}
+
+bool Shader::bindUniformBlock(const char* blockName, GLuint bindingPoint) {
+    GLuint index = glGetUniformBlockIndex(programId, blockName);
+    if (index == GL_INVALID_INDEX) {
+        std::cerr << "Shader has no uniform block " << blockName << std::endl;
+        return false;
+    }
+    glUniformBlockBinding(programId, index, bindingPoint);
+    return true;
+}
+
+void Shader::cacheUniformLocations() {
+    GLint count = 0;
+    GLint maxNameLength = 0;
+    glGetProgramiv(programId, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    std::string name(static_cast<size_t>(maxNameLength > 0 ? maxNameLength : 1), '\0');
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(programId, static_cast<GLuint>(i), maxNameLength, &length, &size, &type, name.data());
+        std::string uniformName(name.data(), static_cast<size_t>(length));
+        // Members of uniform blocks have no location; they are set through a UniformBuffer
+        GLint location = glGetUniformLocation(programId, uniformName.c_str());
+        if (location < 0) {
+            continue;
+        }
+        uniformLocations_[uniformName] = location;
+        // Arrays are reported as "name[0]" but may be set by their bare name
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+            uniformLocations_[uniformName.substr(0, uniformName.size() - 3)] = location;
+        }
+    }
+}
+
+GLint Shader::location(std::string_view name) const {
+    auto it = uniformLocations_.find(std::string(name));
+    return it != uniformLocations_.end() ? it->second : -1;
 }
 
 GLuint Shader::compileShader(const char* source, GLenum type) {
@@ -74,4 +127,26 @@ void Shader::checkCompileErrors(GLuint shader, const std::string& type) {
             std::cerr << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << std::endl;
         }
     }
-}
\ No newline at end of file
+}
+
+UniformBuffer::UniformBuffer(GLuint bindingPoint, size_t size) : bindingPoint_(bindingPoint), size_(size) {
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(size_), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint_, buffer_);
+}
+
+UniformBuffer::~UniformBuffer() {
+    glDeleteBuffers(1, &buffer_);
+}
+
+void UniformBuffer::update(const void* data, size_t size) {
+    if (size != size_) {
+        std::cerr << "UniformBuffer update of " << size << " bytes into a " << size_ << "-byte buffer" << std::endl;
+        return;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, static_cast<GLsizeiptr>(size_), data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
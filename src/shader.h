@@ -3,8 +3,21 @@
 #define GL_GLEXT_PROTOTYPES
 #include <glm/glm.hpp>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <iostream>
 #include "gl_includes.h"
+
+/**
+ * @brief A uniform's location in one program, looked up once. Setting a handle whose uniform the
+ * program doesn't have (location -1, e.g. optimized out) does nothing, as in GL.
+ */
+template<typename T>
+struct Uniform {
+    GLint location = -1;
+    explicit operator bool() const { return location >= 0; }
+};
+
 class Shader {
 public:
     GLuint programId;
@@ -13,12 +26,55 @@ public:
     ~Shader();
     
     void use();
+    
+    // Handle for a uniform, from the locations cached at link time; look handles up once, not per draw
+    template<typename T>
+    Uniform<T> uniform(std::string_view name) const { return Uniform<T>{location(name)}; }
+    // Set on the program in use
+    void set(Uniform<glm::mat4> uniform, const glm::mat4& matrix);
+    void set(Uniform<glm::vec3> uniform, const glm::vec3& vector);
+    void set(Uniform<float> uniform, float value);
+    void set(Uniform<int> uniform, int value);
+    
+    // By name, for setup code; the location still comes from the cache
     void setMat4(const std::string& name, const glm::mat4& matrix);
     void setVec3(const std::string& name, const glm::vec3& vector);
     void setFloat(const std::string& name, float value);
     void setInt(const std::string& name, int value);
     
+    // Connects the named uniform block to a UniformBuffer binding point; false if the program has no such block
+    bool bindUniformBlock(const char* blockName, GLuint bindingPoint);
+    
 private:
+    // Active uniforms by name (array uniforms under both "name" and "name[0]")
+    std::unordered_map<std::string, GLint> uniformLocations_;
+    
     GLuint compileShader(const char* source, GLenum type);
     void checkCompileErrors(GLuint shader, const std::string& type);
-};
\ No newline at end of file
+    void cacheUniformLocations();
+    GLint location(std::string_view name) const;
+};
+
+/**
+ * @brief A uniform buffer bound to a fixed binding point, for blocks shared by several programs
+ * and rewritten once per frame. The caller lays the data out to match the block's std140 layout.
+ */
+class UniformBuffer {
+public:
+    UniformBuffer(GLuint bindingPoint, size_t size);
+    ~UniformBuffer();
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+    
+    // Replaces the whole contents; size must be the size given at construction
+    void update(const void* data, size_t size);
+    template<typename T>
+    void update(const T& data) { update(&data, sizeof(T)); }
+    
+    GLuint bindingPoint() const { return bindingPoint_; }
+    
+private:
+    GLuint buffer_ = 0;
+    GLuint bindingPoint_;
+    size_t size_;
+};
@@ -1,12 +1,32 @@
 #include "sqlite_chunk_persistence.h"
+#include "chunk_arena.h"
 #include "chunkdims.h"
 #include "block.h"
 #include <iostream>
 
 
-SQLiteChunkPersistence::SQLiteChunkPersistence(std::unique_ptr<sqlite3, decltype(&sqlite3_close)> db)
+SQLiteChunkPersistence::SQLiteChunkPersistence(std::unique_ptr<sqlite3, decltype(&sqlite3_close)> db,
+                                               SQLiteSynchronousMode synchronous)
     : db_(db ? std::shared_ptr<sqlite3>(db.release(), sqlite3_close) : nullptr) {
     initializeDatabase();
+    setSynchronousMode(synchronous);
+}
+
+SQLiteChunkPersistence::~SQLiteChunkPersistence() {
+    // Statements must be finalized before the connection closes
+    sqlite3_finalize(saveStmt_);
+    sqlite3_finalize(loadStmt_);
+}
+
+bool SQLiteChunkPersistence::exec(const char* sql) {
+    char* errMsg = nullptr;
+    int rc = sqlite3_exec(db_.get(), sql, nullptr, nullptr, &errMsg);
+    if (rc != SQLITE_OK) {
+        std::cerr << "SQLite error running '" << sql << "': " << (errMsg ? errMsg : sqlite3_errmsg(db_.get())) << "\n";
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
 }
 
 void SQLiteChunkPersistence::initializeDatabase() {
@@ -28,116 +48,175 @@ void SQLiteChunkPersistence::initializeDatabase() {
         std::cerr << "Failed to initialize database: " << errMsg << std::endl;
         sqlite3_free(errMsg);
     }
-}
 
-bool SQLiteChunkPersistence::saveChunk(const ChunkSpan& chunk) {
-    if (!db_) {
-        std::cerr << "No database connection for saving chunk\n";
-        return false;
-    }
-    
-    const AbsoluteChunkPosition& pos = chunk.position;
-    auto serializedData = chunk.serialize();
-    // Prepare SQL statement
-    const char* sql = R"sql(
+    // WAL lets readers proceed during writes and turns each commit into an append
+    exec("PRAGMA journal_mode=WAL;");
+
+    const char* saveSQL = R"sql(
         INSERT OR REPLACE INTO chunks (x, y, z, data) 
         VALUES (?, ?, ?, ?)
     )sql";
-    
-    sqlite3_stmt* stmt = nullptr;
-    int rc = sqlite3_prepare_v2(db_.get(), sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    if (sqlite3_prepare_v3(db_.get(), saveSQL, -1, SQLITE_PREPARE_PERSISTENT, &saveStmt_, nullptr) != SQLITE_OK) {
         std::cerr << "Failed to prepare save statement: " << sqlite3_errmsg(db_.get()) << "\n";
-        return false;
     }
-    
-    // Bind parameters
-    sqlite3_bind_int(stmt, 1, pos.x);
-    sqlite3_bind_int(stmt, 2, pos.y);
-    sqlite3_bind_int(stmt, 3, pos.z);
-    sqlite3_bind_blob(stmt, 4, serializedData.data(), static_cast<int>(serializedData.size()), SQLITE_STATIC);
-    
-    // Execute
-    rc = sqlite3_step(stmt);
+
+    const char* loadSQL = R"sql(
+        SELECT data FROM chunks WHERE x = ? AND y = ? AND z = ?
+    )sql";
+    if (sqlite3_prepare_v3(db_.get(), loadSQL, -1, SQLITE_PREPARE_PERSISTENT, &loadStmt_, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to prepare load statement: " << sqlite3_errmsg(db_.get()) << "\n";
+    }
+}
+
+bool SQLiteChunkPersistence::setSynchronousMode(SQLiteSynchronousMode mode) {
+    if (!db_) return false;
+    std::lock_guard<std::mutex> lock(dbMutex_);
+    switch (mode) {
+        case SQLiteSynchronousMode::Off:    return exec("PRAGMA synchronous=OFF;");
+        case SQLiteSynchronousMode::Normal: return exec("PRAGMA synchronous=NORMAL;");
+        case SQLiteSynchronousMode::Full:   return exec("PRAGMA synchronous=FULL;");
+    }
+    return false;
+}
+
+bool SQLiteChunkPersistence::writeChunk(const ChunkSpan& chunk) {
+    const AbsoluteChunkPosition& pos = chunk.position;
+    auto serializedData = chunk.serialize();
+
+    sqlite3_bind_int(saveStmt_, 1, pos.x);
+    sqlite3_bind_int(saveStmt_, 2, pos.y);
+    sqlite3_bind_int(saveStmt_, 3, pos.z);
+    sqlite3_bind_blob(saveStmt_, 4, serializedData.data(), static_cast<int>(serializedData.size()), SQLITE_STATIC);
+
+    int rc = sqlite3_step(saveStmt_);
     bool success = (rc == SQLITE_DONE);
-    
     if (!success) {
         std::cerr << "Failed to execute save statement: " << sqlite3_errmsg(db_.get()) << "\n";
     }
-    
-    int result = sqlite3_finalize(stmt);
-    if (result != SQLITE_OK) {
-        std::cerr << "Failed to finalize save statement: " << sqlite3_errmsg(db_.get()) << "\n";
-        success = false;
-    }
+    // Unbind before serializedData goes away
+    sqlite3_reset(saveStmt_);
+    sqlite3_clear_bindings(saveStmt_);
     return success;
 }
 
+std::optional<ChunkSerializationSparseVector> SQLiteChunkPersistence::readChunk(const AbsoluteChunkPosition& pos) {
+    sqlite3_bind_int(loadStmt_, 1, pos.x);
+    sqlite3_bind_int(loadStmt_, 2, pos.y);
+    sqlite3_bind_int(loadStmt_, 3, pos.z);
+
+    std::optional<ChunkSerializationSparseVector> serialized;
+    int rc = sqlite3_step(loadStmt_);
+    if (rc == SQLITE_ROW) {
+        const void* blobData = sqlite3_column_blob(loadStmt_, 0);
+        int blobSize = sqlite3_column_bytes(loadStmt_, 0);
+        if (blobData && blobSize > 0) {
+            // The blob is only valid until the statement is reset; copying it is cheap, so the
+            // decode can happen after the connection is released
+            const auto* bytes = static_cast<const uint8_t*>(blobData);
+            serialized.emplace(bytes, bytes + blobSize);
+        } else {
+            std::cerr << "Invalid blob data at (" << pos.x << "," << pos.y << "," << pos.z << "): size=" << blobSize << "\n";
+        }
+    } else if (rc != SQLITE_DONE) {
+        // SQLITE_DONE is an ordinary miss; anything else is a real error
+        std::cerr << "Failed to execute load statement: " << sqlite3_errmsg(db_.get()) << "\n";
+    }
+    sqlite3_reset(loadStmt_);
+    return serialized;
+}
+
+std::optional<std::shared_ptr<ChunkSpan>> SQLiteChunkPersistence::decodeChunk(const ChunkSerializationSparseVector& serialized) {
+    try {
+        return makePooledChunk(std::span<const uint8_t>(serialized));
+    } catch (const std::exception& ex) {
+        std::cerr << "Failed to deserialize chunk: " << ex.what() << "\n";
+        return std::nullopt;
+    }
+}
+
+bool SQLiteChunkPersistence::saveChunk(const ChunkSpan& chunk) {
+    if (!db_ || !saveStmt_) {
+        std::cerr << "No database connection for saving chunk\n";
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(dbMutex_);
+    return writeChunk(chunk);
+}
+
 std::optional<std::shared_ptr<ChunkSpan>> SQLiteChunkPersistence::loadChunk(const AbsoluteChunkPosition& pos) {
-    if (!db_) {
+    if (!db_ || !loadStmt_) {
         std::cerr << "No database connection for loading chunk\n";
         return std::nullopt;
     }
-    
-    const char* sql = R"sql(
-        SELECT data FROM chunks WHERE x = ? AND y = ? AND z = ?
-    )sql";
-    
-    sqlite3_stmt* stmt = nullptr;
-    int rc = sqlite3_prepare_v2(db_.get(), sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
-        std::cerr << "Failed to prepare load statement: " << sqlite3_errmsg(db_.get()) << "\n";
-        return std::nullopt;
+
+    std::optional<ChunkSerializationSparseVector> serialized;
+    {
+        std::lock_guard<std::mutex> lock(dbMutex_);
+        serialized = readChunk(pos);
     }
-    
-    // Bind parameters
-    sqlite3_bind_int(stmt, 1, pos.x);
-    sqlite3_bind_int(stmt, 2, pos.y);
-    sqlite3_bind_int(stmt, 3, pos.z);
-    
-    // Execute query
-    rc = sqlite3_step(stmt);
-    if (rc != SQLITE_ROW) {
-        std::cerr << "No chunk found at (" << pos.x << "," << pos.y << "," << pos.z << ") - rc=" << rc << "\n";
-        sqlite3_finalize(stmt);
-        return std::nullopt;
+    if (!serialized) return std::nullopt;
+    return decodeChunk(*serialized);
+}
+
+bool SQLiteChunkPersistence::saveChunks(const std::vector<std::shared_ptr<const ChunkSpan>>& chunks) {
+    if (!db_ || !saveStmt_) {
+        std::cerr << "No database connection for saving chunks\n";
+        return false;
     }
-    
-    // Get the blob data
-    const void* blobData = sqlite3_column_blob(stmt, 0);
-    int blobSize = sqlite3_column_bytes(stmt, 0);
-    
-    if (!blobData || blobSize <= 0) {
-        std::cerr << "Invalid blob data: size=" << blobSize << "\n";
-        sqlite3_finalize(stmt);
-        return std::nullopt;
+    if (chunks.empty()) return true;
+
+    std::lock_guard<std::mutex> lock(dbMutex_);
+    // One transaction means one journal sync for the whole batch
+    if (!exec("BEGIN IMMEDIATE;")) return false;
+    bool success = true;
+    for (const auto& chunk : chunks) {
+        if (chunk && !writeChunk(*chunk)) {
+            success = false;
+            break;
+        }
     }
-    
-    std::cerr << "Loading chunk (" << pos.x << "," << pos.y << "," << pos.z << ") with " 
-              << blobSize << " bytes\n";
-    
-    // Copy the data to a vector
-    std::vector<uint8_t> serializedData(
-        static_cast<const uint8_t*>(blobData),
-        static_cast<const uint8_t*>(blobData) + blobSize
-    );
-    
-    sqlite3_finalize(stmt);
-    
-    try {
-        auto chunk = std::make_shared<ChunkSpan>(serializedData);
-        return chunk;
-    } catch (const std::exception& ex) {
-        std::cerr << "Failed to deserialize chunk: " << ex.what() << "\n";
-        return std::nullopt;
+    if (!success) {
+        exec("ROLLBACK;");
+        return false;
+    }
+    return exec("COMMIT;");
+}
+
+std::vector<std::optional<std::shared_ptr<ChunkSpan>>> SQLiteChunkPersistence::loadChunks(std::span<const AbsoluteChunkPosition> positions) {
+    std::vector<std::optional<std::shared_ptr<ChunkSpan>>> result(positions.size());
+    auto serialized = loadSerializedChunks(positions);
+    // Decode with the connection free for other loads and the write-behind thread
+    for (size_t i = 0; i < serialized.size(); ++i) {
+        if (serialized[i]) result[i] = decodeChunk(*serialized[i]);
+    }
+    return result;
+}
+
+std::vector<std::optional<ChunkSerializationSparseVector>> SQLiteChunkPersistence::loadSerializedChunks(std::span<const AbsoluteChunkPosition> positions) {
+    std::vector<std::optional<ChunkSerializationSparseVector>> result(positions.size());
+    if (!db_ || !loadStmt_) {
+        std::cerr << "No database connection for loading chunks\n";
+        return result;
     }
+
+    std::lock_guard<std::mutex> lock(dbMutex_);
+    // A single read transaction avoids taking and dropping the shared lock per row
+    bool inTransaction = exec("BEGIN;");
+    for (size_t i = 0; i < positions.size(); ++i) {
+        result[i] = readChunk(positions[i]);
+    }
+    if (inTransaction) exec("COMMIT;");
+    return result;
 }
 
 void SQLiteChunkPersistence::saveAllLoadedChunks(const ChunkMap& chunks) {
     if (!db_) return;
+    std::vector<std::shared_ptr<const ChunkSpan>> batch;
+    batch.reserve(chunks.size());
     for (const auto& [pos, chunk] : chunks) {
         if (chunk) {
-            saveChunk(*chunk);
+            batch.push_back(chunk);
         }
     }
-}
\ No newline at end of file
+    saveChunks(batch);
+}
@@ -4,18 +4,48 @@
 #include "chunkspan.h"
 #include <sqlite3.h>
 #include <memory>
+#include <mutex>
 #include <iostream>
 
+// Values for SQLite's PRAGMA synchronous. Normal is durable across application crashes in WAL mode.
+enum class SQLiteSynchronousMode {
+    Off,
+    Normal,
+    Full
+};
+
 class SQLiteChunkPersistence : public IChunkPersistence {
 public:
-    explicit SQLiteChunkPersistence(std::unique_ptr<sqlite3, decltype(&sqlite3_close)> db);
-    ~SQLiteChunkPersistence() override = default;
+    explicit SQLiteChunkPersistence(std::unique_ptr<sqlite3, decltype(&sqlite3_close)> db,
+                                    SQLiteSynchronousMode synchronous = SQLiteSynchronousMode::Normal);
+    ~SQLiteChunkPersistence() override;
 
     bool saveChunk(const ChunkSpan& chunk) override;
     std::optional<std::shared_ptr<ChunkSpan>> loadChunk(const AbsoluteChunkPosition& pos) override;
     void saveAllLoadedChunks(const ChunkMap& chunks) override;
+    // Writes all chunks in a single transaction
+    bool saveChunks(const std::vector<std::shared_ptr<const ChunkSpan>>& chunks) override;
+    // Reads all positions inside a single read transaction
+    std::vector<std::optional<std::shared_ptr<ChunkSpan>>> loadChunks(std::span<const AbsoluteChunkPosition> positions) override;
+    // The stored blobs, copied out inside the read transaction
+    std::vector<std::optional<ChunkSerializationSparseVector>> loadSerializedChunks(std::span<const AbsoluteChunkPosition> positions) override;
+
+    bool setSynchronousMode(SQLiteSynchronousMode mode);
 
 private:
     void initializeDatabase();
+    bool exec(const char* sql);
+    // Runs the cached insert statement; caller holds dbMutex_
+    bool writeChunk(const ChunkSpan& chunk);
+    // Runs the cached select statement and copies out the row's blob; caller holds dbMutex_
+    std::optional<ChunkSerializationSparseVector> readChunk(const AbsoluteChunkPosition& pos);
+    // Deserializes a copied blob; no lock needed
+    static std::optional<std::shared_ptr<ChunkSpan>> decodeChunk(const ChunkSerializationSparseVector& serialized);
+
     std::shared_ptr<sqlite3> db_;
-};
\ No newline at end of file
+    // Statements are prepared once and reset between uses
+    sqlite3_stmt* saveStmt_ = nullptr;
+    sqlite3_stmt* loadStmt_ = nullptr;
+    // Serializes use of the connection; World may load chunks from several threads
+    std::mutex dbMutex_;
+};
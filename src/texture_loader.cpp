@@ -1,5 +1,7 @@
 #include "texture_loader.h"
 #include <stdio.h>
+#include <algorithm>
+#include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -33,4 +35,55 @@ GLuint loadTexture(const char* path) {
     
     stbi_image_free(data);
     return textureID;
-}
\ No newline at end of file
+}
+
+GLuint loadTextureArray(const char* path, int tileSize) {
+    int width, height, channels;
+    // Always RGBA, so every layer has the same layout whatever the file holds
+    unsigned char* data = stbi_load(path, &width, &height, &channels, 4);
+    
+    if (!data) {
+        fprintf(stderr, "Failed to load texture: %s\n", path);
+        fprintf(stderr, "stb_image error: %s\n", stbi_failure_reason());
+        return 0;
+    }
+    if (tileSize <= 0 || width % tileSize != 0 || height % tileSize != 0) {
+        fprintf(stderr, "Texture %s (%dx%d) is not a whole number of %dx%d tiles\n", path, width, height, tileSize, tileSize);
+        stbi_image_free(data);
+        return 0;
+    }
+    
+    const int columns = width / tileSize;
+    const int layers = columns * (height / tileSize);
+    printf("Loaded texture array: %d tiles of %dx%d\n", layers, tileSize, tileSize);
+    
+    // Regroup the atlas so each tile's rows are contiguous, as glTexImage3D expects layers
+    const size_t tileBytes = static_cast<size_t>(tileSize) * tileSize * 4;
+    const size_t rowBytes = static_cast<size_t>(tileSize) * 4;
+    std::vector<unsigned char> tiles(tileBytes * layers);
+    for (int layer = 0; layer < layers; ++layer) {
+        const int tileX = (layer % columns) * tileSize;
+        const int tileY = (layer / columns) * tileSize;
+        for (int row = 0; row < tileSize; ++row) {
+            const unsigned char* src = data + (static_cast<size_t>(tileY + row) * width + tileX) * 4;
+            std::copy(src, src + rowBytes, tiles.begin() + layer * tileBytes + row * rowBytes);
+        }
+    }
+    stbi_image_free(data);
+    
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+    
+    // Each layer wraps onto itself, so merged faces can repeat a tile without reaching its neighbours
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, tileSize, tileSize, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, tiles.data());
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return textureID;
+}
@@ -5,4 +5,13 @@
  * @param path Path to the texture file (PNG, JPG, etc.)
  * @return OpenGL texture ID, or 0 if loading failed
  */
-GLuint loadTexture(const char* path);
\ No newline at end of file
+GLuint loadTexture(const char* path);
+
+/**
+ * Load a texture atlas as a mipmapped GL_TEXTURE_2D_ARRAY with one layer per tile
+ * @param path Path to the atlas image
+ * @param tileSize Width and height of one tile in pixels; the image must be a whole number of tiles
+ * @return OpenGL texture ID, or 0 if loading failed. Layer i holds the tile at row i / columns,
+ * column i % columns, counting rows from the top of the image (see getTileIndex).
+ */
+GLuint loadTextureArray(const char* path, int tileSize);
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    if (threadCount == 0) threadCount = 1;
+    queues_.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+    threads_.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        if (thread.joinable()) thread.join();
+    }
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    size_t target = nextQueue_.fetch_add(1) % queues_.size();
+    {
+        // Count before publishing so a worker that takes the task never drives the count below zero.
+        // Incrementing under the wake lock means a worker about to sleep cannot miss it.
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        ++queuedTasks_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues_[target]->mutex);
+        queues_[target]->tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::tryTake(size_t self, std::function<void()>& out) {
+    // Own queue first (front), then steal from the back of the others
+    for (size_t offset = 0; offset < queues_.size(); ++offset) {
+        auto& queue = *queues_[(self + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        if (offset == 0) {
+            out = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            out = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        --queuedTasks_;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t self) {
+    std::function<void()> task;
+    for (;;) {
+        if (tryTake(self, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        wake_.wait(lock, [this]() { return stopping_ || queuedTasks_ > 0; });
+        if (stopping_ && queuedTasks_ == 0) return;
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Fixed-size work-stealing thread pool.
+ *
+ * Each worker owns a task deque. Submitted tasks are distributed round-robin;
+ * a worker pops from the front of its own deque and, when that is empty, steals
+ * from the back of another worker's deque.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return threads_.size(); }
+
+    /**
+     * @brief Queues a callable and returns a future for its result.
+     */
+    template<typename F>
+    auto submit(F&& func) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using R = std::invoke_result_t<std::decay_t<F>>;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+        std::future<R> result = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    /**
+     * @brief Calls func(i) for every i in [0, count) across the pool and blocks until all calls return.
+     * The calling thread takes part, so this is safe to call from inside a pool task.
+     * The first exception thrown by func is rethrown on the calling thread.
+     * @param grain Number of consecutive indices claimed at a time.
+     */
+    template<typename F>
+    void parallelFor(size_t count, F&& func, size_t grain = 1) {
+        if (count == 0) return;
+        if (grain == 0) grain = 1;
+
+        // Shared state outlives this call in case a helper task is only scheduled after we return
+        struct State {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> done{0};
+            size_t count = 0;
+            size_t grain = 1;
+            std::function<void(size_t)> func;
+            std::mutex mutex;
+            std::condition_variable finished;
+            std::exception_ptr error;
+        };
+        auto state = std::make_shared<State>();
+        state->count = count;
+        state->grain = grain;
+        state->func = std::forward<F>(func);
+
+        auto run = [](const std::shared_ptr<State>& s) {
+            for (;;) {
+                size_t begin = s->next.fetch_add(s->grain);
+                if (begin >= s->count) return;
+                size_t end = std::min(begin + s->grain, s->count);
+                try {
+                    for (size_t i = begin; i < end; ++i) s->func(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(s->mutex);
+                    if (!s->error) s->error = std::current_exception();
+                }
+                if (s->done.fetch_add(end - begin) + (end - begin) == s->count) {
+                    std::lock_guard<std::mutex> lock(s->mutex);
+                    s->finished.notify_all();
+                }
+            }
+        };
+
+        const size_t chunks = (count + grain - 1) / grain;
+        const size_t helpers = std::min(size(), chunks > 0 ? chunks - 1 : 0);
+        for (size_t h = 0; h < helpers; ++h) {
+            enqueue([state, run]() { run(state); });
+        }
+        run(state);
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&]() { return state->done.load() >= state->count; });
+        if (state->error) std::rethrow_exception(state->error);
+    }
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void enqueue(std::function<void()> task);
+    bool tryTake(size_t self, std::function<void()>& out);
+    void workerLoop(size_t self);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> nextQueue_{0};
+    std::atomic<size_t> queuedTasks_{0};
+    std::atomic<bool> stopping_{false};
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+};
@@ -0,0 +1,89 @@
+#include "tick_scheduler.h"
+
+#include <algorithm>
+#include <exception>
+
+#include "log.h"
+#include "trace.h"
+
+void TickScheduler::addPhase(const std::string& name, Clock::duration budget, Phase run) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry entry;
+    entry.stats.name = name;
+    entry.stats.budget = budget;
+    entry.run = std::move(run);
+    entry.duration = &metricHistogram("blocktest_tick_phase_seconds", "Time spent in one run of a tick phase", {{"phase", name}});
+    entry.overrunCount = &metricCounter("blocktest_tick_phase_overruns_total", "Tick phase runs that finished past their deadline", {{"phase", name}});
+    phases_.push_back(std::move(entry));
+}
+
+bool TickScheduler::setBudget(const std::string& name, Clock::duration budget) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& phase : phases_) {
+        if (phase.stats.name == name) {
+            phase.stats.budget = budget;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TickScheduler::runTick() {
+    Clock::time_point deadline = Clock::now();
+    for (size_t i = 0; i < phases_.size(); ++i) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            deadline += phases_[i].stats.budget;
+        }
+        const auto started = Clock::now();
+        bool pending = false;
+        try {
+            TraceSpan span(phases_[i].stats.name);
+            pending = phases_[i].run(deadline);
+        } catch (const std::exception& e) {
+            LOG_ERROR("Error in tick phase " << phases_[i].stats.name << ": " << e.what());
+        }
+        const auto finished = Clock::now();
+        phases_[i].duration->observe(finished - started);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry& phase = phases_[i];
+        TickPhaseStats& stats = phase.stats;
+        stats.lastDuration = finished - started;
+        stats.worstDuration = std::max(stats.worstDuration, stats.lastDuration);
+        ++stats.runs;
+        stats.pending = pending;
+        if (pending) {
+            ++stats.carriedOver;
+        }
+        if (finished > deadline) {
+            ++stats.overruns;
+            phase.overrunCount->add();
+            if (finished - phase.lastReport >= TICK_OVERRUN_REPORT_INTERVAL) {
+                phase.lastReport = finished;
+                LOG_WARN("Tick phase " << stats.name << " overran its deadline by "
+                         << std::chrono::duration_cast<std::chrono::microseconds>(finished - deadline).count() << "us ("
+                         << std::chrono::duration_cast<std::chrono::microseconds>(stats.lastDuration).count() << "us against a "
+                         << std::chrono::duration_cast<std::chrono::microseconds>(stats.budget).count() << "us budget, "
+                         << stats.overruns << " overruns so far)");
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++ticks_;
+}
+
+std::vector<TickPhaseStats> TickScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<TickPhaseStats> result;
+    result.reserve(phases_.size());
+    for (const auto& phase : phases_) {
+        result.push_back(phase.stats);
+    }
+    return result;
+}
+
+uint64_t TickScheduler::tickCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ticks_;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "metrics.h"
+
+// Least time between two overrun reports for the same phase
+constexpr auto TICK_OVERRUN_REPORT_INTERVAL = std::chrono::seconds(5);
+
+// What a phase has done so far, for logs and tests
+struct TickPhaseStats {
+    std::string name;
+    std::chrono::steady_clock::duration budget{};
+    std::chrono::steady_clock::duration lastDuration{};
+    std::chrono::steady_clock::duration worstDuration{};
+    uint64_t runs = 0;
+    // Runs that finished past their deadline
+    uint64_t overruns = 0;
+    // Runs that stopped with work left for the next tick
+    uint64_t carriedOver = 0;
+    // The last run left work
+    bool pending = false;
+};
+
+/**
+ * @brief Runs a fixed list of phases, in the order they were added, once per tick.
+ *
+ * Each phase gets a deadline of tick start plus the budgets of it and every phase before it, so
+ * time a phase leaves unused goes to the next while one that runs long only eats into the rest.
+ * Phases stop when they reach their deadline and return true to say work is left; they pick it up
+ * where they stopped on the next tick. Phases that finish past their deadline anyway are counted
+ * and logged as warnings, at most once per TICK_OVERRUN_REPORT_INTERVAL each. Durations and
+ * overruns also go to blocktest_tick_phase_* metrics labelled by phase name. The scheduler
+ * owns no thread: call runTick() at the tick rate from whichever thread owns the state the phases
+ * touch. addPhase() must not race runTick(); budgets and stats are safe from any thread.
+ */
+class TickScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Gets the time to stop by; true when it stopped with work left
+    using Phase = std::function<bool(Clock::time_point deadline)>;
+
+    void addPhase(const std::string& name, Clock::duration budget, Phase run);
+    // False when there is no phase by that name
+    bool setBudget(const std::string& name, Clock::duration budget);
+
+    void runTick();
+
+    std::vector<TickPhaseStats> stats() const;
+    uint64_t tickCount() const;
+
+private:
+    struct Entry {
+        TickPhaseStats stats;
+        Phase run;
+        Clock::time_point lastReport{};
+        MetricHistogram* duration = nullptr;
+        MetricCounter* overrunCount = nullptr;
+    };
+
+    std::vector<Entry> phases_;
+    uint64_t ticks_ = 0;
+    mutable std::mutex mutex_; // guards budgets, stats and ticks_, never held while a phase runs
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Hierarchical timer wheel: schedule() and the per-timer share of advance() are O(1)
+ * however many timers are pending.
+ *
+ * Four levels of 64 slots; level L slots each span 64^L ticks. A timer lands in the lowest level
+ * whose span reaches its deadline and moves down a level each time the wheel turns past its slot,
+ * so only timers that are about to fire are ever touched. A timer fires on the first advance() at
+ * or past its deadline rounded up to a tick, never before it, except that deadlines past the
+ * wheel's range (64^4 ticks) fire at the end of it; check the real deadline when a timer fires.
+ * There is no cancel: let a stale timer fire and ignore it. Not synchronized.
+ */
+template<typename T>
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TimerWheel(Clock::duration tick, Clock::time_point start = Clock::now()) : tick_(tick), start_(start) {}
+
+    void schedule(T value, Clock::time_point deadline) {
+        uint64_t due = tickOf(deadline);
+        // Already due: fire on the next advance
+        if (due <= current_) {
+            due = current_ + 1;
+        }
+        due = std::min(due, current_ + RANGE - 1);
+        place(Entry{std::move(value), due});
+        ++size_;
+    }
+
+    // Turns the wheel up to now, appending the value of every timer that came due to expired
+    void advance(Clock::time_point now, std::vector<T>& expired) {
+        const uint64_t target = now < start_ ? 0 : static_cast<uint64_t>((now - start_) / tick_);
+        while (current_ < target) {
+            if (size_ == 0) {
+                // Nothing to cascade or fire; jump straight there
+                current_ = target;
+                return;
+            }
+            ++current_;
+            // Each level's slot is cascaded when every level below it wraps
+            for (size_t level = 1; level < LEVELS && (current_ & ((uint64_t{1} << (SLOT_BITS * level)) - 1)) == 0; ++level) {
+                auto& slot = levels_[level][(current_ >> (SLOT_BITS * level)) & SLOT_MASK];
+                std::vector<Entry> cascading;
+                cascading.swap(slot);
+                for (auto& entry : cascading) {
+                    place(std::move(entry));
+                }
+            }
+            auto& slot = levels_[0][current_ & SLOT_MASK];
+            for (auto& entry : slot) {
+                expired.push_back(std::move(entry.value));
+            }
+            size_ -= slot.size();
+            slot.clear();
+        }
+    }
+
+    size_t size() const { return size_; }
+    Clock::duration tick() const { return tick_; }
+
+private:
+    static constexpr size_t SLOT_BITS = 6;
+    static constexpr size_t SLOTS = size_t{1} << SLOT_BITS;
+    static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+    static constexpr size_t LEVELS = 4;
+    static constexpr uint64_t RANGE = uint64_t{1} << (SLOT_BITS * LEVELS);
+
+    struct Entry {
+        T value;
+        uint64_t due;
+    };
+
+    // Rounded up, so a timer never fires before its deadline's tick
+    uint64_t tickOf(Clock::time_point time) const {
+        if (time <= start_) {
+            return 0;
+        }
+        return static_cast<uint64_t>((time - start_ + tick_ - Clock::duration(1)) / tick_);
+    }
+
+    void place(Entry entry) {
+        const uint64_t delta = entry.due - current_;
+        size_t level = 0;
+        while (level + 1 < LEVELS && delta >= (uint64_t{1} << (SLOT_BITS * (level + 1)))) {
+            ++level;
+        }
+        levels_[level][(entry.due >> (SLOT_BITS * level)) & SLOT_MASK].push_back(std::move(entry));
+    }
+
+    const Clock::duration tick_;
+    const Clock::time_point start_;
+    // Ticks since start that have been processed
+    uint64_t current_ = 0;
+    size_t size_ = 0;
+    std::array<std::array<std::vector<Entry>, SLOTS>, LEVELS> levels_;
+};
@@ -0,0 +1,80 @@
+#include "trace.h"
+
+#include <atomic>
+
+namespace {
+
+// Small stable ids make the trace viewer's thread rows readable
+uint32_t currentThreadId() {
+    static std::atomic<uint32_t> nextId{1};
+    thread_local const uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+void appendJsonString(std::string& out, const std::string& text) {
+    out += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+} // namespace
+
+Tracer& Tracer::global() {
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::start(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    spans_.clear();
+    spans_.reserve(capacity);
+    capacity_ = capacity;
+    next_ = 0;
+    epoch_ = std::chrono::steady_clock::now();
+    enabled_.store(capacity > 0, std::memory_order_relaxed);
+}
+
+void Tracer::stop() {
+    enabled_.store(false, std::memory_order_relaxed);
+}
+
+void Tracer::record(std::string_view name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::duration duration) {
+    const uint32_t threadId = currentThreadId();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (capacity_ == 0) {
+        return;
+    }
+    Span span{std::string(name),
+              std::chrono::duration_cast<std::chrono::microseconds>(start - epoch_).count(),
+              std::chrono::duration_cast<std::chrono::microseconds>(duration).count(),
+              threadId};
+    if (spans_.size() < capacity_) {
+        spans_.push_back(std::move(span));
+    } else {
+        spans_[next_] = std::move(span);
+        next_ = (next_ + 1) % capacity_;
+    }
+}
+
+std::string Tracer::chromeTraceJson() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string out = "{\"traceEvents\":[";
+    for (size_t i = 0; i < spans_.size(); ++i) {
+        const Span& span = spans_[(next_ + i) % spans_.size()];
+        if (i > 0) {
+            out += ',';
+        }
+        out += "{\"name\":";
+        appendJsonString(out, span.name);
+        out += ",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(span.threadId) +
+               ",\"ts\":" + std::to_string(span.startMicros) +
+               ",\"dur\":" + std::to_string(span.durationMicros) + '}';
+    }
+    out += "],\"displayTimeUnit\":\"ms\"}";
+    return out;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Spans kept by Tracer::start() unless told otherwise; older ones are overwritten
+constexpr size_t TRACE_DEFAULT_CAPACITY = 65536;
+
+/**
+ * @brief Process-wide recorder of timed spans, exported in the Chrome trace event format
+ * (chrome://tracing, Perfetto). Off until start(); while off a TraceSpan costs one relaxed load.
+ * Spans go into a fixed ring under a mutex, so tracing is for diagnosis rather than always-on use.
+ */
+class Tracer {
+public:
+    static Tracer& global();
+
+    // Starts recording into a fresh ring of capacity spans
+    void start(size_t capacity = TRACE_DEFAULT_CAPACITY);
+    void stop();
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    void record(std::string_view name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::duration duration);
+    // {"traceEvents": [...]} with one complete ("X") event per recorded span, oldest first
+    std::string chromeTraceJson() const;
+
+private:
+    struct Span {
+        std::string name;
+        int64_t startMicros;
+        int64_t durationMicros;
+        uint32_t threadId;
+    };
+
+    std::atomic<bool> enabled_{false};
+    mutable std::mutex mutex_;
+    std::vector<Span> spans_;
+    size_t capacity_ = 0;
+    size_t next_ = 0; // where the next span goes once spans_ is full
+    std::chrono::steady_clock::time_point epoch_{};
+};
+
+// Records the time from construction to destruction as a span named name, when tracing is on;
+// name must outlive the span
+class TraceSpan {
+public:
+    explicit TraceSpan(std::string_view name)
+        : name_(name), active_(Tracer::global().enabled()) {
+        if (active_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+    ~TraceSpan() {
+        if (active_) {
+            Tracer::global().record(name_, start_, std::chrono::steady_clock::now() - start_);
+        }
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const std::string_view name_;
+    const bool active_;
+    std::chrono::steady_clock::time_point start_{};
+};
@@ -1,12 +1,46 @@
 #include "world.h"
+#include "chunk_arena.h"
 #include "chunkspan.h"
 #include "chunktransform.h"
 #include "name_component.h"
 #include "player_session.h"
-#include <cmath>
+#include "thread_pool.h"
+#include "chunk_residency.h"
+#include "chunk_write_behind.h"
+#include "concurrent_chunk_map.h"
+#include "log.h"
+#include "metrics.h"
+#include "trace.h"
+#include "world_checkpoint.h"
 #include <algorithm>
-#include <set>
 #include <iostream>
+#include <unordered_set>
+
+namespace {
+
+// Process-wide; a server runs one World, so the depth gauges describe it
+struct WorldMetrics {
+    MetricHistogram& generateSeconds = metricHistogram("blocktest_chunk_generate_seconds", "Time to generate one chunk");
+    MetricHistogram& loadBatchSeconds = metricHistogram("blocktest_chunk_load_batch_seconds", "Time to read one batch of chunks from persistence");
+    MetricCounter& loadedFromWriteBehind = metricCounter("blocktest_chunks_loaded_total", "Chunks loaded, by where they came from", {{"source", "write_behind"}});
+    MetricCounter& loadedFromPersistence = metricCounter("blocktest_chunks_loaded_total", "Chunks loaded, by where they came from", {{"source", "persistence"}});
+    MetricCounter& loadedByGeneration = metricCounter("blocktest_chunks_loaded_total", "Chunks loaded, by where they came from", {{"source", "generated"}});
+    MetricGauge& loadQueueDepth = metricGauge("blocktest_chunk_load_queue_depth", "Chunks queued for loading by the anchors");
+    MetricGauge& demandQueueDepth = metricGauge("blocktest_chunk_demand_queue_depth", "Chunks requested on demand and not yet loaded");
+    MetricGauge& loadedChunks = metricGauge("blocktest_loaded_chunks", "Chunks currently loaded");
+    MetricGauge& chunkArenaBytes = metricGauge("blocktest_chunk_arena_bytes", "Bytes the shared chunk arena and block storage pool hold in slabs");
+};
+
+WorldMetrics& worldMetrics() {
+    static WorldMetrics metrics;
+    return metrics;
+}
+
+size_t pooledChunkBytes() {
+    return ChunkArena::shared().reservedBytes() + BlockStoragePool::shared().reservedBytes();
+}
+
+} // namespace
 
 World::World(
     std::shared_ptr<IWorldgenStrategy> chunkGenerator,
@@ -14,163 +48,516 @@ World::World(
     size_t loadAnchorRadiusInChunks,
     size_t seed,
     std::shared_ptr<IChunkPersistence> persistence)
-    : chunkGenerator_(chunkGenerator), 
+    : chunks_(std::make_unique<ConcurrentChunkMap>()),
+      chunkGenerator_(chunkGenerator), 
       loadAnchors_(loadAnchors), 
       loadAnchorRadiusInChunks_(loadAnchorRadiusInChunks), 
       seed_(seed), 
-      persistence_(persistence) {
+      persistence_(persistence),
+      residency_(std::make_unique<ChunkResidency>(static_cast<int32_t>(loadAnchorRadiusInChunks))) {
+    if (persistence_) {
+        writeBehind_ = std::make_unique<ChunkWriteBehind>(persistence_);
+    }
+}
+
+bool IChunkPersistence::saveChunks(const std::vector<std::shared_ptr<const ChunkSpan>>& chunks) {
+    bool success = true;
+    for (const auto& chunk : chunks) {
+        if (chunk && !saveChunk(*chunk)) {
+            success = false;
+        }
+    }
+    return success;
 }
 
-std::optional<std::shared_ptr<ChunkSpan>> World::chunkAt(const AbsoluteChunkPosition pos) const {
-    auto it = chunks_.find(pos);
-    if (it != chunks_.end()) {
-        return it->second;
+std::vector<std::optional<std::shared_ptr<ChunkSpan>>> IChunkPersistence::loadChunks(std::span<const AbsoluteChunkPosition> positions) {
+    std::vector<std::optional<std::shared_ptr<ChunkSpan>>> result;
+    result.reserve(positions.size());
+    for (const auto& pos : positions) {
+        result.push_back(loadChunk(pos));
+    }
+    return result;
+}
+
+std::vector<std::optional<ChunkSerializationSparseVector>> IChunkPersistence::loadSerializedChunks(std::span<const AbsoluteChunkPosition> positions) {
+    std::vector<std::optional<ChunkSerializationSparseVector>> result;
+    result.reserve(positions.size());
+    for (auto& chunk : loadChunks(positions)) {
+        result.push_back(chunk ? std::optional((*chunk)->serialize()) : std::nullopt);
+    }
+    return result;
+}
+
+std::optional<std::shared_ptr<const ChunkSpan>> World::chunkAt(const AbsoluteChunkPosition pos) const {
+    auto chunk = chunks_->find(pos);
+    if (chunk) {
+        return chunk;
     }
     return std::nullopt;
 }
 
+bool World::chunksLoadedIn(const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max) const {
+    return chunks_->anyLoadedIn(min, max);
+}
+
+void World::syncAnchors() {
+    // Callback anchors are keyed by their index; player entities by their entity id
+    constexpr ChunkResidency::AnchorId kCallbackAnchorTag = ChunkResidency::AnchorId{1} << 32;
+
+    std::vector<AbsoluteBlockPosition> anchors = loadAnchors_();
+    for (size_t i = 0; i < anchors.size(); ++i) {
+        residency_->updateAnchor(kCallbackAnchorTag | i, toAbsoluteChunk(anchors[i]));
+    }
+    // A shrunk anchor list releases the spheres it dropped
+    for (size_t i = anchors.size(); i < callbackAnchorCount_; ++i) {
+        residency_->removeAnchor(kCallbackAnchorTag | i);
+    }
+    callbackAnchorCount_ = anchors.size();
+
+    // Player entities anchor the chunks around them too; only those that changed chunk (or spawned
+    // or despawned) since the last call need telling
+    std::lock_guard<std::mutex> lock(entityMutex_);
+    for (auto entity : entityIndex_.takeChunkChanges()) {
+        ChunkResidency::AnchorId id = static_cast<std::underlying_type_t<entt::entity>>(entity);
+        if (auto chunk = entityIndex_.chunkOf(entity)) {
+            residency_->updateAnchor(id, *chunk);
+        } else {
+            residency_->removeAnchor(id);
+        }
+    }
+}
+
 void World::ensureChunksLoaded() {
     if (!loadAnchors_) {
         return;
     }
-    
-    // Get load anchors
-    std::vector<AbsoluteBlockPosition> anchors = loadAnchors_();
+    queueChunkLoads();
+    loadQueuedChunks(std::chrono::steady_clock::time_point::max());
+}
 
-    // query for name components to load player entities in those chunks
-    auto view = entityRegistry_.view<NameComponent, AbsolutePrecisePosition>();
-    for (auto entity : view) {
-        const auto& pos = view.get<AbsolutePrecisePosition>(entity);
-        anchors.push_back(toAbsoluteBlock(pos));
+size_t World::queueChunkLoads() {
+    if (!loadAnchors_) {
+        return 0;
     }
 
-    
-    // Convert anchors to chunk positions and collect all chunks to load
-    std::set<AbsoluteChunkPosition, std::function<bool(const AbsoluteChunkPosition&, const AbsoluteChunkPosition&)>> 
-        chunksToLoad([](const AbsoluteChunkPosition& a, const AbsoluteChunkPosition& b) {
-            if (a.x != b.x) return a.x < b.x;
-            if (a.y != b.y) return a.y < b.y;
-            return a.z < b.z;
+    syncAnchors();
+
+    // Only chunks that entered some anchor's sphere since the last call can be missing
+    for (const auto& chunkPos : residency_->takePendingLoads()) {
+        if (queuedLoads_.insert(chunkPos).second) {
+            loadQueue_.push_back(chunkPos);
+        }
+    }
+    worldMetrics().loadQueueDepth.set(static_cast<int64_t>(loadQueue_.size()));
+    return loadQueue_.size();
+}
+
+bool World::loadQueuedChunks(std::chrono::steady_clock::time_point deadline) {
+    // Without a deadline everything goes in one batch; otherwise the deadline is checked between
+    // batches sized to keep the pool busy, and the first batch always runs so every call progresses
+    const bool unbounded = deadline == std::chrono::steady_clock::time_point::max();
+    const size_t batchSize = unbounded ? loadQueue_.size() : CHUNK_LOAD_BATCH_PER_THREAD * getGenerationThreads();
+    do {
+        std::vector<AbsoluteChunkPosition> missing;
+        while (!loadQueue_.empty() && missing.size() < batchSize) {
+            AbsoluteChunkPosition chunkPos = loadQueue_.front();
+            loadQueue_.pop_front();
+            queuedLoads_.erase(chunkPos);
+            // Skip chunks that left every sphere while queued, or were loaded meanwhile
+            if (residency_->isResident(chunkPos) && !chunks_->contains(chunkPos)) {
+                missing.push_back(chunkPos);
+            }
+        }
+        loadChunks(missing);
+    } while (!loadQueue_.empty() && std::chrono::steady_clock::now() < deadline);
+    worldMetrics().loadQueueDepth.set(static_cast<int64_t>(loadQueue_.size()));
+    return !loadQueue_.empty();
+}
+
+bool World::saveDirtyChunks(std::chrono::steady_clock::time_point deadline) {
+    if (!writeBehind_) {
+        return false;
+    }
+    std::vector<std::shared_ptr<const ChunkSpan>> dirty;
+    do {
+        chunks_->takeDirty(saveCursor_, dirty);
+        for (auto& chunk : dirty) {
+            writeBehind_->enqueue(std::move(chunk));
+        }
+        dirty.clear();
+        saveCursor_ = (saveCursor_ + 1) % CONCURRENT_CHUNK_MAP_SHARDS;
+    } while (saveCursor_ != 0 && std::chrono::steady_clock::now() < deadline);
+    return saveCursor_ != 0;
+}
+
+bool World::saveCheckpoint(const std::filesystem::path& path) const {
+    WorldCheckpoint checkpoint;
+    checkpoint.chunkLoadEpoch = chunkLoadEpoch_;
+    chunks_->forEach([&](const AbsoluteChunkPosition&, const ConcurrentChunkMap::Entry& entry) {
+        checkpoint.chunks.push_back(WorldCheckpointChunk{entry.chunk, entry.dirty});
+    });
+    {
+        // Sessions and registry from one moment, so every saved session's entity is in the snapshot
+        std::lock_guard<std::mutex> lock(entityMutex_);
+        sessionManager_.forEachActiveSession([&](const PlayerSession& session) {
+            checkpoint.sessions.push_back(WorldCheckpointSession{session.sessionToken, session.playerName, session.playerEntity, session.position});
         });
-    
-    const int32_t radius = static_cast<int32_t>(loadAnchorRadiusInChunks_);
-    
-    for (const auto& anchor : anchors) {
-        AbsoluteChunkPosition anchorChunk = toAbsoluteChunk(anchor);
-        
-        // Add all chunks within the radius
-        for (int32_t dx = -radius; dx <= radius; dx++) {
-            for (int32_t dy = -radius; dy <= radius; dy++) {
-                for (int32_t dz = -radius; dz <= radius; dz++) {
-                    // Check if within spherical radius
-                    double distance = std::sqrt(dx*dx + dy*dy + dz*dz);
-                    if (distance <= radius) {
-                        AbsoluteChunkPosition chunkPos = {
-                            anchorChunk.x + dx,
-                            anchorChunk.y + dy,
-                            anchorChunk.z + dz
-                        };
-                        chunksToLoad.insert(chunkPos);
-                    }
-                }
+        checkpoint.registry = encodeRegistrySnapshot(entityRegistry_);
+    }
+    return writeWorldCheckpoint(path, checkpoint);
+}
+
+bool World::restoreCheckpoint(const std::filesystem::path& path) {
+    auto checkpoint = readWorldCheckpoint(path);
+    if (!checkpoint) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(entityMutex_);
+        if (!entityRegistry_.view<AbsolutePrecisePosition>().empty()) {
+            LOG_ERROR("Not restoring checkpoint " << path << " into a world that already has entities");
+            return false;
+        }
+        if (!decodeRegistrySnapshot(checkpoint->registry, entityRegistry_)) {
+            entityRegistry_.clear();
+            return false;
+        }
+    }
+
+    // With persistence the checkpoint is used up: its edited chunks are saved now and the file goes
+    // once restored, so a crash later in this run can't bring them back over what this run saves
+    bool consumed = false;
+    if (persistence_) {
+        std::vector<std::shared_ptr<const ChunkSpan>> edited;
+        for (const auto& entry : checkpoint->chunks) {
+            if (entry.dirty) {
+                edited.push_back(entry.chunk);
             }
         }
+        consumed = edited.empty() || persistence_->saveChunks(edited);
+        if (!consumed) {
+            LOG_ERROR("Failed to save the edited chunks of checkpoint " << path << ", keeping it");
+        }
     }
-    
-    // Load chunks that aren't already loaded
-    for (const auto& chunkPos : chunksToLoad) {
-        if (chunks_.find(chunkPos) == chunks_.end()) {
-            std::shared_ptr<ChunkSpan> chunk = nullptr;
-            
-            // Try to load from persistence first
-            if (persistence_) {
-                auto persistedChunk = persistence_->loadChunk(chunkPos);
-                if (persistedChunk.has_value()) {
-                    chunk = persistedChunk.value();
-                }
+
+    // Restored chunks get leases like demand loads, so ones no anchor claims are unloaded after the linger
+    uint64_t epoch = checkpoint->chunkLoadEpoch;
+    {
+        std::lock_guard<std::mutex> lock(demandMutex_);
+        const auto now = std::chrono::steady_clock::now();
+        for (auto& entry : checkpoint->chunks) {
+            const AbsoluteChunkPosition pos = entry.chunk->position;
+            epoch = std::max(epoch, entry.chunk->version() >> 32);
+            if (chunks_->insert(pos, std::move(entry.chunk), entry.dirty && !consumed)) {
+                demandLeases_[pos] = now;
+            }
+        }
+    }
+    chunkLoadEpoch_ = epoch;
+    worldMetrics().loadedChunks.set(static_cast<int64_t>(chunks_->size()));
+    worldMetrics().chunkArenaBytes.set(static_cast<int64_t>(pooledChunkBytes()));
+
+    std::lock_guard<std::mutex> lock(entityMutex_);
+    std::unordered_set<entt::entity> claimed;
+    for (const auto& session : checkpoint->sessions) {
+        if (entityRegistry_.valid(session.playerEntity)
+            && sessionManager_.restoreSession(session.token, session.playerName, session.playerEntity, session.position)) {
+            claimed.insert(session.playerEntity);
+        }
+    }
+    // Players whose sessions had already lapsed have nobody left to clean them up
+    std::vector<entt::entity> orphans;
+    for (auto entity : entityRegistry_.view<NameComponent>()) {
+        if (!claimed.contains(entity)) {
+            orphans.push_back(entity);
+        }
+    }
+    for (auto entity : orphans) {
+        entityRegistry_.destroy(entity);
+    }
+    for (auto entity : entityRegistry_.view<AbsolutePrecisePosition>()) {
+        entityChangedLocked(entity);
+    }
+    LOG_INFO("Restored checkpoint " << path << ": " << checkpoint->chunks.size() << " chunks, " << claimed.size() << " sessions");
+    if (consumed) {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+        if (error) {
+            LOG_ERROR("Failed to remove restored checkpoint " << path << ": " << error.message());
+        }
+    }
+    return true;
+}
+
+std::shared_future<std::shared_ptr<const ChunkSpan>> World::requestChunkLoad(const AbsoluteChunkPosition& pos) {
+    std::lock_guard<std::mutex> lock(demandMutex_);
+    // Loads publish the chunk before dropping its entry here, so one of the two is always seen
+    auto queued = demanded_.find(pos);
+    if (queued != demanded_.end()) {
+        return queued->second->future;
+    }
+    if (auto chunk = chunks_->find(pos)) {
+        auto lease = demandLeases_.find(pos);
+        if (lease != demandLeases_.end()) {
+            lease->second = std::chrono::steady_clock::now();
+        }
+        std::promise<std::shared_ptr<const ChunkSpan>> loaded;
+        loaded.set_value(std::move(chunk));
+        return loaded.get_future().share();
+    }
+    auto entry = std::make_shared<DemandedChunk>();
+    demanded_.emplace(pos, entry);
+    demandQueue_.push_back(pos);
+    worldMetrics().demandQueueDepth.set(static_cast<int64_t>(demandQueue_.size()));
+    return entry->future;
+}
+
+std::vector<AbsoluteChunkPosition> World::loadDemandedChunks(std::chrono::steady_clock::time_point deadline) {
+    const size_t batchSize = CHUNK_LOAD_BATCH_PER_THREAD * getGenerationThreads();
+    std::vector<AbsoluteChunkPosition> published;
+    do {
+        std::vector<AbsoluteChunkPosition> batch;
+        {
+            std::lock_guard<std::mutex> lock(demandMutex_);
+            while (!demandQueue_.empty() && batch.size() < batchSize) {
+                batch.push_back(demandQueue_.front());
+                demandQueue_.pop_front();
             }
-            
-            // If not in persistence, generate the chunk
-            if (!chunk && chunkGenerator_) {
-                auto transform = chunkGenerator_->generateChunk(chunkPos, seed_);
-                if (transform) {
-                    // Create an empty chunk and apply the transform
-                    chunk = std::make_shared<ChunkSpan>(chunkPos);
-                    transform->apply(*chunk);
-                }
+            worldMetrics().demandQueueDepth.set(static_cast<int64_t>(demandQueue_.size()));
+        }
+        if (batch.empty()) {
+            break;
+        }
+        std::vector<AbsoluteChunkPosition> missing;
+        for (const auto& chunkPos : batch) {
+            if (!chunks_->contains(chunkPos)) {
+                missing.push_back(chunkPos);
             }
-            
-            // If we still don't have a chunk, create an empty one
-            if (!chunk) {
-                chunk = std::make_shared<ChunkSpan>(chunkPos);
+        }
+        loadChunks(missing);
+
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(demandMutex_);
+        for (const auto& chunkPos : batch) {
+            auto entry = demanded_.find(chunkPos);
+            if (entry != demanded_.end()) {
+                entry->second->promise.set_value(chunks_->find(chunkPos));
+                demanded_.erase(entry);
             }
-            
-            chunks_[chunkPos] = chunk;
+            demandLeases_[chunkPos] = now;
+        }
+        published.insert(published.end(), missing.begin(), missing.end());
+    } while (std::chrono::steady_clock::now() < deadline);
+    return published;
+}
+
+bool World::hasDemandedChunks() const {
+    std::lock_guard<std::mutex> lock(demandMutex_);
+    return !demandQueue_.empty();
+}
+
+void World::setDemandChunkLinger(std::chrono::steady_clock::duration linger) {
+    std::lock_guard<std::mutex> lock(demandMutex_);
+    demandLinger_ = linger;
+}
+
+void World::loadChunks(const std::vector<AbsoluteChunkPosition>& missing) {
+    if (missing.empty()) {
+        return;
+    }
+    TraceSpan span("World::loadChunks");
+    WorldMetrics& metrics = worldMetrics();
+
+    std::vector<std::shared_ptr<ChunkSpan>> produced(missing.size());
+
+    // A save that hasn't reached persistence yet is newer than whatever persistence holds.
+    // Copy it: the writer thread may still be reading the queued one.
+    std::vector<AbsoluteChunkPosition> toRead;
+    std::vector<size_t> toReadIndex;
+    for (size_t i = 0; i < missing.size(); ++i) {
+        auto pendingChunk = writeBehind_ ? writeBehind_->pending(missing[i]) : std::nullopt;
+        if (pendingChunk.has_value()) {
+            produced[i] = makePooledChunk(**pendingChunk);
+            metrics.loadedFromWriteBehind.add();
+        } else {
+            toRead.push_back(missing[i]);
+            toReadIndex.push_back(i);
         }
     }
+
+    // Everything else is fetched from persistence in one batch, then decoded across the pool
+    if (persistence_ && !toRead.empty()) {
+        const auto started = std::chrono::steady_clock::now();
+        auto loaded = persistence_->loadSerializedChunks(toRead);
+        metrics.loadBatchSeconds.observe(std::chrono::steady_clock::now() - started);
+        const size_t count = std::min(loaded.size(), toReadIndex.size());
+        auto decode = [&](size_t j) {
+            if (!loaded[j]) {
+                return;
+            }
+            try {
+                produced[toReadIndex[j]] = makePooledChunk(std::span<const uint8_t>(*loaded[j]));
+            } catch (const std::exception& e) {
+                // Regenerated below, like a chunk persistence never had
+                LOG_ERROR("Failed to decode stored chunk (" << toRead[j].x << "," << toRead[j].y << "," << toRead[j].z << "): " << e.what());
+            }
+        };
+        if (generationPool_ && count > 1) {
+            generationPool_->parallelFor(count, decode);
+        } else {
+            for (size_t j = 0; j < count; ++j) {
+                decode(j);
+            }
+        }
+        for (size_t j = 0; j < count; ++j) {
+            if (produced[toReadIndex[j]]) {
+                metrics.loadedFromPersistence.add();
+            }
+        }
+    }
+
+    // Generate what persistence didn't have, fanning out across the pool when enabled
+    std::vector<size_t> toGenerate;
+    for (size_t i = 0; i < missing.size(); ++i) {
+        if (!produced[i]) {
+            toGenerate.push_back(i);
+        }
+    }
+    metrics.loadedByGeneration.add(toGenerate.size());
+    auto produce = [&](size_t j) { produced[toGenerate[j]] = generateChunk(missing[toGenerate[j]]); };
+    if (generationPool_ && toGenerate.size() > 1) {
+        generationPool_->parallelFor(toGenerate.size(), produce);
+    } else {
+        for (size_t j = 0; j < toGenerate.size(); ++j) {
+            produce(j);
+        }
+    }
+
+    // Publish all results; generated chunks aren't in persistence yet, so they start dirty
+    std::vector<char> generated(missing.size(), 0);
+    for (size_t i : toGenerate) {
+        generated[i] = 1;
+    }
+    // Every load starts a new version range, so versions of a position keep rising across unload and reload
+    const uint64_t loadVersion = ++chunkLoadEpoch_ << 32;
+    for (size_t i = 0; i < missing.size(); ++i) {
+        produced[i]->setVersion(loadVersion);
+        chunks_->insert(missing[i], std::move(produced[i]), generated[i] != 0);
+    }
+    metrics.loadedChunks.set(static_cast<int64_t>(chunks_->size()));
+    metrics.chunkArenaBytes.set(static_cast<int64_t>(pooledChunkBytes()));
+}
+
+std::shared_ptr<ChunkSpan> World::generateChunk(const AbsoluteChunkPosition& chunkPos) const {
+    if (chunkGenerator_) {
+        ScopedMetricTimer timer(worldMetrics().generateSeconds);
+        auto transform = chunkGenerator_->generateChunk(chunkPos, seed_);
+        if (transform) {
+            // Create an empty chunk and apply the transform, fused into one pass where possible
+            auto chunk = makePooledChunk(chunkPos);
+            compiledTransform(transform)->apply(*chunk);
+            // Drop palette entries the transforms overwrote, often collapsing to uniform
+            chunk->compact();
+            return chunk;
+        }
+    }
+
+    // Without a generator, create an empty chunk
+    return makePooledChunk(chunkPos);
+}
+
+std::shared_ptr<const ChunkTransform> World::compiledTransform(const std::shared_ptr<ChunkTransform>& transform) const {
+    {
+        std::lock_guard<std::mutex> lock(compiledMutex_);
+        if (transform == compiledSource_) {
+            return compiled_;
+        }
+    }
+    // Compile outside the lock so workers handed per-position transforms don't queue on it
+    std::shared_ptr<const ChunkTransform> compiled = transform->compile();
+    std::lock_guard<std::mutex> lock(compiledMutex_);
+    compiledSource_ = transform;
+    compiled_ = compiled;
+    return compiled;
+}
+
+void World::setGenerationThreads(size_t threadCount) {
+    if (threadCount <= 1) {
+        generationPool_.reset();
+    } else if (!generationPool_ || generationPool_->size() != threadCount) {
+        generationPool_ = std::make_unique<ThreadPool>(threadCount);
+    }
+}
+
+size_t World::getGenerationThreads() const {
+    return generationPool_ ? generationPool_->size() : 1;
 }
 
 void World::garbageCollectChunks() {
     if (!loadAnchors_) {
         return;
     }
-    
-    // Get load anchors
-    std::vector<AbsoluteBlockPosition> anchors = loadAnchors_();
-    
-    // Convert anchors to chunk positions
-    std::vector<AbsoluteChunkPosition> anchorChunks;
-    for (const auto& anchor : anchors) {
-        anchorChunks.push_back(toAbsoluteChunk(anchor));
-    }
-    
-    const double radius = static_cast<double>(loadAnchorRadiusInChunks_);
-    
-    // Find chunks to unload
+
+    syncAnchors();
+
+    // Only chunks that left every anchor's sphere since the last call are candidates
     std::vector<AbsoluteChunkPosition> chunksToUnload;
-    
-    for (const auto& [chunkPos, chunk] : chunks_) {
-        bool shouldKeep = false;
-        
-        // Check if chunk is within radius of any anchor
-        for (const auto& anchorChunk : anchorChunks) {
-            double dx = chunkPos.x - anchorChunk.x;
-            double dy = chunkPos.y - anchorChunk.y;
-            double dz = chunkPos.z - anchorChunk.z;
-            double distance = std::sqrt(dx*dx + dy*dy + dz*dz);
-            
-            if (distance <= radius) {
-                shouldKeep = true;
-                break;
+    for (const auto& chunkPos : residency_->takePendingUnloads()) {
+        if (!residency_->isResident(chunkPos)) {
+            chunksToUnload.push_back(chunkPos);
+        }
+    }
+    // So are demand-loaded chunks nobody has asked for in a while, unless a player is still near
+    // enough to be using them
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<AbsoluteChunkPosition> lapsed;
+    {
+        std::lock_guard<std::mutex> lock(demandMutex_);
+        for (const auto& [chunkPos, lastRequest] : demandLeases_) {
+            if (now - lastRequest >= demandLinger_) {
+                lapsed.push_back(chunkPos);
             }
         }
-        
-        if (!shouldKeep) {
-            chunksToUnload.push_back(chunkPos);
+    }
+    if (!lapsed.empty()) {
+        std::vector<AbsoluteChunkPosition> players;
+        sessionManager_.forEachActiveSession([&](const PlayerSession& session) {
+            players.push_back(toAbsoluteChunk(session.position));
+        });
+        std::lock_guard<std::mutex> lock(demandMutex_);
+        for (const auto& chunkPos : lapsed) {
+            auto lease = demandLeases_.find(chunkPos);
+            if (lease == demandLeases_.end()) {
+                continue;
+            }
+            const bool nearPlayer = std::any_of(players.begin(), players.end(), [&](const AbsoluteChunkPosition& player) {
+                return std::abs(chunkPos.x - player.x) <= DEMAND_LOAD_RADIUS && std::abs(chunkPos.y - player.y) <= DEMAND_LOAD_RADIUS
+                    && std::abs(chunkPos.z - player.z) <= DEMAND_LOAD_RADIUS;
+            });
+            if (nearPlayer) {
+                lease->second = now;
+                continue;
+            }
+            demandLeases_.erase(lease);
+            if (!residency_->isResident(chunkPos)) {
+                chunksToUnload.push_back(chunkPos);
+            }
         }
     }
     
-    // Save chunks to persistence and unload them
+    // Queue dirty chunks for saving and unload them; clean chunks are just dropped
     for (const auto& chunkPos : chunksToUnload) {
-        auto it = chunks_.find(chunkPos);
-        if (it != chunks_.end()) {
-            // Save to persistence if available
-            if (persistence_) {
-                persistence_->saveChunk(*it->second);
-            }
-            
-            // Remove from memory
-            chunks_.erase(it);
+        auto removed = chunks_->erase(chunkPos);
+        if (removed && removed->dirty && writeBehind_) {
+            writeBehind_->enqueue(std::move(removed->chunk));
         }
     }
+    worldMetrics().loadedChunks.set(static_cast<int64_t>(chunks_->size()));
+    worldMetrics().chunkArenaBytes.set(static_cast<int64_t>(pooledChunkBytes()));
 }
 
 const std::optional<std::shared_ptr<const ChunkSpan>> World::getChunkIfLoaded(const AbsoluteChunkPosition& pos) const {
-    auto it = chunks_.find(pos);
-    if (it != chunks_.end()) {
-        return std::const_pointer_cast<const ChunkSpan>(it->second);
-    }
-    return std::nullopt;
+    return chunkAt(pos);
 }
 
 const std::optional<Block> World::getBlockIfLoaded(const AbsoluteBlockPosition& pos) const {
@@ -192,52 +579,127 @@ const std::optional<Block> World::getBlockIfLoaded(const AbsoluteBlockPosition&
     return chunk->getBlock(localPos);
 }
 
+std::optional<WorldgenSurface> World::surfaceAt(int64_t worldX, int64_t worldZ) const {
+    if (!chunkGenerator_) {
+        return std::nullopt;
+    }
+    return chunkGenerator_->surfaceAt(worldX, worldZ, seed_);
+}
+
 World::~World() {
-    // Save all loaded chunks to persistence before destroying
-    if (persistence_) {
-        persistence_->saveAllLoadedChunks(chunks_);
+    if (!persistence_) {
+        return;
     }
+    // Let queued unloads land first so they can't overwrite anything saved below
+    writeBehind_->flush();
+
+    // Only chunks changed since they were loaded need saving
+    ChunkMap dirty;
+    chunks_->forEach([&](const AbsoluteChunkPosition& chunkPos, const ConcurrentChunkMap::Entry& entry) {
+        if (entry.dirty) {
+            dirty.emplace(chunkPos, entry.chunk);
+        }
+    });
+    persistence_->saveAllLoadedChunks(dirty);
 }
 
-bool World::setBlockIfLoaded(const AbsoluteBlockPosition& pos, Block block) {
+bool World::setBlockIfLoaded(const AbsoluteBlockPosition& pos, Block block, BlockEditResult* result) {
     // Convert to chunk position
     AbsoluteChunkPosition chunkPos = toAbsoluteChunk(pos);
     
-    // Check if chunk is loaded (get mutable reference)
-    auto it = chunks_.find(chunkPos);
-    if (it == chunks_.end()) {
-        return false;
-    }
-    
-    auto& chunk = it->second;
-    
     // Convert to local position within the chunk
     ChunkLocalPosition localPos = toChunkLocal(pos, chunkPos);
     
-    // Set the block in the chunk
-    chunk->setBlock(localPos, block);
+    // Set the block on a copy of the chunk and publish it if it changed; fails if the chunk isn't loaded
+    bool loaded = false;
+    chunks_->update(chunkPos, [&](ChunkSpan& chunk) {
+        loaded = true;
+        const uint64_t before = chunk.version();
+        chunk.setBlock(localPos, block);
+        if (result) *result = BlockEditResult{chunk.version(), chunk.version() != before};
+        return chunk.version() != before;
+    });
+    return loaded;
+}
+
+std::vector<std::optional<BlockEditResult>> World::setBlocksIfLoaded(std::span<const BlockPlacement> edits) {
+    // Edit indices per chunk, in request order
+    ChunkPosMap<std::vector<size_t>> byChunk;
+    for (size_t i = 0; i < edits.size(); ++i) {
+        byChunk[toAbsoluteChunk(edits[i].pos)].push_back(i);
+    }
     
-    return true;
+    std::vector<std::optional<BlockEditResult>> results(edits.size());
+    for (const auto& [chunkPos, indices] : byChunk) {
+        // One copy and publish per chunk, however many of its blocks change
+        chunks_->update(chunkPos, [&](ChunkSpan& chunk) {
+            const uint64_t before = chunk.version();
+            for (size_t i : indices) {
+                const uint64_t previous = chunk.version();
+                chunk.setBlock(toChunkLocal(edits[i].pos, chunkPos), edits[i].block);
+                results[i] = BlockEditResult{chunk.version(), chunk.version() != previous};
+            }
+            return chunk.version() != before;
+        });
+    }
+    return results;
+}
+
+void World::setEntityUpdatedCallback(const std::function<void(entt::entity, const entt::registry&)>& cb) {
+    std::lock_guard<std::mutex> lock(entityMutex_);
+    entityUpdatedCallback_ = cb;
+}
+
+void World::readEntities(const std::function<void(const entt::registry&)>& fn) const {
+    std::lock_guard<std::mutex> lock(entityMutex_);
+    fn(entityRegistry_);
+}
+
+std::vector<entt::entity> World::entitiesInRadius(const AbsolutePrecisePosition& center, double radius) const {
+    std::vector<entt::entity> found;
+    std::lock_guard<std::mutex> lock(entityMutex_);
+    entityIndex_.queryRadius(center, radius, found);
+    return found;
+}
+
+std::vector<entt::entity> World::entitiesInChunkBox(const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max) const {
+    std::vector<entt::entity> found;
+    std::lock_guard<std::mutex> lock(entityMutex_);
+    entityIndex_.queryBox(min, max, found);
+    return found;
+}
+
+void World::entityChangedLocked(entt::entity entity) {
+    const auto* position = entityRegistry_.valid(entity) ? entityRegistry_.try_get<AbsolutePrecisePosition>(entity) : nullptr;
+    if (position) {
+        entityIndex_.update(entity, *position);
+    } else {
+        entityIndex_.remove(entity);
+    }
+    if (entityUpdatedCallback_) {
+        entityUpdatedCallback_(entity, entityRegistry_);
+    }
 }
 
 entt::entity World::spawnPlayer(const std::string& playerName, const AbsolutePrecisePosition& position) {
+    std::lock_guard<std::mutex> lock(entityMutex_);
     // Create a new entity in the registry
     entt::entity playerEntity = entityRegistry_.create();
     
     // Add components to the player entity
     entityRegistry_.emplace<NameComponent>(playerEntity, playerName);
     entityRegistry_.emplace<AbsolutePrecisePosition>(playerEntity, position);
-    if (entityUpdatedCallback_) {
-        entityUpdatedCallback_(playerEntity, entityRegistry_);
-    }
+    entityChangedLocked(playerEntity);
     
     return playerEntity;
 }
 
 void World::despawnPlayer(entt::entity playerEntity) {
+    std::lock_guard<std::mutex> lock(entityMutex_);
     // Check if entity exists before destroying
     if (entityRegistry_.valid(playerEntity)) {
         entityRegistry_.destroy(playerEntity);
+        entityChangedLocked(playerEntity);
     }
 }
 
@@ -269,36 +731,56 @@ std::string World::createPlayerSession(const std::string& playerName, const Abso
     return sessionToken;
 }
 
+std::optional<SessionHandle> World::resolvePlayerSession(const std::string& sessionToken) const {
+    return sessionManager_.resolve(sessionToken);
+}
+
 bool World::refreshPlayerSession(const std::string& sessionToken) {
     return sessionManager_.refreshSession(sessionToken);
 }
 
+bool World::refreshPlayerSession(SessionHandle session) {
+    return sessionManager_.refreshSession(session);
+}
+
 bool World::updatePlayerPosition(const std::string& sessionToken, const AbsolutePrecisePosition& position) {
-    // Update position in session manager
-    if (!sessionManager_.updatePlayerPosition(sessionToken, position)) {
+    // One session lookup yields the entity; the registry is only touched if the session exists
+    entt::entity playerEntity;
+    if (!sessionManager_.updatePlayerPosition(sessionToken, position, &playerEntity)) {
         return false;
     }
     
-    // Update position in entity registry
-    auto sessionOpt = sessionManager_.getSession(sessionToken);
-    std::clog << "Updating position for session: " << sessionToken << std::endl;
-    if (sessionOpt.has_value()) {
-        const auto& session = sessionOpt.value();
-        if (entityRegistry_.valid(session.playerEntity)) {
-            auto* posComponent = entityRegistry_.try_get<AbsolutePrecisePosition>(session.playerEntity);
-            if (posComponent) {
-                std::clog << " - Old Position: (" << posComponent->x << ", " << posComponent->y << ", " << posComponent->z << ")" << std::endl;
-                std::clog << " - New Position: (" << position.x << ", " << position.y << ", " << position.z << ")" << std::endl;
-                *posComponent = position;
-                if (entityUpdatedCallback_) {
-                    entityUpdatedCallback_(session.playerEntity, entityRegistry_);
-                }
-                return true;
-            }
-        }
+    std::lock_guard<std::mutex> lock(entityMutex_);
+    return movePlayerEntityLocked(playerEntity, position);
+}
+
+std::vector<bool> World::updatePlayerPositions(const std::vector<std::pair<SessionHandle, AbsolutePrecisePosition>>& updates) {
+    std::vector<bool> applied(updates.size(), false);
+    std::vector<entt::entity> entities(updates.size());
+    for (size_t i = 0; i < updates.size(); ++i) {
+        applied[i] = sessionManager_.updatePlayerPosition(updates[i].first, updates[i].second, &entities[i]);
     }
     
-    return false;
+    std::lock_guard<std::mutex> lock(entityMutex_);
+    for (size_t i = 0; i < updates.size(); ++i) {
+        if (applied[i]) {
+            applied[i] = movePlayerEntityLocked(entities[i], updates[i].second);
+        }
+    }
+    return applied;
+}
+
+bool World::movePlayerEntityLocked(entt::entity playerEntity, const AbsolutePrecisePosition& position) {
+    if (!entityRegistry_.valid(playerEntity)) {
+        return false;
+    }
+    auto* posComponent = entityRegistry_.try_get<AbsolutePrecisePosition>(playerEntity);
+    if (!posComponent) {
+        return false;
+    }
+    *posComponent = position;
+    entityChangedLocked(playerEntity);
+    return true;
 }
 
 bool World::isValidSession(const std::string& sessionToken) const {
@@ -309,27 +791,29 @@ std::optional<PlayerSession> World::getPlayerSession(const std::string& sessionT
     return sessionManager_.getSession(sessionToken);
 }
 
-std::vector<PlayerSession> World::getAllActiveSessions() const {
-    return sessionManager_.getAllActiveSessions();
+std::optional<PlayerSessionState> World::getPlayerSessionState(SessionHandle session) const {
+    return sessionManager_.getSessionState(session);
 }
 
-void World::disconnectPlayerBySession(const std::string& sessionToken) {
-    auto sessionOpt = sessionManager_.getSession(sessionToken);
-    if (sessionOpt.has_value()) {
-        const auto& session = sessionOpt.value();
-        disconnectPlayer(session.playerEntity);
-        sessionManager_.removeSession(sessionToken);
+std::optional<SessionHandle> World::disconnectPlayerBySession(const std::string& sessionToken) {
+    auto session = sessionManager_.resolve(sessionToken);
+    if (!session) {
+        return std::nullopt;
+    }
+    auto playerEntity = sessionManager_.removeSession(sessionToken);
+    if (!playerEntity) {
+        return std::nullopt;
     }
+    disconnectPlayer(*playerEntity);
+    return session;
 }
 
-void World::cleanupExpiredSessions() {
-    auto expiredTokens = sessionManager_.removeExpiredSessions();
-    
-    // Despawn entities for expired sessions
-    for (const auto& token : expiredTokens) {
-        // Session is already removed, but we need to clean up the entity
-        // This is a bit tricky since we don't have the entity ID anymore
-        // In a real implementation, you might want to store entity mappings separately
-        // For now, we'll rely on the session cleanup
-    }
-}
\ No newline at end of file
+std::vector<SessionHandle> World::cleanupExpiredSessions() {
+    std::vector<SessionHandle> ended;
+    // Timed-out players go the same way as ones that disconnect
+    for (const auto& expired : sessionManager_.removeExpiredSessions()) {
+        disconnectPlayer(expired.playerEntity);
+        ended.push_back(expired.handle);
+    }
+    return ended;
+}
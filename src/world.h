@@ -1,36 +1,44 @@
 #pragma once
 
+#include <chrono>
+#include <deque>
+#include <filesystem>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <unordered_map>
 #include <functional>
+#include <future>
+#include <span>
 #include <vector>
 
 #include <entt/entt.hpp>
 
 #include "chunktransform.h"
+#include "chunk_pos_hash.h"
 #include "position.h"
 #include "name_component.h"
 #include "player_session.h"
+#include "entity_spatial_index.h"
 #include <functional>
 
 
-struct ChunkPosHash {
-    std::size_t operator()(const AbsoluteChunkPosition& pos) const {
-        // Simple hash combining x, y, z
-        return std::hash<int32_t>()(pos.x) ^ (std::hash<int32_t>()(pos.y) << 1) ^ (std::hash<int32_t>()(pos.z) << 2);
-    }
-};
-
-struct ChunkPosEq {
-    bool operator()(const AbsoluteChunkPosition& a, const AbsoluteChunkPosition& b) const {
-        return a.x == b.x && a.y == b.y && a.z == b.z;
-    }
-};
-
+// Chunks each generation thread takes per loadQueuedChunks batch
+constexpr size_t CHUNK_LOAD_BATCH_PER_THREAD = 4;
+// How long a chunk loaded on demand, outside every anchor's sphere, stays after its last request
+constexpr auto DEMAND_CHUNK_LINGER = std::chrono::seconds(30);
+// Misses within this many chunks (Chebyshev) of a session's player may be loaded on demand, and a
+// demand-loaded chunk stays past its linger while some player is that close to it
+constexpr int32_t DEMAND_LOAD_RADIUS = 8;
 
 // Type alias for chunk map
-using ChunkMap = std::unordered_map<AbsoluteChunkPosition, std::shared_ptr<ChunkSpan>, ChunkPosHash, ChunkPosEq>;
+using ChunkMap = FlatHashMap<AbsoluteChunkPosition, std::shared_ptr<const ChunkSpan>, ChunkPosHash, ChunkPosEq>;
+
+// Terrain at one world column: every block below height is block, everything above it Empty
+struct WorldgenSurface {
+    int64_t height;
+    Block block;
+};
 
 // Interface for chunk generation
 class IWorldgenStrategy {
@@ -40,18 +48,52 @@ public:
      * @brief Returns a single ChunkTransform pointer for a given position. Must not mutate internal state, to prevent the same seed producing different results.
      * @param pos The absolute chunk position to generate.
      * @param seed A simple seed value for procedural generation.
-     * @return A unique pointer to a ChunkTransform that can be applied to a ChunkSpan.
+     * @return A unique pointer to a ChunkTransform that can be applied to a ChunkSpan. A generator whose
+     * tree doesn't depend on pos should return the same transform every time, so World compiles it once.
      */
     virtual std::shared_ptr<ChunkTransform> generateChunk(const AbsoluteChunkPosition& pos, size_t seed) const = 0;
+    /**
+     * @brief The generated surface at a world column without generating its chunks, for far-away LOD
+     * chunks. Caves and overhangs are left out. Generators without a cheap heightmap return nullopt.
+     */
+    virtual std::optional<WorldgenSurface> surfaceAt(int64_t worldX, int64_t worldZ, size_t seed) const { return std::nullopt; }
+};
+
+class ThreadPool;
+class ChunkResidency;
+class ChunkWriteBehind;
+class ConcurrentChunkMap;
+
+// One block write of a World::setBlocksIfLoaded batch
+struct BlockPlacement {
+    AbsoluteBlockPosition pos;
+    Block block;
+};
+
+// What one block write did: the chunk's version right after it, and whether the block changed.
+// Writing the block that is already there leaves the version as it was.
+struct BlockEditResult {
+    uint64_t version = 0;
+    bool changed = false;
 };
 
 // Interface for chunk persistence
+// World saves from a background write-behind thread while loading on the tick thread, so implementations must be thread-safe.
 class IChunkPersistence {
 public:
     virtual ~IChunkPersistence() = default;
     virtual bool saveChunk(const ChunkSpan& chunk) = 0;
     virtual std::optional<std::shared_ptr<ChunkSpan>> loadChunk(const AbsoluteChunkPosition& pos) = 0;
     virtual void saveAllLoadedChunks(const ChunkMap& chunks) = 0;
+    // Batch variants; the defaults loop over saveChunk/loadChunk. Backends should override them
+    // when a batch can share one transaction or round trip.
+    virtual bool saveChunks(const std::vector<std::shared_ptr<const ChunkSpan>>& chunks);
+    // Results are in the same order as positions; nullopt where nothing is stored
+    virtual std::vector<std::optional<std::shared_ptr<ChunkSpan>>> loadChunks(std::span<const AbsoluteChunkPosition> positions);
+    // Like loadChunks but returns ChunkSpan::serialize() bytes, so the caller can decode them on
+    // its own threads. The default re-serializes what loadChunks decoded; backends that store the
+    // serialized form should override it and just copy the bytes out.
+    virtual std::vector<std::optional<ChunkSerializationSparseVector>> loadSerializedChunks(std::span<const AbsoluteChunkPosition> positions);
 };
 
 class World {
@@ -62,13 +104,77 @@ public:
         size_t loadAnchorRadiusInChunks = 10,
         size_t seed = 0,
         std::shared_ptr<IChunkPersistence> persistence = nullptr);
-    std::optional<std::shared_ptr<ChunkSpan>> chunkAt(const AbsoluteChunkPosition pos) const;
+    // Chunk lookups and block reads/writes are safe from any thread, concurrently with
+    // ensureChunksLoaded and garbageCollectChunks on the tick thread. Returned chunks are
+    // immutable snapshots; block writes publish a new copy of the chunk.
+    std::optional<std::shared_ptr<const ChunkSpan>> chunkAt(const AbsoluteChunkPosition pos) const;
+    // Whether any chunk in min..max (inclusive) is loaded; cheap where nothing near the box is
+    bool chunksLoadedIn(const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max) const;
+    // Loads every chunk the anchors need; queueChunkLoads then loadQueuedChunks without a deadline
     void ensureChunksLoaded();
     void garbageCollectChunks();
+    /**
+     * @brief Budgeted loading, for a tick that mustn't stall: queueChunkLoads() moves the anchors
+     * and queues the chunks that became resident (returning how many are queued), and each
+     * loadQueuedChunks() call loads queued chunks in batches until the deadline. True when some
+     * are still queued.
+     */
+    size_t queueChunkLoads();
+    bool loadQueuedChunks(std::chrono::steady_clock::time_point deadline);
+    /**
+     * @brief Hands edited chunks to the write-behind queue so they survive a crash, not just an
+     * unload. A sweep covers the loaded chunks a map shard at a time until the deadline and the
+     * next call continues it; true while the sweep is unfinished. Does nothing without persistence.
+     */
+    bool saveDirtyChunks(std::chrono::steady_clock::time_point deadline);
+    /**
+     * @brief Writes the loaded chunks, live sessions and entity registry to one checkpoint file
+     * (see world_checkpoint.h), replacing any earlier one only once the new one is complete.
+     * Tick thread; chunk edits and player moves made on RPC threads meanwhile may or may not be included.
+     */
+    bool saveCheckpoint(const std::filesystem::path& path) const;
+    /**
+     * @brief Loads a checkpoint into a World that hasn't spawned anyone yet, before its first
+     * ensureChunksLoaded: restored chunks keep their versions and dirty flags and are held by a
+     * demand lease until the anchors take them over, and sessions come back under their old tokens
+     * with a fresh timeout. False, leaving the World as it was, if the file can't be read.
+     * With persistence, the restored edits are saved at once and the file is removed, so a later
+     * crash can't restore it again over newer saves; without, it is kept as the only copy.
+     */
+    bool restoreCheckpoint(const std::filesystem::path& path);
+    /**
+     * @brief Asks for a chunk whether or not an anchor needs it; safe from any thread. The future
+     * is ready at once for a loaded chunk; otherwise the chunk is queued for loadDemandedChunks and
+     * every request for it until then shares one future. A chunk loaded this way that no anchor
+     * needs is unloaded by garbageCollectChunks once DEMAND_CHUNK_LINGER passes without a request
+     * and no session's player is within DEMAND_LOAD_RADIUS of it; clients keep using their copy
+     * without asking again, and their edits need it loaded.
+     */
+    std::shared_future<std::shared_ptr<const ChunkSpan>> requestChunkLoad(const AbsoluteChunkPosition& pos);
+    // Loads requested chunks in batches until the deadline, ahead of the anchors' queue; returns
+    // the positions it published, whose futures are now ready. Tick thread.
+    std::vector<AbsoluteChunkPosition> loadDemandedChunks(std::chrono::steady_clock::time_point deadline);
+    bool hasDemandedChunks() const;
+    void setDemandChunkLinger(std::chrono::steady_clock::duration linger);
+    /**
+     * @brief Sets how many worker threads ensureChunksLoaded uses for chunk generation.
+     * 0 or 1 keeps everything on the calling thread (the default).
+     */
+    void setGenerationThreads(size_t threadCount);
+    size_t getGenerationThreads() const;
     // note users can NEVER force-load a chunk, they can only set anchors and call ensureChunksLoaded()
     const std::optional<std::shared_ptr<const ChunkSpan>> getChunkIfLoaded(const AbsoluteChunkPosition& pos) const;
     const std::optional<Block> getBlockIfLoaded(const AbsoluteBlockPosition& pos) const;
-    bool setBlockIfLoaded(const AbsoluteBlockPosition& pos, Block block);
+    // The generator's surface at a world column (see IWorldgenStrategy::surfaceAt); nullopt without a generator
+    std::optional<WorldgenSurface> surfaceAt(int64_t worldX, int64_t worldZ) const;
+    // result, if given, receives what the write did; a chunk it doesn't change isn't republished
+    bool setBlockIfLoaded(const AbsoluteBlockPosition& pos, Block block, BlockEditResult* result = nullptr);
+    /**
+     * @brief Applies many writes, publishing each changed chunk once with all of its edits.
+     * Edits to one chunk apply in the order given. Each result is what that edit did, or nullopt
+     * where the chunk isn't loaded.
+     */
+    std::vector<std::optional<BlockEditResult>> setBlocksIfLoaded(std::span<const BlockPlacement> edits);
     
     // Player management methods
     entt::entity spawnPlayer(const std::string& playerName, const AbsolutePrecisePosition& position);
@@ -78,17 +184,32 @@ public:
     
     // Session management methods
     std::string createPlayerSession(const std::string& playerName, const AbsolutePrecisePosition& spawnPosition);
+    // Handle of the session a client's token names, for paths that look it up repeatedly
+    std::optional<SessionHandle> resolvePlayerSession(const std::string& sessionToken) const;
     bool refreshPlayerSession(const std::string& sessionToken);
+    bool refreshPlayerSession(SessionHandle session);
     bool updatePlayerPosition(const std::string& sessionToken, const AbsolutePrecisePosition& position);
+    // Applies many (session, position) updates taking the entity lock once; true where applied
+    std::vector<bool> updatePlayerPositions(const std::vector<std::pair<SessionHandle, AbsolutePrecisePosition>>& updates);
     bool isValidSession(const std::string& sessionToken) const;
     std::optional<PlayerSession> getPlayerSession(const std::string& sessionToken) const;
-    std::vector<PlayerSession> getAllActiveSessions() const;
-    void disconnectPlayerBySession(const std::string& sessionToken);
-    void cleanupExpiredSessions();
+    std::optional<PlayerSessionState> getPlayerSessionState(SessionHandle session) const;
+    // The ended session's handle, if the token named one; its player is despawned
+    std::optional<SessionHandle> disconnectPlayerBySession(const std::string& sessionToken);
+    // Ends timed-out sessions and despawns their players; returns the sessions that ended
+    std::vector<SessionHandle> cleanupExpiredSessions();
 
-    // Entity update callback (called when an entity with a position is updated/spawned)
-    void setEntityUpdatedCallback(const std::function<void(entt::entity, const entt::registry&)>& cb) { entityUpdatedCallback_ = cb; }
+    // Entity update callback, called with the entity lock held whenever an entity with a position is
+    // spawned, moved or despawned (check registry.valid()); keep it cheap, e.g. mark the entity dirty
+    void setEntityUpdatedCallback(const std::function<void(entt::entity, const entt::registry&)>& cb);
+    // Runs fn with the registry while no RPC thread can modify it
+    void readEntities(const std::function<void(const entt::registry&)>& fn) const;
+    // Spawned entities within radius blocks of center, from the chunk-bucketed index
+    std::vector<entt::entity> entitiesInRadius(const AbsolutePrecisePosition& center, double radius) const;
+    // Spawned entities in chunks min..max, inclusive
+    std::vector<entt::entity> entitiesInChunkBox(const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max) const;
     size_t getLoadAnchorRadiusInChunks() const { return loadAnchorRadiusInChunks_; }
+    size_t getSeed() const { return seed_; }
     
     // Registry access
     entt::registry& getRegistry() { return entityRegistry_; }
@@ -96,8 +217,22 @@ public:
     
     ~World();
 private:
-    // Map of loaded chunks
-    ChunkMap chunks_;
+    // Moves a player's entity and notifies the entity callback; requires entityMutex_ held
+    bool movePlayerEntityLocked(entt::entity playerEntity, const AbsolutePrecisePosition& position);
+    // Reindexes an entity that was spawned, moved or despawned, then runs the entity callback;
+    // requires entityMutex_ held
+    void entityChangedLocked(entt::entity entity);
+    // Pushes the current callback and player anchors into the residency tracker
+    void syncAnchors();
+    // Loads from the write-behind queue or persistence, or generates, and publishes each chunk
+    void loadChunks(const std::vector<AbsoluteChunkPosition>& missing);
+    // Runs the generator for a chunk, or returns an empty one without a generator. Safe to call concurrently.
+    std::shared_ptr<ChunkSpan> generateChunk(const AbsoluteChunkPosition& pos) const;
+    // ChunkTransform::compile() of the generator's transform, reused while it returns the same one
+    std::shared_ptr<const ChunkTransform> compiledTransform(const std::shared_ptr<ChunkTransform>& transform) const;
+
+    // Map of loaded chunks, sharded for concurrent access
+    std::unique_ptr<ConcurrentChunkMap> chunks_;
     // Chunk generator for creating chunks on demand
     std::shared_ptr<IWorldgenStrategy> chunkGenerator_;
     // Load anchors and radius
@@ -107,8 +242,42 @@ private:
     size_t seed_ = 0;
     // Persistence provider (can be null)
     std::shared_ptr<IChunkPersistence> persistence_;
+    // The generator's last transform and its compiled form; guarded by compiledMutex_
+    mutable std::mutex compiledMutex_;
+    mutable std::shared_ptr<ChunkTransform> compiledSource_;
+    mutable std::shared_ptr<const ChunkTransform> compiled_;
+    // Worker pool for chunk loading/generation (null = serial)
+    std::unique_ptr<ThreadPool> generationPool_;
+    // Which chunks the anchors currently require; updated incrementally as anchors move
+    std::unique_ptr<ChunkResidency> residency_;
+    // Saves unloaded dirty chunks off the tick thread (null without persistence)
+    std::unique_ptr<ChunkWriteBehind> writeBehind_;
+    // Chunks that became resident but aren't loaded yet, oldest first
+    std::deque<AbsoluteChunkPosition> loadQueue_;
+    ChunkSet queuedLoads_;
+    // Next map shard saveDirtyChunks looks at; 0 between sweeps
+    size_t saveCursor_ = 0;
+    // Demand loads: one shared future per position until it is loaded, and when each chunk
+    // loaded that way was last asked for; all guarded by demandMutex_
+    struct DemandedChunk {
+        std::promise<std::shared_ptr<const ChunkSpan>> promise;
+        std::shared_future<std::shared_ptr<const ChunkSpan>> future = promise.get_future().share();
+    };
+    mutable std::mutex demandMutex_;
+    ChunkPosMap<std::shared_ptr<DemandedChunk>> demanded_;
+    std::deque<AbsoluteChunkPosition> demandQueue_;
+    ChunkPosMap<std::chrono::steady_clock::time_point> demandLeases_;
+    std::chrono::steady_clock::duration demandLinger_ = DEMAND_CHUNK_LINGER;
+    // Batches of chunks loaded so far; the high half of a freshly loaded chunk's version
+    uint64_t chunkLoadEpoch_ = 0;
     //entt registry for entities
     entt::registry entityRegistry_;
+    // Positioned entities bucketed by chunk; follows entityRegistry_
+    EntitySpatialIndex entityIndex_;
+    // Guards entityRegistry_, entityIndex_ and entityUpdatedCallback_; players are spawned and moved from RPC threads
+    mutable std::mutex entityMutex_;
+    // Anchors the loadAnchors_ callback returned last time, registered under their index
+    size_t callbackAnchorCount_ = 0;
     // Player session manager
     PlayerSessionManager sessionManager_;
     // Callback for notifying server of entity updates
@@ -0,0 +1,294 @@
+#include "world_checkpoint.h"
+#include "chunk_arena.h"
+#include "log.h"
+#include "name_component.h"
+#include "snapshot_archive.h"
+
+#include <cerrno>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char CHECKPOINT_MAGIC[4] = {'B', 'T', 'C', 'K'};
+constexpr uint32_t CHECKPOINT_FORMAT_VERSION = 1;
+
+struct CheckpointHeader {
+    char magic[4];
+    uint32_t formatVersion;
+    uint64_t chunkLoadEpoch;
+    uint64_t chunkCount;
+    uint64_t sessionCount;
+    uint64_t registryBytes;
+};
+
+// Followed by byteLength bytes of ChunkSpan::serialize output, which carries the position
+struct ChunkRecord {
+    uint64_t version;
+    uint32_t byteLength;
+    uint8_t dirty;
+    uint8_t padding[3];
+};
+
+// Followed by the token and the player name
+struct SessionRecord {
+    uint32_t tokenLength;
+    uint32_t nameLength;
+    uint32_t playerEntity;
+    uint32_t padding;
+    double x, y, z;
+};
+
+// The snapshot archives plus the two components players carry, which aren't trivially copyable
+class CheckpointOutputArchive : public VectorOutputArchive {
+public:
+    using VectorOutputArchive::VectorOutputArchive;
+    using VectorOutputArchive::operator();
+    void operator()(const NameComponent& component) { (*this)(component.name); }
+    void operator()(const AbsolutePrecisePosition& position) {
+        (*this)(position.x);
+        (*this)(position.y);
+        (*this)(position.z);
+    }
+};
+
+class CheckpointInputArchive : public VectorInputArchive {
+public:
+    using VectorInputArchive::VectorInputArchive;
+    using VectorInputArchive::operator();
+    void operator()(NameComponent& component) { (*this)(component.name); }
+    void operator()(AbsolutePrecisePosition& position) {
+        (*this)(position.x);
+        (*this)(position.y);
+        (*this)(position.z);
+    }
+};
+
+// Sequential writes into a buffer already sized for them
+class Writer {
+public:
+    explicit Writer(uint8_t* out) : out_(out) {}
+    void bytes(const void* data, size_t length) {
+        if (length) {
+            std::memcpy(out_ + offset_, data, length);
+        }
+        offset_ += length;
+    }
+    template<typename T>
+    void value(const T& v) { bytes(&v, sizeof(T)); }
+
+private:
+    uint8_t* out_;
+    size_t offset_ = 0;
+};
+
+// Sequential bounds-checked reads; throws std::runtime_error past the end
+class Reader {
+public:
+    explicit Reader(std::span<const uint8_t> in) : in_(in) {}
+    std::span<const uint8_t> bytes(size_t length) {
+        if (length > in_.size() - offset_) {
+            throw std::runtime_error("checkpoint is truncated");
+        }
+        auto out = in_.subspan(offset_, length);
+        offset_ += length;
+        return out;
+    }
+    template<typename T>
+    T value() {
+        T v;
+        std::memcpy(&v, bytes(sizeof(T)).data(), sizeof(T));
+        return v;
+    }
+    std::string string(size_t length) {
+        auto data = bytes(length);
+        return std::string(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+private:
+    std::span<const uint8_t> in_;
+    size_t offset_ = 0;
+};
+
+// A whole file mapped read-only, unmapped and closed on destruction
+struct MappedFile {
+    int fd = -1;
+    const uint8_t* map = nullptr;
+    size_t size = 0;
+
+    ~MappedFile() {
+        if (map) munmap(const_cast<uint8_t*>(map), size);
+        if (fd >= 0) close(fd);
+    }
+};
+
+} // namespace
+
+bool writeWorldCheckpoint(const std::filesystem::path& path, const WorldCheckpoint& checkpoint) {
+    // Serialize first so the file can be sized, then filled through one mapping
+    std::vector<ChunkSerializationSparseVector> serialized;
+    serialized.reserve(checkpoint.chunks.size());
+    size_t total = sizeof(CheckpointHeader) + checkpoint.registry.size();
+    for (const auto& entry : checkpoint.chunks) {
+        serialized.push_back(entry.chunk->serialize());
+        total += sizeof(ChunkRecord) + serialized.back().size();
+    }
+    for (const auto& session : checkpoint.sessions) {
+        total += sizeof(SessionRecord) + session.token.size() + session.playerName.size();
+    }
+
+    const std::filesystem::path temporary = path.string() + ".tmp";
+    int fd = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Failed to create checkpoint " << temporary << ": " << std::strerror(errno));
+        return false;
+    }
+    // Reserve the blocks rather than leave a sparse file: a full disk then fails here, where
+    // stores through the mapping would raise SIGBUS
+    if (const int error = posix_fallocate(fd, 0, static_cast<off_t>(total)); error != 0) {
+        LOG_ERROR("Failed to size checkpoint " << temporary << ": " << std::strerror(error));
+        close(fd);
+        return false;
+    }
+    void* m = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED) {
+        LOG_ERROR("Failed to map checkpoint " << temporary << ": " << std::strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    Writer out(static_cast<uint8_t*>(m));
+    CheckpointHeader header{};
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    header.formatVersion = CHECKPOINT_FORMAT_VERSION;
+    header.chunkLoadEpoch = checkpoint.chunkLoadEpoch;
+    header.chunkCount = checkpoint.chunks.size();
+    header.sessionCount = checkpoint.sessions.size();
+    header.registryBytes = checkpoint.registry.size();
+    out.value(header);
+    for (size_t i = 0; i < checkpoint.chunks.size(); ++i) {
+        ChunkRecord record{};
+        record.version = checkpoint.chunks[i].chunk->version();
+        record.byteLength = static_cast<uint32_t>(serialized[i].size());
+        record.dirty = checkpoint.chunks[i].dirty ? 1 : 0;
+        out.value(record);
+        out.bytes(serialized[i].data(), serialized[i].size());
+    }
+    for (const auto& session : checkpoint.sessions) {
+        SessionRecord record{};
+        record.tokenLength = static_cast<uint32_t>(session.token.size());
+        record.nameLength = static_cast<uint32_t>(session.playerName.size());
+        record.playerEntity = static_cast<uint32_t>(static_cast<std::underlying_type_t<entt::entity>>(session.playerEntity));
+        record.x = session.position.x;
+        record.y = session.position.y;
+        record.z = session.position.z;
+        out.value(record);
+        out.bytes(session.token.data(), session.token.size());
+        out.bytes(session.playerName.data(), session.playerName.size());
+    }
+    out.bytes(checkpoint.registry.data(), checkpoint.registry.size());
+
+    const bool synced = msync(m, total, MS_SYNC) == 0;
+    munmap(m, total);
+    close(fd);
+    if (!synced) {
+        LOG_ERROR("Failed to flush checkpoint " << temporary << ": " << std::strerror(errno));
+        return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        LOG_ERROR("Failed to replace checkpoint " << path << ": " << error.message());
+        return false;
+    }
+    LOG_INFO("Wrote checkpoint " << path << ": " << checkpoint.chunks.size() << " chunks, " << checkpoint.sessions.size()
+             << " sessions, " << total << " bytes");
+    return true;
+}
+
+std::optional<WorldCheckpoint> readWorldCheckpoint(const std::filesystem::path& path) {
+    MappedFile file;
+    file.fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file.fd < 0) {
+        if (errno != ENOENT) {
+            LOG_ERROR("Failed to open checkpoint " << path << ": " << std::strerror(errno));
+        }
+        return std::nullopt;
+    }
+    struct stat st{};
+    if (fstat(file.fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CheckpointHeader)) {
+        LOG_ERROR("Checkpoint " << path << " is truncated");
+        return std::nullopt;
+    }
+    file.size = static_cast<size_t>(st.st_size);
+    void* m = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if (m == MAP_FAILED) {
+        LOG_ERROR("Failed to map checkpoint " << path << ": " << std::strerror(errno));
+        return std::nullopt;
+    }
+    file.map = static_cast<const uint8_t*>(m);
+    // Read front to back exactly once
+    madvise(m, file.size, MADV_SEQUENTIAL);
+
+    WorldCheckpoint checkpoint;
+    try {
+        Reader in(std::span<const uint8_t>(file.map, file.size));
+        const auto header = in.value<CheckpointHeader>();
+        if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 || header.formatVersion != CHECKPOINT_FORMAT_VERSION) {
+            LOG_ERROR("Checkpoint " << path << " has an unknown format");
+            return std::nullopt;
+        }
+        // Counts are checked against the file's size before anything is reserved for them
+        if (header.chunkCount > file.size / sizeof(ChunkRecord) || header.sessionCount > file.size / sizeof(SessionRecord)) {
+            throw std::runtime_error("record counts exceed the file");
+        }
+        checkpoint.chunkLoadEpoch = header.chunkLoadEpoch;
+        checkpoint.chunks.reserve(header.chunkCount);
+        for (uint64_t i = 0; i < header.chunkCount; ++i) {
+            const auto record = in.value<ChunkRecord>();
+            auto chunk = makePooledChunk(in.bytes(record.byteLength));
+            chunk->setVersion(record.version);
+            checkpoint.chunks.push_back(WorldCheckpointChunk{std::move(chunk), record.dirty != 0});
+        }
+        checkpoint.sessions.reserve(header.sessionCount);
+        for (uint64_t i = 0; i < header.sessionCount; ++i) {
+            const auto record = in.value<SessionRecord>();
+            WorldCheckpointSession session;
+            session.token = in.string(record.tokenLength);
+            session.playerName = in.string(record.nameLength);
+            session.playerEntity = static_cast<entt::entity>(record.playerEntity);
+            session.position = AbsolutePrecisePosition(record.x, record.y, record.z);
+            checkpoint.sessions.push_back(std::move(session));
+        }
+        auto registry = in.bytes(header.registryBytes);
+        checkpoint.registry.assign(registry.begin(), registry.end());
+    } catch (const std::exception& e) {
+        LOG_ERROR("Checkpoint " << path << " is corrupt: " << e.what());
+        return std::nullopt;
+    }
+    return checkpoint;
+}
+
+std::vector<std::uint8_t> encodeRegistrySnapshot(const entt::registry& registry) {
+    std::vector<std::uint8_t> out;
+    CheckpointOutputArchive archive(out);
+    entt::snapshot{registry}.get<entt::entity>(archive).get<NameComponent>(archive).get<AbsolutePrecisePosition>(archive);
+    return out;
+}
+
+bool decodeRegistrySnapshot(const std::vector<std::uint8_t>& data, entt::registry& registry) {
+    try {
+        CheckpointInputArchive archive(data);
+        entt::snapshot_loader{registry}.get<entt::entity>(archive).get<NameComponent>(archive).get<AbsolutePrecisePosition>(archive).orphans();
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to load the entity snapshot: " << e.what());
+        return false;
+    }
+    return true;
+}
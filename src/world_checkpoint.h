@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <entt/entt.hpp>
+
+#include "chunkspan.h"
+#include "position.h"
+
+/*
+ * A world checkpoint is one file holding what a restarted server needs to carry on where it
+ * stopped: every loaded chunk with its version and dirty flag, the live sessions under their
+ * tokens, and the entity registry as an EnTT snapshot. It is written to a temporary file that is
+ * renamed over the old one, so a crash mid-write leaves the previous checkpoint, and it is read
+ * back through a read-only mapping in one pass, chunks decoding straight from the mapped bytes.
+ */
+
+struct WorldCheckpointChunk {
+    std::shared_ptr<const ChunkSpan> chunk; // keeps its version
+    // Differs from what persistence holds
+    bool dirty = false;
+};
+
+struct WorldCheckpointSession {
+    std::string token;
+    std::string playerName;
+    entt::entity playerEntity;
+    AbsolutePrecisePosition position;
+};
+
+struct WorldCheckpoint {
+    // World's chunk load epoch, so versions handed out after a restore stay above the restored ones
+    uint64_t chunkLoadEpoch = 0;
+    std::vector<WorldCheckpointChunk> chunks;
+    std::vector<WorldCheckpointSession> sessions;
+    // encodeRegistrySnapshot output
+    std::vector<std::uint8_t> registry;
+};
+
+bool writeWorldCheckpoint(const std::filesystem::path& path, const WorldCheckpoint& checkpoint);
+// nullopt, after logging why, when the file is missing, truncated or not a checkpoint
+std::optional<WorldCheckpoint> readWorldCheckpoint(const std::filesystem::path& path);
+
+// The registry's entities and their NameComponent and AbsolutePrecisePosition, through VectorOutputArchive
+std::vector<std::uint8_t> encodeRegistrySnapshot(const entt::registry& registry);
+// Loads a snapshot into an empty registry, keeping entity ids; false on malformed data
+bool decodeRegistrySnapshot(const std::vector<std::uint8_t>& data, entt::registry& registry);
@@ -0,0 +1,98 @@
+#include <benchmark/benchmark.h>
+#include "chunk_generators.h"
+#include "chunktransform.h"
+#include "chunkspan.h"
+#include "chunkdims.h"
+#include <memory>
+
+// Chunk generation throughput, reported as chunks/s: each ChunkTransform on its own, the + and |
+// trees as written and after compile(), and the world generators end to end. Every iteration
+// generates a different chunk position so noise caches and column lookups see fresh columns.
+
+namespace {
+
+std::shared_ptr<siv::PerlinNoise> benchNoise() {
+    static auto noise = std::make_shared<siv::PerlinNoise>(1234u);
+    return noise;
+}
+
+std::shared_ptr<ChunkTransform> terrain(std::shared_ptr<ColumnHeightCache> cache = nullptr) {
+    return std::make_shared<PerlinNoiseChunkTransform>(benchNoise(), 40.0, 3, 0.5, Block::Grass, 0, CHUNK_HEIGHT, std::move(cache));
+}
+
+// The layered tree a generator would build: stone floor, noise terrain on top, dirt band merged in
+std::shared_ptr<ChunkTransform> layered() {
+    auto floor = std::make_shared<HeightmapChunkTransform>(CHUNK_HEIGHT / 4, Block::Stone);
+    auto band = std::make_shared<HeightmapChunkTransform>(CHUNK_HEIGHT / 3, Block::Dirt);
+    return *(*floor + terrain()) | band;
+}
+
+AbsoluteChunkPosition nextPosition(int64_t i) {
+    // Walk a 64-wide strip so columns repeat only after many iterations
+    return AbsoluteChunkPosition(static_cast<int32_t>(i % 64), 0, static_cast<int32_t>(i / 64));
+}
+
+void transformBenchmark(benchmark::State& state, const std::shared_ptr<ChunkTransform>& transform) {
+    int64_t i = 0;
+    for (auto _ : state) {
+        ChunkSpan chunk(nextPosition(i++));
+        transform->apply(chunk);
+        benchmark::DoNotOptimize(chunk.getBlock(CHUNK_BLOCK_COUNT - 1));
+    }
+    state.counters["chunks/s"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+void generatorBenchmark(benchmark::State& state, const std::shared_ptr<IWorldgenStrategy>& generator) {
+    int64_t i = 0;
+    for (auto _ : state) {
+        const AbsoluteChunkPosition pos = nextPosition(i++);
+        ChunkSpan chunk(pos);
+        generator->generateChunk(pos, 42)->compile()->apply(chunk);
+        chunk.compact();
+        benchmark::DoNotOptimize(chunk.getBlock(CHUNK_BLOCK_COUNT - 1));
+    }
+    state.counters["chunks/s"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+void BM_EmptyTransform(benchmark::State& state) { transformBenchmark(state, std::make_shared<EmptyChunkTransform>()); }
+void BM_FillTransform(benchmark::State& state) { transformBenchmark(state, std::make_shared<FillChunkTransform>(Block::Stone)); }
+void BM_HeightmapTransform(benchmark::State& state) {
+    transformBenchmark(state, std::make_shared<HeightmapChunkTransform>(CHUNK_HEIGHT / 2, Block::Stone));
+}
+void BM_PerlinNoiseTransform(benchmark::State& state) { transformBenchmark(state, terrain()); }
+void BM_PerlinNoiseTransformCached(benchmark::State& state) {
+    transformBenchmark(state, terrain(PerlinNoiseChunkTransform::makeHeightCache(benchNoise(), 40.0, 3)));
+}
+void BM_LambdaTransform(benchmark::State& state) {
+    transformBenchmark(state, std::make_shared<LambdaChunkTransform>([](ChunkSpan& chunk) {
+        chunk.setBlock(ChunkLocalPosition(0, 0, 0), Block::Stone);
+    }));
+}
+void BM_CombinedTransform(benchmark::State& state) {
+    auto floor = std::make_shared<HeightmapChunkTransform>(CHUNK_HEIGHT / 4, Block::Stone);
+    transformBenchmark(state, std::make_shared<CombinedChunkTransform>(floor, terrain()));
+}
+void BM_MergeTransform(benchmark::State& state) {
+    auto band = std::make_shared<HeightmapChunkTransform>(CHUNK_HEIGHT / 3, Block::Dirt);
+    transformBenchmark(state, std::make_shared<MergeChunkTransform>(terrain(), band));
+}
+void BM_LayeredTree(benchmark::State& state) { transformBenchmark(state, layered()); }
+void BM_LayeredTreeCompiled(benchmark::State& state) { transformBenchmark(state, layered()->compile()); }
+
+void BM_FlatworldGenerator(benchmark::State& state) {
+    generatorBenchmark(state, std::make_shared<FlatworldChunkGenerator>(static_cast<size_t>(state.range(0)), Block::Grass));
+}
+
+} // namespace
+
+BENCHMARK(BM_EmptyTransform);
+BENCHMARK(BM_FillTransform);
+BENCHMARK(BM_HeightmapTransform);
+BENCHMARK(BM_PerlinNoiseTransform);
+BENCHMARK(BM_PerlinNoiseTransformCached);
+BENCHMARK(BM_LambdaTransform);
+BENCHMARK(BM_CombinedTransform);
+BENCHMARK(BM_MergeTransform);
+BENCHMARK(BM_LayeredTree);
+BENCHMARK(BM_LayeredTreeCompiled);
+BENCHMARK(BM_FlatworldGenerator)->Arg(1)->Arg(CHUNK_HEIGHT / 2)->Arg(CHUNK_HEIGHT * 3);
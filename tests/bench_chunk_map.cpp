@@ -0,0 +1,99 @@
+#include <benchmark/benchmark.h>
+#include "world.h"
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Chunk lookup throughput for the chunk-keyed containers at 10k-100k resident chunks.
+// Lookups mix hits inside a loaded cube of chunks with misses just outside it, like a
+// renderer probing neighbours.
+
+namespace {
+
+// The previous ChunkPosHash, kept for comparison
+struct XorShiftChunkPosHash {
+    std::size_t operator()(const AbsoluteChunkPosition& pos) const {
+        return std::hash<int32_t>()(pos.x) ^ (std::hash<int32_t>()(pos.y) << 1) ^ (std::hash<int32_t>()(pos.z) << 2);
+    }
+};
+
+// Resident chunks: a cube around the origin, flattened vertically the way loaded worlds are
+std::vector<AbsoluteChunkPosition> residentChunks(size_t count) {
+    std::vector<AbsoluteChunkPosition> result;
+    int32_t half = 1;
+    while (static_cast<size_t>(2 * half) * (2 * half) * 8 < count) ++half;
+    for (int32_t x = -half; x < half && result.size() < count; ++x) {
+        for (int32_t z = -half; z < half && result.size() < count; ++z) {
+            for (int32_t y = -4; y < 4 && result.size() < count; ++y) {
+                result.emplace_back(x, y, z);
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<AbsoluteChunkPosition> probes(const std::vector<AbsoluteChunkPosition>& resident) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> pick(0, resident.size() - 1);
+    std::vector<AbsoluteChunkPosition> result;
+    result.reserve(4096);
+    for (size_t i = 0; i < 4096; ++i) {
+        AbsoluteChunkPosition p = resident[pick(rng)];
+        // One in four probes is a miss one layer above the loaded slab
+        result.emplace_back(p.x, (i % 4 == 0) ? p.y + 8 : p.y, p.z);
+    }
+    return result;
+}
+
+template<typename Map>
+void lookupBenchmark(benchmark::State& state) {
+    const auto resident = residentChunks(static_cast<size_t>(state.range(0)));
+    const auto queries = probes(resident);
+    Map map;
+    auto chunk = std::make_shared<const ChunkSpan>(AbsoluteChunkPosition(0, 0, 0));
+    for (const auto& pos : resident) {
+        map.emplace(pos, chunk);
+    }
+
+    size_t found = 0;
+    for (auto _ : state) {
+        for (const auto& q : queries) {
+            found += map.find(q) != map.end() ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * queries.size()));
+}
+
+template<typename Map>
+void churnBenchmark(benchmark::State& state) {
+    // Load/unload churn: slide the resident cube one chunk along x per iteration
+    const auto resident = residentChunks(static_cast<size_t>(state.range(0)));
+    Map map;
+    auto chunk = std::make_shared<const ChunkSpan>(AbsoluteChunkPosition(0, 0, 0));
+    for (const auto& pos : resident) {
+        map.emplace(pos, chunk);
+    }
+    int32_t shift = 0;
+    for (auto _ : state) {
+        for (const auto& pos : resident) {
+            if (pos.x == resident.front().x) {
+                map.erase(AbsoluteChunkPosition(pos.x + shift, pos.y, pos.z));
+                map.emplace(AbsoluteChunkPosition(resident.back().x + shift + 1, pos.y, pos.z), chunk);
+            }
+        }
+        ++shift;
+    }
+}
+
+using StdMapOldHash = std::unordered_map<AbsoluteChunkPosition, std::shared_ptr<const ChunkSpan>, XorShiftChunkPosHash, ChunkPosEq>;
+using StdMapNewHash = std::unordered_map<AbsoluteChunkPosition, std::shared_ptr<const ChunkSpan>, ChunkPosHash, ChunkPosEq>;
+
+} // namespace
+
+BENCHMARK_TEMPLATE(lookupBenchmark, StdMapOldHash)->Arg(10000)->Arg(50000)->Arg(100000);
+BENCHMARK_TEMPLATE(lookupBenchmark, StdMapNewHash)->Arg(10000)->Arg(50000)->Arg(100000);
+BENCHMARK_TEMPLATE(lookupBenchmark, ChunkMap)->Arg(10000)->Arg(50000)->Arg(100000);
+BENCHMARK_TEMPLATE(churnBenchmark, StdMapOldHash)->Arg(10000)->Arg(100000);
+BENCHMARK_TEMPLATE(churnBenchmark, ChunkMap)->Arg(10000)->Arg(100000);
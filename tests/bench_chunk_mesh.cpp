@@ -0,0 +1,42 @@
+#include <benchmark/benchmark.h>
+#include "chunk_mesh.h"
+#include "bench_fixtures.h"
+#include "chunkspan.h"
+#include "chunkdims.h"
+#include <memory>
+
+// Headless chunk meshing throughput (no GL context), reported as chunks/s, for the chunk shapes
+// the renderer meets: flat ground, noise terrain, and the checkerboard worst case where no two
+// solid blocks touch.
+
+namespace {
+
+ChunkSpan makeChunk(int64_t shape) {
+    return makeBenchChunk(static_cast<BenchChunkShape>(shape), AbsoluteChunkPosition(3, 0, -2));
+}
+
+void meshBenchmark(benchmark::State& state, MeshingMode mode, VertexFormat format) {
+    const ChunkSpan chunk = makeChunk(state.range(0));
+    ChunkMeshScratch scratch;
+    ChunkMeshGeometry geometry;
+    for (auto _ : state) {
+        ChunkMesh::buildGeometry(chunk, mode, {}, scratch, geometry);
+        if (format == VertexFormat::Packed) {
+            ChunkMesh::pack(geometry);
+        }
+        benchmark::DoNotOptimize(geometry.vertexCount());
+    }
+    state.counters["chunks/s"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+    state.counters["vertices"] = static_cast<double>(geometry.vertexCount());
+}
+
+void BM_MeshNaive(benchmark::State& state) { meshBenchmark(state, MeshingMode::Naive, VertexFormat::Full); }
+void BM_MeshGreedy(benchmark::State& state) { meshBenchmark(state, MeshingMode::Greedy, VertexFormat::Full); }
+void BM_MeshGreedyPacked(benchmark::State& state) { meshBenchmark(state, MeshingMode::Greedy, VertexFormat::Packed); }
+
+} // namespace
+
+// Argument: 1 flat, 2 noise terrain, 3 checkerboard (see BenchChunkShape)
+BENCHMARK(BM_MeshNaive)->DenseRange(static_cast<int>(BenchChunkShape::Flat), static_cast<int>(BenchChunkShape::Checkerboard));
+BENCHMARK(BM_MeshGreedy)->DenseRange(static_cast<int>(BenchChunkShape::Flat), static_cast<int>(BenchChunkShape::Checkerboard));
+BENCHMARK(BM_MeshGreedyPacked)->DenseRange(static_cast<int>(BenchChunkShape::Flat), static_cast<int>(BenchChunkShape::Checkerboard));
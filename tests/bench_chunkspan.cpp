@@ -0,0 +1,68 @@
+#include <benchmark/benchmark.h>
+#include "chunkspan.h"
+#include "bench_fixtures.h"
+#include "chunkdims.h"
+#include <memory>
+#include <string_view>
+
+// ChunkSpan wire format: serialize() and the three ways back (owning vector, borrowed bytes,
+// decode() into an existing chunk), for uniform, layered, noisy and worst-case chunks.
+
+namespace {
+
+ChunkSpan makeChunk(int64_t shape) {
+    return makeBenchChunk(static_cast<BenchChunkShape>(shape), AbsoluteChunkPosition(-7, 0, 12));
+}
+
+void setCounters(benchmark::State& state, size_t bytes) {
+    state.counters["chunks/s"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+    state.counters["bytes"] = static_cast<double>(bytes);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+}
+
+void BM_Serialize(benchmark::State& state) {
+    const ChunkSpan chunk = makeChunk(state.range(0));
+    size_t bytes = 0;
+    for (auto _ : state) {
+        auto data = chunk.serialize();
+        bytes = data.size();
+        benchmark::DoNotOptimize(data.data());
+    }
+    setCounters(state, bytes);
+}
+
+void BM_DeserializeVector(benchmark::State& state) {
+    const auto data = makeChunk(state.range(0)).serialize();
+    for (auto _ : state) {
+        ChunkSpan chunk(data);
+        benchmark::DoNotOptimize(chunk.getBlock(CHUNK_BLOCK_COUNT - 1));
+    }
+    setCounters(state, data.size());
+}
+
+void BM_DeserializeBorrowed(benchmark::State& state) {
+    const auto data = makeChunk(state.range(0)).serialize();
+    const std::string_view bytes(reinterpret_cast<const char*>(data.data()), data.size());
+    for (auto _ : state) {
+        ChunkSpan chunk(bytes);
+        benchmark::DoNotOptimize(chunk.getBlock(CHUNK_BLOCK_COUNT - 1));
+    }
+    setCounters(state, data.size());
+}
+
+void BM_DecodeInPlace(benchmark::State& state) {
+    const auto data = makeChunk(state.range(0)).serialize();
+    ChunkSpan chunk(AbsoluteChunkPosition(0, 0, 0));
+    for (auto _ : state) {
+        chunk.decode(std::span<const uint8_t>(data));
+        benchmark::DoNotOptimize(chunk.getBlock(CHUNK_BLOCK_COUNT - 1));
+    }
+    setCounters(state, data.size());
+}
+
+} // namespace
+
+BENCHMARK(BM_Serialize)->DenseRange(static_cast<int>(BenchChunkShape::Uniform), static_cast<int>(BenchChunkShape::Checkerboard));
+BENCHMARK(BM_DeserializeVector)->DenseRange(static_cast<int>(BenchChunkShape::Uniform), static_cast<int>(BenchChunkShape::Checkerboard));
+BENCHMARK(BM_DeserializeBorrowed)->DenseRange(static_cast<int>(BenchChunkShape::Uniform), static_cast<int>(BenchChunkShape::Checkerboard));
+BENCHMARK(BM_DecodeInPlace)->DenseRange(static_cast<int>(BenchChunkShape::Uniform), static_cast<int>(BenchChunkShape::Checkerboard));
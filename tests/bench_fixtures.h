@@ -0,0 +1,41 @@
+#pragma once
+
+#include "chunkspan.h"
+#include "chunktransform.h"
+#include "chunkdims.h"
+#include <memory>
+
+// Chunk shapes shared by the benchmarks, passed as the benchmark argument: uniform stone, flat
+// ground, noise terrain, and the checkerboard worst case where no two solid blocks touch.
+enum class BenchChunkShape { Uniform, Flat, Terrain, Checkerboard };
+
+// A compacted chunk of the given shape at position
+inline ChunkSpan makeBenchChunk(BenchChunkShape shape, const AbsoluteChunkPosition& position) {
+    ChunkSpan chunk(position);
+    switch (shape) {
+    case BenchChunkShape::Uniform:
+        FillChunkTransform(Block::Stone).apply(chunk);
+        break;
+    case BenchChunkShape::Flat:
+        HeightmapChunkTransform(CHUNK_HEIGHT / 2, Block::Stone).apply(chunk);
+        break;
+    case BenchChunkShape::Terrain: {
+        auto noise = std::make_shared<siv::PerlinNoise>(1234u);
+        PerlinNoiseChunkTransform(noise, 40.0, 3, 0.5, Block::Grass, 0, CHUNK_HEIGHT).apply(chunk);
+        break;
+    }
+    case BenchChunkShape::Checkerboard:
+        for (int z = 0; z < CHUNK_DEPTH; ++z) {
+            for (int y = 0; y < CHUNK_HEIGHT; ++y) {
+                for (int x = 0; x < CHUNK_WIDTH; ++x) {
+                    if ((x + y + z) % 2 == 0) {
+                        chunk.setBlock(ChunkLocalPosition(x, y, z), Block::Stone);
+                    }
+                }
+            }
+        }
+        break;
+    }
+    chunk.compact();
+    return chunk;
+}
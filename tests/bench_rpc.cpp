@@ -0,0 +1,116 @@
+#include <benchmark/benchmark.h>
+#include <grpcpp/grpcpp.h>
+#include "blockserver.grpc.pb.h"
+#include "server.h"
+#include "world.h"
+#include "chunk_generators.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+// End-to-end GetChunk over loopback against an in-process Server, in both server modes and with
+// 1 to 8 client threads sharing one channel. Besides calls/s, each thread reports its median and
+// 99th percentile latency, averaged over threads. Revalidation sends the version the client
+// already holds, so the reply is not_modified and carries no chunk.
+
+namespace {
+
+constexpr int32_t LOADED_RADIUS = 4;
+
+struct RpcBench {
+    std::shared_ptr<World> world;
+    std::unique_ptr<Server> server;
+    std::unique_ptr<blockserver::BlockServer::Stub> stub;
+    std::vector<AbsoluteChunkPosition> chunks;
+};
+
+// Set up by thread 0 before the timed loop, which starts with a barrier, and torn down after it
+RpcBench* bench = nullptr;
+
+RpcBench* startBench(ServerMode mode) {
+    static std::atomic<uint16_t> nextPort{9590};
+    auto result = new RpcBench;
+    auto generator = std::make_shared<FlatworldChunkGenerator>(1, Block::Grass);
+    result->world = std::make_shared<World>(generator, []() { return std::vector<AbsoluteBlockPosition>{ {0,0,0} }; }, LOADED_RADIUS, 42);
+    result->world->ensureChunksLoaded();
+    for (int32_t x = -LOADED_RADIUS / 2; x <= LOADED_RADIUS / 2; ++x) {
+        for (int32_t z = -LOADED_RADIUS / 2; z <= LOADED_RADIUS / 2; ++z) {
+            result->chunks.emplace_back(x, 0, z);
+        }
+    }
+    const uint16_t port = nextPort.fetch_add(1);
+    result->server = std::make_unique<Server>(port, result->world, mode);
+    result->server->start();
+    auto channel = grpc::CreateChannel("127.0.0.1:" + std::to_string(port), grpc::InsecureChannelCredentials());
+    channel->WaitForConnected(std::chrono::system_clock::now() + std::chrono::seconds(5));
+    result->stub = blockserver::BlockServer::NewStub(channel);
+    return result;
+}
+
+double percentile(std::vector<double>& samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    const size_t index = std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+void getChunkBenchmark(benchmark::State& state, ServerMode mode, bool revalidate) {
+    if (state.thread_index() == 0) {
+        bench = startBench(mode);
+    }
+
+    std::vector<double> latenciesUs;
+    std::vector<uint64_t> versions;
+    size_t i = static_cast<size_t>(state.thread_index());
+    int64_t failures = 0;
+    for (auto _ : state) {
+        if (versions.empty()) {
+            versions.assign(bench->chunks.size(), 0);
+        }
+        const size_t index = i++ % bench->chunks.size();
+        const AbsoluteChunkPosition& pos = bench->chunks[index];
+        blockserver::ChunkRequest request;
+        request.set_x(pos.x);
+        request.set_y(pos.y);
+        request.set_z(pos.z);
+        if (revalidate) {
+            request.set_known_version(versions[index]);
+        }
+        blockserver::ChunkResponse response;
+        grpc::ClientContext context;
+        const auto started = std::chrono::steady_clock::now();
+        const grpc::Status status = bench->stub->GetChunk(&context, request, &response);
+        latenciesUs.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count());
+        if (!status.ok() || !response.success()) {
+            ++failures;
+        } else if (revalidate) {
+            versions[index] = response.version();
+        }
+    }
+
+    state.counters["calls/s"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+    state.counters["p50_us"] = benchmark::Counter(percentile(latenciesUs, 0.50), benchmark::Counter::kAvgThreads);
+    state.counters["p99_us"] = benchmark::Counter(percentile(latenciesUs, 0.99), benchmark::Counter::kAvgThreads);
+    state.counters["failures"] = static_cast<double>(failures);
+    if (state.thread_index() == 0) {
+        bench->server->stop();
+        delete bench;
+        bench = nullptr;
+    }
+}
+
+void BM_GetChunkSync(benchmark::State& state) { getChunkBenchmark(state, ServerMode::Sync, false); }
+void BM_GetChunkAsync(benchmark::State& state) { getChunkBenchmark(state, ServerMode::Async, false); }
+void BM_GetChunkRevalidateSync(benchmark::State& state) { getChunkBenchmark(state, ServerMode::Sync, true); }
+void BM_GetChunkRevalidateAsync(benchmark::State& state) { getChunkBenchmark(state, ServerMode::Async, true); }
+
+} // namespace
+
+BENCHMARK(BM_GetChunkSync)->Threads(1)->Threads(8)->UseRealTime();
+BENCHMARK(BM_GetChunkAsync)->Threads(1)->Threads(8)->UseRealTime();
+BENCHMARK(BM_GetChunkRevalidateSync)->Threads(1)->Threads(8)->UseRealTime();
+BENCHMARK(BM_GetChunkRevalidateAsync)->Threads(1)->Threads(8)->UseRealTime();
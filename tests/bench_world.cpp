@@ -0,0 +1,199 @@
+#include <benchmark/benchmark.h>
+#include "world.h"
+#include "chunk_generators.h"
+#include "chunktransform.h"
+#include "sqlite_chunk_persistence.h"
+#include "chunkdims.h"
+#include <sqlite3.h>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+// World residency and SQLite persistence. Residency benchmarks take the anchor radius in chunks
+// and the number of anchors; anchors are spaced so their spheres don't overlap, the way players
+// spread over a server. Persistence benchmarks write to a WAL database in the temp directory.
+
+namespace {
+
+// Anchors along z, two radii apart, all shifted by offsetChunks along x
+struct Anchors {
+    int32_t radius;
+    int32_t count;
+    std::shared_ptr<std::atomic<int32_t>> offsetChunks = std::make_shared<std::atomic<int32_t>>(0);
+
+    std::function<std::vector<AbsoluteBlockPosition>()> callback() const {
+        return [radius = radius, count = count, offset = offsetChunks]() {
+            std::vector<AbsoluteBlockPosition> result;
+            for (int32_t i = 0; i < count; ++i) {
+                result.emplace_back(offset->load() * CHUNK_WIDTH, 0, i * (2 * radius + 1) * CHUNK_DEPTH);
+            }
+            return result;
+        };
+    }
+};
+
+std::unique_ptr<World> makeWorld(const Anchors& anchors) {
+    auto generator = std::make_shared<FlatworldChunkGenerator>(1, Block::Grass);
+    return std::make_unique<World>(generator, anchors.callback(), static_cast<size_t>(anchors.radius), 42);
+}
+
+// Cold start: every anchor's sphere is generated from nothing
+void BM_EnsureChunksLoaded(benchmark::State& state) {
+    Anchors anchors{static_cast<int32_t>(state.range(0)), static_cast<int32_t>(state.range(1))};
+    std::unique_ptr<World> world;
+    for (auto _ : state) {
+        state.PauseTiming();
+        world.reset();
+        world = makeWorld(anchors);
+        state.ResumeTiming();
+        world->ensureChunksLoaded();
+    }
+}
+
+// Every anchor moves far enough that all of its chunks unload
+void BM_GarbageCollectChunks(benchmark::State& state) {
+    Anchors anchors{static_cast<int32_t>(state.range(0)), static_cast<int32_t>(state.range(1))};
+    std::unique_ptr<World> world;
+    for (auto _ : state) {
+        state.PauseTiming();
+        world.reset();
+        anchors.offsetChunks->store(0);
+        world = makeWorld(anchors);
+        world->ensureChunksLoaded();
+        anchors.offsetChunks->store(4 * anchors.radius + 2);
+        state.ResumeTiming();
+        world->garbageCollectChunks();
+    }
+}
+
+// Steady state: each tick every anchor walks one chunk, loading the leading face of its sphere
+// and unloading the trailing one
+void BM_AnchorsWalk(benchmark::State& state) {
+    Anchors anchors{static_cast<int32_t>(state.range(0)), static_cast<int32_t>(state.range(1))};
+    auto world = makeWorld(anchors);
+    world->ensureChunksLoaded();
+    for (auto _ : state) {
+        anchors.offsetChunks->fetch_add(1);
+        world->ensureChunksLoaded();
+        world->garbageCollectChunks();
+    }
+    state.counters["ticks/s"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+void residencyArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"radius", "anchors"})->ArgsProduct({{2, 4, 8}, {1, 4, 16}})->Unit(benchmark::kMillisecond);
+}
+
+// A fresh database per benchmark, removed when it ends
+class BenchDatabase {
+public:
+    explicit BenchDatabase(SQLiteSynchronousMode mode = SQLiteSynchronousMode::Normal)
+        : path_(std::filesystem::temp_directory_path() / "blocktest_bench.db") {
+        removeFiles();
+        sqlite3* raw = nullptr;
+        sqlite3_open(path_.string().c_str(), &raw);
+        persistence_ = std::make_unique<SQLiteChunkPersistence>(std::unique_ptr<sqlite3, decltype(&sqlite3_close)>(raw, sqlite3_close), mode);
+    }
+    ~BenchDatabase() {
+        persistence_.reset();
+        removeFiles();
+    }
+    SQLiteChunkPersistence& persistence() { return *persistence_; }
+
+private:
+    void removeFiles() {
+        std::filesystem::remove(path_);
+        std::filesystem::remove(path_.string() + "-wal");
+        std::filesystem::remove(path_.string() + "-shm");
+    }
+
+    std::filesystem::path path_;
+    std::unique_ptr<SQLiteChunkPersistence> persistence_;
+};
+
+// Chunks with a few distinct layers each, so rows are a realistic size
+std::vector<std::shared_ptr<const ChunkSpan>> makeChunks(size_t count) {
+    std::vector<std::shared_ptr<const ChunkSpan>> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto chunk = std::make_shared<ChunkSpan>(AbsoluteChunkPosition(static_cast<int32_t>(i % 64), 0, static_cast<int32_t>(i / 64)));
+        HeightmapChunkTransform(static_cast<int>(i % CHUNK_HEIGHT), Block::Stone).apply(*chunk);
+        chunk->setBlock(i % CHUNK_BLOCK_COUNT, Block::Dirt);
+        chunk->compact();
+        result.push_back(chunk);
+    }
+    return result;
+}
+
+constexpr size_t STORED_CHUNKS = 4096;
+
+void BM_SQLiteSaveChunk(benchmark::State& state) {
+    BenchDatabase db(static_cast<SQLiteSynchronousMode>(state.range(0)));
+    const auto chunks = makeChunks(STORED_CHUNKS);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.persistence().saveChunk(*chunks[i++ % chunks.size()]));
+    }
+    state.counters["chunks/s"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+void BM_SQLiteSaveChunks(benchmark::State& state) {
+    BenchDatabase db(static_cast<SQLiteSynchronousMode>(state.range(0)));
+    const auto chunks = makeChunks(STORED_CHUNKS);
+    const size_t batchSize = static_cast<size_t>(state.range(1));
+    std::vector<std::shared_ptr<const ChunkSpan>> batch;
+    size_t i = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        batch.clear();
+        for (size_t j = 0; j < batchSize; ++j) {
+            batch.push_back(chunks[i++ % chunks.size()]);
+        }
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(db.persistence().saveChunks(batch));
+    }
+    state.counters["chunks/s"] = benchmark::Counter(static_cast<double>(state.iterations() * batchSize), benchmark::Counter::kIsRate);
+}
+
+void BM_SQLiteLoadChunk(benchmark::State& state) {
+    BenchDatabase db;
+    const auto chunks = makeChunks(STORED_CHUNKS);
+    db.persistence().saveChunks(chunks);
+    size_t i = 0;
+    for (auto _ : state) {
+        auto loaded = db.persistence().loadChunk(chunks[i++ % chunks.size()]->position);
+        benchmark::DoNotOptimize(loaded);
+    }
+    state.counters["chunks/s"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+void BM_SQLiteLoadChunks(benchmark::State& state) {
+    BenchDatabase db;
+    const auto chunks = makeChunks(STORED_CHUNKS);
+    db.persistence().saveChunks(chunks);
+    const size_t batchSize = static_cast<size_t>(state.range(0));
+    std::vector<AbsoluteChunkPosition> positions;
+    for (const auto& chunk : chunks) {
+        positions.push_back(chunk->position);
+    }
+    size_t start = 0;
+    for (auto _ : state) {
+        auto loaded = db.persistence().loadChunks(std::span<const AbsoluteChunkPosition>(positions).subspan(start, batchSize));
+        benchmark::DoNotOptimize(loaded);
+        start = (start + batchSize) % (positions.size() - batchSize);
+    }
+    state.counters["chunks/s"] = benchmark::Counter(static_cast<double>(state.iterations() * batchSize), benchmark::Counter::kIsRate);
+}
+
+} // namespace
+
+BENCHMARK(BM_EnsureChunksLoaded)->Apply(residencyArgs);
+BENCHMARK(BM_GarbageCollectChunks)->Apply(residencyArgs);
+BENCHMARK(BM_AnchorsWalk)->Apply(residencyArgs);
+
+BENCHMARK(BM_SQLiteSaveChunk)->ArgName("sync")->DenseRange(static_cast<int>(SQLiteSynchronousMode::Off), static_cast<int>(SQLiteSynchronousMode::Full));
+BENCHMARK(BM_SQLiteSaveChunks)->ArgNames({"sync", "batch"})
+    ->ArgsProduct({{static_cast<int>(SQLiteSynchronousMode::Off), static_cast<int>(SQLiteSynchronousMode::Normal)}, {16, 256}});
+BENCHMARK(BM_SQLiteLoadChunk);
+BENCHMARK(BM_SQLiteLoadChunks)->ArgName("batch")->Arg(16)->Arg(256);
@@ -61,6 +61,14 @@ TEST_F(BlockTest, TextureIndices) {
     EXPECT_EQ(emptyIndexY, 17);
 }
 
+// Tile indices count row by row across the atlas
+TEST_F(BlockTest, TileIndices) {
+    EXPECT_EQ(getTileIndex(Block::Grass), 10 * BLOCKS_PER_ROW + 4);
+    EXPECT_EQ(getTileIndex(Block::Dirt), 3);
+    EXPECT_EQ(getTileIndex(Block::Air), getTileIndex(Block::Empty));
+    EXPECT_EQ(BLOCK_TYPE_COUNT, static_cast<size_t>(Block::Dirt) + 1);
+}
+
 // Test constants
 TEST_F(BlockTest, Constants) {
     EXPECT_EQ(TEXTURE_ATLAS_WIDTH, 512);
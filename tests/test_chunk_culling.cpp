@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include "chunk_culling.h"
+#include "chunk_mesh.h"
+#include "chunkdims.h"
+#include "block.h"
+
+namespace {
+
+int blockIndex(int x, int y, int z) {
+    return x + y * CHUNK_WIDTH + z * CHUNK_WIDTH * CHUNK_HEIGHT;
+}
+
+} // namespace
+
+TEST(ChunkFaceConnectivityTest, EmptyAndSolidChunks) {
+    EXPECT_EQ(computeChunkFaceConnectivity(std::vector<Block>(CHUNK_BLOCK_COUNT, Block::Air)), CHUNK_FACES_ALL_CONNECTED);
+    EXPECT_EQ(computeChunkFaceConnectivity(std::vector<Block>(CHUNK_BLOCK_COUNT, Block::Stone)), 0);
+}
+
+TEST(ChunkFaceConnectivityTest, FloorSeparatesTopFromBottom) {
+    std::vector<Block> blocks(CHUNK_BLOCK_COUNT, Block::Air);
+    for (int z = 0; z < CHUNK_DEPTH; ++z) {
+        for (int x = 0; x < CHUNK_WIDTH; ++x) {
+            blocks[blockIndex(x, 8, z)] = Block::Stone;
+        }
+    }
+    ChunkFaceConnectivity connectivity = computeChunkFaceConnectivity(blocks);
+    EXPECT_FALSE(chunkFacesConnected(connectivity, 4, 5));
+    EXPECT_TRUE(chunkFacesConnected(connectivity, 4, 2));
+    EXPECT_TRUE(chunkFacesConnected(connectivity, 5, 3));
+    EXPECT_TRUE(chunkFacesConnected(connectivity, 0, 1));
+    EXPECT_TRUE(chunkFacesConnected(connectivity, 3, 2));
+
+    // One hole joins the two halves
+    blocks[blockIndex(3, 8, 12)] = Block::Air;
+    EXPECT_EQ(computeChunkFaceConnectivity(blocks), CHUNK_FACES_ALL_CONNECTED);
+}
+
+TEST(ChunkFaceConnectivityTest, MesherRecordsConnectivity) {
+    std::vector<Block> blocks(CHUNK_BLOCK_COUNT, Block::Stone);
+    ChunkMeshGeometry geometry = ChunkMesh::buildGeometry(blocks, glm::vec3(0.0f), MeshingMode::Greedy);
+    EXPECT_EQ(geometry.faceConnectivity, 0);
+}
+
+TEST(FrustumTest, RejectsChunksBehindAndBesideTheCamera) {
+    // At the origin looking down -z
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+    Frustum frustum(projection * view);
+
+    EXPECT_TRUE(frustum.intersectsChunk(AbsoluteChunkPosition(0, 0, -2)));
+    EXPECT_TRUE(frustum.intersectsChunk(AbsoluteChunkPosition(-1, -1, -2)));
+    // The camera's own chunk straddles the near plane
+    EXPECT_TRUE(frustum.intersectsChunk(AbsoluteChunkPosition(0, 0, 0)));
+    EXPECT_FALSE(frustum.intersectsChunk(AbsoluteChunkPosition(0, 0, 2)));
+    EXPECT_FALSE(frustum.intersectsChunk(AbsoluteChunkPosition(4, 0, -1)));
+    EXPECT_FALSE(frustum.intersectsChunk(AbsoluteChunkPosition(0, 0, -8)));
+}
+
+TEST(FindVisibleChunksTest, SolidGroundHidesWhatIsBelowIt) {
+    auto connectivity = [](const AbsoluteChunkPosition& pos) -> std::optional<ChunkFaceConnectivity> {
+        if (pos.y < 0) {
+            return ChunkFaceConnectivity{0};
+        }
+        return CHUNK_FACES_ALL_CONNECTED;
+    };
+    ChunkSet visible = findVisibleChunks(AbsoluteChunkPosition(0, 0, 0), 3, connectivity, [](const AbsoluteChunkPosition&) { return true; });
+
+    // The ground's top layer is drawn, nothing under it
+    EXPECT_TRUE(visible.contains(AbsoluteChunkPosition(0, -1, 0)));
+    EXPECT_TRUE(visible.contains(AbsoluteChunkPosition(2, -1, -3)));
+    EXPECT_FALSE(visible.contains(AbsoluteChunkPosition(0, -2, 0)));
+    EXPECT_FALSE(visible.contains(AbsoluteChunkPosition(3, -3, 1)));
+    EXPECT_TRUE(visible.contains(AbsoluteChunkPosition(3, 3, 3)));
+    // Outside maxDistance
+    EXPECT_FALSE(visible.contains(AbsoluteChunkPosition(4, 0, 0)));
+}
+
+TEST(FindVisibleChunksTest, WallsAndFrustumStopTheWalk) {
+    // A solid wall of chunks at x = 1
+    auto connectivity = [](const AbsoluteChunkPosition& pos) -> std::optional<ChunkFaceConnectivity> {
+        if (pos.x == 1) {
+            return ChunkFaceConnectivity{0};
+        }
+        return std::nullopt;
+    };
+    auto everything = [](const AbsoluteChunkPosition&) { return true; };
+    ChunkSet visible = findVisibleChunks(AbsoluteChunkPosition(0, 0, 0), 3, connectivity, everything);
+    EXPECT_TRUE(visible.contains(AbsoluteChunkPosition(1, 0, 0)));
+    EXPECT_TRUE(visible.contains(AbsoluteChunkPosition(-3, 2, 1)));
+    for (int32_t y = -3; y <= 3; ++y) {
+        for (int32_t z = -3; z <= 3; ++z) {
+            EXPECT_FALSE(visible.contains(AbsoluteChunkPosition(2, y, z)));
+        }
+    }
+
+    // Only the -z half space is in view; the camera's chunk is kept anyway
+    ChunkSet ahead = findVisibleChunks(AbsoluteChunkPosition(0, 0, 0), 3,
+                                       [](const AbsoluteChunkPosition&) { return std::nullopt; },
+                                       [](const AbsoluteChunkPosition& pos) { return pos.z <= 0; });
+    EXPECT_TRUE(ahead.contains(AbsoluteChunkPosition(0, 0, 0)));
+    EXPECT_TRUE(ahead.contains(AbsoluteChunkPosition(-2, 1, -3)));
+    EXPECT_FALSE(ahead.contains(AbsoluteChunkPosition(0, 0, 1)));
+}
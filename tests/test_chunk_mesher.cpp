@@ -0,0 +1,386 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include "chunk_mesher.h"
+#include "buffer_range_allocator.h"
+#include "chunk_mesh_cache.h"
+#include "chunk_mesh.h"
+#include "chunkspan.h"
+#include "chunkdims.h"
+#include <algorithm>
+
+namespace {
+
+// Drains the mesher until want results arrive or a few seconds pass
+std::vector<ChunkMesher::Result> drain(ChunkMesher& mesher, size_t want) {
+    std::vector<ChunkMesher::Result> results;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (results.size() < want && std::chrono::steady_clock::now() < deadline) {
+        mesher.drainCompleted(std::chrono::milliseconds(1), [&](ChunkMesher::Result&& result) {
+            results.push_back(std::move(result));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return results;
+}
+
+std::vector<Block> blocksOf(const ChunkSpan& chunk) {
+    std::vector<Block> blocks(CHUNK_BLOCK_COUNT);
+    chunk.copyTo(std::span<Block, CHUNK_BLOCK_COUNT>(blocks.data(), CHUNK_BLOCK_COUNT));
+    return blocks;
+}
+
+// Block faces covered by each quad, from how often its texture repeats
+float coveredFaces(const ChunkMeshGeometry& geometry) {
+    float total = 0.0f;
+    for (size_t i = 0; i < geometry.vertices.size(); i += 4) {
+        // Corner 1 carries the full (u, v) repeat of the quad
+        total += geometry.vertices[i + 1].texCoord.x * geometry.vertices[i + 1].texCoord.y;
+    }
+    return total;
+}
+
+} // namespace
+
+TEST(ChunkMeshTest, GreedyMergesAFlatLayerIntoOneQuadPerSide) {
+    ChunkSpan chunk(AbsoluteChunkPosition(0, 0, 0));
+    for (int x = 0; x < CHUNK_WIDTH; ++x) {
+        for (int z = 0; z < CHUNK_DEPTH; ++z) {
+            chunk.setBlock(ChunkLocalPosition(x, 3, z), Block::Grass);
+        }
+    }
+    auto blocks = blocksOf(chunk);
+    auto naive = ChunkMesh::buildGeometry(blocks, glm::vec3(0.0f), MeshingMode::Naive);
+    auto greedy = ChunkMesh::buildGeometry(blocks, glm::vec3(0.0f), MeshingMode::Greedy);
+
+    EXPECT_EQ(naive.vertices.size() / 4, static_cast<size_t>(2 * CHUNK_WIDTH * CHUNK_DEPTH + 2 * (CHUNK_WIDTH + CHUNK_DEPTH)));
+    ASSERT_EQ(greedy.vertices.size() / 4, 6u);
+    EXPECT_EQ(greedy.indices.size(), 36u);
+    EXPECT_FLOAT_EQ(coveredFaces(greedy), coveredFaces(naive));
+
+    // The top quad spans the whole layer and repeats the grass texture once per block
+    auto top = std::find_if(greedy.vertices.begin(), greedy.vertices.end(), [](const Vertex& v) { return v.normal.y > 0.5f; });
+    ASSERT_NE(top, greedy.vertices.end());
+    EXPECT_FLOAT_EQ(top[1].texCoord.x, static_cast<float>(CHUNK_WIDTH));
+    EXPECT_FLOAT_EQ(top[1].texCoord.y, static_cast<float>(CHUNK_DEPTH));
+    EXPECT_FLOAT_EQ(top[1].position.x - top[0].position.x, static_cast<float>(CHUNK_WIDTH));
+    EXPECT_TRUE(top->tile == BlockRenderer::getTileOrigin(Block::Grass));
+}
+
+TEST(ChunkMeshTest, GreedyCoversTheSameFacesOnMixedTerrain) {
+    ChunkSpan chunk(AbsoluteChunkPosition(0, 0, 0));
+    // Rolling stone with a dirt cap and some holes, so merges stop at block and height changes
+    for (int x = 0; x < CHUNK_WIDTH; ++x) {
+        for (int z = 0; z < CHUNK_DEPTH; ++z) {
+            int height = 4 + (x / 4 + z / 5) % 3;
+            for (int y = 0; y <= height; ++y) {
+                if ((x * 7 + y * 3 + z * 5) % 61 == 0) {
+                    continue;
+                }
+                chunk.setBlock(ChunkLocalPosition(x, y, z), y == height ? Block::Dirt : Block::Stone);
+            }
+        }
+    }
+    auto blocks = blocksOf(chunk);
+    auto naive = ChunkMesh::buildGeometry(blocks, glm::vec3(0.0f), MeshingMode::Naive);
+    auto greedy = ChunkMesh::buildGeometry(blocks, glm::vec3(0.0f), MeshingMode::Greedy);
+
+    EXPECT_FLOAT_EQ(coveredFaces(greedy), coveredFaces(naive));
+    EXPECT_LT(greedy.vertices.size() * 4, naive.vertices.size());
+}
+
+TEST(ChunkMeshTest, ReusedBuffersMeshStraightFromTheChunkSpan) {
+    ChunkSpan busy(AbsoluteChunkPosition(2, 0, -1));
+    ChunkSpan sparse(AbsoluteChunkPosition(-3, 1, 0));
+    for (int x = 0; x < CHUNK_WIDTH; x += 2) {
+        for (int z = 0; z < CHUNK_DEPTH; ++z) {
+            busy.setBlock(ChunkLocalPosition(x, (x + z) % CHUNK_HEIGHT, z), Block::Stone);
+        }
+    }
+    sparse.setBlock(ChunkLocalPosition(4, 4, 4), Block::Wood);
+
+    ChunkMeshScratch scratch;
+    ChunkMeshGeometry out;
+    for (MeshingMode mode : {MeshingMode::Naive, MeshingMode::Greedy}) {
+        ChunkMesh::buildGeometry(busy, mode, {}, scratch, out);
+        const Vertex* vertexStorage = out.vertices.data();
+        const unsigned int* indexStorage = out.indices.data();
+
+        // A smaller mesh built into the same buffers comes out the same as one built fresh, in place
+        ChunkMesh::buildGeometry(sparse, mode, {}, scratch, out);
+        auto expected = ChunkMesh::buildGeometry(blocksOf(sparse), glm::vec3(-3 * CHUNK_WIDTH, CHUNK_HEIGHT, 0), mode);
+        EXPECT_EQ(out.vertices.data(), vertexStorage);
+        EXPECT_EQ(out.indices.data(), indexStorage);
+        EXPECT_EQ(out.indices, expected.indices);
+        ASSERT_EQ(out.vertices.size(), expected.vertices.size());
+        EXPECT_TRUE(out.vertices.back().position == expected.vertices.back().position);
+        EXPECT_TRUE(out.origin == expected.origin);
+        EXPECT_EQ(out.faceConnectivity, expected.faceConnectivity);
+
+        // Packing keeps the Full buffers for the next build
+        ChunkMesh::pack(out);
+        EXPECT_GE(out.vertices.capacity(), expected.vertices.size());
+    }
+}
+
+TEST(ChunkMeshTest, BorderFacesAreCulledAgainstNeighbours) {
+    const AbsoluteChunkPosition pos(0, 0, 0);
+    ChunkSpan chunk(pos);
+    chunk.fill(Block::Stone);
+    auto blocks = blocksOf(chunk);
+
+    // Alone, a solid chunk shows all six walls
+    const float wall = static_cast<float>(CHUNK_WIDTH * CHUNK_HEIGHT);
+    EXPECT_FLOAT_EQ(coveredFaces(ChunkMesh::buildGeometry(blocks, glm::vec3(0.0f), MeshingMode::Greedy)), 6 * wall);
+
+    // Solid on the right and on top, and the chunk below has a one-block hole under the border
+    ChunkNeighbours neighbours;
+    auto solid = std::make_shared<ChunkSpan>(ChunkNeighbours::positionOf(pos, 3));
+    solid->fill(Block::Dirt);
+    neighbours.faces[3] = solid;
+    neighbours.faces[4] = solid;
+    auto below = std::make_shared<ChunkSpan>(ChunkNeighbours::positionOf(pos, 5));
+    below->fill(Block::Stone);
+    below->setBlock(ChunkLocalPosition(2, CHUNK_HEIGHT - 1, 7), Block::Air);
+    neighbours.faces[5] = below;
+    EXPECT_TRUE(ChunkPosEq{}(below->position, AbsoluteChunkPosition(0, -1, 0)));
+
+    for (MeshingMode mode : {MeshingMode::Naive, MeshingMode::Greedy}) {
+        auto geometry = ChunkMesh::buildGeometry(blocks, glm::vec3(0.0f), mode, neighbours);
+        EXPECT_FLOAT_EQ(coveredFaces(geometry), 3 * wall + 1);
+        for (const Vertex& v : geometry.vertices) {
+            EXPECT_FALSE(v.normal.x > 0.5f || v.normal.y > 0.5f);
+        }
+    }
+}
+
+TEST(ChunkMeshTest, PackedVerticesDecodeToTheFullOnes) {
+    const AbsoluteChunkPosition pos(-2, 1, 3);
+    ChunkSpan chunk(pos);
+    for (int x = 0; x < CHUNK_WIDTH; ++x) {
+        for (int z = 0; z < CHUNK_DEPTH; ++z) {
+            chunk.setBlock(ChunkLocalPosition(x, (x + z) % CHUNK_HEIGHT, z), (x + z) % 2 ? Block::Stone : Block::Grass);
+        }
+    }
+    const glm::vec3 origin(pos.x * CHUNK_WIDTH, pos.y * CHUNK_HEIGHT, pos.z * CHUNK_DEPTH);
+    auto full = ChunkMesh::buildGeometry(blocksOf(chunk), origin, MeshingMode::Greedy);
+    auto packed = full;
+    ChunkMesh::pack(packed);
+
+    ASSERT_EQ(packed.format, VertexFormat::Packed);
+    EXPECT_TRUE(packed.vertices.empty());
+    ASSERT_EQ(packed.packedVertices.size(), full.vertices.size());
+    ASSERT_EQ(packed.packedIndices.size(), full.indices.size());
+    for (size_t i = 0; i < full.indices.size(); ++i) {
+        ASSERT_EQ(packed.packedIndices[i], full.indices[i]);
+    }
+    // Same decoding as the packed chunk shader
+    for (size_t i = 0; i < full.vertices.size(); ++i) {
+        const Vertex& expected = full.vertices[i];
+        const PackedVertex& v = packed.packedVertices[i];
+        glm::vec3 position = origin + glm::vec3(static_cast<float>(v.corner & 31u), static_cast<float>((v.corner >> 5) & 31u), static_cast<float>((v.corner >> 10) & 31u)) - glm::vec3(0.5f);
+        ASSERT_TRUE(position == expected.position) << "vertex " << i;
+        uint32_t face = (v.corner >> 15) & 7u;
+        ASSERT_TRUE(ChunkPosEq{}(ChunkNeighbours::positionOf(AbsoluteChunkPosition(0, 0, 0), static_cast<int>(face)),
+                                 AbsoluteChunkPosition(static_cast<int32_t>(expected.normal.x), static_cast<int32_t>(expected.normal.y), static_cast<int32_t>(expected.normal.z))));
+        ASSERT_FLOAT_EQ(static_cast<float>((v.corner >> 18) & 31u), expected.texCoord.x);
+        ASSERT_FLOAT_EQ(static_cast<float>((v.corner >> 23) & 31u), expected.texCoord.y);
+        glm::vec2 tile(static_cast<float>(v.tile % BLOCKS_PER_ROW) * BlockRenderer::getTileSize(), static_cast<float>(v.tile / BLOCKS_PER_ROW) * BlockRenderer::getTileSize());
+        ASSERT_TRUE(tile == expected.tile);
+    }
+}
+
+TEST(ChunkMeshTest, FaceUVTableMatchesTheAtlasLayout) {
+    // Built at compile time; spot-check one entry there as well
+    static_assert(BLOCK_FACE_UVS[static_cast<size_t>(Block::Grass)][4][3].u == 4.0f / BLOCKS_PER_ROW);
+    const float tileSize = BlockRenderer::getTileSize();
+    for (size_t index = 0; index < BLOCK_TYPE_COUNT; ++index) {
+        Block block = static_cast<Block>(index);
+        auto [texX, texY] = getTextureIndex(block);
+        glm::vec2 origin(static_cast<float>(texX) * tileSize, static_cast<float>(texY) * tileSize);
+        EXPECT_EQ(BlockRenderer::getTileOrigin(block), origin);
+        for (int face = 0; face < 6; ++face) {
+            for (int vertex = 0; vertex < 4; ++vertex) {
+                glm::vec2 corner = BlockRenderer::getTileCorner(vertex);
+                glm::vec2 uv = BlockRenderer::getTextureUV(block, face, vertex);
+                EXPECT_FLOAT_EQ(uv.x, origin.x + corner.x * tileSize);
+                EXPECT_FLOAT_EQ(uv.y, origin.y + corner.y * tileSize);
+            }
+        }
+    }
+    // Values outside the enum fall back to Empty's texture rather than reading past the table
+    EXPECT_EQ(BlockRenderer::getTileOrigin(static_cast<Block>(200)), BlockRenderer::getTileOrigin(Block::Empty));
+}
+
+TEST(ChunkMesherTest, BuildsTheSameGeometryAsTheRenderThread) {
+    const AbsoluteChunkPosition pos(1, -1, 2);
+    auto chunk = std::make_shared<ChunkSpan>(pos);
+    chunk->setBlock(ChunkLocalPosition(0, 0, 0), Block::Stone);
+    chunk->setBlock(ChunkLocalPosition(1, 0, 0), Block::Dirt);
+    chunk->setBlock(ChunkLocalPosition(5, 5, 5), Block::Grass);
+
+    ChunkMesher mesher(2, MeshingMode::Naive, VertexFormat::Full);
+    mesher.submit(pos, chunk);
+    auto results = drain(mesher, 1);
+    ASSERT_EQ(results.size(), 1u);
+    EXPECT_TRUE(ChunkPosEq{}(results[0].position, pos));
+    EXPECT_EQ(mesher.pending(), 0u);
+
+    std::vector<Block> blocks(CHUNK_BLOCK_COUNT);
+    chunk->copyTo(std::span<Block, CHUNK_BLOCK_COUNT>(blocks.data(), CHUNK_BLOCK_COUNT));
+    auto expected = ChunkMesh::buildGeometry(blocks, glm::vec3(pos.x * CHUNK_WIDTH, pos.y * CHUNK_HEIGHT, pos.z * CHUNK_DEPTH));
+    // Two touching cubes share a hidden face pair, the lone one shows all six
+    EXPECT_EQ(expected.indices.size(), (10u + 6u) * 6u);
+    ASSERT_EQ(results[0].geometry.vertices.size(), expected.vertices.size());
+    EXPECT_EQ(results[0].geometry.indices, expected.indices);
+    EXPECT_TRUE(results[0].geometry.vertices.front().position == expected.vertices.front().position);
+}
+
+TEST(ChunkMesherTest, ResubmittedAndCancelledChunksAreNotHandedOutStale) {
+    ChunkMesher mesher(2);
+    const AbsoluteChunkPosition edited(0, 0, 0);
+    const AbsoluteChunkPosition dropped(3, 0, 0);
+
+    auto before = std::make_shared<ChunkSpan>(edited);
+    auto after = std::make_shared<ChunkSpan>(edited);
+    after->setBlock(ChunkLocalPosition(2, 2, 2), Block::Wood);
+    mesher.submit(edited, before);
+    mesher.submit(edited, after);
+    mesher.submit(dropped, std::make_shared<ChunkSpan>(dropped));
+    mesher.cancel(dropped);
+
+    auto results = drain(mesher, 1);
+    // Give a stale build time to show up if it were going to
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    mesher.drainCompleted(std::chrono::milliseconds(1), [&](ChunkMesher::Result&& result) {
+        results.push_back(std::move(result));
+    });
+    ASSERT_EQ(results.size(), 1u);
+    EXPECT_TRUE(ChunkPosEq{}(results[0].position, edited));
+    // Packed by default
+    EXPECT_EQ(results[0].geometry.format, VertexFormat::Packed);
+    EXPECT_EQ(results[0].geometry.packedIndices.size(), 36u);
+    EXPECT_EQ(mesher.pending(), 0u);
+}
+
+TEST(ChunkMesherTest, LodChunksAreScaledAndTrackedApartFromFullChunks) {
+    ChunkMesher mesher(2);
+    const AbsoluteChunkPosition pos(1, 0, 0);
+    auto full = std::make_shared<ChunkSpan>(pos);
+    full->setBlock(ChunkLocalPosition(0, 0, 0), Block::Stone);
+    auto lod = std::make_shared<ChunkSpan>(pos);
+    lod->setBlock(ChunkLocalPosition(0, 0, 0), Block::Stone);
+    mesher.submit(pos, full);
+    mesher.submit(pos, lod, {}, 1);
+    EXPECT_EQ(mesher.pending(), 2u);
+
+    auto results = drain(mesher, 2);
+    ASSERT_EQ(results.size(), 2u);
+    const auto& scaled = results[0].lodLevel == 1 ? results[0] : results[1];
+    const auto& unscaled = results[0].lodLevel == 1 ? results[1] : results[0];
+    EXPECT_EQ(unscaled.lodLevel, 0u);
+    EXPECT_EQ(unscaled.geometry.format, VertexFormat::Packed);
+    ASSERT_EQ(scaled.lodLevel, 1u);
+    // LOD meshes stay in world space: the level 1 chunk at x = 1 starts at chunk 2, two blocks per block
+    ASSERT_EQ(scaled.geometry.format, VertexFormat::Full);
+    EXPECT_FLOAT_EQ(scaled.geometry.origin.x, 2.0f * CHUNK_WIDTH);
+    float lo = scaled.geometry.vertices.front().position.x;
+    float hi = lo;
+    for (const Vertex& v : scaled.geometry.vertices) {
+        lo = std::min(lo, v.position.x);
+        hi = std::max(hi, v.position.x);
+    }
+    EXPECT_FLOAT_EQ(lo, 2.0f * CHUNK_WIDTH - 0.5f);
+    EXPECT_FLOAT_EQ(hi, 2.0f * CHUNK_WIDTH + 1.5f);
+    EXPECT_FLOAT_EQ(coveredFaces(scaled.geometry), 6.0f * 4.0f);
+    EXPECT_EQ(mesher.pending(), 0u);
+}
+
+TEST(BufferRangeAllocatorTest, ReusesAndMergesFreedRanges) {
+    BufferRangeAllocator ranges(1000);
+    auto a = ranges.allocate(300);
+    auto b = ranges.allocate(300);
+    auto c = ranges.allocate(300);
+    ASSERT_TRUE(a && b && c);
+    EXPECT_EQ(*a, 0u);
+    EXPECT_EQ(*b, 300u);
+    EXPECT_EQ(*c, 600u);
+    EXPECT_FALSE(ranges.allocate(200).has_value());
+
+    // A freed range is reused first-fit
+    ranges.free(*b, 300);
+    EXPECT_EQ(ranges.allocate(100).value(), 300u);
+    EXPECT_EQ(ranges.largestFree(), 200u);
+
+    // Freeing everything merges back into one range
+    ranges.free(300, 100);
+    ranges.free(*a, 300);
+    ranges.free(*c, 300);
+    EXPECT_EQ(ranges.used(), 0u);
+    EXPECT_EQ(ranges.largestFree(), 1000u);
+
+    // Growing joins the new space to a free tail
+    ranges.allocate(900);
+    ranges.grow(2000);
+    EXPECT_EQ(ranges.largestFree(), 1100u);
+    EXPECT_EQ(ranges.allocate(1100).value(), 900u);
+    EXPECT_EQ(ranges.used(), ranges.capacity());
+}
+
+TEST(ChunkMeshCacheTest, RemeshesOnlyWhenTheVersionChanges) {
+    ChunkMeshCache cache;
+    AbsoluteChunkPosition pos(1, 0, -2);
+    EXPECT_TRUE(cache.needsMesh(pos, 7));
+    EXPECT_TRUE(cache.queued(pos, 7));
+    // Building counts as meshed, so it isn't submitted twice
+    EXPECT_FALSE(cache.needsMesh(pos, 7));
+    cache.uploaded(pos, 1000, 0);
+    EXPECT_FALSE(cache.needsMesh(pos, 7));
+    EXPECT_EQ(cache.connectivity(pos).value(), 0);
+    EXPECT_EQ(cache.residentBytes(), 1000u);
+
+    EXPECT_TRUE(cache.needsMesh(pos, 8));
+    EXPECT_TRUE(cache.queued(pos, 8));
+    cache.uploaded(pos, 600, CHUNK_FACES_ALL_CONNECTED);
+    EXPECT_EQ(cache.residentBytes(), 600u);
+
+    // A neighbour arriving invalidates the mesh without changing its version
+    cache.invalidate(pos);
+    EXPECT_TRUE(cache.needsMesh(pos, 8));
+    EXPECT_FALSE(cache.queued(pos, 8));
+    EXPECT_FALSE(cache.needsMesh(pos, 8));
+    EXPECT_FALSE(cache.connectivity(AbsoluteChunkPosition(0, 0, 0)).has_value());
+}
+
+TEST(ChunkMeshCacheTest, EvictsPastKeepDistanceThenLeastRecentlyDrawn) {
+    ChunkMeshCache cache(3000);
+    AbsoluteChunkPosition centre(0, 0, 0);
+    auto add = [&](const AbsoluteChunkPosition& pos) {
+        cache.queued(pos, 1);
+        cache.uploaded(pos, 1000, CHUNK_FACES_ALL_CONNECTED);
+    };
+    add(AbsoluteChunkPosition(0, 0, 0));
+    add(AbsoluteChunkPosition(4, 0, 0));
+    cache.nextFrame();
+    add(AbsoluteChunkPosition(0, -5, 4));
+    add(AbsoluteChunkPosition(6, 0, 0));
+
+    // Only the chunk past the keep distance goes; the budget is met without touching the rest
+    auto evicted = cache.evict(centre, 3, 5);
+    ASSERT_EQ(evicted.size(), 1u);
+    EXPECT_TRUE(ChunkPosEq{}(evicted[0], AbsoluteChunkPosition(6, 0, 0)));
+    EXPECT_EQ(cache.residentBytes(), 3000u);
+
+    // Over budget: the lingering chunk drawn longest ago goes first, never one in the load range
+    cache.nextFrame();
+    cache.touch(AbsoluteChunkPosition(4, 0, 0));
+    add(AbsoluteChunkPosition(1, 1, 1));
+    add(AbsoluteChunkPosition(2, 2, 2));
+    evicted = cache.evict(centre, 3, 5);
+    ASSERT_EQ(evicted.size(), 2u);
+    EXPECT_TRUE(ChunkPosEq{}(evicted[0], AbsoluteChunkPosition(0, -5, 4)));
+    EXPECT_TRUE(ChunkPosEq{}(evicted[1], AbsoluteChunkPosition(4, 0, 0)));
+    EXPECT_EQ(cache.residentBytes(), 3000u);
+    EXPECT_TRUE(cache.contains(AbsoluteChunkPosition(0, 0, 0)));
+    EXPECT_FALSE(cache.contains(AbsoluteChunkPosition(4, 0, 0)));
+}
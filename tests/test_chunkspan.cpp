@@ -1,8 +1,12 @@
 #include <gtest/gtest.h>
 #include "chunkspan.h"
+#include "block_kernels.h"
 #include "position.h"
 #include "block.h"
 #include "chunkdims.h"
+#include "chunk_pos_hash.h"
+#include <algorithm>
+#include <vector>
 
 class ChunkSpanTest : public ::testing::Test {
 protected:
@@ -113,4 +117,272 @@ TEST_F(ChunkSpanTest, ArrayConstructor) {
 TEST_F(ChunkSpanTest, StrideValues) {
     EXPECT_EQ(chunk->strideY, CHUNK_WIDTH);
     EXPECT_EQ(chunk->strideZ, CHUNK_WIDTH * CHUNK_HEIGHT);
-}
\ No newline at end of file
+}
+// New chunks use uniform storage until they diverge
+TEST_F(ChunkSpanTest, UniformByDefault) {
+    EXPECT_EQ(chunk->storageMode(), ChunkStorageMode::Uniform);
+    EXPECT_EQ(chunk->uniformBlock(), Block::Empty);
+    EXPECT_EQ(chunk->paletteSize(), 1u);
+}
+
+// Setting a different block promotes to paletted storage and palette grows on demand
+TEST_F(ChunkSpanTest, PalettePromotion) {
+    chunk->setBlock(ChunkLocalPosition(0, 0, 0), Block::Stone);
+    EXPECT_EQ(chunk->storageMode(), ChunkStorageMode::Paletted);
+    EXPECT_EQ(chunk->paletteSize(), 2u);
+
+    // Grow past 2 and 4 entries to force repacking at wider index widths
+    const Block blocks[] = {Block::Grass, Block::Water, Block::Sand, Block::Wood, Block::Leaves};
+    for (size_t i = 0; i < std::size(blocks); ++i) {
+        chunk->setBlock(ChunkLocalPosition(static_cast<uint32_t>(i + 1), 0, 0), blocks[i]);
+    }
+    EXPECT_EQ(chunk->storageMode(), ChunkStorageMode::Paletted);
+    EXPECT_EQ(chunk->paletteSize(), 7u);
+
+    EXPECT_EQ(chunk->getBlock(ChunkLocalPosition(0, 0, 0)), Block::Stone);
+    for (size_t i = 0; i < std::size(blocks); ++i) {
+        EXPECT_EQ(chunk->getBlock(ChunkLocalPosition(static_cast<uint32_t>(i + 1), 0, 0)), blocks[i]);
+    }
+    EXPECT_EQ(chunk->getBlock(ChunkLocalPosition(15, 15, 15)), Block::Empty);
+}
+
+// More distinct blocks than the palette can hold promotes to dense storage
+TEST_F(ChunkSpanTest, DensePromotion) {
+    for (uint32_t i = 0; i <= CHUNK_MAX_PALETTE_SIZE; ++i) {
+        chunk->setBlock(static_cast<size_t>(i), static_cast<Block>(i + 1));
+    }
+    EXPECT_EQ(chunk->storageMode(), ChunkStorageMode::Dense);
+    for (uint32_t i = 0; i <= CHUNK_MAX_PALETTE_SIZE; ++i) {
+        EXPECT_EQ(chunk->getBlock(static_cast<size_t>(i)), static_cast<Block>(i + 1));
+    }
+    EXPECT_EQ(chunk->getBlock(CHUNK_BLOCK_COUNT - 1), Block::Empty);
+}
+
+// compact() collapses storage back down once contents become uniform again
+TEST_F(ChunkSpanTest, CompactCollapsesToUniform) {
+    ChunkLocalPosition pos(3, 4, 5);
+    chunk->setBlock(pos, Block::Stone);
+    chunk->setBlock(pos, Block::Empty);
+    EXPECT_EQ(chunk->storageMode(), ChunkStorageMode::Paletted);
+
+    chunk->compact();
+    EXPECT_EQ(chunk->storageMode(), ChunkStorageMode::Uniform);
+    EXPECT_EQ(chunk->getBlock(pos), Block::Empty);
+
+    chunk->fillRange(0, CHUNK_BLOCK_COUNT / 2, Block::Dirt);
+    chunk->compact();
+    EXPECT_EQ(chunk->storageMode(), ChunkStorageMode::Paletted);
+    EXPECT_EQ(chunk->paletteSize(), 2u);
+    EXPECT_EQ(chunk->getBlock(size_t{0}), Block::Dirt);
+    EXPECT_EQ(chunk->getBlock(CHUNK_BLOCK_COUNT - 1), Block::Empty);
+
+    chunk->fill(Block::Stone);
+    EXPECT_TRUE(chunk->isUniform());
+    EXPECT_LT(chunk->storageBytes(), CHUNK_BLOCK_COUNT);
+}
+
+// Serialization round-trips regardless of storage mode
+TEST_F(ChunkSpanTest, SerializationAcrossStorageModes) {
+    chunk->fill(Block::Stone);
+    auto uniformData = chunk->serialize();
+    ChunkSpan uniformCopy(uniformData);
+    EXPECT_TRUE(uniformCopy.isUniform());
+    EXPECT_EQ(uniformCopy.uniformBlock(), Block::Stone);
+
+    for (uint32_t i = 0; i <= CHUNK_MAX_PALETTE_SIZE; ++i) {
+        chunk->setBlock(static_cast<size_t>(i * 7), static_cast<Block>(i + 1));
+    }
+    auto denseData = chunk->serialize();
+    ChunkSpan denseCopy(denseData);
+    for (size_t i = 0; i < CHUNK_BLOCK_COUNT; ++i) {
+        ASSERT_EQ(denseCopy.getBlock(i), chunk->getBlock(i)) << "index " << i;
+    }
+}
+
+// Writes that change a block bump the version, copies and compaction keep it
+TEST_F(ChunkSpanTest, VersionTracksWrites) {
+    EXPECT_EQ(chunk->version(), 0u);
+    chunk->setBlock(ChunkLocalPosition(1, 2, 3), Block::Stone);
+    chunk->setBlock(ChunkLocalPosition(1, 2, 4), Block::Stone);
+    EXPECT_EQ(chunk->version(), 2u);
+    // Writing the block already there isn't a change
+    chunk->setBlock(ChunkLocalPosition(1, 2, 4), Block::Stone);
+    EXPECT_EQ(chunk->version(), 2u);
+    chunk->fill(Block::Sand);
+    EXPECT_EQ(chunk->version(), 3u);
+
+    chunk->setVersion(100);
+    ChunkSpan copy(*chunk);
+    EXPECT_EQ(copy.version(), 100u);
+    copy.compact();
+    EXPECT_EQ(copy.version(), 100u);
+    copy.setBlock(size_t{0}, Block::Dirt);
+    EXPECT_EQ(copy.version(), 101u);
+    EXPECT_EQ(chunk->version(), 100u);
+}
+
+// The content hash depends only on the blocks, not how they are stored
+TEST_F(ChunkSpanTest, ContentHashIgnoresStorageMode) {
+    chunk->fill(Block::Stone);
+    ASSERT_TRUE(chunk->isUniform());
+    const uint64_t uniformHash = chunk->contentHash();
+    EXPECT_NE(uniformHash, 0u);
+
+    std::array<Block, CHUNK_BLOCK_COUNT> dense;
+    dense.fill(Block::Stone);
+    ChunkSpan denseCopy(dense, chunk->position);
+    EXPECT_EQ(denseCopy.contentHash(), uniformHash);
+
+    chunk->setBlock(ChunkLocalPosition(3, 4, 5), Block::Dirt);
+    EXPECT_NE(chunk->contentHash(), uniformHash);
+    denseCopy.setBlock(ChunkLocalPosition(3, 4, 5), Block::Dirt);
+    EXPECT_EQ(denseCopy.contentHash(), chunk->contentHash());
+}
+
+// Solid and layered chunks encode to a few bytes, and the old v1 format still loads
+TEST_F(ChunkSpanTest, CompactEncodingAndV1Compatibility) {
+    chunk->fill(Block::Stone);
+    EXPECT_LT(chunk->serialize().size(), 32u);
+    chunk->fillRange(0, CHUNK_BLOCK_COUNT / 2, Block::Dirt);
+    auto layered = chunk->serialize();
+    EXPECT_LT(layered.size(), 64u);
+    ChunkSpan layeredCopy(layered);
+    EXPECT_TRUE(ChunkPosEq{}(layeredCopy.position, chunkPos));
+    EXPECT_EQ(layeredCopy.contentHash(), chunk->contentHash());
+
+    // v1: version, position, non-empty count, then (uint32 index, uint8 block) pairs
+    std::vector<uint8_t> v1{1};
+    auto append = [&](auto value) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+        v1.insert(v1.end(), bytes, bytes + sizeof(value));
+    };
+    append(int32_t{4});
+    append(int32_t{-5});
+    append(int32_t{6});
+    append(uint32_t{2});
+    append(uint32_t{0});
+    v1.push_back(static_cast<uint8_t>(Block::Stone));
+    append(uint32_t{CHUNK_BLOCK_COUNT - 1});
+    v1.push_back(static_cast<uint8_t>(Block::Water));
+    ChunkSpan fromV1(v1);
+    EXPECT_TRUE(ChunkPosEq{}(fromV1.position, AbsoluteChunkPosition(4, -5, 6)));
+    EXPECT_EQ(fromV1.getBlock(size_t{0}), Block::Stone);
+    EXPECT_EQ(fromV1.getBlock(size_t{1}), Block::Empty);
+    EXPECT_EQ(fromV1.getBlock(CHUNK_BLOCK_COUNT - 1), Block::Water);
+
+    // Truncated input is rejected
+    layered.pop_back();
+    EXPECT_THROW(ChunkSpan truncated(layered), std::runtime_error);
+}
+
+// Decoding in place replaces position and contents and reuses the chunk's storage
+TEST_F(ChunkSpanTest, DecodeInPlaceReusesStorage) {
+    for (uint32_t i = 0; i <= CHUNK_MAX_PALETTE_SIZE; ++i) {
+        chunk->setBlock(static_cast<size_t>(i * 7), static_cast<Block>(i + 1));
+    }
+    ASSERT_EQ(chunk->storageMode(), ChunkStorageMode::Dense);
+    const auto denseData = chunk->serialize();
+
+    ChunkSpan other(AbsoluteChunkPosition(-4, 0, 9));
+    other.setBlock(size_t{5}, Block::Sand);
+    other.setBlock(size_t{900}, Block::Water);
+    const auto otherBytes = other.serialize();
+    const std::string otherData(otherBytes.begin(), otherBytes.end());
+
+    ChunkSpan pooled(AbsoluteChunkPosition(0, 0, 0));
+    pooled.decode(std::span<const uint8_t>(denseData));
+    EXPECT_TRUE(ChunkPosEq{}(pooled.position, chunkPos));
+    EXPECT_EQ(pooled.contentHash(), chunk->contentHash());
+    const size_t denseBytes = pooled.storageBytes();
+
+    // A second dense chunk fits the buffer already there
+    chunk->setBlock(size_t{1}, Block::Dirt);
+    pooled.decode(std::span<const uint8_t>(chunk->serialize()));
+    EXPECT_EQ(pooled.storageBytes(), denseBytes);
+    EXPECT_EQ(pooled.contentHash(), chunk->contentHash());
+
+    // Straight from a protobuf-style string
+    pooled.decode(std::string_view(otherData));
+    EXPECT_TRUE(ChunkPosEq{}(pooled.position, other.position));
+    EXPECT_EQ(pooled.storageMode(), ChunkStorageMode::Paletted);
+    EXPECT_EQ(pooled.getBlock(size_t{900}), Block::Water);
+    EXPECT_EQ(pooled.contentHash(), ChunkSpan(std::string_view(otherData)).contentHash());
+    EXPECT_LT(pooled.storageBytes(), denseBytes);
+
+    EXPECT_THROW(pooled.decode(std::string_view(otherData).substr(0, 8)), std::runtime_error);
+}
+
+// The non-empty count and column heights follow every kind of write without a rescan
+TEST_F(ChunkSpanTest, SummaryFollowsEdits) {
+    EXPECT_TRUE(chunk->isEmpty());
+    EXPECT_EQ(chunk->columnHeight(3, 5), 0);
+
+    chunk->setBlock(ChunkLocalPosition(3, 2, 5), Block::Stone);
+    chunk->setBlock(ChunkLocalPosition(3, 9, 5), Block::Dirt);
+    EXPECT_EQ(chunk->nonEmptyCount(), 2u);
+    EXPECT_EQ(chunk->columnHeight(3, 5), 10);
+    EXPECT_EQ(chunk->columnHeight(5, 3), 0);
+
+    // Removing the top block drops the column to the next one down
+    chunk->setBlock(ChunkLocalPosition(3, 9, 5), Block::Empty);
+    EXPECT_EQ(chunk->columnHeight(3, 5), 3);
+    chunk->setBlock(ChunkLocalPosition(3, 2, 5), Block::Empty);
+    EXPECT_TRUE(chunk->isEmpty());
+    EXPECT_EQ(chunk->columnHeight(3, 5), 0);
+    EXPECT_EQ(chunk->storageMode(), ChunkStorageMode::Paletted);
+
+    // Through dense promotion, ranges and whole-chunk rebuilds
+    for (uint32_t i = 0; i <= CHUNK_MAX_PALETTE_SIZE; ++i) {
+        chunk->setBlock(static_cast<size_t>(i), static_cast<Block>(i + 1));
+    }
+    ASSERT_EQ(chunk->storageMode(), ChunkStorageMode::Dense);
+    EXPECT_EQ(chunk->nonEmptyCount(), CHUNK_MAX_PALETTE_SIZE + 1);
+    EXPECT_EQ(chunk->columnHeight(0, 0), 2);
+    chunk->fillRange(0, CHUNK_WIDTH * CHUNK_HEIGHT, Block::Sand);
+    EXPECT_EQ(chunk->nonEmptyCount(), CHUNK_WIDTH * CHUNK_HEIGHT);
+    EXPECT_EQ(chunk->columnHeight(7, 0), CHUNK_HEIGHT);
+    EXPECT_EQ(chunk->columnHeight(7, 1), 0);
+
+    ChunkSpan decoded(chunk->serialize());
+    EXPECT_EQ(decoded.nonEmptyCount(), chunk->nonEmptyCount());
+    EXPECT_EQ(decoded.columnHeight(7, 0), CHUNK_HEIGHT);
+
+    chunk->fill(Block::Stone);
+    EXPECT_EQ(chunk->nonEmptyCount(), CHUNK_BLOCK_COUNT);
+    EXPECT_EQ(chunk->columnHeight(15, 15), CHUNK_HEIGHT);
+    chunk->setBlock(ChunkLocalPosition(1, 15, 1), Block::Empty);
+    EXPECT_EQ(chunk->nonEmptyCount(), CHUNK_BLOCK_COUNT - 1);
+    EXPECT_EQ(chunk->columnHeight(1, 1), CHUNK_HEIGHT - 1);
+    EXPECT_EQ(chunk->columnHeight(2, 1), CHUNK_HEIGHT);
+}
+
+// The vector kernels agree with plain loops, including lengths that leave a scalar tail
+TEST(BlockKernelsTest, MatchScalarLoops) {
+    std::vector<Block> first(100), second(100), dst(100, Block::Wood);
+    for (size_t i = 0; i < first.size(); ++i) {
+        first[i] = i % 3 == 0 ? Block::Stone : Block::Empty;
+        second[i] = i % 5 == 0 ? Block::Water : Block::Empty;
+    }
+    for (size_t count : {size_t{0}, size_t{7}, size_t{16}, size_t{33}, size_t{100}}) {
+        size_t expected = static_cast<size_t>(std::count_if(first.begin(), first.begin() + count, [](Block b) { return b != Block::Empty; }));
+        EXPECT_EQ(countBlocksNotEqual(first.data(), count, Block::Empty), expected);
+    }
+
+    std::vector<Block> run(70, Block::Grass);
+    EXPECT_EQ(findBlockNotEqual(run.data(), run.size(), Block::Grass), run.size());
+    run[45] = Block::Dirt;
+    EXPECT_EQ(findBlockNotEqual(run.data(), run.size(), Block::Grass), 45u);
+    EXPECT_EQ(findBlockNotEqual(run.data(), 40, Block::Grass), 40u);
+    run[66] = Block::Dirt;
+    EXPECT_EQ(findBlockNotEqual(run.data() + 46, 24, Block::Grass), 20u);
+
+    mergeNonEmptyBlocks(dst.data(), first.data(), second.data(), dst.size());
+    for (size_t i = 0; i < dst.size(); ++i) {
+        Block expected = first[i] != Block::Empty ? first[i] : second[i] != Block::Empty ? second[i] : Block::Wood;
+        ASSERT_EQ(dst[i], expected) << "block " << i;
+    }
+
+    fillBlocks(dst.data() + 3, 50, Block::Leaves);
+    EXPECT_EQ(dst[2], first[2] != Block::Empty ? first[2] : second[2] != Block::Empty ? second[2] : Block::Wood);
+    EXPECT_EQ(countBlocksNotEqual(dst.data() + 3, 50, Block::Leaves), 0u);
+}
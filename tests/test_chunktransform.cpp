@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include "chunktransform.h"
+#include "chunkspan.h"
+#include "position.h"
+#include "block.h"
+#include "chunkdims.h"
+
+namespace {
+
+std::shared_ptr<ChunkTransform> perlin(Block block, int startHeight, int maxHeight) {
+    auto noise = std::make_shared<siv::PerlinNoise>(1234u);
+    return std::make_shared<PerlinNoiseChunkTransform>(noise, 40.0, 3, 0.5, block, startHeight, maxHeight);
+}
+
+// Applies the transform as written and compiled to the same positions and compares every block
+void expectCompiledMatches(const std::shared_ptr<ChunkTransform>& transform) {
+    auto compiled = transform->compile();
+    for (const AbsoluteChunkPosition& pos : {AbsoluteChunkPosition(0, 0, 0), AbsoluteChunkPosition(-2, 1, 3), AbsoluteChunkPosition(5, -1, -4)}) {
+        ChunkSpan expected(pos);
+        ChunkSpan actual(pos);
+        transform->apply(expected);
+        compiled->apply(actual);
+        for (size_t i = 0; i < CHUNK_BLOCK_COUNT; ++i) {
+            ASSERT_EQ(expected.getBlock(i), actual.getBlock(i)) << "block " << i;
+        }
+    }
+}
+
+} // namespace
+
+TEST(ChunkTransformTest, SeparableTreeCompilesToFusedPass) {
+    auto ground = std::make_shared<HeightmapChunkTransform>(4, Block::Stone);
+    auto hills = perlin(Block::Grass, 0, 40);
+    auto water = std::make_shared<HeightmapChunkTransform>(10, Block::Water);
+    auto tree = *(*(*ground + hills) | water) + std::make_shared<NullChunkTransform>();
+
+    EXPECT_TRUE(tree->columnSeparable());
+    EXPECT_NE(dynamic_cast<FusedChunkTransform*>(tree->compile().get()), nullptr);
+    expectCompiledMatches(tree);
+}
+
+TEST(ChunkTransformTest, MergeWithEmptyAndFill) {
+    auto sand = std::make_shared<FillChunkTransform>(Block::Sand);
+    auto empty = std::make_shared<EmptyChunkTransform>();
+    expectCompiledMatches(*empty | sand);
+    expectCompiledMatches(*(*sand + empty) | perlin(Block::Wood, -20, 20));
+}
+
+TEST(ChunkTransformTest, LambdaFallsBackButChildrenStillFuse) {
+    auto lambda = std::make_shared<LambdaChunkTransform>([](ChunkSpan& chunk) {
+        for (size_t i = 0; i < CHUNK_BLOCK_COUNT; i += 7) {
+            chunk.setBlock(i, Block::Leaves);
+        }
+    });
+    auto fusable = *std::make_shared<HeightmapChunkTransform>(3, Block::Stone) | perlin(Block::Grass, -5, 30);
+    auto tree = *fusable + lambda;
+
+    EXPECT_FALSE(tree->columnSeparable());
+    auto compiled = tree->compile();
+    auto* combined = dynamic_cast<CombinedChunkTransform*>(compiled.get());
+    ASSERT_NE(combined, nullptr);
+    EXPECT_NE(dynamic_cast<FusedChunkTransform*>(combined->first().get()), nullptr);
+    EXPECT_EQ(combined->second(), lambda);
+    expectCompiledMatches(tree);
+}
+
+TEST(ColumnHeightCacheTest, ComputesEachColumnOnceAndEvictsLeastRecentlyUsed) {
+    std::atomic<int> calls{0};
+    ColumnHeightCache cache([&](int64_t x, int64_t z) {
+        ++calls;
+        return static_cast<double>(x * 1000 + z);
+    }, COLUMN_HEIGHT_CACHE_SHARDS);
+
+    EXPECT_DOUBLE_EQ(cache.sample(-1, 17), -1000.0 + 17.0);
+    EXPECT_EQ(calls.load(), CHUNK_WIDTH * CHUNK_DEPTH);
+    // Same column, different block, and the column fetched directly
+    EXPECT_DOUBLE_EQ(cache.sample(-16, 31), -16000.0 + 31.0);
+    EXPECT_DOUBLE_EQ((*cache.column(-1, 1))[0], -16000.0 + 16.0);
+    EXPECT_EQ(calls.load(), CHUNK_WIDTH * CHUNK_DEPTH);
+    EXPECT_EQ(cache.misses(), 1u);
+    EXPECT_EQ(cache.hits(), 2u);
+
+    for (int32_t i = 0; i < 200; ++i) {
+        cache.column(i, -i);
+    }
+    EXPECT_LE(cache.size(), cache.capacity());
+}
+
+TEST(ColumnHeightCacheTest, CachedPerlinMatchesUncached) {
+    auto noise = std::make_shared<siv::PerlinNoise>(99u);
+    auto cache = PerlinNoiseChunkTransform::makeHeightCache(noise, 40.0, 3);
+    auto plain = std::make_shared<PerlinNoiseChunkTransform>(noise, 40.0, 3, 0.5, Block::Grass, -10, 30);
+    auto cached = std::make_shared<PerlinNoiseChunkTransform>(noise, 40.0, 3, 0.5, Block::Grass, -10, 30, cache);
+    auto fused = (*cached + std::make_shared<NullChunkTransform>())->compile();
+
+    // Vertically stacked chunks share one cached column
+    for (int32_t y = -1; y <= 2; ++y) {
+        AbsoluteChunkPosition pos(3, y, -2);
+        ChunkSpan expected(pos);
+        ChunkSpan direct(pos);
+        ChunkSpan viaFused(pos);
+        plain->apply(expected);
+        cached->apply(direct);
+        fused->apply(viaFused);
+        for (size_t i = 0; i < CHUNK_BLOCK_COUNT; ++i) {
+            ASSERT_EQ(expected.getBlock(i), direct.getBlock(i));
+            ASSERT_EQ(expected.getBlock(i), viaFused.getBlock(i));
+        }
+    }
+    EXPECT_EQ(cache->misses(), 1u);
+}
@@ -3,12 +3,15 @@
 #include <chrono>
 #include <memory>
 #include <atomic>
+#include <filesystem>
 #include "client.h"
 #include "server.h"
 #include "world.h"
 #include "position.h"
 #include "block.h"
 #include "chunk_generators.h"
+#include "chunkdims.h"
+#include "name_component.h"
 // Helper struct to manage server-client pairs for individual tests
 struct ServerClientPair {
     std::shared_ptr<World> world;
@@ -47,7 +50,7 @@ struct ServerClientPair {
 class ClientServerTest : public ::testing::Test {
 protected:
     // Helper function to create a server-client pair for individual tests
-    std::unique_ptr<ServerClientPair> createServerClientPair(const std::string& playerId = "test_player") {
+    std::unique_ptr<ServerClientPair> createServerClientPair(const std::string& playerId = "test_player", ServerMode mode = ServerMode::Sync) {
         auto pair = std::make_unique<ServerClientPair>();
         
         pair->terrainGenerator = std::make_shared<FlatworldChunkGenerator>(1, Block::Grass);
@@ -60,7 +63,7 @@ protected:
         pair->port = port_counter.fetch_add(1);
         
         // Create and start server
-        pair->server = std::make_unique<Server>(pair->port, pair->world);
+        pair->server = std::make_unique<Server>(pair->port, pair->world, mode);
         
         pair->server->start();
         
@@ -97,6 +100,35 @@ TEST_F(ClientServerTest, ServerInfo) {
     EXPECT_NE(serverInfo.find("Error"), 0); // Should not start with "Error"
 }
 
+// Test server metrics over GetStats
+TEST_F(ClientServerTest, GetStatsReportsRpcLatency) {
+    auto pair = createServerClientPair();
+    
+    EXPECT_TRUE(pair->client->connect());
+    EXPECT_FALSE(pair->client->getServerInfo().empty());
+    
+    auto stats = pair->client->getServerStats(true);
+    ASSERT_TRUE(stats.has_value());
+    EXPECT_TRUE(stats->success());
+    
+    // The GetServerInfo call above has been timed
+    bool found = false;
+    for (const auto& metric : stats->metrics()) {
+        if (metric.name() != "blocktest_rpc_duration_seconds") {
+            continue;
+        }
+        for (const auto& label : metric.labels()) {
+            if (label.name() == "method" && label.value() == "GetServerInfo") {
+                EXPECT_EQ(metric.kind(), blockserver::Metric::HISTOGRAM);
+                EXPECT_GE(metric.count(), 1u);
+                found = true;
+            }
+        }
+    }
+    EXPECT_TRUE(found);
+    EXPECT_NE(stats->prometheus_text().find("blocktest_rpc_duration_seconds_bucket{method=\"GetServerInfo\""), std::string::npos);
+}
+
 // Test player position management
 TEST_F(ClientServerTest, PlayerPosition) {
     auto pair = createServerClientPair();
@@ -217,6 +249,333 @@ TEST_F(ClientServerTest, UpdatedChunks) {
     EXPECT_GE(updatedChunks.size(), 0);
 }
 
+// Test that a batch of chunk requests is filled by GetChunks
+TEST_F(ClientServerTest, BatchedChunkRequests) {
+    auto pair = createServerClientPair();
+    ASSERT_TRUE(pair->client->connect());
+    
+    std::vector<AbsoluteChunkPosition> positions;
+    for (int32_t x = -1; x <= 1; ++x) {
+        for (int32_t z = -1; z <= 1; ++z) {
+            positions.emplace_back(x, 0, z);
+        }
+    }
+    pair->client->requestChunksAsync(positions);
+    
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (pair->client->getCacheSize() < positions.size() && std::chrono::steady_clock::now() < deadline) {
+        pair->client->processPendingRequests();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    for (const auto& pos : positions) {
+        EXPECT_TRUE(pair->client->getCachedChunk(pos).has_value());
+    }
+    EXPECT_EQ(pair->client->getPendingRequestCount(), 0u);
+}
+
+// Chunks kept in the disk cache are revalidated instead of downloaded again
+TEST_F(ClientServerTest, DiskCacheRevalidatesChunks) {
+    auto pair = createServerClientPair();
+    auto cacheDir = std::filesystem::temp_directory_path() / "blocktest_client_cache_test";
+    std::filesystem::remove_all(cacheDir);
+    
+    const std::vector<AbsoluteChunkPosition> positions{{0, 0, 0}, {1, 0, 0}, {0, 0, 1}};
+    auto fetchAll = [&](Client& client) {
+        client.requestChunksAsync(positions);
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (client.getCacheSize() < positions.size() && std::chrono::steady_clock::now() < deadline) {
+            client.processPendingRequests();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    };
+    
+    pair->client->setDiskCacheDirectory(cacheDir);
+    ASSERT_TRUE(pair->client->connect());
+    EXPECT_FALSE(pair->client->getWorldId().empty());
+    fetchAll(*pair->client);
+    ASSERT_EQ(pair->client->getCacheSize(), positions.size());
+    EXPECT_EQ(pair->client->getRevalidatedChunkCount(), 0u);
+    pair->client->disconnect();
+    
+    // Edit one chunk while away; it must be downloaded again
+    ASSERT_TRUE(pair->world->setBlockIfLoaded(AbsoluteBlockPosition(3, 3, 3), Block::Wood));
+    
+    auto client2 = std::make_unique<Client>("127.0.0.1", pair->port, "test_player2");
+    client2->setDiskCacheDirectory(cacheDir);
+    ASSERT_TRUE(client2->connect());
+    fetchAll(*client2);
+    for (const auto& pos : positions) {
+        EXPECT_TRUE(client2->getCachedChunk(pos).has_value());
+    }
+    EXPECT_EQ(client2->getRevalidatedChunkCount(), positions.size() - 1);
+    auto edited = client2->getCachedChunk(AbsoluteChunkPosition(0, 0, 0));
+    ASSERT_TRUE(edited.has_value());
+    EXPECT_EQ((*edited)->getBlock(ChunkLocalPosition(3, 3, 3)), Block::Wood);
+    
+    client2->disconnect();
+    std::filesystem::remove_all(cacheDir);
+}
+
+// Players see each other through GetEntityUpdates, and only what changed after the first poll
+TEST_F(ClientServerTest, EntityUpdatesBetweenPlayers) {
+    auto pair = createServerClientPair();
+    auto client2 = std::make_unique<Client>("127.0.0.1", pair->port, "test_player2");
+    ASSERT_TRUE(pair->client->connect());
+    ASSERT_TRUE(client2->connect());
+    ASSERT_TRUE(pair->client->connectAsPlayer("alice", AbsolutePrecisePosition(0.0, 10.0, 0.0)));
+    ASSERT_TRUE(client2->connectAsPlayer("bob", AbsolutePrecisePosition(4.0, 10.0, 4.0)));
+    
+    auto findPlayer = [](Client& client, const std::string& name) {
+        std::optional<AbsolutePrecisePosition> found;
+        client.readEntities([&](const GameRegistry& entities) {
+            auto view = entities.raw().view<const NameComponent, const AbsolutePrecisePosition>();
+            for (auto entity : view) {
+                if (view.get<const NameComponent>(entity).name == name) {
+                    found = view.get<const AbsolutePrecisePosition>(entity);
+                }
+            }
+        });
+        return found;
+    };
+    
+    ASSERT_TRUE(pair->client->pollEntityUpdates(4));
+    auto bob = findPlayer(*pair->client, "bob");
+    ASSERT_TRUE(bob.has_value());
+    EXPECT_DOUBLE_EQ(bob->x, 4.0);
+    // A player isn't sent itself
+    EXPECT_FALSE(findPlayer(*pair->client, "alice").has_value());
+    
+    ASSERT_TRUE(client2->updatePlayerPosition(AbsolutePrecisePosition(6.0, 10.0, 4.0)));
+    ASSERT_TRUE(pair->client->pollEntityUpdates(4));
+    bob = findPlayer(*pair->client, "bob");
+    ASSERT_TRUE(bob.has_value());
+    EXPECT_DOUBLE_EQ(bob->x, 6.0);
+    
+    ASSERT_TRUE(client2->disconnectPlayer());
+    ASSERT_TRUE(pair->client->pollEntityUpdates(4));
+    EXPECT_FALSE(findPlayer(*pair->client, "bob").has_value());
+    client2->disconnect();
+}
+
+// Position samples over the player stream are coalesced and applied by the server tick
+TEST_F(ClientServerTest, PlayerStreamCoalescesPositions) {
+    auto pair = createServerClientPair();
+    ASSERT_TRUE(pair->client->connect());
+    ASSERT_TRUE(pair->client->connectAsPlayer("streamer", AbsolutePrecisePosition(0.0, 10.0, 0.0)));
+    ASSERT_TRUE(pair->client->openPlayerStream());
+    EXPECT_TRUE(pair->client->isPlayerStreamOpen());
+    const std::string token = pair->client->getSessionToken();
+    
+    for (int i = 1; i <= 20; ++i) {
+        EXPECT_TRUE(pair->client->updatePlayerPosition(AbsolutePrecisePosition(i * 0.5, 10.0, 0.0)));
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    std::optional<PlayerSession> session;
+    while (std::chrono::steady_clock::now() < deadline) {
+        session = pair->world->getPlayerSession(token);
+        if (session && session->position.x == 10.0) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    ASSERT_TRUE(session.has_value());
+    EXPECT_DOUBLE_EQ(session->position.x, 10.0);
+    // Samples arriving between client writes were dropped rather than queued
+    EXPECT_LE(pair->client->getAppliedInputSequence(), 20u);
+    EXPECT_TRUE(pair->client->refreshSession());
+    
+    pair->client->closePlayerStream();
+    EXPECT_FALSE(pair->client->isPlayerStreamOpen());
+    // Back on the unary path
+    EXPECT_TRUE(pair->client->updatePlayerPosition(AbsolutePrecisePosition(1.0, 10.0, 1.0)));
+    EXPECT_DOUBLE_EQ(pair->world->getPlayerSession(token)->position.z, 1.0);
+}
+
+// The async completion-queue mode serves the same calls, and streams still work alongside it
+// Misses near the session's player are generated on demand; ones far from it stay misses
+TEST_F(ClientServerTest, ChunkMissesLoadOnDemandNearThePlayer) {
+    auto pair = createServerClientPair();
+    ASSERT_TRUE(pair->client->connect());
+    AbsolutePrecisePosition spawn(5000.0, 0.0, 5000.0);
+    ASSERT_TRUE(pair->client->connectAsPlayer("DemandPlayer", spawn));
+    
+    // Past the load radius of 3, so no anchor brings them in
+    const AbsoluteChunkPosition center = toAbsoluteChunk(spawn);
+    const AbsoluteChunkPosition near(center.x + 6, center.y, center.z);
+    const AbsoluteChunkPosition far(center.x + 50, center.y, center.z);
+    pair->client->requestChunksAsync(std::vector<AbsoluteChunkPosition>{near, far});
+    
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (pair->client->getPendingRequestCount() > 0 && std::chrono::steady_clock::now() < deadline) {
+        pair->client->processPendingRequests();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    pair->client->processPendingRequests();
+    EXPECT_TRUE(pair->client->getCachedChunk(near).has_value());
+    EXPECT_FALSE(pair->client->getCachedChunk(far).has_value());
+    EXPECT_TRUE(pair->world->getChunkIfLoaded(near).has_value());
+}
+
+TEST_F(ClientServerTest, AsyncServerMode) {
+    auto pair = createServerClientPair("test_player", ServerMode::Async);
+    ASSERT_EQ(pair->server->getMode(), ServerMode::Async);
+    ASSERT_TRUE(pair->client->connect());
+    EXPECT_TRUE(pair->client->ping());
+    EXPECT_FALSE(pair->client->getWorldId().empty());
+    
+    ASSERT_TRUE(pair->client->placeBlock(AbsoluteBlockPosition(2, 3, 4), Block::Stone));
+    auto block = pair->client->getBlockAt(AbsoluteBlockPosition(2, 3, 4));
+    ASSERT_TRUE(block.has_value());
+    EXPECT_EQ(*block, Block::Stone);
+    
+    const std::vector<AbsoluteChunkPosition> positions{{0, 0, 0}, {1, 0, 0}, {-1, 0, 0}};
+    pair->client->requestChunksAsync(positions);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (pair->client->getCacheSize() < positions.size() && std::chrono::steady_clock::now() < deadline) {
+        pair->client->processPendingRequests();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(pair->client->getCacheSize(), positions.size());
+    
+    EXPECT_TRUE(pair->client->subscribeChunks(2));
+    pair->client->unsubscribeChunks();
+    EXPECT_EQ(pair->server->getShedCallCount(), 0u);
+}
+
+// Queued edits show in the cache at once and reach the server in batches; rejected ones are counted
+TEST_F(ClientServerTest, QueuedBlockEdits) {
+    auto pair = createServerClientPair();
+    ASSERT_TRUE(pair->client->connect());
+    const AbsoluteChunkPosition chunkPos(0, 0, 0);
+    pair->client->requestChunkAsync(chunkPos);
+    const auto loadDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!pair->client->getCachedChunk(chunkPos) && std::chrono::steady_clock::now() < loadDeadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(pair->client->getCachedChunk(chunkPos).has_value());
+    
+    for (int64_t x = 0; x < 8; ++x) {
+        ASSERT_TRUE(pair->client->placeBlockAsync(AbsoluteBlockPosition(x, 2, 3), Block::Stone));
+    }
+    ASSERT_TRUE(pair->client->breakBlockAsync(AbsoluteBlockPosition(0, 2, 3)));
+    // Applied locally before the server has answered
+    auto cached = pair->client->getCachedChunk(chunkPos);
+    EXPECT_EQ((*cached)->getBlock(ChunkLocalPosition(1, 2, 3)), Block::Stone);
+    EXPECT_EQ((*cached)->getBlock(ChunkLocalPosition(0, 2, 3)), Block::Empty);
+    
+    // Far outside what the server has loaded
+    ASSERT_TRUE(pair->client->placeBlockAsync(AbsoluteBlockPosition(CHUNK_WIDTH * 1000, 0, 0), Block::Stone));
+    ASSERT_TRUE(pair->client->flushBlockEdits());
+    EXPECT_EQ(pair->client->getRejectedBlockEditCount(), 1u);
+    EXPECT_EQ(*pair->world->getBlockIfLoaded(AbsoluteBlockPosition(7, 2, 3)), Block::Stone);
+    EXPECT_EQ(*pair->world->getBlockIfLoaded(AbsoluteBlockPosition(0, 2, 3)), Block::Empty);
+    // Acknowledged edits moved the cached copy to the server's version, so its pushes apply as deltas
+    EXPECT_EQ((*pair->client->getCachedChunk(chunkPos))->version(), (*pair->world->getChunkIfLoaded(chunkPos))->version());
+}
+
+// A rejected edit to a chunk we hold is rolled back in the cache
+TEST_F(ClientServerTest, RejectedBlockEditRollsBack) {
+    auto pair = createServerClientPair();
+    pair->world->setDemandChunkLinger(std::chrono::milliseconds(200));
+    ASSERT_TRUE(pair->client->connect());
+    AbsolutePrecisePosition spawn(5000.0, 0.0, 5000.0);
+    ASSERT_TRUE(pair->client->connectAsPlayer("RollbackPlayer", spawn));
+    
+    // Demand-loaded, so the server drops it again shortly after the player leaves
+    const AbsoluteChunkPosition center = toAbsoluteChunk(spawn);
+    const AbsoluteChunkPosition chunkPos(center.x + 6, center.y, center.z);
+    pair->client->requestChunkAsync(chunkPos);
+    const auto loadDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!pair->client->getCachedChunk(chunkPos) && std::chrono::steady_clock::now() < loadDeadline) {
+        pair->client->processPendingRequests();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(pair->client->getCachedChunk(chunkPos).has_value());
+    // It stays loaded while the player is near it
+    ASSERT_TRUE(pair->client->updatePlayerPosition(AbsolutePrecisePosition(-5000.0, 0.0, -5000.0)));
+    const auto unloadDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (pair->world->getChunkIfLoaded(chunkPos) && std::chrono::steady_clock::now() < unloadDeadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_FALSE(pair->world->getChunkIfLoaded(chunkPos).has_value());
+    
+    const AbsoluteBlockPosition placed(chunkPos.x * CHUNK_WIDTH + 1, chunkPos.y * CHUNK_HEIGHT + 2, chunkPos.z * CHUNK_DEPTH + 3);
+    const ChunkLocalPosition local = toChunkLocal(placed, chunkPos);
+    const Block before = (*pair->client->getCachedChunk(chunkPos))->getBlock(local);
+    const Block edit = before == Block::Stone ? Block::Empty : Block::Stone;
+    ASSERT_TRUE(pair->client->placeBlockAsync(placed, edit));
+    EXPECT_EQ((*pair->client->getCachedChunk(chunkPos))->getBlock(local), edit);
+    
+    ASSERT_TRUE(pair->client->flushBlockEdits());
+    EXPECT_EQ(pair->client->getRejectedBlockEditCount(), 1u);
+    EXPECT_EQ((*pair->client->getCachedChunk(chunkPos))->getBlock(local), before);
+}
+
+// Each polling player sees every update, not just whoever polls first
+TEST_F(ClientServerTest, UpdatedChunksPerPlayer) {
+    auto pair = createServerClientPair();
+    auto client2 = std::make_unique<Client>("127.0.0.1", pair->port, "test_player2");
+    ASSERT_TRUE(pair->client->connect());
+    ASSERT_TRUE(client2->connect());
+    pair->client->setPlayerPosition(AbsoluteBlockPosition(0, 0, 0));
+    client2->setPlayerPosition(AbsoluteBlockPosition(0, 0, 0));
+    
+    // First polls register both players
+    pair->client->getUpdatedChunks(2);
+    client2->getUpdatedChunks(2);
+    
+    ASSERT_TRUE(pair->client->placeBlock(AbsoluteBlockPosition(1, 2, 1), Block::Stone));
+    EXPECT_EQ(pair->client->getUpdatedChunks(2).size(), 1u);
+    EXPECT_EQ(client2->getUpdatedChunks(2).size(), 1u);
+    
+    client2->disconnect();
+}
+
+// Test that block changes are pushed to subscribers
+TEST_F(ClientServerTest, ChunkSubscriptionPushesUpdates) {
+    auto pair = createServerClientPair();
+    auto editor = std::make_unique<Client>("127.0.0.1", pair->port, "editor");
+    ASSERT_TRUE(pair->client->connect());
+    ASSERT_TRUE(editor->connect());
+    
+    pair->client->setPlayerPosition(AbsoluteBlockPosition(0, 0, 0));
+    ASSERT_TRUE(pair->client->subscribeChunks(2));
+    AbsoluteBlockPosition placed(1, 2, 1);
+    AbsoluteChunkPosition chunkPos = toAbsoluteChunk(placed);
+    // Hold a copy so the edits arrive as block deltas on top of it
+    pair->client->requestChunkAsync(chunkPos);
+    const auto loadDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!pair->client->getCachedChunk(chunkPos) && std::chrono::steady_clock::now() < loadDeadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(pair->client->getCachedChunk(chunkPos).has_value());
+    // Let the stream register on the server
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    
+    ASSERT_TRUE(editor->placeBlock(placed, Block::Stone));
+    // Out of the view radius: not pushed
+    ASSERT_TRUE(editor->placeBlock(AbsoluteBlockPosition(CHUNK_WIDTH * 3, 0, 0), Block::Stone));
+    
+    std::vector<AbsoluteChunkPosition> updates;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (updates.empty() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        updates = pair->client->takeStreamedChunkUpdates();
+    }
+    ASSERT_EQ(updates.size(), 1u);
+    EXPECT_TRUE(ChunkPosEq{}(updates[0], chunkPos));
+    
+    // The pushed change is already in the cache, at the server's version
+    auto cached = pair->client->getCachedChunk(chunkPos);
+    ASSERT_TRUE(cached.has_value());
+    EXPECT_EQ((*cached)->getBlock(toChunkLocal(placed, chunkPos)), Block::Stone);
+    EXPECT_EQ((*cached)->version(), (*pair->world->chunkAt(chunkPos))->version());
+    
+    pair->client->unsubscribeChunks();
+    EXPECT_FALSE(pair->client->isSubscribed());
+    editor->disconnect();
+}
+
 // Test cache management
 TEST_F(ClientServerTest, CacheManagement) {
     auto pair = createServerClientPair();
@@ -231,8 +590,10 @@ TEST_F(ClientServerTest, CacheManagement) {
     EXPECT_EQ(pair->client->getCacheSize(), 0);
     
     // Test eviction (should not crash with empty cache)
-    pair->client->evictOldChunks(5);
+    pair->client->setCacheBudget(4096);
+    EXPECT_EQ(pair->client->evictOldChunks(), 0u);
     EXPECT_EQ(pair->client->getCacheSize(), 0);
+    EXPECT_EQ(pair->client->getCacheStats().byteBudget, 4096u);
 }
 
 // Test client disconnection and reconnection
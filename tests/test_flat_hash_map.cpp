@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include "flat_hash_map.h"
+#include "world.h"
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+// Random inserts, overwrites and erases must leave the same contents as std::unordered_map
+TEST(FlatHashMapTest, MatchesStdUnorderedMap) {
+    ChunkPosMap<int> flat;
+    std::unordered_map<AbsoluteChunkPosition, int, ChunkPosHash, ChunkPosEq> reference;
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int32_t> coord(-20, 20);
+    std::uniform_int_distribution<int> op(0, 3);
+
+    for (int i = 0; i < 50000; ++i) {
+        AbsoluteChunkPosition pos(coord(rng), coord(rng) / 4, coord(rng));
+        switch (op(rng)) {
+            case 0:
+            case 1:
+                flat[pos] = i;
+                reference[pos] = i;
+                break;
+            case 2:
+                EXPECT_EQ(flat.erase(pos), reference.erase(pos));
+                break;
+            case 3: {
+                auto it = flat.find(pos);
+                auto ref = reference.find(pos);
+                ASSERT_EQ(it == flat.end(), ref == reference.end());
+                if (ref != reference.end()) {
+                    EXPECT_EQ(it->second, ref->second);
+                }
+                break;
+            }
+        }
+        ASSERT_EQ(flat.size(), reference.size());
+    }
+
+    size_t visited = 0;
+    for (const auto& [pos, value] : flat) {
+        ASSERT_EQ(reference.at(pos), value);
+        ++visited;
+    }
+    EXPECT_EQ(visited, reference.size());
+}
+
+// Erasing while iterating removes every entry exactly once
+TEST(FlatHashMapTest, EraseWhileIterating) {
+    ChunkSet set;
+    for (int32_t x = 0; x < 64; ++x) {
+        for (int32_t z = 0; z < 64; ++z) {
+            set.insert(AbsoluteChunkPosition(x, 0, z));
+        }
+    }
+    EXPECT_EQ(set.size(), 4096u);
+    EXPECT_FALSE(set.insert(AbsoluteChunkPosition(3, 0, 3)).second);
+
+    size_t erased = 0;
+    for (auto it = set.begin(); it != set.end();) {
+        if (it->x % 2 == 0) {
+            it = set.erase(it);
+            ++erased;
+        } else {
+            ++it;
+        }
+    }
+    EXPECT_EQ(erased, 2048u);
+    EXPECT_EQ(set.size(), 2048u);
+    for (int32_t x = 0; x < 64; ++x) {
+        EXPECT_EQ(set.contains(AbsoluteChunkPosition(x, 0, 5)), x % 2 == 1);
+    }
+
+    set.clear();
+    EXPECT_TRUE(set.empty());
+    EXPECT_EQ(set.begin(), set.end());
+}
+
+// Move-only values survive rehashing and backward-shift deletion
+TEST(FlatHashMapTest, MoveOnlyValues) {
+    ChunkPosMap<std::unique_ptr<int>> map;
+    for (int i = 0; i < 1000; ++i) {
+        map.try_emplace(AbsoluteChunkPosition(i, -i, i * 3), std::make_unique<int>(i));
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        EXPECT_EQ(map.erase(AbsoluteChunkPosition(i, -i, i * 3)), 1u);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        auto it = map.find(AbsoluteChunkPosition(i, -i, i * 3));
+        if (i % 3 == 0) {
+            EXPECT_EQ(it, map.end());
+        } else {
+            ASSERT_NE(it, map.end());
+            EXPECT_EQ(*it->second, i);
+        }
+    }
+}
+
+// Adjacent chunks must not collide in the low bits the table indexes with
+TEST(FlatHashMapTest, ChunkHashSpreadsNeighbours) {
+    std::unordered_set<size_t> buckets;
+    for (int32_t x = 0; x < 16; ++x) {
+        for (int32_t y = 0; y < 16; ++y) {
+            for (int32_t z = 0; z < 16; ++z) {
+                buckets.insert(ChunkPosHash{}(AbsoluteChunkPosition(x, y, z)) & 4095);
+            }
+        }
+    }
+    // 4096 keys into 4096 buckets: a random function fills about 63% of them
+    EXPECT_GT(buckets.size(), 2400u);
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include "log.h"
+#include "metrics.h"
+#include "trace.h"
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Counters and histograms shared by threads add up, and snapshots report what was observed
+TEST(MetricsRegistryTest, CountsAndBucketsObservations) {
+    MetricsRegistry registry;
+    MetricCounter& counter = registry.counter("test_events_total", "Events", {{"kind", "a"}});
+    EXPECT_EQ(&counter, &registry.counter("test_events_total", "Events", {{"kind", "a"}}));
+    EXPECT_NE(&counter, &registry.counter("test_events_total", "Events", {{"kind", "b"}}));
+    EXPECT_THROW(registry.gauge("test_events_total", "Events", {{"kind", "a"}}), std::invalid_argument);
+
+    MetricHistogram& histogram = registry.histogram("test_duration_seconds", "Durations", {}, {0.001, 0.01, 0.1});
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 1000; ++i) {
+                counter.add();
+                histogram.observe(i % 2 == 0 ? 0.005 : 1.0);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    histogram.observe(std::chrono::microseconds(1000));
+    registry.gauge("test_depth", "Depth").set(-3);
+
+    auto metrics = registry.snapshot();
+    ASSERT_EQ(metrics.size(), 4u);
+    // Sorted by name, then labels
+    EXPECT_EQ(metrics[0].name, "test_depth");
+    EXPECT_EQ(metrics[0].value, -3.0);
+    EXPECT_EQ(metrics[1].name, "test_duration_seconds");
+    EXPECT_EQ(metrics[1].count, 4001u);
+    EXPECT_EQ(metrics[1].bucketCounts, (std::vector<uint64_t>{1, 2000, 0, 2000}));
+    EXPECT_NEAR(metrics[1].sum, 2000 * 0.005 + 2000 * 1.0 + 0.001, 1e-6);
+    EXPECT_EQ(metrics[2].labels, (MetricLabels{{"kind", "a"}}));
+    EXPECT_EQ(metrics[2].value, 4000.0);
+    EXPECT_EQ(metrics[3].value, 0.0);
+}
+
+// One HELP/TYPE per name, cumulative le buckets ending in +Inf, then _sum and _count
+TEST(MetricsRegistryTest, FormatsPrometheusText) {
+    MetricsRegistry registry;
+    registry.counter("test_calls_total", "Calls", {{"method", "Get\"Chunk"}}).add(2);
+    registry.counter("test_calls_total", "Calls", {{"method", "Ping"}}).add(1);
+    MetricHistogram& histogram = registry.histogram("test_bytes", "Sizes", {}, {16, 256});
+    histogram.observe(10);
+    histogram.observe(100);
+    histogram.observe(1000);
+
+    const std::string text = formatPrometheusText(registry.snapshot());
+    EXPECT_EQ(text,
+              "# HELP test_bytes Sizes\n"
+              "# TYPE test_bytes histogram\n"
+              "test_bytes_bucket{le=\"16\"} 1\n"
+              "test_bytes_bucket{le=\"256\"} 2\n"
+              "test_bytes_bucket{le=\"+Inf\"} 3\n"
+              "test_bytes_sum 1110\n"
+              "test_bytes_count 3\n"
+              "# HELP test_calls_total Calls\n"
+              "# TYPE test_calls_total counter\n"
+              "test_calls_total{method=\"Get\\\"Chunk\"} 2\n"
+              "test_calls_total{method=\"Ping\"} 1\n");
+}
+
+// Spans are only kept while tracing, oldest first once the ring wraps
+TEST(TracerTest, RecordsSpansAsChromeTraceEvents) {
+    Tracer& tracer = Tracer::global();
+    { TraceSpan ignored("before start"); }
+    tracer.start(2);
+    { TraceSpan first("first"); }
+    { TraceSpan second("second"); }
+    { TraceSpan third("third"); }
+    tracer.stop();
+    { TraceSpan ignored("after stop"); }
+
+    const std::string json = tracer.chromeTraceJson();
+    EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0u);
+    EXPECT_EQ(json.find("before start"), std::string::npos);
+    EXPECT_EQ(json.find("\"first\""), std::string::npos);
+    EXPECT_EQ(json.find("after stop"), std::string::npos);
+    const size_t second = json.find("{\"name\":\"second\",\"ph\":\"X\"");
+    const size_t third = json.find("{\"name\":\"third\",\"ph\":\"X\"");
+    ASSERT_NE(second, std::string::npos);
+    ASSERT_NE(third, std::string::npos);
+    EXPECT_LT(second, third);
+}
+
+// Disabled levels never evaluate their message
+TEST(LogTest, SkipsDisabledLevels) {
+    const LogLevel previous = logLevel();
+    int evaluated = 0;
+    auto count = [&] { return ++evaluated; };
+    setLogLevel(LogLevel::Error);
+    LOG_INFO("not shown " << count());
+    LOG_WARN("not shown " << count());
+    EXPECT_EQ(evaluated, 0);
+    EXPECT_TRUE(logEnabled(LogLevel::Error));
+    EXPECT_FALSE(logEnabled(LogLevel::Off));
+    setLogLevel(LogLevel::Off);
+    LOG_ERROR("not shown " << count());
+    EXPECT_EQ(evaluated, 0);
+    setLogLevel(previous);
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "rpc_dispatcher.h"
+
+namespace {
+
+// Holds the single worker inside a task until released
+struct Gate {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool entered = false;
+    bool open = false;
+
+    void block() {
+        std::unique_lock<std::mutex> lock(mutex);
+        entered = true;
+        cv.notify_all();
+        cv.wait(lock, [this] { return open; });
+    }
+    void waitEntered() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return entered; });
+    }
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex);
+        open = true;
+        cv.notify_all();
+    }
+};
+
+} // namespace
+
+TEST(RpcDispatcherTest, RunsHigherPriorityFirst) {
+    RpcDispatcher dispatcher(1, 16);
+    Gate gate;
+    dispatcher.submit(RpcPriority::Low, [&] { gate.block(); }, [] {});
+    gate.waitEntered();
+
+    std::mutex orderMutex;
+    std::vector<RpcPriority> order;
+    auto record = [&](RpcPriority p) {
+        return [&, p] {
+            std::lock_guard<std::mutex> lock(orderMutex);
+            order.push_back(p);
+        };
+    };
+    dispatcher.submit(RpcPriority::Low, record(RpcPriority::Low), [] {});
+    dispatcher.submit(RpcPriority::Normal, record(RpcPriority::Normal), [] {});
+    dispatcher.submit(RpcPriority::High, record(RpcPriority::High), [] {});
+    gate.release();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (dispatcher.queued() > 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    dispatcher.stop();
+
+    std::lock_guard<std::mutex> lock(orderMutex);
+    ASSERT_EQ(order.size(), 3u);
+    EXPECT_EQ(order[0], RpcPriority::High);
+    EXPECT_EQ(order[1], RpcPriority::Normal);
+    EXPECT_EQ(order[2], RpcPriority::Low);
+}
+
+TEST(RpcDispatcherTest, ShedsLowPriorityWorkWhenFull) {
+    RpcDispatcher dispatcher(1, 2);
+    Gate gate;
+    dispatcher.submit(RpcPriority::Low, [&] { gate.block(); }, [] {});
+    gate.waitEntered();
+
+    std::atomic<int> ran{0};
+    std::atomic<int> shed{0};
+    auto run = [&] { ++ran; };
+    auto drop = [&] { ++shed; };
+    EXPECT_TRUE(dispatcher.submit(RpcPriority::Low, run, drop));
+    EXPECT_TRUE(dispatcher.submit(RpcPriority::Low, run, drop));
+    // Full of Low work: another Low call is rejected, a High call displaces one
+    EXPECT_FALSE(dispatcher.submit(RpcPriority::Low, run, drop));
+    EXPECT_TRUE(dispatcher.submit(RpcPriority::High, run, drop));
+    EXPECT_EQ(shed.load(), 2);
+    EXPECT_EQ(dispatcher.queued(), 2u);
+
+    gate.release();
+    dispatcher.stop();
+    EXPECT_EQ(ran.load() + shed.load(), 4);
+    EXPECT_EQ(dispatcher.shedCount(), static_cast<size_t>(shed.load()));
+}
@@ -2,6 +2,29 @@
 #include "world.h"
 #include "position.h"
 #include "block.h"
+#include "chunk_generators.h"
+#include "chunk_residency.h"
+#include "sqlite_chunk_persistence.h"
+#include "region_chunk_persistence.h"
+#include "chunk_migration.h"
+#include "chunk_delta_log.h"
+#include "encoded_chunk_cache.h"
+#include "chunk_lod.h"
+#include "entity_sync.h"
+#include "dirty_chunk_tracker.h"
+#include "client_chunk_cache.h"
+#include "chunk_request_scheduler.h"
+#include "mpsc_queue.h"
+#include "tick_scheduler.h"
+#include "entity_spatial_index.h"
+#include "timer_wheel.h"
+#include "player_session.h"
+#include "name_component.h"
+#include "chunk_arena.h"
+#include <filesystem>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 class WorldTest : public ::testing::Test {
 protected:
@@ -48,4 +71,1321 @@ TEST_F(WorldTest, ChunkManagement) {
 TEST_F(WorldTest, WorldGeneration) {
     // Test terrain generation methods if available
     EXPECT_TRUE(true); // Placeholder test
-}
\ No newline at end of file
+}
+
+// Parallel generation must produce exactly what serial generation does
+TEST_F(WorldTest, ParallelGenerationMatchesSerial) {
+    auto generator = std::make_shared<FlatworldChunkGenerator>(4, Block::Stone);
+    auto anchors = []() { return std::vector<AbsoluteBlockPosition>{ {0,0,0}, {40,0,0} }; };
+
+    World serial(generator, anchors, 2, 7);
+    serial.ensureChunksLoaded();
+
+    World parallel(generator, anchors, 2, 7);
+    parallel.setGenerationThreads(4);
+    EXPECT_EQ(parallel.getGenerationThreads(), 4u);
+    parallel.ensureChunksLoaded();
+
+    for (int32_t x = -2; x <= 5; ++x) {
+        for (int32_t y = -2; y <= 2; ++y) {
+            for (int32_t z = -2; z <= 2; ++z) {
+                AbsoluteChunkPosition pos(x, y, z);
+                auto a = serial.getChunkIfLoaded(pos);
+                auto b = parallel.getChunkIfLoaded(pos);
+                ASSERT_EQ(a.has_value(), b.has_value());
+                if (!a) continue;
+                for (size_t i = 0; i < CHUNK_BLOCK_COUNT; ++i) {
+                    ASSERT_EQ((*a)->getBlock(i), (*b)->getBlock(i));
+                }
+            }
+        }
+    }
+    ASSERT_TRUE(parallel.getBlockIfLoaded(AbsoluteBlockPosition(0, 3, 0)).has_value());
+    EXPECT_EQ(*parallel.getBlockIfLoaded(AbsoluteBlockPosition(0, 3, 0)), Block::Stone);
+    EXPECT_EQ(*parallel.getBlockIfLoaded(AbsoluteBlockPosition(0, 4, 0)), Block::Empty);
+}
+
+// Moving an anchor loads the chunks entering its sphere and unloads the ones leaving it
+TEST_F(WorldTest, AnchorMovementLoadsAndUnloadsShell) {
+    AbsoluteBlockPosition anchor(0, 0, 0);
+    World moving(nullptr, [&]() { return std::vector<AbsoluteBlockPosition>{ anchor }; }, 2);
+    moving.ensureChunksLoaded();
+    EXPECT_TRUE(moving.getChunkIfLoaded(AbsoluteChunkPosition(-2, 0, 0)).has_value());
+    EXPECT_FALSE(moving.getChunkIfLoaded(AbsoluteChunkPosition(3, 0, 0)).has_value());
+
+    // Step one chunk along +x
+    anchor = AbsoluteBlockPosition(CHUNK_WIDTH, 0, 0);
+    moving.ensureChunksLoaded();
+    moving.garbageCollectChunks();
+
+    for (int32_t x = -4; x <= 5; ++x) {
+        for (int32_t y = -3; y <= 3; ++y) {
+            for (int32_t z = -3; z <= 3; ++z) {
+                int32_t dx = x - 1;
+                bool expected = dx * dx + y * y + z * z <= 4;
+                EXPECT_EQ(moving.getChunkIfLoaded(AbsoluteChunkPosition(x, y, z)).has_value(), expected)
+                    << x << "," << y << "," << z;
+            }
+        }
+    }
+}
+
+// Block writes report the new chunk version, and a reloaded chunk never reuses an old one
+TEST_F(WorldTest, ChunkVersionsRiseAcrossEditsAndReloads) {
+    AbsoluteBlockPosition anchor(0, 0, 0);
+    World moving(nullptr, [&]() { return std::vector<AbsoluteBlockPosition>{ anchor }; }, 1);
+    moving.ensureChunksLoaded();
+
+    BlockEditResult firstEdit;
+    BlockEditResult secondEdit;
+    ASSERT_TRUE(moving.setBlockIfLoaded(AbsoluteBlockPosition(1, 1, 1), Block::Stone, &firstEdit));
+    ASSERT_TRUE(moving.setBlockIfLoaded(AbsoluteBlockPosition(2, 1, 1), Block::Stone, &secondEdit));
+    EXPECT_TRUE(firstEdit.changed && secondEdit.changed);
+    const uint64_t second = secondEdit.version;
+    EXPECT_EQ(second, firstEdit.version + 1);
+    EXPECT_EQ((*moving.chunkAt(AbsoluteChunkPosition(0, 0, 0)))->version(), second);
+    // Writing the block already there is no change, and keeps the published chunk
+    auto published = *moving.chunkAt(AbsoluteChunkPosition(0, 0, 0));
+    BlockEditResult same;
+    ASSERT_TRUE(moving.setBlockIfLoaded(AbsoluteBlockPosition(2, 1, 1), Block::Stone, &same));
+    EXPECT_FALSE(same.changed);
+    EXPECT_EQ(same.version, second);
+    EXPECT_EQ(*moving.chunkAt(AbsoluteChunkPosition(0, 0, 0)), published);
+
+    // Move away so the chunk unloads, then come back
+    anchor = AbsoluteBlockPosition(CHUNK_WIDTH * 10, 0, 0);
+    moving.ensureChunksLoaded();
+    moving.garbageCollectChunks();
+    ASSERT_FALSE(moving.chunkAt(AbsoluteChunkPosition(0, 0, 0)).has_value());
+    anchor = AbsoluteBlockPosition(0, 0, 0);
+    moving.ensureChunksLoaded();
+    auto reloaded = moving.chunkAt(AbsoluteChunkPosition(0, 0, 0));
+    ASSERT_TRUE(reloaded.has_value());
+    EXPECT_GT((*reloaded)->version(), second);
+}
+
+// A batch of edits publishes each chunk once, in request order, and skips unloaded chunks
+TEST_F(WorldTest, BulkEditsGroupByChunk) {
+    World bulk(nullptr, []() { return std::vector<AbsoluteBlockPosition>{ {0, 0, 0} }; }, 1);
+    bulk.ensureChunksLoaded();
+    const uint64_t before = (*bulk.chunkAt(AbsoluteChunkPosition(0, 0, 0)))->version();
+
+    const std::vector<BlockPlacement> edits{
+        {AbsoluteBlockPosition(1, 1, 1), Block::Stone},
+        {AbsoluteBlockPosition(CHUNK_WIDTH + 1, 1, 1), Block::Dirt},
+        {AbsoluteBlockPosition(CHUNK_WIDTH * 50, 0, 0), Block::Dirt},
+        {AbsoluteBlockPosition(1, 1, 1), Block::Sand},
+        {AbsoluteBlockPosition(2, 1, 1), Block::Water},
+        {AbsoluteBlockPosition(2, 1, 1), Block::Water},
+    };
+    auto results = bulk.setBlocksIfLoaded(edits);
+    ASSERT_EQ(results.size(), edits.size());
+    EXPECT_FALSE(results[2].has_value());
+    ASSERT_TRUE(results[0] && results[1] && results[3] && results[4] && results[5]);
+    EXPECT_EQ(results[0]->version, before + 1);
+    EXPECT_EQ(results[3]->version, before + 2);
+    EXPECT_EQ(results[4]->version, before + 3);
+    // A repeated write changes nothing
+    EXPECT_TRUE(results[4]->changed);
+    EXPECT_FALSE(results[5]->changed);
+    EXPECT_EQ(results[5]->version, before + 3);
+
+    auto chunk = *bulk.chunkAt(AbsoluteChunkPosition(0, 0, 0));
+    EXPECT_EQ(chunk->version(), results[4]->version);
+    EXPECT_EQ(*bulk.getBlockIfLoaded(AbsoluteBlockPosition(1, 1, 1)), Block::Sand);
+    EXPECT_EQ(*bulk.getBlockIfLoaded(AbsoluteBlockPosition(2, 1, 1)), Block::Water);
+    EXPECT_EQ(*bulk.getBlockIfLoaded(AbsoluteBlockPosition(CHUNK_WIDTH + 1, 1, 1)), Block::Dirt);
+}
+
+// Chunks around players stay loaded through garbage collection
+TEST_F(WorldTest, GarbageCollectionKeepsPlayerChunks) {
+    World players(nullptr, []() { return std::vector<AbsoluteBlockPosition>{}; }, 1);
+    auto player = players.spawnPlayer("alice", AbsolutePrecisePosition(100.0, 0.0, 0.0));
+    players.ensureChunksLoaded();
+    players.garbageCollectChunks();
+    AbsoluteChunkPosition playerChunk = toAbsoluteChunk(AbsolutePrecisePosition(100.0, 0.0, 0.0));
+    EXPECT_TRUE(players.getChunkIfLoaded(playerChunk).has_value());
+
+    players.despawnPlayer(player);
+    players.garbageCollectChunks();
+    EXPECT_FALSE(players.getChunkIfLoaded(playerChunk).has_value());
+}
+
+TEST_F(WorldTest, EntityQueriesFollowPlayerMoves) {
+    World players(nullptr, []() { return std::vector<AbsoluteBlockPosition>{}; }, 1);
+    auto near = players.spawnPlayer("near", AbsolutePrecisePosition(1.0, 0.0, 1.0));
+    std::string token = players.createPlayerSession("far", AbsolutePrecisePosition(200.0, 0.0, 0.0));
+    auto far = players.getPlayerSession(token)->playerEntity;
+    EXPECT_EQ(players.entitiesInRadius(AbsolutePrecisePosition(0.0, 0.0, 0.0), 10.0), std::vector<entt::entity>{near});
+
+    EXPECT_TRUE(players.updatePlayerPosition(token, AbsolutePrecisePosition(4.0, 0.0, 0.0)));
+    EXPECT_EQ(players.entitiesInRadius(AbsolutePrecisePosition(0.0, 0.0, 0.0), 10.0).size(), 2u);
+    players.despawnPlayer(near);
+    EXPECT_EQ(players.entitiesInChunkBox(AbsoluteChunkPosition(-1, -1, -1), AbsoluteChunkPosition(1, 1, 1)), std::vector<entt::entity>{far});
+}
+
+// Block reads and writes from many threads race safely with loading and unloading
+TEST_F(WorldTest, ConcurrentBlockAccessDuringLoadAndUnload) {
+    std::atomic<int64_t> anchorX{0};
+    World concurrent(std::make_shared<FlatworldChunkGenerator>(4, Block::Stone),
+                     [&]() { return std::vector<AbsoluteBlockPosition>{ {anchorX.load(), 0, 0} }; }, 2);
+    concurrent.ensureChunksLoaded();
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> writes{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&, t]() {
+            for (int i = 0; !stop.load(); ++i) {
+                AbsoluteBlockPosition pos((i * 7 + t) % 48 - 16, 8 + t, (i * 3) % 32 - 16);
+                if (concurrent.setBlockIfLoaded(pos, Block::Dirt)) {
+                    ++writes;
+                    auto block = concurrent.getBlockIfLoaded(pos);
+                    // Without persistence an unload in between regenerates the chunk, losing the edit
+                    if (block.has_value()) {
+                        EXPECT_TRUE(*block == Block::Dirt || *block == Block::Empty);
+                    }
+                }
+                auto chunk = concurrent.chunkAt(AbsoluteChunkPosition(0, 0, 0));
+                if (chunk) {
+                    EXPECT_EQ((*chunk)->getBlock(ChunkLocalPosition(0, 0, 0)), Block::Stone);
+                }
+            }
+        });
+    }
+
+    // Walk the anchor back and forth so chunks keep loading and unloading under the workers
+    for (int step = 0; step < 40; ++step) {
+        anchorX = (step % 8 < 4 ? step % 4 : 4 - step % 4) * CHUNK_WIDTH;
+        concurrent.ensureChunksLoaded();
+        concurrent.garbageCollectChunks();
+    }
+    stop = true;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    EXPECT_GT(writes.load(), 0u);
+}
+
+TEST_F(WorldTest, ChunksLoadedInSkipsEmptyRegions) {
+    std::atomic<int64_t> anchorX{0};
+    World probed(std::make_shared<FlatworldChunkGenerator>(4, Block::Stone),
+                 [&]() { return std::vector<AbsoluteBlockPosition>{ {anchorX.load(), 0, 0} }; }, 1);
+    probed.ensureChunksLoaded();
+    ASSERT_TRUE(probed.chunkAt(AbsoluteChunkPosition(-1, 0, 0)).has_value());
+    ASSERT_FALSE(probed.chunkAt(AbsoluteChunkPosition(1, 1, 1)).has_value());
+
+    EXPECT_TRUE(probed.chunksLoadedIn(AbsoluteChunkPosition(0, 0, 0), AbsoluteChunkPosition(0, 0, 0)));
+    // Wholly covers a region with chunks in it
+    EXPECT_TRUE(probed.chunksLoadedIn(AbsoluteChunkPosition(-8, 0, 0), AbsoluteChunkPosition(-1, 7, 7)));
+    // Partly covers one, missing its chunks
+    EXPECT_FALSE(probed.chunksLoadedIn(AbsoluteChunkPosition(1, 1, 1), AbsoluteChunkPosition(7, 7, 7)));
+    EXPECT_FALSE(probed.chunksLoadedIn(AbsoluteChunkPosition(100, 0, 0), AbsoluteChunkPosition(200, 0, 0)));
+
+    // Unloading takes the chunks out of their regions' counts
+    anchorX = 1000 * CHUNK_WIDTH;
+    probed.ensureChunksLoaded();
+    probed.garbageCollectChunks();
+    EXPECT_FALSE(probed.chunksLoadedIn(AbsoluteChunkPosition(-8, -8, -8), AbsoluteChunkPosition(7, 7, 7)));
+    EXPECT_TRUE(probed.chunksLoadedIn(AbsoluteChunkPosition(1000, 0, 0), AbsoluteChunkPosition(1000, 0, 0)));
+}
+
+// In-memory persistence that records every save
+class RecordingPersistence : public IChunkPersistence {
+public:
+    bool saveChunk(const ChunkSpan& chunk) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        stored.insert_or_assign(chunk.position, std::make_shared<ChunkSpan>(chunk));
+        ++saves;
+        return true;
+    }
+    std::optional<std::shared_ptr<ChunkSpan>> loadChunk(const AbsoluteChunkPosition& pos) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = stored.find(pos);
+        if (it == stored.end()) return std::nullopt;
+        return std::make_shared<ChunkSpan>(*it->second);
+    }
+    void saveAllLoadedChunks(const ChunkMap& chunks) override {
+        for (const auto& [pos, chunk] : chunks) saveChunk(*chunk);
+    }
+    size_t saveCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return saves;
+    }
+
+    std::mutex mutex;
+    ChunkMap stored;
+    size_t saves = 0;
+};
+
+// Only generated or edited chunks are written back, and shutdown skips clean chunks
+TEST_F(WorldTest, OnlyDirtyChunksAreSaved) {
+    auto persistence = std::make_shared<RecordingPersistence>();
+    auto generator = std::make_shared<FlatworldChunkGenerator>(4, Block::Stone);
+    AbsoluteBlockPosition anchor(0, 0, 0);
+    auto anchors = [&]() { return std::vector<AbsoluteBlockPosition>{ anchor }; };
+
+    // First session generates (dirty) chunks, which are all saved at shutdown
+    {
+        World first(generator, anchors, 1, 0, persistence);
+        first.ensureChunksLoaded();
+    }
+    const size_t generatedCount = persistence->saveCount();
+    EXPECT_EQ(generatedCount, 7u);
+
+    // Second session loads them clean, edits one and moves away
+    {
+        World second(generator, anchors, 1, 0, persistence);
+        second.ensureChunksLoaded();
+        EXPECT_TRUE(second.setBlockIfLoaded(AbsoluteBlockPosition(0, 10, 0), Block::Dirt));
+        anchor = AbsoluteBlockPosition(CHUNK_WIDTH * 100, 0, 0);
+        second.garbageCollectChunks();
+        EXPECT_FALSE(second.getChunkIfLoaded(AbsoluteChunkPosition(0, 0, 0)).has_value());
+
+        // Coming back before or after the write lands must see the edit
+        anchor = AbsoluteBlockPosition(0, 0, 0);
+        second.ensureChunksLoaded();
+        auto block = second.getBlockIfLoaded(AbsoluteBlockPosition(0, 10, 0));
+        ASSERT_TRUE(block.has_value());
+        EXPECT_EQ(*block, Block::Dirt);
+        anchor = AbsoluteBlockPosition(CHUNK_WIDTH * 100, 0, 0);
+        second.ensureChunksLoaded();
+    }
+    // One write for the edited chunk, plus the far-away chunks generated at shutdown
+    EXPECT_EQ(persistence->saveCount(), generatedCount + 1 + 7);
+    ASSERT_TRUE(persistence->loadChunk(AbsoluteChunkPosition(0, 0, 0)).has_value());
+    EXPECT_EQ((*persistence->loadChunk(AbsoluteChunkPosition(0, 0, 0)))->getBlock(ChunkLocalPosition(0, 10, 0)), Block::Dirt);
+}
+
+// Budgeted loads carry the rest over, and an autosave sweep leaves shutdown only the later edits
+TEST_F(WorldTest, BudgetedLoadingAndAutosaveCarryOver) {
+    using namespace std::chrono;
+    auto persistence = std::make_shared<RecordingPersistence>();
+    auto generator = std::make_shared<FlatworldChunkGenerator>(4, Block::Stone);
+    auto anchors = []() { return std::vector<AbsoluteBlockPosition>{ {0, 0, 0} }; };
+    size_t queued = 0;
+    {
+        World budgeted(generator, anchors, 2, 0, persistence);
+        auto loadedCount = [&]() {
+            size_t count = 0;
+            for (int x = -2; x <= 2; ++x)
+                for (int y = -2; y <= 2; ++y)
+                    for (int z = -2; z <= 2; ++z)
+                        count += budgeted.getChunkIfLoaded(AbsoluteChunkPosition(x, y, z)).has_value();
+            return count;
+        };
+        queued = budgeted.queueChunkLoads();
+        ASSERT_GT(queued, CHUNK_LOAD_BATCH_PER_THREAD);
+
+        // A deadline already past still loads one batch
+        EXPECT_TRUE(budgeted.loadQueuedChunks(steady_clock::now() - seconds(1)));
+        EXPECT_EQ(loadedCount(), CHUNK_LOAD_BATCH_PER_THREAD);
+        EXPECT_EQ(budgeted.queueChunkLoads(), queued - CHUNK_LOAD_BATCH_PER_THREAD);
+        EXPECT_FALSE(budgeted.loadQueuedChunks(steady_clock::now() + seconds(10)));
+        EXPECT_EQ(loadedCount(), queued);
+
+        // Generated chunks start dirty; a sweep a shard at a time queues each once
+        size_t steps = 1;
+        while (budgeted.saveDirtyChunks(steady_clock::now() - seconds(1))) {
+            ++steps;
+        }
+        EXPECT_GT(steps, 1u);
+        EXPECT_TRUE(budgeted.setBlockIfLoaded(AbsoluteBlockPosition(0, 10, 0), Block::Dirt));
+    }
+    EXPECT_EQ(persistence->saveCount(), queued + 1);
+}
+
+// Demand loads share one future per position and outlast GC only while they keep being asked for
+TEST_F(WorldTest, DemandLoadsShareFuturesAndLinger) {
+    using namespace std::chrono;
+    auto generator = std::make_shared<FlatworldChunkGenerator>(4, Block::Stone);
+    World demand(generator, []() { return std::vector<AbsoluteBlockPosition>{ {0, 0, 0} }; }, 1);
+    demand.ensureChunksLoaded();
+    const AbsoluteChunkPosition far(40, 0, 0);
+
+    auto first = demand.requestChunkLoad(far);
+    auto second = demand.requestChunkLoad(far);
+    EXPECT_EQ(first.wait_for(seconds(0)), std::future_status::timeout);
+    EXPECT_TRUE(demand.hasDemandedChunks());
+    auto published = demand.loadDemandedChunks(steady_clock::now() + seconds(10));
+    ASSERT_EQ(published.size(), 1u);
+    EXPECT_TRUE(ChunkPosEq{}(published[0], far));
+    EXPECT_FALSE(demand.hasDemandedChunks());
+    ASSERT_EQ(first.wait_for(seconds(0)), std::future_status::ready);
+    ASSERT_TRUE(first.get());
+    EXPECT_EQ(first.get(), second.get());
+    EXPECT_EQ(first.get()->getBlock(ChunkLocalPosition(0, 0, 0)), Block::Stone);
+
+    // Loaded chunks answer at once, and GC keeps the lingering one
+    auto again = demand.requestChunkLoad(far);
+    EXPECT_EQ(again.wait_for(seconds(0)), std::future_status::ready);
+    demand.garbageCollectChunks();
+    EXPECT_TRUE(demand.getChunkIfLoaded(far).has_value());
+
+    demand.setDemandChunkLinger(milliseconds(0));
+    // A player close by may still be using it without asking again
+    const std::string token = demand.createPlayerSession("nearby", AbsolutePrecisePosition(34 * CHUNK_WIDTH, 0.0, 0.0));
+    demand.garbageCollectChunks();
+    EXPECT_TRUE(demand.getChunkIfLoaded(far).has_value());
+
+    ASSERT_TRUE(demand.updatePlayerPosition(token, AbsolutePrecisePosition(0.0, 0.0, 0.0)));
+    demand.garbageCollectChunks();
+    EXPECT_FALSE(demand.getChunkIfLoaded(far).has_value());
+    EXPECT_TRUE(demand.getChunkIfLoaded(AbsoluteChunkPosition(0, 0, 0)).has_value());
+}
+
+// A checkpoint brings back chunks with their versions, and sessions and players under their old ids
+TEST_F(WorldTest, CheckpointRestoresChunksSessionsAndPlayers) {
+    auto path = std::filesystem::temp_directory_path() / "blocktest_world_checkpoint_test.ckpt";
+    std::filesystem::remove(path);
+    const AbsolutePrecisePosition spawn(4.5, 6.0, 7.5);
+    BlockEditResult edited;
+    std::string token;
+    {
+        World original(nullptr, []() { return std::vector<AbsoluteBlockPosition>{ {0, 0, 0} }; }, 1);
+        EXPECT_FALSE(original.restoreCheckpoint(path));
+        original.ensureChunksLoaded();
+        ASSERT_TRUE(original.setBlockIfLoaded(AbsoluteBlockPosition(1, 2, 3), Block::Stone, &edited));
+        token = original.createPlayerSession("alice", spawn);
+        ASSERT_TRUE(original.saveCheckpoint(path));
+    }
+
+    World restored(nullptr, []() { return std::vector<AbsoluteBlockPosition>{ {0, 0, 0} }; }, 2);
+    ASSERT_TRUE(restored.restoreCheckpoint(path));
+    auto chunk = restored.getChunkIfLoaded(AbsoluteChunkPosition(0, 0, 0));
+    ASSERT_TRUE(chunk.has_value());
+    EXPECT_EQ((*chunk)->version(), edited.version);
+    EXPECT_EQ(restored.getBlockIfLoaded(AbsoluteBlockPosition(1, 2, 3)), Block::Stone);
+    auto session = restored.getPlayerSession(token);
+    ASSERT_TRUE(session.has_value());
+    EXPECT_EQ(session->playerName, "alice");
+    ASSERT_TRUE(restored.getRegistry().valid(session->playerEntity));
+    EXPECT_EQ(restored.getRegistry().get<NameComponent>(session->playerEntity).name, "alice");
+    auto nearby = restored.entitiesInRadius(spawn, 1.0);
+    ASSERT_EQ(nearby.size(), 1u);
+    EXPECT_EQ(nearby[0], session->playerEntity);
+    EXPECT_TRUE(restored.updatePlayerPosition(token, AbsolutePrecisePosition(5.0, 6.0, 7.5)));
+
+    // The anchors take over the restored chunks, and versions keep rising past the saved ones
+    restored.ensureChunksLoaded();
+    BlockEditResult next;
+    ASSERT_TRUE(restored.setBlockIfLoaded(AbsoluteBlockPosition(1, 2, 3), Block::Air, &next));
+    EXPECT_GT(next.version, edited.version);
+    auto fresh = restored.getChunkIfLoaded(AbsoluteChunkPosition(2, 0, 0));
+    ASSERT_TRUE(fresh.has_value());
+    EXPECT_GT((*fresh)->version(), edited.version);
+
+    // Only a world nobody has joined yet can be restored into
+    EXPECT_FALSE(restored.restoreCheckpoint(path));
+    std::filesystem::remove(path);
+}
+
+// With persistence a checkpoint is restored once: a crash after later saves can't bring it back
+TEST_F(WorldTest, CheckpointIsConsumedByRestoreWithPersistence) {
+    auto path = std::filesystem::temp_directory_path() / "blocktest_world_checkpoint_consumed.ckpt";
+    std::filesystem::remove(path);
+    auto persistence = std::make_shared<RecordingPersistence>();
+    auto generator = std::make_shared<FlatworldChunkGenerator>(4, Block::Stone);
+    auto anchors = []() { return std::vector<AbsoluteBlockPosition>{ {0, 0, 0} }; };
+    const AbsoluteBlockPosition block(1, 2, 3);
+    {
+        World original(generator, anchors, 1, 0, persistence);
+        original.ensureChunksLoaded();
+        ASSERT_TRUE(original.setBlockIfLoaded(block, Block::Grass));
+        ASSERT_TRUE(original.saveCheckpoint(path));
+    }
+    // As if it had crashed after the checkpoint: nothing reached the store
+    persistence->stored.clear();
+
+    {
+        World restored(generator, anchors, 1, 0, persistence);
+        ASSERT_TRUE(restored.restoreCheckpoint(path));
+        EXPECT_FALSE(std::filesystem::exists(path));
+        auto saved = persistence->loadChunk(toAbsoluteChunk(block));
+        ASSERT_TRUE(saved.has_value());
+        EXPECT_EQ((*saved)->getBlock(toChunkLocal(block, toAbsoluteChunk(block))), Block::Grass);
+
+        // A later edit is saved by the write-behind, then this run crashes too
+        restored.ensureChunksLoaded();
+        ASSERT_TRUE(restored.setBlockIfLoaded(block, Block::Air));
+        restored.saveDirtyChunks(std::chrono::steady_clock::time_point::max());
+    }
+
+    World restarted(generator, anchors, 1, 0, persistence);
+    EXPECT_FALSE(restarted.restoreCheckpoint(path));
+    restarted.ensureChunksLoaded();
+    EXPECT_EQ(restarted.getBlockIfLoaded(block), Block::Air);
+}
+
+TEST(TickSchedulerTest, PhasesRunInOrderWithCumulativeDeadlines) {
+    using namespace std::chrono;
+    TickScheduler tick;
+    std::vector<std::string> order;
+    std::vector<TickScheduler::Clock::time_point> deadlines;
+    int backlog = 3;
+    tick.addPhase("first", milliseconds(10), [&](TickScheduler::Clock::time_point deadline) {
+        order.push_back("first");
+        deadlines.push_back(deadline);
+        return false;
+    });
+    // Works off one item per tick
+    tick.addPhase("backlog", milliseconds(10), [&](TickScheduler::Clock::time_point deadline) {
+        order.push_back("backlog");
+        deadlines.push_back(deadline);
+        --backlog;
+        return backlog > 0;
+    });
+    tick.addPhase("slow", microseconds(1), [&](TickScheduler::Clock::time_point deadline) {
+        order.push_back("slow");
+        std::this_thread::sleep_until(deadline + milliseconds(2));
+        return false;
+    });
+
+    tick.runTick();
+    EXPECT_EQ(order, (std::vector<std::string>{"first", "backlog", "slow"}));
+    EXPECT_EQ(deadlines[1] - deadlines[0], milliseconds(10));
+    tick.runTick();
+    tick.runTick();
+    EXPECT_EQ(backlog, 0);
+    EXPECT_EQ(tick.tickCount(), 3u);
+
+    auto stats = tick.stats();
+    ASSERT_EQ(stats.size(), 3u);
+    EXPECT_EQ(stats[1].runs, 3u);
+    EXPECT_EQ(stats[1].carriedOver, 2u);
+    EXPECT_FALSE(stats[1].pending);
+    EXPECT_EQ(stats[0].overruns, 0u);
+    EXPECT_EQ(stats[2].overruns, 3u);
+    EXPECT_GE(stats[2].worstDuration, milliseconds(2));
+
+    EXPECT_TRUE(tick.setBudget("slow", milliseconds(50)));
+    EXPECT_FALSE(tick.setBudget("missing", milliseconds(50)));
+    EXPECT_EQ(tick.stats()[2].budget, milliseconds(50));
+}
+
+// Batched saves and bulk loads round-trip through a WAL-mode database
+TEST(SQLiteChunkPersistenceTest, BatchSaveAndBulkLoad) {
+    auto path = std::filesystem::temp_directory_path() / "blocktest_persistence_test.db";
+    std::filesystem::remove(path);
+    {
+        sqlite3* raw = nullptr;
+        ASSERT_EQ(sqlite3_open(path.string().c_str(), &raw), SQLITE_OK);
+        SQLiteChunkPersistence persistence(std::unique_ptr<sqlite3, decltype(&sqlite3_close)>(raw, sqlite3_close));
+
+        std::vector<std::shared_ptr<const ChunkSpan>> batch;
+        std::vector<AbsoluteChunkPosition> positions;
+        for (int32_t i = 0; i < 64; ++i) {
+            auto chunk = std::make_shared<ChunkSpan>(AbsoluteChunkPosition(i, -i, 2 * i));
+            chunk->setBlock(static_cast<size_t>(i), Block::Stone);
+            batch.push_back(chunk);
+            positions.emplace_back(i, -i, 2 * i);
+        }
+        positions.emplace_back(1000, 1000, 1000);
+        EXPECT_TRUE(persistence.saveChunks(batch));
+        EXPECT_TRUE(persistence.setSynchronousMode(SQLiteSynchronousMode::Full));
+
+        auto loaded = persistence.loadChunks(positions);
+        ASSERT_EQ(loaded.size(), positions.size());
+        for (int32_t i = 0; i < 64; ++i) {
+            ASSERT_TRUE(loaded[i].has_value());
+            EXPECT_TRUE(ChunkPosEq{}((*loaded[i])->position, positions[i]));
+            EXPECT_EQ((*loaded[i])->getBlock(static_cast<size_t>(i)), Block::Stone);
+            EXPECT_EQ((*loaded[i])->getBlock(static_cast<size_t>(i + 1)), Block::Empty);
+        }
+        EXPECT_FALSE(loaded.back().has_value());
+        EXPECT_FALSE(persistence.loadChunk(AbsoluteChunkPosition(1000, 1000, 1000)).has_value());
+        // The serialized batch returns the stored bytes undecoded
+        auto serialized = persistence.loadSerializedChunks(positions);
+        ASSERT_EQ(serialized.size(), positions.size());
+        ASSERT_TRUE(serialized[5].has_value());
+        EXPECT_EQ(*serialized[5], batch[5]->serialize());
+        EXPECT_FALSE(serialized.back().has_value());
+
+        // Single-chunk saves overwrite rows from the batch
+        ChunkSpan replacement(AbsoluteChunkPosition(0, 0, 0));
+        replacement.fill(Block::Dirt);
+        EXPECT_TRUE(persistence.saveChunk(replacement));
+        auto reloaded = persistence.loadChunk(AbsoluteChunkPosition(0, 0, 0));
+        ASSERT_TRUE(reloaded.has_value());
+        EXPECT_TRUE((*reloaded)->isUniform());
+        EXPECT_EQ((*reloaded)->uniformBlock(), Block::Dirt);
+    }
+    std::filesystem::remove(path);
+    std::filesystem::remove(path.string() + "-wal");
+    std::filesystem::remove(path.string() + "-shm");
+}
+
+// Region files round-trip chunks across regions, rewrites and reopening
+TEST(RegionFileChunkPersistenceTest, RoundTripAndReopen) {
+    auto dir = std::filesystem::temp_directory_path() / "blocktest_region_test";
+    std::filesystem::remove_all(dir);
+    std::vector<AbsoluteChunkPosition> positions = { {0,0,0}, {31,31,31}, {32,0,0}, {-1,-1,-1}, {-33,5,70} };
+    {
+        RegionFileChunkPersistence regions(dir);
+        EXPECT_FALSE(regions.loadChunk(AbsoluteChunkPosition(0, 0, 0)).has_value());
+
+        std::vector<std::shared_ptr<const ChunkSpan>> batch;
+        for (size_t i = 0; i < positions.size(); ++i) {
+            auto chunk = std::make_shared<ChunkSpan>(positions[i]);
+            chunk->setBlock(i, Block::Stone);
+            batch.push_back(chunk);
+        }
+        EXPECT_TRUE(regions.saveChunks(batch));
+
+        // Grow one chunk past its sectors so it has to move, and shrink another in place
+        ChunkSpan dense(positions[0]);
+        for (size_t i = 0; i < CHUNK_BLOCK_COUNT; ++i) {
+            dense.setBlock(i, (i % 3) ? Block::Stone : Block::Dirt);
+        }
+        EXPECT_TRUE(regions.saveChunk(dense));
+        ChunkSpan emptied(positions[1]);
+        EXPECT_TRUE(regions.saveChunk(emptied));
+        EXPECT_TRUE(regions.flush());
+    }
+    EXPECT_TRUE(std::filesystem::exists(dir / "r.-1.-1.-1.region"));
+
+    RegionFileChunkPersistence reopened(dir);
+    auto first = reopened.loadChunk(positions[0]);
+    ASSERT_TRUE(first.has_value());
+    for (size_t i = 0; i < CHUNK_BLOCK_COUNT; ++i) {
+        ASSERT_EQ((*first)->getBlock(i), (i % 3) ? Block::Stone : Block::Dirt);
+    }
+    auto second = reopened.loadChunk(positions[1]);
+    ASSERT_TRUE(second.has_value());
+    EXPECT_TRUE((*second)->isUniform());
+    for (size_t i = 2; i < positions.size(); ++i) {
+        auto chunk = reopened.loadChunk(positions[i]);
+        ASSERT_TRUE(chunk.has_value()) << i;
+        EXPECT_TRUE(ChunkPosEq{}((*chunk)->position, positions[i]));
+        EXPECT_EQ((*chunk)->getBlock(i), Block::Stone);
+        EXPECT_EQ((*chunk)->getBlock(i + 1), Block::Empty);
+    }
+    EXPECT_FALSE(reopened.loadChunk(AbsoluteChunkPosition(1, 0, 0)).has_value());
+    std::filesystem::remove_all(dir);
+}
+
+// A World backed by region files reloads exactly what it generated and edited
+TEST(RegionFileChunkPersistenceTest, WorldRoundTrip) {
+    auto dir = std::filesystem::temp_directory_path() / "blocktest_region_world_test";
+    std::filesystem::remove_all(dir);
+    auto anchors = []() { return std::vector<AbsoluteBlockPosition>{ {0,0,0} }; };
+    {
+        World world(std::make_shared<FlatworldChunkGenerator>(4, Block::Stone), anchors, 1, 0,
+                    std::make_shared<RegionFileChunkPersistence>(dir));
+        world.ensureChunksLoaded();
+        EXPECT_TRUE(world.setBlockIfLoaded(AbsoluteBlockPosition(-1, 8, 0), Block::Dirt));
+    }
+    // Stored chunks are decoded across the generation pool
+    World reloaded(nullptr, anchors, 1, 0, std::make_shared<RegionFileChunkPersistence>(dir));
+    reloaded.setGenerationThreads(4);
+    reloaded.ensureChunksLoaded();
+    EXPECT_EQ(reloaded.getBlockIfLoaded(AbsoluteBlockPosition(0, 3, 0)), Block::Stone);
+    EXPECT_EQ(reloaded.getBlockIfLoaded(AbsoluteBlockPosition(0, 4, 0)), Block::Empty);
+    EXPECT_EQ(reloaded.getBlockIfLoaded(AbsoluteBlockPosition(-1, 8, 0)), Block::Dirt);
+    std::filesystem::remove_all(dir);
+}
+
+// Every row of the SQLite chunks table ends up in the region files
+TEST(RegionFileChunkPersistenceTest, MigrateFromSQLite) {
+    auto dir = std::filesystem::temp_directory_path() / "blocktest_region_migrate_test";
+    std::filesystem::remove_all(dir);
+    auto dbPath = std::filesystem::temp_directory_path() / "blocktest_region_migrate_test.db";
+    std::filesystem::remove(dbPath);
+    std::filesystem::remove(dbPath.string() + "-wal");
+    std::filesystem::remove(dbPath.string() + "-shm");
+    {
+        sqlite3* raw = nullptr;
+        ASSERT_EQ(sqlite3_open(dbPath.string().c_str(), &raw), SQLITE_OK);
+        SQLiteChunkPersistence sqlite(std::unique_ptr<sqlite3, decltype(&sqlite3_close)>(raw, sqlite3_close));
+        for (int32_t i = 0; i < 40; ++i) {
+            ChunkSpan chunk(AbsoluteChunkPosition(i * 7, -i, i));
+            chunk.fill(static_cast<Block>(1 + i % 3));
+            ASSERT_TRUE(sqlite.saveChunk(chunk));
+        }
+    }
+
+    sqlite3* raw = nullptr;
+    ASSERT_EQ(sqlite3_open_v2(dbPath.string().c_str(), &raw, SQLITE_OPEN_READONLY, nullptr), SQLITE_OK);
+    RegionFileChunkPersistence regions(dir);
+    EXPECT_EQ(migrateSQLiteChunks(raw, regions, 16), 40u);
+    sqlite3_close(raw);
+    for (int32_t i = 0; i < 40; ++i) {
+        auto chunk = regions.loadChunk(AbsoluteChunkPosition(i * 7, -i, i));
+        ASSERT_TRUE(chunk.has_value()) << i;
+        EXPECT_EQ((*chunk)->uniformBlock(), static_cast<Block>(1 + i % 3));
+    }
+    std::filesystem::remove_all(dir);
+    std::filesystem::remove(dbPath);
+    std::filesystem::remove(dbPath.string() + "-wal");
+    std::filesystem::remove(dbPath.string() + "-shm");
+}
+
+// Incremental updates must agree with recomputing every anchor's sphere from scratch
+TEST(ChunkResidencyTest, IncrementalMatchesFullRecompute) {
+    const int32_t r = 3;
+    ChunkResidency residency(r);
+    std::vector<AbsoluteChunkPosition> anchors = { {0,0,0}, {2,0,0}, {-5,1,3} };
+    // Unit steps, diagonal steps and one teleport
+    std::vector<AbsoluteChunkPosition> steps = { {1,0,0}, {1,1,0}, {0,-1,1}, {-1,-1,-1}, {0,0,1}, {20,0,-7}, {1,0,0} };
+
+    for (size_t step = 0; step <= steps.size(); ++step) {
+        for (size_t a = 0; a < anchors.size(); ++a) {
+            if (step > 0) {
+                const auto& d = steps[(step - 1 + a) % steps.size()];
+                anchors[a] = AbsoluteChunkPosition(anchors[a].x + d.x, anchors[a].y + d.y, anchors[a].z + d.z);
+            }
+            residency.updateAnchor(a, anchors[a]);
+        }
+
+        size_t expectedCount = 0;
+        for (int32_t x = -12; x <= 40; ++x) {
+            for (int32_t y = -8; y <= 10; ++y) {
+                for (int32_t z = -14; z <= 10; ++z) {
+                    bool expected = false;
+                    for (const auto& c : anchors) {
+                        int32_t dx = x - c.x, dy = y - c.y, dz = z - c.z;
+                        expected = expected || dx * dx + dy * dy + dz * dz <= r * r;
+                    }
+                    expectedCount += expected ? 1 : 0;
+                    ASSERT_EQ(residency.isResident(AbsoluteChunkPosition(x, y, z)), expected)
+                        << "step " << step << " at " << x << "," << y << "," << z;
+                }
+            }
+        }
+        EXPECT_EQ(residency.residentCount(), expectedCount);
+    }
+
+    residency.retainAnchors({});
+    EXPECT_EQ(residency.residentCount(), 0u);
+    EXPECT_TRUE(residency.takePendingLoads().empty());
+}
+
+TEST(ChunkDeltaLogTest, ReturnsEditsOnlyWhenTheWindowCoversThem) {
+    ChunkDeltaLog log(4);
+    AbsoluteChunkPosition pos(1, 2, 3);
+    for (uint64_t version = 11; version <= 16; ++version) {
+        log.record(pos, version, static_cast<uint32_t>(version), Block::Stone);
+    }
+
+    // Window holds versions 13..16
+    auto edits = log.editsBetween(pos, 13, 16);
+    ASSERT_TRUE(edits.has_value());
+    ASSERT_EQ(edits->size(), 3u);
+    EXPECT_EQ((*edits)[0].version, 14u);
+    EXPECT_EQ((*edits)[2].index, 16u);
+    EXPECT_TRUE(log.editsBetween(pos, 12, 16).has_value());
+    EXPECT_FALSE(log.editsBetween(pos, 11, 16).has_value());
+    EXPECT_FALSE(log.editsBetween(pos, 13, 17).has_value());
+    EXPECT_TRUE(log.editsBetween(pos, 16, 16)->empty());
+    EXPECT_FALSE(log.editsBetween(AbsoluteChunkPosition(0, 0, 0), 1, 2).has_value());
+
+    // A gap in versions restarts the log
+    log.record(pos, 40, 0, Block::Sand);
+    EXPECT_FALSE(log.editsBetween(pos, 15, 40).has_value());
+    EXPECT_EQ(log.editsBetween(pos, 39, 40)->size(), 1u);
+}
+
+TEST(ChunkDeltaLogTest, BoundsTrackedChunks) {
+    ChunkDeltaLog log(8, 16);
+    for (int32_t i = 0; i < 100; ++i) {
+        log.record(AbsoluteChunkPosition(i, 0, 0), 1, 0, Block::Stone);
+    }
+    EXPECT_LE(log.trackedChunks(), 16u);
+    EXPECT_TRUE(log.editsBetween(AbsoluteChunkPosition(99, 0, 0), 0, 1).has_value());
+    EXPECT_FALSE(log.editsBetween(AbsoluteChunkPosition(0, 0, 0), 0, 1).has_value());
+}
+
+// Freed slots are reused before another slab is taken, and requests too big for a slot bypass the arena
+TEST(ChunkArenaTest, RecyclesSlotsAndFallsBackForLargeRequests) {
+    ChunkArena arena(2);
+    void* a = arena.allocate(CHUNK_ARENA_SLOT_BYTES, alignof(std::max_align_t));
+    void* b = arena.allocate(64, 8);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(arena.liveSlots(), 2u);
+    EXPECT_EQ(arena.reservedBytes(), 2 * CHUNK_ARENA_SLOT_BYTES);
+    arena.deallocate(a, CHUNK_ARENA_SLOT_BYTES, alignof(std::max_align_t));
+    EXPECT_EQ(arena.allocate(32, 8), a);
+    void* c = arena.allocate(CHUNK_ARENA_SLOT_BYTES, 8);
+    EXPECT_EQ(arena.reservedBytes(), 4 * CHUNK_ARENA_SLOT_BYTES);
+    void* big = arena.allocate(CHUNK_ARENA_SLOT_BYTES + 1, 8);
+    EXPECT_EQ(arena.fallbackAllocations(), 1u);
+    EXPECT_EQ(arena.liveSlots(), 3u);
+    arena.deallocate(big, CHUNK_ARENA_SLOT_BYTES + 1, 8);
+    arena.deallocate(a, 32, 8);
+    arena.deallocate(b, 64, 8);
+    arena.deallocate(c, CHUNK_ARENA_SLOT_BYTES, 8);
+    EXPECT_EQ(arena.liveSlots(), 0u);
+
+    // A pooled chunk and its control block fit one slot of the shared arena
+    ChunkArena& shared = ChunkArena::shared();
+    const size_t live = shared.liveSlots();
+    const size_t fallbacks = shared.fallbackAllocations();
+    {
+        auto chunk = makePooledChunk(AbsoluteChunkPosition(1, 2, 3));
+        auto copy = makePooledChunk(*chunk);
+        EXPECT_EQ(shared.liveSlots(), live + 2);
+        EXPECT_EQ(shared.fallbackAllocations(), fallbacks);
+    }
+    EXPECT_EQ(shared.liveSlots(), live);
+}
+
+// Buffers round up to a size class, freed ones are reused, and a chunk's storage comes from the shared pool
+TEST(BlockStoragePoolTest, RecyclesBuffersBySizeClass) {
+    BlockStoragePool pool;
+    void* palette = pool.allocate(3);
+    void* dense = pool.allocate(CHUNK_BLOCK_COUNT);
+    EXPECT_EQ(pool.liveBytes(), 16u + CHUNK_BLOCK_COUNT);
+    EXPECT_EQ(pool.reservedBytes(), 2 * BLOCK_STORAGE_SLAB_BYTES);
+    pool.deallocate(palette, 3);
+    EXPECT_EQ(pool.allocate(16), palette);
+    void* big = pool.allocate(size_t{1} << (BLOCK_STORAGE_MAX_CLASS_SHIFT + 1));
+    EXPECT_EQ(pool.fallbackAllocations(), 1u);
+    pool.deallocate(big, size_t{1} << (BLOCK_STORAGE_MAX_CLASS_SHIFT + 1));
+    pool.deallocate(palette, 16);
+    pool.deallocate(dense, CHUNK_BLOCK_COUNT);
+    EXPECT_EQ(pool.liveBytes(), 0u);
+    EXPECT_EQ(pool.reservedBytes(), 2 * BLOCK_STORAGE_SLAB_BYTES);
+
+    BlockStoragePool& shared = BlockStoragePool::shared();
+    const size_t live = shared.liveBytes();
+    {
+        auto chunk = makePooledChunk(AbsoluteChunkPosition(0, 0, 0));
+        for (size_t i = 0; i < CHUNK_BLOCK_COUNT; ++i) {
+            chunk->setBlock(i, static_cast<Block>(i % 32));
+        }
+        EXPECT_EQ(chunk->storageMode(), ChunkStorageMode::Dense);
+        EXPECT_GE(shared.liveBytes(), live + CHUNK_BLOCK_COUNT);
+    }
+    EXPECT_EQ(shared.liveBytes(), live);
+}
+
+TEST(EncodedChunkCacheTest, ReusesEncodingUntilTheVersionChanges) {
+    EncodedChunkCache cache(2);
+    ChunkSpan chunk(AbsoluteChunkPosition(1, 0, -1));
+    chunk.fill(Block::Stone);
+    chunk.setVersion(10);
+
+    auto first = cache.get(chunk);
+    auto second = cache.get(chunk);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(cache.hits(), 1u);
+    EXPECT_EQ(first->contentHash, chunk.contentHash());
+    auto expected = chunk.serialize();
+    EXPECT_EQ(first->bytes, std::string(expected.begin(), expected.end()));
+
+    // A write bumps the version, so the next lookup re-encodes
+    chunk.setBlock(size_t{0}, Block::Dirt);
+    auto edited = cache.get(chunk);
+    EXPECT_NE(edited, first);
+    EXPECT_EQ(edited->version, chunk.version());
+    EXPECT_EQ(ChunkSpan(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(edited->bytes.data()), edited->bytes.size())).getBlock(size_t{0}), Block::Dirt);
+
+    cache.invalidate(chunk.position);
+    EXPECT_EQ(cache.size(), 0u);
+    for (int32_t x = 0; x < 5; ++x) {
+        cache.get(ChunkSpan(AbsoluteChunkPosition(x, 0, 0)));
+    }
+    EXPECT_EQ(cache.size(), cache.capacity());
+}
+
+TEST(ChunkLodTest, DownsamplesSurfacesAndClearsFinerRings) {
+    EXPECT_TRUE(ChunkPosEq{}(lodPosition(AbsoluteChunkPosition(-1, 3, 8), 2), AbsoluteChunkPosition(-1, 0, 2)));
+    EXPECT_TRUE(ChunkPosEq{}(lodFirstChunk(AbsoluteChunkPosition(-1, 0, 2), 2), AbsoluteChunkPosition(-4, 0, 8)));
+    EXPECT_TRUE(ChunkPosEq{}(lodLastChunk(AbsoluteChunkPosition(-1, 0, 2), 2), AbsoluteChunkPosition(-1, 3, 11)));
+
+    // A one-block grass floor with a stone pillar one block wide
+    ChunkSpan ground(AbsoluteChunkPosition(0, 0, 0));
+    for (uint8_t z = 0; z < CHUNK_DEPTH; ++z) {
+        for (uint8_t x = 0; x < CHUNK_WIDTH; ++x) {
+            ground.setBlock(ChunkLocalPosition(x, 0, z), Block::Grass);
+        }
+    }
+    for (uint8_t y = 1; y < CHUNK_HEIGHT; ++y) {
+        ground.setBlock(ChunkLocalPosition(4, y, 4), Block::Stone);
+    }
+    ChunkSpan solid(AbsoluteChunkPosition(1, 0, 0));
+    solid.fill(Block::Dirt);
+
+    ChunkSpan lod = downsampleLodChunk({&ground, &solid, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr}, AbsoluteChunkPosition(0, 0, 0));
+    // The floor survives downsampling, the pillar doesn't, and the solid child fills its octant
+    EXPECT_EQ(lod.getBlock(ChunkLocalPosition(0, 0, 0)), Block::Grass);
+    EXPECT_EQ(lod.getBlock(ChunkLocalPosition(2, 0, 2)), Block::Grass);
+    EXPECT_EQ(lod.getBlock(ChunkLocalPosition(2, 1, 2)), Block::Empty);
+    EXPECT_EQ(lod.getBlock(ChunkLocalPosition(8, 7, 0)), Block::Dirt);
+    EXPECT_EQ(lod.getBlock(ChunkLocalPosition(0, 8, 0)), Block::Empty);
+
+    // Clearing where the full-chunk ring draws chunk (0, 0, 0) leaves the rest
+    EXPECT_FALSE(clearLodChunkBox(lod, 1, AbsoluteChunkPosition(2, 0, 0), AbsoluteChunkPosition(3, 1, 1)));
+    EXPECT_TRUE(clearLodChunkBox(lod, 1, AbsoluteChunkPosition(-5, -5, -5), AbsoluteChunkPosition(0, 0, 0)));
+    EXPECT_EQ(lod.getBlock(ChunkLocalPosition(0, 0, 0)), Block::Empty);
+    EXPECT_EQ(lod.getBlock(ChunkLocalPosition(7, 0, 7)), Block::Empty);
+    EXPECT_EQ(lod.getBlock(ChunkLocalPosition(8, 0, 0)), Block::Dirt);
+}
+
+TEST(ChunkLodCacheTest, RebuildsOnlyWhenChunksUnderItChange) {
+    ChunkPosMap<std::shared_ptr<const ChunkSpan>> resident;
+    size_t surfaceSamples = 0;
+    ChunkLodCache cache(
+        [&](const AbsoluteChunkPosition& pos) -> std::shared_ptr<const ChunkSpan> {
+            auto it = resident.find(pos);
+            return it == resident.end() ? nullptr : it->second;
+        },
+        [&](const AbsoluteChunkPosition& min, const AbsoluteChunkPosition& max) {
+            for (const auto& [pos, chunk] : resident) {
+                if (min.x <= pos.x && pos.x <= max.x && min.y <= pos.y && pos.y <= max.y && min.z <= pos.z && pos.z <= max.z) {
+                    return true;
+                }
+            }
+            return false;
+        },
+        [&](int64_t, int64_t) {
+            ++surfaceSamples;
+            return std::optional<WorldgenSurface>(WorldgenSurface{1, Block::Grass});
+        },
+        1);
+    EXPECT_EQ(cache.get(0, AbsoluteChunkPosition(0, 0, 0)), nullptr);
+
+    // Nothing resident: built from the generator's surface
+    auto surface = cache.get(1, AbsoluteChunkPosition(0, 0, 0));
+    EXPECT_EQ(surface->chunk->getBlock(ChunkLocalPosition(0, 0, 0)), Block::Grass);
+    EXPECT_EQ(surface->chunk->getBlock(ChunkLocalPosition(0, 1, 0)), Block::Empty);
+    // One sample per LOD column, whatever the level
+    EXPECT_EQ(surfaceSamples, size_t{CHUNK_WIDTH} * CHUNK_DEPTH);
+    EXPECT_EQ(cache.get(1, AbsoluteChunkPosition(0, 0, 0)), surface);
+    EXPECT_EQ(cache.hits(), 1u);
+    // Rebuilding the same contents after eviction keeps the version clients hold
+    cache.get(1, AbsoluteChunkPosition(4, 0, 4));
+    auto rebuilt = cache.get(1, AbsoluteChunkPosition(0, 0, 0));
+    EXPECT_NE(rebuilt, surface);
+    EXPECT_EQ(rebuilt->version, surface->version);
+
+    // A resident chunk replaces the surface, and each edit to it shows on the next lookup
+    auto edited = std::make_shared<ChunkSpan>(AbsoluteChunkPosition(0, 0, 0));
+    for (uint8_t z = 0; z < CHUNK_DEPTH; ++z) {
+        edited->fillRange(z * edited->strideZ, z * edited->strideZ + CHUNK_WIDTH, Block::Stone);
+    }
+    resident[edited->position] = edited;
+    auto fromChunk = cache.get(1, AbsoluteChunkPosition(0, 0, 0));
+    EXPECT_NE(fromChunk->version, surface->version);
+    EXPECT_EQ(fromChunk->chunk->getBlock(ChunkLocalPosition(0, 0, 0)), Block::Stone);
+    EXPECT_EQ(fromChunk->chunk->getBlock(ChunkLocalPosition(8, 0, 0)), Block::Grass);
+    EXPECT_EQ(cache.get(1, AbsoluteChunkPosition(0, 0, 0)), fromChunk);
+
+    // A far chunk with nothing under it skips the levels below
+    surfaceSamples = 0;
+    auto empty = cache.get(3, AbsoluteChunkPosition(10, 0, 10));
+    EXPECT_EQ(surfaceSamples, size_t{CHUNK_WIDTH} * CHUNK_DEPTH);
+    EXPECT_EQ(empty->chunk->getBlock(ChunkLocalPosition(0, 0, 0)), Block::Grass);
+    EXPECT_EQ(empty->chunk->getBlock(ChunkLocalPosition(0, 1, 0)), Block::Empty);
+
+    // Higher levels follow the level below
+    auto far = cache.get(3, AbsoluteChunkPosition(0, 0, 0));
+    EXPECT_EQ(far->chunk->getBlock(ChunkLocalPosition(0, 0, 0)), Block::Stone);
+    EXPECT_EQ(far->chunk->getBlock(ChunkLocalPosition(2, 0, 2)), Block::Grass);
+    edited->fill(Block::Dirt);
+    auto farEdited = cache.get(3, AbsoluteChunkPosition(0, 0, 0));
+    EXPECT_NE(farEdited->version, far->version);
+    EXPECT_EQ(farEdited->chunk->getBlock(ChunkLocalPosition(0, 0, 0)), Block::Dirt);
+
+    // Unloading keeps what was built from the chunk
+    auto beforeUnload = cache.get(1, AbsoluteChunkPosition(0, 0, 0));
+    resident.clear();
+    EXPECT_EQ(cache.get(1, AbsoluteChunkPosition(0, 0, 0)), beforeUnload);
+}
+
+TEST(DirtyChunkTrackerTest, EditsOnlyReachWatchersInRange) {
+    DirtyChunkTracker tracker(4);
+    // First polls register the watchers and return nothing
+    EXPECT_TRUE(tracker.poll("spawn", AbsoluteChunkPosition(0, 0, 0), 2).empty());
+    EXPECT_TRUE(tracker.poll("far", AbsoluteChunkPosition(100, 0, 100), 2).empty());
+    EXPECT_EQ(tracker.watchersNear(AbsoluteChunkPosition(1, 0, 1)), 1u);
+    EXPECT_EQ(tracker.watchersNear(AbsoluteChunkPosition(-1, -1, -1)), 1u);
+
+    tracker.markDirty(AbsoluteChunkPosition(1, 0, -1));
+    tracker.markDirty(AbsoluteChunkPosition(1, 0, -1));
+    // Indexed in the same region but outside the radius
+    tracker.markDirty(AbsoluteChunkPosition(3, 0, 3));
+    tracker.markDirty(AbsoluteChunkPosition(101, 0, 99));
+
+    auto spawn = tracker.poll("spawn", AbsoluteChunkPosition(0, 0, 0), 2);
+    ASSERT_EQ(spawn.size(), 1u);
+    EXPECT_TRUE(ChunkPosEq{}(spawn[0], AbsoluteChunkPosition(1, 0, -1)));
+    EXPECT_EQ(tracker.poll("far", AbsoluteChunkPosition(100, 0, 100), 2).size(), 1u);
+    // Polled updates aren't returned twice
+    EXPECT_TRUE(tracker.poll("spawn", AbsoluteChunkPosition(0, 0, 0), 2).empty());
+
+    // Moving re-indexes the watcher under its new regions
+    tracker.poll("far", AbsoluteChunkPosition(0, 0, 0), 2);
+    EXPECT_EQ(tracker.watchersNear(AbsoluteChunkPosition(0, 0, 0)), 2u);
+    EXPECT_EQ(tracker.watchersNear(AbsoluteChunkPosition(100, 0, 100)), 0u);
+    tracker.markDirty(AbsoluteChunkPosition(0, 1, 0));
+    EXPECT_EQ(tracker.poll("spawn", AbsoluteChunkPosition(0, 0, 0), 2).size(), 1u);
+    EXPECT_EQ(tracker.poll("far", AbsoluteChunkPosition(0, 0, 0), 2).size(), 1u);
+
+    tracker.remove("spawn");
+    EXPECT_EQ(tracker.watcherCount(), 1u);
+    EXPECT_EQ(tracker.removeIdle(std::chrono::seconds(0)), 1u);
+    EXPECT_EQ(tracker.watchersNear(AbsoluteChunkPosition(0, 0, 0)), 0u);
+}
+
+TEST(ClientChunkCacheTest, EvictsFurthestThenLeastRecentlyUsedAndKeepsPins) {
+    auto makeChunk = [](const AbsoluteChunkPosition& pos) {
+        auto chunk = std::make_shared<ChunkSpan>(pos);
+        chunk->fill(Block::Stone);
+        return chunk;
+    };
+    const size_t perChunk = ClientChunkCache::chunkBytes(*makeChunk(AbsoluteChunkPosition(0, 0, 0)));
+    // Room for five chunks; evicting to the low-water mark from six removes just one
+    ClientChunkCache cache(perChunk * 23 / 4);
+    cache.setCenter(AbsoluteChunkPosition(0, 0, 0));
+
+    const AbsoluteChunkPosition underfoot(0, -1, 0);
+    const AbsoluteChunkPosition near(1, 0, 2);
+    const AbsoluteChunkPosition farOld(6, 0, 0);
+    const AbsoluteChunkPosition farRecent(0, 0, -6);
+    const AbsoluteChunkPosition pinnedFar(20, 0, 0);
+    cache.pin(pinnedFar);
+    for (const auto& pos : {underfoot, near, farOld, farRecent, pinnedFar}) {
+        cache.insert(pos, makeChunk(pos));
+    }
+    EXPECT_EQ(cache.bytes(), perChunk * 5);
+    EXPECT_EQ(cache.evict(), 0u);
+    EXPECT_EQ(cache.size(), 5u);
+
+    // Over budget: of the two far chunks the one looked up longest ago goes
+    EXPECT_NE(cache.find(farRecent), nullptr);
+    cache.insert(AbsoluteChunkPosition(2, 0, 0), makeChunk(AbsoluteChunkPosition(2, 0, 0)));
+    EXPECT_FALSE(cache.contains(farOld));
+    EXPECT_TRUE(cache.contains(farRecent));
+    EXPECT_TRUE(cache.contains(pinnedFar));
+    EXPECT_TRUE(cache.contains(underfoot));
+
+    // Shrinking the budget evicts by distance first, never the pinned chunk
+    cache.setByteBudget(perChunk * 23 / 10);
+    EXPECT_TRUE(cache.contains(pinnedFar));
+    EXPECT_TRUE(cache.contains(underfoot));
+    EXPECT_FALSE(cache.contains(farRecent));
+    EXPECT_EQ(cache.bytes(), perChunk * 2);
+
+    ClientChunkCacheStats stats = cache.stats();
+    EXPECT_EQ(stats.chunks, cache.size());
+    EXPECT_EQ(stats.pinned, 1u);
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_GE(stats.evictions, 4u);
+    EXPECT_EQ(cache.find(farOld), nullptr);
+    EXPECT_EQ(cache.stats().misses, 1u);
+}
+
+TEST(ChunkRequestSchedulerTest, OrdersByDistanceAndFacingAndDropsStale) {
+    ChunkRequestScheduler scheduler(4);
+    scheduler.setViewDirection(0.0, 0.0, 2.0);
+    const AbsoluteChunkPosition ahead(0, 0, 2);
+    const AbsoluteChunkPosition behind(0, 0, -2);
+    const AbsoluteChunkPosition beside(1, 0, 0);
+    const AbsoluteChunkPosition farAhead(0, 0, 3);
+    for (const auto& pos : {farAhead, behind, ahead, beside}) {
+        EXPECT_TRUE(scheduler.enqueue(pos));
+    }
+    EXPECT_FALSE(scheduler.enqueue(ahead));
+    EXPECT_EQ(scheduler.size(), 4u);
+
+    // Nearest first, and a chunk behind waits behind one further off ahead
+    auto batch = scheduler.takeBatch(3);
+    ASSERT_EQ(batch.size(), 3u);
+    EXPECT_TRUE(ChunkPosEq{}(batch[0], beside));
+    EXPECT_TRUE(ChunkPosEq{}(batch[1], ahead));
+    EXPECT_TRUE(ChunkPosEq{}(batch[2], farAhead));
+    EXPECT_FALSE(scheduler.contains(ahead));
+    EXPECT_TRUE(scheduler.contains(behind));
+
+    // Walking away leaves the chunk behind past the cancel distance
+    scheduler.enqueue(AbsoluteChunkPosition(0, 0, 5));
+    auto dropped = scheduler.setCenter(AbsoluteChunkPosition(0, 0, 3));
+    ASSERT_EQ(dropped.size(), 1u);
+    EXPECT_TRUE(ChunkPosEq{}(dropped[0], behind));
+    EXPECT_FALSE(scheduler.contains(behind));
+    EXPECT_TRUE(scheduler.isStale(behind));
+    EXPECT_EQ(scheduler.size(), 1u);
+    EXPECT_TRUE(scheduler.enqueue(behind));
+}
+
+TEST(ChunkRequestSchedulerTest, InflightLimitFollowsRoundTrips) {
+    using std::chrono::microseconds;
+    ChunkRequestScheduler scheduler;
+    EXPECT_EQ(scheduler.inflightLimit(), CHUNK_REQUEST_INITIAL_INFLIGHT);
+    EXPECT_EQ(scheduler.smoothedRoundTrip().count(), 0);
+
+    // Steady fast round trips open the limit up to the maximum
+    for (int i = 0; i < 100; ++i) {
+        scheduler.recordRoundTrip(microseconds(1000));
+    }
+    EXPECT_EQ(scheduler.inflightLimit(), CHUNK_REQUEST_MAX_INFLIGHT);
+    EXPECT_EQ(scheduler.smoothedRoundTrip().count(), 1000);
+
+    // Round trips climbing far past the fastest cut it back, but not below the minimum
+    for (int i = 0; i < 20; ++i) {
+        scheduler.recordRoundTrip(microseconds(20000));
+    }
+    size_t cut = scheduler.inflightLimit();
+    EXPECT_LT(cut, CHUNK_REQUEST_MAX_INFLIGHT);
+    for (int i = 0; i < 1000; ++i) {
+        scheduler.recordRoundTrip(microseconds(20000));
+    }
+    EXPECT_EQ(scheduler.inflightLimit(), CHUNK_REQUEST_MIN_INFLIGHT);
+}
+
+TEST(ChunkRequestSchedulerTest, InflightLimitIgnoresBatchSize) {
+    using std::chrono::microseconds;
+    ChunkRequestScheduler scheduler;
+
+    // Small and large batches at the same per-chunk cost: the large ones aren't taken for queueing
+    for (int i = 0; i < 100; ++i) {
+        const size_t chunks = i % 2 ? 256 : 16;
+        scheduler.recordRoundTrip(microseconds(100 * chunks), chunks);
+    }
+    EXPECT_EQ(scheduler.inflightLimit(), CHUNK_REQUEST_MAX_INFLIGHT);
+    EXPECT_EQ(scheduler.smoothedRoundTrip().count(), 100);
+}
+
+TEST(MpscQueueTest, DeliversEveryProducersItemsInTheirOrder) {
+    MpscQueue<std::pair<int, int>> queue;
+    EXPECT_FALSE(queue.pop().has_value());
+
+    constexpr int producers = 4;
+    constexpr int perProducer = 10000;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, p]() {
+            for (int i = 0; i < perProducer; ++i) {
+                queue.push({p, i});
+            }
+        });
+    }
+
+    // Consume while the producers are still pushing
+    std::vector<int> next(producers, 0);
+    int received = 0;
+    while (received < producers * perProducer) {
+        auto item = queue.pop();
+        if (!item) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(item->second, next[item->first]);
+        ++next[item->first];
+        ++received;
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_FALSE(queue.pop().has_value());
+}
+
+TEST(EntitySpatialIndexTest, BucketsFollowMovesAndAnswerQueries) {
+    entt::registry registry;
+    std::vector<entt::entity> entities;
+    EntitySpatialIndex index;
+    // A row of entities, one every 4 blocks along x
+    for (int i = 0; i < 40; ++i) {
+        entities.push_back(registry.create());
+        EXPECT_TRUE(index.update(entities.back(), AbsolutePrecisePosition(i * 4.0 + 0.5, 10.0, 0.5)));
+    }
+    EXPECT_EQ(index.takeChunkChanges().size(), 40u);
+    EXPECT_EQ(index.occupiedChunkCount(), 40u * 4 / CHUNK_WIDTH);
+
+    // Staying inside the chunk isn't a chunk change; crossing into another is
+    EXPECT_FALSE(index.update(entities[0], AbsolutePrecisePosition(1.5, 10.0, 0.5)));
+    EXPECT_TRUE(index.update(entities[1], AbsolutePrecisePosition(-3.0, 10.0, 0.5)));
+    EXPECT_EQ(index.takeChunkChanges(), std::vector<entt::entity>{entities[1]});
+    EXPECT_EQ(index.chunkOf(entities[1])->x, -1);
+    EXPECT_DOUBLE_EQ(index.positionOf(entities[0])->x, 1.5);
+
+    // Compare every query against a scan of the stored positions
+    auto expectSame = [](std::vector<entt::entity> got, std::vector<entt::entity> want) {
+        std::sort(got.begin(), got.end());
+        std::sort(want.begin(), want.end());
+        EXPECT_EQ(got, want);
+    };
+    for (double radius : {0.0, 3.0, 9.0, 40.0, 500.0}) {
+        const AbsolutePrecisePosition center(30.0, 12.0, 0.0);
+        std::vector<entt::entity> got;
+        index.queryRadius(center, radius, got);
+        std::vector<entt::entity> want;
+        for (auto entity : entities) {
+            auto p = *index.positionOf(entity);
+            double d = (p.x - center.x) * (p.x - center.x) + (p.y - center.y) * (p.y - center.y) + (p.z - center.z) * (p.z - center.z);
+            if (d <= radius * radius) want.push_back(entity);
+        }
+        expectSame(got, want);
+    }
+    for (int32_t span : {0, 2, 100}) {
+        std::vector<entt::entity> got;
+        index.queryBox(AbsoluteChunkPosition(1, 0, 0), AbsoluteChunkPosition(1 + span, 0, 0), got);
+        std::vector<entt::entity> want;
+        for (auto entity : entities) {
+            auto chunk = *index.chunkOf(entity);
+            if (chunk.x >= 1 && chunk.x <= 1 + span && chunk.y == 0 && chunk.z == 0) want.push_back(entity);
+        }
+        expectSame(got, want);
+    }
+
+    // Removing every entity of a chunk drops its bucket
+    for (auto entity : std::vector<entt::entity>(index.entitiesIn(AbsoluteChunkPosition(0, 0, 0)))) {
+        EXPECT_TRUE(index.remove(entity));
+    }
+    EXPECT_TRUE(index.entitiesIn(AbsoluteChunkPosition(0, 0, 0)).empty());
+    EXPECT_FALSE(index.remove(entities[0]));
+    EXPECT_FALSE(index.chunkOf(entities[0]).has_value());
+    EXPECT_EQ(index.size(), 40u - CHUNK_WIDTH / 4 + 1);
+}
+
+TEST(TimerWheelTest, FiresAtTheDeadlineAcrossLevels) {
+    using namespace std::chrono;
+    const auto start = steady_clock::now();
+    TimerWheel<int> wheel(milliseconds(10), start);
+    wheel.schedule(1, start + milliseconds(25));
+    // Far enough out to sit two levels up and cascade down
+    wheel.schedule(2, start + milliseconds(10 * 5000));
+    wheel.schedule(3, start - seconds(1));
+    EXPECT_EQ(wheel.size(), 3u);
+
+    std::vector<int> expired;
+    wheel.advance(start + milliseconds(10), expired);
+    EXPECT_EQ(expired, std::vector<int>{3});
+    expired.clear();
+    wheel.advance(start + milliseconds(29), expired);
+    EXPECT_TRUE(expired.empty());
+    wheel.advance(start + milliseconds(30), expired);
+    EXPECT_EQ(expired, std::vector<int>{1});
+    expired.clear();
+    wheel.advance(start + milliseconds(10 * 4999), expired);
+    EXPECT_TRUE(expired.empty());
+    wheel.advance(start + milliseconds(10 * 5000), expired);
+    EXPECT_EQ(expired, std::vector<int>{2});
+    EXPECT_EQ(wheel.size(), 0u);
+}
+
+TEST(PlayerSessionManagerTest, HandlesResolveAndExpireOnlyWhenIdle) {
+    using namespace std::chrono;
+    entt::registry registry;
+    const auto first = registry.create();
+    const auto second = registry.create();
+    PlayerSessionManager sessions(seconds(1));
+    const AbsolutePrecisePosition origin(0.0, 64.0, 0.0);
+
+    std::string token = sessions.createSession("first", first, origin);
+    std::string other = sessions.createSession("second", second, origin);
+    auto handle = sessions.resolve(token);
+    ASSERT_TRUE(handle.has_value());
+    EXPECT_NE(*handle, *sessions.resolve(other));
+    EXPECT_EQ(sessions.getSessionState(*handle)->playerEntity, first);
+
+    // The same handle with another secret names nothing
+    std::string forged = token;
+    forged.back() = forged.back() == '0' ? '1' : '0';
+    EXPECT_FALSE(sessions.resolve(forged).has_value());
+    EXPECT_FALSE(sessions.refreshSession(forged));
+
+    EXPECT_TRUE(sessions.updatePlayerPosition(*handle, AbsolutePrecisePosition(1.0, 64.0, 0.0)));
+    EXPECT_DOUBLE_EQ(sessions.getSession(token)->position.x, 1.0);
+    EXPECT_TRUE(sessions.removeExpiredSessions(steady_clock::now()).empty());
+
+    // Only the refreshed session outlives its first deadline
+    std::this_thread::sleep_for(milliseconds(600));
+    EXPECT_TRUE(sessions.refreshSession(token));
+    auto expired = sessions.removeExpiredSessions(steady_clock::now() + milliseconds(700));
+    ASSERT_EQ(expired.size(), 1u);
+    EXPECT_EQ(expired[0].playerEntity, second);
+    EXPECT_TRUE(sessions.isValidSession(token));
+    EXPECT_EQ(sessions.getActiveSessionCount(), 1u);
+
+    // A stale handle doesn't reach the session that reuses its slot
+    EXPECT_EQ(sessions.removeSession(token), first);
+    std::string reused = sessions.createSession("third", first, origin);
+    EXPECT_FALSE(sessions.getSessionState(*handle).has_value());
+    EXPECT_FALSE(sessions.refreshSession(*handle));
+    EXPECT_TRUE(sessions.isValidSession(reused));
+}
+
+TEST(EntitySyncTest, TrackerDeltasFollowDirtyEntitiesAndAcks) {
+    entt::registry registry;
+    EntityTracker tracker;
+    // Stands in for World's index, which the server asks who is in view
+    EntitySpatialIndex index;
+    auto place = [&](entt::entity entity, const AbsolutePrecisePosition& position) {
+        registry.emplace_or_replace<AbsolutePrecisePosition>(entity, position);
+        index.update(entity, position);
+        tracker.markDirty(entity);
+    };
+    auto near = registry.create();
+    registry.emplace<NameComponent>(near, "near");
+    place(near, AbsolutePrecisePosition(1.0, 2.0, 3.0));
+    auto far = registry.create();
+    registry.emplace<NameComponent>(far, "far");
+    place(far, AbsolutePrecisePosition(16.0 * 40, 0.0, 0.0));
+    tracker.refresh(registry);
+    EXPECT_EQ(tracker.size(), 2u);
+
+    auto visibleFromOrigin = [&]() {
+        std::vector<entt::entity> nearby;
+        index.queryBox(AbsoluteChunkPosition(-4, -4, -4), AbsoluteChunkPosition(4, 4, 4), nearby);
+        return tracker.snapshotOf(nearby);
+    };
+    EntityInterest interest;
+    auto first = interest.next(0, visibleFromOrigin());
+    EXPECT_TRUE(first.full);
+    ASSERT_EQ(first.deltas.size(), 1u);
+    EXPECT_EQ(first.deltas[0].entity, static_cast<EntityId>(near));
+    EXPECT_EQ(first.deltas[0].name, "near");
+
+    // Moves below the quantum are not sent; until refresh() the tracker doesn't see them at all
+    place(near, AbsolutePrecisePosition(1.01, 2.0, 3.0));
+    tracker.refresh(registry);
+    auto idle = interest.next(first.sequence, visibleFromOrigin());
+    EXPECT_FALSE(idle.full);
+    EXPECT_TRUE(idle.deltas.empty());
+
+    place(near, AbsolutePrecisePosition(5.0, 2.0, 3.0));
+    tracker.refresh(registry);
+    auto moved = interest.next(idle.sequence, visibleFromOrigin());
+    ASSERT_EQ(moved.deltas.size(), 1u);
+    ASSERT_TRUE(moved.deltas[0].position.has_value());
+    EXPECT_FALSE(moved.deltas[0].name.has_value());
+    EXPECT_EQ(dequantizePosition(*moved.deltas[0].position).x, 5.0);
+
+    // An ack the server no longer remembers gets a full snapshot
+    EXPECT_TRUE(interest.next(12345, visibleFromOrigin()).full);
+
+    registry.destroy(near);
+    index.remove(near);
+    tracker.markDirty(near);
+    tracker.refresh(registry);
+    auto gone = interest.next(moved.sequence, visibleFromOrigin());
+    ASSERT_EQ(gone.deltas.size(), 1u);
+    EXPECT_TRUE(gone.deltas[0].removed);
+}
+
+TEST(EntitySyncTest, MirrorAppliesEncodedDeltas) {
+    EntityDelta delta;
+    delta.entity = 7;
+    delta.position = quantizePosition(AbsolutePrecisePosition(-1.5, 64.25, 8.0));
+    delta.name = "alice";
+    EntityDelta decoded;
+    decoded.entity = delta.entity;
+    decodeEntityComponents(encodeEntityComponents(delta), decoded);
+    EXPECT_EQ(decoded.position, delta.position);
+    EXPECT_EQ(decoded.name, delta.name);
+
+    EntityMirror mirror;
+    mirror.apply(decoded);
+    auto local = mirror.localEntity(7);
+    ASSERT_TRUE(local.has_value());
+    EXPECT_EQ(mirror.registry().raw().get<NameComponent>(*local).name, "alice");
+    EXPECT_EQ(mirror.registry().raw().get<AbsolutePrecisePosition>(*local).y, 64.25);
+
+    EntityDelta removed;
+    removed.entity = 7;
+    removed.removed = true;
+    mirror.apply(removed);
+    EXPECT_EQ(mirror.size(), 0u);
+}